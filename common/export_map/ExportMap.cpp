@@ -32,6 +32,68 @@ using std::string;
 using std::stringstream;
 
 
+HistogramVariable::HistogramVariable(const string &name)
+    : BaseVariable(name) {
+  Reset();
+}
+
+
+/*
+ * Clear all samples.
+ */
+void HistogramVariable::Reset() {
+  m_count = 0;
+  m_total = 0;
+  m_max = 0;
+  for (unsigned int i = 0; i < BUCKETS; i++)
+    m_buckets[i] = 0;
+}
+
+
+/*
+ * Return the string representation of this histogram.
+ * The form is:
+ *   count:N mean_us:M max_us:X p50_us:<A p99_us:<B <1us:C <2us:D ...
+ * Empty buckets are skipped.
+ * @return the string representation of the variable.
+ */
+const string HistogramVariable::Value() const {
+  stringstream value;
+  value << "count:" << m_count << " mean_us:" <<
+    (m_count ? m_total / static_cast<int64_t>(m_count) : 0) << " max_us:" <<
+    m_max;
+  if (!m_count)
+    return value.str();
+
+  value << " p50_us:<" << Percentile(50) << " p99_us:<" << Percentile(99);
+  for (unsigned int i = 0; i < BUCKETS; i++) {
+    if (!m_buckets[i])
+      continue;
+    if (i == BUCKETS - 1)
+      value << " >=" << (static_cast<int64_t>(1) << (i - 1));
+    else
+      value << " <" << (static_cast<int64_t>(1) << i);
+    value << "us:" << m_buckets[i];
+  }
+  return value.str();
+}
+
+
+/*
+ * Return the upper bound of the bucket that contains the given percentile.
+ */
+int64_t HistogramVariable::Percentile(unsigned int percent) const {
+  uint64_t target = (m_count * percent + 99) / 100;
+  uint64_t seen = 0;
+  for (unsigned int i = 0; i < BUCKETS - 1; i++) {
+    seen += m_buckets[i];
+    if (seen >= target)
+      return static_cast<int64_t>(1) << i;
+  }
+  return m_max + 1;
+}
+
+
 /*
  * Return the string representation of this map variable.
  * The form is:
@@ -66,13 +128,45 @@ const string MapVariable<string>::Value() const {
 }
 
 
+/*
+ * Return the string representation of this map variable, this is the same as
+ * a MapVariable.
+ */
+template<typename Type>
+const string IndexedMapVariable<Type>::Value() const {
+  stringstream value;
+  value << "map:" << m_label;
+  typename map<unsigned int, Type>::const_iterator iter;
+  for (iter = m_variables.begin(); iter != m_variables.end(); ++iter)
+    value << " " << iter->first << ":" << iter->second;
+  return value.str();
+}
+
+
+template<>
+const string IndexedMapVariable<string>::Value() const {
+  stringstream value;
+  value << "map:" << m_label;
+  map<unsigned int, string>::const_iterator iter;
+  for (iter = m_variables.begin(); iter != m_variables.end(); ++iter) {
+    std::string var = iter->second;
+    Escape(&var);
+    value << " " << iter->first << ":\"" << var << "\"";
+  }
+  return value.str();
+}
+
+
 ExportMap::~ExportMap() {
   DeleteVariables(&m_int_variables);
   DeleteVariables(&m_counter_variables);
+  DeleteVariables(&m_histogram_variables);
   DeleteVariables(&m_string_variables);
   DeleteVariables(&m_str_map_variables);
   DeleteVariables(&m_uint_map_variables);
   DeleteVariables(&m_int_map_variables);
+  DeleteVariables(&m_str_indexed_map_variables);
+  DeleteVariables(&m_uint_indexed_map_variables);
 }
 
 
@@ -106,6 +200,16 @@ StringVariable *ExportMap::GetStringVar(const string &name) {
 }
 
 
+/*
+ * Lookup or create a histogram variable.
+ * @param name the name of the variable.
+ * @return a HistogramVariable.
+ */
+HistogramVariable *ExportMap::GetHistogramVar(const string &name) {
+  return GetVar(&m_histogram_variables, name);
+}
+
+
 /*
  * Lookup or create a string map variable
  * @param name the name of the variable
@@ -139,6 +243,30 @@ UIntMap *ExportMap::GetUIntMapVar(const string &name, const string &label) {
 }
 
 
+/*
+ * Lookup or create a string map variable with integer keys
+ * @param name the name of the variable
+ * @param label the label to use for the map (optional)
+ * @return an IndexedMapVariable
+ */
+StringIndexedMap *ExportMap::GetStringIndexedMapVar(const string &name,
+                                                    const string &label) {
+  return GetMapVar(&m_str_indexed_map_variables, name, label);
+}
+
+
+/*
+ * Lookup or create an unsigned int map variable with integer keys
+ * @param name the name of the variable
+ * @param label the label to use for the map (optional)
+ * @return an IndexedMapVariable
+ */
+UIntIndexedMap *ExportMap::GetUIntIndexedMapVar(const string &name,
+                                                const string &label) {
+  return GetMapVar(&m_uint_indexed_map_variables, name, label);
+}
+
+
 /*
  * Return a list of all variables.
  * @return a vector of all variables.
@@ -148,9 +276,12 @@ vector<BaseVariable*> ExportMap::AllVariables() const {
   AddVariablesToVector(&variables, m_int_variables);
   AddVariablesToVector(&variables, m_counter_variables);
   AddVariablesToVector(&variables, m_string_variables);
+  AddVariablesToVector(&variables, m_histogram_variables);
   AddVariablesToVector(&variables, m_str_map_variables);
   AddVariablesToVector(&variables, m_int_map_variables);
   AddVariablesToVector(&variables, m_uint_map_variables);
+  AddVariablesToVector(&variables, m_str_indexed_map_variables);
+  AddVariablesToVector(&variables, m_uint_indexed_map_variables);
 
   sort(variables.begin(), variables.end(), VariableLessThan());
   return variables;
@@ -27,8 +27,11 @@
 using ola::BaseVariable;
 using ola::CounterVariable;
 using ola::ExportMap;
+using ola::HistogramVariable;
 using ola::IntMap;
 using ola::IntegerVariable;
+using ola::UIntIndexedMap;
+using ola::StringIndexedMap;
 using ola::StringMap;
 using ola::StringVariable;
 using std::string;
@@ -40,8 +43,10 @@ class ExportMapTest: public CppUnit::TestFixture {
   CPPUNIT_TEST(testIntegerVariable);
   CPPUNIT_TEST(testCounterVariable);
   CPPUNIT_TEST(testStringVariable);
+  CPPUNIT_TEST(testHistogramVariable);
   CPPUNIT_TEST(testStringMapVariable);
   CPPUNIT_TEST(testIntMapVariable);
+  CPPUNIT_TEST(testIndexedMapVariable);
   CPPUNIT_TEST(testExportMap);
   CPPUNIT_TEST_SUITE_END();
 
@@ -49,8 +54,10 @@ class ExportMapTest: public CppUnit::TestFixture {
     void testIntegerVariable();
     void testCounterVariable();
     void testStringVariable();
+    void testHistogramVariable();
     void testStringMapVariable();
     void testIntMapVariable();
+    void testIndexedMapVariable();
     void testExportMap();
 };
 
@@ -118,6 +125,60 @@ void ExportMapTest::testStringVariable() {
 }
 
 
+/*
+ * Check that the HistogramVariable works correctly.
+ */
+void ExportMapTest::testHistogramVariable() {
+  string name = "foo";
+  HistogramVariable var(name);
+
+  CPPUNIT_ASSERT_EQUAL(var.Name(), name);
+  CPPUNIT_ASSERT_EQUAL(string("count:0 mean_us:0 max_us:0"), var.Value());
+
+  var.Add(0);
+  var.Add(1);
+  var.Add(3);
+  var.Add(3);
+  var.Add(100);
+  CPPUNIT_ASSERT_EQUAL((uint64_t) 5, var.Count());
+  CPPUNIT_ASSERT_EQUAL((int64_t) 100, var.Max());
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, var.BucketCount(0));
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, var.BucketCount(1));
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 2, var.BucketCount(2));
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, var.BucketCount(7));
+  CPPUNIT_ASSERT_EQUAL(
+      string("count:5 mean_us:21 max_us:100 p50_us:<4 p99_us:<128 <1us:1 "
+             "<2us:1 <4us:2 <128us:1"),
+      var.Value());
+
+  // very long samples end up in the last bucket
+  var.Add(static_cast<int64_t>(1) << 40);
+  CPPUNIT_ASSERT_EQUAL(
+      (unsigned int) 1,
+      var.BucketCount(HistogramVariable::BUCKETS - 1));
+
+  // the bucket boundaries are powers of two
+  var.Reset();
+  var.Add(2);
+  var.Add(4);
+  var.Add(7);
+  var.Add((static_cast<int64_t>(1) << 22) - 1);
+  var.Add(static_cast<int64_t>(1) << 22);
+  var.Add(-5);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, var.BucketCount(0));
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, var.BucketCount(2));
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 2, var.BucketCount(3));
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, var.BucketCount(22));
+  CPPUNIT_ASSERT_EQUAL(
+      (unsigned int) 1,
+      var.BucketCount(HistogramVariable::BUCKETS - 1));
+
+  var.Reset();
+  CPPUNIT_ASSERT_EQUAL((uint64_t) 0, var.Count());
+  CPPUNIT_ASSERT_EQUAL(string("count:0 mean_us:0 max_us:0"), var.Value());
+}
+
+
 /*
  * Check that the StringMap works correctly.
  */
@@ -189,6 +250,42 @@ void ExportMapTest::testIntMapVariable() {
   CPPUNIT_ASSERT_EQUAL(var.Value(), string("map:count key3:1"));
 }
 
+
+/*
+ * Check that the maps with integer keys work correctly.
+ */
+void ExportMapTest::testIndexedMapVariable() {
+  UIntIndexedMap var("foo", "universe");
+  CPPUNIT_ASSERT_EQUAL(string("foo"), var.Name());
+  CPPUNIT_ASSERT_EQUAL(string("universe"), var.Label());
+  CPPUNIT_ASSERT_EQUAL(string("map:universe"), var.Value());
+
+  // keys are sorted numerically
+  var[10] = 1;
+  var[2] = 5;
+  CPPUNIT_ASSERT_EQUAL(5u, var[2]);
+  CPPUNIT_ASSERT_EQUAL(string("map:universe 2:5 10:1"), var.Value());
+
+  // references remain valid as other keys are added & removed
+  unsigned int &counter = var[2];
+  for (unsigned int i = 100; i < 200; i++)
+    var[i] = i;
+  for (unsigned int i = 100; i < 200; i++)
+    var.Remove(i);
+  counter++;
+  CPPUNIT_ASSERT_EQUAL(string("map:universe 2:6 10:1"), var.Value());
+
+  var.Remove(10);
+  var.Remove(10);
+  CPPUNIT_ASSERT_EQUAL(string("map:universe 2:6"), var.Value());
+
+  StringIndexedMap str_var("bar", "universe");
+  str_var[1] = "foo\"";
+  CPPUNIT_ASSERT_EQUAL(string("map:universe 1:\"foo\\\"\""),
+                       str_var.Value());
+}
+
+
 /*
  * Check the export map works correctly.
  */
@@ -211,6 +308,9 @@ void ExportMapTest::testExportMap() {
   CPPUNIT_ASSERT_EQUAL(map_var->Name(), map_var_name);
   CPPUNIT_ASSERT_EQUAL(map_var->Label(), map_var_label);
 
+  UIntIndexedMap *indexed_var = map.GetUIntIndexedMapVar("indexed_var");
+  CPPUNIT_ASSERT_EQUAL(indexed_var, map.GetUIntIndexedMapVar("indexed_var"));
+
   vector<BaseVariable*> variables = map.AllVariables();
-  CPPUNIT_ASSERT_EQUAL(variables.size(), (size_t) 3);
+  CPPUNIT_ASSERT_EQUAL(variables.size(), (size_t) 4);
 }
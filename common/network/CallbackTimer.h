@@ -0,0 +1,62 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * CallbackTimer.h
+ * Records how long an i/o handler takes to run.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#ifndef COMMON_NETWORK_CALLBACKTIMER_H_
+#define COMMON_NETWORK_CALLBACKTIMER_H_
+
+#include "ola/Clock.h"
+#include "ola/ExportMap.h"
+
+namespace ola {
+namespace network {
+
+/*
+ * Adds the time between construction and destruction to a HistogramVariable.
+ * If the histogram is NULL this does nothing, so the cost for descriptors
+ * that haven't been named is a single branch.
+ */
+class CallbackTimer {
+  public:
+    CallbackTimer(const Clock *clock, HistogramVariable *histogram)
+        : m_clock(clock),
+          m_histogram(histogram) {
+      if (m_histogram)
+        m_clock->CurrentTime(&m_start);
+    }
+
+    ~CallbackTimer() {
+      if (m_histogram) {
+        TimeStamp end;
+        m_clock->CurrentTime(&end);
+        m_histogram->Add((end - m_start).AsInt());
+      }
+    }
+
+  private:
+    const Clock *m_clock;
+    HistogramVariable *m_histogram;
+    TimeStamp m_start;
+
+    CallbackTimer(const CallbackTimer&);
+    CallbackTimer& operator=(const CallbackTimer&);
+};
+}  // network
+}  // ola
+#endif  // COMMON_NETWORK_CALLBACKTIMER_H_
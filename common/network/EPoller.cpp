@@ -0,0 +1,597 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * EPoller.cpp
+ * A Poller which uses epoll()
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <map>
+#include <vector>
+
+#include "common/network/CallbackTimer.h"
+#include "common/network/EPoller.h"
+#include "ola/Logging.h"
+#include "ola/network/SelectServer.h"
+#include "ola/network/Socket.h"
+
+namespace ola {
+namespace network {
+
+static const uint32_t READ_FLAGS = EPOLLIN;
+static const uint32_t WRITE_FLAGS = EPOLLOUT;
+// these are always reported, regardless of what we asked for
+static const uint32_t ERROR_FLAGS = EPOLLHUP | EPOLLERR;
+
+
+/*
+ * Constructor
+ * @param export_map an ExportMap to update
+ * @param clock the Clock used to set the wake up time
+ * @param internal_descriptor a descriptor that is always polled for reads.
+ *   This isn't counted in the ExportMap and is never removed.
+ */
+EPoller::EPoller(ExportMap *export_map,
+                 const Clock *clock,
+                 ReadFileDescriptor *internal_descriptor)
+    : m_export_map(export_map),
+      m_clock(clock),
+      m_epoll_fd(INVALID_DESCRIPTOR) {
+  if (m_export_map)
+    m_export_map->GetIntegerVar(SelectServer::K_READ_DESCRIPTOR_VAR);
+
+  m_epoll_fd = epoll_create(MAX_EVENTS);
+  if (m_epoll_fd < 0) {
+    OLA_FATAL << "epoll_create() failed: " << strerror(errno);
+    m_epoll_fd = INVALID_DESCRIPTOR;
+    return;
+  }
+
+  if (internal_descriptor && internal_descriptor->ValidReadDescriptor()) {
+    epoll_descriptor_t *descriptor = LookupOrCreate(
+        internal_descriptor->ReadDescriptor());
+    descriptor->read_descriptor = internal_descriptor;
+    descriptor->internal = true;
+    UpdateEvents(descriptor, READ_FLAGS);
+  }
+}
+
+
+EPoller::~EPoller() {
+  UnregisterAll();
+  DescriptorMap::iterator iter = m_descriptors.begin();
+  for (; iter != m_descriptors.end(); ++iter)
+    delete iter->second;
+  m_descriptors.clear();
+  m_connected_descriptors.clear();
+  FreeOrphanedDescriptors();
+
+  if (m_epoll_fd != INVALID_DESCRIPTOR)
+    close(m_epoll_fd);
+}
+
+
+bool EPoller::AddReadDescriptor(ReadFileDescriptor *descriptor) {
+  if (!descriptor->ValidReadDescriptor()) {
+    OLA_WARN << "AddReadDescriptor called with invalid descriptor";
+    return false;
+  }
+
+  epoll_descriptor_t *epoll_descriptor = LookupOrCreate(
+      descriptor->ReadDescriptor());
+  if (epoll_descriptor->read_descriptor || epoll_descriptor->internal ||
+      epoll_descriptor->connected_descriptor) {
+    if (epoll_descriptor->read_descriptor != descriptor)
+      OLA_WARN << "fd " << epoll_descriptor->fd <<
+        " is already registered for reads";
+    return false;
+  }
+
+  epoll_descriptor->read_descriptor = descriptor;
+  if (!UpdateEvents(epoll_descriptor,
+                    epoll_descriptor->events | READ_FLAGS)) {
+    epoll_descriptor->read_descriptor = NULL;
+    ReleaseIfUnused(epoll_descriptor);
+    return false;
+  }
+
+  if (m_export_map)
+    (*m_export_map->GetIntegerVar(SelectServer::K_READ_DESCRIPTOR_VAR))++;
+  return true;
+}
+
+
+bool EPoller::AddReadDescriptor(ConnectedDescriptor *descriptor,
+                                bool delete_on_close) {
+  if (!descriptor->ValidReadDescriptor()) {
+    OLA_WARN << "AddReadDescriptor called with invalid descriptor";
+    return false;
+  }
+
+  epoll_descriptor_t *epoll_descriptor = LookupOrCreate(
+      descriptor->ReadDescriptor());
+  if (epoll_descriptor->read_descriptor || epoll_descriptor->internal ||
+      epoll_descriptor->connected_descriptor) {
+    if (epoll_descriptor->connected_descriptor != descriptor)
+      OLA_WARN << "fd " << epoll_descriptor->fd <<
+        " is already registered for reads";
+    return false;
+  }
+
+  epoll_descriptor->connected_descriptor = descriptor;
+  epoll_descriptor->delete_on_close = delete_on_close;
+  if (!UpdateEvents(epoll_descriptor,
+                    epoll_descriptor->events | READ_FLAGS)) {
+    epoll_descriptor->connected_descriptor = NULL;
+    ReleaseIfUnused(epoll_descriptor);
+    return false;
+  }
+  m_connected_descriptors.insert(epoll_descriptor);
+
+  if (m_export_map)
+    (*m_export_map->GetIntegerVar(
+        SelectServer::K_CONNECTED_DESCRIPTORS_VAR))++;
+  return true;
+}
+
+
+bool EPoller::RemoveReadDescriptor(ReadFileDescriptor *descriptor) {
+  if (!descriptor->ValidReadDescriptor())
+    OLA_WARN << "Removing a invalid file descriptor";
+
+  epoll_descriptor_t *epoll_descriptor = FindByReadDescriptor(descriptor);
+  if (!epoll_descriptor || epoll_descriptor->read_descriptor != descriptor ||
+      epoll_descriptor->internal)
+    return false;
+
+  epoll_descriptor->read_descriptor = NULL;
+  epoll_descriptor->read_histogram = NULL;
+  // if the descriptor has been closed the kernel has already removed it
+  if (descriptor->ValidReadDescriptor())
+    UpdateEvents(epoll_descriptor, epoll_descriptor->events & ~READ_FLAGS);
+  ReleaseIfUnused(epoll_descriptor);
+
+  if (m_export_map)
+    (*m_export_map->GetIntegerVar(SelectServer::K_READ_DESCRIPTOR_VAR))--;
+  return true;
+}
+
+
+bool EPoller::RemoveReadDescriptor(ConnectedDescriptor *descriptor) {
+  if (!descriptor->ValidReadDescriptor())
+    OLA_WARN << "Removing a invalid file descriptor";
+
+  epoll_descriptor_t *epoll_descriptor = FindByReadDescriptor(descriptor);
+  if (!epoll_descriptor ||
+      epoll_descriptor->connected_descriptor != descriptor)
+    return false;
+
+  epoll_descriptor->connected_descriptor = NULL;
+  epoll_descriptor->read_histogram = NULL;
+  epoll_descriptor->delete_on_close = false;
+  m_connected_descriptors.erase(epoll_descriptor);
+  if (descriptor->ValidReadDescriptor())
+    UpdateEvents(epoll_descriptor, epoll_descriptor->events & ~READ_FLAGS);
+  ReleaseIfUnused(epoll_descriptor);
+
+  if (m_export_map)
+    (*m_export_map->GetIntegerVar(
+        SelectServer::K_CONNECTED_DESCRIPTORS_VAR))--;
+  return true;
+}
+
+
+bool EPoller::AddWriteDescriptor(WriteFileDescriptor *descriptor) {
+  if (!descriptor->ValidWriteDescriptor()) {
+    OLA_WARN << "AddWriteDescriptor called with invalid descriptor";
+    return false;
+  }
+
+  epoll_descriptor_t *epoll_descriptor = LookupOrCreate(
+      descriptor->WriteDescriptor());
+  if (epoll_descriptor->write_descriptor) {
+    if (epoll_descriptor->write_descriptor != descriptor)
+      OLA_WARN << "fd " << epoll_descriptor->fd <<
+        " is already registered for writes";
+    return false;
+  }
+
+  epoll_descriptor->write_descriptor = descriptor;
+  if (!UpdateEvents(epoll_descriptor,
+                    epoll_descriptor->events | WRITE_FLAGS)) {
+    epoll_descriptor->write_descriptor = NULL;
+    ReleaseIfUnused(epoll_descriptor);
+    return false;
+  }
+
+  if (m_export_map)
+    (*m_export_map->GetIntegerVar(SelectServer::K_WRITE_DESCRIPTOR_VAR))++;
+  return true;
+}
+
+
+bool EPoller::RemoveWriteDescriptor(WriteFileDescriptor *descriptor) {
+  if (!descriptor->ValidWriteDescriptor())
+    OLA_WARN << "Removing a closed descriptor";
+
+  epoll_descriptor_t *epoll_descriptor = FindByWriteDescriptor(descriptor);
+  if (!epoll_descriptor)
+    return false;
+
+  epoll_descriptor->write_descriptor = NULL;
+  epoll_descriptor->write_histogram = NULL;
+  if (descriptor->ValidWriteDescriptor())
+    UpdateEvents(epoll_descriptor, epoll_descriptor->events & ~WRITE_FLAGS);
+  ReleaseIfUnused(epoll_descriptor);
+
+  if (m_export_map)
+    (*m_export_map->GetIntegerVar(SelectServer::K_WRITE_DESCRIPTOR_VAR))--;
+  return true;
+}
+
+
+/*
+ * Record how long the read handler for a descriptor takes.
+ */
+bool EPoller::SetReadHistogram(ReadFileDescriptor *descriptor,
+                               HistogramVariable *histogram) {
+  epoll_descriptor_t *epoll_descriptor = FindByReadDescriptor(descriptor);
+  if (!epoll_descriptor || epoll_descriptor->internal ||
+      (epoll_descriptor->read_descriptor != descriptor &&
+       epoll_descriptor->connected_descriptor != descriptor))
+    return false;
+  epoll_descriptor->read_histogram = histogram;
+  return true;
+}
+
+
+/*
+ * Record how long the write handler for a descriptor takes.
+ */
+bool EPoller::SetWriteHistogram(WriteFileDescriptor *descriptor,
+                                HistogramVariable *histogram) {
+  epoll_descriptor_t *epoll_descriptor = FindByWriteDescriptor(descriptor);
+  if (!epoll_descriptor)
+    return false;
+  epoll_descriptor->write_histogram = histogram;
+  return true;
+}
+
+
+/*
+ * One iteration of the epoll() loop.
+ * @return false on error, true on success.
+ */
+bool EPoller::Poll(const TimeInterval &poll_interval,
+                   TimeStamp *wake_up_time) {
+  if (m_epoll_fd == INVALID_DESCRIPTOR)
+    return false;
+
+  CheckConnectedDescriptors();
+  FreeOrphanedDescriptors();
+
+  // epoll only has ms resolution, round up so we don't spin until the next
+  // timeout is due. A negative value would block forever.
+  int64_t usecs = poll_interval.AsInt();
+  int ms_to_sleep = usecs > 0 ?
+    static_cast<int>((usecs + ONE_THOUSAND - 1) / ONE_THOUSAND) : 0;
+
+  struct epoll_event events[MAX_EVENTS];
+  int ready = epoll_wait(m_epoll_fd, events, MAX_EVENTS, ms_to_sleep);
+
+  if (ready == 0) {
+    m_clock->CurrentTime(wake_up_time);
+    return true;
+  } else if (ready == -1) {
+    if (errno == EINTR)
+      return true;
+    OLA_WARN << "epoll_wait() error, " << strerror(errno);
+    return false;
+  }
+
+  m_clock->CurrentTime(wake_up_time);
+
+  // Handlers may add or remove descriptors. Removed entries are orphaned
+  // rather than deleted so the pointers in events[] remain valid.
+  for (int i = 0; i < ready; i++) {
+    epoll_descriptor_t *descriptor =
+      reinterpret_cast<epoll_descriptor_t*>(events[i].data.ptr);
+
+    if (events[i].events & (READ_FLAGS | ERROR_FLAGS)) {
+      if (descriptor->read_descriptor) {
+        CallbackTimer timer(m_clock, descriptor->read_histogram);
+        descriptor->read_descriptor->PerformRead();
+      } else if (descriptor->connected_descriptor) {
+        if (descriptor->connected_descriptor->IsClosed()) {
+          HandleClosedDescriptor(descriptor);
+        } else {
+          CallbackTimer timer(m_clock, descriptor->read_histogram);
+          descriptor->connected_descriptor->PerformRead();
+        }
+      }
+    }
+
+    if ((events[i].events & (WRITE_FLAGS | ERROR_FLAGS)) &&
+        descriptor->write_descriptor) {
+      CallbackTimer timer(m_clock, descriptor->write_histogram);
+      descriptor->write_descriptor->PerformWrite();
+    }
+  }
+
+  FreeOrphanedDescriptors();
+  return true;
+}
+
+
+/*
+ * Remove all registrations.
+ */
+void EPoller::UnregisterAll() {
+  DescriptorMap::iterator iter = m_descriptors.begin();
+  while (iter != m_descriptors.end()) {
+    DescriptorMap::iterator this_iter = iter;
+    iter++;
+    epoll_descriptor_t *descriptor = this_iter->second;
+    if (descriptor->internal)
+      continue;
+
+    if (descriptor->connected_descriptor && descriptor->delete_on_close)
+      delete descriptor->connected_descriptor;
+    m_orphaned_descriptors.push_back(descriptor);
+    m_descriptors.erase(this_iter);
+  }
+  m_connected_descriptors.clear();
+  FreeOrphanedDescriptors();
+}
+
+
+/*
+ * Find the entry for a fd, creating it if it doesn't exist. If the existing
+ * entry refers to descriptors that were closed without being removed, they
+ * are dropped first. A ConnectedDescriptor is closed as if the remote end had
+ * closed it, so OnClose runs and it's deleted if it was added with
+ * delete_on_close.
+ */
+EPoller::epoll_descriptor_t *EPoller::LookupOrCreate(int fd) {
+  DescriptorMap::iterator iter = m_descriptors.find(fd);
+  if (iter != m_descriptors.end()) {
+    epoll_descriptor_t *descriptor = iter->second;
+    bool stale = false;
+    if (descriptor->read_descriptor && !descriptor->internal &&
+        descriptor->read_descriptor->ReadDescriptor() != fd) {
+      descriptor->read_descriptor = NULL;
+      descriptor->read_histogram = NULL;
+      stale = true;
+      if (m_export_map)
+        (*m_export_map->GetIntegerVar(
+            SelectServer::K_READ_DESCRIPTOR_VAR))--;
+    }
+    bool closed = (descriptor->connected_descriptor &&
+                   descriptor->connected_descriptor->ReadDescriptor() != fd);
+    if (descriptor->write_descriptor &&
+        descriptor->write_descriptor->WriteDescriptor() != fd &&
+        !(closed && descriptor->write_descriptor ==
+          static_cast<WriteFileDescriptor*>(
+            descriptor->connected_descriptor))) {
+      descriptor->write_descriptor = NULL;
+      descriptor->write_histogram = NULL;
+      stale = true;
+      if (m_export_map)
+        (*m_export_map->GetIntegerVar(
+            SelectServer::K_WRITE_DESCRIPTOR_VAR))--;
+    }
+
+    if (stale || closed) {
+      OLA_WARN << "Removed a inactive descriptor from the select server";
+      // the kernel dropped the old registration when the fd was closed
+      descriptor->events = 0;
+    }
+    if (!closed)
+      return descriptor;
+
+    // this may release the entry, in which case a new one is created below
+    HandleClosedDescriptor(descriptor);
+    iter = m_descriptors.find(fd);
+    if (iter != m_descriptors.end())
+      return iter->second;
+  }
+
+  epoll_descriptor_t *descriptor = new epoll_descriptor_t;
+  descriptor->fd = fd;
+  descriptor->events = 0;
+  descriptor->read_descriptor = NULL;
+  descriptor->connected_descriptor = NULL;
+  descriptor->write_descriptor = NULL;
+  descriptor->read_histogram = NULL;
+  descriptor->write_histogram = NULL;
+  descriptor->delete_on_close = false;
+  descriptor->internal = false;
+  m_descriptors[fd] = descriptor;
+  return descriptor;
+}
+
+
+/*
+ * Find the entry for a read descriptor. If the descriptor has been closed we
+ * no longer know the fd, so fall back to a linear search.
+ */
+EPoller::epoll_descriptor_t *EPoller::FindByReadDescriptor(
+    const ReadFileDescriptor *descriptor) {
+  if (descriptor->ValidReadDescriptor()) {
+    DescriptorMap::iterator iter = m_descriptors.find(
+        descriptor->ReadDescriptor());
+    return iter == m_descriptors.end() ? NULL : iter->second;
+  }
+
+  DescriptorMap::iterator iter = m_descriptors.begin();
+  for (; iter != m_descriptors.end(); ++iter) {
+    if (iter->second->read_descriptor == descriptor ||
+        iter->second->connected_descriptor == descriptor)
+      return iter->second;
+  }
+  return NULL;
+}
+
+
+EPoller::epoll_descriptor_t *EPoller::FindByWriteDescriptor(
+    const WriteFileDescriptor *descriptor) {
+  if (descriptor->ValidWriteDescriptor()) {
+    DescriptorMap::iterator iter = m_descriptors.find(
+        descriptor->WriteDescriptor());
+    if (iter == m_descriptors.end() ||
+        iter->second->write_descriptor != descriptor)
+      return NULL;
+    return iter->second;
+  }
+
+  DescriptorMap::iterator iter = m_descriptors.begin();
+  for (; iter != m_descriptors.end(); ++iter) {
+    if (iter->second->write_descriptor == descriptor)
+      return iter->second;
+  }
+  return NULL;
+}
+
+
+/*
+ * Change the set of events we're interested in for a fd.
+ */
+bool EPoller::UpdateEvents(epoll_descriptor_t *descriptor, uint32_t events) {
+  if (descriptor->events == events)
+    return true;
+
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = events;
+  event.data.ptr = descriptor;
+
+  int op = EPOLL_CTL_MOD;
+  if (!events)
+    op = EPOLL_CTL_DEL;
+  else if (!descriptor->events)
+    op = EPOLL_CTL_ADD;
+
+  int r = epoll_ctl(m_epoll_fd, op, descriptor->fd, &event);
+  if (r && op == EPOLL_CTL_ADD && errno == EEXIST)
+    r = epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, descriptor->fd, &event);
+
+  if (r && !(op == EPOLL_CTL_DEL && (errno == ENOENT || errno == EBADF))) {
+    OLA_WARN << "epoll_ctl(" << op << ", " << descriptor->fd << ") failed: "
+      << strerror(errno);
+    return false;
+  }
+  descriptor->events = events;
+  return true;
+}
+
+
+/*
+ * Orphan an entry once nothing refers to it.
+ */
+void EPoller::ReleaseIfUnused(epoll_descriptor_t *descriptor) {
+  if (descriptor->read_descriptor || descriptor->connected_descriptor ||
+      descriptor->write_descriptor || descriptor->internal)
+    return;
+
+  DescriptorMap::iterator iter = m_descriptors.find(descriptor->fd);
+  if (iter != m_descriptors.end() && iter->second == descriptor)
+    m_descriptors.erase(iter);
+  m_orphaned_descriptors.push_back(descriptor);
+}
+
+
+/*
+ * Called when a ConnectedDescriptor is closed, either by the remote end or
+ * locally without removing it first.
+ */
+void EPoller::HandleClosedDescriptor(epoll_descriptor_t *descriptor) {
+  ConnectedDescriptor *connected_descriptor = descriptor->connected_descriptor;
+  bool delete_on_close = descriptor->delete_on_close;
+
+  descriptor->connected_descriptor = NULL;
+  descriptor->read_histogram = NULL;
+  descriptor->delete_on_close = false;
+  m_connected_descriptors.erase(descriptor);
+  // don't leave a dangling write registration for a descriptor we're about
+  // to delete, or one that was closed.
+  if (descriptor->write_descriptor ==
+      static_cast<WriteFileDescriptor*>(connected_descriptor) &&
+      (delete_on_close || !connected_descriptor->ValidWriteDescriptor())) {
+    descriptor->write_descriptor = NULL;
+    descriptor->write_histogram = NULL;
+    if (m_export_map)
+      (*m_export_map->GetIntegerVar(
+          SelectServer::K_WRITE_DESCRIPTOR_VAR))--;
+  }
+  UpdateEvents(descriptor,
+               descriptor->write_descriptor ? WRITE_FLAGS : 0);
+  ReleaseIfUnused(descriptor);
+  if (m_export_map)
+    (*m_export_map->GetIntegerVar(
+        SelectServer::K_CONNECTED_DESCRIPTORS_VAR))--;
+
+  ConnectedDescriptor::OnCloseCallback *on_close =
+    connected_descriptor->TransferOnClose();
+  if (on_close)
+    on_close->Run();
+  if (delete_on_close)
+    delete connected_descriptor;
+}
+
+
+/*
+ * epoll only reports events from the kernel, and a descriptor that was closed
+ * locally, e.g. by a StreamRpcChannel on an error, never gets one. Check the
+ * connected descriptors each loop so they're cleaned up the same way the
+ * SelectPoller does.
+ */
+void EPoller::CheckConnectedDescriptors() {
+  std::vector<epoll_descriptor_t*> closed;
+  std::set<epoll_descriptor_t*>::iterator iter =
+    m_connected_descriptors.begin();
+  for (; iter != m_connected_descriptors.end(); ++iter) {
+    if (!(*iter)->connected_descriptor->ValidReadDescriptor())
+      closed.push_back(*iter);
+  }
+
+  // OnClose may remove other descriptors, so check each one is still here
+  std::vector<epoll_descriptor_t*>::iterator closed_iter = closed.begin();
+  for (; closed_iter != closed.end(); ++closed_iter) {
+    epoll_descriptor_t *descriptor = *closed_iter;
+    if (!m_connected_descriptors.count(descriptor) ||
+        descriptor->connected_descriptor->ValidReadDescriptor())
+      continue;
+    OLA_WARN << "Removed a disconnected descriptor from the select server";
+    // the kernel dropped the registration when the fd was closed
+    descriptor->events = 0;
+    HandleClosedDescriptor(descriptor);
+  }
+}
+
+
+void EPoller::FreeOrphanedDescriptors() {
+  std::vector<epoll_descriptor_t*>::iterator iter =
+    m_orphaned_descriptors.begin();
+  for (; iter != m_orphaned_descriptors.end(); ++iter)
+    delete *iter;
+  m_orphaned_descriptors.clear();
+}
+}  // network
+}  // ola
@@ -0,0 +1,117 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * EPoller.h
+ * A Poller which uses epoll()
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#ifndef COMMON_NETWORK_EPOLLER_H_
+#define COMMON_NETWORK_EPOLLER_H_
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "common/network/PollerInterface.h"
+#include "ola/Clock.h"
+#include "ola/ExportMap.h"
+#include "ola/network/Socket.h"
+
+namespace ola {
+namespace network {
+
+/*
+ * The epoll() based poller. Descriptors are registered with the kernel once,
+ * so the cost of each iteration depends on the number of ready descriptors
+ * rather than the number of registered ones, and there is no FD_SETSIZE
+ * limit. This is level triggered, so the read / write handlers behave exactly
+ * as they do with the SelectPoller.
+ */
+class EPoller : public PollerInterface {
+  public :
+    EPoller(ExportMap *export_map,
+            const Clock *clock,
+            ReadFileDescriptor *internal_descriptor);
+    ~EPoller();
+
+    bool AddReadDescriptor(ReadFileDescriptor *descriptor);
+    bool AddReadDescriptor(ConnectedDescriptor *descriptor,
+                           bool delete_on_close);
+    bool RemoveReadDescriptor(ReadFileDescriptor *descriptor);
+    bool RemoveReadDescriptor(ConnectedDescriptor *descriptor);
+
+    bool AddWriteDescriptor(WriteFileDescriptor *descriptor);
+    bool RemoveWriteDescriptor(WriteFileDescriptor *descriptor);
+
+    bool SetReadHistogram(ReadFileDescriptor *descriptor,
+                          HistogramVariable *histogram);
+    bool SetWriteHistogram(WriteFileDescriptor *descriptor,
+                           HistogramVariable *histogram);
+
+    bool Poll(const TimeInterval &poll_interval, TimeStamp *wake_up_time);
+    void UnregisterAll();
+
+  private :
+    /*
+     * epoll works on file descriptors, not our descriptor objects, so we keep
+     * one of these for each fd. The read & write sides may be different
+     * objects, e.g. a LoopbackDescriptor.
+     */
+    typedef struct {
+      int fd;
+      uint32_t events;
+      ReadFileDescriptor *read_descriptor;
+      ConnectedDescriptor *connected_descriptor;
+      WriteFileDescriptor *write_descriptor;
+      HistogramVariable *read_histogram;
+      HistogramVariable *write_histogram;
+      bool delete_on_close;
+      bool internal;
+    } epoll_descriptor_t;
+
+    typedef std::map<int, epoll_descriptor_t*> DescriptorMap;
+
+    ExportMap *m_export_map;
+    const Clock *m_clock;
+    int m_epoll_fd;
+    DescriptorMap m_descriptors;
+    // the entries with a ConnectedDescriptor, these are checked each loop in
+    // case the descriptor was closed locally, which epoll doesn't report.
+    std::set<epoll_descriptor_t*> m_connected_descriptors;
+    // descriptors removed while we were dispatching events, these are freed
+    // once all handlers have run.
+    std::vector<epoll_descriptor_t*> m_orphaned_descriptors;
+
+    epoll_descriptor_t *LookupOrCreate(int fd);
+    epoll_descriptor_t *FindByReadDescriptor(
+        const ReadFileDescriptor *descriptor);
+    epoll_descriptor_t *FindByWriteDescriptor(
+        const WriteFileDescriptor *descriptor);
+    bool UpdateEvents(epoll_descriptor_t *descriptor, uint32_t events);
+    void ReleaseIfUnused(epoll_descriptor_t *descriptor);
+    void CheckConnectedDescriptors();
+    void HandleClosedDescriptor(epoll_descriptor_t *descriptor);
+    void FreeOrphanedDescriptors();
+
+    static const unsigned int MAX_EVENTS = 64;
+
+    EPoller(const EPoller&);
+    EPoller operator=(const EPoller&);
+};
+}  // network
+}  // ola
+#endif  // COMMON_NETWORK_EPOLLER_H_
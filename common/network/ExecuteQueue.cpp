@@ -0,0 +1,195 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * ExecuteQueue.cpp
+ * The queue of closures passed to SelectServer::Execute().
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
+#include "common/network/ExecuteQueue.h"
+#include "ola/Logging.h"
+
+namespace ola {
+namespace network {
+
+
+ExecuteQueue::ExecuteQueue()
+    : m_wake_up_pending(0),
+      m_wake_ups(0) {
+#ifdef HAVE_SYS_EVENTFD_H
+  m_event_fd = INVALID_DESCRIPTOR;
+#endif
+  Node *node = new Node;
+  node->next = NULL;
+  node->closure = NULL;
+  m_head = node;
+  m_tail = node;
+}
+
+
+/*
+ * Closures that never ran are deleted.
+ */
+ExecuteQueue::~ExecuteQueue() {
+  ola::BaseCallback0<void> *closure;
+  while ((closure = Pop()))
+    delete closure;
+  delete m_tail;
+
+#ifdef HAVE_SYS_EVENTFD_H
+  if (m_event_fd != INVALID_DESCRIPTOR)
+    close(m_event_fd);
+#endif
+}
+
+
+/*
+ * Setup the wake up descriptor.
+ * @returns true if successful, false otherwise.
+ */
+bool ExecuteQueue::Init() {
+#ifdef HAVE_SYS_EVENTFD_H
+  if (m_event_fd != INVALID_DESCRIPTOR)
+    return false;
+
+  m_event_fd = eventfd(0, EFD_NONBLOCK);
+  if (m_event_fd < 0) {
+    OLA_WARN << "eventfd() failed, " << strerror(errno);
+    m_event_fd = INVALID_DESCRIPTOR;
+    return false;
+  }
+  return true;
+#else
+  return m_loopback.Init();
+#endif
+}
+
+
+int ExecuteQueue::ReadDescriptor() const {
+#ifdef HAVE_SYS_EVENTFD_H
+  return m_event_fd;
+#else
+  return m_loopback.ReadDescriptor();
+#endif
+}
+
+
+/*
+ * Called when the descriptor is readable, this runs everything in the queue.
+ */
+void ExecuteQueue::PerformRead() {
+  ClearWakeUp();
+  // Any Push() from here on will signal the descriptor again, so nothing can
+  // be left behind.
+  m_wake_up_pending = 0;
+  __sync_synchronize();
+  RunPending();
+}
+
+
+/*
+ * Add a closure to the queue, this can be called from any thread.
+ * @param closure the closure to run in the consumer's thread.
+ */
+void ExecuteQueue::Push(ola::BaseCallback0<void> *closure) {
+  Node *node = new Node;
+  node->next = NULL;
+  node->closure = closure;
+
+  // the node must be complete before it's visible to the consumer
+  __sync_synchronize();
+  Node *previous = __sync_lock_test_and_set(&m_head, node);
+  previous->next = node;
+
+  if (__sync_bool_compare_and_swap(&m_wake_up_pending, 0, 1))
+    SignalWakeUp();
+}
+
+
+/*
+ * Run all closures that have been linked into the queue.
+ * @returns the number of closures that were run.
+ */
+unsigned int ExecuteQueue::RunPending() {
+  unsigned int count = 0;
+  ola::BaseCallback0<void> *closure;
+  while ((closure = Pop())) {
+    closure->Run();
+    count++;
+  }
+  return count;
+}
+
+
+void ExecuteQueue::SignalWakeUp() {
+  __sync_fetch_and_add(&m_wake_ups, 1);
+#ifdef HAVE_SYS_EVENTFD_H
+  uint64_t value = 1;
+  if (write(m_event_fd, &value, sizeof(value)) != sizeof(value))
+    OLA_WARN << "Failed to signal eventfd: " << strerror(errno);
+#else
+  uint8_t wake_up = 'a';
+  m_loopback.Send(&wake_up, sizeof(wake_up));
+#endif
+}
+
+
+void ExecuteQueue::ClearWakeUp() {
+#ifdef HAVE_SYS_EVENTFD_H
+  uint64_t value;
+  if (read(m_event_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+    OLA_WARN << "Failed to read eventfd: " << strerror(errno);
+#else
+  while (m_loopback.DataRemaining()) {
+    uint8_t message;
+    unsigned int size;
+    m_loopback.Receive(&message, sizeof(message), size);
+  }
+#endif
+}
+
+
+/*
+ * Remove the oldest closure from the queue.
+ * @returns the closure or NULL if there are no more closures. A producer may
+ *   be part way through a Push(), in which case that closure, and any after
+ *   it, are returned once it completes.
+ */
+ola::BaseCallback0<void> *ExecuteQueue::Pop() {
+  Node *next = m_tail->next;
+  if (!next)
+    return NULL;
+  __sync_synchronize();
+
+  ola::BaseCallback0<void> *closure = next->closure;
+  next->closure = NULL;
+  delete m_tail;
+  m_tail = next;
+  return closure;
+}
+}  // network
+}  // ola
@@ -0,0 +1,90 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * ExecuteQueue.h
+ * The queue of closures passed to SelectServer::Execute().
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#ifndef COMMON_NETWORK_EXECUTEQUEUE_H_
+#define COMMON_NETWORK_EXECUTEQUEUE_H_
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "ola/Callback.h"
+#include "ola/network/Socket.h"
+
+namespace ola {
+namespace network {
+
+/*
+ * A multi-producer, single-consumer queue of closures. Any thread can call
+ * Push(), only the SelectServer thread may call PerformRead() or RunPending().
+ *
+ * Push() doesn't take a lock, the closure is linked onto the head of the list
+ * with an atomic exchange. The consumer is woken up by making the descriptor
+ * readable, this is an eventfd if the platform has one, otherwise a pipe. Only
+ * the first Push() after the consumer starts draining the queue signals the
+ * descriptor, so a burst of closures costs a single write() & a single wake
+ * up.
+ */
+class ExecuteQueue: public ReadFileDescriptor {
+  public:
+    ExecuteQueue();
+    ~ExecuteQueue();
+
+    bool Init();
+
+    int ReadDescriptor() const;
+    void PerformRead();
+
+    void Push(ola::BaseCallback0<void> *closure);
+    unsigned int RunPending();
+
+    // The number of times the descriptor has been signalled.
+    unsigned int WakeUps() const { return m_wake_ups; }
+
+  private:
+    struct Node {
+      Node *volatile next;
+      ola::BaseCallback0<void> *closure;
+    };
+
+    // producers swap this, the consumer never touches it
+    Node *volatile m_head;
+    // only used by the consumer. This always points to a node whose closure
+    // has already been taken (or the initial node).
+    Node *m_tail;
+    volatile int m_wake_up_pending;
+    volatile unsigned int m_wake_ups;
+
+#ifdef HAVE_SYS_EVENTFD_H
+    int m_event_fd;
+#else
+    LoopbackDescriptor m_loopback;
+#endif
+
+    void SignalWakeUp();
+    void ClearWakeUp();
+    ola::BaseCallback0<void> *Pop();
+
+    ExecuteQueue(const ExecuteQueue&);
+    ExecuteQueue& operator=(const ExecuteQueue&);
+};
+}  // network
+}  // ola
+#endif  // COMMON_NETWORK_EXECUTEQUEUE_H_
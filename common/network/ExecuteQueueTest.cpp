@@ -0,0 +1,206 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * ExecuteQueueTest.cpp
+ * Test fixture for the ExecuteQueue class
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <vector>
+
+#include "common/network/ExecuteQueue.h"
+#include "ola/Callback.h"
+#include "ola/Logging.h"
+#include "ola/network/SelectServer.h"
+#include "ola/thread/Thread.h"
+
+using ola::network::ExecuteQueue;
+using ola::network::SelectServer;
+using std::vector;
+
+
+/*
+ * A thread which pushes a sequence of closures onto the queue.
+ */
+class ProducerThread: public ola::thread::Thread {
+  public:
+    ProducerThread(ExecuteQueue *queue,
+                   class ExecuteQueueTest *test,
+                   unsigned int id,
+                   unsigned int count)
+        : m_queue(queue),
+          m_test(test),
+          m_id(id),
+          m_count(count) {
+    }
+
+    void *Run();
+
+  private:
+    ExecuteQueue *m_queue;
+    class ExecuteQueueTest *m_test;
+    unsigned int m_id;
+    unsigned int m_count;
+};
+
+
+class ExecuteQueueTest: public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(ExecuteQueueTest);
+  CPPUNIT_TEST(testOrdering);
+  CPPUNIT_TEST(testWakeUpCoalescing);
+  CPPUNIT_TEST(testManyProducers);
+  CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void setUp() {
+      m_received = 0;
+      m_out_of_order = 0;
+    }
+
+    void testOrdering();
+    void testWakeUpCoalescing();
+    void testManyProducers();
+
+    void Record(unsigned int producer, unsigned int sequence) {
+      if (m_next_sequence[producer] != sequence)
+        m_out_of_order++;
+      m_next_sequence[producer] = sequence + 1;
+      m_received++;
+      if (m_received == m_expected)
+        m_ss.Terminate();
+    }
+
+  private:
+    SelectServer m_ss;
+    vector<unsigned int> m_next_sequence;
+    unsigned int m_received;
+    unsigned int m_expected;
+    unsigned int m_out_of_order;
+
+    void PushClosure(ExecuteQueue *queue, unsigned int sequence) {
+      queue->Push(ola::NewSingleCallback(this, &ExecuteQueueTest::Record,
+                                         PRODUCER, sequence));
+    }
+
+    static const unsigned int PRODUCER = 0;
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ExecuteQueueTest);
+
+
+void *ProducerThread::Run() {
+  for (unsigned int i = 0; i < m_count; i++)
+    m_queue->Push(
+        ola::NewSingleCallback(m_test, &ExecuteQueueTest::Record, m_id, i));
+  return NULL;
+}
+
+
+/*
+ * Check closures are run in the order they were added.
+ */
+void ExecuteQueueTest::testOrdering() {
+  ExecuteQueue queue;
+  CPPUNIT_ASSERT(queue.Init());
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, queue.RunPending());
+
+  m_next_sequence.assign(1, 0);
+  m_expected = 0;
+  for (unsigned int i = 0; i < 10; i++)
+    PushClosure(&queue, i);
+
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, m_received);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 10, queue.RunPending());
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 10, m_received);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, m_out_of_order);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, queue.RunPending());
+
+  // closures that never run are cleaned up by the destructor
+  PushClosure(&queue, 10);
+}
+
+
+/*
+ * Check that a burst of closures only signals the descriptor once.
+ */
+void ExecuteQueueTest::testWakeUpCoalescing() {
+  ExecuteQueue queue;
+  CPPUNIT_ASSERT(queue.Init());
+  m_next_sequence.assign(1, 0);
+  m_expected = 0;
+
+  for (unsigned int i = 0; i < 100; i++)
+    PushClosure(&queue, i);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, queue.WakeUps());
+
+  queue.PerformRead();
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 100, m_received);
+
+  // the next closure needs a new wake up
+  PushClosure(&queue, 100);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 2, queue.WakeUps());
+  queue.PerformRead();
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 101, m_received);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, m_out_of_order);
+}
+
+
+/*
+ * Have many threads push closures while the SelectServer drains the queue.
+ * Every closure should run once, and closures from the same thread should run
+ * in order.
+ */
+void ExecuteQueueTest::testManyProducers() {
+  const unsigned int PRODUCERS = 16;
+  const unsigned int CLOSURES_PER_PRODUCER = 5000;
+
+  ExecuteQueue queue;
+  CPPUNIT_ASSERT(queue.Init());
+  CPPUNIT_ASSERT(m_ss.AddReadDescriptor(&queue));
+  m_next_sequence.assign(PRODUCERS, 0);
+  m_expected = PRODUCERS * CLOSURES_PER_PRODUCER;
+
+  vector<ProducerThread*> threads;
+  for (unsigned int i = 0; i < PRODUCERS; i++) {
+    ProducerThread *thread = new ProducerThread(&queue, this, i,
+                                                CLOSURES_PER_PRODUCER);
+    threads.push_back(thread);
+    thread->Start();
+  }
+
+  // in case something goes wrong
+  m_ss.RegisterSingleTimeout(
+      10000, ola::NewSingleCallback(&m_ss, &SelectServer::Terminate));
+  m_ss.Run();
+
+  vector<ProducerThread*>::iterator iter = threads.begin();
+  for (; iter != threads.end(); ++iter) {
+    (*iter)->Join();
+    delete *iter;
+  }
+  m_ss.RemoveReadDescriptor(&queue);
+
+  CPPUNIT_ASSERT_EQUAL(m_expected, m_received);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, m_out_of_order);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, queue.RunPending());
+  for (unsigned int i = 0; i < PRODUCERS; i++)
+    CPPUNIT_ASSERT_EQUAL(CLOSURES_PER_PRODUCER, m_next_sequence[i]);
+  // there is at most one wake up per closure, usually far fewer.
+  CPPUNIT_ASSERT(queue.WakeUps() <= m_expected);
+  OLA_INFO << m_expected << " closures needed " << queue.WakeUps() <<
+    " wake ups";
+}
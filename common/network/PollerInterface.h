@@ -0,0 +1,79 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * PollerInterface.h
+ * The interface for the classes that wait for descriptors to become ready.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#ifndef COMMON_NETWORK_POLLERINTERFACE_H_
+#define COMMON_NETWORK_POLLERINTERFACE_H_
+
+#include "ola/Clock.h"
+#include "ola/ExportMap.h"
+#include "ola/network/Socket.h"
+
+namespace ola {
+namespace network {
+
+/*
+ * A Poller keeps track of the registered descriptors, waits for them to
+ * become ready and then calls the appropriate methods. The SelectServer
+ * delegates all descriptor handling to a Poller, timeouts are still managed by
+ * the SelectServer.
+ *
+ * All Pollers update the same ExportMap variables as the SelectServer used to
+ * so the choice of poller isn't visible to the rest of the system.
+ */
+class PollerInterface {
+  public :
+    virtual ~PollerInterface() {}
+
+    virtual bool AddReadDescriptor(ReadFileDescriptor *descriptor) = 0;
+    virtual bool AddReadDescriptor(ConnectedDescriptor *descriptor,
+                                   bool delete_on_close) = 0;
+    virtual bool RemoveReadDescriptor(ReadFileDescriptor *descriptor) = 0;
+    virtual bool RemoveReadDescriptor(ConnectedDescriptor *descriptor) = 0;
+
+    virtual bool AddWriteDescriptor(WriteFileDescriptor *descriptor) = 0;
+    virtual bool RemoveWriteDescriptor(WriteFileDescriptor *descriptor) = 0;
+
+    /*
+     * Record how long the read or write handler for a registered descriptor
+     * takes to run. This is forgotten when the descriptor is removed.
+     * @returns false if the descriptor isn't registered.
+     */
+    virtual bool SetReadHistogram(ReadFileDescriptor *descriptor,
+                                  HistogramVariable *histogram) = 0;
+    virtual bool SetWriteHistogram(WriteFileDescriptor *descriptor,
+                                   HistogramVariable *histogram) = 0;
+
+    /*
+     * Wait for up to poll_interval for descriptors to become ready and then
+     * run the handlers. wake_up_time is updated before any handlers are run.
+     * @returns false if there was an error, true otherwise.
+     */
+    virtual bool Poll(const TimeInterval &poll_interval,
+                      TimeStamp *wake_up_time) = 0;
+
+    /*
+     * Delete any descriptors that were registered with delete_on_close and
+     * forget about everything else.
+     */
+    virtual void UnregisterAll() = 0;
+};
+}  // network
+}  // ola
+#endif  // COMMON_NETWORK_POLLERINTERFACE_H_
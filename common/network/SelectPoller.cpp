@@ -0,0 +1,444 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * SelectPoller.cpp
+ * A Poller which uses select()
+ * Copyright (C) 2005-2012 Simon Newton
+ */
+
+#ifdef WIN32
+#include <winsock2.h>
+#else
+#include <sys/select.h>
+#endif
+
+#include <string.h>
+#include <errno.h>
+
+#include <algorithm>
+#include <queue>
+#include <set>
+
+#include "common/network/CallbackTimer.h"
+#include "common/network/SelectPoller.h"
+#include "ola/Logging.h"
+#include "ola/network/SelectServer.h"
+#include "ola/network/Socket.h"
+
+namespace ola {
+namespace network {
+
+using std::max;
+
+
+/*
+ * Constructor
+ * @param export_map an ExportMap to update
+ * @param clock the Clock used to set the wake up time
+ * @param internal_descriptor a descriptor that is always polled for reads.
+ *   This isn't counted in the ExportMap and is never removed.
+ */
+SelectPoller::SelectPoller(ExportMap *export_map,
+                           const Clock *clock,
+                           ReadFileDescriptor *internal_descriptor)
+    : m_export_map(export_map),
+      m_clock(clock),
+      m_internal_descriptor(internal_descriptor) {
+  if (m_export_map)
+    m_export_map->GetIntegerVar(SelectServer::K_READ_DESCRIPTOR_VAR);
+}
+
+
+SelectPoller::~SelectPoller() {
+  UnregisterAll();
+}
+
+
+bool SelectPoller::AddReadDescriptor(ReadFileDescriptor *descriptor) {
+  if (!descriptor->ValidReadDescriptor()) {
+    OLA_WARN << "AddReadDescriptor called with invalid descriptor";
+    return false;
+  }
+
+  if (m_read_descriptors.find(descriptor) != m_read_descriptors.end())
+    return false;
+
+  m_read_descriptors.insert(descriptor);
+  if (m_export_map)
+    (*m_export_map->GetIntegerVar(SelectServer::K_READ_DESCRIPTOR_VAR))++;
+  return true;
+}
+
+
+bool SelectPoller::AddReadDescriptor(ConnectedDescriptor *descriptor,
+                                     bool delete_on_close) {
+  if (!descriptor->ValidReadDescriptor()) {
+    OLA_WARN << "AddReadDescriptor called with invalid descriptor";
+    return false;
+  }
+
+  ConnectedDescriptorSet::const_iterator iter =
+      m_connected_read_descriptors.begin();
+  for (; iter != m_connected_read_descriptors.end(); ++iter) {
+    if (iter->descriptor == descriptor)
+      return false;
+  }
+
+  connected_descriptor_t registered_descriptor;
+  registered_descriptor.descriptor = descriptor;
+  registered_descriptor.delete_on_close = delete_on_close;
+
+  m_connected_read_descriptors.insert(registered_descriptor);
+  if (m_export_map)
+    (*m_export_map->GetIntegerVar(
+        SelectServer::K_CONNECTED_DESCRIPTORS_VAR))++;
+  return true;
+}
+
+
+bool SelectPoller::RemoveReadDescriptor(ReadFileDescriptor *descriptor) {
+  if (!descriptor->ValidReadDescriptor())
+    OLA_WARN << "Removing a invalid file descriptor";
+
+  ReadDescriptorSet::iterator iter = m_read_descriptors.find(descriptor);
+  if (iter != m_read_descriptors.end()) {
+    m_read_descriptors.erase(iter);
+    m_read_histograms.erase(descriptor);
+    if (m_export_map)
+      (*m_export_map->GetIntegerVar(SelectServer::K_READ_DESCRIPTOR_VAR))--;
+    return true;
+  }
+  return false;
+}
+
+
+bool SelectPoller::RemoveReadDescriptor(ConnectedDescriptor *descriptor) {
+  if (!descriptor->ValidReadDescriptor())
+    OLA_WARN << "Removing a invalid file descriptor";
+
+  ConnectedDescriptorSet::iterator iter =
+      m_connected_read_descriptors.begin();
+  for (; iter != m_connected_read_descriptors.end(); ++iter) {
+    if (iter->descriptor == descriptor) {
+      m_connected_read_descriptors.erase(iter);
+      m_read_histograms.erase(descriptor);
+      if (m_export_map)
+        (*m_export_map->GetIntegerVar(
+            SelectServer::K_CONNECTED_DESCRIPTORS_VAR))--;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+bool SelectPoller::AddWriteDescriptor(WriteFileDescriptor *descriptor) {
+  if (!descriptor->ValidWriteDescriptor()) {
+    OLA_WARN << "AddWriteDescriptor called with invalid descriptor";
+    return false;
+  }
+
+  if (m_write_descriptors.find(descriptor) != m_write_descriptors.end())
+    return false;
+
+  m_write_descriptors.insert(descriptor);
+  if (m_export_map)
+    (*m_export_map->GetIntegerVar(SelectServer::K_WRITE_DESCRIPTOR_VAR))++;
+  return true;
+}
+
+
+bool SelectPoller::RemoveWriteDescriptor(WriteFileDescriptor *descriptor) {
+  if (!descriptor->ValidWriteDescriptor())
+    OLA_WARN << "Removing a closed descriptor";
+
+  WriteDescriptorSet::iterator iter = m_write_descriptors.find(descriptor);
+  if (iter != m_write_descriptors.end()) {
+    m_write_descriptors.erase(iter);
+    m_write_histograms.erase(descriptor);
+    if (m_export_map)
+      (*m_export_map->GetIntegerVar(SelectServer::K_WRITE_DESCRIPTOR_VAR))--;
+    return true;
+  }
+  return false;
+}
+
+
+/*
+ * Record how long the read handler for a descriptor takes.
+ */
+bool SelectPoller::SetReadHistogram(ReadFileDescriptor *descriptor,
+                                    HistogramVariable *histogram) {
+  bool registered =
+    m_read_descriptors.find(descriptor) != m_read_descriptors.end();
+  ConnectedDescriptorSet::const_iterator iter =
+      m_connected_read_descriptors.begin();
+  for (; !registered && iter != m_connected_read_descriptors.end(); ++iter)
+    registered = iter->descriptor == descriptor;
+
+  if (!registered)
+    return false;
+  if (histogram)
+    m_read_histograms[descriptor] = histogram;
+  else
+    m_read_histograms.erase(descriptor);
+  return true;
+}
+
+
+/*
+ * Record how long the write handler for a descriptor takes.
+ */
+bool SelectPoller::SetWriteHistogram(WriteFileDescriptor *descriptor,
+                                     HistogramVariable *histogram) {
+  if (m_write_descriptors.find(descriptor) == m_write_descriptors.end())
+    return false;
+  if (histogram)
+    m_write_histograms[descriptor] = histogram;
+  else
+    m_write_histograms.erase(descriptor);
+  return true;
+}
+
+
+/*
+ * One iteration of the select() loop.
+ * @return false on error, true on success.
+ */
+bool SelectPoller::Poll(const TimeInterval &poll_interval,
+                        TimeStamp *wake_up_time) {
+  int maxsd = 0;
+  fd_set r_fds, w_fds;
+  struct timeval tv;
+
+  FD_ZERO(&r_fds);
+  FD_ZERO(&w_fds);
+  AddDescriptorsToSet(&r_fds, &w_fds, &maxsd);
+
+  poll_interval.AsTimeval(&tv);
+  switch (select(maxsd + 1, &r_fds, &w_fds, NULL, &tv)) {
+    case 0:
+      // timeout
+      m_clock->CurrentTime(wake_up_time);
+      return true;
+    case -1:
+      if (errno == EINTR)
+        return true;
+      OLA_WARN << "select() error, " << strerror(errno);
+      return false;
+    default:
+      m_clock->CurrentTime(wake_up_time);
+      CheckDescriptors(&r_fds, &w_fds);
+  }
+  return true;
+}
+
+
+/*
+ * Remove all registrations.
+ */
+void SelectPoller::UnregisterAll() {
+  ConnectedDescriptorSet::iterator iter = m_connected_read_descriptors.begin();
+  for (; iter != m_connected_read_descriptors.end(); ++iter) {
+    if (iter->delete_on_close) {
+      delete iter->descriptor;
+    }
+  }
+  m_read_descriptors.clear();
+  m_connected_read_descriptors.clear();
+  m_write_descriptors.clear();
+  m_read_histograms.clear();
+  m_write_histograms.clear();
+}
+
+
+/*
+ * Add all the descriptors to the FD_SET
+ */
+void SelectPoller::AddDescriptorsToSet(fd_set *r_set,
+                                       fd_set *w_set,
+                                       int *max_sd) {
+  ReadDescriptorSet::iterator iter = m_read_descriptors.begin();
+  while (iter != m_read_descriptors.end()) {
+    ReadDescriptorSet::iterator this_iter = iter;
+    iter++;
+
+    if ((*this_iter)->ValidReadDescriptor()) {
+      *max_sd = max(*max_sd, (*this_iter)->ReadDescriptor());
+      FD_SET((*this_iter)->ReadDescriptor(), r_set);
+    } else {
+      // The descriptor was probably closed without removing it from the select
+      // server
+      if (m_export_map)
+        (*m_export_map->GetIntegerVar(SelectServer::K_READ_DESCRIPTOR_VAR))--;
+      m_read_histograms.erase(*this_iter);
+      m_read_descriptors.erase(this_iter);
+      OLA_WARN << "Removed a inactive descriptor from the select server";
+    }
+  }
+
+  ConnectedDescriptorSet::iterator con_iter =
+      m_connected_read_descriptors.begin();
+  while (con_iter != m_connected_read_descriptors.end()) {
+    ConnectedDescriptorSet::iterator this_iter = con_iter;
+    con_iter++;
+
+    if (this_iter->descriptor->ValidReadDescriptor()) {
+      *max_sd = max(*max_sd, this_iter->descriptor->ReadDescriptor());
+      FD_SET(this_iter->descriptor->ReadDescriptor(), r_set);
+    } else {
+      // The descriptor was closed without removing it from the select server
+      ConnectedDescriptor::OnCloseCallback *on_close =
+        this_iter->descriptor->TransferOnClose();
+      if (on_close)
+        on_close->Run();
+      m_read_histograms.erase(this_iter->descriptor);
+      if (this_iter->delete_on_close)
+        delete this_iter->descriptor;
+      if (m_export_map)
+        (*m_export_map->GetIntegerVar(
+            SelectServer::K_CONNECTED_DESCRIPTORS_VAR))--;
+      m_connected_read_descriptors.erase(this_iter);
+      OLA_WARN << "Removed a disconnected descriptor from the select server";
+    }
+  }
+
+  WriteDescriptorSet::iterator write_iter = m_write_descriptors.begin();
+  while (write_iter != m_write_descriptors.end()) {
+    WriteDescriptorSet::iterator this_iter = write_iter;
+    write_iter++;
+
+    if ((*this_iter)->ValidWriteDescriptor()) {
+      *max_sd = max(*max_sd, (*this_iter)->WriteDescriptor());
+      FD_SET((*this_iter)->WriteDescriptor(), w_set);
+    } else {
+      // The descriptor was probably closed without removing it from the select
+      // server
+      if (m_export_map)
+        (*m_export_map->GetIntegerVar(
+            SelectServer::K_WRITE_DESCRIPTOR_VAR))--;
+      m_write_histograms.erase(*this_iter);
+      m_write_descriptors.erase(this_iter);
+      OLA_WARN << "Removed a disconnected descriptor from the select server";
+    }
+  }
+
+  // finally add the internal descriptor
+  if (m_internal_descriptor && m_internal_descriptor->ValidReadDescriptor()) {
+    FD_SET(m_internal_descriptor->ReadDescriptor(), r_set);
+    *max_sd = max(*max_sd, m_internal_descriptor->ReadDescriptor());
+  }
+}
+
+
+/*
+ * Check all the registered descriptors:
+ *  - Execute the callback for descriptors with data
+ *  - Excute OnClose if a remote end closed the connection
+ */
+void SelectPoller::CheckDescriptors(fd_set *r_set, fd_set *w_set) {
+  // Because the callbacks can add or remove descriptors from the select
+  // server, we have to call them after we've used the iterators.
+  std::queue<ReadFileDescriptor*> read_ready_queue;
+  std::queue<WriteFileDescriptor*> write_ready_queue;
+  std::queue<connected_descriptor_t> closed_queue;
+
+  ReadDescriptorSet::iterator iter = m_read_descriptors.begin();
+  for (; iter != m_read_descriptors.end(); ++iter) {
+    if (FD_ISSET((*iter)->ReadDescriptor(), r_set))
+      read_ready_queue.push(*iter);
+  }
+
+  // check the read sockets
+  ConnectedDescriptorSet::iterator con_iter =
+      m_connected_read_descriptors.begin();
+  while (con_iter != m_connected_read_descriptors.end()) {
+    ConnectedDescriptorSet::iterator this_iter = con_iter;
+    con_iter++;
+    if (FD_ISSET(this_iter->descriptor->ReadDescriptor(), r_set)) {
+      if (this_iter->descriptor->IsClosed()) {
+        closed_queue.push(*this_iter);
+        m_read_histograms.erase(this_iter->descriptor);
+        m_connected_read_descriptors.erase(this_iter);
+      } else {
+        read_ready_queue.push(this_iter->descriptor);
+      }
+    }
+  }
+
+  // check the write sockets
+  WriteDescriptorSet::iterator write_iter = m_write_descriptors.begin();
+  for (; write_iter != m_write_descriptors.end(); write_iter++) {
+    if (FD_ISSET((*write_iter)->WriteDescriptor(), w_set))
+      write_ready_queue.push(*write_iter);
+  }
+
+  // deal with anything that needs an action
+  while (!read_ready_queue.empty()) {
+    ReadFileDescriptor *descriptor = read_ready_queue.front();
+    {
+      CallbackTimer timer(m_clock, ReadHistogram(descriptor));
+      descriptor->PerformRead();
+    }
+    read_ready_queue.pop();
+  }
+
+  while (!write_ready_queue.empty()) {
+    WriteFileDescriptor *descriptor = write_ready_queue.front();
+    {
+      CallbackTimer timer(m_clock, WriteHistogram(descriptor));
+      descriptor->PerformWrite();
+    }
+    write_ready_queue.pop();
+  }
+
+  while (!closed_queue.empty()) {
+    const connected_descriptor_t &connected_descriptor = closed_queue.front();
+    ConnectedDescriptor::OnCloseCallback *on_close =
+      connected_descriptor.descriptor->TransferOnClose();
+    if (on_close)
+      on_close->Run();
+    if (connected_descriptor.delete_on_close)
+      delete connected_descriptor.descriptor;
+    if (m_export_map)
+      (*m_export_map->GetIntegerVar(
+          SelectServer::K_CONNECTED_DESCRIPTORS_VAR))--;
+    closed_queue.pop();
+  }
+
+  if (m_internal_descriptor && m_internal_descriptor->ValidReadDescriptor() &&
+      FD_ISSET(m_internal_descriptor->ReadDescriptor(), r_set))
+    m_internal_descriptor->PerformRead();
+}
+
+
+HistogramVariable *SelectPoller::ReadHistogram(
+    const ReadFileDescriptor *descriptor) {
+  if (m_read_histograms.empty())
+    return NULL;
+  ReadHistogramMap::const_iterator iter = m_read_histograms.find(descriptor);
+  return iter == m_read_histograms.end() ? NULL : iter->second;
+}
+
+
+HistogramVariable *SelectPoller::WriteHistogram(
+    const WriteFileDescriptor *descriptor) {
+  if (m_write_histograms.empty())
+    return NULL;
+  WriteHistogramMap::const_iterator iter = m_write_histograms.find(descriptor);
+  return iter == m_write_histograms.end() ? NULL : iter->second;
+}
+}  // network
+}  // ola
@@ -0,0 +1,113 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * SelectPoller.h
+ * A Poller which uses select()
+ * Copyright (C) 2005-2012 Simon Newton
+ */
+
+#ifndef COMMON_NETWORK_SELECTPOLLER_H_
+#define COMMON_NETWORK_SELECTPOLLER_H_
+
+#ifdef WIN32
+#include <winsock2.h>
+#else
+#include <sys/select.h>
+#endif
+
+#include <map>
+#include <set>
+
+#include "common/network/PollerInterface.h"
+#include "ola/Clock.h"
+#include "ola/ExportMap.h"
+#include "ola/network/Socket.h"
+
+namespace ola {
+namespace network {
+
+/*
+ * The select() based poller. This rebuilds the fd_sets on each iteration so
+ * it's O(n) in the number of descriptors and limited to FD_SETSIZE, but it's
+ * available on every platform.
+ */
+class SelectPoller : public PollerInterface {
+  public :
+    SelectPoller(ExportMap *export_map,
+                 const Clock *clock,
+                 ReadFileDescriptor *internal_descriptor);
+    ~SelectPoller();
+
+    bool AddReadDescriptor(ReadFileDescriptor *descriptor);
+    bool AddReadDescriptor(ConnectedDescriptor *descriptor,
+                           bool delete_on_close);
+    bool RemoveReadDescriptor(ReadFileDescriptor *descriptor);
+    bool RemoveReadDescriptor(ConnectedDescriptor *descriptor);
+
+    bool AddWriteDescriptor(WriteFileDescriptor *descriptor);
+    bool RemoveWriteDescriptor(WriteFileDescriptor *descriptor);
+
+    bool SetReadHistogram(ReadFileDescriptor *descriptor,
+                          HistogramVariable *histogram);
+    bool SetWriteHistogram(WriteFileDescriptor *descriptor,
+                           HistogramVariable *histogram);
+
+    bool Poll(const TimeInterval &poll_interval, TimeStamp *wake_up_time);
+    void UnregisterAll();
+
+  private :
+    typedef struct {
+      ConnectedDescriptor *descriptor;
+      bool delete_on_close;
+    } connected_descriptor_t;
+
+    struct connected_descriptor_t_lt {
+      bool operator()(const connected_descriptor_t &c1,
+                      const connected_descriptor_t &c2) const {
+        return c1.descriptor->ReadDescriptor() <
+            c2.descriptor->ReadDescriptor();
+      }
+    };
+
+    typedef std::set<ReadFileDescriptor*> ReadDescriptorSet;
+    typedef std::set<WriteFileDescriptor*> WriteDescriptorSet;
+    typedef std::set<connected_descriptor_t, connected_descriptor_t_lt>
+      ConnectedDescriptorSet;
+    typedef std::map<const ReadFileDescriptor*, HistogramVariable*>
+      ReadHistogramMap;
+    typedef std::map<const WriteFileDescriptor*, HistogramVariable*>
+      WriteHistogramMap;
+
+    ExportMap *m_export_map;
+    const Clock *m_clock;
+    ReadFileDescriptor *m_internal_descriptor;
+    ReadDescriptorSet m_read_descriptors;
+    ConnectedDescriptorSet m_connected_read_descriptors;
+    WriteDescriptorSet m_write_descriptors;
+    // only descriptors with a histogram are in these
+    ReadHistogramMap m_read_histograms;
+    WriteHistogramMap m_write_histograms;
+
+    void CheckDescriptors(fd_set *r_set, fd_set *w_set);
+    HistogramVariable *ReadHistogram(const ReadFileDescriptor *descriptor);
+    HistogramVariable *WriteHistogram(const WriteFileDescriptor *descriptor);
+    void AddDescriptorsToSet(fd_set *r_set, fd_set *w_set, int *max_sd);
+
+    SelectPoller(const SelectPoller&);
+    SelectPoller operator=(const SelectPoller&);
+};
+}  // network
+}  // ola
+#endif  // COMMON_NETWORK_SELECTPOLLER_H_
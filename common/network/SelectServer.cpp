@@ -18,20 +18,24 @@
  * Copyright (C) 2005-2008 Simon Newton
  */
 
-#ifdef WIN32
-#include <winsock2.h>
-#else
-#include <sys/select.h>
+#if HAVE_CONFIG_H
+#  include <config.h>
 #endif
 
 #include <string.h>
 #include <errno.h>
 
 #include <algorithm>
-#include <queue>
 #include <set>
 #include <vector>
 
+#include "common/network/ExecuteQueue.h"
+#include "common/network/PollerInterface.h"
+#include "common/network/SelectPoller.h"
+#include "common/network/TimerWheel.h"
+#ifdef HAVE_EPOLL
+#include "common/network/EPoller.h"
+#endif
 #include "ola/Logging.h"
 #include "ola/network/SelectServer.h"
 #include "ola/network/Socket.h"
@@ -53,37 +57,39 @@ const char SelectServer::K_TIMER_VAR[] = "ss-timers";
 const char SelectServer::K_LOOP_TIME[] = "ss-loop-time";
 // iterations through the select server
 const char SelectServer::K_LOOP_COUNT[] = "ss-loop-count";
+// time spent in named callbacks, the name is appended
+const char SelectServer::K_CALLBACK_TIME_VAR_PREFIX[] = "ss-callback-time-";
 
 using ola::Callback0;
 using ola::ExportMap;
 using ola::thread::INVALID_TIMEOUT;
 using ola::thread::timeout_id;
-using std::max;
-
-
-
 
 
 /*
  * Constructor
  * @param export_map an ExportMap to update
- * @param wake_up_time a TimeStamp which is updated with the current wake up
- * time.
+ * @param clock the Clock to use, if NULL a new Clock is created.
+ * @param poller_type the mechanism used to wait for i/o.
  */
 SelectServer::SelectServer(ExportMap *export_map,
-                           Clock *clock)
+                           Clock *clock,
+                           PollerType poller_type)
     : m_terminate(false),
       m_is_running(false),
       m_poll_interval(POLL_INTERVAL_SECOND, POLL_INTERVAL_USECOND),
       m_export_map(export_map),
+      m_timer_count(NULL),
       m_loop_iterations(NULL),
       m_loop_time(NULL),
       m_clock(clock),
-      m_free_clock(false) {
+      m_free_clock(false),
+      m_incoming_queue(NULL),
+      m_poller(NULL),
+      m_timeouts(NULL) {
 
   if (m_export_map) {
-    m_export_map->GetIntegerVar(K_READ_DESCRIPTOR_VAR);
-    m_export_map->GetIntegerVar(K_TIMER_VAR);
+    m_timer_count = m_export_map->GetIntegerVar(K_TIMER_VAR);
     m_loop_time = m_export_map->GetCounterVar(K_LOOP_TIME);
     m_loop_iterations = m_export_map->GetCounterVar(K_LOOP_COUNT);
   }
@@ -92,12 +98,23 @@ SelectServer::SelectServer(ExportMap *export_map,
     m_clock = new Clock;
     m_free_clock = true;
   }
+  m_timeouts = new TimerWheel(m_clock);
 
   // TODO(simon): this should really be in an Init() method.
-  if (!m_incoming_descriptor.Init())
-    OLA_FATAL << "Failed to init LoopbackDescriptor, Execute() won't work!";
-  m_incoming_descriptor.SetOnData(
-      ola::NewCallback(this, &SelectServer::DrainAndExecute));
+  m_incoming_queue = new ExecuteQueue();
+  if (!m_incoming_queue->Init())
+    OLA_FATAL << "Failed to init ExecuteQueue, Execute() won't work!";
+
+#ifdef HAVE_EPOLL
+  if (poller_type == EPOLL_POLLER)
+    m_poller = new EPoller(m_export_map, m_clock, m_incoming_queue);
+#else
+  if (poller_type == EPOLL_POLLER)
+    OLA_WARN << "epoll() isn't available, falling back to select()";
+#endif
+
+  if (!m_poller)
+    m_poller = new SelectPoller(m_export_map, m_clock, m_incoming_queue);
 }
 
 
@@ -106,6 +123,9 @@ SelectServer::SelectServer(ExportMap *export_map,
  */
 SelectServer::~SelectServer() {
   UnregisterAll();
+  delete m_timeouts;
+  delete m_poller;
+  delete m_incoming_queue;
   if (m_free_clock)
     delete m_clock;
 }
@@ -166,18 +186,7 @@ void SelectServer::RunOnce(unsigned int delay_sec,
  * @return true on success, false on failure.
  */
 bool SelectServer::AddReadDescriptor(ReadFileDescriptor *descriptor) {
-  if (!descriptor->ValidReadDescriptor()) {
-    OLA_WARN << "AddReadDescriptor called with invalid descriptor";
-    return false;
-  }
-
-  if (m_read_descriptors.find(descriptor) != m_read_descriptors.end())
-    return false;
-
-  m_read_descriptors.insert(descriptor);
-  if (m_export_map)
-    (*m_export_map->GetIntegerVar(K_READ_DESCRIPTOR_VAR))++;
-  return true;
+  return m_poller->AddReadDescriptor(descriptor);
 }
 
 
@@ -192,26 +201,7 @@ bool SelectServer::AddReadDescriptor(ReadFileDescriptor *descriptor) {
  */
 bool SelectServer::AddReadDescriptor(ConnectedDescriptor *descriptor,
                                      bool delete_on_close) {
-  if (!descriptor->ValidReadDescriptor()) {
-    OLA_WARN << "AddReadDescriptor called with invalid descriptor";
-    return false;
-  }
-
-  ConnectedDescriptorSet::const_iterator iter =
-      m_connected_read_descriptors.begin();
-  for (; iter != m_connected_read_descriptors.end(); ++iter) {
-    if (iter->descriptor == descriptor)
-      return false;
-  }
-
-  connected_descriptor_t registered_descriptor;
-  registered_descriptor.descriptor = descriptor;
-  registered_descriptor.delete_on_close = delete_on_close;
-
-  m_connected_read_descriptors.insert(registered_descriptor);
-  if (m_export_map)
-    (*m_export_map->GetIntegerVar(K_CONNECTED_DESCRIPTORS_VAR))++;
-  return true;
+  return m_poller->AddReadDescriptor(descriptor, delete_on_close);
 }
 
 
@@ -221,17 +211,7 @@ bool SelectServer::AddReadDescriptor(ConnectedDescriptor *descriptor,
  * @return true if removed successfully, false otherwise
  */
 bool SelectServer::RemoveReadDescriptor(ReadFileDescriptor *descriptor) {
-  if (!descriptor->ValidReadDescriptor())
-    OLA_WARN << "Removing a invalid file descriptor";
-
-  ReadDescriptorSet::iterator iter = m_read_descriptors.find(descriptor);
-  if (iter != m_read_descriptors.end()) {
-    m_read_descriptors.erase(iter);
-    if (m_export_map)
-      (*m_export_map->GetIntegerVar(K_READ_DESCRIPTOR_VAR))--;
-    return true;
-  }
-  return false;
+  return m_poller->RemoveReadDescriptor(descriptor);
 }
 
 
@@ -241,20 +221,7 @@ bool SelectServer::RemoveReadDescriptor(ReadFileDescriptor *descriptor) {
  * @return true if removed successfully, false otherwise
  */
 bool SelectServer::RemoveReadDescriptor(ConnectedDescriptor *descriptor) {
-  if (!descriptor->ValidReadDescriptor())
-    OLA_WARN << "Removing a invalid file descriptor";
-
-  ConnectedDescriptorSet::iterator iter =
-      m_connected_read_descriptors.begin();
-  for (; iter != m_connected_read_descriptors.end(); ++iter) {
-    if (iter->descriptor == descriptor) {
-      m_connected_read_descriptors.erase(iter);
-      if (m_export_map)
-        (*m_export_map->GetIntegerVar(K_CONNECTED_DESCRIPTORS_VAR))--;
-      return true;
-    }
-  }
-  return false;
+  return m_poller->RemoveReadDescriptor(descriptor);
 }
 
 
@@ -265,18 +232,7 @@ bool SelectServer::RemoveReadDescriptor(ConnectedDescriptor *descriptor) {
  * @return true on success, false on failure.
  */
 bool SelectServer::AddWriteDescriptor(WriteFileDescriptor *descriptor) {
-  if (!descriptor->ValidWriteDescriptor()) {
-    OLA_WARN << "AddWriteDescriptor called with invalid descriptor";
-    return false;
-  }
-
-  if (m_write_descriptors.find(descriptor) != m_write_descriptors.end())
-    return false;
-
-  m_write_descriptors.insert(descriptor);
-  if (m_export_map)
-    (*m_export_map->GetIntegerVar(K_WRITE_DESCRIPTOR_VAR))++;
-  return true;
+  return m_poller->AddWriteDescriptor(descriptor);
 }
 
 
@@ -287,17 +243,7 @@ bool SelectServer::AddWriteDescriptor(WriteFileDescriptor *descriptor) {
  * @return true on success, false on failure.
  */
 bool SelectServer::RemoveWriteDescriptor(WriteFileDescriptor *descriptor) {
-  if (!descriptor->ValidWriteDescriptor())
-    OLA_WARN << "Removing a closed descriptor";
-
-  WriteDescriptorSet::iterator iter = m_write_descriptors.find(descriptor);
-  if (iter != m_write_descriptors.end()) {
-    m_write_descriptors.erase(iter);
-    if (m_export_map)
-      (*m_export_map->GetIntegerVar(K_WRITE_DESCRIPTOR_VAR))--;
-    return true;
-  }
-  return false;
+  return m_poller->RemoveWriteDescriptor(descriptor);
 }
 
 
@@ -316,12 +262,35 @@ timeout_id SelectServer::RegisterRepeatingTimeout(
   if (!closure)
     return INVALID_TIMEOUT;
 
-  if (m_export_map)
-    (*m_export_map->GetIntegerVar(K_TIMER_VAR))++;
+  return RegisterRepeatingTimeout(
+      TimeInterval(static_cast<int64_t>(ms) * ONE_THOUSAND),
+      closure,
+      ola::thread::FIXED_DELAY);
+}
+
+
+/*
+ * Register a repeating timeout function. Returning 0 from the closure will
+ * cancel this timeout.
+ * @param interval the delay between function calls
+ * @param closure the closure to call when the event triggers. Ownership is
+ * given up to the select server - make sure nothing else uses this closure.
+ * @param mode FIXED_RATE schedules each call relative to the previous
+ *   deadline, which avoids drift. FIXED_DELAY schedules it relative to when
+ *   the previous call ran.
+ * @returns the identifier for this timeout, this can be used to remove it
+ * later.
+ */
+timeout_id SelectServer::RegisterRepeatingTimeout(
+    const TimeInterval &interval,
+    ola::Callback0<bool> *closure,
+    ola::thread::TimerMode mode) {
+  if (!closure)
+    return INVALID_TIMEOUT;
 
-  Event *event = new RepeatingEvent(ms, m_clock, closure);
-  m_events.push(event);
-  return event;
+  timeout_id id = m_timeouts->AddRepeatingTimeout(interval, closure, mode);
+  UpdateTimerCount();
+  return id;
 }
 
 
@@ -338,12 +307,9 @@ timeout_id SelectServer::RegisterSingleTimeout(
   if (!closure)
     return INVALID_TIMEOUT;
 
-  if (m_export_map)
-    (*m_export_map->GetIntegerVar(K_TIMER_VAR))++;
-
-  Event *event = new SingleEvent(ms, m_clock, closure);
-  m_events.push(event);
-  return event;
+  timeout_id id = m_timeouts->AddSingleTimeout(ms, closure);
+  UpdateTimerCount();
+  return id;
 }
 
 
@@ -355,8 +321,48 @@ void SelectServer::RemoveTimeout(timeout_id id) {
   if (id == INVALID_TIMEOUT)
     return;
 
-  if (!m_removed_timeouts.insert(id).second)
-    OLA_WARN << "timeout " << id << " already in remove set";
+  if (m_timeouts->RemoveTimeout(id))
+    UpdateTimerCount();
+}
+
+
+/*
+ * Record how long a read descriptor's callback takes to run. The times are
+ * exported as a histogram named K_CALLBACK_TIME_VAR_PREFIX + name, so
+ * descriptors can share a name. This does nothing if there is no ExportMap.
+ * @param descriptor a descriptor that has been added with AddReadDescriptor()
+ * @param name the name to use, e.g. "e131-socket"
+ */
+void SelectServer::SetReadDescriptorName(ReadFileDescriptor *descriptor,
+                                         const string &name) {
+  HistogramVariable *histogram = CallbackHistogram(name);
+  if (histogram && !m_poller->SetReadHistogram(descriptor, histogram))
+    OLA_WARN << "Can't name " << name << ", it's not a read descriptor";
+}
+
+
+/*
+ * Record how long a write descriptor's callback takes to run.
+ * @param descriptor a descriptor that has been added with AddWriteDescriptor()
+ * @param name the name to use
+ */
+void SelectServer::SetWriteDescriptorName(WriteFileDescriptor *descriptor,
+                                          const string &name) {
+  HistogramVariable *histogram = CallbackHistogram(name);
+  if (histogram && !m_poller->SetWriteHistogram(descriptor, histogram))
+    OLA_WARN << "Can't name " << name << ", it's not a write descriptor";
+}
+
+
+/*
+ * Record how long a timeout's closure takes to run.
+ * @param id the timeout_id
+ * @param name the name to use
+ */
+void SelectServer::SetTimeoutName(timeout_id id, const string &name) {
+  HistogramVariable *histogram = CallbackHistogram(name);
+  if (histogram && !m_timeouts->SetHistogram(id, histogram))
+    OLA_WARN << "Can't name " << name << ", the timeout doesn't exist";
 }
 
 
@@ -377,17 +383,11 @@ void SelectServer::RunInLoop(Callback0<void> *closure) {
  * used to perform delayed deletion of objects.
  */
 void SelectServer::Execute(ola::BaseCallback0<void> *closure) {
-  {
-    ola::thread::MutexLocker locker(&m_incoming_mutex);
-    m_incoming_queue.push(closure);
-  }
-
-  // kick select(), we do this even if we're in the same thread as select() is
-  // called. If we don't do this there is a race condition because a callback
-  // may be added just prior to select(). Without this kick, select() will
-  // sleep for the poll_interval before executing the callback.
-  uint8_t wake_up = 'a';
-  m_incoming_descriptor.Send(&wake_up, sizeof(wake_up));
+  // This doesn't take a lock. The queue kicks select() even if we're in the
+  // same thread as select() is called, otherwise a callback added just prior
+  // to select() would wait for the poll_interval before executing. Only the
+  // first Execute() since the queue was last drained does this.
+  m_incoming_queue->Push(closure);
 }
 
 
@@ -396,27 +396,17 @@ void SelectServer::Execute(ola::BaseCallback0<void> *closure) {
  * @return false on error, true on success.
  */
 bool SelectServer::CheckForEvents(const TimeInterval &poll_interval) {
-  int maxsd;
-  fd_set r_fds, w_fds;
   TimeStamp now;
   TimeInterval sleep_interval = poll_interval;
-  struct timeval tv;
 
   LoopClosureSet::iterator loop_iter;
   for (loop_iter = m_loop_closures.begin(); loop_iter != m_loop_closures.end();
        ++loop_iter)
     (*loop_iter)->Run();
 
-  maxsd = 0;
-  FD_ZERO(&r_fds);
-  FD_ZERO(&w_fds);
   m_clock->CurrentTime(&now);
   now = CheckTimeouts(now);
 
-  // adding descriptors should be the last thing we do, they may have changed
-  // due to timeouts above.
-  AddDescriptorsToSet(&r_fds, &w_fds, &maxsd);
-
   if (m_wake_up_time.IsSet()) {
     TimeInterval loop_time = now - m_wake_up_time;
     OLA_DEBUG << "ss process time was " << loop_time.ToString();
@@ -426,8 +416,9 @@ bool SelectServer::CheckForEvents(const TimeInterval &poll_interval) {
       (*m_loop_iterations)++;
   }
 
-  if (!m_events.empty()) {
-    TimeInterval interval = m_events.top()->NextTime() - now;
+  TimeStamp next_timeout;
+  if (m_timeouts->NextTimeout(&next_timeout)) {
+    TimeInterval interval = next_timeout - now;
     sleep_interval = std::min(interval, sleep_interval);
   }
 
@@ -437,168 +428,13 @@ bool SelectServer::CheckForEvents(const TimeInterval &poll_interval) {
   if (m_terminate)
     sleep_interval = std::min(sleep_interval, TimeInterval(0, 1000));
 
-  sleep_interval.AsTimeval(&tv);
-  switch (select(maxsd + 1, &r_fds, &w_fds, NULL, &tv)) {
-    case 0:
-      // timeout
-      m_clock->CurrentTime(&m_wake_up_time);
-      return true;
-    case -1:
-      if (errno == EINTR)
-        return true;
-      OLA_WARN << "select() error, " << strerror(errno);
-      return false;
-    default:
-      m_clock->CurrentTime(&m_wake_up_time);
-      CheckDescriptors(&r_fds, &w_fds);
-      m_clock->CurrentTime(&m_wake_up_time);
-      CheckTimeouts(m_wake_up_time);
-  }
-  return true;
-}
-
-
-/*
- * Add all the descriptors to the FD_SET
- */
-void SelectServer::AddDescriptorsToSet(fd_set *r_set,
-                                       fd_set *w_set,
-                                       int *max_sd) {
-  ReadDescriptorSet::iterator iter = m_read_descriptors.begin();
-  while (iter != m_read_descriptors.end()) {
-    ReadDescriptorSet::iterator this_iter = iter;
-    iter++;
-
-    if ((*this_iter)->ValidReadDescriptor()) {
-      *max_sd = max(*max_sd, (*this_iter)->ReadDescriptor());
-      FD_SET((*this_iter)->ReadDescriptor(), r_set);
-    } else {
-      // The descriptor was probably closed without removing it from the select
-      // server
-      if (m_export_map)
-        (*m_export_map->GetIntegerVar(K_READ_DESCRIPTOR_VAR))--;
-      m_read_descriptors.erase(this_iter);
-      OLA_WARN << "Removed a inactive descriptor from the select server";
-    }
-  }
-
-  ConnectedDescriptorSet::iterator con_iter =
-      m_connected_read_descriptors.begin();
-  while (con_iter != m_connected_read_descriptors.end()) {
-    ConnectedDescriptorSet::iterator this_iter = con_iter;
-    con_iter++;
-
-    if (this_iter->descriptor->ValidReadDescriptor()) {
-      *max_sd = max(*max_sd, this_iter->descriptor->ReadDescriptor());
-      FD_SET(this_iter->descriptor->ReadDescriptor(), r_set);
-    } else {
-      // The descriptor was closed without removing it from the select server
-      ConnectedDescriptor::OnCloseCallback *on_close =
-        this_iter->descriptor->TransferOnClose();
-      if (on_close)
-        on_close->Run();
-      if (this_iter->delete_on_close)
-        delete this_iter->descriptor;
-      if (m_export_map)
-        (*m_export_map->GetIntegerVar(K_CONNECTED_DESCRIPTORS_VAR))--;
-      m_connected_read_descriptors.erase(this_iter);
-      OLA_WARN << "Removed a disconnected descriptor from the select server";
-    }
-  }
-
-  WriteDescriptorSet::iterator write_iter = m_write_descriptors.begin();
-  while (write_iter != m_write_descriptors.end()) {
-    WriteDescriptorSet::iterator this_iter = write_iter;
-    write_iter++;
-
-    if ((*this_iter)->ValidWriteDescriptor()) {
-      *max_sd = max(*max_sd, (*this_iter)->WriteDescriptor());
-      FD_SET((*this_iter)->WriteDescriptor(), w_set);
-    } else {
-      // The descriptor was probably closed without removing it from the select
-      // server
-      if (m_export_map)
-        (*m_export_map->GetIntegerVar(K_WRITE_DESCRIPTOR_VAR))--;
-      m_write_descriptors.erase(this_iter);
-      OLA_WARN << "Removed a disconnected descriptor from the select server";
-    }
-  }
-
-  // finally add the loopback descriptor
-  FD_SET(m_incoming_descriptor.ReadDescriptor(), r_set);
-  *max_sd = max(*max_sd, m_incoming_descriptor.ReadDescriptor());
-}
-
-
-/*
- * Check all the registered descriptors:
- *  - Execute the callback for descriptors with data
- *  - Excute OnClose if a remote end closed the connection
- */
-void SelectServer::CheckDescriptors(fd_set *r_set, fd_set *w_set) {
-  // Because the callbacks can add or remove descriptors from the select
-  // server, we have to call them after we've used the iterators.
-  std::queue<ReadFileDescriptor*> read_ready_queue;
-  std::queue<WriteFileDescriptor*> write_ready_queue;
-  std::queue<connected_descriptor_t> closed_queue;
-
-  ReadDescriptorSet::iterator iter = m_read_descriptors.begin();
-  for (; iter != m_read_descriptors.end(); ++iter) {
-    if (FD_ISSET((*iter)->ReadDescriptor(), r_set))
-      read_ready_queue.push(*iter);
-  }
-
-  // check the read sockets
-  ConnectedDescriptorSet::iterator con_iter =
-      m_connected_read_descriptors.begin();
-  while (con_iter != m_connected_read_descriptors.end()) {
-    ConnectedDescriptorSet::iterator this_iter = con_iter;
-    con_iter++;
-    if (FD_ISSET(this_iter->descriptor->ReadDescriptor(), r_set)) {
-      if (this_iter->descriptor->IsClosed()) {
-        closed_queue.push(*this_iter);
-        m_connected_read_descriptors.erase(this_iter);
-      } else {
-        read_ready_queue.push(this_iter->descriptor);
-      }
-    }
-  }
-
-  // check the write sockets
-  WriteDescriptorSet::iterator write_iter = m_write_descriptors.begin();
-  for (; write_iter != m_write_descriptors.end(); write_iter++) {
-    if (FD_ISSET((*write_iter)->WriteDescriptor(), w_set))
-      write_ready_queue.push(*write_iter);
-  }
-
-  // deal with anything that needs an action
-  while (!read_ready_queue.empty()) {
-    ReadFileDescriptor *descriptor = read_ready_queue.front();
-    descriptor->PerformRead();
-    read_ready_queue.pop();
-  }
-
-  while (!write_ready_queue.empty()) {
-    WriteFileDescriptor *descriptor = write_ready_queue.front();
-    descriptor->PerformWrite();
-    write_ready_queue.pop();
-  }
-
-  while (!closed_queue.empty()) {
-    const connected_descriptor_t &connected_descriptor = closed_queue.front();
-    ConnectedDescriptor::OnCloseCallback *on_close =
-      connected_descriptor.descriptor->TransferOnClose();
-    if (on_close)
-      on_close->Run();
-    if (connected_descriptor.delete_on_close)
-      delete connected_descriptor.descriptor;
-    if (m_export_map)
-      (*m_export_map->GetIntegerVar(K_CONNECTED_DESCRIPTORS_VAR))--;
-    closed_queue.pop();
-  }
+  // the poller updates m_wake_up_time before it runs any of the i/o handlers
+  if (!m_poller->Poll(sleep_interval, &m_wake_up_time))
+    return false;
 
-  if (FD_ISSET(m_incoming_descriptor.ReadDescriptor(), r_set))
-    DrainAndExecute();
+  m_clock->CurrentTime(&m_wake_up_time);
+  CheckTimeouts(m_wake_up_time);
+  return true;
 }
 
 
@@ -607,35 +443,8 @@ void SelectServer::CheckDescriptors(fd_set *r_set, fd_set *w_set) {
  * @returns a struct timeval of the time up to where we checked.
  */
 TimeStamp SelectServer::CheckTimeouts(const TimeStamp &current_time) {
-  TimeStamp now = current_time;
-
-  Event *e;
-  if (m_events.empty())
-    return now;
-
-  for (e = m_events.top(); !m_events.empty() && (e->NextTime() < now);
-       e = m_events.top()) {
-    m_events.pop();
-
-    // if this was removed, skip it
-    if (m_removed_timeouts.erase(e)) {
-      delete e;
-      if (m_export_map)
-        (*m_export_map->GetIntegerVar(K_TIMER_VAR))--;
-      continue;
-    }
-
-    if (e->Trigger()) {
-      // true implies we need to run this again
-      e->UpdateTime(now);
-      m_events.push(e);
-    } else {
-      delete e;
-      if (m_export_map)
-        (*m_export_map->GetIntegerVar(K_TIMER_VAR))--;
-    }
-    m_clock->CurrentTime(&now);
-  }
+  TimeStamp now = m_timeouts->RunExpired(current_time);
+  UpdateTimerCount();
   return now;
 }
 
@@ -644,21 +453,9 @@ TimeStamp SelectServer::CheckTimeouts(const TimeStamp &current_time) {
  * Remove all registrations.
  */
 void SelectServer::UnregisterAll() {
-  ConnectedDescriptorSet::iterator iter = m_connected_read_descriptors.begin();
-  for (; iter != m_connected_read_descriptors.end(); ++iter) {
-    if (iter->delete_on_close) {
-      delete iter->descriptor;
-    }
-  }
-  m_read_descriptors.clear();
-  m_connected_read_descriptors.clear();
-  m_write_descriptors.clear();
-  m_removed_timeouts.clear();
-
-  while (!m_events.empty()) {
-    delete m_events.top();
-    m_events.pop();
-  }
+  m_poller->UnregisterAll();
+  m_timeouts->Clear();
+  UpdateTimerCount();
 
   LoopClosureSet::iterator loop_iter;
   for (loop_iter = m_loop_closures.begin(); loop_iter != m_loop_closures.end();
@@ -668,25 +465,23 @@ void SelectServer::UnregisterAll() {
 }
 
 
-void SelectServer::DrainAndExecute() {
-  while (m_incoming_descriptor.DataRemaining()) {
-    uint8_t message;
-    unsigned int size;
-    m_incoming_descriptor.Receive(&message, sizeof(message), size);
-  }
+/*
+ * Get the histogram for a named callback.
+ * @returns the HistogramVariable or NULL if there is no ExportMap.
+ */
+HistogramVariable *SelectServer::CallbackHistogram(const string &name) {
+  if (!m_export_map)
+    return NULL;
+  return m_export_map->GetHistogramVar(K_CALLBACK_TIME_VAR_PREFIX + name);
+}
 
-  while (true) {
-    m_incoming_mutex.Lock();
-    if (m_incoming_queue.empty()) {
-      m_incoming_mutex.Unlock();
-      break;
-    }
 
-    ola::BaseCallback0<void> *callback = m_incoming_queue.front();
-    m_incoming_queue.pop();
-    m_incoming_mutex.Unlock();
-    callback->Run();
-  }
+/*
+ * Update the number of timers in the ExportMap.
+ */
+void SelectServer::UpdateTimerCount() {
+  if (m_timer_count)
+    m_timer_count->Set(m_timeouts->Size());
 }
 }  // network
 }  // ola
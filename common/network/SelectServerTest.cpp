@@ -14,12 +14,17 @@
  *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  *
  * SelectServerTest.cpp
- * Test fixture for the Socket classes
+ * Test fixture for the SelectServer, this is run against each of the pollers.
  * Copyright (C) 2005-2008 Simon Newton
  */
 
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
 #include <cppunit/extensions/HelperMacros.h>
 #include <sstream>
+#include <string>
 
 #include "ola/Callback.h"
 #include "ola/Clock.h"
@@ -29,24 +34,37 @@
 #include "ola/network/Socket.h"
 
 using ola::ExportMap;
+using ola::HistogramVariable;
 using ola::IntegerVariable;
+using ola::network::ConnectedDescriptor;
 using ola::network::LoopbackDescriptor;
 using ola::network::SelectServer;
 using ola::network::UdpSocket;
+using ola::network::UnixSocket;
+using std::string;
 
 class SelectServerTest: public CppUnit::TestFixture {
   CPPUNIT_TEST_SUITE(SelectServerTest);
   CPPUNIT_TEST(testAddRemoveReadDescriptor);
+  CPPUNIT_TEST(testRemoteEndClose);
+  CPPUNIT_TEST(testLocalClose);
+  CPPUNIT_TEST(testReadWriteDescriptor);
   CPPUNIT_TEST(testTimeout);
   CPPUNIT_TEST(testLoopCallbacks);
+  CPPUNIT_TEST(testCallbackHistograms);
   CPPUNIT_TEST_SUITE_END();
 
   public:
+    virtual ~SelectServerTest() {}
     void setUp();
     void tearDown();
     void testAddRemoveReadDescriptor();
+    void testRemoteEndClose();
+    void testLocalClose();
+    void testReadWriteDescriptor();
     void testTimeout();
     void testLoopCallbacks();
+    void testCallbackHistograms();
 
     void FatalTimeout() {
       CPPUNIT_ASSERT(false);
@@ -79,9 +97,41 @@ class SelectServerTest: public CppUnit::TestFixture {
 
     void IncrementLoopCounter() { m_loop_counter++; }
 
+    void ConnectionClosed() {
+      m_close_counter++;
+      m_ss->Terminate();
+    }
+
+    void CountClose() {
+      m_close_counter++;
+    }
+
+    void WriteReady(ConnectedDescriptor *descriptor) {
+      m_write_counter++;
+      m_ss->RemoveWriteDescriptor(descriptor);
+      uint8_t data = 'a';
+      descriptor->Send(&data, sizeof(data));
+    }
+
+    void ReadReady(ConnectedDescriptor *descriptor) {
+      uint8_t data;
+      unsigned int data_read;
+      descriptor->Receive(&data, sizeof(data), data_read);
+      m_read_counter++;
+      m_ss->Terminate();
+    }
+
+  protected:
+    virtual SelectServer::PollerType Poller() const {
+      return SelectServer::SELECT_POLLER;
+    }
+
   private:
     unsigned int m_timeout_counter;
     unsigned int m_loop_counter;
+    unsigned int m_close_counter;
+    unsigned int m_read_counter;
+    unsigned int m_write_counter;
     ExportMap *m_map;
     SelectServer *m_ss;
 };
@@ -90,12 +140,33 @@ class SelectServerTest: public CppUnit::TestFixture {
 CPPUNIT_TEST_SUITE_REGISTRATION(SelectServerTest);
 
 
+#ifdef HAVE_EPOLL
+/*
+ * Run the same tests with the epoll() poller.
+ */
+class EPollSelectServerTest: public SelectServerTest {
+  CPPUNIT_TEST_SUB_SUITE(EPollSelectServerTest, SelectServerTest);
+  CPPUNIT_TEST_SUITE_END();
+
+  protected:
+    SelectServer::PollerType Poller() const {
+      return SelectServer::EPOLL_POLLER;
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(EPollSelectServerTest);
+#endif
+
+
 void SelectServerTest::setUp() {
   ola::InitLogging(ola::OLA_LOG_INFO, ola::OLA_LOG_STDERR);
   m_map = new ExportMap();
-  m_ss = new SelectServer(m_map);
+  m_ss = new SelectServer(m_map, NULL, Poller());
   m_timeout_counter = 0;
   m_loop_counter = 0;
+  m_close_counter = 0;
+  m_read_counter = 0;
+  m_write_counter = 0;
 }
 
 
@@ -152,6 +223,115 @@ void SelectServerTest::testAddRemoveReadDescriptor() {
 }
 
 
+/*
+ * Check that OnClose is called, and the descriptor removed, when the remote
+ * end closes the connection.
+ */
+void SelectServerTest::testRemoteEndClose() {
+  IntegerVariable *connected_socket_count =
+    m_map->GetIntegerVar(SelectServer::K_CONNECTED_DESCRIPTORS_VAR);
+
+  UnixSocket socket;
+  CPPUNIT_ASSERT(socket.Init());
+  UnixSocket *other_end = socket.OppositeEnd();
+  socket.SetOnClose(
+      ola::NewSingleCallback(this, &SelectServerTest::ConnectionClosed));
+  CPPUNIT_ASSERT(m_ss->AddReadDescriptor(&socket));
+  CPPUNIT_ASSERT_EQUAL(1, connected_socket_count->Get());
+
+  m_ss->RegisterSingleTimeout(
+      1000,
+      ola::NewSingleCallback(this, &SelectServerTest::FatalTimeout));
+  other_end->Close();
+  m_ss->Run();
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, m_close_counter);
+  CPPUNIT_ASSERT_EQUAL(0, connected_socket_count->Get());
+  // it's already gone
+  CPPUNIT_ASSERT(!m_ss->RemoveReadDescriptor(&socket));
+  delete other_end;
+}
+
+
+/*
+ * Check that OnClose is called, and the descriptor removed & deleted, when
+ * the descriptor is closed locally without removing it first.
+ */
+void SelectServerTest::testLocalClose() {
+  IntegerVariable *connected_socket_count =
+    m_map->GetIntegerVar(SelectServer::K_CONNECTED_DESCRIPTORS_VAR);
+
+  UnixSocket *socket = new UnixSocket();
+  CPPUNIT_ASSERT(socket->Init());
+  UnixSocket *other_end = socket->OppositeEnd();
+  socket->SetOnClose(
+      ola::NewSingleCallback(this, &SelectServerTest::ConnectionClosed));
+  CPPUNIT_ASSERT(m_ss->AddReadDescriptor(socket, true));
+  CPPUNIT_ASSERT_EQUAL(1, connected_socket_count->Get());
+
+  m_ss->RegisterSingleTimeout(
+      1000,
+      ola::NewSingleCallback(this, &SelectServerTest::FatalTimeout));
+  // the select server deletes the socket
+  socket->Close();
+  m_ss->Run();
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, m_close_counter);
+  CPPUNIT_ASSERT_EQUAL(0, connected_socket_count->Get());
+  delete other_end;
+
+  // if the fd is reused before the next loop, the old descriptor is still
+  // closed.
+  socket = new UnixSocket();
+  CPPUNIT_ASSERT(socket->Init());
+  other_end = socket->OppositeEnd();
+  socket->SetOnClose(
+      ola::NewSingleCallback(this, &SelectServerTest::CountClose));
+  CPPUNIT_ASSERT(m_ss->AddReadDescriptor(socket, true));
+  socket->Close();
+  delete other_end;
+
+  UnixSocket new_socket;
+  CPPUNIT_ASSERT(new_socket.Init());
+  UnixSocket *new_other_end = new_socket.OppositeEnd();
+  CPPUNIT_ASSERT(m_ss->AddReadDescriptor(&new_socket));
+  m_ss->RunOnce(0, 0);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 2, m_close_counter);
+  CPPUNIT_ASSERT_EQUAL(1, connected_socket_count->Get());
+  CPPUNIT_ASSERT(m_ss->RemoveReadDescriptor(&new_socket));
+  CPPUNIT_ASSERT_EQUAL(0, connected_socket_count->Get());
+  delete new_other_end;
+}
+
+
+/*
+ * Check that a descriptor can be registered for both reads and writes.
+ */
+void SelectServerTest::testReadWriteDescriptor() {
+  IntegerVariable *write_count =
+    m_map->GetIntegerVar(SelectServer::K_WRITE_DESCRIPTOR_VAR);
+
+  LoopbackDescriptor loopback;
+  CPPUNIT_ASSERT(loopback.Init());
+  ConnectedDescriptor *descriptor = &loopback;
+  loopback.SetOnData(
+      ola::NewCallback(this, &SelectServerTest::ReadReady, descriptor));
+  loopback.SetOnWritable(
+      ola::NewCallback(this, &SelectServerTest::WriteReady, descriptor));
+  CPPUNIT_ASSERT(m_ss->AddReadDescriptor(&loopback));
+  CPPUNIT_ASSERT(m_ss->AddWriteDescriptor(&loopback));
+  CPPUNIT_ASSERT(!m_ss->AddWriteDescriptor(&loopback));
+  CPPUNIT_ASSERT_EQUAL(1, write_count->Get());
+
+  m_ss->RegisterSingleTimeout(
+      1000,
+      ola::NewSingleCallback(this, &SelectServerTest::FatalTimeout));
+  m_ss->Run();
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, m_write_counter);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, m_read_counter);
+  CPPUNIT_ASSERT_EQUAL(0, write_count->Get());
+  CPPUNIT_ASSERT(m_ss->RemoveReadDescriptor(&loopback));
+}
+
+
 /*
  * Timeout tests
  */
@@ -221,3 +401,60 @@ void SelectServerTest::testLoopCallbacks() {
   // we should have at least 5 calls to IncrementLoopCounter
   CPPUNIT_ASSERT(m_loop_counter >= 5);
 }
+
+
+/*
+ * Check that named callbacks are timed.
+ */
+void SelectServerTest::testCallbackHistograms() {
+  const string prefix = SelectServer::K_CALLBACK_TIME_VAR_PREFIX;
+  LoopbackDescriptor loopback;
+  CPPUNIT_ASSERT(loopback.Init());
+  ConnectedDescriptor *descriptor = &loopback;
+  loopback.SetOnData(
+      ola::NewCallback(this, &SelectServerTest::ReadReady, descriptor));
+  loopback.SetOnWritable(
+      ola::NewCallback(this, &SelectServerTest::WriteReady, descriptor));
+  CPPUNIT_ASSERT(m_ss->AddReadDescriptor(&loopback));
+  CPPUNIT_ASSERT(m_ss->AddWriteDescriptor(&loopback));
+  m_ss->SetReadDescriptorName(&loopback, "loopback-read");
+  m_ss->SetWriteDescriptorName(&loopback, "loopback-write");
+
+  m_ss->RegisterSingleTimeout(
+      1000,
+      ola::NewSingleCallback(this, &SelectServerTest::FatalTimeout));
+  m_ss->Run();
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, m_read_counter);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, m_write_counter);
+
+  HistogramVariable *read_histogram =
+    m_map->GetHistogramVar(prefix + "loopback-read");
+  HistogramVariable *write_histogram =
+    m_map->GetHistogramVar(prefix + "loopback-write");
+  CPPUNIT_ASSERT_EQUAL((uint64_t) 1, read_histogram->Count());
+  CPPUNIT_ASSERT_EQUAL((uint64_t) 1, write_histogram->Count());
+
+  // now a timeout
+  ola::network::timeout_id timeout = m_ss->RegisterSingleTimeout(
+      10,
+      ola::NewSingleCallback(this, &SelectServerTest::SingleIncrementTimeout));
+  m_ss->SetTimeoutName(timeout, "increment");
+  m_ss->RegisterSingleTimeout(
+      20,
+      ola::NewSingleCallback(this, &SelectServerTest::TerminateTimeout));
+  m_ss->Run();
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, m_timeout_counter);
+  HistogramVariable *timeout_histogram =
+    m_map->GetHistogramVar(prefix + "increment");
+  CPPUNIT_ASSERT_EQUAL((uint64_t) 1, timeout_histogram->Count());
+
+  // once the descriptor is removed it's no longer timed
+  CPPUNIT_ASSERT(m_ss->RemoveReadDescriptor(&loopback));
+  CPPUNIT_ASSERT(m_ss->AddReadDescriptor(&loopback));
+  uint8_t data = 'a';
+  loopback.Send(&data, sizeof(data));
+  m_ss->Run();
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 2, m_read_counter);
+  CPPUNIT_ASSERT_EQUAL((uint64_t) 1, read_histogram->Count());
+  CPPUNIT_ASSERT(m_ss->RemoveReadDescriptor(&loopback));
+}
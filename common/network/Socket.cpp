@@ -37,6 +37,7 @@
 #endif
 
 #include <string>
+#include <vector>
 
 #include "ola/Logging.h"
 #include "ola/network/Socket.h"
@@ -500,6 +501,171 @@ bool DeviceDescriptor::Close() {
 }
 
 
+// DatagramBatch
+// ------------------------------------------------
+
+#ifdef HAVE_RECVMMSG
+/*
+ * The headers passed to recvmmsg(). These are setup once when the batch is
+ * created.
+ */
+struct DatagramBatch::MessageHeaders {
+  std::vector<struct mmsghdr> messages;
+  std::vector<struct iovec> iovecs;
+  std::vector<struct sockaddr_in> addresses;
+};
+#else
+struct DatagramBatch::MessageHeaders {};
+#endif
+
+
+/*
+ * Create a new batch
+ * @param capacity the maximum number of datagrams to read at once
+ * @param max_size the size of the largest datagram
+ */
+DatagramBatch::DatagramBatch(unsigned int capacity, unsigned int max_size)
+    : m_capacity(capacity ? capacity : 1),
+      m_max_size(max_size),
+      m_size(0),
+      m_datagrams(m_capacity),
+      m_headers(NULL) {
+  // keep each buffer aligned so the datagrams can be cast to packet structs
+  m_stride = (m_max_size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+  m_buffers = new uint8_t[m_capacity * m_stride];
+
+#ifdef HAVE_RECVMMSG
+  m_headers = new MessageHeaders;
+  m_headers->messages.resize(m_capacity);
+  m_headers->iovecs.resize(m_capacity);
+  m_headers->addresses.resize(m_capacity);
+  for (unsigned int i = 0; i < m_capacity; i++) {
+    m_headers->iovecs[i].iov_base = Slot(i);
+    m_headers->iovecs[i].iov_len = m_max_size;
+    struct msghdr *header = &m_headers->messages[i].msg_hdr;
+    memset(header, 0, sizeof(*header));
+    header->msg_name = &m_headers->addresses[i];
+    header->msg_namelen = sizeof(m_headers->addresses[i]);
+    header->msg_iov = &m_headers->iovecs[i];
+    header->msg_iovlen = 1;
+  }
+#endif
+}
+
+
+DatagramBatch::~DatagramBatch() {
+  delete[] m_buffers;
+  delete m_headers;
+}
+
+
+/*
+ * Record a datagram that was read into Buffer(Size()).
+ */
+void DatagramBatch::Append(unsigned int length,
+                           const IPV4Address &source,
+                           uint16_t port) {
+  if (m_size == m_capacity)
+    return;
+  datagram_info &info = m_datagrams[m_size++];
+  info.length = length;
+  info.source = source;
+  info.port = port;
+}
+
+
+// DatagramSendQueue
+// ------------------------------------------------
+
+#ifdef HAVE_SENDMMSG
+/*
+ * The headers passed to sendmmsg(). These are filled in when the queue is
+ * sent since the data may have moved as datagrams were added.
+ */
+struct DatagramSendQueue::MessageHeaders {
+  std::vector<struct mmsghdr> messages;
+  std::vector<struct iovec> iovecs;
+  std::vector<struct sockaddr_in> addresses;
+};
+#else
+struct DatagramSendQueue::MessageHeaders {};
+#endif
+
+
+/*
+ * Create a new send queue.
+ * @param capacity the maximum number of datagrams that can be queued.
+ */
+DatagramSendQueue::DatagramSendQueue(unsigned int capacity)
+    : m_capacity(capacity ? capacity : 1),
+      m_send_calls(0),
+      m_headers(NULL) {
+  m_datagrams.reserve(m_capacity);
+#ifdef HAVE_SENDMMSG
+  m_headers = new MessageHeaders;
+#endif
+}
+
+
+DatagramSendQueue::~DatagramSendQueue() {
+  delete m_headers;
+}
+
+
+/*
+ * Copy a datagram into the queue.
+ * @param data the datagram
+ * @param length the length of the datagram
+ * @param destination the address to send to
+ * @param port the port to send to, in host byte order
+ * @returns false if the queue is full.
+ */
+bool DatagramSendQueue::Add(const uint8_t *data,
+                            unsigned int length,
+                            const IPV4Address &destination,
+                            uint16_t port) {
+  if (IsFull())
+    return false;
+
+  datagram_info info;
+  info.offset = m_data.size();
+  info.length = length;
+  info.destination = destination;
+  info.port = port;
+  m_data.insert(m_data.end(), data, data + length);
+  m_datagrams.push_back(info);
+  return true;
+}
+
+
+/*
+ * Send the last datagram to another destination.
+ * @param destination the address to send to
+ * @param port the port to send to, in host byte order
+ * @returns false if the queue is full or empty.
+ */
+bool DatagramSendQueue::AddDestination(const IPV4Address &destination,
+                                       uint16_t port) {
+  if (IsFull() || Empty())
+    return false;
+
+  datagram_info info = m_datagrams.back();
+  info.destination = destination;
+  info.port = port;
+  m_datagrams.push_back(info);
+  return true;
+}
+
+
+/*
+ * Remove all datagrams from the queue. The storage is kept for next time.
+ */
+void DatagramSendQueue::Clear() {
+  m_data.clear();
+  m_datagrams.clear();
+}
+
+
 // UdpSocket
 // ------------------------------------------------
 
@@ -639,6 +805,99 @@ ssize_t UdpSocket::SendTo(const uint8_t *buffer,
 }
 
 
+/*
+ * Send all the datagrams in a queue. This uses sendmmsg() where it's
+ * available, otherwise it calls sendto() for each datagram. A datagram that
+ * can't be sent is skipped, and a single warning is logged for the batch. The
+ * queue is empty afterwards.
+ * @param queue the DatagramSendQueue to send
+ * @return the number of datagrams that were sent.
+ */
+unsigned int UdpSocket::SendBatch(DatagramSendQueue *queue) const {
+  unsigned int sent = 0;
+  unsigned int failed = 0;
+  unsigned int calls = 0;
+  unsigned int i = 0;
+  int error = 0;
+
+#ifdef HAVE_SENDMMSG
+  DatagramSendQueue::MessageHeaders *headers = queue->m_headers;
+  const unsigned int count = queue->Size();
+  headers->messages.resize(count);
+  headers->iovecs.resize(count);
+  headers->addresses.resize(count);
+  for (unsigned int j = 0; j < count; j++) {
+    struct iovec &iov = headers->iovecs[j];
+    iov.iov_base = const_cast<uint8_t*>(queue->Data(j));
+    iov.iov_len = queue->Length(j);
+
+    struct sockaddr_in &address = headers->addresses[j];
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = HostToNetwork(queue->Port(j));
+    address.sin_addr = queue->Destination(j).Address();
+
+    struct msghdr *header = &headers->messages[j].msg_hdr;
+    memset(header, 0, sizeof(*header));
+    header->msg_name = &address;
+    header->msg_namelen = sizeof(address);
+    header->msg_iov = &iov;
+    header->msg_iovlen = 1;
+  }
+
+  while (i < count) {
+    int result = sendmmsg(m_fd, &headers->messages[i], count - i, 0);
+    calls++;
+    if (result < 0) {
+      if (errno == ENOSYS) {
+        // the kernel doesn't support sendmmsg, fall back to sendto()
+        break;
+      }
+      // skip this datagram
+      failed++;
+      error = errno;
+      i++;
+    } else {
+      sent += result;
+      i += result;
+    }
+  }
+#endif
+
+  for (; i < queue->Size(); i++) {
+    struct sockaddr_in destination;
+    memset(&destination, 0, sizeof(destination));
+    destination.sin_family = AF_INET;
+    destination.sin_port = HostToNetwork(queue->Port(i));
+    destination.sin_addr = queue->Destination(i).Address();
+    calls++;
+    ssize_t bytes_sent = sendto(
+      m_fd,
+      reinterpret_cast<const char*>(queue->Data(i)),
+      queue->Length(i),
+      0,
+      reinterpret_cast<const struct sockaddr*>(&destination),
+      sizeof(struct sockaddr));
+    if (bytes_sent == static_cast<ssize_t>(queue->Length(i))) {
+      sent++;
+    } else {
+      failed++;
+      if (bytes_sent < 0)
+        error = errno;
+    }
+  }
+
+  // one line per batch, otherwise a down interface floods the log
+  if (failed) {
+    OLA_WARN << "Failed to send " << failed << " of " << queue->Size() <<
+      " datagrams" << (error ? ", " : "") << (error ? strerror(error) : "");
+  }
+  queue->SetSendCalls(calls);
+  queue->Clear();
+  return sent;
+}
+
+
 /*
  * Receive data
  * @param buffer the buffer to store the data
@@ -696,6 +955,79 @@ bool UdpSocket::RecvFrom(uint8_t *buffer,
 }
 
 
+/*
+ * Read as many datagrams as are waiting, up to the capacity of the batch.
+ * This uses a single recvmmsg() call where it's available, otherwise it calls
+ * recvfrom() until the socket would block. This should be called when the
+ * socket is readable.
+ * @param batch the DatagramBatch to fill, any existing datagrams are removed.
+ * @return true if it worked, false if the first read failed. It's possible for
+ * the batch to be empty if another reader took the data.
+ */
+bool UdpSocket::RecvBatch(DatagramBatch *batch) const {
+  batch->Clear();
+
+#ifdef HAVE_RECVMMSG
+  DatagramBatch::MessageHeaders *headers = batch->m_headers;
+  for (unsigned int i = 0; i < batch->Capacity(); i++)
+    headers->messages[i].msg_hdr.msg_namelen =
+      sizeof(headers->addresses[i]);
+
+  int count = recvmmsg(m_fd, &headers->messages[0], batch->Capacity(),
+                       MSG_DONTWAIT, NULL);
+  if (count >= 0) {
+    for (int i = 0; i < count; i++) {
+      const struct sockaddr_in &source = headers->addresses[i];
+      batch->Append(headers->messages[i].msg_len,
+                    IPV4Address(source.sin_addr),
+                    NetworkToHost(source.sin_port));
+    }
+    return true;
+  }
+  if (errno == EAGAIN || errno == EWOULDBLOCK)
+    return true;
+  if (errno != ENOSYS) {
+    OLA_WARN << "recvmmsg failed: " << strerror(errno);
+    return false;
+  }
+  // the kernel doesn't support recvmmsg, fall back to recvfrom()
+#endif
+
+  // Without MSG_DONTWAIT the second read could block, so only read one
+  // datagram.
+#ifdef MSG_DONTWAIT
+  const int flags = MSG_DONTWAIT;
+  const unsigned int limit = batch->Capacity();
+#else
+  const int flags = 0;
+  const unsigned int limit = 1;
+#endif
+
+  for (unsigned int i = 0; i < limit; i++) {
+    struct sockaddr_in source;
+    socklen_t source_size = sizeof(source);
+    ssize_t size = recvfrom(
+      m_fd,
+      reinterpret_cast<char*>(batch->Buffer(i)),
+      batch->MaxSize(),
+      flags,
+      reinterpret_cast<struct sockaddr*>(&source),
+      &source_size);
+
+    if (size < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      OLA_WARN << "recvfrom failed: " << strerror(errno);
+      return i != 0;
+    }
+    batch->Append(static_cast<unsigned int>(size),
+                  IPV4Address(source.sin_addr),
+                  NetworkToHost(source.sin_port));
+  }
+  return true;
+}
+
+
 /*
  * Enable broadcasting for this socket.
  * @return true if it worked, false otherwise
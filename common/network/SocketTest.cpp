@@ -18,6 +18,10 @@
  * Copyright (C) 2005-2008 Simon Newton
  */
 
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
 #include <cppunit/extensions/HelperMacros.h>
 #include <stdint.h>
 #include <string.h>
@@ -33,6 +37,8 @@
 using std::string;
 using ola::network::AcceptingSocket;
 using ola::network::ConnectedDescriptor;
+using ola::network::DatagramBatch;
+using ola::network::DatagramSendQueue;
 using ola::network::IPV4Address;
 using ola::network::LoopbackDescriptor;
 using ola::network::PipeDescriptor;
@@ -46,6 +52,7 @@ using ola::network::UdpSocket;
 static const unsigned char test_cstring[] = "Foo";
 // used to set a timeout which aborts the tests
 static const int ABORT_TIMEOUT_IN_MS = 1000;
+static const uint8_t DATAGRAMS_TO_SEND = 5;
 
 class SocketTest: public CppUnit::TestFixture {
   CPPUNIT_TEST_SUITE(SocketTest);
@@ -58,9 +65,12 @@ class SocketTest: public CppUnit::TestFixture {
   CPPUNIT_TEST(testTcpSocketClientClose);
   CPPUNIT_TEST(testTcpSocketServerClose);
   CPPUNIT_TEST(testUdpSocket);
+  CPPUNIT_TEST(testUdpRecvBatch);
+  CPPUNIT_TEST(testUdpSendBatch);
   CPPUNIT_TEST_SUITE_END();
 
   public:
+    virtual ~SocketTest() {}
     void setUp();
     void tearDown();
     void testLoopbackDescriptor();
@@ -71,6 +81,8 @@ class SocketTest: public CppUnit::TestFixture {
     void testTcpSocketClientClose();
     void testTcpSocketServerClose();
     void testUdpSocket();
+    void testUdpRecvBatch();
+    void testUdpSendBatch();
 
     // timing out indicates something went wrong
     void Timeout() {
@@ -88,16 +100,24 @@ class SocketTest: public CppUnit::TestFixture {
     void NewConnectionSendAndClose(ConnectedDescriptor *socket);
     void UdpReceiveAndTerminate(UdpSocket *socket);
     void UdpReceiveAndSend(UdpSocket *socket);
+    void UdpReceiveBatch(UdpSocket *socket, DatagramBatch *batch);
 
     // Socket close actions
     void TerminateOnClose() {
       m_ss->Terminate();
     }
 
+  protected:
+    virtual SelectServer::PollerType Poller() const {
+      return SelectServer::SELECT_POLLER;
+    }
+
   private:
     SelectServer *m_ss;
     AcceptingSocket *m_accepting_socket;
     ola::SingleUseCallback0<void> *m_timeout_closure;
+    unsigned int m_batch_reads;
+    unsigned int m_datagrams_received;
 
     void SocketClientClose(ConnectedDescriptor *socket,
                            ConnectedDescriptor *socket2);
@@ -108,12 +128,30 @@ class SocketTest: public CppUnit::TestFixture {
 CPPUNIT_TEST_SUITE_REGISTRATION(SocketTest);
 
 
+#ifdef HAVE_EPOLL
+/*
+ * Run the same tests with the epoll() poller.
+ */
+class EPollSocketTest: public SocketTest {
+  CPPUNIT_TEST_SUB_SUITE(EPollSocketTest, SocketTest);
+  CPPUNIT_TEST_SUITE_END();
+
+  protected:
+    SelectServer::PollerType Poller() const {
+      return SelectServer::EPOLL_POLLER;
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(EPollSocketTest);
+#endif
+
+
 /*
  * Setup the select server
  */
 void SocketTest::setUp() {
   ola::InitLogging(ola::OLA_LOG_INFO, ola::OLA_LOG_STDERR);
-  m_ss = new SelectServer();
+  m_ss = new SelectServer(NULL, NULL, Poller());
   m_timeout_closure = ola::NewSingleCallback(this, &SocketTest::Timeout);
   CPPUNIT_ASSERT(m_ss->RegisterSingleTimeout(ABORT_TIMEOUT_IN_MS,
                                              m_timeout_closure));
@@ -308,6 +346,109 @@ void SocketTest::testUdpSocket() {
 }
 
 
+/*
+ * Check that RecvBatch() reads all the waiting datagrams, up to the capacity
+ * of the batch.
+ */
+void SocketTest::testUdpRecvBatch() {
+  IPV4Address ip_address;
+  CPPUNIT_ASSERT(IPV4Address::FromString("127.0.0.1", &ip_address));
+  uint16_t server_port = 9011;
+  UdpSocket socket;
+  CPPUNIT_ASSERT(socket.Init());
+  CPPUNIT_ASSERT(socket.Bind(server_port));
+
+  DatagramBatch batch(3, 16);
+  CPPUNIT_ASSERT_EQUAL(3u, batch.Capacity());
+  CPPUNIT_ASSERT_EQUAL(0u, batch.Size());
+  socket.SetOnData(
+      ola::NewCallback(this, &SocketTest::UdpReceiveBatch, &socket, &batch));
+  CPPUNIT_ASSERT(m_ss->AddReadDescriptor(&socket));
+
+  UdpSocket client_socket;
+  CPPUNIT_ASSERT(client_socket.Init());
+  for (uint8_t i = 0; i < DATAGRAMS_TO_SEND; i++) {
+    uint8_t data[DATAGRAMS_TO_SEND];
+    memset(data, i, sizeof(data));
+    // datagram i is i + 1 bytes long
+    ssize_t bytes_sent = client_socket.SendTo(data, i + 1, ip_address,
+                                              server_port);
+    CPPUNIT_ASSERT_EQUAL(static_cast<ssize_t>(i + 1), bytes_sent);
+  }
+
+  m_batch_reads = 0;
+  m_datagrams_received = 0;
+  m_ss->Run();
+  m_ss->RemoveReadDescriptor(&socket);
+  CPPUNIT_ASSERT_EQUAL(static_cast<unsigned int>(DATAGRAMS_TO_SEND),
+                       m_datagrams_received);
+  // the first read fills the batch, the second gets the rest
+  CPPUNIT_ASSERT_EQUAL(2u, m_batch_reads);
+}
+
+
+/*
+ * Check that SendBatch() sends everything in the queue.
+ */
+void SocketTest::testUdpSendBatch() {
+  IPV4Address ip_address;
+  CPPUNIT_ASSERT(IPV4Address::FromString("127.0.0.1", &ip_address));
+  uint16_t server_port = 9012;
+  UdpSocket socket;
+  CPPUNIT_ASSERT(socket.Init());
+  CPPUNIT_ASSERT(socket.Bind(server_port));
+
+  DatagramBatch batch(DATAGRAMS_TO_SEND, 16);
+  socket.SetOnData(
+      ola::NewCallback(this, &SocketTest::UdpReceiveBatch, &socket, &batch));
+  CPPUNIT_ASSERT(m_ss->AddReadDescriptor(&socket));
+
+  DatagramSendQueue queue(DATAGRAMS_TO_SEND);
+  CPPUNIT_ASSERT(queue.Empty());
+  CPPUNIT_ASSERT(!queue.AddDestination(ip_address, server_port));
+  uint8_t data[] = {0, 1, 2, 3, 4};
+  for (uint8_t i = 0; i < DATAGRAMS_TO_SEND - 1; i++) {
+    // datagram i is i + 1 bytes long
+    memset(data, i, sizeof(data));
+    CPPUNIT_ASSERT(queue.Add(data, i + 1, ip_address, server_port));
+  }
+  CPPUNIT_ASSERT(!queue.IsFull());
+  memset(data, DATAGRAMS_TO_SEND - 1, sizeof(data));
+  CPPUNIT_ASSERT(queue.Add(data, DATAGRAMS_TO_SEND, ip_address, server_port));
+  CPPUNIT_ASSERT(queue.IsFull());
+  CPPUNIT_ASSERT(!queue.Add(data, 1, ip_address, server_port));
+  CPPUNIT_ASSERT(!queue.AddDestination(ip_address, server_port));
+  CPPUNIT_ASSERT_EQUAL(3u, queue.Length(2));
+  CPPUNIT_ASSERT_EQUAL(static_cast<uint8_t>(2), queue.Data(2)[0]);
+
+  UdpSocket client_socket;
+  CPPUNIT_ASSERT(client_socket.Init());
+  CPPUNIT_ASSERT_EQUAL(static_cast<unsigned int>(DATAGRAMS_TO_SEND),
+                       client_socket.SendBatch(&queue));
+  CPPUNIT_ASSERT(queue.Empty());
+  CPPUNIT_ASSERT(queue.SendCalls() >= 1);
+
+  m_batch_reads = 0;
+  m_datagrams_received = 0;
+  m_ss->Run();
+  m_ss->RemoveReadDescriptor(&socket);
+  CPPUNIT_ASSERT_EQUAL(static_cast<unsigned int>(DATAGRAMS_TO_SEND),
+                       m_datagrams_received);
+
+  // AddDestination() reuses the last datagram
+  CPPUNIT_ASSERT(queue.Add(data, 2, ip_address, server_port));
+  CPPUNIT_ASSERT(queue.AddDestination(IPV4Address::Broadcast(), 1));
+  CPPUNIT_ASSERT_EQUAL(2u, queue.Size());
+  CPPUNIT_ASSERT_EQUAL(queue.Data(0), queue.Data(1));
+  CPPUNIT_ASSERT_EQUAL(2u, queue.Length(1));
+  CPPUNIT_ASSERT(IPV4Address::Broadcast() == queue.Destination(1));
+  CPPUNIT_ASSERT_EQUAL(static_cast<uint16_t>(1), queue.Port(1));
+
+  // broadcast isn't enabled, so the second datagram is skipped
+  CPPUNIT_ASSERT_EQUAL(1u, client_socket.SendBatch(&queue));
+  CPPUNIT_ASSERT(queue.Empty());
+}
+
 
 /*
  * Receive some data and close the socket
@@ -413,6 +554,26 @@ void SocketTest::UdpReceiveAndTerminate(UdpSocket *socket) {
 }
 
 
+/*
+ * Check a batch of datagrams and terminate once they have all arrived.
+ */
+void SocketTest::UdpReceiveBatch(UdpSocket *socket, DatagramBatch *batch) {
+  IPV4Address expected_address;
+  CPPUNIT_ASSERT(IPV4Address::FromString("127.0.0.1", &expected_address));
+
+  CPPUNIT_ASSERT(socket->RecvBatch(batch));
+  m_batch_reads++;
+  for (unsigned int i = 0; i < batch->Size(); i++) {
+    uint8_t expected = m_datagrams_received++;
+    CPPUNIT_ASSERT_EQUAL(expected + 1u, batch->Length(i));
+    CPPUNIT_ASSERT_EQUAL(expected, batch->Data(i)[0]);
+    CPPUNIT_ASSERT(expected_address == batch->Source(i));
+  }
+  if (m_datagrams_received == DATAGRAMS_TO_SEND)
+    m_ss->Terminate();
+}
+
+
 /*
  * Receive some data and echo it back.
  */
@@ -0,0 +1,419 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * TimerWheel.cpp
+ * A hierarchical timing wheel used by the SelectServer to manage timeouts.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <stdint.h>
+
+#include "common/network/TimerWheel.h"
+
+namespace ola {
+namespace network {
+
+using ola::thread::INVALID_TIMEOUT;
+
+
+/*
+ * Create a new timer.
+ * @param interval the interval
+ * @param now the current time
+ * @param mode how to schedule the next run
+ */
+TimerWheel::Timer::Timer(const TimeInterval &interval,
+                         const TimeStamp &now,
+                         ola::thread::TimerMode mode)
+    : expiry_tick(0),
+      level(-1),
+      cancelled(false),
+      histogram(NULL),
+      m_interval(interval),
+      m_mode(mode) {
+  prev = NULL;
+  next = NULL;
+  m_next = now + m_interval;
+}
+
+
+/*
+ * Work out when the timer should next run.
+ * @param now the time the timer last ran
+ */
+void TimerWheel::Timer::UpdateTime(const TimeStamp &now) {
+  int64_t interval = m_interval.InNanoSeconds();
+  if (m_mode == ola::thread::FIXED_DELAY || interval <= 0) {
+    m_next = now + m_interval;
+    return;
+  }
+
+  // move to the first deadline after now, skipping any we missed.
+  m_next += m_interval;
+  if (m_next <= now) {
+    int64_t missed = (now - m_next).InNanoSeconds() / interval + 1;
+    m_next += TimeInterval::FromNanoSeconds(missed * interval);
+  }
+}
+
+
+/*
+ * Create a new TimerWheel.
+ * @param clock the clock to use, ownership is not transferred.
+ */
+TimerWheel::TimerWheel(const Clock *clock)
+    : m_clock(clock),
+      m_current_tick(0),
+      m_running_timer(NULL) {
+  m_clock->CurrentTime(&m_origin);
+  for (unsigned int level = 0; level < K_LEVELS; level++) {
+    m_level_count[level] = 0;
+    for (unsigned int i = 0; i < K_SLOTS; i++) {
+      TimerNode *slot = &m_wheels[level][i];
+      slot->prev = slot;
+      slot->next = slot;
+    }
+  }
+}
+
+
+/*
+ * Clean up
+ */
+TimerWheel::~TimerWheel() {
+  Clear();
+}
+
+
+/*
+ * Add a repeating timeout. The closure can return false to stop it repeating.
+ * @param interval the interval between calls.
+ * @param closure the closure to run, ownership is transferred.
+ * @param mode how to schedule the next run.
+ * @returns the id of the timeout.
+ */
+timeout_id TimerWheel::AddRepeatingTimeout(const TimeInterval &interval,
+                                           ola::BaseCallback0<bool> *closure,
+                                           ola::thread::TimerMode mode) {
+  TimeStamp now;
+  m_clock->CurrentTime(&now);
+  return AddTimer(new RepeatingTimer(interval, now, closure, mode));
+}
+
+
+/*
+ * Add a single timeout.
+ * @param ms the time until the timeout fires.
+ * @param closure the closure to run, ownership is transferred.
+ * @returns the id of the timeout.
+ */
+timeout_id TimerWheel::AddSingleTimeout(unsigned int ms,
+                                        ola::BaseCallback0<void> *closure) {
+  TimeStamp now;
+  m_clock->CurrentTime(&now);
+  return AddTimer(new SingleTimer(
+        TimeInterval(static_cast<int64_t>(ms) * ONE_THOUSAND), now, closure));
+}
+
+
+/*
+ * Remove a timeout. This is safe to call from within the timeout's own
+ * closure.
+ * @param id the timeout to remove
+ * @returns true if the timeout was removed, false if it didn't exist.
+ */
+bool TimerWheel::RemoveTimeout(timeout_id id) {
+  if (id == INVALID_TIMEOUT)
+    return false;
+
+  TimerSet::iterator iter = m_timers.find(reinterpret_cast<uintptr_t>(id));
+  if (iter == m_timers.end())
+    return false;
+
+  Timer *timer = reinterpret_cast<Timer*>(*iter);
+  if (timer == m_running_timer) {
+    // this will be deleted once the closure returns
+    timer->cancelled = true;
+    return true;
+  }
+
+  Unlink(timer);
+  DeleteTimer(timer);
+  return true;
+}
+
+
+/*
+ * Record how long a timeout's closure takes to run.
+ * @param id the timeout
+ * @param histogram the HistogramVariable to update, or NULL to stop recording.
+ * @returns true if the timeout exists, false otherwise.
+ */
+bool TimerWheel::SetHistogram(timeout_id id, HistogramVariable *histogram) {
+  if (id == INVALID_TIMEOUT)
+    return false;
+
+  TimerSet::iterator iter = m_timers.find(reinterpret_cast<uintptr_t>(id));
+  if (iter == m_timers.end())
+    return false;
+
+  reinterpret_cast<Timer*>(*iter)->histogram = histogram;
+  return true;
+}
+
+
+/*
+ * Run all the timeouts that have expired.
+ * @param current_time the current time
+ * @returns the time up to which we checked, this is updated each time a
+ *   timeout runs.
+ */
+TimeStamp TimerWheel::RunExpired(const TimeStamp &current_time) {
+  TimeStamp now = current_time;
+  uint64_t target_tick = TickFor(now);
+
+  while (m_current_tick < target_tick) {
+    if (m_timers.empty()) {
+      m_current_tick = target_tick;
+      break;
+    }
+
+    if (!m_level_count[0]) {
+      // nothing on the inner wheel, jump to the tick before the next cascade
+      uint64_t last_tick_in_turn = m_current_tick | K_SLOT_MASK;
+      if (last_tick_in_turn >= target_tick) {
+        m_current_tick = target_tick;
+        break;
+      }
+      m_current_tick = last_tick_in_turn;
+    }
+
+    m_current_tick++;
+    // cascade each outer wheel that has completed a turn, outer wheels are
+    // only cascaded if the wheel inside them has wrapped.
+    for (unsigned int level = 1; level < K_LEVELS; level++) {
+      if ((m_current_tick >> ((level - 1) * K_SLOT_BITS)) & K_SLOT_MASK)
+        break;
+      Cascade(level);
+    }
+
+    RunSlot(&m_wheels[0][m_current_tick & K_SLOT_MASK], &now);
+    uint64_t new_target = TickFor(now);
+    if (new_target > target_tick)
+      target_tick = new_target;
+  }
+  return now;
+}
+
+
+/*
+ * Return the time the next timeout is due. For timeouts on the outer wheels
+ * this returns the time they'll be cascaded, which is never later than the
+ * actual expiry time.
+ * @param next the TimeStamp to update
+ * @returns false if there are no timeouts, true otherwise.
+ */
+bool TimerWheel::NextTimeout(TimeStamp *next) const {
+  if (m_timers.empty())
+    return false;
+
+  bool found = false;
+  uint64_t next_tick = 0;
+
+  for (unsigned int level = 0; level < K_LEVELS; level++) {
+    if (!m_level_count[level])
+      continue;
+
+    unsigned int shift = level * K_SLOT_BITS;
+    uint64_t base = m_current_tick >> shift;
+    // slots on the outer wheels can be one full turn away
+    unsigned int max_offset = level ? K_SLOTS : K_SLOTS - 1;
+    for (unsigned int offset = 1; offset <= max_offset; offset++) {
+      uint64_t tick = (base + offset) << shift;
+      if (found && tick >= next_tick)
+        break;
+      if (!SlotIsEmpty(m_wheels[level][(base + offset) & K_SLOT_MASK])) {
+        next_tick = tick;
+        found = true;
+        break;
+      }
+    }
+  }
+
+  if (!found) {
+    // the timers are all waiting to be re-run, this shouldn't happen
+    next_tick = m_current_tick + 1;
+  }
+
+  *next = m_origin + TimeInterval(
+      static_cast<int64_t>(next_tick) * K_USEC_PER_TICK);
+  return true;
+}
+
+
+/*
+ * Remove & delete all timeouts.
+ */
+void TimerWheel::Clear() {
+  for (unsigned int level = 0; level < K_LEVELS; level++) {
+    for (unsigned int i = 0; i < K_SLOTS; i++) {
+      TimerNode *slot = &m_wheels[level][i];
+      while (!SlotIsEmpty(*slot)) {
+        Timer *timer = static_cast<Timer*>(slot->next);
+        Unlink(timer);
+        DeleteTimer(timer);
+      }
+    }
+  }
+}
+
+
+/*
+ * Take ownership of a timer and add it to the wheel.
+ */
+timeout_id TimerWheel::AddTimer(Timer *timer) {
+  // round up so we never fire early, and always put the timer in a future
+  // slot, otherwise a timer added from a closure could run in this pass.
+  TimeInterval delay = timer->NextTime() - m_origin;
+  int64_t usecs = delay.AsInt();
+  uint64_t tick = usecs <= 0 ? 0 :
+    (usecs + K_USEC_PER_TICK - 1) / K_USEC_PER_TICK;
+  timer->expiry_tick = tick > m_current_tick ? tick : m_current_tick + 1;
+
+  Insert(timer);
+  m_timers.insert(reinterpret_cast<uintptr_t>(timer));
+  return timer;
+}
+
+
+/*
+ * Link a timer into the correct slot based on its expiry tick.
+ */
+void TimerWheel::Insert(Timer *timer) {
+  uint64_t delta = timer->expiry_tick > m_current_tick ?
+    timer->expiry_tick - m_current_tick : 0;
+  uint64_t tick = timer->expiry_tick;
+
+  unsigned int level = 0;
+  while (level < K_LEVELS - 1 &&
+         delta >= (static_cast<uint64_t>(1) << ((level + 1) * K_SLOT_BITS)))
+    level++;
+
+  if (level == K_LEVELS - 1) {
+    // timers beyond the range of the outer wheel are parked in the furthest
+    // slot and re-inserted when that slot is cascaded.
+    uint64_t max_delta = (static_cast<uint64_t>(1) <<
+                          (K_LEVELS * K_SLOT_BITS)) - 1;
+    if (delta > max_delta)
+      tick = m_current_tick + max_delta;
+  }
+
+  TimerNode *slot = &m_wheels[level][
+    (tick >> (level * K_SLOT_BITS)) & K_SLOT_MASK];
+  timer->next = slot;
+  timer->prev = slot->prev;
+  slot->prev->next = timer;
+  slot->prev = timer;
+  timer->level = level;
+  m_level_count[level]++;
+}
+
+
+/*
+ * Remove a timer from whichever slot it's in.
+ */
+void TimerWheel::Unlink(Timer *timer) {
+  if (timer->level < 0)
+    return;
+  timer->prev->next = timer->next;
+  timer->next->prev = timer->prev;
+  timer->prev = NULL;
+  timer->next = NULL;
+  m_level_count[timer->level]--;
+  timer->level = -1;
+}
+
+
+/*
+ * Move the timers in the current slot of an outer wheel inwards.
+ */
+void TimerWheel::Cascade(unsigned int level) {
+  TimerNode *slot = &m_wheels[level][
+    (m_current_tick >> (level * K_SLOT_BITS)) & K_SLOT_MASK];
+  while (!SlotIsEmpty(*slot)) {
+    Timer *timer = static_cast<Timer*>(slot->next);
+    Unlink(timer);
+    Insert(timer);
+  }
+}
+
+
+/*
+ * Run all the timers in a slot on the inner wheel.
+ * @param slot the slot to run
+ * @param now the current time, this is updated after each closure runs.
+ */
+void TimerWheel::RunSlot(TimerNode *slot, TimeStamp *now) {
+  while (!SlotIsEmpty(*slot)) {
+    Timer *timer = static_cast<Timer*>(slot->next);
+    Unlink(timer);
+
+    if (timer->expiry_tick > m_current_tick) {
+      // a parked timer that isn't due yet
+      Insert(timer);
+      continue;
+    }
+
+    // the timer may be deleted by the time the closure returns
+    HistogramVariable *histogram = timer->histogram;
+    TimeStamp start = *now;
+
+    m_running_timer = timer;
+    bool repeat = timer->Trigger();
+    m_running_timer = NULL;
+
+    if (repeat && !timer->cancelled) {
+      timer->UpdateTime(*now);
+      AddTimer(timer);
+    } else {
+      DeleteTimer(timer);
+    }
+    m_clock->CurrentTime(now);
+    if (histogram)
+      histogram->Add((*now - start).AsInt());
+  }
+}
+
+
+/*
+ * Delete a timer that has already been unlinked.
+ */
+void TimerWheel::DeleteTimer(Timer *timer) {
+  m_timers.erase(reinterpret_cast<uintptr_t>(timer));
+  delete timer;
+}
+
+
+/*
+ * Convert a TimeStamp to the last tick that has completely elapsed.
+ */
+uint64_t TimerWheel::TickFor(const TimeStamp &time) const {
+  if (time <= m_origin)
+    return m_current_tick;
+  uint64_t tick = (time - m_origin).AsInt() / K_USEC_PER_TICK;
+  return tick > m_current_tick ? tick : m_current_tick;
+}
+}  // network
+}  // ola
@@ -0,0 +1,193 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * TimerWheel.h
+ * A hierarchical timing wheel used by the SelectServer to manage timeouts.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#ifndef COMMON_NETWORK_TIMERWHEEL_H_
+#define COMMON_NETWORK_TIMERWHEEL_H_
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdint.h>
+#include HASH_SET_H
+
+#include "ola/Callback.h"
+#include "ola/Clock.h"
+#include "ola/ExportMap.h"
+#include "ola/thread/SchedulerInterface.h"
+
+namespace ola {
+namespace network {
+
+using ola::thread::timeout_id;
+
+/*
+ * A hierarchical timing wheel with millisecond resolution.
+ *
+ * Timeouts are stored in doubly linked lists, one per slot. There are
+ * K_LEVELS wheels of K_SLOTS slots each, the first covers the next 256ms, the
+ * second the next 65s and so on. Timeouts on the outer wheels are moved
+ * inwards (cascaded) as time advances. This makes adding and removing a
+ * timeout O(1), compared to O(log n) for a heap, which matters when there are
+ * thousands of RDM timeouts that are almost always cancelled before they
+ * fire.
+ *
+ * Timeouts never fire early but may fire up to 1ms late.
+ */
+class TimerWheel {
+  public :
+    explicit TimerWheel(const Clock *clock);
+    ~TimerWheel();
+
+    timeout_id AddRepeatingTimeout(const TimeInterval &interval,
+                                   ola::BaseCallback0<bool> *closure,
+                                   ola::thread::TimerMode mode);
+    timeout_id AddSingleTimeout(unsigned int ms,
+                                ola::BaseCallback0<void> *closure);
+    bool RemoveTimeout(timeout_id id);
+    bool SetHistogram(timeout_id id, HistogramVariable *histogram);
+
+    TimeStamp RunExpired(const TimeStamp &now);
+    bool NextTimeout(TimeStamp *next) const;
+
+    unsigned int Size() const { return m_timers.size(); }
+    void Clear();
+
+  private :
+    struct TimerNode {
+      TimerNode *prev;
+      TimerNode *next;
+    };
+
+    /*
+     * The base timer class.
+     */
+    class Timer: public TimerNode {
+      public:
+        Timer(const TimeInterval &interval,
+              const TimeStamp &now,
+              ola::thread::TimerMode mode);
+        virtual ~Timer() {}
+        virtual bool Trigger() = 0;
+
+        void UpdateTime(const TimeStamp &now);
+        TimeStamp NextTime() const { return m_next; }
+
+        uint64_t expiry_tick;  // the tick this timer expires on
+        int level;  // the wheel this timer is on, or -1 if it's not linked
+        bool cancelled;  // set if the timer is removed while running
+        // if set, the time the closure takes to run is recorded here
+        HistogramVariable *histogram;
+
+      private:
+        TimeInterval m_interval;
+        TimeStamp m_next;
+        ola::thread::TimerMode m_mode;
+    };
+
+    // A timer that only fires once
+    class SingleTimer: public Timer {
+      public:
+        SingleTimer(const TimeInterval &interval,
+                    const TimeStamp &now,
+                    ola::BaseCallback0<void> *closure)
+            : Timer(interval, now, ola::thread::FIXED_DELAY),
+              m_closure(closure) {
+        }
+        ~SingleTimer() {
+          if (m_closure)
+            delete m_closure;
+        }
+
+        bool Trigger() {
+          if (m_closure) {
+            m_closure->Run();
+            // it's deleted itself at this point
+            m_closure = NULL;
+          }
+          return false;
+        }
+
+      private:
+        ola::BaseCallback0<void> *m_closure;
+    };
+
+    /*
+     * A timer that fires more than once. The closure can return false to
+     * indicate that it should not be called again.
+     */
+    class RepeatingTimer: public Timer {
+      public:
+        RepeatingTimer(const TimeInterval &interval,
+                       const TimeStamp &now,
+                       ola::BaseCallback0<bool> *closure,
+                       ola::thread::TimerMode mode)
+            : Timer(interval, now, mode),
+              m_closure(closure) {
+        }
+        ~RepeatingTimer() {
+          delete m_closure;
+        }
+
+        bool Trigger() {
+          if (!m_closure)
+            return false;
+          return m_closure->Run();
+        }
+
+      private:
+        ola::BaseCallback0<bool> *m_closure;
+    };
+
+    // the ids of the live timers, used to validate calls to RemoveTimeout()
+    typedef HASH_NAMESPACE::HASH_SET_CLASS<uintptr_t> TimerSet;
+
+    static const unsigned int K_SLOT_BITS = 8;
+    static const unsigned int K_SLOTS = 1 << K_SLOT_BITS;
+    static const uint64_t K_SLOT_MASK = K_SLOTS - 1;
+    static const unsigned int K_LEVELS = 4;
+    static const int64_t K_USEC_PER_TICK = 1000;
+
+    const Clock *m_clock;
+    TimeStamp m_origin;
+    uint64_t m_current_tick;  // all slots up to & including this have run
+    TimerNode m_wheels[K_LEVELS][K_SLOTS];
+    unsigned int m_level_count[K_LEVELS];
+    TimerSet m_timers;
+    Timer *m_running_timer;
+
+    timeout_id AddTimer(Timer *timer);
+    void Insert(Timer *timer);
+    void Unlink(Timer *timer);
+    void Cascade(unsigned int level);
+    void RunSlot(TimerNode *slot, TimeStamp *now);
+    void DeleteTimer(Timer *timer);
+    uint64_t TickFor(const TimeStamp &time) const;
+
+    static bool SlotIsEmpty(const TimerNode &slot) {
+      return slot.next == &slot;
+    }
+
+    TimerWheel(const TimerWheel&);
+    TimerWheel operator=(const TimerWheel&);
+};
+}  // network
+}  // ola
+#endif  // COMMON_NETWORK_TIMERWHEEL_H_
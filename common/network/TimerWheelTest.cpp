@@ -0,0 +1,264 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * TimerWheelTest.cpp
+ * Test fixture for the TimerWheel class
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "common/network/TimerWheel.h"
+#include "ola/Callback.h"
+#include "ola/Clock.h"
+
+using ola::MockClock;
+using ola::TimeInterval;
+using ola::TimeStamp;
+using ola::network::TimerWheel;
+using ola::network::timeout_id;
+
+
+class TimerWheelTest: public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(TimerWheelTest);
+  CPPUNIT_TEST(testSingleTimeout);
+  CPPUNIT_TEST(testRepeatingTimeout);
+  CPPUNIT_TEST(testFixedRateTimeout);
+  CPPUNIT_TEST(testRemoveTimeout);
+  CPPUNIT_TEST(testLongTimeouts);
+  CPPUNIT_TEST(testNextTimeout);
+  CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void setUp() {
+      m_counter = 0;
+      m_wheel = new TimerWheel(&m_clock);
+    }
+    void tearDown() { delete m_wheel; }
+
+    void testSingleTimeout();
+    void testRepeatingTimeout();
+    void testFixedRateTimeout();
+    void testRemoveTimeout();
+    void testLongTimeouts();
+    void testNextTimeout();
+
+  private:
+    MockClock m_clock;
+    TimerWheel *m_wheel;
+    unsigned int m_counter;
+    timeout_id m_self_id;
+
+    void Increment() { m_counter++; }
+
+    bool RepeatingIncrement() {
+      m_counter++;
+      return m_counter < 3;
+    }
+
+    bool AlwaysIncrement() {
+      m_counter++;
+      return true;
+    }
+
+    bool RemoveSelf() {
+      m_counter++;
+      m_wheel->RemoveTimeout(m_self_id);
+      return true;
+    }
+
+    void AddAnother() {
+      m_counter++;
+      m_wheel->AddSingleTimeout(
+          0, ola::NewSingleCallback(this, &TimerWheelTest::Increment));
+    }
+
+    void Advance(int32_t sec, int32_t usec) {
+      m_clock.AdvanceTime(sec, usec);
+      TimeStamp now;
+      m_clock.CurrentTime(&now);
+      m_wheel->RunExpired(now);
+    }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TimerWheelTest);
+
+
+/*
+ * Check single timeouts run once, in the right order.
+ */
+void TimerWheelTest::testSingleTimeout() {
+  m_wheel->AddSingleTimeout(
+      100, ola::NewSingleCallback(this, &TimerWheelTest::Increment));
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, m_wheel->Size());
+
+  Advance(0, 50000);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, m_counter);
+  Advance(0, 60000);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, m_counter);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, m_wheel->Size());
+  Advance(1, 0);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, m_counter);
+
+  // a timeout that adds another one, the new timeout shouldn't run until the
+  // next pass
+  m_wheel->AddSingleTimeout(
+      10, ola::NewSingleCallback(this, &TimerWheelTest::AddAnother));
+  Advance(0, 20000);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 2, m_counter);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, m_wheel->Size());
+  Advance(0, 2000);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 3, m_counter);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, m_wheel->Size());
+}
+
+
+/*
+ * Check repeating timeouts.
+ */
+void TimerWheelTest::testRepeatingTimeout() {
+  m_wheel->AddRepeatingTimeout(
+      TimeInterval(0, 100000),
+      ola::NewCallback(this, &TimerWheelTest::RepeatingIncrement),
+      ola::thread::FIXED_DELAY);
+
+  for (unsigned int i = 1; i <= 3; i++) {
+    Advance(0, 101000);
+    CPPUNIT_ASSERT_EQUAL(i, m_counter);
+  }
+  // the closure returned false, so this should have been removed
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, m_wheel->Size());
+  Advance(1, 0);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 3, m_counter);
+}
+
+
+/*
+ * Check that fixed rate timeouts are scheduled from the previous deadline
+ * rather than the time they ran.
+ */
+void TimerWheelTest::testFixedRateTimeout() {
+  m_wheel->AddRepeatingTimeout(
+      TimeInterval(0, 100000),
+      ola::NewCallback(this, &TimerWheelTest::AlwaysIncrement),
+      ola::thread::FIXED_RATE);
+  m_wheel->AddRepeatingTimeout(
+      TimeInterval(0, 100000),
+      ola::NewCallback(this, &TimerWheelTest::RepeatingIncrement),
+      ola::thread::FIXED_DELAY);
+
+  // both run 50ms late.
+  Advance(0, 150000);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 2, m_counter);
+  // the fixed rate timeout is due at 200ms, the fixed delay one at 250ms
+  Advance(0, 60000);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 3, m_counter);
+  Advance(0, 50000);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 4, m_counter);
+
+  // now we miss several deadlines, this should only run once
+  m_counter = 10;
+  Advance(0, 450000);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 11, m_counter);
+  // and then go back to the original phase, the next deadline is 800ms
+  Advance(0, 30000);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 11, m_counter);
+  Advance(0, 70000);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 12, m_counter);
+}
+
+
+/*
+ * Check that timeouts can be removed, including from within the closure.
+ */
+void TimerWheelTest::testRemoveTimeout() {
+  timeout_id id = m_wheel->AddSingleTimeout(
+      100, ola::NewSingleCallback(this, &TimerWheelTest::Increment));
+  CPPUNIT_ASSERT(m_wheel->RemoveTimeout(id));
+  CPPUNIT_ASSERT(!m_wheel->RemoveTimeout(id));
+  CPPUNIT_ASSERT(!m_wheel->RemoveTimeout(ola::thread::INVALID_TIMEOUT));
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, m_wheel->Size());
+  Advance(1, 0);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, m_counter);
+
+  m_self_id = m_wheel->AddRepeatingTimeout(
+      TimeInterval(0, 10000),
+      ola::NewCallback(this, &TimerWheelTest::RemoveSelf),
+      ola::thread::FIXED_DELAY);
+  Advance(0, 11000);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, m_counter);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, m_wheel->Size());
+  Advance(1, 0);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, m_counter);
+}
+
+
+/*
+ * Check timeouts on the outer wheels are cascaded correctly.
+ */
+void TimerWheelTest::testLongTimeouts() {
+  // 5 minutes, 2 hours & the longest possible timeout, which is at the end
+  // of the outer wheel
+  m_wheel->AddSingleTimeout(
+      300000, ola::NewSingleCallback(this, &TimerWheelTest::Increment));
+  m_wheel->AddSingleTimeout(
+      7200000, ola::NewSingleCallback(this, &TimerWheelTest::Increment));
+  m_wheel->AddSingleTimeout(
+      0xffffffff,
+      ola::NewSingleCallback(this, &TimerWheelTest::Increment));
+
+  Advance(299, 0);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, m_counter);
+  Advance(2, 0);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, m_counter);
+  Advance(6890, 0);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, m_counter);
+  Advance(20, 0);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 2, m_counter);
+
+  Advance(49 * 86400, 0);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 2, m_counter);
+  Advance(86400, 0);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 3, m_counter);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, m_wheel->Size());
+}
+
+
+/*
+ * Check NextTimeout never returns a time later than the actual expiry.
+ */
+void TimerWheelTest::testNextTimeout() {
+  TimeStamp next;
+  CPPUNIT_ASSERT(!m_wheel->NextTimeout(&next));
+
+  TimeStamp now;
+  m_clock.CurrentTime(&now);
+  m_wheel->AddSingleTimeout(
+      10000, ola::NewSingleCallback(this, &TimerWheelTest::Increment));
+  CPPUNIT_ASSERT(m_wheel->NextTimeout(&next));
+  CPPUNIT_ASSERT(next > now);
+  CPPUNIT_ASSERT(next <= now + TimeInterval(10, 1000));
+
+  m_wheel->AddSingleTimeout(
+      50, ola::NewSingleCallback(this, &TimerWheelTest::Increment));
+  CPPUNIT_ASSERT(m_wheel->NextTimeout(&next));
+  CPPUNIT_ASSERT(next > now);
+  CPPUNIT_ASSERT(next <= now + TimeInterval(0, 51000));
+
+  m_wheel->Clear();
+  CPPUNIT_ASSERT(!m_wheel->NextTimeout(&next));
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, m_counter);
+}
@@ -0,0 +1,252 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * timer_wheel_benchmark.cpp
+ * Compares the TimerWheel with the priority queue the SelectServer used to
+ * use. The workload models RDM requests: each timeout is registered and then
+ * almost always cancelled when the response arrives.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <getopt.h>
+#include <stdlib.h>
+#include <iostream>
+#include <queue>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "common/network/TimerWheel.h"
+#include "ola/Callback.h"
+#include "ola/Clock.h"
+#include "ola/StringUtils.h"
+
+using ola::Clock;
+using ola::TimeInterval;
+using ola::TimeStamp;
+using ola::network::TimerWheel;
+using ola::network::timeout_id;
+using std::cout;
+using std::endl;
+using std::vector;
+
+
+/*
+ * A clock that only moves when we tell it to, so the benchmark isn't
+ * dominated by gettimeofday().
+ */
+class ManualClock: public Clock {
+  public:
+    ManualClock() {
+      Clock real_clock;
+      real_clock.CurrentTime(&m_now);
+    }
+
+    void CurrentTime(TimeStamp *timestamp) const { *timestamp = m_now; }
+    void Advance(const TimeInterval &interval) { m_now += interval; }
+
+  private:
+    TimeStamp m_now;
+};
+
+
+/*
+ * The timeout handling from the old SelectServer: a heap of events plus a set
+ * of the ids that have been removed.
+ */
+class QueueTimeouts {
+  public:
+    explicit QueueTimeouts(const Clock *clock) : m_clock(clock) {}
+
+    ~QueueTimeouts() {
+      while (!m_events.empty()) {
+        delete m_events.top();
+        m_events.pop();
+      }
+    }
+
+    timeout_id AddSingleTimeout(unsigned int ms,
+                                ola::SingleUseCallback0<void> *closure) {
+      TimeStamp now;
+      m_clock->CurrentTime(&now);
+      Event *event = new Event(now + TimeInterval(ms * 1000), closure);
+      m_events.push(event);
+      return event;
+    }
+
+    bool RemoveTimeout(timeout_id id) {
+      return m_removed_timeouts.insert(id).second;
+    }
+
+    TimeStamp RunExpired(const TimeStamp &current_time) {
+      TimeStamp now = current_time;
+      while (!m_events.empty() && m_events.top()->next < now) {
+        Event *e = m_events.top();
+        m_events.pop();
+        if (!m_removed_timeouts.erase(e))
+          e->closure->Run();
+        else
+          delete e->closure;
+        delete e;
+        m_clock->CurrentTime(&now);
+      }
+      return now;
+    }
+
+  private:
+    struct Event {
+      Event(const TimeStamp &next_time,
+            ola::SingleUseCallback0<void> *callback)
+          : next(next_time),
+            closure(callback) {
+      }
+      TimeStamp next;
+      ola::SingleUseCallback0<void> *closure;
+    };
+
+    struct ltevent {
+      bool operator()(Event *e1, Event *e2) const {
+        return e1->next > e2->next;
+      }
+    };
+
+    const Clock *m_clock;
+    std::priority_queue<Event*, vector<Event*>, ltevent> m_events;
+    std::set<timeout_id> m_removed_timeouts;
+};
+
+
+typedef struct {
+  unsigned int operations;
+  unsigned int outstanding;
+  unsigned int fire_one_in;
+} options;
+
+
+static unsigned int fired = 0;
+
+void TimeoutFired() {
+  fired++;
+}
+
+
+/*
+ * Run the workload against a timeout implementation.
+ */
+template <typename TimeoutManager>
+void RunBenchmark(const std::string &name, const options &opts) {
+  ManualClock clock;
+  TimeoutManager manager(&clock);
+  vector<timeout_id> in_flight(opts.outstanding, ola::thread::INVALID_TIMEOUT);
+  fired = 0;
+  srandom(1);
+
+  Clock real_clock;
+  TimeStamp start, end;
+  real_clock.CurrentTime(&start);
+
+  for (unsigned int i = 0; i < opts.operations; i++) {
+    unsigned int index = i % opts.outstanding;
+    // a response arrives for the oldest request, most of the time before the
+    // timeout fires.
+    if (in_flight[index] != ola::thread::INVALID_TIMEOUT &&
+        (random() % opts.fire_one_in))
+      manager.RemoveTimeout(in_flight[index]);
+
+    in_flight[index] = manager.AddSingleTimeout(
+        1000 + random() % 2000,
+        ola::NewSingleCallback(&TimeoutFired));
+
+    if (i % 16 == 0) {
+      clock.Advance(TimeInterval(0, 1000));
+      TimeStamp now;
+      clock.CurrentTime(&now);
+      manager.RunExpired(now);
+    }
+  }
+
+  real_clock.CurrentTime(&end);
+  TimeInterval duration = end - start;
+  cout << name << ": " << opts.operations << " add/remove pairs with " <<
+    opts.outstanding << " outstanding took " << duration << "s (" <<
+    (duration.AsInt() * 1000.0 / opts.operations) << " ns/op), " << fired <<
+    " fired" << endl;
+}
+
+
+/*
+ * Display the help message
+ */
+void DisplayHelpAndExit(char *argv[]) {
+  cout << "Usage: " << argv[0] << " [options]\n"
+  "\n"
+  "Benchmark the SelectServer timeout implementations.\n"
+  "\n"
+  "  -h, --help                  Display this help message and exit.\n"
+  "  -n, --operations <count>    The number of timeouts to add.\n"
+  "  -o, --outstanding <count>   The number of timeouts in flight.\n"
+  << endl;
+  exit(0);
+}
+
+
+/*
+ * Parse our command line options
+ */
+void ParseOptions(int argc, char *argv[], options *opts) {
+  static struct option long_options[] = {
+      {"help", no_argument, 0, 'h'},
+      {"operations", required_argument, 0, 'n'},
+      {"outstanding", required_argument, 0, 'o'},
+      {0, 0, 0, 0}
+    };
+
+  int option_index = 0;
+  while (1) {
+    int c = getopt_long(argc, argv, "hn:o:", long_options, &option_index);
+    if (c == -1)
+      break;
+
+    switch (c) {
+      case 0:
+        break;
+      case 'h':
+        DisplayHelpAndExit(argv);
+        break;
+      case 'n':
+        ola::StringToInt(optarg, &opts->operations);
+        break;
+      case 'o':
+        ola::StringToInt(optarg, &opts->outstanding);
+        break;
+      default:
+        break;
+    }
+  }
+  if (!opts->outstanding)
+    opts->outstanding = 1;
+}
+
+
+int main(int argc, char *argv[]) {
+  options opts;
+  opts.operations = 2000000;
+  opts.outstanding = 10000;
+  opts.fire_one_in = 50;
+  ParseOptions(argc, argv, &opts);
+
+  RunBenchmark<QueueTimeouts>("priority queue", opts);
+  RunBenchmark<TimerWheel>("timer wheel", opts);
+}
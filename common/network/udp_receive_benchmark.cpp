@@ -0,0 +1,233 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * udp_receive_benchmark.cpp
+ * Compares reading one datagram each time the socket is ready with reading a
+ * DatagramBatch. Bursts of E1.31 sized datagrams are sent over the loopback
+ * interface and we measure how long the SelectServer takes to receive them.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+
+#include "ola/Callback.h"
+#include "ola/Clock.h"
+#include "ola/Logging.h"
+#include "ola/StringUtils.h"
+#include "ola/network/IPV4Address.h"
+#include "ola/network/SelectServer.h"
+#include "ola/network/Socket.h"
+
+using ola::Clock;
+using ola::TimeInterval;
+using ola::TimeStamp;
+using ola::network::DatagramBatch;
+using ola::network::IPV4Address;
+using ola::network::SelectServer;
+using ola::network::UdpSocket;
+using std::cout;
+using std::endl;
+
+
+typedef struct {
+  unsigned int bursts;
+  unsigned int burst_size;
+  unsigned int batch_size;
+  uint16_t port;
+} options;
+
+
+/*
+ * Counts the datagrams read from a socket.
+ */
+class Receiver {
+  public:
+    Receiver(UdpSocket *socket, unsigned int batch_size)
+        : m_socket(socket),
+          m_batch(batch_size, MAX_DATAGRAM_SIZE),
+          m_datagrams(0),
+          m_wake_ups(0) {
+    }
+
+    // The old way, one recvfrom() per wake up.
+    void ReadOne() {
+      uint8_t buffer[MAX_DATAGRAM_SIZE];
+      ssize_t size = sizeof(buffer);
+      IPV4Address source;
+      uint16_t port;
+      m_wake_ups++;
+      if (m_socket->RecvFrom(buffer, &size, source, port))
+        m_datagrams++;
+    }
+
+    void ReadBatch() {
+      m_wake_ups++;
+      if (m_socket->RecvBatch(&m_batch))
+        m_datagrams += m_batch.Size();
+    }
+
+    unsigned int Datagrams() const { return m_datagrams; }
+    unsigned int WakeUps() const { return m_wake_ups; }
+
+  private:
+    UdpSocket *m_socket;
+    DatagramBatch m_batch;
+    unsigned int m_datagrams;
+    unsigned int m_wake_ups;
+
+    static const unsigned int MAX_DATAGRAM_SIZE = 1472;
+};
+
+
+/*
+ * Send bursts of datagrams and time how long it takes to read them.
+ * @returns the number of datagrams per second.
+ */
+double RunBenchmark(bool batched, const options &opts) {
+  IPV4Address loopback;
+  IPV4Address::FromString("127.0.0.1", &loopback);
+  SelectServer ss;
+  UdpSocket sender, receiver;
+  if (!sender.Init() || !receiver.Init() ||
+      !receiver.Bind(loopback, opts.port)) {
+    OLA_WARN << "Failed to setup sockets";
+    exit(1);
+  }
+
+  Receiver counter(&receiver, opts.batch_size);
+  if (batched)
+    receiver.SetOnData(ola::NewCallback(&counter, &Receiver::ReadBatch));
+  else
+    receiver.SetOnData(ola::NewCallback(&counter, &Receiver::ReadOne));
+  ss.AddReadDescriptor(&receiver);
+
+  // the size of an E1.31 packet with a full universe
+  uint8_t packet[638];
+  memset(packet, 0, sizeof(packet));
+
+  Clock clock;
+  TimeInterval duration;
+  unsigned int sent = 0;
+  for (unsigned int burst = 0; burst < opts.bursts; burst++) {
+    for (unsigned int i = 0; i < opts.burst_size; i++) {
+      packet[0] = i;
+      if (sender.SendTo(packet, sizeof(packet), loopback, opts.port) ==
+          static_cast<ssize_t>(sizeof(packet)))
+        sent++;
+    }
+
+    TimeStamp start, end;
+    clock.CurrentTime(&start);
+    while (counter.Datagrams() < sent) {
+      unsigned int received = counter.Datagrams();
+      ss.RunOnce(0, 100000);
+      // the kernel dropped some, give up on this burst
+      if (counter.Datagrams() == received)
+        break;
+    }
+    clock.CurrentTime(&end);
+    duration += end - start;
+    sent = counter.Datagrams();
+  }
+  ss.RemoveReadDescriptor(&receiver);
+
+  double rate = counter.Datagrams() * 1000000.0 / duration.AsInt();
+  cout << (batched ? "RecvBatch(): " : "RecvFrom():  ") <<
+    counter.Datagrams() << " datagrams, " << counter.WakeUps() <<
+    " wake ups, " << duration << "s, " << static_cast<unsigned int>(rate) <<
+    " datagrams/s" << endl;
+  return rate;
+}
+
+
+/*
+ * Display the help message
+ */
+void DisplayHelpAndExit(char *argv[]) {
+  cout << "Usage: " << argv[0] << " [options]\n"
+  "\n"
+  "Compare reading one datagram per wake up with batched reads.\n"
+  "\n"
+  "  -b, --batch-size <count>   The capacity of the DatagramBatch.\n"
+  "  -c, --bursts <count>       The number of bursts to send.\n"
+  "  -h, --help                 Display this help message and exit.\n"
+  "  -p, --port <port>          The UDP port to use.\n"
+  "  -s, --burst-size <count>   The number of datagrams in each burst.\n"
+  << endl;
+  exit(0);
+}
+
+
+/*
+ * Parse our command line options
+ */
+void ParseOptions(int argc, char *argv[], options *opts) {
+  static struct option long_options[] = {
+      {"batch-size", required_argument, 0, 'b'},
+      {"bursts", required_argument, 0, 'c'},
+      {"burst-size", required_argument, 0, 's'},
+      {"help", no_argument, 0, 'h'},
+      {"port", required_argument, 0, 'p'},
+      {0, 0, 0, 0}
+    };
+
+  int option_index = 0;
+  while (1) {
+    int c = getopt_long(argc, argv, "b:c:hp:s:", long_options, &option_index);
+    if (c == -1)
+      break;
+
+    switch (c) {
+      case 0:
+        break;
+      case 'b':
+        ola::StringToInt(optarg, &opts->batch_size);
+        break;
+      case 'c':
+        ola::StringToInt(optarg, &opts->bursts);
+        break;
+      case 'h':
+        DisplayHelpAndExit(argv);
+        break;
+      case 'p':
+        ola::StringToInt(optarg, &opts->port);
+        break;
+      case 's':
+        ola::StringToInt(optarg, &opts->burst_size);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+
+int main(int argc, char *argv[]) {
+  options opts;
+  opts.bursts = 2000;
+  opts.burst_size = 64;
+  opts.batch_size = 32;
+  opts.port = 8899;
+  ParseOptions(argc, argv, &opts);
+  ola::InitLogging(ola::OLA_LOG_WARN, ola::OLA_LOG_STDERR);
+
+  double single_rate = RunBenchmark(false, opts);
+  double batch_rate = RunBenchmark(true, opts);
+  cout << "  speedup: " << batch_rate / single_rate << endl;
+}
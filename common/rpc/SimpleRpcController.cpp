@@ -35,6 +35,7 @@ SimpleRpcController::SimpleRpcController()
 void SimpleRpcController::Reset() {
   m_failed = false;
   m_cancelled = false;
+  m_error_text.clear();
   if (m_callback)
     OLA_FATAL << "calling reset() while an rpc is in progress, we're " <<
       "leaking memory!";
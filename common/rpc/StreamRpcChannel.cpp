@@ -19,11 +19,16 @@
  */
 
 #include <errno.h>
+#include <string.h>
 #include <google/protobuf/service.h>
 #include <google/protobuf/message.h>
 #include <google/protobuf/descriptor.h>
 #include <google/protobuf/dynamic_message.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <map>
 #include <string>
+#include <vector>
 
 #include "common/rpc/Rpc.pb.h"
 #include "common/rpc/SimpleRpcController.h"
@@ -36,9 +41,12 @@ namespace ola {
 namespace rpc {
 
 using google::protobuf::ServiceDescriptor;
+using google::protobuf::internal::WireFormatLite;
+using google::protobuf::io::CodedInputStream;
 
 const char StreamRpcChannel::K_RPC_RECEIVED_TYPE_VAR[] = "rpc-received-type";
 const char StreamRpcChannel::K_RPC_RECEIVED_VAR[] = "rpc-received";
+const char StreamRpcChannel::K_RPC_SEND_DROPPED_VAR[] = "rpc-send-dropped";
 const char StreamRpcChannel::K_RPC_SENT_ERROR_VAR[] = "rpc-send-errors";
 const char StreamRpcChannel::K_RPC_SENT_VAR[] = "rpc-sent";
 const char StreamRpcChannel::STREAMING_NO_RESPONSE[] = "STREAMING_NO_RESPONSE";
@@ -55,6 +63,14 @@ StreamRpcChannel::StreamRpcChannel(
       m_buffer_size(0),
       m_expected_size(0),
       m_current_size(0),
+      m_ss(NULL),
+      m_output(NULL),
+      m_output_size(0),
+      m_output_offset(0),
+      m_output_length(0),
+      m_high_water_mark(DEFAULT_HIGH_WATER_MARK),
+      m_write_registered(false),
+      m_send_message(new RpcMessage()),
       m_export_map(export_map),
       m_recv_type_map(NULL) {
   descriptor->SetOnData(
@@ -63,6 +79,7 @@ StreamRpcChannel::StreamRpcChannel(
   // init the counters
   const char *vars[] = {
     K_RPC_RECEIVED_VAR,
+    K_RPC_SEND_DROPPED_VAR,
     K_RPC_SENT_ERROR_VAR,
     K_RPC_SENT_VAR,
   };
@@ -76,10 +93,31 @@ StreamRpcChannel::StreamRpcChannel(
 }
 
 
+/*
+ * The descriptor must still exist when the channel is deleted.
+ */
 StreamRpcChannel::~StreamRpcChannel() {
+  if (m_write_registered)
+    m_ss->RemoveWriteDescriptor(m_descriptor);
   if (m_on_close)
     delete m_on_close;
   free(m_buffer);
+  free(m_output);
+  delete m_send_message;
+
+  std::map<const MethodDescriptor*, Message*>::iterator iter =
+    m_request_messages.begin();
+  for (; iter != m_request_messages.end(); ++iter)
+    delete iter->second;
+
+  std::vector<OutstandingRequest*>::iterator request_iter =
+    m_free_requests.begin();
+  for (; request_iter != m_free_requests.end(); ++request_iter) {
+    delete (*request_iter)->controller;
+    delete (*request_iter)->response;
+    delete (*request_iter)->callback;
+    delete *request_iter;
+  }
 }
 
 
@@ -128,6 +166,7 @@ void StreamRpcChannel::DescriptorReady() {
       // this probably means we've messed the framing up, close the channel
       OLA_WARN << "Errors detected on RPC channel, closing";
       m_descriptor->Close();
+      UpdateWriteRegistration();
     }
     m_expected_size = 0;
   }
@@ -149,8 +188,25 @@ void StreamRpcChannel::SetOnClose(SingleUseCallback0<void> *closure) {
 
 
 /*
- * Call a method with the given request and reply
- * TODO(simonn): reduce the number of copies here
+ * Set the SelectServer used to wait for the descriptor to become writable.
+ */
+void StreamRpcChannel::SetSelectServer(
+    ola::network::SelectServerInterface *ss) {
+  if (m_write_registered) {
+    m_ss->RemoveWriteDescriptor(m_descriptor);
+    m_write_registered = false;
+  }
+  m_ss = ss;
+  if (m_ss)
+    m_descriptor->SetOnWritable(
+        ola::NewCallback(this, &StreamRpcChannel::DescriptorWritable));
+  UpdateWriteRegistration();
+}
+
+
+/*
+ * Call a method with the given request and reply. Streaming requests are
+ * dropped if the peer isn't keeping up.
  */
 void StreamRpcChannel::CallMethod(
     const MethodDescriptor *method,
@@ -158,8 +214,7 @@ void StreamRpcChannel::CallMethod(
     const Message *request,
     Message *reply,
     google::protobuf::Closure *done) {
-  string output;
-  RpcMessage message;
+  RpcMessage *message = m_send_message;
   bool is_streaming = false;
 
   // Streaming methods are those with a reply set to STREAMING_NO_RESPONSE and
@@ -171,15 +226,22 @@ void StreamRpcChannel::CallMethod(
       return;
     }
     is_streaming = true;
+
+    if (OutputBlocked()) {
+      if (m_export_map)
+        (*m_export_map->GetCounterVar(K_RPC_SEND_DROPPED_VAR))++;
+      return;
+    }
   }
 
-  message.set_type(is_streaming ? STREAM_REQUEST : REQUEST);
-  message.set_id(m_seq++);
-  message.set_name(method->name());
+  uint32_t id = m_seq++;
+  message->Clear();
+  message->set_type(is_streaming ? STREAM_REQUEST : REQUEST);
+  message->set_id(id);
+  message->set_name(method->name());
 
-  request->SerializeToString(&output);
-  message.set_buffer(output);
-  bool r = SendMsg(&message);
+  request->SerializeToString(message->mutable_buffer());
+  bool r = SendMsg(message);
 
   if (is_streaming)
     return;
@@ -191,7 +253,7 @@ void StreamRpcChannel::CallMethod(
     return;
   }
 
-  OutstandingResponse *response = GetOutstandingResponse(message.id());
+  OutstandingResponse *response = GetOutstandingResponse(id);
   if (response) {
     // fail any outstanding response with the same id
     OLA_WARN << "response " << response->id << " already pending, failing " <<
@@ -201,11 +263,11 @@ void StreamRpcChannel::CallMethod(
   }
 
   response = new OutstandingResponse();
-  response->id = message.id();
+  response->id = id;
   response->controller = controller;
   response->callback = done;
   response->reply = reply;
-  m_responses[message.id()] = response;
+  m_responses[id] = response;
 }
 
 
@@ -213,19 +275,16 @@ void StreamRpcChannel::CallMethod(
  * Called when a response is ready.
  */
 void StreamRpcChannel::RequestComplete(OutstandingRequest *request) {
-  string output;
-  RpcMessage message;
-
   if (request->controller->Failed()) {
     SendRequestFailed(request);
     return;
   }
 
-  message.set_type(RESPONSE);
-  message.set_id(request->id);
-  request->response->SerializeToString(&output);
-  message.set_buffer(output);
-  SendMsg(&message);
+  m_send_message->Clear();
+  m_send_message->set_type(RESPONSE);
+  m_send_message->set_id(request->id);
+  request->response->SerializeToString(m_send_message->mutable_buffer());
+  SendMsg(m_send_message);
   DeleteOutstandingRequest(request);
 }
 
@@ -234,7 +293,9 @@ void StreamRpcChannel::RequestComplete(OutstandingRequest *request) {
 //-----------------------------------------------------------------------------
 
 /*
- * Write an RpcMessage to the write descriptor.
+ * Write an RpcMessage to the output buffer, the header & message are
+ * serialized together so they go out in a single write.
+ * @returns false if the channel has failed
  */
 bool StreamRpcChannel::SendMsg(RpcMessage *msg) {
   if (!m_descriptor->ValidReadDescriptor()) {
@@ -242,38 +303,135 @@ bool StreamRpcChannel::SendMsg(RpcMessage *msg) {
     return false;
   }
 
-  string output;
-  msg->SerializeToString(&output);
-  int length = output.length();
-  uint32_t header;
-  StreamRpcHeader::EncodeHeader(&header, PROTOCOL_VERSION, length);
-
-  ssize_t ret = m_descriptor->Send(reinterpret_cast<const uint8_t*>(&header),
-                                   sizeof(header));
-  ret = m_descriptor->Send(reinterpret_cast<const uint8_t*>(output.data()),
-                           length);
-
-  if (ret != length) {
-    if (ret == -1)
-      OLA_WARN << "Send failed " << strerror(errno);
-    else
-      OLA_WARN << "Failed to send full datagram, closing channel";
-    // At the point framing is screwed and we should shut the channel down
-    m_descriptor->Close();
-    if (m_on_close)
-      m_on_close->Run();
-
-    if (m_export_map)
-      (*m_export_map->GetCounterVar(K_RPC_SENT_ERROR_VAR))++;
+  uint32_t length = msg->ByteSize();
+  uint8_t *output = ReserveOutput(sizeof(uint32_t) + length);
+  if (!output) {
+    OLA_WARN << "Output buffer full, closing channel";
+    CloseChannel();
     return false;
   }
 
+  uint32_t header;
+  StreamRpcHeader::EncodeHeader(&header, PROTOCOL_VERSION, length);
+  memcpy(output, &header, sizeof(header));
+  msg->SerializeWithCachedSizesToArray(output + sizeof(header));
+  m_output_length += sizeof(header) + length;
+
   if (m_export_map)
     (*m_export_map->GetCounterVar(K_RPC_SENT_VAR))++;
+
+  // if we're waiting for the descriptor this goes out with everything else
+  if (m_write_registered)
+    return true;
+  return FlushOutput();
+}
+
+
+/*
+ * Make room for size bytes at the end of the output buffer.
+ * @returns a pointer to the space, or NULL if the buffer would be larger than
+ * MAX_BUFFER_SIZE.
+ */
+uint8_t *StreamRpcChannel::ReserveOutput(unsigned int size) {
+  if (m_output_offset + m_output_length + size <= m_output_size)
+    return m_output + m_output_offset + m_output_length;
+
+  // move the unsent data to the start of the buffer
+  if (m_output_offset) {
+    memmove(m_output, m_output + m_output_offset, m_output_length);
+    m_output_offset = 0;
+  }
+
+  unsigned int required_size = m_output_length + size;
+  if (required_size > m_output_size) {
+    if (required_size > MAX_BUFFER_SIZE)
+      return NULL;
+
+    unsigned int new_size = m_output_size ? m_output_size : INITIAL_BUFFER_SIZE;
+    while (new_size < required_size)
+      new_size *= 2;
+    if (new_size > MAX_BUFFER_SIZE)
+      new_size = MAX_BUFFER_SIZE;
+
+    uint8_t *new_output = static_cast<uint8_t*>(realloc(m_output, new_size));
+    if (!new_output)
+      return NULL;
+    m_output = new_output;
+    m_output_size = new_size;
+  }
+  return m_output + m_output_length;
+}
+
+
+/*
+ * Write as much of the output buffer as the descriptor will take.
+ * @returns false if the write failed and the channel was closed.
+ */
+bool StreamRpcChannel::FlushOutput() {
+  if (m_output_length) {
+    ssize_t ret = m_descriptor->Send(m_output + m_output_offset,
+                                     m_output_length);
+    if (ret < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        OLA_WARN << "Send failed " << strerror(errno);
+        CloseChannel();
+        return false;
+      }
+    } else {
+      m_output_offset += ret;
+      m_output_length -= ret;
+    }
+  }
+
+  if (!m_output_length)
+    m_output_offset = 0;
+  UpdateWriteRegistration();
   return true;
 }
 
 
+/*
+ * Called when the descriptor can be written to.
+ */
+void StreamRpcChannel::DescriptorWritable() {
+  FlushOutput();
+}
+
+
+/*
+ * Wait for the descriptor to become writable if there's unsent data.
+ */
+void StreamRpcChannel::UpdateWriteRegistration() {
+  if (!m_ss)
+    return;
+
+  bool waiting = m_output_length && m_descriptor->ValidWriteDescriptor();
+  if (waiting && !m_write_registered) {
+    m_write_registered = m_ss->AddWriteDescriptor(m_descriptor);
+  } else if (!waiting && m_write_registered) {
+    m_ss->RemoveWriteDescriptor(m_descriptor);
+    m_write_registered = false;
+  }
+}
+
+
+/*
+ * Close the channel after a write failed. At this point the framing is
+ * broken.
+ */
+void StreamRpcChannel::CloseChannel() {
+  m_output_offset = 0;
+  m_output_length = 0;
+  UpdateWriteRegistration();
+  m_descriptor->Close();
+  if (m_on_close)
+    m_on_close->Run();
+
+  if (m_export_map)
+    (*m_export_map->GetCounterVar(K_RPC_SENT_ERROR_VAR))++;
+}
+
+
 /*
  * Allocate an incomming message buffer
  * @param size the size of the new buffer to allocate
@@ -326,12 +484,68 @@ int StreamRpcChannel::ReadHeader(unsigned int *version,
 }
 
 
+/*
+ * Parse the RpcMessage envelope. This decodes the fields by hand so the name
+ * string is reused and the buffer isn't copied.
+ * @returns false if the message is malformed
+ */
+bool StreamRpcChannel::ParseMessage(const uint8_t *data, unsigned int size,
+                                    received_message *msg) {
+  CodedInputStream input(data, size);
+  bool has_type = false;
+  msg->type = 0;
+  msg->id = 0;
+  msg->name.clear();
+  msg->buffer = data;
+  msg->buffer_size = 0;
+
+  uint32_t tag;
+  while ((tag = input.ReadTag())) {
+    WireFormatLite::WireType wire_type = WireFormatLite::GetTagWireType(tag);
+    uint32_t value;
+    switch (WireFormatLite::GetTagFieldNumber(tag)) {
+      case RpcMessage::kTypeFieldNumber:
+        if (wire_type != WireFormatLite::WIRETYPE_VARINT ||
+            !input.ReadVarint32(&value))
+          return false;
+        msg->type = value;
+        has_type = true;
+        break;
+      case RpcMessage::kIdFieldNumber:
+        if (wire_type != WireFormatLite::WIRETYPE_VARINT ||
+            !input.ReadVarint32(&value))
+          return false;
+        msg->id = value;
+        break;
+      case RpcMessage::kNameFieldNumber:
+        if (wire_type != WireFormatLite::WIRETYPE_LENGTH_DELIMITED ||
+            !input.ReadVarint32(&value) ||
+            !input.ReadString(&msg->name, value))
+          return false;
+        break;
+      case RpcMessage::kBufferFieldNumber:
+        if (wire_type != WireFormatLite::WIRETYPE_LENGTH_DELIMITED ||
+            !input.ReadVarint32(&value) ||
+            value > size - input.CurrentPosition())
+          return false;
+        msg->buffer = data + input.CurrentPosition();
+        msg->buffer_size = value;
+        input.Skip(value);
+        break;
+      default:
+        if (!WireFormatLite::SkipField(&input, tag))
+          return false;
+    }
+  }
+  return has_type && input.ConsumedEntireMessage();
+}
+
+
 /*
  * Parse a new message and handle it.
  */
 bool StreamRpcChannel::HandleNewMsg(uint8_t *data, unsigned int size) {
-  RpcMessage msg;
-  if (!msg.ParseFromArray(data, size)) {
+  if (!ParseMessage(data, size, &m_received)) {
     OLA_WARN << "Failed to parse RPC";
     return false;
   }
@@ -339,39 +553,39 @@ bool StreamRpcChannel::HandleNewMsg(uint8_t *data, unsigned int size) {
   if (m_export_map)
     (*m_export_map->GetCounterVar(K_RPC_RECEIVED_VAR))++;
 
-  switch (msg.type()) {
+  switch (m_received.type) {
     case REQUEST:
       if (m_recv_type_map)
         (*m_recv_type_map)["request"]++;
-      HandleRequest(&msg);
+      HandleRequest(m_received);
       break;
     case RESPONSE:
       if (m_recv_type_map)
         (*m_recv_type_map)["response"]++;
-      HandleResponse(&msg);
+      HandleResponse(m_received);
       break;
     case RESPONSE_CANCEL:
       if (m_recv_type_map)
         (*m_recv_type_map)["cancelled"]++;
-      HandleCanceledResponse(&msg);
+      HandleCanceledResponse(m_received);
       break;
     case RESPONSE_FAILED:
       if (m_recv_type_map)
         (*m_recv_type_map)["failed"]++;
-      HandleFailedResponse(&msg);
+      HandleFailedResponse(m_received);
       break;
     case RESPONSE_NOT_IMPLEMENTED:
       if (m_recv_type_map)
         (*m_recv_type_map)["not-implemented"]++;
-      HandleNotImplemented(&msg);
+      HandleNotImplemented(m_received);
       break;
     case STREAM_REQUEST:
       if (m_recv_type_map)
         (*m_recv_type_map)["stream_request"]++;
-      HandleStreamRequest(&msg);
+      HandleStreamRequest(m_received);
       break;
     default:
-      OLA_WARN << "not sure of msg type " << msg.type();
+      OLA_WARN << "not sure of msg type " << m_received.type;
       break;
   }
   return true;
@@ -379,78 +593,74 @@ bool StreamRpcChannel::HandleNewMsg(uint8_t *data, unsigned int size) {
 
 
 /*
- * Handle a new RPC method call.
+ * Find the method a request is for.
+ * @returns the MethodDescriptor or NULL if the method doesn't exist
  */
-void StreamRpcChannel::HandleRequest(RpcMessage *msg) {
+const MethodDescriptor *StreamRpcChannel::FindMethod(
+    const received_message &msg) {
   if (!m_service) {
     OLA_WARN << "no service registered";
-    return;
+    return NULL;
   }
 
   const ServiceDescriptor *service = m_service->GetDescriptor();
   if (!service) {
     OLA_WARN << "failed to get service descriptor";
-    return;
+    return NULL;
   }
-  const MethodDescriptor *method = service->FindMethodByName(msg->name());
+  const MethodDescriptor *method = service->FindMethodByName(msg.name);
   if (!method) {
     OLA_WARN << "failed to get method descriptor";
-    SendNotImplemented(msg->id());
-    return;
+    SendNotImplemented(msg.id);
   }
+  return method;
+}
+
 
-  Message* request_pb = m_service->GetRequestPrototype(method).New();
-  Message* response_pb = m_service->GetResponsePrototype(method).New();
+/*
+ * Handle a new RPC method call.
+ */
+void StreamRpcChannel::HandleRequest(const received_message &msg) {
+  const MethodDescriptor *method = FindMethod(msg);
+  if (!method)
+    return;
 
-  if (!request_pb || !response_pb) {
-    OLA_WARN << "failed to get request or response objects";
+  Message *request_pb = GetRequestMessage(method);
+  if (!request_pb) {
+    OLA_WARN << "failed to get request object";
     return;
   }
 
-  if (!request_pb->ParseFromString(msg->buffer())) {
+  if (!request_pb->ParseFromArray(msg.buffer, msg.buffer_size)) {
     OLA_WARN << "parsing of request pb failed";
     return;
   }
 
-  OutstandingRequest *request = new OutstandingRequest();
-  request->id = msg->id();
-  request->controller = new SimpleRpcController();
-  request->response = response_pb;
+  OutstandingRequest *request = NewOutstandingRequest(method);
+  if (!request) {
+    OLA_WARN << "failed to get response object";
+    return;
+  }
+  request->id = msg.id;
 
-  if (m_requests.find(msg->id()) != m_requests.end()) {
-    OLA_WARN << "dup sequence number for request " << msg->id();
-    SendRequestFailed(m_requests[msg->id()]);
+  if (m_requests.find(msg.id) != m_requests.end()) {
+    OLA_WARN << "dup sequence number for request " << msg.id;
+    SendRequestFailed(m_requests[msg.id]);
   }
 
-  m_requests[msg->id()] = request;
-  google::protobuf::Closure *callback = NewCallback(
-      this, &StreamRpcChannel::RequestComplete, request);
-  m_service->CallMethod(method, request->controller, request_pb, response_pb,
-                        callback);
-  delete request_pb;
+  m_requests[msg.id] = request;
+  m_service->CallMethod(method, request->controller, request_pb,
+                        request->response, request->callback);
 }
 
 
 /*
  * Handle a streaming RPC call. This doesn't return any response to the client.
  */
-void StreamRpcChannel::HandleStreamRequest(RpcMessage *msg) {
-  if (!m_service) {
-    OLA_WARN << "no service registered";
-    return;
-  }
-
-  const ServiceDescriptor *service = m_service->GetDescriptor();
-  if (!service) {
-    OLA_WARN << "failed to get service descriptor";
+void StreamRpcChannel::HandleStreamRequest(const received_message &msg) {
+  const MethodDescriptor *method = FindMethod(msg);
+  if (!method)
     return;
-  }
-  const MethodDescriptor *method = service->FindMethodByName(msg->name());
-  if (!method) {
-    OLA_WARN << "failed to get method descriptor";
-    SendNotImplemented(msg->id());
-    return;
-  }
 
   if (method->output_type()->name() != STREAMING_NO_RESPONSE) {
     OLA_WARN << "Streaming request recieved for " << method->name() <<
@@ -458,33 +668,83 @@ void StreamRpcChannel::HandleStreamRequest(RpcMessage *msg) {
     return;
   }
 
-  Message* request_pb = m_service->GetRequestPrototype(method).New();
-
+  Message *request_pb = GetRequestMessage(method);
   if (!request_pb) {
-    OLA_WARN << "failed to get request or response objects";
+    OLA_WARN << "failed to get request object";
     return;
   }
 
-  if (!request_pb->ParseFromString(msg->buffer())) {
+  if (!request_pb->ParseFromArray(msg.buffer, msg.buffer_size)) {
     OLA_WARN << "parsing of request pb failed";
     return;
   }
 
   m_service->CallMethod(method, NULL, request_pb, NULL, NULL);
-  delete request_pb;
 }
 
 
 // server side
+/*
+ * Get the request message for a method. Services don't keep the request once
+ * CallMethod returns so there's one message per method that is parsed into
+ * each time.
+ */
+Message *StreamRpcChannel::GetRequestMessage(const MethodDescriptor *method) {
+  std::map<const MethodDescriptor*, Message*>::iterator iter =
+    m_request_messages.find(method);
+  if (iter != m_request_messages.end())
+    return iter->second;
+
+  Message *request_pb = m_service->GetRequestPrototype(method).New();
+  if (request_pb)
+    m_request_messages[method] = request_pb;
+  return request_pb;
+}
+
+
+/*
+ * Get an OutstandingRequest for a method, reusing a completed one if there is
+ * one. The response is cleared, or replaced if it's for a different method.
+ */
+OutstandingRequest *StreamRpcChannel::NewOutstandingRequest(
+    const MethodDescriptor *method) {
+  OutstandingRequest *request;
+  if (m_free_requests.empty()) {
+    request = new OutstandingRequest();
+    request->controller = new SimpleRpcController();
+    request->callback = google::protobuf::NewPermanentCallback(
+        this, &StreamRpcChannel::RequestComplete, request);
+  } else {
+    request = m_free_requests.back();
+    m_free_requests.pop_back();
+    request->controller->Reset();
+  }
+
+  if (request->method == method) {
+    request->response->Clear();
+  } else {
+    delete request->response;
+    request->response = m_service->GetResponsePrototype(method).New();
+    request->method = method;
+    if (!request->response) {
+      request->method = NULL;
+      m_free_requests.push_back(request);
+      return NULL;
+    }
+  }
+  return request;
+}
+
+
 /*
  * Notify the caller that the request failed.
  */
 void StreamRpcChannel::SendRequestFailed(OutstandingRequest *request) {
-  RpcMessage message;
-  message.set_type(RESPONSE_FAILED);
-  message.set_id(request->id);
-  message.set_buffer(request->controller->ErrorText());
-  SendMsg(&message);
+  m_send_message->Clear();
+  m_send_message->set_type(RESPONSE_FAILED);
+  m_send_message->set_id(request->id);
+  m_send_message->set_buffer(request->controller->ErrorText());
+  SendMsg(m_send_message);
   DeleteOutstandingRequest(request);
 }
 
@@ -493,20 +753,26 @@ void StreamRpcChannel::SendRequestFailed(OutstandingRequest *request) {
  * Sent if we get a request for a non-existant method.
  */
 void StreamRpcChannel::SendNotImplemented(int msg_id) {
-  RpcMessage message;
-  message.set_type(RESPONSE_NOT_IMPLEMENTED);
-  message.set_id(msg_id);
-  SendMsg(&message);
+  m_send_message->Clear();
+  m_send_message->set_type(RESPONSE_NOT_IMPLEMENTED);
+  m_send_message->set_id(msg_id);
+  SendMsg(m_send_message);
 }
 
 
 /*
- * Cleanup an outstanding request after the response has been returned
+ * Cleanup an outstanding request after the response has been returned. The
+ * request is kept for reuse unless we already have enough spare ones.
  */
 void StreamRpcChannel::DeleteOutstandingRequest(OutstandingRequest *request) {
   m_requests.erase(request->id);
+  if (m_free_requests.size() < MAX_FREE_REQUESTS) {
+    m_free_requests.push_back(request);
+    return;
+  }
   delete request->controller;
   delete request->response;
+  delete request->callback;
   delete request;
 }
 
@@ -515,10 +781,10 @@ void StreamRpcChannel::DeleteOutstandingRequest(OutstandingRequest *request) {
 /*
  * Handle a RPC response by invoking the callback.
  */
-void StreamRpcChannel::HandleResponse(RpcMessage *msg) {
-  OutstandingResponse *response = GetOutstandingResponse(msg->id());
+void StreamRpcChannel::HandleResponse(const received_message &msg) {
+  OutstandingResponse *response = GetOutstandingResponse(msg.id);
   if (response) {
-    response->reply->ParseFromString(msg->buffer());
+    response->reply->ParseFromArray(msg.buffer, msg.buffer_size);
     InvokeCallbackAndCleanup(response);
   }
 }
@@ -527,10 +793,11 @@ void StreamRpcChannel::HandleResponse(RpcMessage *msg) {
 /*
  * Handle a RPC response by invoking the callback.
  */
-void StreamRpcChannel::HandleFailedResponse(RpcMessage *msg) {
-  OutstandingResponse *response = GetOutstandingResponse(msg->id());
+void StreamRpcChannel::HandleFailedResponse(const received_message &msg) {
+  OutstandingResponse *response = GetOutstandingResponse(msg.id);
   if (response) {
-    response->controller->SetFailed(msg->buffer());
+    response->controller->SetFailed(
+        string(reinterpret_cast<const char*>(msg.buffer), msg.buffer_size));
     InvokeCallbackAndCleanup(response);
   }
 }
@@ -539,11 +806,12 @@ void StreamRpcChannel::HandleFailedResponse(RpcMessage *msg) {
 /*
  * Handle a RPC response by invoking the callback.
  */
-void StreamRpcChannel::HandleCanceledResponse(RpcMessage *msg) {
+void StreamRpcChannel::HandleCanceledResponse(const received_message &msg) {
   OLA_INFO << "Received a canceled response";
-  OutstandingResponse *response = GetOutstandingResponse(msg->id());
+  OutstandingResponse *response = GetOutstandingResponse(msg.id);
   if (response) {
-    response->controller->SetFailed(msg->buffer());
+    response->controller->SetFailed(
+        string(reinterpret_cast<const char*>(msg.buffer), msg.buffer_size));
     InvokeCallbackAndCleanup(response);
   }
 }
@@ -552,9 +820,9 @@ void StreamRpcChannel::HandleCanceledResponse(RpcMessage *msg) {
 /*
  * Handle a NOT_IMPLEMENTED by invoking the callback.
  */
-void StreamRpcChannel::HandleNotImplemented(RpcMessage *msg) {
+void StreamRpcChannel::HandleNotImplemented(const received_message &msg) {
   OLA_INFO << "Received a non-implemented response";
-  OutstandingResponse *response = GetOutstandingResponse(msg->id());
+  OutstandingResponse *response = GetOutstandingResponse(msg.id);
   if (response) {
     response->controller->SetFailed("Not Implemented");
     InvokeCallbackAndCleanup(response);
@@ -23,6 +23,9 @@
 
 #include <stdint.h>
 #include <google/protobuf/service.h>
+#include <map>
+#include <string>
+#include <vector>
 #include <ola/network/Socket.h>
 #include <ola/network/SelectServer.h>
 #include <ola/Callback.h>
@@ -46,12 +49,22 @@ class OutstandingRequest {
    * These are requests on the server end that haven't completed yet.
    */
   public:
-    OutstandingRequest() {}
+    OutstandingRequest()
+        : id(0),
+          controller(NULL),
+          response(NULL),
+          method(NULL),
+          callback(NULL) {
+    }
     ~OutstandingRequest() {}
 
     int id;
     RpcController *controller;
     Message *response;
+    // Requests are reused once they complete. The response is kept if the
+    // next request is for the same method, the callback is always kept.
+    const MethodDescriptor *method;
+    google::protobuf::Closure *callback;
 };
 
 class OutstandingResponse {
@@ -107,26 +120,59 @@ class StreamRpcChannel: public RpcChannel {
 
     void RequestComplete(OutstandingRequest *request);
     void SetService(Service *service) { m_service = service; }
+
+    // Output that can't be written straight away is buffered. If a select
+    // server is provided it's written once the descriptor is writable,
+    // otherwise it's written on the next send.
+    void SetSelectServer(ola::network::SelectServerInterface *ss);
+    // Streaming requests are dropped once more than this many bytes are
+    // buffered.
+    void SetHighWaterMark(unsigned int bytes) { m_high_water_mark = bytes; }
+    // True if the peer isn't keeping up, senders that can drop data should
+    // hold off.
+    bool OutputBlocked() const {
+      return m_output_length > m_high_water_mark;
+    }
     static const unsigned int PROTOCOL_VERSION = 1;
 
   private:
+    // An RpcMessage that has been received, the buffer points into the
+    // receive buffer so requests can be parsed without another copy.
+    typedef struct {
+      int type;
+      int id;
+      std::string name;
+      const uint8_t *buffer;
+      unsigned int buffer_size;
+    } received_message;
+
     bool SendMsg(RpcMessage *msg);
+    uint8_t *ReserveOutput(unsigned int size);
+    bool FlushOutput();
+    void DescriptorWritable();
+    void UpdateWriteRegistration();
+    void CloseChannel();
     int AllocateMsgBuffer(unsigned int size);
     int ReadHeader(unsigned int *version, unsigned int *size) const;
+    bool ParseMessage(const uint8_t *data, unsigned int size,
+                      received_message *msg);
     bool HandleNewMsg(uint8_t *buffer, unsigned int size);
-    void HandleRequest(RpcMessage *msg);
-    void HandleStreamRequest(RpcMessage *msg);
+    const MethodDescriptor *FindMethod(const received_message &msg);
+    void HandleRequest(const received_message &msg);
+    void HandleStreamRequest(const received_message &msg);
 
     // server end
+    Message *GetRequestMessage(const MethodDescriptor *method);
+    OutstandingRequest *NewOutstandingRequest(const MethodDescriptor *method);
     void SendRequestFailed(OutstandingRequest *request);
     void SendNotImplemented(int msg_id);
     void DeleteOutstandingRequest(OutstandingRequest *request);
 
     // client end
-    void HandleResponse(RpcMessage *msg);
-    void HandleFailedResponse(RpcMessage *msg);
-    void HandleCanceledResponse(RpcMessage *msg);
-    void HandleNotImplemented(RpcMessage *msg);
+    void HandleResponse(const received_message &msg);
+    void HandleFailedResponse(const received_message &msg);
+    void HandleCanceledResponse(const received_message &msg);
+    void HandleNotImplemented(const received_message &msg);
     OutstandingResponse *GetOutstandingResponse(int msg_id);
     void InvokeCallbackAndCleanup(OutstandingResponse *response);
 
@@ -139,6 +185,21 @@ class StreamRpcChannel: public RpcChannel {
     unsigned int m_buffer_size;  // size of the buffer
     unsigned int m_expected_size;  // the total size of the current msg
     unsigned int m_current_size;  // the amount of data read for the current msg
+    ola::network::SelectServerInterface *m_ss;
+    uint8_t *m_output;  // buffer for outgoing msgs
+    unsigned int m_output_size;  // size of the output buffer
+    unsigned int m_output_offset;  // start of the unsent data
+    unsigned int m_output_length;  // amount of unsent data
+    unsigned int m_high_water_mark;
+    bool m_write_registered;  // true if we're waiting for the descriptor
+    // Messages are reused so that sending & receiving doesn't allocate once
+    // the strings have grown.
+    RpcMessage *m_send_message;
+    received_message m_received;
+    // one request message per method, the service doesn't keep them after
+    // CallMethod returns
+    std::map<const MethodDescriptor*, Message*> m_request_messages;
+    std::vector<OutstandingRequest*> m_free_requests;
     HASH_NAMESPACE::HASH_MAP_CLASS<int, OutstandingRequest*> m_requests;
     HASH_NAMESPACE::HASH_MAP_CLASS<int, OutstandingResponse*> m_responses;
     ExportMap *m_export_map;
@@ -146,11 +207,14 @@ class StreamRpcChannel: public RpcChannel {
 
     static const char K_RPC_RECEIVED_TYPE_VAR[];
     static const char K_RPC_RECEIVED_VAR[];
+    static const char K_RPC_SEND_DROPPED_VAR[];
     static const char K_RPC_SENT_ERROR_VAR[];
     static const char K_RPC_SENT_VAR[];
     static const char STREAMING_NO_RESPONSE[];
     static const unsigned int INITIAL_BUFFER_SIZE = 1 << 11;  // 2k
     static const unsigned int MAX_BUFFER_SIZE = 1 << 20;  // 1M
+    static const unsigned int DEFAULT_HIGH_WATER_MARK = 1 << 16;  // 64k
+    static const unsigned int MAX_FREE_REQUESTS = 16;
 };
 }  // rpc
 }  // ola
@@ -20,7 +20,9 @@
 
 #include <cppunit/extensions/HelperMacros.h>
 #include <google/protobuf/stubs/common.h>
+#include <sys/socket.h>
 #include <string>
+#include <vector>
 #include "ola/network/SelectServer.h"
 #include "ola/network/Socket.h"
 #include "common/rpc/StreamRpcChannel.h"
@@ -30,6 +32,7 @@
 using google::protobuf::NewCallback;
 using ola::network::LoopbackDescriptor;
 using ola::network::SelectServer;
+using ola::network::UnixSocket;
 using ola::rpc::EchoReply;
 using ola::rpc::EchoRequest;
 using ola::rpc::STREAMING_NO_RESPONSE;
@@ -38,6 +41,7 @@ using ola::rpc::StreamRpcChannel;
 using ola::rpc::TestService;
 using ola::rpc::TestService_Stub;
 using std::string;
+using std::vector;
 
 /*
  * Our test implementation
@@ -72,6 +76,8 @@ class StreamRpcChannelTest: public CppUnit::TestFixture {
   CPPUNIT_TEST(testEcho);
   CPPUNIT_TEST(testFailedEcho);
   CPPUNIT_TEST(testStreamRequest);
+  CPPUNIT_TEST(testReusedRequests);
+  CPPUNIT_TEST(testBufferedOutput);
   CPPUNIT_TEST_SUITE_END();
 
   public:
@@ -80,6 +86,8 @@ class StreamRpcChannelTest: public CppUnit::TestFixture {
     void testEcho();
     void testFailedEcho();
     void testStreamRequest();
+    void testReusedRequests();
+    void testBufferedOutput();
     void EchoComplete();
     void FailedEchoComplete();
 
@@ -133,6 +141,22 @@ void TestServiceImpl::Stream(::google::protobuf::RpcController* controller,
 }
 
 
+/*
+ * Records the data from each stream request.
+ */
+class RecordingServiceImpl: public TestService {
+  public:
+    void Stream(::google::protobuf::RpcController*,
+                const ::ola::rpc::EchoRequest* request,
+                STREAMING_NO_RESPONSE*,
+                ::google::protobuf::Closure*) {
+      frames.push_back(request->data());
+    }
+
+    vector<string> frames;
+};
+
+
 void StreamRpcChannelTest::setUp() {
   m_socket = new LoopbackDescriptor();
   m_socket->Init();
@@ -201,3 +225,90 @@ void StreamRpcChannelTest::testStreamRequest() {
   m_stub->Stream(NULL, &m_request, NULL, NULL);
   m_ss.Run();
 }
+
+
+/*
+ * Check that the requests the channel reuses don't carry state from one call
+ * to the next.
+ */
+void StreamRpcChannelTest::testReusedRequests() {
+  const char *data[] = {"foo", "bar", "baz"};
+  for (unsigned int i = 0; i < sizeof(data) / sizeof(data[0]); i++) {
+    m_controller.Reset();
+    m_reply.Clear();
+    m_request.set_data(data[i]);
+    m_stub->Echo(&m_controller,
+                 &m_request,
+                 &m_reply,
+                 NewCallback(this, &StreamRpcChannelTest::EchoComplete));
+    m_ss.Run();
+    CPPUNIT_ASSERT_EQUAL(string(data[i]), m_reply.data());
+
+    // a failed request in between, this must not fail the next echo
+    m_controller.Reset();
+    m_stub->FailedEcho(
+        &m_controller,
+        &m_request,
+        &m_reply,
+        NewCallback(this, &StreamRpcChannelTest::FailedEchoComplete));
+    m_ss.Run();
+  }
+}
+
+
+/*
+ * Check that frames sent faster than the other end reads them are buffered
+ * rather than closing the channel.
+ */
+void StreamRpcChannelTest::testBufferedOutput() {
+  const unsigned int frame_count = 10000;
+  const unsigned int high_water_mark = 8192;
+  UnixSocket sender;
+  CPPUNIT_ASSERT(sender.Init());
+  UnixSocket *receiver = sender.OppositeEnd();
+
+  // shrink the socket buffers so writes are short
+  int buffer_size = 2048;
+  CPPUNIT_ASSERT(!setsockopt(sender.WriteDescriptor(), SOL_SOCKET, SO_SNDBUF,
+                             &buffer_size, sizeof(buffer_size)));
+  CPPUNIT_ASSERT(!setsockopt(receiver->ReadDescriptor(), SOL_SOCKET,
+                             SO_RCVBUF, &buffer_size, sizeof(buffer_size)));
+
+  RecordingServiceImpl service;
+  StreamRpcChannel receiving_channel(&service, receiver);
+  StreamRpcChannel sending_channel(NULL, &sender);
+  sending_channel.SetSelectServer(&m_ss);
+  sending_channel.SetHighWaterMark(high_water_mark);
+  TestService_Stub stub(&sending_channel);
+  m_ss.AddReadDescriptor(receiver);
+
+  // a DMX frame's worth of data
+  string data(512, 'x');
+  EchoRequest request;
+  bool blocked = false;
+  for (unsigned int i = 0; i < frame_count; i++) {
+    while (sending_channel.OutputBlocked()) {
+      blocked = true;
+      m_ss.RunOnce(0, 10000);
+    }
+    data[i % data.size()] = 'a' + i % 26;
+    request.set_data(data);
+    stub.Stream(NULL, &request, NULL, NULL);
+  }
+
+  unsigned int loops = 0;
+  while (service.frames.size() < frame_count && loops++ < frame_count)
+    m_ss.RunOnce(0, 10000);
+
+  CPPUNIT_ASSERT(blocked);
+  CPPUNIT_ASSERT(sender.ValidWriteDescriptor());
+  CPPUNIT_ASSERT(!sending_channel.OutputBlocked());
+  CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(frame_count),
+                       service.frames.size());
+  // check the frames arrived in order
+  for (unsigned int i = 0; i < frame_count; i++)
+    CPPUNIT_ASSERT_EQUAL(static_cast<char>('a' + i % 26),
+                         service.frames[i][i % data.size()]);
+
+  m_ss.RemoveReadDescriptor(receiver);
+}
@@ -0,0 +1,285 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * rpc_stream_benchmark.cpp
+ * Measures how fast a StreamRpcChannel can receive DMX frames and how many
+ * allocations each frame needs.
+ * Copyright (C) 2012 Simon Newton
+ *
+ * The frames are encoded once and written straight to one end of a unix
+ * socket, so only the receiving channel and the service are measured.
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <iostream>
+#include <new>
+#include <string>
+
+#include "common/protocol/Ola.pb.h"
+#include "common/rpc/Rpc.pb.h"
+#include "common/rpc/StreamRpcChannel.h"
+#include "ola/BaseTypes.h"
+#include "ola/Clock.h"
+#include "ola/DmxBuffer.h"
+#include "ola/Logging.h"
+#include "ola/StringUtils.h"
+#include "ola/network/Socket.h"
+
+using ola::Clock;
+using ola::DmxBuffer;
+using ola::TimeInterval;
+using ola::TimeStamp;
+using ola::network::UnixSocket;
+using ola::rpc::RpcMessage;
+using ola::rpc::StreamRpcChannel;
+using ola::rpc::StreamRpcHeader;
+using std::cout;
+using std::endl;
+using std::string;
+
+
+// Count the allocations made while a run is being timed.
+static bool count_allocations = false;
+static uint64_t allocations = 0;
+
+#if __cplusplus >= 201103L
+#define THROW_BAD_ALLOC
+#else
+#define THROW_BAD_ALLOC throw(std::bad_alloc)
+#endif
+
+void *operator new(size_t size) THROW_BAD_ALLOC {
+  if (count_allocations)
+    allocations++;
+  void *ptr = malloc(size ? size : 1);
+  if (!ptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void operator delete(void *ptr) throw() {
+  free(ptr);
+}
+
+
+typedef struct {
+  unsigned int frames;
+  unsigned int batch_size;
+} options;
+
+
+/*
+ * Applies each frame the way olad does.
+ */
+class BenchmarkService: public ola::proto::OlaServerService {
+  public:
+    BenchmarkService() : frames(0) {}
+
+    void UpdateDmxData(google::protobuf::RpcController*,
+                       const ola::proto::DmxData *request,
+                       ola::proto::Ack*,
+                       google::protobuf::Closure *done) {
+      Apply(request);
+      done->Run();
+    }
+
+    void StreamDmxData(google::protobuf::RpcController*,
+                       const ola::proto::DmxData *request,
+                       ola::proto::STREAMING_NO_RESPONSE*,
+                       google::protobuf::Closure*) {
+      Apply(request);
+    }
+
+    unsigned int frames;
+
+  private:
+    DmxBuffer m_buffer;
+
+    void Apply(const ola::proto::DmxData *request) {
+      const string &data = request->data();
+      m_buffer.Set(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+      frames++;
+    }
+};
+
+
+/*
+ * Encode a batch of frames, each with a header, as they'd appear on the wire.
+ */
+void EncodeBatch(const string &method, ola::rpc::Type type,
+                 unsigned int batch_size, string *output) {
+  ola::proto::DmxData data;
+  data.set_universe(1);
+  string slots(DMX_UNIVERSE_SIZE, 0);
+  RpcMessage message;
+  string encoded;
+
+  for (unsigned int i = 0; i < batch_size; i++) {
+    slots[i % DMX_UNIVERSE_SIZE] = i;
+    data.set_data(slots);
+    message.set_type(type);
+    message.set_id(i);
+    message.set_name(method);
+    data.SerializeToString(message.mutable_buffer());
+    message.SerializeToString(&encoded);
+
+    uint32_t header;
+    StreamRpcHeader::EncodeHeader(&header, StreamRpcChannel::PROTOCOL_VERSION,
+                                  encoded.size());
+    output->append(reinterpret_cast<char*>(&header), sizeof(header));
+    output->append(encoded);
+  }
+}
+
+
+/*
+ * Write a batch to the socket and wait for the channel to handle all of it.
+ * Any responses are read and thrown away.
+ */
+void SendBatch(const string &batch, unsigned int batch_size,
+               UnixSocket *sender, StreamRpcChannel *channel,
+               BenchmarkService *service) {
+  const uint8_t *data = reinterpret_cast<const uint8_t*>(batch.data());
+  unsigned int offset = 0;
+  unsigned int target = service->frames + batch_size;
+  uint8_t discard[4096];
+
+  while (service->frames < target) {
+    if (offset < batch.size()) {
+      ssize_t sent = sender->Send(data + offset, batch.size() - offset);
+      if (sent > 0)
+        offset += sent;
+    }
+
+    UnixSocket *receiver = sender->OppositeEnd();
+    while (receiver->DataRemaining() && service->frames < target)
+      channel->DescriptorReady();
+
+    unsigned int data_read;
+    while (sender->DataRemaining())
+      sender->Receive(discard, sizeof(discard), data_read);
+  }
+}
+
+
+/*
+ * Time sending opts.frames frames to method.
+ */
+void RunBenchmark(const string &method, ola::rpc::Type type,
+                  const options &opts) {
+  UnixSocket sender;
+  if (!sender.Init()) {
+    OLA_WARN << "Failed to create the socket pair";
+    return;
+  }
+
+  BenchmarkService service;
+  StreamRpcChannel channel(&service, sender.OppositeEnd());
+  string batch;
+  EncodeBatch(method, type, opts.batch_size, &batch);
+
+  // the first batch grows the buffers
+  SendBatch(batch, opts.batch_size, &sender, &channel, &service);
+
+  Clock clock;
+  TimeStamp start, end;
+  unsigned int batches = opts.frames / opts.batch_size;
+  allocations = 0;
+  count_allocations = true;
+  clock.CurrentTime(&start);
+  for (unsigned int i = 0; i < batches; i++)
+    SendBatch(batch, opts.batch_size, &sender, &channel, &service);
+  clock.CurrentTime(&end);
+  count_allocations = false;
+
+  unsigned int frames = batches * opts.batch_size;
+  TimeInterval duration = end - start;
+  cout << method << ": " << frames << " frames in " << duration << ", " <<
+    frames * 1000000.0 / duration.AsInt() << " frames/s, " <<
+    static_cast<double>(allocations) / frames << " allocations/frame" <<
+    endl;
+}
+
+
+/*
+ * Display the help message
+ */
+void DisplayHelpAndExit(char *argv[]) {
+  cout << "Usage: " << argv[0] << " [options]\n"
+  "\n"
+  "Time how fast a StreamRpcChannel receives StreamDmxData and UpdateDmxData\n"
+  "requests over a unix socket, and count the allocations per frame.\n"
+  "\n"
+  "  -b, --batch <count>    The number of frames to write at once.\n"
+  "  -f, --frames <count>   The number of frames to send.\n"
+  "  -h, --help             Display this help message and exit.\n"
+  << endl;
+  exit(0);
+}
+
+
+/*
+ * Parse our command line options
+ */
+void ParseOptions(int argc, char *argv[], options *opts) {
+  static struct option long_options[] = {
+      {"batch", required_argument, 0, 'b'},
+      {"frames", required_argument, 0, 'f'},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0}
+    };
+
+  int option_index = 0;
+  while (1) {
+    int c = getopt_long(argc, argv, "b:f:h", long_options, &option_index);
+    if (c == -1)
+      break;
+
+    switch (c) {
+      case 0:
+        break;
+      case 'b':
+        ola::StringToInt(optarg, &opts->batch_size);
+        break;
+      case 'f':
+        ola::StringToInt(optarg, &opts->frames);
+        break;
+      case 'h':
+        DisplayHelpAndExit(argv);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+
+int main(int argc, char *argv[]) {
+  options opts;
+  opts.frames = 200000;
+  opts.batch_size = 64;
+  ParseOptions(argc, argv, &opts);
+  ola::InitLogging(ola::OLA_LOG_WARN, ola::OLA_LOG_STDERR);
+
+  if (!opts.batch_size)
+    opts.batch_size = 1;
+  if (opts.frames < opts.batch_size)
+    opts.frames = opts.batch_size;
+
+  RunBenchmark("StreamDmxData", ola::rpc::STREAM_REQUEST, opts);
+  RunBenchmark("UpdateDmxData", ola::rpc::REQUEST, opts);
+}
@@ -0,0 +1,60 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * Clock.cpp
+ * Provides the current time.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <sys/time.h>
+#include <time.h>
+
+#include "ola/Clock.h"
+
+namespace ola {
+
+
+/*
+ * Get the current time from the monotonic clock. If clock_gettime() isn't
+ * available we fall back to gettimeofday().
+ * @param timestamp the TimeStamp to update
+ */
+void Clock::CurrentTime(TimeStamp *timestamp) const {
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+    *timestamp = TimeStamp::FromNanoSeconds(
+        ts.tv_sec * NSEC_IN_SECONDS + ts.tv_nsec);
+    return;
+  }
+#endif
+  Clock::CurrentRealTime(timestamp);
+}
+
+
+/*
+ * Get the wall clock time.
+ * @param timestamp the TimeStamp to update
+ */
+void Clock::CurrentRealTime(TimeStamp *timestamp) const {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  *timestamp = tv;
+}
+}  // ola
@@ -113,6 +113,27 @@ void ClockTest::testTimeInterval() {
   TimeInterval interval5(1, 600000);  // 1.6s
   CPPUNIT_ASSERT(interval4 != interval5);
   CPPUNIT_ASSERT(interval4 < interval5);
+
+  // nanosecond precision is maintained
+  TimeInterval interval6 = TimeInterval::FromNanoSeconds(22727272);
+  CPPUNIT_ASSERT_EQUAL(static_cast<int64_t>(22727272),
+                       interval6.InNanoSeconds());
+  CPPUNIT_ASSERT_EQUAL(static_cast<int64_t>(22727), interval6.AsInt());
+  CPPUNIT_ASSERT_EQUAL(static_cast<int64_t>(22), interval6.InMilliSeconds());
+  interval6 += interval6;
+  CPPUNIT_ASSERT_EQUAL(static_cast<int64_t>(45454544),
+                       interval6.InNanoSeconds());
+
+  // negative intervals convert to a normalized timeval
+  TimeStamp earlier, later;
+  later += TimeInterval(1, 0);
+  TimeInterval negative = earlier - later;
+  negative += TimeInterval(0, 250000);
+  struct timeval tv;
+  negative.AsTimeval(&tv);
+  CPPUNIT_ASSERT_EQUAL(static_cast<time_t>(-1), tv.tv_sec);
+  CPPUNIT_ASSERT_EQUAL(250000, static_cast<int>(tv.tv_usec));
+  CPPUNIT_ASSERT_EQUAL(string("-0.750000"), negative.ToString());
 }
 
 
@@ -128,6 +149,15 @@ void ClockTest::testClock() {
   TimeStamp second;
   clock.CurrentTime(&second);
   CPPUNIT_ASSERT(first < second);
+
+  // the real time should be close to gettimeofday()
+  TimeStamp real_time;
+  clock.CurrentRealTime(&real_time);
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  TimeStamp now(tv);
+  CPPUNIT_ASSERT(real_time <= now);
+  CPPUNIT_ASSERT(now - real_time < TimeInterval(1, 0));
 }
 
 
@@ -17,7 +17,9 @@
  * The DmxBuffer class
  * Copyright (C) 2005-2009 Simon Newton
  *
- * This implements a DmxBuffer which uses copy-on-write and delayed init.
+ * This implements a DmxBuffer with inline storage. Earlier versions used
+ * copy-on-write, which meant a heap allocation whenever a shared buffer was
+ * written to, and that happened for almost every frame that was merged.
  *
  * A DmxBuffer can hold up to 512 bytes of channel information. The amount of
  * valid data is returned by calling Size().
@@ -28,6 +30,7 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include "common/utils/HTPMerge.h"
 #include "ola/BaseTypes.h"
 #include "ola/DmxBuffer.h"
 #include "ola/Logging.h"
@@ -40,26 +43,18 @@ using std::max;
 using std::vector;
 
 DmxBuffer::DmxBuffer()
-    : m_ref_count(NULL),
-      m_copy_on_write(false),
-      m_data(NULL),
+    : m_initialized(false),
       m_length(0) {
 }
 
 
 /*
- * Copy constructor. We just copy the underlying pointers and mark COW as
- * true if the other buffer has data.
+ * Copy constructor.
  */
 DmxBuffer::DmxBuffer(const DmxBuffer &other)
-    : m_ref_count(NULL),
-      m_copy_on_write(false),
-      m_data(NULL),
+    : m_initialized(false),
       m_length(0) {
-
-  if (other.m_data && other.m_ref_count) {
-    CopyFromOther(other);
-  }
+  CopyFromOther(other);
 }
 
 
@@ -67,9 +62,7 @@ DmxBuffer::DmxBuffer(const DmxBuffer &other)
  * Create a new buffer from data
  */
 DmxBuffer::DmxBuffer(const uint8_t *data, unsigned int length)
-    : m_ref_count(0),
-      m_copy_on_write(false),
-      m_data(NULL),
+    : m_initialized(false),
       m_length(0) {
   Set(data, length);
 }
@@ -79,9 +72,7 @@ DmxBuffer::DmxBuffer(const uint8_t *data, unsigned int length)
  * Create a new buffer from a string
  */
 DmxBuffer::DmxBuffer(const string &data)
-    : m_ref_count(0),
-      m_copy_on_write(false),
-      m_data(NULL),
+    : m_initialized(false),
       m_length(0) {
     Set(data);
 }
@@ -90,9 +81,7 @@ DmxBuffer::DmxBuffer(const string &data)
 /*
  * Cleanup
  */
-DmxBuffer::~DmxBuffer() {
-  CleanupMemory();
-}
+DmxBuffer::~DmxBuffer() {}
 
 
 /*
@@ -100,12 +89,8 @@ DmxBuffer::~DmxBuffer() {
  * @param other the other DmxBuffer
  */
 DmxBuffer& DmxBuffer::operator=(const DmxBuffer &other) {
-  if (this != &other) {
-    CleanupMemory();
-    if (other.m_data) {
-      CopyFromOther(other);
-    }
-  }
+  if (this != &other)
+    CopyFromOther(other);
   return *this;
 }
 
@@ -115,8 +100,31 @@ DmxBuffer& DmxBuffer::operator=(const DmxBuffer &other) {
  */
 bool DmxBuffer::operator==(const DmxBuffer &other) const {
   return (m_length == other.m_length &&
-          (m_data == other.m_data ||
-           0 == memcmp(m_data, other.m_data, m_length)));
+          0 == memcmp(m_data, other.m_data, m_length));
+}
+
+
+/*
+ * Find which channels differ from a previous frame.
+ * @param previous the frame to compare against
+ * @param start set to the first channel that differs
+ * @param end set to one past the last channel that differs
+ * @returns false if the buffers are the same, true otherwise. If one buffer
+ *   is longer than the other, the extra channels count as changed.
+ */
+bool DmxBuffer::ChangedRange(const DmxBuffer &previous,
+                             unsigned int *start,
+                             unsigned int *end) const {
+  unsigned int common_length = min(m_length, previous.m_length);
+  bool changed = FindChangedRange(m_data, previous.m_data, common_length,
+                                  start, end);
+  if (m_length == previous.m_length)
+    return changed;
+
+  if (!changed)
+    *start = common_length;
+  *end = max(m_length, previous.m_length);
+  return true;
 }
 
 
@@ -125,25 +133,97 @@ bool DmxBuffer::operator==(const DmxBuffer &other) const {
  * @param other the DmxBuffer to HTP merge into this one
  */
 bool DmxBuffer::HTPMerge(const DmxBuffer &other) {
-  if (!m_data) {
-    if (!Init())
-      return false;
+  if (!m_initialized) {
+    m_initialized = true;
+    m_length = 0;
   }
-  DuplicateIfNeeded();
 
-  unsigned int other_length = min((unsigned int) DMX_UNIVERSE_SIZE,
-                                  other.m_length);
   unsigned int merge_length = min(m_length, other.m_length);
 
   for (unsigned int i = 0; i < merge_length; i++) {
     m_data[i] = max(m_data[i], other.m_data[i]);
   }
 
-  if (other_length > m_length) {
+  if (other.m_length > m_length) {
     memcpy(m_data + merge_length, other.m_data + merge_length,
-           other_length - merge_length);
-    m_length = other_length;
+           other.m_length - merge_length);
+    m_length = other.m_length;
+  }
+  return true;
+}
+
+
+/*
+ * Replace the contents of this buffer with the HTP merge of a set of
+ * sources. This is done in a single pass, using the fastest merge kernel the
+ * CPU supports, rather than resetting & merging one source at a time.
+ * @param sources an array of pointers to the buffers to merge
+ * @param count the number of sources
+ * @post Size() is the largest of the source sizes
+ */
+bool DmxBuffer::HTPMerge(const DmxBuffer *const *sources, unsigned int count) {
+  HTPMergeFunction merge = SelectedHTPMergeKernel().function;
+  m_initialized = true;
+
+  for (unsigned int i = 0; i < count; i++) {
+    if (sources[i] == this) {
+      // the kernels can't write to one of their inputs
+      uint8_t merged[DMX_UNIVERSE_SIZE];
+      m_length = merge(merged, sources, count);
+      memcpy(m_data, merged, m_length);
+      return true;
+    }
   }
+  m_length = merge(m_data, sources, count);
+  return true;
+}
+
+
+/*
+ * Replace the contents of this buffer with the merge of a set of sources
+ * that each have a priority for every channel. For each channel the value
+ * comes from the sources with the highest priority for that channel.
+ * @param sources an array of pointers to the buffers to merge
+ * @param priorities an array of pointers to the per channel priorities for
+ *   each source. A priority of 0 means the source doesn't control that channel
+ * @param count the number of sources
+ * @param merged_priorities set to the winning priority for each channel
+ * @param htp if true, sources with the same priority are HTP merged,
+ *   otherwise the latest in the array wins.
+ * @post Size() & merged_priorities->Size() are the largest of the source sizes
+ */
+bool DmxBuffer::PriorityMerge(const DmxBuffer *const *sources,
+                              const DmxBuffer *const *priorities,
+                              unsigned int count,
+                              DmxBuffer *merged_priorities,
+                              bool htp) {
+  if (!merged_priorities || merged_priorities == this)
+    return false;
+
+  PriorityMergeFunction merge = SelectedHTPMergeKernel().priority_function;
+  bool aliased = false;
+  for (unsigned int i = 0; i < count; i++) {
+    if (sources[i] == this || sources[i] == merged_priorities ||
+        priorities[i] == this || priorities[i] == merged_priorities)
+      aliased = true;
+  }
+
+  if (aliased) {
+    // the kernels can't write to one of their inputs
+    uint8_t merged[DMX_UNIVERSE_SIZE];
+    uint8_t merged_priority[DMX_UNIVERSE_SIZE];
+    unsigned int length = merge(merged, merged_priority, sources, priorities,
+                                count, htp);
+    Set(merged, length);
+    merged_priorities->Set(merged_priority, length);
+    return true;
+  }
+
+  m_initialized = true;
+  merged_priorities->m_initialized = true;
+  m_length = merge(m_data, merged_priorities->m_data, sources, priorities,
+                   count, htp);
+  merged_priorities->m_length = m_length;
   return true;
 }
 
@@ -156,14 +236,9 @@ bool DmxBuffer::Set(const uint8_t *data, unsigned int length) {
   if (!data)
     return false;
 
-  if (m_copy_on_write)
-    CleanupMemory();
-  if (!m_data) {
-    if (!Init())
-      return false;
-  }
+  m_initialized = true;
   m_length = min(length, (unsigned int) DMX_UNIVERSE_SIZE);
-  memcpy(m_data, data, m_length);
+  memmove(m_data, data, m_length);
   return true;
 }
 
@@ -180,11 +255,12 @@ bool DmxBuffer::Set(const string &data) {
 
 /*
  * Sets the data in this buffer to be the same as the other one.
- * Used instead of a COW to optimise.
  * @post Size() == other.Size()
  */
 bool DmxBuffer::Set(const DmxBuffer &other) {
-  return Set(other.m_data, other.m_length);
+  if (this != &other)
+    CopyFromOther(other);
+  return true;
 }
 
 
@@ -198,12 +274,7 @@ bool DmxBuffer::SetFromString(const string &input) {
   vector<string> dmx_values;
   vector<string>::const_iterator iter;
 
-  if (m_copy_on_write)
-    CleanupMemory();
-  if (!m_data)
-    if (!Init())
-      return false;
-
+  m_initialized = true;
   if (input.empty()) {
     m_length = 0;
     return true;
@@ -230,15 +301,13 @@ bool DmxBuffer::SetRangeToValue(unsigned int offset,
   if (offset >= DMX_UNIVERSE_SIZE)
     return false;
 
-  if (!m_data) {
+  if (!m_initialized) {
     Blackout();
   }
 
   if (offset > m_length)
     return false;
 
-  DuplicateIfNeeded();
-
   unsigned int copy_length = min(length, DMX_UNIVERSE_SIZE - offset);
   memset(m_data + offset, value, copy_length);
   m_length = max(m_length, offset + copy_length);
@@ -260,17 +329,15 @@ bool DmxBuffer::SetRange(unsigned int offset,
   if (!data || offset >= DMX_UNIVERSE_SIZE)
     return false;
 
-  if (!m_data) {
+  if (!m_initialized) {
     Blackout();
   }
 
   if (offset > m_length)
     return false;
 
-  DuplicateIfNeeded();
-
   unsigned int copy_length = min(length, DMX_UNIVERSE_SIZE - offset);
-  memcpy(m_data + offset, data, copy_length);
+  memmove(m_data + offset, data, copy_length);
   m_length = max(m_length, offset + copy_length);
   return true;
 }
@@ -285,7 +352,7 @@ void DmxBuffer::SetChannel(unsigned int channel, uint8_t data) {
   if (channel >= DMX_UNIVERSE_SIZE)
     return;
 
-  if (!m_data) {
+  if (!m_initialized) {
     Blackout();
   }
 
@@ -295,7 +362,6 @@ void DmxBuffer::SetChannel(unsigned int channel, uint8_t data) {
     return;
   }
 
-  DuplicateIfNeeded();
   m_data[channel] = data;
   m_length = max(channel+1, m_length);
 }
@@ -305,12 +371,8 @@ void DmxBuffer::SetChannel(unsigned int channel, uint8_t data) {
  * Get the contents of this buffer
  */
 void DmxBuffer::Get(uint8_t *data, unsigned int *length) const {
-  if (m_data) {
-    *length = min(*length, m_length);
-    memcpy(data, m_data, *length);
-  } else {
-    *length = 0;
-  }
+  *length = min(*length, m_length);
+  memcpy(data, m_data, *length);
 }
 
 
@@ -319,7 +381,7 @@ void DmxBuffer::Get(uint8_t *data, unsigned int *length) const {
  * initialized or the channel was out-of-bounds.
  */
 uint8_t DmxBuffer::Get(unsigned int channel) const {
-  if (m_data && channel < m_length)
+  if (channel < m_length)
     return m_data[channel];
   else
     return 0;
@@ -331,7 +393,7 @@ uint8_t DmxBuffer::Get(unsigned int channel) const {
  */
 string DmxBuffer::Get() const {
   string data;
-  data.append(reinterpret_cast<char*>(m_data), m_length);
+  data.append(reinterpret_cast<const char*>(m_data), m_length);
   return data;
 }
 
@@ -341,11 +403,7 @@ string DmxBuffer::Get() const {
  * @post Size() == DMX_UNIVERSE_SIZE
  */
 bool DmxBuffer::Blackout() {
-  if (m_copy_on_write)
-    CleanupMemory();
-  if (!m_data)
-    if (!Init())
-      return false;
+  m_initialized = true;
   memset(m_data, 0, DMX_UNIVERSE_SIZE);
   m_length = DMX_UNIVERSE_SIZE;
   return true;
@@ -357,8 +415,27 @@ bool DmxBuffer::Blackout() {
  * @post Size() == 0
  */
 void DmxBuffer::Reset() {
-  if (m_data)
-    m_length = 0;
+  m_length = 0;
+}
+
+
+/*
+ * Exchange the contents of this buffer with another one. Only the valid data
+ * is moved.
+ * @param other the buffer to swap with
+ */
+void DmxBuffer::Swap(DmxBuffer *other) {
+  if (this == other)
+    return;
+
+  unsigned int swap_length = max(m_length, other->m_length);
+  for (unsigned int i = 0; i < swap_length; i++) {
+    uint8_t value = m_data[i];
+    m_data[i] = other->m_data[i];
+    other->m_data[i] = value;
+  }
+  std::swap(m_initialized, other->m_initialized);
+  std::swap(m_length, other->m_length);
 }
 
 
@@ -366,9 +443,6 @@ void DmxBuffer::Reset() {
  * Convert to a human readable representation
  */
 string DmxBuffer::ToString() const {
-  if (!m_data)
-    return "";
-
   std::stringstream str;
   for (unsigned int i = 0; i < Size(); i++) {
     if (i)
@@ -380,77 +454,12 @@ string DmxBuffer::ToString() const {
 
 
 /*
- * Allocate memory
- */
-bool DmxBuffer::Init() {
-  try {
-    m_data = new uint8_t[DMX_UNIVERSE_SIZE];
-  } catch (std::bad_alloc &ex) {
-    return false;
-  }
-  try {
-    m_ref_count = new unsigned int;
-  } catch (std::bad_alloc &ex) {
-    delete[] m_data;
-    return false;
-  }
-  m_length = 0;
-  *m_ref_count = 1;
-  return true;
-}
-
-
-/*
- * Called before making a change, this duplicates the data if required.
- */
-bool DmxBuffer::DuplicateIfNeeded() {
-  if (m_copy_on_write && *m_ref_count == 1)
-    m_copy_on_write = false;
-
-  if (m_copy_on_write && *m_ref_count > 1) {
-    unsigned int *old_ref_count = m_ref_count;
-    uint8_t *original_data = m_data;
-    unsigned int length = m_length;
-    m_copy_on_write = false;
-    if (Init()) {
-      Set(original_data, length);
-      (*old_ref_count)--;
-      return true;
-    }
-    return false;
-  }
-  return true;
-}
-
-
-/*
- * Setup this buffer to point to the data of the other buffer
+ * Copy the valid data from another buffer.
  * @param other the source buffer
- * @pre other.m_data and other.m_ref_count are not NULL
  */
 void DmxBuffer::CopyFromOther(const DmxBuffer &other) {
-  m_copy_on_write = true;
-  other.m_copy_on_write = true;
-  m_ref_count = other.m_ref_count;
-  (*m_ref_count)++;
-  m_data = other.m_data;
+  m_initialized = other.m_initialized;
   m_length = other.m_length;
-}
-
-
-/*
- * Decrement the ref count by one and free the memory if required
- */
-void DmxBuffer::CleanupMemory() {
-  if (m_ref_count && m_data) {
-    (*m_ref_count)--;
-    if (!*m_ref_count) {
-      delete[] m_data;
-      delete m_ref_count;
-    }
-    m_data = NULL;
-    m_ref_count = NULL;
-    m_length = 0;
-  }
+  memcpy(m_data, other.m_data, m_length);
 }
 }  //  ola
@@ -41,6 +41,8 @@ class DmxBufferTest: public CppUnit::TestFixture {
   CPPUNIT_TEST(testSetRangeToValue);
   CPPUNIT_TEST(testSetChannel);
   CPPUNIT_TEST(testToString);
+  CPPUNIT_TEST(testSwap);
+  CPPUNIT_TEST(testChangedRange);
   CPPUNIT_TEST_SUITE_END();
 
   public:
@@ -56,6 +58,8 @@ class DmxBufferTest: public CppUnit::TestFixture {
     void testSetRangeToValue();
     void testSetChannel();
     void testToString();
+    void testSwap();
+    void testChangedRange();
 
   private:
     static const uint8_t TEST_DATA[];
@@ -508,3 +512,74 @@ void DmxBufferTest::testToString() {
   buffer.SetRangeToValue(0, 255, 5);
   CPPUNIT_ASSERT_EQUAL(string("255,255,255,255,255"), buffer.ToString());
 }
+
+
+/*
+ * Test Swap()
+ */
+void DmxBufferTest::testSwap() {
+  const DmxBuffer buffer2(TEST_DATA2, sizeof(TEST_DATA2));
+  const DmxBuffer buffer3(TEST_DATA3, sizeof(TEST_DATA3));
+  DmxBuffer first(buffer2);
+  DmxBuffer second(buffer3);
+
+  first.Swap(&second);
+  CPPUNIT_ASSERT(buffer3 == first);
+  CPPUNIT_ASSERT(buffer2 == second);
+
+  // swapping with ourself is a no-op
+  first.Swap(&first);
+  CPPUNIT_ASSERT(buffer3 == first);
+
+  // the uninitialized state moves with the data, so SetChannel() on the
+  // swapped buffer still blacks it out first
+  DmxBuffer empty;
+  empty.Swap(&second);
+  CPPUNIT_ASSERT(buffer2 == empty);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, second.Size());
+  second.SetChannel(2, 10);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) DMX_UNIVERSE_SIZE, second.Size());
+  CPPUNIT_ASSERT_EQUAL((uint8_t) 0, second.Get(0));
+  CPPUNIT_ASSERT_EQUAL((uint8_t) 10, second.Get(2));
+}
+
+
+/*
+ * Test ChangedRange()
+ */
+void DmxBufferTest::testChangedRange() {
+  unsigned int start, end;
+  DmxBuffer previous, current;
+  previous.Blackout();
+  current.Blackout();
+  CPPUNIT_ASSERT(!current.ChangedRange(previous, &start, &end));
+
+  // check single changes at each position, so both the vector & scalar
+  // code are used
+  for (unsigned int i = 0; i < DMX_UNIVERSE_SIZE; i++) {
+    current.SetChannel(i, 1);
+    CPPUNIT_ASSERT(current.ChangedRange(previous, &start, &end));
+    CPPUNIT_ASSERT_EQUAL(i, start);
+    CPPUNIT_ASSERT_EQUAL(i + 1, end);
+    current.SetChannel(i, 0);
+  }
+
+  current.SetChannel(3, 1);
+  current.SetChannel(300, 1);
+  CPPUNIT_ASSERT(current.ChangedRange(previous, &start, &end));
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 3, start);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 301, end);
+
+  // extra channels count as changed
+  const uint8_t short_data[] = {0, 0, 0, 0};
+  DmxBuffer short_buffer(short_data, sizeof(short_data));
+  CPPUNIT_ASSERT(previous.ChangedRange(short_buffer, &start, &end));
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 4, start);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) DMX_UNIVERSE_SIZE, end);
+
+  DmxBuffer empty;
+  CPPUNIT_ASSERT(short_buffer.ChangedRange(empty, &start, &end));
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, start);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 4, end);
+  CPPUNIT_ASSERT(!empty.ChangedRange(DmxBuffer(), &start, &end));
+}
@@ -0,0 +1,251 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * DmxFrameEncoder.cpp
+ * Compresses the frames sent in DmxData messages.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <string.h>
+#include <map>
+#include "common/utils/DmxFrameEncoder.h"
+
+namespace ola {
+
+using std::map;
+
+
+/*
+ * Allow frames to be sent with an encoding, the peer must be able to decode
+ * it.
+ */
+void DmxFrameEncoder::EnableEncoding(dmx_encoding encoding) {
+  if (encoding != DMX_ENCODING_RAW)
+    m_encodings |= (1 << encoding);
+}
+
+
+/*
+ * Go back to sending every frame as is.
+ */
+void DmxFrameEncoder::DisableEncodings() {
+  m_encodings = 0;
+  m_last_frames.clear();
+}
+
+
+/*
+ * Encode a frame.
+ * @param universe the universe the frame is for
+ * @param frame the frame to send
+ * @param data set to the data to send, this is either the frame itself or
+ *   points into the encoder and is valid until the next call to Encode().
+ * @param length set to the length of the data to send
+ * @returns the encoding used
+ */
+dmx_encoding DmxFrameEncoder::Encode(unsigned int universe,
+                                     const DmxBuffer &frame,
+                                     const uint8_t **data,
+                                     unsigned int *length) {
+  dmx_encoding encoding = DMX_ENCODING_RAW;
+  *data = frame.GetRaw();
+  *length = frame.Size();
+
+  if (EncodingEnabled(DMX_ENCODING_DELTA)) {
+    map<unsigned int, last_frame>::iterator iter =
+      m_last_frames.find(universe);
+    if (iter == m_last_frames.end()) {
+      last_frame &last = m_last_frames[universe];
+      last.frame.Set(frame);
+      last.deltas = 0;
+    } else if (iter->second.deltas >= MAX_DELTAS) {
+      iter->second.frame.Set(frame);
+      iter->second.deltas = 0;
+    } else {
+      unsigned int size = *length ? *length - 1 : 0;
+      if (*length &&
+          EncodeDelta(iter->second.frame, frame, m_delta_data, &size)) {
+        encoding = DMX_ENCODING_DELTA;
+        *data = m_delta_data;
+        *length = size;
+        iter->second.deltas++;
+      } else {
+        iter->second.deltas = 0;
+      }
+      iter->second.frame.Set(frame);
+    }
+  }
+
+  // The RunLengthEncoder gives up once it runs out of space, so limiting it
+  // to the best size so far keeps this cheap when the delta is small.
+  if (EncodingEnabled(DMX_ENCODING_RLE) && frame.Size() > 2 && *length > 1) {
+    unsigned int size = *length - 1;
+    if (m_rle_encoder.Encode(frame, m_rle_data, size)) {
+      encoding = DMX_ENCODING_RLE;
+      *data = m_rle_data;
+      *length = size;
+    }
+  }
+  return encoding;
+}
+
+
+/*
+ * Build the delta between two frames.
+ * @param previous the last frame sent
+ * @param frame the new frame
+ * @param data where to store the delta
+ * @param length the size of data, set to the size of the delta
+ * @returns true if the delta fit, false otherwise
+ */
+bool DmxFrameEncoder::EncodeDelta(const DmxBuffer &previous,
+                                  const DmxBuffer &frame,
+                                  uint8_t *data,
+                                  unsigned int *length) {
+  const unsigned int frame_size = frame.Size();
+  const unsigned int previous_size = previous.Size();
+  if (frame_size < previous_size)
+    return false;
+
+  const uint8_t *new_data = frame.GetRaw();
+  const uint8_t *old_data = previous.GetRaw();
+  const unsigned int capacity = *length;
+  unsigned int size = 0;
+  unsigned int offset = 0;  // the end of the last segment
+  unsigned int start = 0;
+
+  while (true) {
+    // most channels don't change, so skip them a word at a time
+    while (start + sizeof(uint64_t) <= previous_size &&
+           !memcmp(new_data + start, old_data + start, sizeof(uint64_t)))
+      start += sizeof(uint64_t);
+    while (start < previous_size && new_data[start] == old_data[start])
+      start++;
+    if (start == frame_size)
+      break;
+
+    // find the end of the changes, taking in any short gaps
+    unsigned int end = start + 1;
+    while (end < frame_size) {
+      if (end >= previous_size || new_data[end] != old_data[end]) {
+        end++;
+        continue;
+      }
+      unsigned int gap_end = end;
+      while (gap_end < previous_size &&
+             new_data[gap_end] == old_data[gap_end] &&
+             gap_end - end <= MAX_MERGED_GAP)
+        gap_end++;
+      if (gap_end - end > MAX_MERGED_GAP || gap_end == frame_size)
+        break;
+      end = gap_end;
+    }
+
+    unsigned int skip = start - offset;
+    while (skip > MAX_SEGMENT_LENGTH) {
+      if (size + 2 > capacity)
+        return false;
+      data[size++] = MAX_SEGMENT_LENGTH;
+      data[size++] = 0;
+      skip -= MAX_SEGMENT_LENGTH;
+    }
+
+    while (start < end) {
+      unsigned int count = end - start;
+      if (count > MAX_SEGMENT_LENGTH)
+        count = MAX_SEGMENT_LENGTH;
+      if (size + 2 + count > capacity)
+        return false;
+      data[size++] = skip;
+      data[size++] = count;
+      memcpy(data + size, new_data + start, count);
+      size += count;
+      start += count;
+      skip = 0;
+    }
+    offset = end;
+  }
+  *length = size;
+  return true;
+}
+
+
+/*
+ * Apply a delta to the last frame.
+ */
+static bool DecodeDelta(const uint8_t *data,
+                        unsigned int length,
+                        DmxBuffer *frame) {
+  if (!frame->Size())
+    frame->Set(data, 0);
+
+  unsigned int offset = 0;
+  for (unsigned int i = 0; i < length;) {
+    if (length - i < 2)
+      return false;
+    offset += data[i++];
+    unsigned int count = data[i++];
+    if (offset > DMX_UNIVERSE_SIZE || count > length - i)
+      return false;
+    if (count) {
+      if (offset > frame->Size() || offset + count > DMX_UNIVERSE_SIZE)
+        return false;
+      frame->SetRange(offset, data + i, count);
+      i += count;
+      offset += count;
+    }
+  }
+  return true;
+}
+
+
+/*
+ * Decode a frame. The frame is updated in place, so it must hold the last
+ * frame received for the universe.
+ * @param encoding the encoding of the data
+ * @param data the encoded data
+ * @param length the length of the encoded data
+ * @param frame_length the length of the decoded frame, this is ignored for
+ *   raw frames.
+ * @param frame the last frame for the universe, updated with the new frame.
+ * @returns true if the frame was decoded, false if the data was bad in which
+ *   case the contents of the frame are undefined.
+ */
+bool DecodeDmxFrame(dmx_encoding encoding,
+                    const uint8_t *data,
+                    unsigned int length,
+                    unsigned int frame_length,
+                    DmxBuffer *frame) {
+  switch (encoding) {
+    case DMX_ENCODING_RAW:
+      return frame->Set(data, length);
+    case DMX_ENCODING_RLE:
+      {
+        RunLengthEncoder decoder;
+        frame->Set(data, 0);
+        if (!decoder.Decode(frame, 0, data, length))
+          return false;
+      }
+      break;
+    case DMX_ENCODING_DELTA:
+      if (!DecodeDelta(data, length, frame))
+        return false;
+      break;
+    default:
+      return false;
+  }
+  return frame->Size() == frame_length;
+}
+}  // ola
@@ -0,0 +1,111 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * DmxFrameEncoder.h
+ * Compresses the frames sent in DmxData messages.
+ * Copyright (C) 2012 Simon Newton
+ *
+ * A frame can be sent as is, run length encoded with the RunLengthEncoder, or
+ * as a delta against the last frame sent for the universe. The encoder picks
+ * whichever of the encodings the peer accepts is smallest.
+ *
+ * A delta is a list of segments, each one is the number of unchanged channels
+ * to skip, the number of changed channels, and then the changed channels
+ * themselves. Both counts are a single byte, longer runs are split. A delta
+ * can grow a frame but not shrink it, shorter frames are sent another way.
+ *
+ * The receiver keeps the last frame for each universe, whatever the encoding,
+ * and decodes deltas into it in place.
+ *
+ * If the receiver fails to decode a frame it has nothing to apply the next
+ * delta to, and streaming requests don't have a reply to tell the sender. So
+ * after MAX_DELTAS deltas in a row the next frame for the universe is sent as
+ * is or run length encoded, which puts the receiver right again.
+ */
+
+#ifndef COMMON_UTILS_DMXFRAMEENCODER_H_
+#define COMMON_UTILS_DMXFRAMEENCODER_H_
+
+#include <stdint.h>
+#include <map>
+#include "ola/BaseTypes.h"
+#include "ola/DmxBuffer.h"
+#include "ola/RunLengthEncoder.h"
+
+namespace ola {
+
+// These match the DmxEncoding values in Ola.proto
+typedef enum {
+  DMX_ENCODING_RAW = 0,
+  DMX_ENCODING_RLE = 1,
+  DMX_ENCODING_DELTA = 2
+} dmx_encoding;
+
+
+class DmxFrameEncoder {
+  public:
+    DmxFrameEncoder(): m_encodings(0) {}
+    ~DmxFrameEncoder() {}
+
+    void EnableEncoding(dmx_encoding encoding);
+    bool EncodingEnabled(dmx_encoding encoding) const {
+      return m_encodings & (1 << encoding);
+    }
+    void DisableEncodings();
+
+    dmx_encoding Encode(unsigned int universe,
+                        const DmxBuffer &frame,
+                        const uint8_t **data,
+                        unsigned int *length);
+    // Call this if a frame for the universe was sent some other way
+    void Forget(unsigned int universe) { m_last_frames.erase(universe); }
+
+    // About a second of frames at the DMX rate.
+    static const unsigned int MAX_DELTAS = 40;
+
+  private:
+    typedef struct {
+      DmxBuffer frame;
+      unsigned int deltas;  // deltas sent since the last full frame
+    } last_frame;
+
+    unsigned int m_encodings;
+    std::map<unsigned int, last_frame> m_last_frames;
+    RunLengthEncoder m_rle_encoder;
+    uint8_t m_delta_data[DMX_UNIVERSE_SIZE];
+    uint8_t m_rle_data[DMX_UNIVERSE_SIZE];
+
+    static bool EncodeDelta(const DmxBuffer &previous,
+                            const DmxBuffer &frame,
+                            uint8_t *data,
+                            unsigned int *length);
+
+    static const unsigned int MAX_SEGMENT_LENGTH = 0xff;
+    // it's cheaper to resend this many unchanged channels than start a new
+    // segment.
+    static const unsigned int MAX_MERGED_GAP = 2;
+
+    DmxFrameEncoder(const DmxFrameEncoder&);
+    DmxFrameEncoder& operator=(const DmxFrameEncoder&);
+};
+
+
+bool DecodeDmxFrame(dmx_encoding encoding,
+                    const uint8_t *data,
+                    unsigned int length,
+                    unsigned int frame_length,
+                    DmxBuffer *frame);
+}  // ola
+#endif  // COMMON_UTILS_DMXFRAMEENCODER_H_
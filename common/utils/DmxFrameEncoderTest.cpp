@@ -0,0 +1,340 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * DmxFrameEncoderTest.cpp
+ * Test fixture for the DmxFrameEncoder class
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+#include "common/utils/DmxFrameEncoder.h"
+#include "ola/BaseTypes.h"
+#include "ola/DmxBuffer.h"
+
+using ola::DmxBuffer;
+using ola::DmxFrameEncoder;
+using ola::DecodeDmxFrame;
+using ola::dmx_encoding;
+using std::string;
+
+
+class DmxFrameEncoderTest: public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(DmxFrameEncoderTest);
+  CPPUNIT_TEST(testRaw);
+  CPPUNIT_TEST(testRunLength);
+  CPPUNIT_TEST(testDelta);
+  CPPUNIT_TEST(testDeltaLengthChanges);
+  CPPUNIT_TEST(testForget);
+  CPPUNIT_TEST(testFullFrames);
+  CPPUNIT_TEST(testBadData);
+  CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void testRaw();
+    void testRunLength();
+    void testDelta();
+    void testDeltaLengthChanges();
+    void testForget();
+    void testFullFrames();
+    void testBadData();
+
+  private:
+    DmxFrameEncoder m_encoder;
+    // the receiver's copy of each frame
+    DmxBuffer m_received;
+
+    dmx_encoding SendFrame(const DmxBuffer &frame, unsigned int *length);
+    void FillWithNoise(DmxBuffer *buffer);
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DmxFrameEncoderTest);
+
+
+/*
+ * Encode a frame for universe 1 and decode it into m_received.
+ * @returns the encoding used
+ */
+dmx_encoding DmxFrameEncoderTest::SendFrame(const DmxBuffer &frame,
+                                            unsigned int *length) {
+  const uint8_t *data;
+  dmx_encoding encoding = m_encoder.Encode(1, frame, &data, length);
+  CPPUNIT_ASSERT(DecodeDmxFrame(encoding, data, *length, frame.Size(),
+                                &m_received));
+  CPPUNIT_ASSERT(frame == m_received);
+  return encoding;
+}
+
+
+/*
+ * Fill a buffer with data that doesn't compress.
+ */
+void DmxFrameEncoderTest::FillWithNoise(DmxBuffer *buffer) {
+  uint8_t data[DMX_UNIVERSE_SIZE];
+  for (unsigned int i = 0; i < DMX_UNIVERSE_SIZE; i++)
+    data[i] = (i * 37 + i / 7) & 0xff;
+  buffer->Set(data, sizeof(data));
+}
+
+
+/*
+ * Check frames are sent as is if there aren't any encodings, or if they don't
+ * help.
+ */
+void DmxFrameEncoderTest::testRaw() {
+  DmxBuffer frame;
+  frame.Blackout();
+  unsigned int length;
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_RAW, SendFrame(frame, &length));
+  CPPUNIT_ASSERT_EQUAL(static_cast<unsigned int>(DMX_UNIVERSE_SIZE), length);
+
+  m_encoder.EnableEncoding(ola::DMX_ENCODING_RLE);
+  FillWithNoise(&frame);
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_RAW, SendFrame(frame, &length));
+  CPPUNIT_ASSERT_EQUAL(static_cast<unsigned int>(DMX_UNIVERSE_SIZE), length);
+
+  // too short to encode
+  frame.SetFromString("0,0");
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_RAW, SendFrame(frame, &length));
+  frame.Reset();
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_RAW, SendFrame(frame, &length));
+  CPPUNIT_ASSERT_EQUAL(0u, length);
+}
+
+
+/*
+ * Check run length encoding is used for frames with repeated values.
+ */
+void DmxFrameEncoderTest::testRunLength() {
+  m_encoder.EnableEncoding(ola::DMX_ENCODING_RLE);
+  CPPUNIT_ASSERT(m_encoder.EncodingEnabled(ola::DMX_ENCODING_RLE));
+  CPPUNIT_ASSERT(!m_encoder.EncodingEnabled(ola::DMX_ENCODING_DELTA));
+
+  DmxBuffer frame;
+  frame.Blackout();
+  frame.SetRangeToValue(100, 255, 20);
+  unsigned int length;
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_RLE, SendFrame(frame, &length));
+  CPPUNIT_ASSERT(length < 20);
+
+  // without deltas the frame is resent in full
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_RLE, SendFrame(frame, &length));
+}
+
+
+/*
+ * Check deltas only carry the changed channels.
+ */
+void DmxFrameEncoderTest::testDelta() {
+  m_encoder.EnableEncoding(ola::DMX_ENCODING_DELTA);
+  m_encoder.EnableEncoding(ola::DMX_ENCODING_RLE);
+
+  DmxBuffer frame;
+  FillWithNoise(&frame);
+  unsigned int length;
+  // nothing to build a delta from yet
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_RAW, SendFrame(frame, &length));
+
+  // no changes
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_DELTA, SendFrame(frame, &length));
+  CPPUNIT_ASSERT_EQUAL(0u, length);
+
+  // a single channel
+  frame.SetChannel(10, 1);
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_DELTA, SendFrame(frame, &length));
+  CPPUNIT_ASSERT_EQUAL(3u, length);
+
+  // a short gap is merged
+  frame.SetChannel(20, 1);
+  frame.SetChannel(22, 1);
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_DELTA, SendFrame(frame, &length));
+  CPPUNIT_ASSERT_EQUAL(5u, length);
+
+  // a longer one isn't
+  frame.SetChannel(20, 2);
+  frame.SetChannel(24, 2);
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_DELTA, SendFrame(frame, &length));
+  CPPUNIT_ASSERT_EQUAL(6u, length);
+
+  // gaps longer than a segment and the last channel
+  frame.SetChannel(0, 2);
+  frame.SetChannel(DMX_UNIVERSE_SIZE - 1, 2);
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_DELTA, SendFrame(frame, &length));
+  CPPUNIT_ASSERT_EQUAL(8u, length);
+
+  // changes longer than a segment
+  DmxBuffer changed;
+  changed.Blackout();
+  changed.SetRange(0, frame.GetRaw(), 400);
+  changed.SetChannel(500, 1);
+  frame.SetRangeToValue(0, 0, DMX_UNIVERSE_SIZE);
+  frame.SetChannel(500, 1);
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_RLE, SendFrame(frame, &length));
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_DELTA, SendFrame(changed, &length));
+  CPPUNIT_ASSERT_EQUAL(404u, length);
+
+  // RLE wins if the whole frame changes
+  frame.SetRangeToValue(0, 100, DMX_UNIVERSE_SIZE);
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_RLE, SendFrame(frame, &length));
+
+  // each universe has its own base
+  const uint8_t *data;
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_RLE,
+                       m_encoder.Encode(2, frame, &data, &length));
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_DELTA,
+                       m_encoder.Encode(2, frame, &data, &length));
+  CPPUNIT_ASSERT_EQUAL(0u, length);
+}
+
+
+/*
+ * Check deltas can grow a frame, but not shrink it.
+ */
+void DmxFrameEncoderTest::testDeltaLengthChanges() {
+  m_encoder.EnableEncoding(ola::DMX_ENCODING_DELTA);
+
+  DmxBuffer frame;
+  FillWithNoise(&frame);
+  DmxBuffer short_frame(frame.GetRaw(), 100);
+  unsigned int length;
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_RAW, SendFrame(short_frame, &length));
+
+  short_frame.SetChannel(100, 1);
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_DELTA,
+                       SendFrame(short_frame, &length));
+  CPPUNIT_ASSERT_EQUAL(3u, length);
+
+  DmxBuffer shorter_frame(frame.GetRaw(), 50);
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_RAW,
+                       SendFrame(shorter_frame, &length));
+  CPPUNIT_ASSERT_EQUAL(50u, length);
+
+  shorter_frame.SetChannel(50, 1);
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_DELTA,
+                       SendFrame(shorter_frame, &length));
+  CPPUNIT_ASSERT_EQUAL(3u, length);
+}
+
+
+/*
+ * Check a frame is resent in full once the encoder is told the receiver's
+ * copy has changed.
+ */
+void DmxFrameEncoderTest::testForget() {
+  m_encoder.EnableEncoding(ola::DMX_ENCODING_DELTA);
+
+  DmxBuffer frame;
+  FillWithNoise(&frame);
+  unsigned int length;
+  SendFrame(frame, &length);
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_DELTA, SendFrame(frame, &length));
+
+  m_encoder.Forget(1);
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_RAW, SendFrame(frame, &length));
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_DELTA, SendFrame(frame, &length));
+
+  m_encoder.DisableEncodings();
+  CPPUNIT_ASSERT(!m_encoder.EncodingEnabled(ola::DMX_ENCODING_DELTA));
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_RAW, SendFrame(frame, &length));
+  m_encoder.EnableEncoding(ola::DMX_ENCODING_DELTA);
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_RAW, SendFrame(frame, &length));
+}
+
+
+/*
+ * Check a full frame is sent every so often, so a receiver that failed to
+ * decode a frame catches up.
+ */
+void DmxFrameEncoderTest::testFullFrames() {
+  m_encoder.EnableEncoding(ola::DMX_ENCODING_DELTA);
+
+  DmxBuffer frame;
+  FillWithNoise(&frame);
+  unsigned int length;
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_RAW, SendFrame(frame, &length));
+  for (unsigned int i = 0; i < DmxFrameEncoder::MAX_DELTAS; i++)
+    CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_DELTA, SendFrame(frame, &length));
+
+  // the receiver lost its copy
+  m_received.Reset();
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_RAW, SendFrame(frame, &length));
+  CPPUNIT_ASSERT_EQUAL(static_cast<unsigned int>(DMX_UNIVERSE_SIZE), length);
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_DELTA, SendFrame(frame, &length));
+
+  // a frame that isn't a delta starts the count again
+  for (unsigned int i = 0; i < DmxFrameEncoder::MAX_DELTAS - 2; i++)
+    CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_DELTA, SendFrame(frame, &length));
+  DmxBuffer short_frame(frame.GetRaw(), 100);
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_RAW, SendFrame(short_frame, &length));
+  for (unsigned int i = 0; i < DmxFrameEncoder::MAX_DELTAS; i++)
+    CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_DELTA,
+                         SendFrame(short_frame, &length));
+  CPPUNIT_ASSERT_EQUAL(ola::DMX_ENCODING_RAW, SendFrame(short_frame, &length));
+}
+
+
+/*
+ * Check bad data is rejected.
+ */
+void DmxFrameEncoderTest::testBadData() {
+  DmxBuffer frame;
+  frame.SetFromString("1,2,3,4");
+
+  // truncated segments
+  const uint8_t truncated[] = {1, 2, 9};
+  CPPUNIT_ASSERT(!DecodeDmxFrame(ola::DMX_ENCODING_DELTA, truncated,
+                                 sizeof(truncated), 4, &frame));
+  frame.SetFromString("1,2,3,4");
+  CPPUNIT_ASSERT(!DecodeDmxFrame(ola::DMX_ENCODING_DELTA, truncated, 1, 4,
+                                 &frame));
+
+  // past the end of the frame
+  const uint8_t past_end[] = {5, 1, 9};
+  frame.SetFromString("1,2,3,4");
+  CPPUNIT_ASSERT(!DecodeDmxFrame(ola::DMX_ENCODING_DELTA, past_end,
+                                 sizeof(past_end), 6, &frame));
+
+  // past the end of the universe
+  const uint8_t past_universe[] = {255, 0, 255, 0, 255, 1, 9};
+  frame.Blackout();
+  CPPUNIT_ASSERT(!DecodeDmxFrame(ola::DMX_ENCODING_DELTA, past_universe,
+                                 sizeof(past_universe), DMX_UNIVERSE_SIZE,
+                                 &frame));
+
+  // the wrong length
+  const uint8_t grow[] = {4, 1, 9};
+  frame.SetFromString("1,2,3,4");
+  CPPUNIT_ASSERT(!DecodeDmxFrame(ola::DMX_ENCODING_DELTA, grow, sizeof(grow),
+                                 4, &frame));
+  frame.SetFromString("1,2,3,4");
+  CPPUNIT_ASSERT(DecodeDmxFrame(ola::DMX_ENCODING_DELTA, grow, sizeof(grow),
+                                5, &frame));
+  CPPUNIT_ASSERT_EQUAL(string("1,2,3,4,9"), frame.ToString());
+
+  const uint8_t rle[] = {0x85, 7};
+  CPPUNIT_ASSERT(!DecodeDmxFrame(ola::DMX_ENCODING_RLE, rle, sizeof(rle), 4,
+                                 &frame));
+  CPPUNIT_ASSERT(DecodeDmxFrame(ola::DMX_ENCODING_RLE, rle, sizeof(rle), 5,
+                                &frame));
+  CPPUNIT_ASSERT_EQUAL(string("7,7,7,7,7"), frame.ToString());
+  CPPUNIT_ASSERT(!DecodeDmxFrame(ola::DMX_ENCODING_RLE, rle, 1, 5, &frame));
+
+  CPPUNIT_ASSERT(!DecodeDmxFrame(static_cast<dmx_encoding>(7), rle,
+                                 sizeof(rle), 5, &frame));
+}
@@ -0,0 +1,521 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * HTPMerge.cpp
+ * The kernels behind DmxBuffer::HTPMerge(sources, count).
+ * Copyright (C) 2012 Simon Newton
+ *
+ * Each vector kernel walks the universe one register at a time and takes the
+ * max across every source before storing the result, so the output is only
+ * written once. A source that ends part way through a register is merged
+ * with scalar code afterwards.
+ *
+ * The priority kernels carry the highest priority seen so far for each
+ * channel in a second register, and use compare masks to pick between the
+ * current value, the new source's value and the max of the two. Blocks where
+ * a source or its priorities end part way through are merged with scalar
+ * code.
+ *
+ * The SSE2 & NEON kernels are used if the compiler targets them. The AVX2
+ * kernel is built with a target attribute and only used if the CPU supports
+ * it, which is checked at runtime.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "common/utils/HTPMerge.h"
+#include "ola/BaseTypes.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define OLA_HTP_MERGE_SSE2 1
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || \
+     (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#include <immintrin.h>
+#define OLA_HTP_MERGE_AVX2 1
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define OLA_HTP_MERGE_NEON 1
+#endif
+
+namespace ola {
+
+using std::max;
+using std::vector;
+
+/*
+ * Return the length of the longest source.
+ */
+static unsigned int MaxLength(const DmxBuffer *const *sources,
+                              unsigned int count) {
+  unsigned int length = 0;
+  for (unsigned int i = 0; i < count; i++)
+    length = max(length, sources[i]->Size());
+  return length;
+}
+
+
+/*
+ * Merge the sources that end in the range [start, end) into the output,
+ * which already holds the merge of the sources that cover the whole range.
+ */
+static void MergePartialSources(uint8_t *output,
+                                unsigned int start,
+                                unsigned int end,
+                                const DmxBuffer *const *sources,
+                                unsigned int count) {
+  for (unsigned int i = 0; i < count; i++) {
+    unsigned int size = sources[i]->Size();
+    if (size <= start || size >= end)
+      continue;
+    const uint8_t *data = sources[i]->GetRaw();
+    for (unsigned int j = start; j < size; j++)
+      output[j] = max(output[j], data[j]);
+  }
+}
+
+
+/*
+ * Merge the channels [start, end) one at a time.
+ */
+static void ScalarMergeRange(uint8_t *output,
+                             unsigned int start,
+                             unsigned int end,
+                             const DmxBuffer *const *sources,
+                             unsigned int count) {
+  if (start >= end)
+    return;
+  memset(output + start, 0, end - start);
+  for (unsigned int i = 0; i < count; i++) {
+    const uint8_t *data = sources[i]->GetRaw();
+    unsigned int source_end = std::min(end, sources[i]->Size());
+    for (unsigned int j = start; j < source_end; j++)
+      output[j] = max(output[j], data[j]);
+  }
+}
+
+
+/*
+ * Merge the channels [start, end) one at a time, using per channel
+ * priorities.
+ */
+static void ScalarPriorityMergeRange(uint8_t *output,
+                                     uint8_t *output_priorities,
+                                     unsigned int start,
+                                     unsigned int end,
+                                     const DmxBuffer *const *sources,
+                                     const DmxBuffer *const *priorities,
+                                     unsigned int count,
+                                     bool htp) {
+  if (start >= end)
+    return;
+  memset(output + start, 0, end - start);
+  memset(output_priorities + start, 0, end - start);
+  for (unsigned int i = 0; i < count; i++) {
+    const uint8_t *data = sources[i]->GetRaw();
+    const uint8_t *priority = priorities[i]->GetRaw();
+    unsigned int source_end = std::min(
+        end, std::min(sources[i]->Size(), priorities[i]->Size()));
+    for (unsigned int j = start; j < source_end; j++) {
+      if (!priority[j] || priority[j] < output_priorities[j])
+        continue;
+      if (priority[j] > output_priorities[j]) {
+        output_priorities[j] = priority[j];
+        output[j] = data[j];
+      } else {
+        output[j] = htp ? max(output[j], data[j]) : data[j];
+      }
+    }
+  }
+}
+
+
+/*
+ * Check which sources can be merged a whole register at a time for the
+ * channels [start, end).
+ * @returns false if a source or its priorities end part way through the
+ * range, in which case the range must be merged with scalar code.
+ */
+static bool PriorityBlockIsFull(unsigned int start,
+                                unsigned int end,
+                                const DmxBuffer *const *sources,
+                                const DmxBuffer *const *priorities,
+                                unsigned int count) {
+  for (unsigned int i = 0; i < count; i++) {
+    unsigned int size = std::min(sources[i]->Size(), priorities[i]->Size());
+    if (size > start && size < end)
+      return false;
+  }
+  return true;
+}
+
+
+static unsigned int HTPMergeScalar(uint8_t *output,
+                                   const DmxBuffer *const *sources,
+                                   unsigned int count) {
+  unsigned int length = MaxLength(sources, count);
+  ScalarMergeRange(output, 0, length, sources, count);
+  return length;
+}
+
+
+static unsigned int PriorityMergeScalar(uint8_t *output,
+                                        uint8_t *output_priorities,
+                                        const DmxBuffer *const *sources,
+                                        const DmxBuffer *const *priorities,
+                                        unsigned int count,
+                                        bool htp) {
+  unsigned int length = MaxLength(sources, count);
+  ScalarPriorityMergeRange(output, output_priorities, 0, length, sources,
+                           priorities, count, htp);
+  return length;
+}
+
+
+#ifdef OLA_HTP_MERGE_SSE2
+static unsigned int HTPMergeSSE2(uint8_t *output,
+                                 const DmxBuffer *const *sources,
+                                 unsigned int count) {
+  static const unsigned int WIDTH = sizeof(__m128i);
+  unsigned int length = MaxLength(sources, count);
+  unsigned int offset = 0;
+  for (; offset + WIDTH <= length; offset += WIDTH) {
+    __m128i merged = _mm_setzero_si128();
+    bool partial = false;
+    for (unsigned int i = 0; i < count; i++) {
+      unsigned int size = sources[i]->Size();
+      if (size >= offset + WIDTH) {
+        merged = _mm_max_epu8(
+            merged,
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+                sources[i]->GetRaw() + offset)));
+      } else if (size > offset) {
+        partial = true;
+      }
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + offset), merged);
+    if (partial)
+      MergePartialSources(output, offset, offset + WIDTH, sources, count);
+  }
+  ScalarMergeRange(output, offset, length, sources, count);
+  return length;
+}
+
+static unsigned int PriorityMergeSSE2(uint8_t *output,
+                                      uint8_t *output_priorities,
+                                      const DmxBuffer *const *sources,
+                                      const DmxBuffer *const *priorities,
+                                      unsigned int count,
+                                      bool htp) {
+  static const unsigned int WIDTH = sizeof(__m128i);
+  const __m128i zero = _mm_setzero_si128();
+  unsigned int length = MaxLength(sources, count);
+  unsigned int offset = 0;
+  for (; offset + WIDTH <= length; offset += WIDTH) {
+    if (!PriorityBlockIsFull(offset, offset + WIDTH, sources, priorities,
+                             count)) {
+      ScalarPriorityMergeRange(output, output_priorities, offset,
+                               offset + WIDTH, sources, priorities, count,
+                               htp);
+      continue;
+    }
+
+    __m128i merged = zero;
+    __m128i best = zero;
+    for (unsigned int i = 0; i < count; i++) {
+      if (std::min(sources[i]->Size(), priorities[i]->Size()) <= offset)
+        continue;
+      __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+          sources[i]->GetRaw() + offset));
+      __m128i priority = _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+          priorities[i]->GetRaw() + offset));
+      // SSE2 has no unsigned compare, but priority <= best iff the max of
+      // the two is best.
+      __m128i new_best = _mm_max_epu8(best, priority);
+      __m128i lower = _mm_cmpeq_epi8(new_best, best);
+      __m128i tied = _mm_andnot_si128(_mm_cmpeq_epi8(priority, zero),
+                                      _mm_cmpeq_epi8(priority, best));
+      __m128i tied_value = htp ? _mm_max_epu8(merged, data) : data;
+      __m128i kept = _mm_or_si128(_mm_and_si128(tied, tied_value),
+                                  _mm_andnot_si128(tied, merged));
+      merged = _mm_or_si128(_mm_and_si128(lower, kept),
+                            _mm_andnot_si128(lower, data));
+      best = new_best;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + offset), merged);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output_priorities + offset),
+                     best);
+  }
+  ScalarPriorityMergeRange(output, output_priorities, offset, length, sources,
+                           priorities, count, htp);
+  return length;
+}
+#endif
+
+
+#ifdef OLA_HTP_MERGE_AVX2
+__attribute__((target("avx2")))
+static unsigned int HTPMergeAVX2(uint8_t *output,
+                                 const DmxBuffer *const *sources,
+                                 unsigned int count) {
+  static const unsigned int WIDTH = sizeof(__m256i);
+  unsigned int length = MaxLength(sources, count);
+  unsigned int offset = 0;
+  for (; offset + WIDTH <= length; offset += WIDTH) {
+    __m256i merged = _mm256_setzero_si256();
+    bool partial = false;
+    for (unsigned int i = 0; i < count; i++) {
+      unsigned int size = sources[i]->Size();
+      if (size >= offset + WIDTH) {
+        merged = _mm256_max_epu8(
+            merged,
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(
+                sources[i]->GetRaw() + offset)));
+      } else if (size > offset) {
+        partial = true;
+      }
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + offset), merged);
+    if (partial)
+      MergePartialSources(output, offset, offset + WIDTH, sources, count);
+  }
+  ScalarMergeRange(output, offset, length, sources, count);
+  return length;
+}
+
+__attribute__((target("avx2")))
+static unsigned int PriorityMergeAVX2(uint8_t *output,
+                                      uint8_t *output_priorities,
+                                      const DmxBuffer *const *sources,
+                                      const DmxBuffer *const *priorities,
+                                      unsigned int count,
+                                      bool htp) {
+  static const unsigned int WIDTH = sizeof(__m256i);
+  const __m256i zero = _mm256_setzero_si256();
+  unsigned int length = MaxLength(sources, count);
+  unsigned int offset = 0;
+  for (; offset + WIDTH <= length; offset += WIDTH) {
+    if (!PriorityBlockIsFull(offset, offset + WIDTH, sources, priorities,
+                             count)) {
+      ScalarPriorityMergeRange(output, output_priorities, offset,
+                               offset + WIDTH, sources, priorities, count,
+                               htp);
+      continue;
+    }
+
+    __m256i merged = zero;
+    __m256i best = zero;
+    for (unsigned int i = 0; i < count; i++) {
+      if (std::min(sources[i]->Size(), priorities[i]->Size()) <= offset)
+        continue;
+      __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(
+          sources[i]->GetRaw() + offset));
+      __m256i priority = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(
+          priorities[i]->GetRaw() + offset));
+      __m256i new_best = _mm256_max_epu8(best, priority);
+      __m256i lower = _mm256_cmpeq_epi8(new_best, best);
+      __m256i tied = _mm256_andnot_si256(_mm256_cmpeq_epi8(priority, zero),
+                                         _mm256_cmpeq_epi8(priority, best));
+      __m256i tied_value = htp ? _mm256_max_epu8(merged, data) : data;
+      __m256i kept = _mm256_blendv_epi8(merged, tied_value, tied);
+      merged = _mm256_blendv_epi8(data, kept, lower);
+      best = new_best;
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + offset), merged);
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i*>(output_priorities + offset), best);
+  }
+  ScalarPriorityMergeRange(output, output_priorities, offset, length, sources,
+                           priorities, count, htp);
+  return length;
+}
+#endif
+
+
+#ifdef OLA_HTP_MERGE_NEON
+static unsigned int HTPMergeNEON(uint8_t *output,
+                                 const DmxBuffer *const *sources,
+                                 unsigned int count) {
+  static const unsigned int WIDTH = sizeof(uint8x16_t);
+  unsigned int length = MaxLength(sources, count);
+  unsigned int offset = 0;
+  for (; offset + WIDTH <= length; offset += WIDTH) {
+    uint8x16_t merged = vdupq_n_u8(0);
+    bool partial = false;
+    for (unsigned int i = 0; i < count; i++) {
+      unsigned int size = sources[i]->Size();
+      if (size >= offset + WIDTH)
+        merged = vmaxq_u8(merged, vld1q_u8(sources[i]->GetRaw() + offset));
+      else if (size > offset)
+        partial = true;
+    }
+    vst1q_u8(output + offset, merged);
+    if (partial)
+      MergePartialSources(output, offset, offset + WIDTH, sources, count);
+  }
+  ScalarMergeRange(output, offset, length, sources, count);
+  return length;
+}
+
+static unsigned int PriorityMergeNEON(uint8_t *output,
+                                      uint8_t *output_priorities,
+                                      const DmxBuffer *const *sources,
+                                      const DmxBuffer *const *priorities,
+                                      unsigned int count,
+                                      bool htp) {
+  static const unsigned int WIDTH = sizeof(uint8x16_t);
+  unsigned int length = MaxLength(sources, count);
+  unsigned int offset = 0;
+  for (; offset + WIDTH <= length; offset += WIDTH) {
+    if (!PriorityBlockIsFull(offset, offset + WIDTH, sources, priorities,
+                             count)) {
+      ScalarPriorityMergeRange(output, output_priorities, offset,
+                               offset + WIDTH, sources, priorities, count,
+                               htp);
+      continue;
+    }
+
+    uint8x16_t merged = vdupq_n_u8(0);
+    uint8x16_t best = vdupq_n_u8(0);
+    for (unsigned int i = 0; i < count; i++) {
+      if (std::min(sources[i]->Size(), priorities[i]->Size()) <= offset)
+        continue;
+      uint8x16_t data = vld1q_u8(sources[i]->GetRaw() + offset);
+      uint8x16_t priority = vld1q_u8(priorities[i]->GetRaw() + offset);
+      uint8x16_t higher = vcgtq_u8(priority, best);
+      uint8x16_t tied = vandq_u8(vceqq_u8(priority, best),
+                                 vtstq_u8(priority, priority));
+      uint8x16_t tied_value = htp ? vmaxq_u8(merged, data) : data;
+      merged = vbslq_u8(higher, data, vbslq_u8(tied, tied_value, merged));
+      best = vmaxq_u8(best, priority);
+    }
+    vst1q_u8(output + offset, merged);
+    vst1q_u8(output_priorities + offset, best);
+  }
+  ScalarPriorityMergeRange(output, output_priorities, offset, length, sources,
+                           priorities, count, htp);
+  return length;
+}
+#endif
+
+
+void AvailableHTPMergeKernels(vector<HTPMergeKernel> *kernels) {
+  kernels->clear();
+  HTPMergeKernel kernel = {"scalar", HTPMergeScalar, PriorityMergeScalar};
+  kernels->push_back(kernel);
+
+#ifdef OLA_HTP_MERGE_SSE2
+  kernel.name = "sse2";
+  kernel.function = HTPMergeSSE2;
+  kernel.priority_function = PriorityMergeSSE2;
+  kernels->push_back(kernel);
+#endif
+
+#ifdef OLA_HTP_MERGE_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    kernel.name = "avx2";
+    kernel.function = HTPMergeAVX2;
+    kernel.priority_function = PriorityMergeAVX2;
+    kernels->push_back(kernel);
+  }
+#endif
+
+#ifdef OLA_HTP_MERGE_NEON
+  kernel.name = "neon";
+  kernel.function = HTPMergeNEON;
+  kernel.priority_function = PriorityMergeNEON;
+  kernels->push_back(kernel);
+#endif
+}
+
+
+static HTPMergeKernel FastestHTPMergeKernel() {
+  vector<HTPMergeKernel> kernels;
+  AvailableHTPMergeKernels(&kernels);
+  return kernels.back();
+}
+
+
+const HTPMergeKernel &SelectedHTPMergeKernel() {
+  static const HTPMergeKernel kernel = FastestHTPMergeKernel();
+  return kernel;
+}
+
+
+#ifdef OLA_HTP_MERGE_SSE2
+/*
+ * Return a bit mask with a bit set for each of the 16 bytes at offset which
+ * differ.
+ */
+static inline unsigned int DifferenceMask(const uint8_t *data,
+                                          const uint8_t *previous,
+                                          unsigned int offset) {
+  __m128i equal = _mm_cmpeq_epi8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset)),
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + offset)));
+  return ~_mm_movemask_epi8(equal) & 0xffff;
+}
+#endif
+
+
+bool FindChangedRange(const uint8_t *data,
+                      const uint8_t *previous,
+                      unsigned int length,
+                      unsigned int *start,
+                      unsigned int *end) {
+  unsigned int first = 0;
+  unsigned int last = length;
+
+#ifdef OLA_HTP_MERGE_SSE2
+  static const unsigned int WIDTH = sizeof(__m128i);
+  // find the first difference from the front
+  for (; first + WIDTH <= length; first += WIDTH) {
+    unsigned int mask = DifferenceMask(data, previous, first);
+    if (mask) {
+      first += __builtin_ctz(mask);
+      break;
+    }
+  }
+#endif
+  while (first < length && data[first] == previous[first])
+    first++;
+  if (first == length)
+    return false;
+
+#ifdef OLA_HTP_MERGE_SSE2
+  // and the last one from the back, we know there is a difference at first
+  for (; last >= first + WIDTH; last -= WIDTH) {
+    unsigned int mask = DifferenceMask(data, previous, last - WIDTH);
+    if (mask) {
+      last = last - WIDTH + (32 - __builtin_clz(mask));
+      break;
+    }
+  }
+#endif
+  while (last > first && data[last - 1] == previous[last - 1])
+    last--;
+
+  *start = first;
+  *end = last;
+  return true;
+}
+}  // ola
@@ -0,0 +1,82 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * HTPMerge.h
+ * The kernels behind DmxBuffer::HTPMerge(sources, count).
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#ifndef COMMON_UTILS_HTPMERGE_H_
+#define COMMON_UTILS_HTPMERGE_H_
+
+#include <stdint.h>
+#include <vector>
+#include "ola/DmxBuffer.h"
+
+namespace ola {
+
+/*
+ * A kernel takes the max of each channel across all the sources and writes
+ * the result to output, which must have room for DMX_UNIVERSE_SIZE channels.
+ * Channels past the end of a source's data don't take part in the merge.
+ * Output must not be the data of one of the sources.
+ * @returns the length of the merged data, the largest of the source sizes.
+ */
+typedef unsigned int (*HTPMergeFunction)(uint8_t *output,
+                                         const DmxBuffer *const *sources,
+                                         unsigned int count);
+
+/*
+ * A priority kernel merges sources which carry a priority for each channel.
+ * For each channel the sources with the highest priority win, if more than
+ * one source has that priority the values are HTP merged, or if htp is false
+ * the last of these sources in the array wins. A priority of 0, or a channel
+ * past the end of a source's priorities, means the source doesn't take part
+ * for that channel. The winning priority is written to output_priorities.
+ * @returns the length of the merged data, the largest of the source sizes.
+ */
+typedef unsigned int (*PriorityMergeFunction)(
+    uint8_t *output,
+    uint8_t *output_priorities,
+    const DmxBuffer *const *sources,
+    const DmxBuffer *const *priorities,
+    unsigned int count,
+    bool htp);
+
+typedef struct {
+  const char *name;
+  HTPMergeFunction function;
+  PriorityMergeFunction priority_function;
+} HTPMergeKernel;
+
+// The kernels this CPU can run, from slowest to fastest. The first is always
+// the portable scalar version.
+void AvailableHTPMergeKernels(std::vector<HTPMergeKernel> *kernels);
+
+// The fastest kernel for this CPU, this is chosen on the first call.
+const HTPMergeKernel &SelectedHTPMergeKernel();
+
+/*
+ * Compare two frames, a register at a time where the CPU allows.
+ * @returns false if the first length bytes are the same, otherwise true and
+ *   [start, end) is the smallest range holding every byte that differs.
+ */
+bool FindChangedRange(const uint8_t *data,
+                      const uint8_t *previous,
+                      unsigned int length,
+                      unsigned int *start,
+                      unsigned int *end);
+}  // ola
+#endif  // COMMON_UTILS_HTPMERGE_H_
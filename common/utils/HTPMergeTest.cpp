@@ -0,0 +1,308 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * HTPMergeTest.cpp
+ * Test fixture for the HTP merge kernels
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "common/utils/HTPMerge.h"
+#include "ola/BaseTypes.h"
+#include "ola/DmxBuffer.h"
+
+using ola::DmxBuffer;
+using ola::HTPMergeKernel;
+using std::string;
+using std::vector;
+
+
+class HTPMergeTest: public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(HTPMergeTest);
+  CPPUNIT_TEST(testKernels);
+  CPPUNIT_TEST(testLengths);
+  CPPUNIT_TEST(testDmxBufferMerge);
+  CPPUNIT_TEST(testPriorityKernels);
+  CPPUNIT_TEST(testDmxBufferPriorityMerge);
+  CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void testKernels();
+    void testLengths();
+    void testDmxBufferMerge();
+    void testPriorityKernels();
+    void testDmxBufferPriorityMerge();
+
+  private:
+    void CheckAllKernels(const vector<DmxBuffer> &sources);
+    void CheckAllPriorityKernels(const vector<DmxBuffer> &sources,
+                                 const vector<DmxBuffer> &priorities,
+                                 bool htp);
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(HTPMergeTest);
+
+
+/*
+ * Run every kernel this CPU supports over the sources and check the result
+ * matches a pairwise merge.
+ */
+void HTPMergeTest::CheckAllKernels(const vector<DmxBuffer> &sources) {
+  DmxBuffer expected;
+  expected.Reset();
+  vector<const DmxBuffer*> pointers;
+  for (unsigned int i = 0; i < sources.size(); i++) {
+    expected.HTPMerge(sources[i]);
+    pointers.push_back(&sources[i]);
+  }
+
+  vector<HTPMergeKernel> kernels;
+  ola::AvailableHTPMergeKernels(&kernels);
+  CPPUNIT_ASSERT(!kernels.empty());
+  CPPUNIT_ASSERT_EQUAL(string("scalar"), string(kernels[0].name));
+
+  for (unsigned int i = 0; i < kernels.size(); i++) {
+    uint8_t output[DMX_UNIVERSE_SIZE];
+    memset(output, 0xaa, sizeof(output));
+    unsigned int length = kernels[i].function(
+        output, pointers.empty() ? NULL : &pointers[0], pointers.size());
+    CPPUNIT_ASSERT_EQUAL_MESSAGE(kernels[i].name, expected.Size(), length);
+    CPPUNIT_ASSERT_MESSAGE(kernels[i].name,
+                           !memcmp(expected.GetRaw(), output, length));
+  }
+}
+
+
+/*
+ * Check the kernels with full universes and a range of source counts.
+ */
+void HTPMergeTest::testKernels() {
+  srandom(17);
+  const unsigned int counts[] = {0, 1, 2, 3, 8, 32};
+  for (unsigned int i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+    vector<DmxBuffer> sources(counts[i]);
+    for (unsigned int j = 0; j < counts[i]; j++) {
+      uint8_t data[DMX_UNIVERSE_SIZE];
+      for (unsigned int k = 0; k < DMX_UNIVERSE_SIZE; k++)
+        data[k] = random();
+      sources[j].Set(data, sizeof(data));
+    }
+    CheckAllKernels(sources);
+  }
+}
+
+
+/*
+ * Check sources that end part way through a vector register.
+ */
+void HTPMergeTest::testLengths() {
+  const unsigned int lengths[] = {0, 1, 15, 16, 17, 31, 33, 100, 511, 512};
+  const unsigned int length_count = sizeof(lengths) / sizeof(lengths[0]);
+
+  for (unsigned int i = 0; i < length_count; i++) {
+    for (unsigned int j = 0; j < length_count; j++) {
+      vector<DmxBuffer> sources(3);
+      uint8_t data[DMX_UNIVERSE_SIZE];
+      for (unsigned int k = 0; k < DMX_UNIVERSE_SIZE; k++)
+        data[k] = k;
+      sources[0].Set(data, lengths[i]);
+      memset(data, 200, sizeof(data));
+      sources[1].Set(data, lengths[j]);
+      memset(data, 100, sizeof(data));
+      sources[2].Set(data, 20);
+      CheckAllKernels(sources);
+    }
+  }
+}
+
+
+/*
+ * Check DmxBuffer::HTPMerge(sources, count), including when the destination
+ * is one of the sources.
+ */
+void HTPMergeTest::testDmxBufferMerge() {
+  const uint8_t data1[] = {1, 20, 3, 40, 5};
+  const uint8_t data2[] = {10, 2, 30};
+  const uint8_t expected_data[] = {10, 20, 30, 40, 5};
+  const DmxBuffer expected(expected_data, sizeof(expected_data));
+
+  DmxBuffer source1(data1, sizeof(data1));
+  DmxBuffer source2(data2, sizeof(data2));
+  const DmxBuffer *sources[] = {&source1, &source2};
+
+  DmxBuffer output;
+  CPPUNIT_ASSERT(output.HTPMerge(sources, 2));
+  CPPUNIT_ASSERT(expected == output);
+
+  // merging no sources leaves an empty buffer
+  CPPUNIT_ASSERT(output.HTPMerge(sources, 0));
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, output.Size());
+
+  CPPUNIT_ASSERT(source2.HTPMerge(sources, 2));
+  CPPUNIT_ASSERT(expected == source2);
+}
+
+
+/*
+ * Run every priority kernel over the sources and check the result matches a
+ * channel by channel merge.
+ */
+void HTPMergeTest::CheckAllPriorityKernels(const vector<DmxBuffer> &sources,
+                                           const vector<DmxBuffer> &priorities,
+                                           bool htp) {
+  uint8_t expected[DMX_UNIVERSE_SIZE];
+  uint8_t expected_priorities[DMX_UNIVERSE_SIZE];
+  unsigned int expected_length = 0;
+  vector<const DmxBuffer*> source_pointers, priority_pointers;
+  for (unsigned int i = 0; i < sources.size(); i++) {
+    expected_length = std::max(expected_length, sources[i].Size());
+    source_pointers.push_back(&sources[i]);
+    priority_pointers.push_back(&priorities[i]);
+  }
+
+  for (unsigned int channel = 0; channel < expected_length; channel++) {
+    uint8_t value = 0, priority = 0;
+    for (unsigned int i = 0; i < sources.size(); i++) {
+      if (channel >= sources[i].Size() || channel >= priorities[i].Size())
+        continue;
+      uint8_t source_priority = priorities[i].Get(channel);
+      uint8_t source_value = sources[i].Get(channel);
+      if (!source_priority || source_priority < priority)
+        continue;
+      if (source_priority > priority)
+        value = source_value;
+      else
+        value = htp ? std::max(value, source_value) : source_value;
+      priority = source_priority;
+    }
+    expected[channel] = value;
+    expected_priorities[channel] = priority;
+  }
+
+  vector<HTPMergeKernel> kernels;
+  ola::AvailableHTPMergeKernels(&kernels);
+  for (unsigned int i = 0; i < kernels.size(); i++) {
+    uint8_t output[DMX_UNIVERSE_SIZE];
+    uint8_t output_priorities[DMX_UNIVERSE_SIZE];
+    memset(output, 0xaa, sizeof(output));
+    memset(output_priorities, 0xaa, sizeof(output_priorities));
+    unsigned int length = kernels[i].priority_function(
+        output, output_priorities,
+        source_pointers.empty() ? NULL : &source_pointers[0],
+        priority_pointers.empty() ? NULL : &priority_pointers[0],
+        sources.size(), htp);
+    CPPUNIT_ASSERT_EQUAL_MESSAGE(kernels[i].name, expected_length, length);
+    CPPUNIT_ASSERT_MESSAGE(kernels[i].name,
+                           !memcmp(expected, output, length));
+    CPPUNIT_ASSERT_MESSAGE(
+        kernels[i].name,
+        !memcmp(expected_priorities, output_priorities, length));
+  }
+}
+
+
+/*
+ * Usually return a full universe, otherwise a random length.
+ */
+static unsigned int RandomLength() {
+  if (random() % 4)
+    return DMX_UNIVERSE_SIZE;
+  return random() % (DMX_UNIVERSE_SIZE + 1);
+}
+
+
+/*
+ * Check the priority kernels with random priorities & lengths.
+ */
+void HTPMergeTest::testPriorityKernels() {
+  srandom(23);
+  const unsigned int counts[] = {0, 1, 2, 3, 8, 32};
+  for (unsigned int round = 0; round < 20; round++) {
+    for (unsigned int i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+      vector<DmxBuffer> sources(counts[i]);
+      vector<DmxBuffer> priorities(counts[i]);
+      for (unsigned int j = 0; j < counts[i]; j++) {
+        uint8_t data[DMX_UNIVERSE_SIZE];
+        uint8_t priority[DMX_UNIVERSE_SIZE];
+        for (unsigned int k = 0; k < DMX_UNIVERSE_SIZE; k++) {
+          data[k] = random();
+          // a small range, so priorities are often tied or 0
+          priority[k] = random() % 4;
+        }
+        // most sources cover the whole universe, so the vector code runs
+        sources[j].Set(data, RandomLength());
+        priorities[j].Set(priority, RandomLength());
+      }
+      CheckAllPriorityKernels(sources, priorities, true);
+      CheckAllPriorityKernels(sources, priorities, false);
+    }
+  }
+}
+
+
+/*
+ * Check DmxBuffer::PriorityMerge().
+ */
+void HTPMergeTest::testDmxBufferPriorityMerge() {
+  const uint8_t data1[] = {10, 20, 30, 40};
+  const uint8_t priority1[] = {100, 100, 50, 0};
+  const uint8_t data2[] = {5, 25, 35};
+  const uint8_t priority2[] = {50, 100, 100};
+  const uint8_t expected_data[] = {10, 25, 35, 0};
+  const uint8_t expected_priority_data[] = {100, 100, 100, 0};
+
+  DmxBuffer source1(data1, sizeof(data1));
+  DmxBuffer source2(data2, sizeof(data2));
+  DmxBuffer priorities1(priority1, sizeof(priority1));
+  DmxBuffer priorities2(priority2, sizeof(priority2));
+  const DmxBuffer *sources[] = {&source1, &source2};
+  const DmxBuffer *priorities[] = {&priorities1, &priorities2};
+
+  DmxBuffer output, merged_priorities;
+  CPPUNIT_ASSERT(output.PriorityMerge(sources, priorities, 2,
+                                      &merged_priorities));
+  CPPUNIT_ASSERT(DmxBuffer(expected_data, sizeof(expected_data)) == output);
+  CPPUNIT_ASSERT(DmxBuffer(expected_priority_data,
+                           sizeof(expected_priority_data)) ==
+                 merged_priorities);
+
+  // with LTP the later source wins the tie on channel 2
+  const uint8_t low_data[] = {5, 15, 35};
+  source2.Set(low_data, sizeof(low_data));
+  CPPUNIT_ASSERT(output.PriorityMerge(sources, priorities, 2,
+                                      &merged_priorities, false));
+  const uint8_t ltp_data[] = {10, 15, 35, 0};
+  CPPUNIT_ASSERT(DmxBuffer(ltp_data, sizeof(ltp_data)) == output);
+  CPPUNIT_ASSERT(output.PriorityMerge(sources, priorities, 2,
+                                      &merged_priorities, true));
+  const uint8_t htp_data[] = {10, 20, 35, 0};
+  CPPUNIT_ASSERT(DmxBuffer(htp_data, sizeof(htp_data)) == output);
+
+  // the destination can be one of the sources
+  source2.Set(data2, sizeof(data2));
+  CPPUNIT_ASSERT(source1.PriorityMerge(sources, priorities, 2,
+                                       &merged_priorities));
+  CPPUNIT_ASSERT(DmxBuffer(expected_data, sizeof(expected_data)) == source1);
+
+  // but not the same buffer as the priorities
+  CPPUNIT_ASSERT(!output.PriorityMerge(sources, priorities, 2, &output));
+}
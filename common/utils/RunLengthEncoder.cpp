@@ -111,21 +111,28 @@ bool RunLengthEncoder::Encode(const DmxBuffer &src,
  * @param start_channel the first channel for the RLE'ed data
  * @param src_data the data to decode
  * @param length the length of the data to decode
+ * @return true if the data was decoded, false if it was truncated or ran past
+ *   the end of the universe.
  */
 bool RunLengthEncoder::Decode(DmxBuffer *dst,
                               unsigned int start_channel,
                               const uint8_t *src_data,
                               unsigned int length) {
-  int destination_index = start_channel;
+  unsigned int destination_index = start_channel;
 
   for (unsigned int i = 0; i < length;) {
     unsigned int segment_length = src_data[i] & (~REPEAT_FLAG);
     if (src_data[i] & REPEAT_FLAG) {
       i++;
-      dst->SetRangeToValue(destination_index, src_data[i++], segment_length);
+      if (i == length ||
+          !dst->SetRangeToValue(destination_index, src_data[i++],
+                                segment_length))
+        return false;
     } else {
       i++;
-      dst->SetRange(destination_index, src_data + i, segment_length);
+      if (segment_length > length - i ||
+          !dst->SetRange(destination_index, src_data + i, segment_length))
+        return false;
       i += segment_length;
     }
     destination_index += segment_length;
@@ -33,11 +33,13 @@ class RunLengthEncoderTest: public CppUnit::TestFixture {
   CPPUNIT_TEST_SUITE(RunLengthEncoderTest);
   CPPUNIT_TEST(testEncode);
   CPPUNIT_TEST(testEncode2);
+  CPPUNIT_TEST(testDecode);
   CPPUNIT_TEST_SUITE_END();
 
   public:
     void testEncode();
     void testEncode2();
+    void testDecode();
     void testEncodeDecode();
     void setUp();
     void tearDown();
@@ -134,6 +136,34 @@ void RunLengthEncoderTest::testEncode2() {
 }
 
 
+/*
+ * Check that decoding works and truncated data is rejected.
+ */
+void RunLengthEncoderTest::testDecode() {
+  const uint8_t ENCODED_DATA[] = {4, 1, 2, 2, 3, 0x83, 0, 1, 1, 0x83, 3, 2,
+                                  1, 2};
+  const uint8_t EXPECTED_DATA[] = {1, 2, 2, 3, 0, 0, 0, 1, 3, 3, 3, 1, 2};
+  DmxBuffer buffer;
+  buffer.Set(EXPECTED_DATA, 0);
+  CPPUNIT_ASSERT(m_encoder.Decode(&buffer, 0, ENCODED_DATA,
+                                  sizeof(ENCODED_DATA)));
+  CPPUNIT_ASSERT(DmxBuffer(EXPECTED_DATA, sizeof(EXPECTED_DATA)) == buffer);
+
+  // missing the repeated value
+  buffer.Set(EXPECTED_DATA, 0);
+  CPPUNIT_ASSERT(!m_encoder.Decode(&buffer, 0, ENCODED_DATA, 6));
+
+  // missing some of the values
+  buffer.Set(EXPECTED_DATA, 0);
+  CPPUNIT_ASSERT(!m_encoder.Decode(&buffer, 0, ENCODED_DATA, 3));
+
+  // past the end of the universe
+  buffer.Blackout();
+  CPPUNIT_ASSERT(!m_encoder.Decode(&buffer, DMX_UNIVERSE_SIZE, ENCODED_DATA,
+                                   sizeof(ENCODED_DATA)));
+}
+
+
 /*
  * Call Encode then Decode and check the results
  */
@@ -0,0 +1,290 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * SharedDmxRegion.cpp
+ * A shared memory region that holds a DMX frame per slot.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+
+#include "common/utils/SharedDmxRegion.h"
+#include "ola/Logging.h"
+#include "ola/StringUtils.h"
+
+namespace ola {
+
+using std::string;
+
+unsigned int SharedDmxRegion::s_region_counter = 0;
+
+
+SharedDmxRegion::SharedDmxRegion()
+    : m_header(NULL),
+      m_slots(NULL),
+      m_slot_count(0),
+      m_size(0) {
+}
+
+
+/*
+ * Create a new region. The name is unique to this process.
+ * @param slot_count the number of slots in the region
+ * @returns true if the region was created, false otherwise
+ */
+bool SharedDmxRegion::Create(unsigned int slot_count) {
+  Close();
+  if (!slot_count || slot_count > MAX_SLOTS) {
+    OLA_WARN << "Invalid shared memory slot count " << slot_count;
+    return false;
+  }
+
+  string name = "/ola-" + IntToString(getpid()) + "-" +
+    IntToString(__sync_fetch_and_add(&s_region_counter, 1));
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) {
+    OLA_WARN << "shm_open(" << name << ") failed: " << strerror(errno);
+    return false;
+  }
+
+  size_t size = RegionSize(slot_count);
+  if (ftruncate(fd, size) < 0) {
+    OLA_WARN << "ftruncate(" << name << ") failed: " << strerror(errno);
+    close(fd);
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  bool ok = Map(fd, size);
+  close(fd);
+  if (!ok) {
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  // ftruncate zeroed the slots
+  m_header->slot_count = slot_count;
+  m_header->doorbell_armed = 0;
+  __sync_synchronize();
+  m_header->magic = MAGIC;
+  m_slot_count = slot_count;
+  m_name = name;
+  return true;
+}
+
+
+/*
+ * Map a region created by another process.
+ * @param name the name of the region
+ * @returns true if the region was mapped, false otherwise
+ */
+bool SharedDmxRegion::Open(const string &name) {
+  Close();
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    OLA_WARN << "shm_open(" << name << ") failed: " << strerror(errno);
+    return false;
+  }
+
+  struct stat stats;
+  if (fstat(fd, &stats) < 0 ||
+      stats.st_size < static_cast<off_t>(RegionSize(1))) {
+    OLA_WARN << "Shared memory region " << name << " is too small";
+    close(fd);
+    return false;
+  }
+
+  bool ok = Map(fd, stats.st_size);
+  close(fd);
+  if (!ok)
+    return false;
+
+  if (m_header->magic != MAGIC ||
+      m_header->slot_count > MAX_SLOTS ||
+      RegionSize(m_header->slot_count) > m_size) {
+    OLA_WARN << "Shared memory region " << name << " isn't a DMX region";
+    Close();
+    return false;
+  }
+  m_slot_count = m_header->slot_count;
+  m_name = name;
+  return true;
+}
+
+
+/*
+ * Remove the name of the region. The memory remains mapped until both sides
+ * close it.
+ */
+void SharedDmxRegion::Unlink() {
+  if (!m_name.empty())
+    shm_unlink(m_name.c_str());
+}
+
+
+/*
+ * Unmap the region.
+ */
+void SharedDmxRegion::Close() {
+  if (m_header)
+    munmap(m_header, m_size);
+  m_header = NULL;
+  m_slots = NULL;
+  m_slot_count = 0;
+  m_size = 0;
+  m_name.clear();
+}
+
+
+/*
+ * Write a frame to a slot, the reader chooses the priority.
+ */
+void SharedDmxRegion::Write(unsigned int slot, const DmxBuffer &buffer) {
+  WriteSlot(slot, buffer, false, 0);
+}
+
+
+/*
+ * Write a frame with a priority to a slot.
+ */
+void SharedDmxRegion::Write(unsigned int slot, const DmxBuffer &buffer,
+                            uint8_t priority) {
+  WriteSlot(slot, buffer, true, priority);
+}
+
+
+/*
+ * Check if the reader is waiting for a frame.
+ * @returns true if the reader armed the doorbell, in which case the caller
+ *   must wake it up.
+ */
+bool SharedDmxRegion::TakeDoorbell() {
+  if (!m_header)
+    return false;
+  // WriteSlot ends with a barrier, so the frame is visible before we look
+  return m_header->doorbell_armed &&
+    __sync_bool_compare_and_swap(&m_header->doorbell_armed, 1, 0);
+}
+
+
+/*
+ * Read the frame in a slot if it's changed.
+ * @param slot the slot to read
+ * @param sequence the sequence number of the last frame read from this slot,
+ *   updated if a new frame is read. Start with 0.
+ * @param buffer the DmxBuffer to copy the frame to
+ * @param has_priority if not NULL, set to true if the frame has a priority
+ * @param priority if not NULL, set to the priority of the frame
+ * @returns true if a new frame was read, false if the slot hasn't changed or
+ *   the writer was too busy for a consistent copy.
+ */
+bool SharedDmxRegion::Read(unsigned int slot, uint32_t *sequence,
+                           DmxBuffer *buffer, bool *has_priority,
+                           uint8_t *priority) const {
+  if (!m_header || slot >= m_slot_count)
+    return false;
+
+  const dmx_slot &current = m_slots[slot];
+  uint8_t data[DMX_UNIVERSE_SIZE];
+  for (unsigned int i = 0; i < MAX_READ_ATTEMPTS; i++) {
+    uint32_t start = current.sequence;
+    __sync_synchronize();
+    if (start == *sequence)
+      return false;
+    if (start & 1)
+      continue;
+
+    unsigned int length = current.length;
+    if (length > DMX_UNIVERSE_SIZE)
+      length = 0;
+    bool frame_has_priority = current.has_priority;
+    uint8_t frame_priority = current.priority;
+    memcpy(data, current.data, length);
+    __sync_synchronize();
+    if (current.sequence != start)
+      continue;
+
+    buffer->Set(data, length);
+    if (has_priority)
+      *has_priority = frame_has_priority;
+    if (priority)
+      *priority = frame_priority;
+    *sequence = start;
+    return true;
+  }
+  return false;
+}
+
+
+/*
+ * Ask the writers to wake us up. This must be called before the slots are
+ * read, otherwise a frame written between the read and the arming would be
+ * missed until the next one.
+ */
+void SharedDmxRegion::ArmDoorbell() {
+  if (!m_header)
+    return;
+  m_header->doorbell_armed = 1;
+  __sync_synchronize();
+}
+
+
+bool SharedDmxRegion::Map(int fd, size_t size) {
+  void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (memory == MAP_FAILED) {
+    OLA_WARN << "mmap failed: " << strerror(errno);
+    return false;
+  }
+  m_header = reinterpret_cast<region_header*>(memory);
+  m_slots = reinterpret_cast<dmx_slot*>(
+      reinterpret_cast<uint8_t*>(memory) + sizeof(region_header));
+  m_size = size;
+  return true;
+}
+
+
+void SharedDmxRegion::WriteSlot(unsigned int slot, const DmxBuffer &buffer,
+                                bool has_priority, uint8_t priority) {
+  if (!m_header || slot >= m_slot_count)
+    return;
+
+  // The peer can write to the slot at any time, so only the local copies of
+  // the sequence number and length are used.
+  dmx_slot &current = m_slots[slot];
+  const uint32_t sequence = current.sequence | 1;
+  current.sequence = sequence;
+  __sync_synchronize();
+  const unsigned int length = buffer.Size();
+  current.length = length;
+  current.has_priority = has_priority;
+  current.priority = priority;
+  memcpy(current.data, buffer.GetRaw(), length);
+  __sync_synchronize();
+  // skip 0 so a reader that starts at 0 always sees the first frame
+  current.sequence = sequence == 0xffffffff ? 2 : sequence + 1;
+  __sync_synchronize();
+}
+
+
+size_t SharedDmxRegion::RegionSize(unsigned int slot_count) {
+  return sizeof(region_header) + slot_count * sizeof(dmx_slot);
+}
+}  // ola
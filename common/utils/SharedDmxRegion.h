@@ -0,0 +1,103 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * SharedDmxRegion.h
+ * A shared memory region that holds a DMX frame per slot.
+ * Copyright (C) 2012 Simon Newton
+ *
+ * olad creates a region for a client and the client maps it by name. Each
+ * slot carries one universe in one direction, so every slot has a single
+ * writer. Like the UniverseSnapshot, a slot is protected by a sequence number
+ * that is odd while the frame is being written; a reader retries if the
+ * sequence number changed while it was copying.
+ *
+ * The region also has a doorbell flag. The reader arms it when it's about to
+ * go idle, and the writer takes it after writing a frame. Only a writer that
+ * took the doorbell needs to wake the reader up, so a busy stream of frames
+ * doesn't need any system calls.
+ */
+
+#ifndef COMMON_UTILS_SHAREDDMXREGION_H_
+#define COMMON_UTILS_SHAREDDMXREGION_H_
+
+#include <stdint.h>
+#include <string>
+#include "ola/BaseTypes.h"
+#include "ola/DmxBuffer.h"
+
+namespace ola {
+
+class SharedDmxRegion {
+  public:
+    SharedDmxRegion();
+    ~SharedDmxRegion() { Close(); }
+
+    bool Create(unsigned int slot_count);
+    bool Open(const std::string &name);
+    void Unlink();
+    void Close();
+
+    bool IsOpen() const { return m_header != NULL; }
+    const std::string &Name() const { return m_name; }
+    unsigned int SlotCount() const { return m_slot_count; }
+
+    // Called by the writer of a slot
+    void Write(unsigned int slot, const DmxBuffer &buffer);
+    void Write(unsigned int slot, const DmxBuffer &buffer, uint8_t priority);
+    bool TakeDoorbell();
+
+    // Called by the reader of a slot
+    bool Read(unsigned int slot, uint32_t *sequence, DmxBuffer *buffer,
+              bool *has_priority = NULL, uint8_t *priority = NULL) const;
+    void ArmDoorbell();
+
+    static const unsigned int MAX_SLOTS = 1024;
+
+  private:
+    typedef struct {
+      uint32_t magic;
+      uint32_t slot_count;
+      volatile uint32_t doorbell_armed;
+    } region_header;
+
+    typedef struct {
+      volatile uint32_t sequence;  // odd while the frame is being written
+      uint16_t length;
+      uint8_t has_priority;
+      uint8_t priority;
+      uint8_t data[DMX_UNIVERSE_SIZE];
+    } dmx_slot;
+
+    std::string m_name;
+    region_header *m_header;
+    dmx_slot *m_slots;
+    // kept out of the region so the other side can't change it
+    unsigned int m_slot_count;
+    size_t m_size;
+
+    bool Map(int fd, size_t size);
+    void WriteSlot(unsigned int slot, const DmxBuffer &buffer,
+                   bool has_priority, uint8_t priority);
+    static size_t RegionSize(unsigned int slot_count);
+
+    static const uint32_t MAGIC = 0x4f4c4131;  // OLA1
+    static const unsigned int MAX_READ_ATTEMPTS = 100;
+    static unsigned int s_region_counter;
+
+    SharedDmxRegion(const SharedDmxRegion&);
+    SharedDmxRegion& operator=(const SharedDmxRegion&);
+};
+}  // ola
+#endif  // COMMON_UTILS_SHAREDDMXREGION_H_
@@ -0,0 +1,160 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * SharedDmxRegionTest.cpp
+ * Test fixture for the SharedDmxRegion class
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <stdint.h>
+#include <string>
+
+#include "common/utils/SharedDmxRegion.h"
+#include "ola/DmxBuffer.h"
+
+using ola::DmxBuffer;
+using ola::SharedDmxRegion;
+using std::string;
+
+
+class SharedDmxRegionTest: public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(SharedDmxRegionTest);
+  CPPUNIT_TEST(testCreateAndOpen);
+  CPPUNIT_TEST(testReadWrite);
+  CPPUNIT_TEST(testDoorbell);
+  CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void testCreateAndOpen();
+    void testReadWrite();
+    void testDoorbell();
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SharedDmxRegionTest);
+
+
+/*
+ * Check creating, opening and unlinking regions.
+ */
+void SharedDmxRegionTest::testCreateAndOpen() {
+  SharedDmxRegion region;
+  CPPUNIT_ASSERT(!region.IsOpen());
+  CPPUNIT_ASSERT(!region.Create(0));
+  CPPUNIT_ASSERT(!region.Create(SharedDmxRegion::MAX_SLOTS + 1));
+
+  CPPUNIT_ASSERT(region.Create(4));
+  CPPUNIT_ASSERT(region.IsOpen());
+  CPPUNIT_ASSERT_EQUAL(4u, region.SlotCount());
+  string name = region.Name();
+  CPPUNIT_ASSERT(!name.empty());
+
+  // each region gets a new name
+  SharedDmxRegion other_region;
+  CPPUNIT_ASSERT(other_region.Create(1));
+  CPPUNIT_ASSERT(name != other_region.Name());
+  other_region.Unlink();
+
+  SharedDmxRegion client;
+  CPPUNIT_ASSERT(client.Open(name));
+  CPPUNIT_ASSERT_EQUAL(4u, client.SlotCount());
+
+  // once unlinked, the mapping remains but the name can't be opened
+  region.Unlink();
+  SharedDmxRegion late_client;
+  CPPUNIT_ASSERT(!late_client.Open(name));
+  CPPUNIT_ASSERT(client.IsOpen());
+
+  client.Close();
+  CPPUNIT_ASSERT(!client.IsOpen());
+  CPPUNIT_ASSERT_EQUAL(0u, client.SlotCount());
+}
+
+
+/*
+ * Check frames written by one mapping are read by another.
+ */
+void SharedDmxRegionTest::testReadWrite() {
+  SharedDmxRegion region, client;
+  CPPUNIT_ASSERT(region.Create(2));
+  CPPUNIT_ASSERT(client.Open(region.Name()));
+  region.Unlink();
+
+  DmxBuffer buffer, result;
+  uint32_t sequence = 0;
+  bool has_priority = true;
+  uint8_t priority = 0;
+
+  // nothing has been written yet
+  CPPUNIT_ASSERT(!region.Read(0, &sequence, &result));
+
+  buffer.SetFromString("1,2,3");
+  client.Write(0, buffer);
+  CPPUNIT_ASSERT(region.Read(0, &sequence, &result, &has_priority,
+                             &priority));
+  CPPUNIT_ASSERT(buffer == result);
+  CPPUNIT_ASSERT(!has_priority);
+
+  // the frame is only returned once
+  CPPUNIT_ASSERT(!region.Read(0, &sequence, &result));
+
+  buffer.SetFromString("4,5");
+  client.Write(0, buffer, 150);
+  CPPUNIT_ASSERT(region.Read(0, &sequence, &result, &has_priority,
+                             &priority));
+  CPPUNIT_ASSERT(buffer == result);
+  CPPUNIT_ASSERT(has_priority);
+  CPPUNIT_ASSERT_EQUAL(static_cast<uint8_t>(150), priority);
+
+  // the other slot is independent
+  uint32_t other_sequence = 0;
+  CPPUNIT_ASSERT(!client.Read(1, &other_sequence, &result));
+  buffer.SetFromString("9,8,7,6");
+  region.Write(1, buffer);
+  CPPUNIT_ASSERT(client.Read(1, &other_sequence, &result));
+  CPPUNIT_ASSERT(buffer == result);
+  CPPUNIT_ASSERT(!region.Read(0, &sequence, &result));
+
+  // an empty frame is still a frame
+  client.Write(0, DmxBuffer());
+  CPPUNIT_ASSERT(region.Read(0, &sequence, &result));
+  CPPUNIT_ASSERT_EQUAL(0u, result.Size());
+
+  // slots past the end are ignored
+  client.Write(2, buffer);
+  CPPUNIT_ASSERT(!region.Read(2, &sequence, &result));
+}
+
+
+/*
+ * Check the doorbell is only taken once each time it's armed.
+ */
+void SharedDmxRegionTest::testDoorbell() {
+  SharedDmxRegion region, client;
+  CPPUNIT_ASSERT(region.Create(1));
+  CPPUNIT_ASSERT(client.Open(region.Name()));
+  region.Unlink();
+
+  CPPUNIT_ASSERT(!client.TakeDoorbell());
+  region.ArmDoorbell();
+  CPPUNIT_ASSERT(client.TakeDoorbell());
+  CPPUNIT_ASSERT(!client.TakeDoorbell());
+
+  region.ArmDoorbell();
+  region.ArmDoorbell();
+  CPPUNIT_ASSERT(client.TakeDoorbell());
+  CPPUNIT_ASSERT(!client.TakeDoorbell());
+}
@@ -0,0 +1,172 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * dmx_buffer_benchmark.cpp
+ * Runs the DmxBuffer operations that happen for each merged frame and counts
+ * the heap allocations. This follows the same steps as the daemon: a plugin
+ * decodes a packet into its buffer, the port copies it into the DmxSource,
+ * the universe HTP merges the sources and hands the result to the outputs.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "ola/BaseTypes.h"
+#include "ola/Clock.h"
+#include "ola/DmxBuffer.h"
+#include "ola/Logging.h"
+#include "ola/StringUtils.h"
+
+using ola::Clock;
+using ola::DmxBuffer;
+using ola::TimeInterval;
+using ola::TimeStamp;
+using std::cout;
+using std::endl;
+using std::vector;
+
+static unsigned int allocations = 0;
+
+void *operator new(size_t size) throw(std::bad_alloc) {
+  allocations++;
+  void *ptr = malloc(size ? size : 1);
+  if (!ptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void *operator new[](size_t size) throw(std::bad_alloc) {
+  return operator new(size);
+}
+
+void operator delete(void *ptr) throw() {
+  free(ptr);
+}
+
+void operator delete[](void *ptr) throw() {
+  free(ptr);
+}
+
+
+typedef struct {
+  unsigned int frames;
+  unsigned int sources;
+} options;
+
+
+/*
+ * Display the help message
+ */
+void DisplayHelpAndExit(char *argv[]) {
+  cout << "Usage: " << argv[0] << " [options]\n"
+  "\n"
+  "Count the allocations needed to merge DMX frames.\n"
+  "\n"
+  "  -f, --frames <count>    The number of frames to merge.\n"
+  "  -h, --help              Display this help message and exit.\n"
+  "  -s, --sources <count>   The number of sources to merge.\n"
+  << endl;
+  exit(0);
+}
+
+
+/*
+ * Parse our command line options
+ */
+void ParseOptions(int argc, char *argv[], options *opts) {
+  static struct option long_options[] = {
+      {"frames", required_argument, 0, 'f'},
+      {"help", no_argument, 0, 'h'},
+      {"sources", required_argument, 0, 's'},
+      {0, 0, 0, 0}
+    };
+
+  int option_index = 0;
+  while (1) {
+    int c = getopt_long(argc, argv, "f:hs:", long_options, &option_index);
+    if (c == -1)
+      break;
+
+    switch (c) {
+      case 0:
+        break;
+      case 'f':
+        ola::StringToInt(optarg, &opts->frames);
+        break;
+      case 'h':
+        DisplayHelpAndExit(argv);
+        break;
+      case 's':
+        ola::StringToInt(optarg, &opts->sources);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+
+int main(int argc, char *argv[]) {
+  options opts;
+  opts.frames = 100000;
+  opts.sources = 4;
+  ParseOptions(argc, argv, &opts);
+  ola::InitLogging(ola::OLA_LOG_WARN, ola::OLA_LOG_STDERR);
+
+  if (!opts.sources)
+    opts.sources = 1;
+
+  uint8_t packet[DMX_UNIVERSE_SIZE];
+  // the buffers the plugins decode into and the port's copies of them
+  vector<DmxBuffer> plugin_buffers(opts.sources);
+  vector<DmxBuffer> source_buffers(opts.sources);
+  DmxBuffer merged, output;
+
+  Clock clock;
+  TimeStamp start, end;
+  clock.CurrentTime(&start);
+  unsigned int start_allocations = allocations;
+
+  for (unsigned int frame = 0; frame < opts.frames; frame++) {
+    for (unsigned int i = 0; i < opts.sources; i++) {
+      for (unsigned int j = 0; j < DMX_UNIVERSE_SIZE; j++)
+        packet[j] = frame + i + j;
+      plugin_buffers[i].Set(packet, sizeof(packet));
+      source_buffers[i] = plugin_buffers[i];
+    }
+
+    merged.Reset();
+    for (unsigned int i = 0; i < opts.sources; i++)
+      merged.HTPMerge(source_buffers[i]);
+    output = merged;
+  }
+
+  unsigned int frame_allocations = allocations - start_allocations;
+  clock.CurrentTime(&end);
+  TimeInterval duration = end - start;
+
+  cout << opts.frames << " frames of " << opts.sources << " sources in " <<
+    duration << "s" << endl;
+  cout << "  " << static_cast<double>(frame_allocations) / opts.frames <<
+    " allocations per merged frame" << endl;
+  cout << "  " << static_cast<unsigned int>(
+      opts.frames * 1000000.0 / duration.AsInt()) << " frames/s" << endl;
+  return output.Size() ? 0 : 1;
+}
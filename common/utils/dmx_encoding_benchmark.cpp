@@ -0,0 +1,290 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * dmx_encoding_benchmark.cpp
+ * Measures the size of the data in each DmxData message, and the time taken
+ * to encode and decode it, for some typical lighting cues. Each cue is sent
+ * as is, run length encoded, as deltas and with both, which is what clients
+ * that call SetupEncoding() use.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "common/utils/DmxFrameEncoder.h"
+#include "ola/BaseTypes.h"
+#include "ola/Clock.h"
+#include "ola/DmxBuffer.h"
+#include "ola/Logging.h"
+#include "ola/StringUtils.h"
+
+using ola::Clock;
+using ola::DmxBuffer;
+using ola::DecodeDmxFrame;
+using ola::DmxFrameEncoder;
+using ola::TimeStamp;
+using std::cout;
+using std::endl;
+using std::vector;
+
+
+typedef struct {
+  unsigned int frames;
+} options;
+
+
+typedef enum {
+  CUE_STATIC,
+  CUE_FADE,
+  CUE_MOVEMENT,
+  CUE_CHASE,
+  CUE_FULL
+} cue_type;
+
+
+typedef struct {
+  cue_type type;
+  const char *name;
+  const char *description;
+} cue;
+
+static const cue CUES[] = {
+  {CUE_STATIC, "static", "a held cue, resent at the refresh rate"},
+  {CUE_FADE, "fade", "48 dimmers fading"},
+  {CUE_MOVEMENT, "movement", "pan & tilt on 12 moving lights"},
+  {CUE_CHASE, "chase", "a 24 channel chase, stepping every 10 frames"},
+  {CUE_FULL, "full", "every channel changing, e.g. pixel mapped video"},
+};
+
+
+typedef struct {
+  const char *name;
+  bool rle;
+  bool delta;
+} encoding_mode;
+
+static const encoding_mode MODES[] = {
+  {"raw", false, false},
+  {"rle", true, false},
+  {"delta", false, true},
+  {"both", true, true},
+};
+
+
+typedef struct {
+  uint64_t bytes;
+  int64_t encode_time;  // in microseconds
+  int64_t decode_time;
+} result;
+
+
+static const unsigned int BATCH_SIZE = 1000;
+
+
+/*
+ * Display the help message
+ */
+void DisplayHelpAndExit(char *argv[]) {
+  cout << "Usage: " << argv[0] << " [options]\n"
+  "\n"
+  "Compare the size of encoded DMX frames, and the time taken to encode and\n"
+  "decode them.\n"
+  "\n"
+  "  -f, --frames <count>    The number of frames for each cue.\n"
+  "  -h, --help              Display this help message and exit.\n"
+  << endl;
+  exit(0);
+}
+
+
+/*
+ * Parse our command line options
+ */
+void ParseOptions(int argc, char *argv[], options *opts) {
+  static struct option long_options[] = {
+      {"frames", required_argument, 0, 'f'},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0}
+    };
+
+  int option_index = 0;
+  while (1) {
+    int c = getopt_long(argc, argv, "f:h", long_options, &option_index);
+    if (c == -1)
+      break;
+
+    switch (c) {
+      case 0:
+        break;
+      case 'f':
+        ola::StringToInt(optarg, &opts->frames);
+        break;
+      case 'h':
+        DisplayHelpAndExit(argv);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+
+/*
+ * Build the frame for a cue. The first 300 channels are patched and have
+ * levels from the previous cues, the rest of the universe is empty.
+ */
+void BuildFrame(cue_type type, unsigned int frame_number, uint8_t *data) {
+  for (unsigned int i = 0; i < DMX_UNIVERSE_SIZE; i++)
+    data[i] = i < 300 ? (i * 73 + 41) % 256 : 0;
+
+  switch (type) {
+    case CUE_STATIC:
+      break;
+    case CUE_FADE:
+      for (unsigned int i = 0; i < 48; i++)
+        data[i] = (frame_number + i) % 256;
+      break;
+    case CUE_MOVEMENT:
+      // 16 channel fixtures from channel 100, pan, pan fine, tilt & tilt fine
+      // are the first four
+      for (unsigned int i = 0; i < 12; i++) {
+        uint8_t *fixture = data + 100 + i * 16;
+        unsigned int pan = (frame_number * 37 + i * 1000) % 65536;
+        unsigned int tilt = (frame_number * 23 + i * 3000) % 65536;
+        fixture[0] = pan >> 8;
+        fixture[1] = pan & 0xff;
+        fixture[2] = tilt >> 8;
+        fixture[3] = tilt & 0xff;
+      }
+      break;
+    case CUE_CHASE:
+      for (unsigned int i = 0; i < 24; i++)
+        data[200 + i] = (i == (frame_number / 10) % 24) ? 255 : 0;
+      break;
+    case CUE_FULL:
+      for (unsigned int i = 0; i < DMX_UNIVERSE_SIZE; i++)
+        data[i] = (frame_number * 7 + i * 37 + i / 7) % 256;
+      break;
+  }
+}
+
+
+/*
+ * Run the frames for a cue through an encoder and a decoder. The frames are
+ * built in batches, then the batch is encoded and the encoded frames are
+ * decoded, so only the encoding and decoding are timed.
+ * @returns false if a frame wasn't decoded correctly.
+ */
+bool RunCue(const options &opts, cue_type type, const encoding_mode &mode,
+            result *result) {
+  DmxFrameEncoder encoder;
+  if (mode.rle)
+    encoder.EnableEncoding(ola::DMX_ENCODING_RLE);
+  if (mode.delta)
+    encoder.EnableEncoding(ola::DMX_ENCODING_DELTA);
+
+  uint8_t data[DMX_UNIVERSE_SIZE];
+  vector<DmxBuffer> frames(BATCH_SIZE);
+  vector<uint8_t> encoded(BATCH_SIZE * DMX_UNIVERSE_SIZE);
+  vector<unsigned int> lengths(BATCH_SIZE);
+  vector<ola::dmx_encoding> encodings(BATCH_SIZE);
+  DmxBuffer received, checked;
+  bool ok = true;
+
+  Clock clock;
+  TimeStamp start, encoded_time, decoded_time;
+  result->bytes = 0;
+  result->encode_time = 0;
+  result->decode_time = 0;
+
+  for (unsigned int first = 0; first < opts.frames; first += BATCH_SIZE) {
+    unsigned int count = std::min(BATCH_SIZE, opts.frames - first);
+    for (unsigned int i = 0; i < count; i++) {
+      BuildFrame(type, first + i, data);
+      frames[i].Set(data, sizeof(data));
+    }
+
+    clock.CurrentTime(&start);
+    for (unsigned int i = 0; i < count; i++) {
+      const uint8_t *frame_data;
+      encodings[i] = encoder.Encode(1, frames[i], &frame_data, &lengths[i]);
+      // like copying it into the DmxData message
+      memcpy(&encoded[i * DMX_UNIVERSE_SIZE], frame_data, lengths[i]);
+    }
+    clock.CurrentTime(&encoded_time);
+    for (unsigned int i = 0; i < count; i++) {
+      DecodeDmxFrame(encodings[i], &encoded[i * DMX_UNIVERSE_SIZE],
+                     lengths[i], frames[i].Size(), &received);
+    }
+    clock.CurrentTime(&decoded_time);
+
+    result->encode_time += (encoded_time - start).AsInt();
+    result->decode_time += (decoded_time - encoded_time).AsInt();
+    for (unsigned int i = 0; i < count; i++) {
+      result->bytes += lengths[i];
+      if (!DecodeDmxFrame(encodings[i], &encoded[i * DMX_UNIVERSE_SIZE],
+                          lengths[i], frames[i].Size(), &checked) ||
+          !(checked == frames[i]))
+        ok = false;
+    }
+  }
+  return ok;
+}
+
+
+/*
+ * Nanoseconds per frame.
+ */
+double PerFrame(const options &opts, int64_t micro_seconds) {
+  return micro_seconds * 1000.0 / opts.frames;
+}
+
+
+int main(int argc, char *argv[]) {
+  options opts;
+  opts.frames = 100000;
+  ParseOptions(argc, argv, &opts);
+  ola::InitLogging(ola::OLA_LOG_WARN, ola::OLA_LOG_STDERR);
+
+  if (!opts.frames)
+    opts.frames = 1;
+
+  bool all_ok = true;
+  cout << std::fixed << std::setprecision(1);
+  for (unsigned int i = 0; i < sizeof(CUES) / sizeof(CUES[0]); i++) {
+    cout << CUES[i].name << ": " << CUES[i].description << endl;
+    for (unsigned int j = 0; j < sizeof(MODES) / sizeof(MODES[0]); j++) {
+      result result;
+      bool ok = RunCue(opts, CUES[i].type, MODES[j], &result);
+      all_ok &= ok;
+
+      cout << "  " << std::setw(6) << std::left << MODES[j].name <<
+        std::right << std::setw(7) <<
+        static_cast<double>(result.bytes) / opts.frames <<
+        " bytes/frame, encode " << std::setw(6) <<
+        PerFrame(opts, result.encode_time) << " ns/frame, decode " <<
+        std::setw(6) << PerFrame(opts, result.decode_time) << " ns/frame" <<
+        (ok ? "" : ", decode FAILED") << endl;
+    }
+  }
+  return all_ok ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * htp_merge_benchmark.cpp
+ * Compares merging full universes one source at a time with each of the
+ * N-way HTP merge kernels the CPU supports, and times the per channel
+ * priority kernels.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "common/utils/HTPMerge.h"
+#include "ola/BaseTypes.h"
+#include "ola/Clock.h"
+#include "ola/DmxBuffer.h"
+#include "ola/Logging.h"
+#include "ola/StringUtils.h"
+
+using ola::Clock;
+using ola::DmxBuffer;
+using ola::HTPMergeKernel;
+using ola::TimeInterval;
+using ola::TimeStamp;
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+
+typedef struct {
+  unsigned int merges;
+} options;
+
+
+/*
+ * Print the time each merge took.
+ */
+void PrintResult(const char *name, const TimeInterval &duration,
+                 unsigned int merges) {
+  cout << "  " << name << ": " << duration.AsInt() * 1000.0 / merges <<
+    " ns/merge" << endl;
+}
+
+
+/*
+ * Time each method with this many sources.
+ */
+void RunBenchmark(unsigned int source_count, const options &opts) {
+  vector<DmxBuffer> sources(source_count);
+  vector<DmxBuffer> priorities(source_count);
+  vector<const DmxBuffer*> pointers, priority_pointers;
+  for (unsigned int i = 0; i < source_count; i++) {
+    uint8_t data[DMX_UNIVERSE_SIZE];
+    uint8_t priority[DMX_UNIVERSE_SIZE];
+    for (unsigned int j = 0; j < DMX_UNIVERSE_SIZE; j++) {
+      data[j] = random();
+      priority[j] = 1 + random() % 4;
+    }
+    sources[i].Set(data, sizeof(data));
+    priorities[i].Set(priority, sizeof(priority));
+    pointers.push_back(&sources[i]);
+    priority_pointers.push_back(&priorities[i]);
+  }
+
+  cout << source_count << " sources" << endl;
+  Clock clock;
+  TimeStamp start, end;
+  DmxBuffer output;
+
+  clock.CurrentTime(&start);
+  for (unsigned int i = 0; i < opts.merges; i++) {
+    output.Reset();
+    for (unsigned int j = 0; j < source_count; j++)
+      output.HTPMerge(sources[j]);
+  }
+  clock.CurrentTime(&end);
+  PrintResult("pairwise", end - start, opts.merges);
+  const DmxBuffer expected(output);
+
+  vector<HTPMergeKernel> kernels;
+  ola::AvailableHTPMergeKernels(&kernels);
+  vector<HTPMergeKernel>::const_iterator iter = kernels.begin();
+  for (; iter != kernels.end(); ++iter) {
+    uint8_t merged[DMX_UNIVERSE_SIZE];
+    clock.CurrentTime(&start);
+    for (unsigned int i = 0; i < opts.merges; i++)
+      iter->function(merged, &pointers[0], source_count);
+    clock.CurrentTime(&end);
+    PrintResult(iter->name, end - start, opts.merges);
+
+    if (!(DmxBuffer(merged, DMX_UNIVERSE_SIZE) == expected))
+      OLA_WARN << iter->name << " produced a different result";
+  }
+
+  for (iter = kernels.begin(); iter != kernels.end(); ++iter) {
+    uint8_t merged[DMX_UNIVERSE_SIZE];
+    uint8_t merged_priorities[DMX_UNIVERSE_SIZE];
+    clock.CurrentTime(&start);
+    for (unsigned int i = 0; i < opts.merges; i++) {
+      iter->priority_function(merged, merged_priorities, &pointers[0],
+                              &priority_pointers[0], source_count, true);
+    }
+    clock.CurrentTime(&end);
+    PrintResult((string(iter->name) + " per channel priority").c_str(),
+                end - start, opts.merges);
+  }
+}
+
+
+/*
+ * Display the help message
+ */
+void DisplayHelpAndExit(char *argv[]) {
+  cout << "Usage: " << argv[0] << " [options]\n"
+  "\n"
+  "Benchmark the HTP & per channel priority merge kernels with 2, 8 & 32\n"
+  "sources.\n"
+  "\n"
+  "  -h, --help              Display this help message and exit.\n"
+  "  -m, --merges <count>    The number of merges to time.\n"
+  << endl;
+  exit(0);
+}
+
+
+/*
+ * Parse our command line options
+ */
+void ParseOptions(int argc, char *argv[], options *opts) {
+  static struct option long_options[] = {
+      {"help", no_argument, 0, 'h'},
+      {"merges", required_argument, 0, 'm'},
+      {0, 0, 0, 0}
+    };
+
+  int option_index = 0;
+  while (1) {
+    int c = getopt_long(argc, argv, "hm:", long_options, &option_index);
+    if (c == -1)
+      break;
+
+    switch (c) {
+      case 0:
+        break;
+      case 'h':
+        DisplayHelpAndExit(argv);
+        break;
+      case 'm':
+        ola::StringToInt(optarg, &opts->merges);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+
+int main(int argc, char *argv[]) {
+  options opts;
+  opts.merges = 100000;
+  ParseOptions(argc, argv, &opts);
+  ola::InitLogging(ola::OLA_LOG_WARN, ola::OLA_LOG_STDERR);
+
+  if (!opts.merges)
+    opts.merges = 1;
+
+  cout << "Selected kernel: " << ola::SelectedHTPMergeKernel().name << endl;
+  const unsigned int source_counts[] = {2, 8, 32};
+  for (unsigned int i = 0; i < sizeof(source_counts) / sizeof(source_counts[0]);
+       i++)
+    RunBenchmark(source_counts[i], opts);
+}
@@ -21,6 +21,8 @@
 #include <errno.h>
 #include <getopt.h>
 #include <stdlib.h>
+#include <ola/Clock.h>
+#include <ola/DmxBatch.h>
 #include <ola/DmxBuffer.h>
 #include <ola/Logging.h>
 #include <ola/StreamingClient.h>
@@ -28,16 +30,23 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 
 using std::cout;
 using std::endl;
 using std::string;
+using ola::DmxBatch;
+using ola::DmxBuffer;
 using ola::StreamingClient;
 
 
 typedef struct {
   unsigned int universe;
+  unsigned int universes;
+  unsigned int frames;
   unsigned int sleep_time;
+  bool batch;
+  bool shared_memory;
   bool help;
 } options;
 
@@ -47,7 +56,11 @@ typedef struct {
  */
 void ParseOptions(int argc, char *argv[], options *opts) {
   static struct option long_options[] = {
+      {"batch", no_argument, 0, 'b'},
+      {"frames", required_argument, 0, 'f'},
       {"help", no_argument, 0, 'h'},
+      {"shared-memory", no_argument, 0, 'm'},
+      {"universes", required_argument, 0, 'n'},
       {"sleep", required_argument, 0, 's'},
       {"universe", required_argument, 0, 'u'},
       {0, 0, 0, 0}
@@ -55,13 +68,17 @@ void ParseOptions(int argc, char *argv[], options *opts) {
 
   opts->sleep_time = 40000;
   opts->universe = 1;
+  opts->universes = 1;
+  opts->frames = 0;
+  opts->batch = false;
+  opts->shared_memory = false;
   opts->help = false;
 
   int c;
   int option_index = 0;
 
   while (1) {
-    c = getopt_long(argc, argv, "hs:u:", long_options, &option_index);
+    c = getopt_long(argc, argv, "bf:hmn:s:u:", long_options, &option_index);
 
     if (c == -1)
       break;
@@ -69,9 +86,21 @@ void ParseOptions(int argc, char *argv[], options *opts) {
     switch (c) {
       case 0:
         break;
+      case 'b':
+        opts->batch = true;
+        break;
+      case 'f':
+        opts->frames = atoi(optarg);
+        break;
       case 'h':
         opts->help = true;
         break;
+      case 'm':
+        opts->shared_memory = true;
+        break;
+      case 'n':
+        opts->universes = atoi(optarg);
+        break;
       case 's':
         opts->sleep_time = atoi(optarg);
         break;
@@ -96,9 +125,14 @@ void DisplayHelpAndExit(char arg[]) {
   "\n"
   "Send DMX512 data to OLA. If dmx data isn't provided we read from stdin.\n"
   "\n"
+  "  -b, --batch                  Send all universes in a single request.\n"
+  "  -f, --frames <count>         Stop after this many frames and print the\n"
+  "                               rate they were sent at.\n"
   "  -h, --help                   Display this help message and exit.\n"
+  "  -m, --shared-memory          Send the frames through shared memory.\n"
+  "  -n, --universes <count>      Number of universes to send each frame.\n"
   "  -s, --sleep <time_in_uS>     Time to sleep between frames.\n"
-  "  -u, --universe <universe_id> Id of universe to send data for.\n"
+  "  -u, --universe <universe_id> Id of the first universe to send data for.\n"
   << endl;
   exit(1);
 }
@@ -121,6 +155,29 @@ bool SendDataFromString(StreamingClient &client,
 }
 
 
+/*
+ * Send one frame to each universe, either as one request per universe or as a
+ * single batch.
+ */
+bool SendFrame(StreamingClient *client,
+               const options &opts,
+               const DmxBuffer &buffer,
+               DmxBatch *batch) {
+  if (opts.batch) {
+    batch->Clear();
+    for (unsigned int i = 0; i < opts.universes; i++)
+      batch->Add(opts.universe + i, buffer);
+    return client->SendDmxBatch(*batch);
+  }
+
+  for (unsigned int i = 0; i < opts.universes; i++) {
+    if (!client->SendDmx(opts.universe + i, buffer))
+      return false;
+  }
+  return true;
+}
+
+
 /*
  * Main
  */
@@ -134,20 +191,50 @@ int main(int argc, char *argv[]) {
   if (opts.help)
     DisplayHelpAndExit(argv[0]);
 
+  if (!opts.universes)
+    opts.universes = 1;
+
   if (!ola_client.Setup()) {
     OLA_FATAL << "Setup failed";
     exit(1);
   }
 
-  while (1) {
-    usleep(opts.sleep_time);
-    ola::DmxBuffer buffer;
-    buffer.Blackout();
+  if (opts.shared_memory) {
+    std::vector<unsigned int> universes;
+    for (unsigned int i = 0; i < opts.universes; i++)
+      universes.push_back(opts.universe + i);
+    if (!ola_client.SetupSharedMemory(universes)) {
+      OLA_FATAL << "Shared memory setup failed";
+      exit(1);
+    }
+  }
+
+  ola::Clock clock;
+  ola::TimeStamp start, end;
+  DmxBuffer buffer;
+  DmxBatch batch;
+  buffer.Blackout();
+  clock.CurrentTime(&start);
+
+  for (unsigned int frame = 0; !opts.frames || frame < opts.frames; frame++) {
+    if (opts.sleep_time)
+      usleep(opts.sleep_time);
+    buffer.SetChannel(0, frame);
 
-    if (!ola_client.SendDmx(opts.universe, buffer)) {
+    if (!SendFrame(&ola_client, opts, buffer, &batch)) {
       cout << "Send DMX failed" << endl;
       return false;
     }
   }
+
+  clock.CurrentTime(&end);
+  ola::TimeInterval duration = end - start;
+  if (duration.AsInt()) {
+    cout << opts.frames << " frames of " << opts.universes << " universes in "
+      << duration << ", " << opts.frames * 1000000.0 / duration.AsInt() <<
+      " frames/s, " <<
+      static_cast<double>(opts.frames) * opts.universes * 1000000.0 /
+      duration.AsInt() << " universes/s" << endl;
+  }
   return 0;
 }
@@ -21,10 +21,6 @@
 #ifndef INCLUDE_OLA_CLOCK_H_
 #define INCLUDE_OLA_CLOCK_H_
 
-#if HAVE_CONFIG_H
-#  include <config.h>
-#endif
-
 #include <stdint.h>
 #include <sys/time.h>
 #include <iomanip>
@@ -39,51 +35,52 @@ using std::ostream;
 
 static const int USEC_IN_SECONDS = 1000000;
 static const int ONE_THOUSAND = 1000;
+static const int64_t NSEC_IN_SECONDS = 1000000000;
 
 
 /*
- * A time interval, with usecond accuracy
+ * A time interval, stored as a 64 bit number of nanoseconds.
  */
 class TimeInterval {
   public:
-    TimeInterval() {
-      Set(0);
+    TimeInterval() : m_interval(0) {}
+
+    explicit TimeInterval(int64_t interval_useconds)
+        : m_interval(interval_useconds * ONE_THOUSAND) {
     }
 
-    explicit TimeInterval(int64_t interval_useconds) {
-      Set(interval_useconds);
+    TimeInterval(const TimeInterval &other)
+        : m_interval(other.m_interval) {
     }
 
-    TimeInterval(const TimeInterval &other) {
-      m_interval = other.m_interval;
+    TimeInterval(int32_t sec, int32_t usec)
+        : m_interval(sec * NSEC_IN_SECONDS +
+                     static_cast<int64_t>(usec) * ONE_THOUSAND) {
     }
 
-    TimeInterval(int32_t sec, int32_t usec) {
-      m_interval.tv_sec = sec;
-      m_interval.tv_usec = usec;
+    static TimeInterval FromNanoSeconds(int64_t interval_nseconds) {
+      TimeInterval interval;
+      interval.m_interval = interval_nseconds;
+      return interval;
     }
 
     TimeInterval& operator=(int64_t interval_useconds) {
-      Set(interval_useconds);
+      m_interval = interval_useconds * ONE_THOUSAND;
       return *this;
     }
 
     TimeInterval& operator=(const TimeInterval& other) {
-      if (this != &other) {
-        m_interval = other.m_interval;
-      }
+      m_interval = other.m_interval;
       return *this;
     }
 
     TimeInterval& operator+=(const TimeInterval& other) {
-      if (this != &other) {
-        timeradd(&m_interval, &other.m_interval, &m_interval);
-      }
+      m_interval += other.m_interval;
       return *this;
     }
 
     bool operator==(const TimeInterval &other) const {
-      return timercmp(&m_interval, &other.m_interval, ==);
+      return m_interval == other.m_interval;
     }
 
     bool operator!=(const TimeInterval &other) const {
@@ -91,44 +88,53 @@ class TimeInterval {
     }
 
     bool operator>(const TimeInterval &other) const {
-      return timercmp(&m_interval, &other.m_interval, >);
+      return m_interval > other.m_interval;
     }
 
     bool operator>=(const TimeInterval &other) const {
-      return timercmp(&m_interval, &other.m_interval, >=);
+      return m_interval >= other.m_interval;
     }
 
     bool operator<(const TimeInterval &other) const {
-      return timercmp(&m_interval, &other.m_interval, <);
+      return m_interval < other.m_interval;
     }
 
     bool operator<=(const TimeInterval &other) const {
-      return timercmp(&m_interval, &other.m_interval, <=);
+      return m_interval <= other.m_interval;
     }
 
     std::string ToString() const {
       std::stringstream str;
-      str << m_interval.tv_sec << "." << std::setfill('0') << std::setw(6) <<
-        m_interval.tv_usec;
+      int64_t useconds = AsInt();
+      if (useconds < 0) {
+        str << "-";
+        useconds = -useconds;
+      }
+      str << useconds / USEC_IN_SECONDS << "." << std::setfill('0') <<
+        std::setw(6) << useconds % USEC_IN_SECONDS;
       return str.str();
     }
 
     int64_t AsInt() const {
-      return (m_interval.tv_sec * static_cast<int64_t>(USEC_IN_SECONDS) +
-              m_interval.tv_usec);
+      return m_interval / ONE_THOUSAND;
     }
 
     int64_t InMilliSeconds() const {
-      return (m_interval.tv_sec * static_cast<int64_t>(ONE_THOUSAND) +
-              m_interval.tv_usec / ONE_THOUSAND);
+      return m_interval / (ONE_THOUSAND * ONE_THOUSAND);
+    }
+
+    int64_t InNanoSeconds() const {
+      return m_interval;
     }
 
     time_t Seconds() const {
-      return m_interval.tv_sec;
+      return static_cast<time_t>(FloorSeconds());
     }
 
     void AsTimeval(struct timeval *tv) const {
-      *tv = m_interval;
+      int64_t seconds = FloorSeconds();
+      tv->tv_sec = static_cast<time_t>(seconds);
+      tv->tv_usec = (m_interval - seconds * NSEC_IN_SECONDS) / ONE_THOUSAND;
     }
 
     friend ostream& operator<< (ostream &out, const TimeInterval &interval) {
@@ -136,60 +142,53 @@ class TimeInterval {
     }
 
   private:
-    void Set(int64_t interval_useconds) {
-#ifdef HAVE_TIME_T
-      m_interval.tv_sec = static_cast<time_t>(
-          interval_useconds / USEC_IN_SECONDS);
-#else
-      m_interval.tv_sec = (
-          interval_useconds / USEC_IN_SECONDS);
-#endif
-
-#ifdef HAVE_SUSECONDS_T
-       m_interval.tv_usec = static_cast<suseconds_t>(
-         interval_useconds % USEC_IN_SECONDS);
-#else
-      m_interval.tv_usec = (
-          interval_useconds % USEC_IN_SECONDS);
-#endif
-    }
-    struct timeval m_interval;
+    int64_t m_interval;
+
+    // Negative intervals round towards -infinity, like a normalized timeval.
+    int64_t FloorSeconds() const {
+      int64_t seconds = m_interval / NSEC_IN_SECONDS;
+      if (m_interval % NSEC_IN_SECONDS < 0)
+        seconds--;
+      return seconds;
+    }
 
   friend class TimeStamp;
 };
 
 
 /*
- * Represents a point in time with usecond accuracy
+ * Represents a point in time, stored as a 64 bit number of nanoseconds since
+ * the epoch of the clock that created it.
  */
 class TimeStamp {
   public:
-    TimeStamp() {
-      timerclear(&m_tv);
-    }
+    TimeStamp() : m_ts(0) {}
 
-    TimeStamp(const TimeStamp &other) {
-      m_tv = other.m_tv;
-    }
+    TimeStamp(const TimeStamp &other) : m_ts(other.m_ts) {}
 
     explicit TimeStamp(const struct timeval &timestamp) {
-      m_tv = timestamp;
+      *this = timestamp;
+    }
+
+    static TimeStamp FromNanoSeconds(int64_t nseconds) {
+      TimeStamp timestamp;
+      timestamp.m_ts = nseconds;
+      return timestamp;
     }
 
     TimeStamp& operator=(const TimeStamp& other) {
-      if (this != &other) {
-        m_tv = other.m_tv;
-      }
+      m_ts = other.m_ts;
       return *this;
     }
 
     TimeStamp& operator=(const struct timeval &tv) {
-      m_tv = tv;
+      m_ts = tv.tv_sec * NSEC_IN_SECONDS +
+        static_cast<int64_t>(tv.tv_usec) * ONE_THOUSAND;
       return *this;
     }
 
     bool operator==(const TimeStamp &other) const {
-      return timercmp(&m_tv, &other.m_tv, ==);
+      return m_ts == other.m_ts;
     }
 
     bool operator!=(const TimeStamp &other) const {
@@ -197,28 +196,28 @@ class TimeStamp {
     }
 
     bool operator>(const TimeStamp &other) const {
-      return timercmp(&m_tv, &other.m_tv, >);
+      return m_ts > other.m_ts;
     }
 
     bool operator>=(const TimeStamp &other) const {
-      return timercmp(&m_tv, &other.m_tv, >=);
+      return m_ts >= other.m_ts;
     }
 
     bool operator<(const TimeStamp &other) const {
-      return timercmp(&m_tv, &other.m_tv, <);
+      return m_ts < other.m_ts;
     }
 
     bool operator<=(const TimeStamp &other) const {
-      return timercmp(&m_tv, &other.m_tv, <=);
+      return m_ts <= other.m_ts;
     }
 
     TimeStamp &operator+=(const TimeInterval &interval) {
-      timeradd(&m_tv, &interval.m_interval, &m_tv);
+      m_ts += interval.m_interval;
       return *this;
     }
 
     TimeStamp &operator-=(const TimeInterval &interval) {
-      TimerSub(m_tv, interval.m_interval, &m_tv);
+      m_ts -= interval.m_interval;
       return *this;
     }
 
@@ -229,25 +228,27 @@ class TimeStamp {
     }
 
     const TimeInterval operator-(const TimeStamp &other) const {
-      TimeInterval result;
-      TimerSub(m_tv, other.m_tv, &result.m_interval);
-      return result;
+      return TimeInterval::FromNanoSeconds(m_ts - other.m_ts);
     }
 
     const TimeStamp operator-(const TimeInterval &interval) const {
-      TimeStamp result;
-      TimerSub(m_tv, interval.m_interval, &result.m_tv);
+      TimeStamp result = *this;
+      result -= interval;
       return result;
     }
 
     bool IsSet() const {
-      return timerisset(&m_tv);
+      return m_ts != 0;
+    }
+
+    int64_t InNanoSeconds() const {
+      return m_ts;
     }
 
     std::string ToString() const {
       std::stringstream str;
-      str << m_tv.tv_sec << "." << std::setfill('0') << std::setw(6) <<
-        m_tv.tv_usec;
+      str << m_ts / NSEC_IN_SECONDS << "." << std::setfill('0') <<
+        std::setw(6) << (m_ts % NSEC_IN_SECONDS) / ONE_THOUSAND;
       return str.str();
     }
 
@@ -256,35 +257,24 @@ class TimeStamp {
     }
 
   private:
-    struct timeval m_tv;
-
-    /**
-     * We don't use timersub here because windows doesn't define it.
-     */
-    void TimerSub(const struct timeval &tv1, const struct timeval &tv2,
-                  struct timeval *result) const {
-      result->tv_sec = tv1.tv_sec - tv2.tv_sec;
-      result->tv_usec = tv1.tv_usec - tv2.tv_usec;
-      if (result->tv_usec < 0) {
-          result->tv_sec--;
-          result->tv_usec += USEC_IN_SECONDS;
-      }
-    }
+    int64_t m_ts;
 };
 
 
 /*
- * Used to get the current time
+ * Used to get the current time.
+ *
+ * CurrentTime() uses a monotonic clock where the platform provides one, so
+ * it's not affected by changes to the system time (e.g. NTP steps). The
+ * values are only meaningful when compared with other values from
+ * CurrentTime(). Use CurrentRealTime() if you need the wall clock time.
  */
 class Clock {
   public:
     Clock() {}
     virtual ~Clock() {}
-    virtual void CurrentTime(TimeStamp *timestamp) const {
-      struct timeval tv;
-      gettimeofday(&tv, NULL);
-      *timestamp = tv;
-    }
+    virtual void CurrentTime(TimeStamp *timestamp) const;
+    virtual void CurrentRealTime(TimeStamp *timestamp) const;
 
   private:
     Clock(const Clock &other);
@@ -312,11 +302,15 @@ class MockClock: public Clock {
     }
 
     void CurrentTime(TimeStamp *timestamp) const {
-      struct timeval tv;
-      gettimeofday(&tv, NULL);
-      *timestamp = tv;
+      Clock::CurrentTime(timestamp);
       *timestamp += m_offset;
     }
+
+    void CurrentRealTime(TimeStamp *timestamp) const {
+      Clock::CurrentRealTime(timestamp);
+      *timestamp += m_offset;
+    }
+
   private:
     TimeInterval m_offset;
 };
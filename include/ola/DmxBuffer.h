@@ -21,6 +21,7 @@
 #ifndef INCLUDE_OLA_DMXBUFFER_H_
 #define INCLUDE_OLA_DMXBUFFER_H_
 
+#include <ola/BaseTypes.h>
 #include <stdint.h>
 #include <string>
 
@@ -29,7 +30,9 @@ namespace ola {
 using std::string;
 
 /*
- * The DmxBuffer class
+ * The DmxBuffer class. The channel data is stored inline, so creating,
+ * copying or updating a buffer never touches the heap. A copy only moves the
+ * Size() valid bytes, use Swap() to exchange the contents of two buffers.
  */
 class DmxBuffer {
   public:
@@ -41,9 +44,18 @@ class DmxBuffer {
     DmxBuffer& operator=(const DmxBuffer &other);
 
     bool operator==(const DmxBuffer &other) const;
+    bool ChangedRange(const DmxBuffer &previous,
+                      unsigned int *start,
+                      unsigned int *end) const;
     unsigned int Size() const { return m_length; }
 
     bool HTPMerge(const DmxBuffer &other);
+    bool HTPMerge(const DmxBuffer *const *sources, unsigned int count);
+    bool PriorityMerge(const DmxBuffer *const *sources,
+                       const DmxBuffer *const *priorities,
+                       unsigned int count,
+                       DmxBuffer *merged_priorities,
+                       bool htp = true);
     bool Set(const uint8_t *data, unsigned int length);
     bool Set(const string &data);
     bool Set(const DmxBuffer &other);
@@ -59,17 +71,16 @@ class DmxBuffer {
     string Get() const;
     bool Blackout();
     void Reset();
+    void Swap(DmxBuffer *other);
     string ToString() const;
 
   private:
-    bool Init();
-    bool DuplicateIfNeeded();
     void CopyFromOther(const DmxBuffer &other);
-    void CleanupMemory();
-    unsigned int *m_ref_count;
-    mutable bool m_copy_on_write;
-    uint8_t *m_data;
+    // false until the buffer has been written to, SetRange() and
+    // SetChannel() blackout the buffer on first use.
+    bool m_initialized;
     unsigned int m_length;
+    uint8_t m_data[DMX_UNIVERSE_SIZE];
 };
 }  // ola
 #endif  // INCLUDE_OLA_DMXBUFFER_H_
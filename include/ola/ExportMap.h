@@ -21,6 +21,7 @@
 #ifndef INCLUDE_OLA_EXPORTMAP_H_
 #define INCLUDE_OLA_EXPORTMAP_H_
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <functional>
 #include <map>
@@ -130,6 +131,52 @@ class CounterVariable: public BaseVariable {
 };
 
 
+/*
+ * A histogram of durations, in microseconds. The buckets are powers of two so
+ * adding a sample is cheap and never allocates memory. Bucket 0 holds samples
+ * under 1us, bucket n holds samples from 2^(n-1) up to 2^n us and the last
+ * bucket holds everything longer.
+ */
+class HistogramVariable: public BaseVariable {
+  public:
+    explicit HistogramVariable(const string &name);
+    ~HistogramVariable() {}
+
+    void Add(int64_t usec) {
+      if (usec < 0)
+        usec = 0;
+      // the bucket is the number of significant bits in the sample
+      unsigned int bucket = usec ?
+        64 - __builtin_clzll(static_cast<uint64_t>(usec)) : 0;
+      if (bucket > BUCKETS - 1)
+        bucket = BUCKETS - 1;
+      m_buckets[bucket]++;
+      m_count++;
+      m_total += usec;
+      if (usec > m_max)
+        m_max = usec;
+    }
+
+    void Reset();
+    uint64_t Count() const { return m_count; }
+    int64_t Max() const { return m_max; }
+    unsigned int BucketCount(unsigned int bucket) const {
+      return bucket < BUCKETS ? m_buckets[bucket] : 0;
+    }
+    const string Value() const;
+
+    static const unsigned int BUCKETS = 24;
+
+  private:
+    uint64_t m_count;
+    int64_t m_total;
+    int64_t m_max;
+    unsigned int m_buckets[BUCKETS];
+
+    int64_t Percentile(unsigned int percent) const;
+};
+
+
 /*
  * A Map variable holds string -> type mappings
  */
@@ -155,6 +202,33 @@ typedef MapVariable<int> IntMap;
 typedef MapVariable<unsigned int> UIntMap;
 
 
+/*
+ * Like a MapVariable but the keys are integers. Use this for things like
+ * per universe stats where converting the key to a string on every update
+ * would be expensive. References to the values remain valid until the key is
+ * removed.
+ */
+template<typename Type>
+class IndexedMapVariable: public BaseVariable {
+  public:
+    IndexedMapVariable(const string &name, const string &label):
+      BaseVariable(name),
+      m_label(label) {}
+    ~IndexedMapVariable() {}
+
+    void Remove(unsigned int key) { m_variables.erase(key); }
+    Type &operator[](unsigned int key) { return m_variables[key]; }
+    const string Value() const;
+    const string Label() const { return m_label; }
+  private:
+    map<unsigned int, Type> m_variables;
+    string m_label;
+};
+
+typedef IndexedMapVariable<string> StringIndexedMap;
+typedef IndexedMapVariable<unsigned int> UIntIndexedMap;
+
+
 /*
  * Return a value from the Map Variable, this will create an entry in the map
  * if the variable doesn't exist.
@@ -190,10 +264,15 @@ class ExportMap {
     IntegerVariable *GetIntegerVar(const string &name);
     CounterVariable *GetCounterVar(const string &name);
     StringVariable *GetStringVar(const string &name);
+    HistogramVariable *GetHistogramVar(const string &name);
 
     StringMap *GetStringMapVar(const string &name, const string &label="");
     IntMap *GetIntMapVar(const string &name, const string &label="");
     UIntMap *GetUIntMapVar(const string &name, const string &label="");
+    StringIndexedMap *GetStringIndexedMapVar(const string &name,
+                                             const string &label="");
+    UIntIndexedMap *GetUIntIndexedMapVar(const string &name,
+                                         const string &label="");
 
   private :
     ExportMap(const ExportMap&);
@@ -217,10 +296,13 @@ class ExportMap {
     map<string, StringVariable*> m_string_variables;
     map<string, IntegerVariable*> m_int_variables;
     map<string, CounterVariable*> m_counter_variables;
+    map<string, HistogramVariable*> m_histogram_variables;
 
     map<string, StringMap*> m_str_map_variables;
     map<string, IntMap*> m_int_map_variables;
     map<string, UIntMap*> m_uint_map_variables;
+    map<string, StringIndexedMap*> m_str_indexed_map_variables;
+    map<string, UIntIndexedMap*> m_uint_indexed_map_variables;
 };
 }  // ola
 #endif  // INCLUDE_OLA_EXPORTMAP_H_
@@ -21,7 +21,6 @@
 #ifndef INCLUDE_OLA_NETWORK_SELECTSERVER_H_
 #define INCLUDE_OLA_NETWORK_SELECTSERVER_H_
 
-#include <queue>
 #include <set>
 #include <string>
 #include <vector>
@@ -38,9 +37,11 @@ namespace network {
 
 using ola::ExportMap;
 using ola::thread::timeout_id;
-using std::priority_queue;
 using std::string;
 
+class ExecuteQueue;
+class PollerInterface;
+class TimerWheel;
 
 /**
  * This is the core of the event driven system. The SelectServer is responsible
@@ -51,8 +52,15 @@ class SelectServer: public SelectServerInterface {
   public :
     enum Direction {READ, WRITE};
 
+    // The mechanism used to wait for descriptors to become ready.
+    enum PollerType {
+      SELECT_POLLER,  // select(), available everywhere
+      EPOLL_POLLER,  // epoll(), Linux only. Falls back to select() if missing
+    };
+
     SelectServer(ExportMap *export_map = NULL,
-                 Clock *clock = NULL);
+                 Clock *clock = NULL,
+                 PollerType poller_type = SELECT_POLLER);
     ~SelectServer();
 
     bool IsRunning() const { return !m_terminate; }
@@ -76,10 +84,19 @@ class SelectServer: public SelectServerInterface {
 
     timeout_id RegisterRepeatingTimeout(unsigned int ms,
                                         ola::Callback0<bool> *closure);
+    timeout_id RegisterRepeatingTimeout(const TimeInterval &interval,
+                                        ola::Callback0<bool> *closure,
+                                        ola::thread::TimerMode mode);
     timeout_id RegisterSingleTimeout(unsigned int ms,
                                      ola::SingleUseCallback0<void> *closure);
     void RemoveTimeout(timeout_id id);
 
+    void SetReadDescriptorName(ReadFileDescriptor *descriptor,
+                               const string &name);
+    void SetWriteDescriptorName(WriteFileDescriptor *descriptor,
+                                const string &name);
+    void SetTimeoutName(timeout_id id, const string &name);
+
     void RunInLoop(ola::Callback0<void> *closure);
 
     void Execute(ola::BaseCallback0<void> *closure);
@@ -91,142 +108,32 @@ class SelectServer: public SelectServerInterface {
     static const char K_TIMER_VAR[];
     static const char K_LOOP_TIME[];
     static const char K_LOOP_COUNT[];
+    static const char K_CALLBACK_TIME_VAR_PREFIX[];
 
   private :
-    /*
-     * These are timer events, they are used inside the SelectServer class
-     */
-    class Event {
-      public:
-        explicit Event(unsigned int ms, const Clock *clock):
-          m_interval(ms * 1000) {
-          TimeStamp now;
-          clock->CurrentTime(&now);
-          m_next = now + m_interval;
-        }
-        virtual ~Event() {}
-        virtual bool Trigger() = 0;
-
-        void UpdateTime(const TimeStamp &now) {
-          m_next = now + m_interval;
-        }
-
-        TimeStamp NextTime() const { return m_next; }
-
-      private:
-        TimeInterval m_interval;
-        TimeStamp m_next;
-    };
-
-    // An event that only happens once
-    class SingleEvent: public Event {
-      public:
-        SingleEvent(unsigned int ms,
-                    const Clock *clock,
-                    ola::BaseCallback0<void> *closure):
-          Event(ms, clock),
-          m_closure(closure) {
-        }
-
-        virtual ~SingleEvent() {
-          if (m_closure)
-            delete m_closure;
-        }
-
-        bool Trigger() {
-          if (m_closure) {
-            m_closure->Run();
-            // it's deleted itself at this point
-            m_closure = NULL;
-          }
-          return false;
-        }
-
-      private:
-        ola::BaseCallback0<void> *m_closure;
-    };
-
-
-    /*
-     * An event that occurs more than once. The closure can return false to
-     * indicate that it should not be called again.
-     */
-    class RepeatingEvent: public Event {
-      public:
-        RepeatingEvent(unsigned int ms,
-                       const Clock *clock,
-                       ola::BaseCallback0<bool> *closure):
-          Event(ms, clock),
-          m_closure(closure) {
-        }
-        ~RepeatingEvent() {
-          delete m_closure;
-        }
-        bool Trigger() {
-          if (!m_closure)
-            return false;
-          return m_closure->Run();
-        }
-
-      private:
-        ola::BaseCallback0<bool> *m_closure;
-    };
-
-
-    typedef struct {
-      ConnectedDescriptor *descriptor;
-      bool delete_on_close;
-    } connected_descriptor_t;
-
-    struct connected_descriptor_t_lt {
-      bool operator()(const connected_descriptor_t &c1,
-                      const connected_descriptor_t &c2) const {
-        return c1.descriptor->ReadDescriptor() <
-            c2.descriptor->ReadDescriptor();
-      }
-    };
-
-    struct ltevent {
-      bool operator()(Event *e1, Event *e2) const {
-        return e1->NextTime() > e2->NextTime();
-      }
-    };
-
-    typedef std::set<ReadFileDescriptor*> ReadDescriptorSet;
-    typedef std::set<WriteFileDescriptor*> WriteDescriptorSet;
-    typedef std::set<connected_descriptor_t, connected_descriptor_t_lt>
-      ConnectedDescriptorSet;
     typedef std::set<ola::Callback0<void>*> LoopClosureSet;
 
     bool m_terminate, m_is_running;
     TimeInterval m_poll_interval;
-    unsigned int m_next_id;
-    ReadDescriptorSet m_read_descriptors;
-    ConnectedDescriptorSet m_connected_read_descriptors;
-    WriteDescriptorSet m_write_descriptors;
-    std::set<timeout_id> m_removed_timeouts;
     ExportMap *m_export_map;
-
-    typedef priority_queue<Event*, vector<Event*>, ltevent> event_queue_t;
-    event_queue_t m_events;
+    IntegerVariable *m_timer_count;
     CounterVariable *m_loop_iterations;
     CounterVariable *m_loop_time;
     TimeStamp m_wake_up_time;
     Clock *m_clock;
     bool m_free_clock;
     LoopClosureSet m_loop_closures;
-    std::queue<ola::BaseCallback0<void>*> m_incoming_queue;
-    ola::thread::Mutex m_incoming_mutex;
-    LoopbackDescriptor m_incoming_descriptor;
+    ExecuteQueue *m_incoming_queue;
+    PollerInterface *m_poller;
+    TimerWheel *m_timeouts;
 
     SelectServer(const SelectServer&);
     SelectServer operator=(const SelectServer&);
     bool CheckForEvents(const TimeInterval &poll_interval);
-    void CheckDescriptors(fd_set *r_set, fd_set *w_set);
-    void AddDescriptorsToSet(fd_set *r_set, fd_set *w_set, int *max_sd);
     TimeStamp CheckTimeouts(const TimeStamp &now);
     void UnregisterAll();
-    void DrainAndExecute();
+    void UpdateTimerCount();
+    HistogramVariable *CallbackHistogram(const string &name);
     void SetTerminate() { m_terminate = true; }
 
     static const int K_MS_IN_SECOND = 1000;
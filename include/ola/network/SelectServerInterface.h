@@ -21,6 +21,7 @@
 #ifndef INCLUDE_OLA_NETWORK_SELECTSERVERINTERFACE_H_
 #define INCLUDE_OLA_NETWORK_SELECTSERVERINTERFACE_H_
 
+#include <string>
 #include <ola/Clock.h>  // NOLINT
 #include <ola/Callback.h>  // NOLINT
 #include <ola/thread/SchedulingExecutorInterface.h>  // NOLINT
@@ -48,11 +49,25 @@ class SelectServerInterface: public ola::thread::SchedulingExecutorInterface {
     virtual ola::thread::timeout_id RegisterRepeatingTimeout(
         unsigned int ms,
         Callback0<bool> *closure) = 0;
+    virtual ola::thread::timeout_id RegisterRepeatingTimeout(
+        const TimeInterval &interval,
+        Callback0<bool> *closure,
+        ola::thread::TimerMode mode) = 0;
     virtual ola::thread::timeout_id RegisterSingleTimeout(
         unsigned int ms,
         SingleUseCallback0<void> *closure) = 0;
     virtual void RemoveTimeout(ola::thread::timeout_id id) = 0;
 
+    // Record how long the callbacks for a registered descriptor or timeout
+    // take to run, under the given name. This is forgotten when the
+    // descriptor or timeout is removed.
+    virtual void SetReadDescriptorName(class ReadFileDescriptor *descriptor,
+                                       const std::string &name) = 0;
+    virtual void SetWriteDescriptorName(class WriteFileDescriptor *descriptor,
+                                        const std::string &name) = 0;
+    virtual void SetTimeoutName(ola::thread::timeout_id id,
+                                const std::string &name) = 0;
+
     virtual const TimeStamp *WakeUpTime() const = 0;
 };
 }  // network
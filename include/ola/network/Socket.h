@@ -61,6 +61,7 @@
 #endif
 
 #include <string>
+#include <vector>
 #include <ola/Callback.h>  // NOLINT
 #include <ola/network/IPV4Address.h>  // NOLINT
 
@@ -383,6 +384,136 @@ class DeviceDescriptor: public ConnectedDescriptor {
 };
 
 
+/*
+ * A set of preallocated buffers that UdpSocketInterface::RecvBatch() fills
+ * with datagrams. The source address & port of each datagram is recorded as
+ * well. A batch is reused for each read so the receive path doesn't allocate.
+ */
+class DatagramBatch {
+  public:
+    DatagramBatch(unsigned int capacity, unsigned int max_size);
+    ~DatagramBatch();
+
+    // the most datagrams that can be read at once
+    unsigned int Capacity() const { return m_capacity; }
+    // the largest datagram that can be stored, larger ones are truncated
+    unsigned int MaxSize() const { return m_max_size; }
+
+    // the number of datagrams in the batch
+    unsigned int Size() const { return m_size; }
+    const uint8_t *Data(unsigned int i) const { return Slot(i); }
+    unsigned int Length(unsigned int i) const {
+      return m_datagrams[i].length;
+    }
+    const IPV4Address &Source(unsigned int i) const {
+      return m_datagrams[i].source;
+    }
+    uint16_t SourcePort(unsigned int i) const {
+      return m_datagrams[i].port;
+    }
+
+    // These are used by the UdpSocketInterface implementations
+    void Clear() { m_size = 0; }
+    uint8_t *Buffer(unsigned int i) { return Slot(i); }
+    void Append(unsigned int length, const IPV4Address &source,
+                uint16_t port);
+
+  private:
+    typedef struct {
+      unsigned int length;
+      IPV4Address source;
+      uint16_t port;
+    } datagram_info;
+
+    // the system specific message headers, see Socket.cpp
+    struct MessageHeaders;
+
+    const unsigned int m_capacity;
+    const unsigned int m_max_size;
+    unsigned int m_stride;
+    unsigned int m_size;
+    uint8_t *m_buffers;
+    std::vector<datagram_info> m_datagrams;
+    MessageHeaders *m_headers;
+
+    uint8_t *Slot(unsigned int i) const { return m_buffers + i * m_stride; }
+
+    DatagramBatch(const DatagramBatch&);
+    DatagramBatch& operator=(const DatagramBatch&);
+
+    friend class UdpSocket;
+};
+
+
+/*
+ * A queue of datagrams, each with a destination, that
+ * UdpSocketInterface::SendBatch() sends with as few system calls as possible.
+ * The data is copied into storage owned by the queue, which is reused once the
+ * queue has been sent, so a queue that's sent regularly doesn't allocate.
+ */
+class DatagramSendQueue {
+  public:
+    explicit DatagramSendQueue(unsigned int capacity = DEFAULT_CAPACITY);
+    ~DatagramSendQueue();
+
+    bool Add(const uint8_t *data,
+             unsigned int length,
+             const IPV4Address &destination,
+             uint16_t port);
+    // Send the datagram that was last added to another destination as well.
+    // The data isn't copied again.
+    bool AddDestination(const IPV4Address &destination, uint16_t port);
+
+    unsigned int Capacity() const { return m_capacity; }
+    unsigned int Size() const { return m_datagrams.size(); }
+    bool Empty() const { return m_datagrams.empty(); }
+    bool IsFull() const { return m_datagrams.size() == m_capacity; }
+    void Clear();
+
+    const uint8_t *Data(unsigned int i) const {
+      return &m_data[m_datagrams[i].offset];
+    }
+    unsigned int Length(unsigned int i) const {
+      return m_datagrams[i].length;
+    }
+    const IPV4Address &Destination(unsigned int i) const {
+      return m_datagrams[i].destination;
+    }
+    uint16_t Port(unsigned int i) const { return m_datagrams[i].port; }
+
+    // The number of system calls the last SendBatch() made.
+    unsigned int SendCalls() const { return m_send_calls; }
+
+    // This is used by the UdpSocketInterface implementations
+    void SetSendCalls(unsigned int calls) { m_send_calls = calls; }
+
+    // sendmmsg() won't take more than this in one call
+    static const unsigned int DEFAULT_CAPACITY = 1024;
+
+  private:
+    typedef struct {
+      unsigned int offset;
+      unsigned int length;
+      IPV4Address destination;
+      uint16_t port;
+    } datagram_info;
+
+    // the system specific message headers, see Socket.cpp
+    struct MessageHeaders;
+
+    const unsigned int m_capacity;
+    unsigned int m_send_calls;
+    std::vector<uint8_t> m_data;
+    std::vector<datagram_info> m_datagrams;
+    MessageHeaders *m_headers;
+
+    DatagramSendQueue(const DatagramSendQueue&);
+    DatagramSendQueue& operator=(const DatagramSendQueue&);
+
+    friend class UdpSocket;
+};
+
+
 /*
  * The UdpSocketInterface.
  * This is done as an Interface so we can mock it out for testing.
@@ -410,6 +541,8 @@ class UdpSocketInterface: public BidirectionalFileDescriptor {
                           ssize_t *data_read,
                           IPV4Address &source,
                           uint16_t &port) const = 0;
+    virtual bool RecvBatch(DatagramBatch *batch) const = 0;
+    virtual unsigned int SendBatch(DatagramSendQueue *queue) const = 0;
 
     virtual bool EnableBroadcast() = 0;
     virtual bool SetMulticastInterface(const IPV4Address &iface) = 0;
@@ -454,6 +587,8 @@ class UdpSocket: public UdpSocketInterface {
                   ssize_t *data_read,
                   IPV4Address &source,
                   uint16_t &port) const;
+    bool RecvBatch(DatagramBatch *batch) const;
+    unsigned int SendBatch(DatagramSendQueue *queue) const;
     bool EnableBroadcast();
     bool SetMulticastInterface(const IPV4Address &iface);
     bool JoinMulticast(const IPV4Address &iface,
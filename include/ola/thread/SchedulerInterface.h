@@ -23,6 +23,7 @@
 #define INCLUDE_OLA_THREAD_SCHEDULERINTERFACE_H_
 
 #include <ola/Callback.h>
+#include <ola/Clock.h>
 
 namespace ola {
 namespace thread {
@@ -30,6 +31,16 @@ namespace thread {
 typedef void* timeout_id;
 static const timeout_id INVALID_TIMEOUT = NULL;
 
+// Controls when a repeating timeout runs next.
+enum TimerMode {
+  // the next run is scheduled an interval after the current run started
+  FIXED_DELAY,
+  // the next run is scheduled an interval after the previous deadline, so
+  // latency in running the callback doesn't accumulate. If runs are missed
+  // they are skipped rather than run back to back.
+  FIXED_RATE,
+};
+
 
 class SchedulerInterface {
   public :
@@ -39,6 +50,10 @@ class SchedulerInterface {
     virtual timeout_id RegisterRepeatingTimeout(
         unsigned int ms,
         Callback0<bool> *closure) = 0;
+    virtual timeout_id RegisterRepeatingTimeout(
+        const TimeInterval &interval,
+        Callback0<bool> *closure,
+        TimerMode mode) = 0;
     virtual timeout_id RegisterSingleTimeout(
         unsigned int ms,
         SingleUseCallback0<void> *closure) = 0;
@@ -50,6 +50,7 @@ class DmxSource {
 
     DmxSource(const DmxSource &other) {
       m_buffer = other.m_buffer;
+      m_slot_priorities = other.m_slot_priorities;
       m_timestamp = other.m_timestamp;
       m_priority = other.m_priority;
     }
@@ -61,6 +62,7 @@ class DmxSource {
     DmxSource& operator=(const DmxSource& other) {
       if (this != &other) {
         m_buffer = other.m_buffer;
+        m_slot_priorities = other.m_slot_priorities;
         m_timestamp = other.m_timestamp;
         m_priority = other.m_priority;
       }
@@ -73,6 +75,7 @@ class DmxSource {
      */
     bool operator==(const DmxSource &other) const {
       return (m_buffer == other.m_buffer &&
+              m_slot_priorities == other.m_slot_priorities &&
               m_timestamp == other.m_timestamp &&
               m_priority == other.m_priority);
     }
@@ -84,6 +87,57 @@ class DmxSource {
     void UpdateData(const DmxBuffer &buffer, const TimeStamp &timestamp,
                     uint8_t priority) {
       m_buffer = buffer;
+      m_slot_priorities.Reset();
+      m_timestamp = timestamp;
+      m_priority = priority;
+    }
+
+
+    /*
+     * Update the DmxSource with new data, this copies the data straight into
+     * the source rather than building a DmxBuffer first.
+     */
+    void UpdateData(const uint8_t *data, unsigned int length,
+                    const TimeStamp &timestamp, uint8_t priority) {
+      m_buffer.Set(data, length);
+      m_slot_priorities.Reset();
+      m_timestamp = timestamp;
+      m_priority = priority;
+    }
+
+
+    /*
+     * Update the timestamp & priority and return the buffer so the new data
+     * can be written in place. The buffer still holds the previous data.
+     */
+    DmxBuffer *UpdateDataInPlace(const TimeStamp &timestamp,
+                                 uint8_t priority) {
+      m_slot_priorities.Reset();
+      m_timestamp = timestamp;
+      m_priority = priority;
+      return &m_buffer;
+    }
+
+
+    /*
+     * Set the per slot priorities, this must be called after UpdateData.
+     */
+    void SetSlotPriorities(const uint8_t *priorities, unsigned int length) {
+      m_slot_priorities.Set(priorities, length);
+    }
+
+
+    /*
+     * Update the DmxSource with new data and a priority for each slot. A
+     * slot priority of 0 means this source doesn't control the slot, slots
+     * past the end of the priorities use a priority of 0.
+     */
+    void UpdateData(const DmxBuffer &buffer,
+                    const DmxBuffer &slot_priorities,
+                    const TimeStamp &timestamp,
+                    uint8_t priority) {
+      m_buffer = buffer;
+      m_slot_priorities = slot_priorities;
       m_timestamp = timestamp;
       m_priority = priority;
     }
@@ -95,6 +149,13 @@ class DmxSource {
     const DmxBuffer &Data() const { return m_buffer; }
 
 
+    /*
+     * Get the per slot priorities, this is empty unless the source sent them
+     */
+    const DmxBuffer &SlotPriorities() const { return m_slot_priorities; }
+    bool HasSlotPriorities() const { return m_slot_priorities.Size() != 0; }
+
+
     /*
      * Get the timestamp
      */
@@ -105,8 +166,15 @@ class DmxSource {
      * Check if this source has timed out
      */
     bool IsActive(const TimeStamp &now) const {
-      TimeStamp timeout = m_timestamp + TIMEOUT_INTERVAL;
-      return now < timeout;
+      return now < ExpiryTime();
+    }
+
+
+    /*
+     * Get the time this source will time out, unless it gets more data
+     */
+    TimeStamp ExpiryTime() const {
+      return m_timestamp + TIMEOUT_INTERVAL;
     }
 
 
@@ -129,6 +197,7 @@ class DmxSource {
 
   private:
     DmxBuffer m_buffer;
+    DmxBuffer m_slot_priorities;
     TimeStamp m_timestamp;
     uint8_t m_priority;
 
@@ -51,6 +51,13 @@ class AbstractPlugin {
     // return the description of this plugin
     virtual string Description() const = 0;
 
+    // true if this plugin can run in a PluginShard, see SupportsShards() below
+    virtual bool SupportsShards() const = 0;
+    // return the PluginAdaptor this plugin uses
+    virtual PluginAdaptor *GetPluginAdaptor() const = 0;
+    // change the PluginAdaptor, this can only be called before Start()
+    virtual void SetPluginAdaptor(PluginAdaptor *plugin_adaptor) = 0;
+
     // used to sort plugins
     virtual bool operator<(const AbstractPlugin &other) const = 0;
 };
@@ -82,6 +89,16 @@ class Plugin: public AbstractPlugin {
     // return the prefix used to identify this plugin
     virtual string PluginPrefix() const = 0;
 
+    /*
+     * Plugins that return true here may be run in their own thread when olad
+     * is started with --plugin-threads. Such plugins must only register
+     * devices from StartHook(), must complete device Configure() requests
+     * before returning and must not share state with other plugins.
+     */
+    virtual bool SupportsShards() const { return false; }
+    PluginAdaptor *GetPluginAdaptor() const { return m_plugin_adaptor; }
+    void SetPluginAdaptor(PluginAdaptor *plugin_adaptor);
+
     bool operator<(const AbstractPlugin &other) const {
       return Id() < other.Id();
     }
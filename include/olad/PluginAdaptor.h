@@ -25,6 +25,7 @@
 #include <ola/Clock.h>  // NOLINT
 #include <ola/Callback.h>  // NOLINT
 #include <ola/network/SelectServerInterface.h>  // NOLINT
+#include <ola/thread/ExecutorInterface.h>  // NOLINT
 
 namespace ola {
 
@@ -35,7 +36,9 @@ class PluginAdaptor: public ola::network::SelectServerInterface {
     PluginAdaptor(class DeviceManager *device_manager,
                   ola::network::SelectServerInterface *select_server,
                   class PreferencesFactory *preferences_factory,
-                  class PortBrokerInterface *port_broker);
+                  class PortBrokerInterface *port_broker,
+                  ola::thread::ExecutorInterface *main_executor = NULL,
+                  class ExportMap *export_map = NULL);
 
     // The following methods are part of the SelectServerInterface
     bool AddReadDescriptor(ola::network::ReadFileDescriptor *descriptor);
@@ -48,10 +51,19 @@ class PluginAdaptor: public ola::network::SelectServerInterface {
 
     timeout_id RegisterRepeatingTimeout(unsigned int ms,
                                         Callback0<bool> *closure);
+    timeout_id RegisterRepeatingTimeout(const TimeInterval &interval,
+                                        Callback0<bool> *closure,
+                                        ola::thread::TimerMode mode);
     timeout_id RegisterSingleTimeout(unsigned int ms,
                                      SingleUseCallback0<void> *closure);
     void RemoveTimeout(timeout_id id);
 
+    void SetReadDescriptorName(ola::network::ReadFileDescriptor *descriptor,
+                               const std::string &name);
+    void SetWriteDescriptorName(ola::network::WriteFileDescriptor *descriptor,
+                                const std::string &name);
+    void SetTimeoutName(timeout_id id, const std::string &name);
+
     void Execute(ola::BaseCallback0<void> *closure);
 
     const TimeStamp *WakeUpTime() const;
@@ -63,6 +75,14 @@ class PluginAdaptor: public ola::network::SelectServerInterface {
     class PortBrokerInterface *GetPortBroker() const {
       return m_port_broker;
     }
+    // This is NULL for plugins that run in a PluginShard.
+    class ExportMap *GetExportMap() const { return m_export_map; }
+
+    // True if the plugins using this adaptor run in a PluginShard thread
+    // rather than the main olad thread.
+    bool IsSharded() const { return m_main_executor != NULL; }
+    void ExecuteInPluginThread(ola::BaseCallback0<void> *closure) const;
+    void ExecuteInMainThread(ola::BaseCallback0<void> *closure) const;
 
   private:
     PluginAdaptor(const PluginAdaptor&);
@@ -72,6 +92,8 @@ class PluginAdaptor: public ola::network::SelectServerInterface {
     ola::network::SelectServerInterface *m_ss;
     class PreferencesFactory *m_preferences_factory;
     class PortBrokerInterface *m_port_broker;
+    ola::thread::ExecutorInterface *m_main_executor;
+    class ExportMap *m_export_map;
 };
 }  // ola
 #endif  // INCLUDE_OLAD_PLUGINADAPTOR_H_
@@ -103,6 +103,21 @@ class OutputPort: public Port, ola::rdm::DiscoverableRDMControllerInterface {
     // Write dmx data to this port
     virtual bool WriteDMX(const DmxBuffer &buffer, uint8_t priority) = 0;
 
+    // Write dmx data along with which slots changed since the last frame.
+    // The universe always calls this one, ports that can skip unchanged
+    // frames or send partial updates override it. Any refresh the hardware or
+    // protocol needs is up to the port.
+    virtual bool WriteDMX(const DmxBuffer &buffer,
+                          uint8_t priority,
+                          const dmx_change &) {
+      return WriteDMX(buffer, priority);
+    }
+
+    // Write the per slot priorities for the universe, this is called before
+    // WriteDMX() if the universe has them. Ports which can't send per slot
+    // priorities return false.
+    virtual bool WriteSlotPriorities(const DmxBuffer &) { return false; }
+
     // Called if the universe name changes
     virtual void UniverseNameChanged(const string &new_name) = 0;
 
@@ -162,6 +177,11 @@ class BasicInputPort: public InputPort {
       return DmxSource::PRIORITY_MIN;
     }
 
+    // Get the inherited per slot priorities, NULL or an empty buffer if the
+    // source didn't send any. Like InheritedPriority() these are only used in
+    // PRIORITY_MODE_INHERIT.
+    virtual const DmxBuffer *ReadSlotPriorities() const { return NULL; }
+
     // override this to cancel the SetUniverse operation.
     virtual bool PreSetUniverse(Universe *, Universe *) { return true; }
 
@@ -181,6 +201,15 @@ class BasicInputPort: public InputPort {
     DmxSource m_dmx_source;
     const PluginAdaptor *m_plugin_adaptor;
 
+    void UpdateSourceData(DmxBuffer *buffer,
+                          DmxBuffer *slot_priorities,
+                          TimeStamp wake_up_time,
+                          uint8_t priority);
+    void RouteRDMRequest(const ola::rdm::RDMRequest *request,
+                         ola::rdm::RDMCallback *callback);
+    void RunUniverseDiscovery(ola::rdm::RDMDiscoveryCallback *on_complete,
+                              bool full);
+
     BasicInputPort(const BasicInputPort&);
     BasicInputPort& operator=(const BasicInputPort&);
 };
@@ -248,6 +277,8 @@ class BasicOutputPort: public OutputPort {
     Universe *m_universe;  // the universe this port belongs to
     AbstractDevice *m_device;
 
+    void UpdateUniverseUIDs(ola::rdm::UIDSet uids);
+
     BasicOutputPort(const BasicOutputPort&);
     BasicOutputPort& operator=(const BasicOutputPort&);
 
@@ -33,5 +33,16 @@ namespace ola {
     CAPABILITY_STATIC,  // port allows a static priority assignment
     CAPABILITY_FULL,  // port can either inherit or use a static assignment
   } port_priority_capability;
+
+  /*
+   * How a frame differs from the previous one a universe wrote to its output
+   * ports. If changed is false the data is the same, otherwise only the slots
+   * in [start, end) differ.
+   */
+  typedef struct {
+    bool changed;
+    unsigned int start;
+    unsigned int end;
+  } dmx_change;
 }  // ola
 #endif  // INCLUDE_OLAD_PORTCONSTANTS_H_
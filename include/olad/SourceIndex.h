@@ -0,0 +1,137 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * SourceIndex.h
+ * Tracks the active sources for a universe and merges them incrementally.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#ifndef INCLUDE_OLAD_SOURCEINDEX_H_
+#define INCLUDE_OLAD_SOURCEINDEX_H_
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include <ola/BaseTypes.h>
+#include <ola/Clock.h>
+#include <ola/DmxBuffer.h>
+#include <olad/DmxSource.h>
+
+namespace ola {
+
+/*
+ * The SourceIndex holds the input ports & source clients of a universe,
+ * bucketed by priority. Sources are identified by a key, the port or client
+ * pointer, and the index holds a pointer to the DmxSource, so the DmxSource
+ * must remain valid until RemoveSource() is called.
+ *
+ * When a source changes only that source is examined. For an HTP merge we
+ * keep a copy of the data each source contributed to the last merge, a
+ * channel only needs to be re-merged from every source if the changed source
+ * used to hold the highest value and has gone down. Adding or removing
+ * sources at the active priority, or changing the merge mode, causes the next
+ * merge to be done from scratch.
+ *
+ * If any source has per slot priorities, each slot is merged separately from
+ * the sources with the highest priority for that slot, across every bucket.
+ * Sources without slot priorities use their source priority for every slot.
+ * This is a full merge each time, done with the vectorized priority kernels.
+ *
+ * Sources time out if they don't send data. We remember the earliest time a
+ * source could expire and only look for expired sources once it has passed.
+ * This deadline isn't moved when a source sends more data, so the owner can
+ * arm a single timer for NextExpiry() and call SourcesExpired() when it
+ * fires, rather than rescheduling on every frame.
+ */
+class SourceIndex {
+  public:
+    SourceIndex();
+    ~SourceIndex() {}
+
+    bool SourceChanged(const void *key,
+                       const DmxSource &source,
+                       const TimeStamp &now,
+                       bool htp_merge,
+                       DmxBuffer *output);
+    bool RemoveSource(const void *key);
+    bool SourcesExpired(const TimeStamp &now,
+                        bool htp_merge,
+                        DmxBuffer *output);
+    // The earliest time a source may expire, unset if there are no sources.
+    const TimeStamp &NextExpiry() const { return m_next_expiry; }
+    void Invalidate() { m_merge_valid = false; }
+
+    uint8_t ActivePriority() const;
+    unsigned int SourceCount() const { return m_sources.size(); }
+    unsigned int ActiveSourceCount() const;
+    // The winning priority for each slot, empty unless a source has per slot
+    // priorities.
+    const DmxBuffer &SlotPriorities() const { return m_slot_priorities; }
+
+  private:
+    typedef struct {
+      const DmxSource *source;
+      uint8_t priority;
+      // the data this source contributed to the last HTP merge
+      DmxBuffer contribution;
+      bool has_slot_priorities;
+      // the source priority repeated for each slot, used in a per slot merge
+      // if this source doesn't have its own slot priorities.
+      DmxBuffer uniform_priorities;
+    } SourceEntry;
+
+    typedef std::map<const void*, SourceEntry> SourceMap;
+    typedef std::vector<SourceEntry*> Bucket;
+    // buckets are never left empty, so the last one is the active priority
+    typedef std::map<uint8_t, Bucket> BucketMap;
+
+    SourceMap m_sources;
+    BucketMap m_buckets;
+    TimeStamp m_next_expiry;
+    // true if m_merged holds the HTP merge of the active contributions
+    bool m_merge_valid;
+    unsigned int m_merged_length;
+    // only allocated once there's an HTP merge, most universes never have
+    // more than one source.
+    std::vector<uint8_t> m_merged;
+    std::vector<const DmxBuffer*> m_merge_buffers;
+    // the number of sources with per slot priorities
+    unsigned int m_slot_priority_sources;
+    DmxBuffer m_slot_priorities;
+    std::vector<const SourceEntry*> m_slot_entries;
+    std::vector<const DmxBuffer*> m_priority_buffers;
+
+    void ExpireSources(const TimeStamp &now);
+    void MergeActiveBucket(bool htp_merge, DmxBuffer *output);
+    void EraseSource(SourceMap::iterator iter);
+    void AddToBucket(SourceEntry *entry);
+    void RemoveFromBucket(SourceEntry *entry);
+    void UpdateSlotPriorityCount(SourceEntry *entry);
+    void SlotPriorityMerge(bool htp_merge, DmxBuffer *output);
+    static bool OlderSource(const SourceEntry *a, const SourceEntry *b);
+    void FullHTPMerge(const Bucket &bucket);
+    void UpdateHTPMerge(const Bucket &bucket, SourceEntry *changed);
+    uint8_t MergeChannel(const Bucket &bucket,
+                         const SourceEntry *changed,
+                         unsigned int channel) const;
+
+    // the number of channels compared at once when looking for changes
+    static const unsigned int BLOCK_SIZE = 32;
+
+    SourceIndex(const SourceIndex&);
+    SourceIndex& operator=(const SourceIndex&);
+};
+}  // ola
+#endif  // INCLUDE_OLAD_SOURCEINDEX_H_
@@ -31,7 +31,10 @@
 #include <ola/rdm/RDMControllerInterface.h>  // NOLINT
 #include <ola/rdm/UID.h>  // NOLINT
 #include <ola/rdm/UIDSet.h>  // NOLINT
+#include <ola/thread/SchedulerInterface.h>  // NOLINT
 #include <olad/DmxSource.h>  // NOLINT
+#include <olad/PortConstants.h>  // NOLINT
+#include <olad/SourceIndex.h>  // NOLINT
 
 namespace ola {
 
@@ -43,6 +46,10 @@ using ola::rdm::RDMDiscoveryCallback;
 class Client;
 class InputPort;
 class OutputPort;
+class OutputScheduler;
+class UniverseRoutes;
+class UniverseSnapshot;
+class UniverseTransform;
 
 class Universe: public ola::rdm::RDMControllerInterface {
   public:
@@ -62,14 +69,33 @@ class Universe: public ola::rdm::RDMControllerInterface {
     merge_mode MergeMode() const { return m_merge_mode; }
     bool IsActive() const;
     uint8_t ActivePriority() const { return m_active_priority; }
+    unsigned int MaxFrameRate() const { return m_max_frame_rate; }
+    unsigned int KeepAliveInterval() const { return m_keepalive_interval; }
 
     // Used to adjust the properties
     void SetName(const string &name);
     void SetMergeMode(merge_mode merge_mode);
+    void SetMaxFrameRate(unsigned int frame_rate);
+    void SetKeepAliveInterval(unsigned int interval_ms);
+    void SetOutputScheduler(OutputScheduler *scheduler);
+    // Used to time out sources that stop sending data
+    void SetScheduler(ola::thread::SchedulerInterface *scheduler);
+    // Takes ownership of the transform, NULL removes it
+    void SetTransform(UniverseTransform *transform);
+    const UniverseTransform *Transform() const { return m_transform; }
+    // The routes fed by this universe, set by the UniverseRouter
+    void SetRoutes(UniverseRoutes *routes) { m_routes = routes; }
+    // Where the frames are published for other threads to read
+    void SetSnapshot(UniverseSnapshot *snapshot);
 
     // Each universe has a DMXBuffer
     bool SetDMX(const DmxBuffer &buffer);
     const DmxBuffer &GetDMX() const { return m_buffer; }
+    // The winning priority for each slot, empty unless a source sent per slot
+    // priorities.
+    const DmxBuffer &SlotPriorities() const {
+      return m_source_index.SlotPriorities();
+    }
 
     // These are the ports we need to nofity when data changes
     bool AddPort(InputPort *port);
@@ -99,6 +125,10 @@ class Universe: public ola::rdm::RDMControllerInterface {
     bool PortDataChanged(InputPort *port);
     bool SourceClientDataChanged(Client *client);
 
+    // These are called by the OutputScheduler
+    bool WriteFrame();
+    bool RefreshOutputs();
+
     // RDM methods
     void SendRDMRequest(const ola::rdm::RDMRequest *request,
                         ola::rdm::RDMCallback *callback);
@@ -123,6 +153,8 @@ class Universe: public ola::rdm::RDMControllerInterface {
     static const char K_UNIVERSE_SINK_CLIENTS_VAR[];
     static const char K_UNIVERSE_SOURCE_CLIENTS_VAR[];
     static const char K_UNIVERSE_UID_COUNT_VAR[];
+    // the fastest rate the output scheduler's timers can honour
+    static const unsigned int MAX_FRAME_RATE;
 
   private:
     typedef struct {
@@ -134,7 +166,6 @@ class Universe: public ola::rdm::RDMControllerInterface {
 
     string m_universe_name;
     unsigned int m_universe_id;
-    string m_universe_id_str;
     uint8_t m_active_priority;
     enum merge_mode m_merge_mode;  // merge mode
     vector<InputPort*> m_input_ports;
@@ -143,9 +174,30 @@ class Universe: public ola::rdm::RDMControllerInterface {
     set<Client*> m_source_clients;  // clients that provide data
     class UniverseStore *m_universe_store;
     DmxBuffer m_buffer;
+    // the merged data before the transform is applied
+    DmxBuffer m_merged_buffer;
+    // the last frame written to the output ports, used to find what changed
+    DmxBuffer m_last_frame;
+    // the slot priorities last written to the output ports
+    DmxBuffer m_last_slot_priorities;
+    TimeStamp m_slot_priority_time;
     ExportMap *m_export_map;
+    unsigned int *m_frame_counter;  // in the export map, may be NULL
     map<UID, OutputPort*> m_output_uids;
     Clock *m_clock;
+    SourceIndex m_source_index;
+    OutputScheduler *m_output_scheduler;
+    unsigned int m_max_frame_rate;  // 0 is unlimited
+    unsigned int m_keepalive_interval;  // in ms, 0 disables the keepalive
+    UniverseTransform *m_transform;
+    UniverseRoutes *m_routes;
+    UniverseSnapshot *m_snapshot;
+    ola::thread::SchedulerInterface *m_scheduler;
+    // a single timer for the source that will expire first
+    ola::thread::timeout_id m_expiry_timeout;
+    TimeStamp m_expiry_deadline;
+
+    static const TimeInterval SLOT_PRIORITY_RESEND_INTERVAL;
 
     Universe(const Universe&);
     Universe& operator=(const Universe&);
@@ -154,16 +206,22 @@ class Universe: public ola::rdm::RDMControllerInterface {
                             const ola::rdm::RDMResponse *response,
                             const std::vector<std::string> &packets);
     bool UpdateDependants();
+    void WriteToPorts(const dmx_change &change);
     void UpdateName();
     void UpdateMode();
     bool RemoveClient(Client *client, bool is_source);
     bool AddClient(Client *client, bool is_source);
-    void HTPMergeSources(const vector<DmxSource> &sources);
     bool MergeAll(const InputPort *port, const Client *client);
+    void ScheduleSourceExpiry();
+    void SourceExpiryTimeout();
+    void CancelSourceExpiry();
     void PortDiscoveryComplete(BaseCallback0<void> *on_complete,
                                OutputPort *output_port,
                                const ola::rdm::UIDSet &uids);
     void DiscoveryComplete(RDMDiscoveryCallback *on_complete);
+    void SendRDMRequestToPort(OutputPort *port,
+                              const ola::rdm::RDMRequest *request,
+                              ola::rdm::RDMCallback *callback);
 
     template<class PortClass>
     bool GenericAddPort(PortClass *port,
@@ -0,0 +1,86 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DmxBatch.h
+ * The data for many universes, sent to the server in a single request.
+ * Copyright (C) 2012 Simon Newton
+ *
+ * The server applies every universe in the batch before it merges any of
+ * them, so the output ports see the frames from the same batch together.
+ */
+
+#ifndef OLA_DMXBATCH_H_
+#define OLA_DMXBATCH_H_
+
+#include <stdint.h>
+#include <ola/DmxBuffer.h>
+#include <vector>
+
+namespace ola {
+
+class DmxBatch {
+  public:
+    typedef struct {
+      unsigned int universe;
+      bool has_priority;
+      uint8_t priority;
+      DmxBuffer data;
+    } entry;
+
+    DmxBatch() : m_size(0) {}
+
+    /*
+     * Add the data for a universe, the server's default priority is used.
+     */
+    void Add(unsigned int universe, const DmxBuffer &data) {
+      entry &new_entry = NewEntry();
+      new_entry.universe = universe;
+      new_entry.has_priority = false;
+      new_entry.priority = 0;
+      new_entry.data = data;
+    }
+
+    /*
+     * Add the data for a universe with a priority.
+     */
+    void Add(unsigned int universe, const DmxBuffer &data, uint8_t priority) {
+      entry &new_entry = NewEntry();
+      new_entry.universe = universe;
+      new_entry.has_priority = true;
+      new_entry.priority = priority;
+      new_entry.data = data;
+    }
+
+    /*
+     * Remove all universes. The space is kept so the batch can be refilled
+     * for the next frame.
+     */
+    void Clear() { m_size = 0; }
+
+    unsigned int Size() const { return m_size; }
+    const entry &Get(unsigned int i) const { return m_entries[i]; }
+
+  private:
+    std::vector<entry> m_entries;
+    unsigned int m_size;
+
+    entry &NewEntry() {
+      if (m_size == m_entries.size())
+        m_entries.push_back(entry());
+      return m_entries[m_size++];
+    }
+};
+}  // ola
+#endif  // OLA_DMXBATCH_H_
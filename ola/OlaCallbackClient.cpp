@@ -295,6 +295,25 @@ bool OlaCallbackClient::RegisterUniverse(
 }
 
 
+/*
+ * Register our interest in a universe, with frames streamed rather than acked.
+ * @param uni  the universe id
+ * @param action REGISTER or UNREGISTER
+ * @param streaming true to have frames pushed without waiting for an ack
+ * @param max_rate the max frames per second to push, 0 means no limit
+ * @return true on success, false on failure
+ */
+bool OlaCallbackClient::RegisterUniverse(
+    unsigned int universe,
+    ola::RegisterAction register_action,
+    bool streaming,
+    unsigned int max_rate,
+    SingleUseCallback1<void, const string&> *callback) {
+  return m_core->RegisterUniverse(universe, register_action, streaming,
+                                  max_rate, callback);
+}
+
+
 /*
  * Write some dmx data.
  * @param universe universe to send to
@@ -336,6 +355,17 @@ bool OlaCallbackClient::SendDmx(
 }
 
 
+/*
+ * Stream the data for many universes in a single request. The server applies
+ * all of them before it updates any output ports.
+ * @param batch the universes and their data
+ * @return true on success, false on failure
+ */
+bool OlaCallbackClient::SendDmxBatch(const DmxBatch &batch) {
+  return m_core->SendDmxBatch(batch);
+}
+
+
 /*
  * Read dmx data.
  * @param universe the universe id to get data for
@@ -348,6 +378,41 @@ bool OlaCallbackClient::FetchDmx(
 }
 
 
+/*
+ * Ask olad for a shared memory region.
+ * @param input_universes the universes to send frames to
+ * @param output_universes the universes to receive frames for
+ * @return true on success, false on failure
+ */
+bool OlaCallbackClient::SetupSharedMemory(
+    const vector<unsigned int> &input_universes,
+    const vector<unsigned int> &output_universes,
+    SingleUseCallback1<void, const string&> *callback) {
+  return m_core->SetupSharedMemory(input_universes, output_universes,
+                                   callback);
+}
+
+
+/*
+ * Read the latest frame for a shared memory output universe.
+ * @return true if there was a new frame, false otherwise
+ */
+bool OlaCallbackClient::ReadSharedDmx(unsigned int universe,
+                                      DmxBuffer *data) {
+  return m_core->ReadSharedDmx(universe, data);
+}
+
+
+/*
+ * Send & receive encoded frames, if olad supports it.
+ * @return true on success, false on failure
+ */
+bool OlaCallbackClient::SetupEncoding(
+    SingleUseCallback1<void, const string&> *callback) {
+  return m_core->SetupEncoding(callback);
+}
+
+
 /*
  * Fetch the UID list for a universe
  * @param universe the universe id to get data for
@@ -23,6 +23,7 @@
 #define OLA_OLACALLBACKCLIENT_H_
 
 #include <ola/Callback.h>
+#include <ola/DmxBatch.h>
 #include <ola/DmxBuffer.h>
 #include <ola/OlaDevice.h>
 #include <ola/common.h>
@@ -132,6 +133,14 @@ class OlaCallbackClient: public ola::rdm::RDMAPIImplInterface {
         unsigned int universe,
         ola::RegisterAction register_action,
         SingleUseCallback1<void, const string&> *callback);
+    // Have frames streamed without acks, at most max_rate frames per second.
+    // A max_rate of 0 means no limit.
+    bool RegisterUniverse(
+        unsigned int universe,
+        ola::RegisterAction register_action,
+        bool streaming,
+        unsigned int max_rate,
+        SingleUseCallback1<void, const string&> *callback);
     bool SendDmx(
         unsigned int universe,
         const DmxBuffer &data,
@@ -142,11 +151,23 @@ class OlaCallbackClient: public ola::rdm::RDMAPIImplInterface {
         Callback1<void, const string&> *callback);
     // A version of SendDmx that doesn't wait for confirmation
     bool SendDmx(unsigned int universe, const DmxBuffer &data);
+    // Stream the data for many universes in one request
+    bool SendDmxBatch(const DmxBatch &batch);
 
     bool FetchDmx(
         unsigned int universe,
         SingleUseCallback2<void, const DmxBuffer&, const string&> *callback);
 
+    // Stream frames through shared memory rather than the connection.
+    bool SetupSharedMemory(
+        const vector<unsigned int> &input_universes,
+        const vector<unsigned int> &output_universes,
+        SingleUseCallback1<void, const string&> *callback);
+    // Returns true if there's a new frame for a shared memory output universe.
+    bool ReadSharedDmx(unsigned int universe, DmxBuffer *data);
+    // Compress the frames sent & received, if olad supports it.
+    bool SetupEncoding(SingleUseCallback1<void, const string&> *callback);
+
     // rdm methods
     bool FetchUIDList(
         unsigned int universe,
@@ -51,7 +51,9 @@ OlaClientCore::OlaClientCore(ConnectedDescriptor *descriptor)
       m_dmx_callback(NULL),
       m_channel(NULL),
       m_stub(NULL),
-      m_connected(false) {
+      m_connected(false),
+      m_shared_memory(NULL),
+      m_keep_received_frames(false) {
 }
 
 
@@ -94,6 +96,11 @@ bool OlaClientCore::Setup() {
  * @return true on success, false on failure
  */
 bool OlaClientCore::Stop() {
+  delete m_shared_memory;
+  m_shared_memory = NULL;
+  m_encoder.DisableEncodings();
+  m_keep_received_frames = false;
+  m_received_frames.clear();
   if (m_connected) {
     m_descriptor->Close();
     delete m_channel;
@@ -494,6 +501,23 @@ bool OlaClientCore::RegisterUniverse(
     unsigned int universe,
     ola::RegisterAction register_action,
     SingleUseCallback1<void, const string&> *callback) {
+  return RegisterUniverse(universe, register_action, false, 0, callback);
+}
+
+
+/*
+ * Register our interest in a universe.
+ * @param universe the id of the universe
+ * @param action the action (register or unregister)
+ * @param streaming true to have frames pushed without waiting for an ack
+ * @param max_rate the max frames per second to push, 0 means no limit
+ */
+bool OlaClientCore::RegisterUniverse(
+    unsigned int universe,
+    ola::RegisterAction register_action,
+    bool streaming,
+    unsigned int max_rate,
+    SingleUseCallback1<void, const string&> *callback) {
   if (!m_connected) {
     delete callback;
     return false;
@@ -508,6 +532,10 @@ bool OlaClientCore::RegisterUniverse(
         ola::proto::UNREGISTER);
   request.set_universe(universe);
   request.set_action(action);
+  if (streaming)
+    request.set_streaming(true);
+  if (max_rate)
+    request.set_max_rate(max_rate);
 
   google::protobuf::Closure *cb = google::protobuf::NewCallback(
       this,
@@ -561,6 +589,52 @@ bool OlaClientCore::SendDmx(unsigned int universe, const DmxBuffer &data) {
 }
 
 
+/*
+ * Stream the data for many universes in a single request.
+ * @param batch the universes and their data
+ * @return true on success, false on failure
+ */
+bool OlaClientCore::SendDmxBatch(const DmxBatch &batch) {
+  if (!m_connected)
+    return false;
+
+  m_batch_entries.clear();
+  bool wrote_shared_memory = false;
+  for (unsigned int i = 0; i < batch.Size(); i++) {
+    const DmxBatch::entry &entry = batch.Get(i);
+    if (m_shared_memory &&
+        (entry.has_priority ?
+         m_shared_memory->Write(entry.universe, entry.data, entry.priority) :
+         m_shared_memory->Write(entry.universe, entry.data))) {
+      m_encoder.Forget(entry.universe);
+      wrote_shared_memory = true;
+    } else {
+      m_batch_entries.push_back(i);
+    }
+  }
+
+  if (wrote_shared_memory)
+    SharedMemoryWritten();
+  // see GenericSendDmx(), the frames are only encoded if the batch will be
+  // sent
+  if (m_batch_entries.empty() || m_channel->OutputBlocked())
+    return true;
+
+  // Clear() keeps the DmxData messages around so add_data() reuses them
+  m_batch_request.Clear();
+  vector<unsigned int>::const_iterator iter = m_batch_entries.begin();
+  for (; iter != m_batch_entries.end(); ++iter) {
+    const DmxBatch::entry &entry = batch.Get(*iter);
+    ola::proto::DmxData *data = m_batch_request.add_data();
+    SetFrame(data, entry.universe, entry.data);
+    if (entry.has_priority)
+      data->set_priority(entry.priority);
+  }
+  m_stub->StreamDmxDataBatch(NULL, &m_batch_request, NULL, NULL);
+  return true;
+}
+
+
 /*
  * Read dmx data
  * @param universe the universe id to get data for
@@ -589,6 +663,92 @@ bool OlaClientCore::FetchDmx(
 }
 
 
+/*
+ * Ask olad for a shared memory region. Once it's set up, streamed frames for
+ * the input universes are written to the region and the merged frames for the
+ * output universes can be read with ReadSharedDmx(). The callback is run with
+ * an error if olad couldn't create the region or we couldn't map it, or if
+ * this connection already has a region.
+ * @param input_universes the universes to send frames to
+ * @param output_universes the universes to receive frames for
+ * @return true on success, false on failure
+ */
+bool OlaClientCore::SetupSharedMemory(
+    const vector<unsigned int> &input_universes,
+    const vector<unsigned int> &output_universes,
+    SingleUseCallback1<void, const string&> *callback) {
+  if (!m_connected) {
+    delete callback;
+    return false;
+  }
+
+  ola::proto::SharedMemoryRequest request;
+  SimpleRpcController *controller = new SimpleRpcController();
+  ola::proto::SharedMemoryReply *reply = new ola::proto::SharedMemoryReply();
+
+  vector<unsigned int>::const_iterator iter = input_universes.begin();
+  for (; iter != input_universes.end(); ++iter)
+    request.add_input_universes(*iter);
+  for (iter = output_universes.begin(); iter != output_universes.end();
+       ++iter)
+    request.add_output_universes(*iter);
+
+  shared_memory_args *args = NewArgs<shared_memory_args>(controller, reply,
+                                                         callback);
+  args->input_universes = input_universes;
+  args->output_universes = output_universes;
+  google::protobuf::Closure *cb = google::protobuf::NewCallback(
+      this,
+      &ola::OlaClientCore::HandleSharedMemory,
+      args);
+  m_stub->SetupSharedMemory(controller, &request, reply, cb);
+  return true;
+}
+
+
+/*
+ * Read the latest frame for an output universe from shared memory.
+ * @param universe the output universe
+ * @param data the DmxBuffer to copy the frame to
+ * @return true if there was a new frame, false otherwise
+ */
+bool OlaClientCore::ReadSharedDmx(unsigned int universe, DmxBuffer *data) {
+  return m_shared_memory && m_shared_memory->Read(universe, data);
+}
+
+
+/*
+ * Ask olad which encodings it accepts for DmxData, and tell it the ones we
+ * accept. Frames are then sent as deltas against the last frame for the
+ * universe, or run length encoded, whichever is smaller. The callback is run
+ * with an error if olad doesn't support encoded frames, in which case they're
+ * sent as is. This lasts until the connection is closed.
+ * @return true on success, false on failure
+ */
+bool OlaClientCore::SetupEncoding(
+    SingleUseCallback1<void, const string&> *callback) {
+  if (!m_connected) {
+    delete callback;
+    return false;
+  }
+
+  ola::proto::DmxEncodingRequest request;
+  SimpleRpcController *controller = new SimpleRpcController();
+  ola::proto::DmxEncodingReply *reply = new ola::proto::DmxEncodingReply();
+  request.add_encodings(ola::proto::DMX_RLE);
+  request.add_encodings(ola::proto::DMX_DELTA);
+  // olad may send a delta as soon as it's seen the request
+  m_keep_received_frames = true;
+
+  google::protobuf::Closure *cb = google::protobuf::NewCallback(
+      this,
+      &ola::OlaClientCore::HandleEncoding,
+      NewArgs<encoding_args>(controller, reply, callback));
+  m_stub->SetDmxEncodings(controller, &request, reply, cb);
+  return true;
+}
+
+
 /*
  * Fetch the UID list for a universe
  */
@@ -819,17 +979,28 @@ void OlaClientCore::UpdateDmxData(
     const ola::proto::DmxData *request,
     ola::proto::Ack *response,
     ::google::protobuf::Closure *done) {
-  if (m_dmx_callback) {
-    DmxBuffer buffer;
-    buffer.Set(request->data());
-    m_dmx_callback->Run(request->universe(), buffer, "");
-  }
+  FrameReceived(request);
   done->Run();
   (void) response;
   (void) controller;
 }
 
 
+/*
+ * Called when new DMX data is streamed to us
+ */
+void OlaClientCore::StreamDmxData(
+    ::google::protobuf::RpcController *controller,
+    const ola::proto::DmxData *request,
+    ola::proto::STREAMING_NO_RESPONSE *response,
+    ::google::protobuf::Closure *done) {
+  FrameReceived(request);
+  (void) controller;
+  (void) response;
+  (void) done;
+}
+
+
 // The following are RPC callbacks
 
 /*
@@ -981,6 +1152,53 @@ void OlaClientCore::HandleAck(ack_args *args) {
 }
 
 
+/*
+ * Called once SetupSharedMemory completes
+ */
+void OlaClientCore::HandleSharedMemory(shared_memory_args *args) {
+  string error_string = "";
+  if (args->controller->Failed()) {
+    error_string = args->controller->ErrorText();
+  } else {
+    SharedDmxClient *shared_memory = new SharedDmxClient();
+    if (shared_memory->Open(args->reply->name(), args->input_universes,
+                            args->output_universes)) {
+      delete m_shared_memory;
+      m_shared_memory = shared_memory;
+    } else {
+      delete shared_memory;
+      error_string = "Failed to map the shared memory region";
+    }
+  }
+
+  if (args->callback)
+    args->callback->Run(error_string);
+  FreeArgs(args);
+}
+
+
+/*
+ * Called once SetupEncoding completes
+ */
+void OlaClientCore::HandleEncoding(encoding_args *args) {
+  string error_string = "";
+  if (args->controller->Failed()) {
+    error_string = args->controller->ErrorText();
+    m_keep_received_frames = false;
+    m_received_frames.clear();
+  } else {
+    m_encoder.DisableEncodings();
+    for (int i = 0; i < args->reply->encodings_size(); i++)
+      m_encoder.EnableEncoding(
+          static_cast<dmx_encoding>(args->reply->encodings(i)));
+  }
+
+  if (args->callback)
+    args->callback->Run(error_string);
+  FreeArgs(args);
+}
+
+
 /*
  * Called once UniverseInfo completes
  */
@@ -1155,9 +1373,20 @@ bool OlaClientCore::GenericSendDmx(
     unsigned int universe,
     const DmxBuffer &data,
     BaseCallback1<void, const string&> *callback) {
+  if (!callback && m_shared_memory && m_shared_memory->Write(universe, data)) {
+    m_encoder.Forget(universe);
+    SharedMemoryWritten();
+    return true;
+  }
+
+  // The channel drops streaming requests while its output is blocked. Don't
+  // encode the frame, otherwise the next delta would be against a frame olad
+  // never saw.
+  if (!callback && m_channel->OutputBlocked())
+    return true;
+
   ola::proto::DmxData request;
-  request.set_universe(universe);
-  request.set_data(data.Get());
+  SetFrame(&request, universe, data);
 
   if (callback) {
     // full request
@@ -1176,6 +1405,64 @@ bool OlaClientCore::GenericSendDmx(
 }
 
 
+/*
+ * Called after frames are written to shared memory, olad only needs to be
+ * told about them if it's armed the doorbell.
+ */
+void OlaClientCore::SharedMemoryWritten() {
+  if (m_shared_memory->TakeDoorbell()) {
+    ola::proto::SharedMemoryDoorbell doorbell;
+    m_stub->RingSharedMemoryDoorbell(NULL, &doorbell, NULL, NULL);
+  }
+}
+
+
+/*
+ * Set the frame in a DmxData message, encoding it if we can.
+ */
+void OlaClientCore::SetFrame(ola::proto::DmxData *request,
+                             unsigned int universe,
+                             const DmxBuffer &data) {
+  const uint8_t *encoded_data;
+  unsigned int length;
+  dmx_encoding encoding = m_encoder.Encode(universe, data, &encoded_data,
+                                           &length);
+  request->set_universe(universe);
+  request->set_data(encoded_data, length);
+  if (encoding != DMX_ENCODING_RAW) {
+    request->set_encoding(static_cast<ola::proto::DmxEncoding>(encoding));
+    request->set_length(data.Size());
+  }
+}
+
+
+/*
+ * Called when olad pushes a frame to us.
+ */
+void OlaClientCore::FrameReceived(const ola::proto::DmxData *request) {
+  if (!m_keep_received_frames) {
+    if (m_dmx_callback) {
+      DmxBuffer buffer;
+      buffer.Set(request->data());
+      m_dmx_callback->Run(request->universe(), buffer, "");
+    }
+    return;
+  }
+
+  const string &data = request->data();
+  DmxBuffer *frame = &m_received_frames[request->universe()];
+  if (!DecodeDmxFrame(static_cast<dmx_encoding>(request->encoding()),
+                      reinterpret_cast<const uint8_t*>(data.data()),
+                      data.size(), request->length(), frame)) {
+    OLA_WARN << "Failed to decode frame for universe " << request->universe();
+    frame->Reset();
+    return;
+  }
+  if (m_dmx_callback)
+    m_dmx_callback->Run(request->universe(), *frame, "");
+}
+
+
 /*
  * Fetch a list of candidate ports, with or without a universe
  */
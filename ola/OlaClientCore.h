@@ -22,15 +22,19 @@
 #define OLA_OLACLIENTCORE_H_
 
 #include <google/protobuf/stubs/common.h>
+#include <map>
 #include <string>
 #include <vector>
 
 #include "common/protocol/Ola.pb.h"
 #include "common/rpc/SimpleRpcController.h"
 #include "common/rpc/StreamRpcChannel.h"
+#include "common/utils/DmxFrameEncoder.h"
 #include "ola/Callback.h"
+#include "ola/DmxBatch.h"
 #include "ola/DmxBuffer.h"
 #include "ola/OlaDevice.h"
+#include "ola/SharedDmxClient.h"
 #include "ola/common.h"
 #include "ola/network/Socket.h"
 #include "ola/plugin_id.h"
@@ -140,6 +144,14 @@ class OlaClientCore: public ola::proto::OlaClientService {
         unsigned int universe,
         ola::RegisterAction register_action,
         SingleUseCallback1<void, const string&> *callback);
+    // Have frames streamed without acks, at most max_rate frames per second.
+    // A max_rate of 0 means no limit.
+    bool RegisterUniverse(
+        unsigned int universe,
+        ola::RegisterAction register_action,
+        bool streaming,
+        unsigned int max_rate,
+        SingleUseCallback1<void, const string&> *callback);
     bool SendDmx(
         unsigned int universe,
         const DmxBuffer &data,
@@ -149,10 +161,22 @@ class OlaClientCore: public ola::proto::OlaClientService {
         const DmxBuffer &data,
         Callback1<void, const string&> *callback);
     bool SendDmx(unsigned int universe, const DmxBuffer &data);
+    // Stream the data for many universes in one request.
+    bool SendDmxBatch(const DmxBatch &batch);
     bool FetchDmx(
         unsigned int universe,
         SingleUseCallback2<void, const DmxBuffer&, const string&> *callback);
 
+    // shared memory methods
+    bool SetupSharedMemory(
+        const vector<unsigned int> &input_universes,
+        const vector<unsigned int> &output_universes,
+        SingleUseCallback1<void, const string&> *callback);
+    bool ReadSharedDmx(unsigned int universe, DmxBuffer *data);
+
+    // Compress the frames sent & received, if olad supports it.
+    bool SetupEncoding(SingleUseCallback1<void, const string&> *callback);
+
     // rdm methods
     bool FetchUIDList(
         unsigned int universe,
@@ -208,6 +232,10 @@ class OlaClientCore: public ola::proto::OlaClientService {
                        const ola::proto::DmxData* request,
                        ola::proto::Ack* response,
                        ::google::protobuf::Closure* done);
+    void StreamDmxData(::google::protobuf::RpcController* controller,
+                       const ola::proto::DmxData* request,
+                       ola::proto::STREAMING_NO_RESPONSE* response,
+                       ::google::protobuf::Closure* done);
 
     // unfortunately all of these need to be public because they're used in the
     // closures. That's why this class is wrapped in OlaClient or
@@ -282,6 +310,24 @@ class OlaClientCore: public ola::proto::OlaClientService {
 
     void HandleGetDmx(get_dmx_args *args);
 
+    typedef struct {
+      SimpleRpcController *controller;
+      ola::proto::SharedMemoryReply *reply;
+      SingleUseCallback1<void, const string&> *callback;
+      vector<unsigned int> input_universes;
+      vector<unsigned int> output_universes;
+    } shared_memory_args;
+
+    void HandleSharedMemory(shared_memory_args *args);
+
+    typedef struct {
+      SimpleRpcController *controller;
+      ola::proto::DmxEncodingReply *reply;
+      SingleUseCallback1<void, const string&> *callback;
+    } encoding_args;
+
+    void HandleEncoding(encoding_args *args);
+
     typedef struct {
       SimpleRpcController *controller;
       ola::proto::UIDListReply *reply;
@@ -316,6 +362,11 @@ class OlaClientCore: public ola::proto::OlaClientService {
         unsigned int universe,
         const DmxBuffer &data,
         BaseCallback1<void, const string&> *callback);
+    void SharedMemoryWritten();
+    void SetFrame(ola::proto::DmxData *request,
+                  unsigned int universe,
+                  const DmxBuffer &data);
+    void FrameReceived(const ola::proto::DmxData *request);
 
     bool GenericFetchCandidatePorts(
         unsigned int universe_id,
@@ -370,6 +421,15 @@ class OlaClientCore: public ola::proto::OlaClientService {
     StreamRpcChannel *m_channel;
     ola::proto::OlaServerService_Stub *m_stub;
     int m_connected;
+    ola::proto::DmxDataBatch m_batch_request;  // reused for each batch
+    // the entries in a batch that weren't written to shared memory
+    std::vector<unsigned int> m_batch_entries;
+    SharedDmxClient *m_shared_memory;
+    DmxFrameEncoder m_encoder;
+    // Once we've asked for encoded frames, the last frame received for each
+    // universe is kept since olad may send a delta against it.
+    bool m_keep_received_frames;
+    std::map<unsigned int, DmxBuffer> m_received_frames;
 };
 
 
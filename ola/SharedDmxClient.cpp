@@ -0,0 +1,114 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * SharedDmxClient.cpp
+ * The client's side of a shared memory region created by olad.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <map>
+#include <string>
+#include <vector>
+#include "ola/Logging.h"
+#include "ola/SharedDmxClient.h"
+
+namespace ola {
+
+using std::map;
+using std::string;
+using std::vector;
+
+
+/*
+ * Map the region olad created. The name is removed once it's mapped, so the
+ * region goes away when both sides are done with it.
+ * @param name the name from the SharedMemoryReply
+ * @param input_universes the input universes from the request
+ * @param output_universes the output universes from the request
+ * @returns true if the region was mapped, false otherwise
+ */
+bool SharedDmxClient::Open(const string &name,
+                           const vector<unsigned int> &input_universes,
+                           const vector<unsigned int> &output_universes) {
+  m_input_slots.clear();
+  m_output_slots.clear();
+  if (!m_region.Open(name))
+    return false;
+  m_region.Unlink();
+
+  if (m_region.SlotCount() !=
+      input_universes.size() + output_universes.size()) {
+    OLA_WARN << "Shared memory region " << name << " has " <<
+      m_region.SlotCount() << " slots, expected " <<
+      input_universes.size() + output_universes.size();
+    m_region.Close();
+    return false;
+  }
+
+  for (unsigned int i = 0; i < input_universes.size(); i++)
+    m_input_slots.insert(map<unsigned int, unsigned int>::value_type(
+          input_universes[i], i));
+  for (unsigned int i = 0; i < output_universes.size(); i++) {
+    output_slot slot;
+    slot.slot = input_universes.size() + i;
+    slot.sequence = 0;
+    m_output_slots.insert(map<unsigned int, output_slot>::value_type(
+          output_universes[i], slot));
+  }
+  return true;
+}
+
+
+/*
+ * Write a frame for an input universe, olad's default priority is used.
+ */
+bool SharedDmxClient::Write(unsigned int universe, const DmxBuffer &data) {
+  map<unsigned int, unsigned int>::const_iterator iter =
+    m_input_slots.find(universe);
+  if (iter == m_input_slots.end())
+    return false;
+  m_region.Write(iter->second, data);
+  return true;
+}
+
+
+/*
+ * Write a frame with a priority for an input universe.
+ */
+bool SharedDmxClient::Write(unsigned int universe, const DmxBuffer &data,
+                            uint8_t priority) {
+  map<unsigned int, unsigned int>::const_iterator iter =
+    m_input_slots.find(universe);
+  if (iter == m_input_slots.end())
+    return false;
+  m_region.Write(iter->second, data, priority);
+  return true;
+}
+
+
+/*
+ * Read the latest merged frame for an output universe.
+ * @param universe the output universe
+ * @param data the DmxBuffer to copy the frame to
+ * @returns true if there was a frame we haven't read yet, false otherwise.
+ */
+bool SharedDmxClient::Read(unsigned int universe, DmxBuffer *data) {
+  map<unsigned int, output_slot>::iterator iter =
+    m_output_slots.find(universe);
+  if (iter == m_output_slots.end())
+    return false;
+  return m_region.Read(iter->second.slot, &iter->second.sequence, data);
+}
+}  // ola
@@ -0,0 +1,65 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * SharedDmxClient.h
+ * The client's side of a shared memory region created by olad.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#ifndef OLA_SHAREDDMXCLIENT_H_
+#define OLA_SHAREDDMXCLIENT_H_
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "common/utils/SharedDmxRegion.h"
+#include "ola/DmxBuffer.h"
+
+namespace ola {
+
+class SharedDmxClient {
+  public:
+    SharedDmxClient() {}
+    ~SharedDmxClient() {}
+
+    bool Open(const std::string &name,
+              const std::vector<unsigned int> &input_universes,
+              const std::vector<unsigned int> &output_universes);
+
+    // Returns false if the universe doesn't have an input slot.
+    bool Write(unsigned int universe, const DmxBuffer &data);
+    bool Write(unsigned int universe, const DmxBuffer &data, uint8_t priority);
+    // Returns true if olad needs to be told about the frames written.
+    bool TakeDoorbell() { return m_region.TakeDoorbell(); }
+
+    // Returns true if there was a new frame for an output universe.
+    bool Read(unsigned int universe, DmxBuffer *data);
+
+  private:
+    typedef struct {
+      unsigned int slot;
+      uint32_t sequence;
+    } output_slot;
+
+    SharedDmxRegion m_region;
+    std::map<unsigned int, unsigned int> m_input_slots;
+    std::map<unsigned int, output_slot> m_output_slots;
+
+    SharedDmxClient(const SharedDmxClient&);
+    SharedDmxClient& operator=(const SharedDmxClient&);
+};
+}  // ola
+#endif  // OLA_SHAREDDMXCLIENT_H_
@@ -24,13 +24,29 @@
 #include <ola/DmxBuffer.h>
 #include <ola/Logging.h>
 #include <ola/StreamingClient.h>
+#include <vector>
 #include "common/protocol/Ola.pb.h"
+#include "common/rpc/SimpleRpcController.h"
 #include "common/rpc/StreamRpcChannel.h"
+#include "common/utils/DmxFrameEncoder.h"
+#include "ola/Clock.h"
+#include "ola/SharedDmxClient.h"
 
 namespace ola {
 
+using ola::rpc::SimpleRpcController;
 using ola::rpc::StreamRpcChannel;
 using ola::proto::OlaServerService_Stub;
+using std::vector;
+
+
+/*
+ * Called when a synchronous request completes.
+ */
+static void SetRequestDone(bool *done) {
+  *done = true;
+}
+
 
 StreamingClient::StreamingClient(bool auto_start)
     : m_auto_start(auto_start),
@@ -38,12 +54,17 @@ StreamingClient::StreamingClient(bool auto_start)
       m_ss(NULL),
       m_channel(NULL),
       m_stub(NULL),
-      m_socket_closed(false) {
+      m_batch_request(new ola::proto::DmxDataBatch()),
+      m_socket_closed(false),
+      m_shared_memory(NULL),
+      m_shared_memory_frames(0),
+      m_encoder(NULL) {
 }
 
 
 StreamingClient::~StreamingClient() {
   Stop();
+  delete m_batch_request;
 }
 
 
@@ -73,6 +94,8 @@ bool StreamingClient::Setup() {
     m_socket = NULL;
     return false;
   }
+  // anything the socket can't take is sent from RunOnce()
+  m_channel->SetSelectServer(m_ss);
 
   m_stub = new OlaServerService_Stub(m_channel);
 
@@ -97,6 +120,11 @@ bool StreamingClient::Setup() {
  * Close the ola connection.
  */
 void StreamingClient::Stop() {
+  delete m_shared_memory;
+  m_shared_memory = NULL;
+  delete m_encoder;
+  m_encoder = NULL;
+
   if (m_stub)
     delete m_stub;
 
@@ -123,24 +151,97 @@ void StreamingClient::Stop() {
  */
 bool StreamingClient::SendDmx(unsigned int universe,
                               const DmxBuffer &data) {
-  if (!m_stub || !m_socket->ValidReadDescriptor())
+  return SendDmx(universe, data, DmxBuffer());
+}
+
+
+/*
+ * Send DMX with a priority for each slot to the remote OLA server. A slot
+ * priority of 0 means this client doesn't control that slot.
+ * @returns True is sent sucessfully, false if the connection to the server has
+ * been closed and Setup() needs to be run again.
+ */
+bool StreamingClient::SendDmx(unsigned int universe,
+                              const DmxBuffer &data,
+                              const DmxBuffer &slot_priorities) {
+  if (m_shared_memory && !slot_priorities.Size() &&
+      m_shared_memory->Write(universe, data)) {
+    if (m_encoder)
+      m_encoder->Forget(universe);
+    return SharedMemoryWritten();
+  }
+
+  if (!CheckConnection())
     return false;
 
-  // We select() on the fd here to see if the remove end has closed the
-  // connection. We could skip this and rely on the EPIPE delivered by the
-  // write() below, but that introduces a race condition in the unittests.
-  m_socket_closed = false;
-  m_ss->RunOnce(0, 0);
+  // The channel drops streaming requests while its output is blocked. Don't
+  // encode the frame, otherwise the next delta would be against a frame olad
+  // never saw.
+  if (m_channel->OutputBlocked())
+    return true;
+
+  ola::proto::DmxData request;
+  SetFrame(&request, universe, data);
+  if (slot_priorities.Size())
+    request.set_slot_priorities(slot_priorities.Get());
+  m_stub->StreamDmxData(NULL, &request, NULL, NULL);
 
   if (m_socket_closed) {
     Stop();
     return false;
   }
+  return true;
+}
 
-  ola::proto::DmxData request;
-  request.set_universe(universe);
-  request.set_data(data.Get());
-  m_stub->StreamDmxData(NULL, &request, NULL, NULL);
+
+/*
+ * Send the data for many universes in a single request. The server applies
+ * all of them before it updates any output ports.
+ * @returns True is sent sucessfully, false if the connection to the server has
+ * been closed and Setup() needs to be run again.
+ */
+bool StreamingClient::SendDmxBatch(const DmxBatch &batch) {
+  if (!m_stub)
+    return false;
+
+  m_batch_entries.clear();
+  bool wrote_shared_memory = false;
+  for (unsigned int i = 0; i < batch.Size(); i++) {
+    const DmxBatch::entry &entry = batch.Get(i);
+    if (m_shared_memory &&
+        (entry.has_priority ?
+         m_shared_memory->Write(entry.universe, entry.data, entry.priority) :
+         m_shared_memory->Write(entry.universe, entry.data))) {
+      if (m_encoder)
+        m_encoder->Forget(entry.universe);
+      wrote_shared_memory = true;
+    } else {
+      m_batch_entries.push_back(i);
+    }
+  }
+
+  if (wrote_shared_memory && !SharedMemoryWritten())
+    return false;
+  if (m_batch_entries.empty())
+    return true;
+
+  if (!CheckConnection())
+    return false;
+  // see SendDmx(), the frames are only encoded if the batch will be sent
+  if (m_channel->OutputBlocked())
+    return true;
+
+  // Clear() keeps the DmxData messages around so add_data() reuses them
+  m_batch_request->Clear();
+  vector<unsigned int>::const_iterator iter = m_batch_entries.begin();
+  for (; iter != m_batch_entries.end(); ++iter) {
+    const DmxBatch::entry &entry = batch.Get(*iter);
+    ola::proto::DmxData *data = m_batch_request->add_data();
+    SetFrame(data, entry.universe, entry.data);
+    if (entry.has_priority)
+      data->set_priority(entry.priority);
+  }
+  m_stub->StreamDmxDataBatch(NULL, m_batch_request, NULL, NULL);
 
   if (m_socket_closed) {
     Stop();
@@ -150,6 +251,84 @@ bool StreamingClient::SendDmx(unsigned int universe,
 }
 
 
+/*
+ * Ask olad for a shared memory region and send the frames for these universes
+ * through it. The universes must be the ones frames are sent to, the others
+ * still go over the connection. This fails if olad can't create the region or
+ * we can't map it, for example if olad is running as another user. A
+ * connection only gets one region, so this fails if it's called again.
+ * @param universes the universes to send through shared memory
+ * @returns true if the region was set up, false otherwise.
+ */
+bool StreamingClient::SetupSharedMemory(const vector<unsigned int> &universes) {
+  if (!CheckConnection() || m_shared_memory)
+    return false;
+
+  ola::proto::SharedMemoryRequest request;
+  ola::proto::SharedMemoryReply reply;
+  SimpleRpcController controller;
+  for (unsigned int i = 0; i < universes.size(); i++)
+    request.add_input_universes(universes[i]);
+
+  bool done = false;
+  m_stub->SetupSharedMemory(
+      &controller, &request, &reply,
+      google::protobuf::NewCallback(&SetRequestDone, &done));
+  if (!WaitForResponse(&done))
+    return false;
+
+  if (controller.Failed()) {
+    OLA_WARN << "Shared memory setup failed: " << controller.ErrorText();
+    return false;
+  }
+
+  SharedDmxClient *shared_memory = new SharedDmxClient();
+  if (!shared_memory->Open(reply.name(), universes, vector<unsigned int>())) {
+    delete shared_memory;
+    return false;
+  }
+  m_shared_memory = shared_memory;
+  m_shared_memory_frames = 0;
+  return true;
+}
+
+
+/*
+ * Ask olad which encodings it accepts for DmxData. Frames are then sent as
+ * deltas against the last frame for the universe, or run length encoded,
+ * whichever is smaller.
+ * @returns true if frames will be encoded, false if olad doesn't support it
+ *   or the connection failed.
+ */
+bool StreamingClient::SetupEncoding() {
+  if (!CheckConnection())
+    return false;
+
+  // we don't receive frames, so there's nothing to put in the request
+  ola::proto::DmxEncodingRequest request;
+  ola::proto::DmxEncodingReply reply;
+  SimpleRpcController controller;
+  bool done = false;
+  m_stub->SetDmxEncodings(
+      &controller, &request, &reply,
+      google::protobuf::NewCallback(&SetRequestDone, &done));
+  if (!WaitForResponse(&done))
+    return false;
+
+  if (controller.Failed()) {
+    OLA_INFO << "olad doesn't support encoded frames: " <<
+      controller.ErrorText();
+    return false;
+  }
+
+  delete m_encoder;
+  m_encoder = new DmxFrameEncoder();
+  for (int i = 0; i < reply.encodings_size(); i++)
+    m_encoder->EnableEncoding(static_cast<dmx_encoding>(reply.encodings(i)));
+  return true;
+}
+
+
 /*
  * Called when the socket is closed
  */
@@ -158,4 +337,108 @@ void StreamingClient::SocketClosed() {
   OLA_WARN << "The RPC socket has been closed, this is more than likely due"
     << " to a framing error, perhaps you're sending too fast?";
 }
+
+
+/*
+ * Called after frames are written to shared memory. olad is only told about
+ * them if it's armed the doorbell, and the connection is only checked now and
+ * again, so a stream of frames doesn't need any system calls.
+ * @returns false if the connection has been closed.
+ */
+bool StreamingClient::SharedMemoryWritten() {
+  bool ring_doorbell = m_shared_memory->TakeDoorbell();
+  if (!ring_doorbell &&
+      ++m_shared_memory_frames < SHARED_MEMORY_CHECK_INTERVAL)
+    return true;
+
+  m_shared_memory_frames = 0;
+  if (!CheckConnection())
+    return false;
+
+  if (ring_doorbell) {
+    ola::proto::SharedMemoryDoorbell doorbell;
+    m_stub->RingSharedMemoryDoorbell(NULL, &doorbell, NULL, NULL);
+    if (m_socket_closed) {
+      Stop();
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/*
+ * Run the SelectServer until a request completes.
+ * @param done set to true once the request completes
+ * @returns true if the request completed, false if the connection was closed
+ *   or olad didn't respond in time.
+ */
+bool StreamingClient::WaitForResponse(const bool *done) {
+  Clock clock;
+  TimeStamp now, deadline;
+  clock.CurrentTime(&now);
+  deadline = now + TimeInterval(REQUEST_TIMEOUT_MS * 1000);
+  while (!*done && !m_socket_closed && now < deadline) {
+    m_ss->RunOnce(0, 10000);
+    clock.CurrentTime(&now);
+  }
+
+  if (m_socket_closed) {
+    Stop();
+    return false;
+  }
+  if (!*done) {
+    // the channel still has the request, the connection can't be reused
+    OLA_WARN << "Timed out waiting for a response from olad";
+    Stop();
+    return false;
+  }
+  return true;
+}
+
+
+/*
+ * Set the frame in a DmxData message, encoding it if we can.
+ */
+void StreamingClient::SetFrame(ola::proto::DmxData *request,
+                               unsigned int universe,
+                               const DmxBuffer &data) {
+  request->set_universe(universe);
+  if (!m_encoder) {
+    request->set_data(data.GetRaw(), data.Size());
+    return;
+  }
+
+  const uint8_t *encoded_data;
+  unsigned int length;
+  dmx_encoding encoding = m_encoder->Encode(universe, data, &encoded_data,
+                                            &length);
+  request->set_data(encoded_data, length);
+  if (encoding != DMX_ENCODING_RAW) {
+    request->set_encoding(static_cast<ola::proto::DmxEncoding>(encoding));
+    request->set_length(data.Size());
+  }
+}
+
+
+/*
+ * Check the connection is still open before sending.
+ * @returns false if the connection has been closed.
+ */
+bool StreamingClient::CheckConnection() {
+  if (!m_stub || !m_socket->ValidReadDescriptor())
+    return false;
+
+  // We select() on the fd here to see if the remove end has closed the
+  // connection. We could skip this and rely on the EPIPE delivered by the
+  // write() below, but that introduces a race condition in the unittests.
+  m_socket_closed = false;
+  m_ss->RunOnce(0, 0);
+
+  if (m_socket_closed) {
+    Stop();
+    return false;
+  }
+  return true;
+}
 }  // ola
@@ -25,17 +25,24 @@
 #ifndef OLA_STREAMINGCLIENT_H_
 #define OLA_STREAMINGCLIENT_H_
 
+#include <ola/DmxBatch.h>
 #include <ola/DmxBuffer.h>
 #include <ola/network/Socket.h>
 #include <ola/network/SelectServer.h>
+#include <vector>
 
 namespace ola {
 
+class DmxFrameEncoder;
+class SharedDmxClient;
+
 namespace rpc {
   class StreamRpcChannel;
 }
 
 namespace proto {
+  class DmxData;
+  class DmxDataBatch;
   class OlaServerService_Stub;
 }
 
@@ -54,18 +61,49 @@ class StreamingClient {
     void Stop();
 
     bool SendDmx(unsigned int universe, const DmxBuffer &data);
+    bool SendDmx(unsigned int universe,
+                 const DmxBuffer &data,
+                 const DmxBuffer &slot_priorities);
+    bool SendDmxBatch(const DmxBatch &batch);
     void SocketClosed();
 
+    // Send the frames for these universes through shared memory. Frames with
+    // slot priorities still go over the connection.
+    bool SetupSharedMemory(const std::vector<unsigned int> &universes);
+    // Compress the frames sent, if olad supports it. This lasts until the
+    // connection is closed.
+    bool SetupEncoding();
+
   private:
     StreamingClient(const StreamingClient&);
     StreamingClient operator=(const StreamingClient&);
 
+    bool CheckConnection();
+    bool WaitForResponse(const bool *done);
+    bool SharedMemoryWritten();
+    void SetFrame(ola::proto::DmxData *request,
+                  unsigned int universe,
+                  const DmxBuffer &data);
+
     bool m_auto_start;
     TcpSocket *m_socket;
     SelectServer *m_ss;
     class ola::rpc::StreamRpcChannel *m_channel;
     class ola::proto::OlaServerService_Stub *m_stub;
+    // reused for each batch
+    class ola::proto::DmxDataBatch *m_batch_request;
+    // the entries in a batch that weren't written to shared memory
+    std::vector<unsigned int> m_batch_entries;
     bool m_socket_closed;
+    SharedDmxClient *m_shared_memory;
+    // frames written to shared memory since the connection was checked
+    unsigned int m_shared_memory_frames;
+    DmxFrameEncoder *m_encoder;
+
+    // how long to wait for olad to respond to a request
+    static const unsigned int REQUEST_TIMEOUT_MS = 2000;
+    // how many shared memory frames to write between connection checks
+    static const unsigned int SHARED_MEMORY_CHECK_INTERVAL = 100;
 };
 }  // ola
 #endif  // OLA_STREAMINGCLIENT_H_
@@ -19,10 +19,14 @@
  */
 
 #include <cppunit/extensions/HelperMacros.h>
+#include <unistd.h>
 #include <string>
+#include <vector>
 
 #include "ola/StreamingClient.h"
+#include "ola/DmxBatch.h"
 #include "ola/DmxBuffer.h"
+#include "ola/OlaClientWrapper.h"
 #include "ola/thread/Thread.h"
 #include "ola/Logging.h"
 #include "olad/OlaDaemon.h"
@@ -38,12 +42,18 @@ using ola::OlaDaemon;
 class StreamingClientTest: public CppUnit::TestFixture {
   CPPUNIT_TEST_SUITE(StreamingClientTest);
   CPPUNIT_TEST(testSendDMX);
+  CPPUNIT_TEST(testSharedMemory);
+  CPPUNIT_TEST(testEncoding);
+  CPPUNIT_TEST(testBlockedOutput);
   CPPUNIT_TEST_SUITE_END();
 
   public:
     void setUp();
     void tearDown();
     void testSendDMX();
+    void testSharedMemory();
+    void testEncoding();
+    void testBlockedOutput();
 
   private:
     class OlaServerThread *m_server_thread;
@@ -61,21 +71,27 @@ class OlaServerThread: public ola::thread::Thread {
     OlaServerThread() :
         Thread(),
         m_olad(NULL),
-        m_is_running(false) {
+        m_is_running(false),
+        m_is_paused(false) {
     }
     ~OlaServerThread();
     bool Setup();
     void *Run();
     void Terminate();
     void WaitForStart();
+    void Pause();
+    void Resume();
 
   private:
     OlaDaemon *m_olad;
     bool m_is_running;
+    bool m_is_paused;
     Mutex m_mutex;
     ConditionVariable m_condition;
+    ConditionVariable m_pause_condition;
 
     void MarkAsStarted();
+    void Paused();
 };
 
 
@@ -94,6 +110,8 @@ bool OlaServerThread::Setup() {
   ola_options.http_enable_quit = false;
   ola_options.http_port = 0;
   ola_options.http_data_dir = "";
+  ola_options.use_epoll = false;
+  ola_options.plugin_threads = 0;
 
   m_olad = new OlaDaemon(ola_options);
   if (!m_olad->Init()) {
@@ -147,6 +165,60 @@ void OlaServerThread::MarkAsStarted() {
 }
 
 
+/**
+ * Block the OLA Server until Resume() is called, it doesn't read from any
+ * clients while paused.
+ */
+void OlaServerThread::Pause() {
+  m_olad->GetSelectServer()->Execute(
+      ola::NewSingleCallback(this, &OlaServerThread::Paused));
+  m_mutex.Lock();
+  while (!m_is_paused)
+    m_pause_condition.Wait(&m_mutex);
+  m_mutex.Unlock();
+}
+
+
+void OlaServerThread::Resume() {
+  m_mutex.Lock();
+  m_is_paused = false;
+  m_mutex.Unlock();
+  m_pause_condition.Broadcast();
+}
+
+
+void OlaServerThread::Paused() {
+  m_mutex.Lock();
+  m_is_paused = true;
+  m_pause_condition.Broadcast();
+  while (m_is_paused)
+    m_pause_condition.Wait(&m_mutex);
+  m_mutex.Unlock();
+}
+
+
+/*
+ * Called when a request to the OLA Server completes.
+ */
+static void RequestComplete(ola::network::SelectServer *ss,
+                            const std::string&) {
+  ss->Terminate();
+}
+
+
+/*
+ * Store the DMX data fetched from the OLA Server.
+ */
+static void FetchedDmx(ola::network::SelectServer *ss,
+                       ola::DmxBuffer *result,
+                       const ola::DmxBuffer &data,
+                       const std::string &error) {
+  if (error.empty())
+    result->Set(data);
+  ss->Terminate();
+}
+
+
 /*
  * Startup the Ola server
  */
@@ -186,6 +258,11 @@ void StreamingClientTest::testSendDMX() {
   CPPUNIT_ASSERT(!ola_client.Setup());
 
   CPPUNIT_ASSERT(ola_client.SendDmx(TEST_UNIVERSE, buffer));
+
+  ola::DmxBatch batch;
+  batch.Add(TEST_UNIVERSE, buffer);
+  batch.Add(TEST_UNIVERSE + 1, buffer, 150);
+  CPPUNIT_ASSERT(ola_client.SendDmxBatch(batch));
   ola_client.Stop();
 
   // Now reconnect
@@ -204,3 +281,127 @@ void StreamingClientTest::testSendDMX() {
 
   CPPUNIT_ASSERT(!ola_client.Setup());
 }
+
+
+/*
+ * Check sending through shared memory.
+ */
+void StreamingClientTest::testSharedMemory() {
+  m_server_thread->WaitForStart();
+  ola::StreamingClient ola_client(false);
+
+  ola::DmxBuffer buffer;
+  buffer.Blackout();
+
+  std::vector<unsigned int> universes;
+  universes.push_back(TEST_UNIVERSE);
+  CPPUNIT_ASSERT(!ola_client.SetupSharedMemory(universes));
+  CPPUNIT_ASSERT(ola_client.Setup());
+  CPPUNIT_ASSERT(ola_client.SetupSharedMemory(universes));
+
+  for (unsigned int i = 0; i < 1000; i++) {
+    buffer.SetChannel(0, i);
+    CPPUNIT_ASSERT(ola_client.SendDmx(TEST_UNIVERSE, buffer));
+  }
+
+  // the universe without a slot goes over the connection
+  ola::DmxBatch batch;
+  batch.Add(TEST_UNIVERSE, buffer);
+  batch.Add(TEST_UNIVERSE + 1, buffer, 150);
+  CPPUNIT_ASSERT(ola_client.SendDmxBatch(batch));
+
+  // the connection is still checked every so often
+  m_server_thread->Terminate();
+  m_server_thread->Join();
+  bool sent = true;
+  for (unsigned int i = 0; i < 1000 && sent; i++)
+    sent = ola_client.SendDmx(TEST_UNIVERSE, buffer);
+  CPPUNIT_ASSERT(!sent);
+  ola_client.Stop();
+}
+
+
+/*
+ * Check sending encoded frames.
+ */
+void StreamingClientTest::testEncoding() {
+  m_server_thread->WaitForStart();
+  ola::StreamingClient ola_client(false);
+
+  ola::DmxBuffer buffer;
+  buffer.Blackout();
+
+  CPPUNIT_ASSERT(!ola_client.SetupEncoding());
+  CPPUNIT_ASSERT(ola_client.Setup());
+  CPPUNIT_ASSERT(ola_client.SetupEncoding());
+
+  for (unsigned int i = 0; i < 100; i++) {
+    buffer.SetChannel(i, i);
+    CPPUNIT_ASSERT(ola_client.SendDmx(TEST_UNIVERSE, buffer));
+  }
+
+  ola::DmxBatch batch;
+  batch.Add(TEST_UNIVERSE, buffer);
+  batch.Add(TEST_UNIVERSE + 1, buffer, 150);
+  CPPUNIT_ASSERT(ola_client.SendDmxBatch(batch));
+  CPPUNIT_ASSERT(ola_client.SendDmxBatch(batch));
+
+  // the encoding is dropped with the connection
+  ola_client.Stop();
+  CPPUNIT_ASSERT(ola_client.Setup());
+  CPPUNIT_ASSERT(ola_client.SendDmx(TEST_UNIVERSE, buffer));
+  ola_client.Stop();
+}
+
+
+/*
+ * Check that the frames dropped while the connection is blocked don't break
+ * the encoding.
+ */
+void StreamingClientTest::testBlockedOutput() {
+  m_server_thread->WaitForStart();
+  // this client creates the universe and reads it back
+  ola::OlaCallbackClientWrapper wrapper(false);
+  CPPUNIT_ASSERT(wrapper.Setup());
+  ola::network::SelectServer *ss = wrapper.GetSelectServer();
+  wrapper.GetClient()->RegisterUniverse(
+      TEST_UNIVERSE,
+      ola::REGISTER,
+      ola::NewSingleCallback(&RequestComplete, ss));
+  ss->Run();
+
+  ola::StreamingClient ola_client(false);
+  CPPUNIT_ASSERT(ola_client.Setup());
+  CPPUNIT_ASSERT(ola_client.SetupEncoding());
+
+  // neighbouring channels differ so the frames are sent as deltas
+  uint8_t data[DMX_UNIVERSE_SIZE];
+  for (unsigned int i = 0; i < DMX_UNIVERSE_SIZE; i++)
+    data[i] = i * 7;
+  ola::DmxBuffer buffer(data, sizeof(data));
+  CPPUNIT_ASSERT(ola_client.SendDmx(TEST_UNIVERSE, buffer));
+
+  // fill the connection, the later frames are dropped by the client
+  m_server_thread->Pause();
+  for (unsigned int i = 0; i < 100000; i++) {
+    for (unsigned int j = 0; j < 256; j++)
+      data[j] = i + j * 7;
+    buffer.SetRange(0, data, 256);
+    CPPUNIT_ASSERT(ola_client.SendDmx(TEST_UNIVERSE, buffer));
+  }
+  m_server_thread->Resume();
+
+  // this only differs from the last dropped frame in the last channel
+  buffer.SetChannel(DMX_UNIVERSE_SIZE - 1, 0);
+  ola::DmxBuffer received;
+  for (unsigned int i = 0; i < 200 && !(received == buffer); i++) {
+    CPPUNIT_ASSERT(ola_client.SendDmx(TEST_UNIVERSE, buffer));
+    wrapper.GetClient()->FetchDmx(
+        TEST_UNIVERSE,
+        ola::NewSingleCallback(&FetchedDmx, ss, &received));
+    ss->Run();
+    usleep(10000);
+  }
+  CPPUNIT_ASSERT(buffer == received);
+  ola_client.Stop();
+}
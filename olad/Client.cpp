@@ -20,55 +20,188 @@
 
 #include <google/protobuf/stubs/common.h>
 #include <map>
+#include <vector>
 #include "common/protocol/Ola.pb.h"
+#include "common/rpc/StreamRpcChannel.h"
 #include "ola/Logging.h"
 #include "olad/Client.h"
+#include "olad/ClientSharedMemory.h"
 
 namespace ola {
 
-using google::protobuf::NewCallback;
+using google::protobuf::NewPermanentCallback;
 using ola::rpc::SimpleRpcController;
+using ola::thread::INVALID_TIMEOUT;
+using ola::thread::timeout_id;
+
+const DmxSource Client::EMPTY_SOURCE;
+const char Client::K_CLIENT_LABEL[] = "client";
+const char Client::K_FRAMES_DROPPED_VAR[] = "client-frames-dropped";
+const char Client::K_FRAMES_PUSHED_VAR[] = "client-frames-pushed";
+
+
+/*
+ * The push state for a universe the client has registered for. The request,
+ * controller, ack & callback are reused for every frame.
+ */
+class Client::SinkState {
+  public:
+    SinkState()
+        : streaming(false),
+          pending(false),
+          in_flight(false),
+          timeout(INVALID_TIMEOUT),
+          callback(NULL) {
+    }
+    ~SinkState() { delete callback; }
+
+    bool streaming;
+    TimeInterval min_interval;  // zero means no limit
+    TimeStamp last_sent;
+    bool pending;  // true if frame hasn't been sent yet
+    bool in_flight;  // true if we're waiting for an ack
+    timeout_id timeout;
+    DmxBuffer frame;
+    ola::proto::DmxData request;
+    SimpleRpcController controller;
+    ola::proto::Ack ack;
+    google::protobuf::Closure *callback;
+};
+
+
+Client::Client(OlaClientService_Stub *client_stub)
+    : m_client_stub(client_stub),
+      m_channel(NULL),
+      m_scheduler(NULL),
+      m_export_map(NULL),
+      m_client_id(0),
+      m_frames_dropped(NULL),
+      m_frames_pushed(NULL),
+      m_shared_memory(NULL) {
+}
+
+
+Client::Client(OlaClientService_Stub *client_stub,
+               ola::rpc::StreamRpcChannel *channel,
+               ola::thread::SchedulerInterface *scheduler,
+               ExportMap *export_map,
+               unsigned int client_id)
+    : m_client_stub(client_stub),
+      m_channel(channel),
+      m_scheduler(scheduler),
+      m_export_map(export_map),
+      m_client_id(client_id),
+      m_frames_dropped(NULL),
+      m_frames_pushed(NULL),
+      m_shared_memory(NULL) {
+  if (m_export_map) {
+    m_frames_dropped = &(*m_export_map->GetUIntIndexedMapVar(
+        K_FRAMES_DROPPED_VAR, K_CLIENT_LABEL))[m_client_id];
+    m_frames_pushed = &(*m_export_map->GetUIntIndexedMapVar(
+        K_FRAMES_PUSHED_VAR, K_CLIENT_LABEL))[m_client_id];
+  }
+}
+
 
 Client::~Client() {
+  delete m_shared_memory;
+  sink_map::iterator iter = m_sinks.begin();
+  for (; iter != m_sinks.end(); ++iter) {
+    if (iter->second->timeout != INVALID_TIMEOUT)
+      m_scheduler->RemoveTimeout(iter->second->timeout);
+    delete iter->second;
+  }
+  m_sinks.clear();
   m_data_map.clear();
+
+  if (m_export_map) {
+    m_export_map->GetUIntIndexedMapVar(K_FRAMES_DROPPED_VAR)->Remove(
+        m_client_id);
+    m_export_map->GetUIntIndexedMapVar(K_FRAMES_PUSHED_VAR)->Remove(
+        m_client_id);
+  }
 }
 
 
 /*
- * Send a DMX Update to this client
+ * Send a DMX Update to this client. If the previous frame for this universe
+ * is still waiting to be sent it's dropped.
  * @param universe the universe_id for this data
  * @param buffer the DmxBuffer with the data
- * @return true if the update was sent, false otherwise
+ * @return true if the update was sent or queued, false otherwise
  */
 bool Client::SendDMX(unsigned int universe, const DmxBuffer &buffer) {
+  if (m_shared_memory && m_shared_memory->WriteOutput(universe, buffer)) {
+    if (m_frames_pushed)
+      (*m_frames_pushed)++;
+    return true;
+  }
+
   if (!m_client_stub) {
     OLA_FATAL << "client_stub is null";
     return false;
   }
 
-  SimpleRpcController *controller = new SimpleRpcController();
-  ola::proto::DmxData dmx_data;
-  ola::proto::Ack *ack = new ola::proto::Ack();
-
-  dmx_data.set_universe(universe);
-  dmx_data.set_data(buffer.Get());
+  SinkState *sink = GetSink(universe);
+  if (sink->pending && m_frames_dropped)
+    (*m_frames_dropped)++;
+  sink->frame = buffer;
+  sink->pending = true;
 
-  m_client_stub->UpdateDmxData(
-      controller,
-      &dmx_data,
-      ack,
-      NewCallback(this, &ola::Client::SendDMXCallback, controller, ack));
+  // if there's a timeout the frame goes out when it triggers
+  if (sink->timeout == INVALID_TIMEOUT)
+    Push(universe, sink, false);
   return true;
 }
 
 
 /*
- * Called when UpdateDmxData completes
+ * Set how frames are pushed for a universe.
+ * @param universe_id the universe to set the options for
+ * @param streaming true to push frames without waiting for an ack
+ * @param max_rate the max frames per second to push, 0 means no limit. This
+ *   requires a scheduler.
  */
-void Client::SendDMXCallback(SimpleRpcController *controller,
-                             ola::proto::Ack *reply) {
-  delete controller;
-  delete reply;
+void Client::SetSinkOptions(unsigned int universe_id,
+                            bool streaming,
+                            unsigned int max_rate) {
+  SinkState *sink = GetSink(universe_id);
+  sink->streaming = streaming;
+  sink->min_interval = max_rate ?
+    TimeInterval(USEC_IN_SECONDS / max_rate) : TimeInterval();
+}
+
+
+/*
+ * Called when the client unregisters from a universe. The state is kept
+ * around since there may be an ack outstanding.
+ */
+void Client::RemoveSink(unsigned int universe_id) {
+  sink_map::iterator iter = m_sinks.find(universe_id);
+  if (iter == m_sinks.end())
+    return;
+
+  SinkState *sink = iter->second;
+  if (sink->timeout != INVALID_TIMEOUT) {
+    m_scheduler->RemoveTimeout(sink->timeout);
+    sink->timeout = INVALID_TIMEOUT;
+  }
+  sink->pending = false;
+  sink->streaming = false;
+  sink->min_interval = TimeInterval();
+}
+
+
+/*
+ * Set the encodings that can be used for frames pushed to this client. Deltas
+ * start from the next frame pushed for each universe.
+ * @param encodings the encodings the client can decode
+ */
+void Client::SetPushEncodings(const std::vector<dmx_encoding> &encodings) {
+  m_encoder.DisableEncodings();
+  std::vector<dmx_encoding>::const_iterator iter = encodings.begin();
+  for (; iter != encodings.end(); ++iter)
+    m_encoder.EnableEncoding(*iter);
 }
 
 
@@ -89,19 +222,150 @@ void Client::DMXRecieved(unsigned int universe, const DmxSource &source) {
 }
 
 
+/*
+ * Get the DmxSource for a universe so it can be updated in place, this creates
+ * the source if it doesn't exist.
+ * @param universe the id of the universe
+ */
+DmxSource *Client::MutableSourceData(unsigned int universe) {
+  return &m_data_map[universe];
+}
+
+
+/*
+ * Set the shared memory region for this client.
+ */
+void Client::SetSharedMemory(ClientSharedMemory *shared_memory) {
+  delete m_shared_memory;
+  m_shared_memory = shared_memory;
+}
+
+
 /*
  * Return the last dmx data sent by this client
  * @param universe the id of the universe we're interested in
  */
-const DmxSource Client::SourceData(unsigned int universe) const {
+const DmxSource &Client::SourceData(unsigned int universe) const {
   map<unsigned int, DmxSource>::const_iterator iter =
     m_data_map.find(universe);
 
-  if (iter != m_data_map.end()) {
+  if (iter != m_data_map.end())
+    return iter->second;
+  return EMPTY_SOURCE;
+}
+
+
+/*
+ * Get the push state for a universe, creating it if it doesn't exist.
+ */
+Client::SinkState *Client::GetSink(unsigned int universe_id) {
+  sink_map::iterator iter = m_sinks.find(universe_id);
+  if (iter != m_sinks.end())
     return iter->second;
+
+  SinkState *sink = new SinkState();
+  sink->callback = NewPermanentCallback(this, &Client::SendDMXCallback,
+                                        universe_id);
+  m_sinks[universe_id] = sink;
+  return sink;
+}
+
+
+/*
+ * Send the pending frame for a universe, if we can.
+ * @param universe_id the universe the frame is for
+ * @param sink the SinkState for the universe
+ * @param ignore_rate true if the rate limit has already been checked
+ */
+void Client::Push(unsigned int universe_id, SinkState *sink,
+                  bool ignore_rate) {
+  // acked pushes wait for the ack of the previous frame
+  if (!sink->pending || sink->in_flight)
+    return;
+
+  TimeStamp now;
+  m_clock.CurrentTime(&now);
+  if (m_scheduler && !ignore_rate && sink->min_interval > TimeInterval() &&
+      sink->last_sent.IsSet()) {
+    TimeStamp next_push = sink->last_sent + sink->min_interval;
+    if (now < next_push) {
+      // round up so we don't exceed the rate
+      int64_t delay = (next_push - now).AsInt();
+      SchedulePush(universe_id, sink, static_cast<unsigned int>(
+          (delay + ONE_THOUSAND - 1) / ONE_THOUSAND));
+      return;
+    }
+  }
+
+  if (sink->streaming && m_channel && m_channel->OutputBlocked()) {
+    // the frame stays pending, if another one arrives first this one is
+    // dropped.
+    if (m_scheduler)
+      SchedulePush(universe_id, sink, BLOCKED_RETRY_INTERVAL);
+    return;
+  }
+
+  const uint8_t *data;
+  unsigned int length;
+  dmx_encoding encoding = m_encoder.Encode(universe_id, sink->frame, &data,
+                                           &length);
+  sink->request.set_universe(universe_id);
+  sink->request.set_data(data, length);
+  if (encoding == DMX_ENCODING_RAW) {
+    sink->request.clear_encoding();
+    sink->request.clear_length();
+  } else {
+    sink->request.set_encoding(
+        static_cast<ola::proto::DmxEncoding>(encoding));
+    sink->request.set_length(sink->frame.Size());
+  }
+  sink->pending = false;
+  sink->last_sent = now;
+  if (m_frames_pushed)
+    (*m_frames_pushed)++;
+
+  if (sink->streaming) {
+    m_client_stub->StreamDmxData(NULL, &sink->request, NULL, NULL);
   } else {
-    DmxSource source;
-    return source;
+    sink->in_flight = true;
+    sink->controller.Reset();
+    m_client_stub->UpdateDmxData(&sink->controller, &sink->request,
+                                 &sink->ack, sink->callback);
   }
 }
+
+
+void Client::SchedulePush(unsigned int universe_id, SinkState *sink,
+                          unsigned int delay_ms) {
+  sink->timeout = m_scheduler->RegisterSingleTimeout(
+      delay_ms,
+      NewSingleCallback(this, &Client::PushTimeout, universe_id));
+}
+
+
+/*
+ * Called when it's time to push a rate limited or blocked frame.
+ */
+void Client::PushTimeout(unsigned int universe_id) {
+  sink_map::iterator iter = m_sinks.find(universe_id);
+  if (iter == m_sinks.end())
+    return;
+  iter->second->timeout = INVALID_TIMEOUT;
+  Push(universe_id, iter->second, true);
+}
+
+
+/*
+ * Called when UpdateDmxData completes, send the latest frame if there is one.
+ */
+void Client::SendDMXCallback(unsigned int universe_id) {
+  sink_map::iterator iter = m_sinks.find(universe_id);
+  if (iter == m_sinks.end())
+    return;
+
+  SinkState *sink = iter->second;
+  sink->in_flight = false;
+  if (sink->timeout == INVALID_TIMEOUT)
+    Push(universe_id, sink, false);
+}
 }  // ola
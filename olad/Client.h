@@ -22,7 +22,12 @@
 #define OLAD_CLIENT_H_
 
 #include <map>
+#include <vector>
 #include "common/rpc/SimpleRpcController.h"
+#include "common/utils/DmxFrameEncoder.h"
+#include "ola/Clock.h"
+#include "ola/ExportMap.h"
+#include "ola/thread/SchedulerInterface.h"
 #include "olad/DmxSource.h"
 
 namespace ola {
@@ -30,6 +35,9 @@ namespace proto {
   class OlaClientService_Stub;
   class Ack;
 }
+namespace rpc {
+  class StreamRpcChannel;
+}
 }
 
 namespace ola {
@@ -37,25 +45,80 @@ namespace ola {
 using std::map;
 using ola::proto::OlaClientService_Stub;
 
+/*
+ * A connected client.
+ *
+ * Frames for universes the client has registered for are pushed with
+ * SendDMX. Only the latest frame for each universe is kept: if the previous
+ * frame hasn't been sent yet, because the client hasn't acked the one before
+ * it, the max rate would be exceeded or the connection is backed up, it's
+ * replaced and counted as dropped. Universes with a slot in the client's
+ * shared memory are written there instead.
+ */
 class Client {
   public :
-    explicit Client(OlaClientService_Stub *client_stub):
-      m_client_stub(client_stub) {}
+    explicit Client(OlaClientService_Stub *client_stub);
+    // The scheduler is used for the rate limits & to retry blocked pushes.
+    // The client_id keys the client's stats in the export map.
+    Client(OlaClientService_Stub *client_stub,
+           ola::rpc::StreamRpcChannel *channel,
+           ola::thread::SchedulerInterface *scheduler,
+           ExportMap *export_map,
+           unsigned int client_id);
     virtual ~Client();
     virtual bool SendDMX(unsigned int universe_id, const DmxBuffer &buffer);
 
-    void SendDMXCallback(ola::rpc::SimpleRpcController *controller,
-                         ola::proto::Ack *ack);
+    void SetSinkOptions(unsigned int universe_id,
+                        bool streaming,
+                        unsigned int max_rate);
+    void RemoveSink(unsigned int universe_id);
+    // The encodings the client can decode, frames are pushed as is until this
+    // is called.
+    void SetPushEncodings(const std::vector<dmx_encoding> &encodings);
+
     void DMXRecieved(unsigned int universe, const DmxSource &source);
-    const DmxSource SourceData(unsigned int universe) const;
+    const DmxSource &SourceData(unsigned int universe) const;
+    DmxSource *MutableSourceData(unsigned int universe);
     class OlaClientService_Stub *Stub() const { return m_client_stub; }
 
+    // Takes ownership of the shared memory, replacing any existing region.
+    void SetSharedMemory(class ClientSharedMemory *shared_memory);
+    class ClientSharedMemory *SharedMemory() const { return m_shared_memory; }
+
+    static const char K_FRAMES_DROPPED_VAR[];
+    static const char K_FRAMES_PUSHED_VAR[];
+
   private:
+    class SinkState;
+    typedef map<unsigned int, SinkState*> sink_map;
+
     Client(const Client&);
     Client& operator=(const Client&);
 
     class OlaClientService_Stub *m_client_stub;
+    ola::rpc::StreamRpcChannel *m_channel;
+    ola::thread::SchedulerInterface *m_scheduler;
+    ExportMap *m_export_map;
+    unsigned int m_client_id;
+    unsigned int *m_frames_dropped;
+    unsigned int *m_frames_pushed;
     map<unsigned int, DmxSource> m_data_map;
+    sink_map m_sinks;
+    class ClientSharedMemory *m_shared_memory;
+    DmxFrameEncoder m_encoder;
+    Clock m_clock;
+
+    SinkState *GetSink(unsigned int universe_id);
+    void Push(unsigned int universe_id, SinkState *sink, bool ignore_rate);
+    void SchedulePush(unsigned int universe_id, SinkState *sink,
+                      unsigned int delay_ms);
+    void PushTimeout(unsigned int universe_id);
+    void SendDMXCallback(unsigned int universe_id);
+
+    static const DmxSource EMPTY_SOURCE;
+    static const char K_CLIENT_LABEL[];
+    // how long to wait before retrying a push to a blocked client
+    static const unsigned int BLOCKED_RETRY_INTERVAL = 20;
 };
 }  // ola
 #endif  // OLAD_CLIENT_H_
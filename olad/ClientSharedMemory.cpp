@@ -0,0 +1,120 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * ClientSharedMemory.cpp
+ * The shared memory region olad creates for a client.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <algorithm>
+#include <vector>
+#include "olad/Client.h"
+#include "olad/ClientSharedMemory.h"
+#include "olad/DmxSource.h"
+#include "olad/Universe.h"
+#include "olad/UniverseStore.h"
+
+namespace ola {
+
+using std::vector;
+
+
+ClientSharedMemory::ClientSharedMemory(Client *client,
+                                       UniverseStore *universe_store,
+                                       const TimeStamp *wake_up_time)
+    : m_client(client),
+      m_universe_store(universe_store),
+      m_wake_up_time(wake_up_time) {
+}
+
+
+ClientSharedMemory::~ClientSharedMemory() {
+  m_region.Unlink();
+}
+
+
+/*
+ * Create the region.
+ * @param input_universes the universes the client sends data for
+ * @param output_universes the universes the client receives data for
+ * @returns true if the region was created, false otherwise
+ */
+bool ClientSharedMemory::Setup(const vector<unsigned int> &input_universes,
+                               const vector<unsigned int> &output_universes) {
+  if (!m_region.Create(input_universes.size() + output_universes.size()))
+    return false;
+
+  m_inputs = input_universes;
+  m_input_sequences.assign(m_inputs.size(), 0);
+  m_output_slots.clear();
+  for (unsigned int i = 0; i < output_universes.size(); i++) {
+    m_output_slots.insert(slot_map::value_type(output_universes[i],
+                                               m_inputs.size() + i));
+  }
+  m_region.ArmDoorbell();
+  return true;
+}
+
+
+/*
+ * Apply any new frames the client has written. Like a DmxDataBatch, every
+ * frame is applied before any of the universes are merged.
+ */
+void ClientSharedMemory::ReadInputs() {
+  // arm first, so a frame written after we've looked at its slot rings
+  m_region.ArmDoorbell();
+
+  m_changed_universes.clear();
+  bool has_priority;
+  uint8_t priority;
+  for (unsigned int i = 0; i < m_inputs.size(); i++) {
+    if (!m_region.Read(i, &m_input_sequences[i], &m_buffer, &has_priority,
+                       &priority))
+      continue;
+
+    Universe *universe = m_universe_store->GetUniverse(m_inputs[i]);
+    if (!universe)
+      continue;
+
+    if (has_priority) {
+      priority = std::max(DmxSource::PRIORITY_MIN, priority);
+      priority = std::min(DmxSource::PRIORITY_MAX, priority);
+    } else {
+      priority = DmxSource::PRIORITY_DEFAULT;
+    }
+    m_client->MutableSourceData(m_inputs[i])->UpdateData(
+        m_buffer, *m_wake_up_time, priority);
+    m_changed_universes.push_back(universe);
+  }
+
+  vector<Universe*>::iterator iter = m_changed_universes.begin();
+  for (; iter != m_changed_universes.end(); ++iter)
+    (*iter)->SourceClientDataChanged(m_client);
+}
+
+
+/*
+ * Write a frame for an output universe.
+ * @returns true if the universe has a slot, false otherwise
+ */
+bool ClientSharedMemory::WriteOutput(unsigned int universe_id,
+                                     const DmxBuffer &buffer) {
+  slot_map::const_iterator iter = m_output_slots.find(universe_id);
+  if (iter == m_output_slots.end())
+    return false;
+  m_region.Write(iter->second, buffer);
+  return true;
+}
+}  // ola
@@ -0,0 +1,70 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * ClientSharedMemory.h
+ * The shared memory region olad creates for a client.
+ * Copyright (C) 2012 Simon Newton
+ *
+ * The client writes frames for its input universes to the region and olad
+ * reads them each time around the select loop, or as soon as the client rings
+ * the doorbell. Frames for the output universes are written to the region
+ * instead of being pushed over the RPC connection.
+ */
+
+#ifndef OLAD_CLIENTSHAREDMEMORY_H_
+#define OLAD_CLIENTSHAREDMEMORY_H_
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "common/utils/SharedDmxRegion.h"
+#include "ola/Clock.h"
+#include "ola/DmxBuffer.h"
+
+namespace ola {
+
+class ClientSharedMemory {
+  public:
+    ClientSharedMemory(class Client *client,
+                       class UniverseStore *universe_store,
+                       const TimeStamp *wake_up_time);
+    ~ClientSharedMemory();
+
+    bool Setup(const std::vector<unsigned int> &input_universes,
+               const std::vector<unsigned int> &output_universes);
+    const std::string &Name() const { return m_region.Name(); }
+
+    void ReadInputs();
+    bool WriteOutput(unsigned int universe_id, const DmxBuffer &buffer);
+
+  private:
+    typedef std::map<unsigned int, unsigned int> slot_map;
+
+    class Client *m_client;
+    class UniverseStore *m_universe_store;
+    const TimeStamp *m_wake_up_time;
+    SharedDmxRegion m_region;
+    std::vector<unsigned int> m_inputs;
+    std::vector<uint32_t> m_input_sequences;
+    slot_map m_output_slots;
+    std::vector<class Universe*> m_changed_universes;
+    DmxBuffer m_buffer;
+
+    ClientSharedMemory(const ClientSharedMemory&);
+    ClientSharedMemory& operator=(const ClientSharedMemory&);
+};
+}  // ola
+#endif  // OLAD_CLIENTSHAREDMEMORY_H_
@@ -20,9 +20,14 @@
 
 #include <cppunit/extensions/HelperMacros.h>
 #include <string>
+#include <vector>
 
+#include "common/utils/DmxFrameEncoder.h"
+#include "ola/BaseTypes.h"
 #include "ola/Clock.h"
 #include "ola/DmxBuffer.h"
+#include "ola/ExportMap.h"
+#include "ola/thread/SchedulerInterface.h"
 #include "olad/DmxSource.h"
 #include "olad//Client.h"
 #include "common/protocol/Ola.pb.h"
@@ -35,18 +40,27 @@ static const char TEST_DATA2[] = "another set of test data";
 
 using ola::Client;
 using ola::DmxBuffer;
+using ola::ExportMap;
+using ola::thread::timeout_id;
 using std::string;
+using std::vector;
 
 
 class ClientTest: public CppUnit::TestFixture {
   CPPUNIT_TEST_SUITE(ClientTest);
   CPPUNIT_TEST(testSendDMX);
   CPPUNIT_TEST(testGetSetDMX);
+  CPPUNIT_TEST(testAckedPush);
+  CPPUNIT_TEST(testStreamingPush);
+  CPPUNIT_TEST(testEncodedPush);
   CPPUNIT_TEST_SUITE_END();
 
   public:
     void testSendDMX();
     void testGetSetDMX();
+    void testAckedPush();
+    void testStreamingPush();
+    void testEncodedPush();
 
   private:
     ola::Clock m_clock;
@@ -85,6 +99,98 @@ void MockClientStub::UpdateDmxData(
 }
 
 
+/*
+ * A stub which records the frames it's given and holds on to the acks.
+ */
+class RecordingClientStub: public ola::proto::OlaClientService_Stub {
+  public:
+    RecordingClientStub(): ola::proto::OlaClientService_Stub(NULL) {}
+
+    void UpdateDmxData(::google::protobuf::RpcController*,
+                       const ::ola::proto::DmxData* request,
+                       ::ola::proto::Ack*,
+                       ::google::protobuf::Closure* done) {
+      frames.push_back(request->data());
+      encodings.push_back(request->encoding());
+      acks.push_back(done);
+    }
+
+    void StreamDmxData(::google::protobuf::RpcController* controller,
+                       const ::ola::proto::DmxData* request,
+                       ::ola::proto::STREAMING_NO_RESPONSE* response,
+                       ::google::protobuf::Closure* done) {
+      CPPUNIT_ASSERT(!controller);
+      CPPUNIT_ASSERT(!response);
+      CPPUNIT_ASSERT(!done);
+      frames.push_back(request->data());
+      encodings.push_back(request->encoding());
+    }
+
+    // run the oldest outstanding ack
+    void Ack() {
+      CPPUNIT_ASSERT(!acks.empty());
+      ::google::protobuf::Closure *done = acks.front();
+      acks.erase(acks.begin());
+      done->Run();
+    }
+
+    vector<string> frames;
+    vector<ola::proto::DmxEncoding> encodings;
+    vector< ::google::protobuf::Closure*> acks;
+};
+
+
+/*
+ * A scheduler which runs single timeouts when asked.
+ */
+class ManualScheduler: public ola::thread::SchedulerInterface {
+  public:
+    ManualScheduler(): m_closure(NULL), m_delay(0) {}
+    ~ManualScheduler() { delete m_closure; }
+
+    timeout_id RegisterRepeatingTimeout(unsigned int,
+                                        ola::Callback0<bool> *closure) {
+      delete closure;
+      return ola::thread::INVALID_TIMEOUT;
+    }
+
+    timeout_id RegisterRepeatingTimeout(const ola::TimeInterval&,
+                                        ola::Callback0<bool> *closure,
+                                        ola::thread::TimerMode) {
+      delete closure;
+      return ola::thread::INVALID_TIMEOUT;
+    }
+
+    timeout_id RegisterSingleTimeout(unsigned int ms,
+                                     ola::SingleUseCallback0<void> *closure) {
+      CPPUNIT_ASSERT(!m_closure);
+      m_closure = closure;
+      m_delay = ms;
+      return closure;
+    }
+
+    void RemoveTimeout(timeout_id id) {
+      CPPUNIT_ASSERT_EQUAL(static_cast<timeout_id>(m_closure), id);
+      delete m_closure;
+      m_closure = NULL;
+    }
+
+    bool Pending() const { return m_closure; }
+    unsigned int Delay() const { return m_delay; }
+
+    void Run() {
+      CPPUNIT_ASSERT(m_closure);
+      ola::SingleUseCallback0<void> *closure = m_closure;
+      m_closure = NULL;
+      closure->Run();
+    }
+
+  private:
+    ola::SingleUseCallback0<void> *m_closure;
+    unsigned int m_delay;
+};
+
+
 /*
  * Check that the SendDMX method works correctly.
  */
@@ -143,3 +249,144 @@ void ClientTest::testGetSetDMX() {
   CPPUNIT_ASSERT(!source4.IsSet());
   CPPUNIT_ASSERT(empty == source4.Data());
 }
+
+
+/*
+ * Check only one acked push is outstanding per universe and that frames sent
+ * while waiting for the ack are replaced by the latest one.
+ */
+void ClientTest::testAckedPush() {
+  ExportMap export_map;
+  RecordingClientStub stub;
+  const unsigned int client_id = 5;
+  Client *client = new Client(&stub, NULL, NULL, &export_map, client_id);
+  ola::UIntIndexedMap *dropped = export_map.GetUIntIndexedMapVar(
+      Client::K_FRAMES_DROPPED_VAR);
+  ola::UIntIndexedMap *pushed = export_map.GetUIntIndexedMapVar(
+      Client::K_FRAMES_PUSHED_VAR);
+
+  CPPUNIT_ASSERT(client->SendDMX(TEST_UNIVERSE, DmxBuffer("1")));
+  CPPUNIT_ASSERT(client->SendDMX(TEST_UNIVERSE, DmxBuffer("2")));
+  CPPUNIT_ASSERT(client->SendDMX(TEST_UNIVERSE, DmxBuffer("3")));
+  // other universes aren't held up
+  CPPUNIT_ASSERT(client->SendDMX(TEST_UNIVERSE2, DmxBuffer("4")));
+  CPPUNIT_ASSERT_EQUAL((size_t) 2, stub.frames.size());
+  CPPUNIT_ASSERT_EQUAL(string("1"), stub.frames[0]);
+  CPPUNIT_ASSERT_EQUAL(string("4"), stub.frames[1]);
+  CPPUNIT_ASSERT_EQUAL(1u, (*dropped)[client_id]);
+
+  // the ack releases the latest frame
+  stub.Ack();
+  CPPUNIT_ASSERT_EQUAL((size_t) 3, stub.frames.size());
+  CPPUNIT_ASSERT_EQUAL(string("3"), stub.frames[2]);
+  CPPUNIT_ASSERT_EQUAL(3u, (*pushed)[client_id]);
+
+  // nothing is waiting
+  stub.Ack();
+  stub.Ack();
+  CPPUNIT_ASSERT_EQUAL((size_t) 3, stub.frames.size());
+  CPPUNIT_ASSERT_EQUAL(1u, (*dropped)[client_id]);
+
+  // the stats go away with the client
+  delete client;
+  CPPUNIT_ASSERT_EQUAL(string("map:client"), dropped->Value());
+  CPPUNIT_ASSERT_EQUAL(string("map:client"), pushed->Value());
+}
+
+
+/*
+ * Check streamed pushes aren't acked and are rate limited.
+ */
+void ClientTest::testStreamingPush() {
+  ExportMap export_map;
+  RecordingClientStub stub;
+  ManualScheduler scheduler;
+  const unsigned int client_id = 5;
+  Client client(&stub, NULL, &scheduler, &export_map, client_id);
+  ola::UIntIndexedMap *dropped = export_map.GetUIntIndexedMapVar(
+      Client::K_FRAMES_DROPPED_VAR);
+
+  // no rate limit
+  client.SetSinkOptions(TEST_UNIVERSE, true, 0);
+  CPPUNIT_ASSERT(client.SendDMX(TEST_UNIVERSE, DmxBuffer("1")));
+  CPPUNIT_ASSERT(client.SendDMX(TEST_UNIVERSE, DmxBuffer("2")));
+  CPPUNIT_ASSERT_EQUAL((size_t) 2, stub.frames.size());
+  CPPUNIT_ASSERT(stub.acks.empty());
+  CPPUNIT_ASSERT(!scheduler.Pending());
+
+  // 10 frames per second, frames inside the 100ms window are held & replaced
+  client.SetSinkOptions(TEST_UNIVERSE, true, 10);
+  CPPUNIT_ASSERT(client.SendDMX(TEST_UNIVERSE, DmxBuffer("3")));
+  CPPUNIT_ASSERT(client.SendDMX(TEST_UNIVERSE, DmxBuffer("4")));
+  CPPUNIT_ASSERT_EQUAL((size_t) 2, stub.frames.size());
+  CPPUNIT_ASSERT(scheduler.Pending());
+  CPPUNIT_ASSERT(scheduler.Delay() > 0);
+  CPPUNIT_ASSERT(scheduler.Delay() <= 100);
+  CPPUNIT_ASSERT_EQUAL(1u, (*dropped)[client_id]);
+
+  scheduler.Run();
+  CPPUNIT_ASSERT_EQUAL((size_t) 3, stub.frames.size());
+  CPPUNIT_ASSERT_EQUAL(string("4"), stub.frames[2]);
+
+  // unregistering discards the held frame
+  CPPUNIT_ASSERT(client.SendDMX(TEST_UNIVERSE, DmxBuffer("5")));
+  CPPUNIT_ASSERT(scheduler.Pending());
+  client.RemoveSink(TEST_UNIVERSE);
+  CPPUNIT_ASSERT(!scheduler.Pending());
+  CPPUNIT_ASSERT_EQUAL((size_t) 3, stub.frames.size());
+}
+
+
+/*
+ * Check pushed frames are encoded once the client has said it can decode
+ * them.
+ */
+void ClientTest::testEncodedPush() {
+  RecordingClientStub stub;
+  ManualScheduler scheduler;
+  Client client(&stub, NULL, &scheduler, NULL, 0);
+  client.SetSinkOptions(TEST_UNIVERSE, true, 0);
+
+  DmxBuffer frame;
+  frame.Blackout();
+  frame.SetChannel(10, 255);
+  CPPUNIT_ASSERT(client.SendDMX(TEST_UNIVERSE, frame));
+  CPPUNIT_ASSERT_EQUAL(ola::proto::DMX_RAW, stub.encodings[0]);
+
+  vector<ola::dmx_encoding> encodings;
+  encodings.push_back(ola::DMX_ENCODING_RLE);
+  encodings.push_back(ola::DMX_ENCODING_DELTA);
+  client.SetPushEncodings(encodings);
+
+  // the first frame is sent in full
+  CPPUNIT_ASSERT(client.SendDMX(TEST_UNIVERSE, frame));
+  CPPUNIT_ASSERT_EQUAL(ola::proto::DMX_RLE, stub.encodings[1]);
+  DmxBuffer received;
+  CPPUNIT_ASSERT(ola::DecodeDmxFrame(
+      ola::DMX_ENCODING_RLE,
+      reinterpret_cast<const uint8_t*>(stub.frames[1].data()),
+      stub.frames[1].size(), DMX_UNIVERSE_SIZE, &received));
+  CPPUNIT_ASSERT(frame == received);
+
+  // then the changes
+  frame.SetChannel(11, 255);
+  CPPUNIT_ASSERT(client.SendDMX(TEST_UNIVERSE, frame));
+  CPPUNIT_ASSERT_EQUAL(ola::proto::DMX_DELTA, stub.encodings[2]);
+  CPPUNIT_ASSERT_EQUAL((size_t) 3, stub.frames[2].size());
+  CPPUNIT_ASSERT(ola::DecodeDmxFrame(
+      ola::DMX_ENCODING_DELTA,
+      reinterpret_cast<const uint8_t*>(stub.frames[2].data()),
+      stub.frames[2].size(), DMX_UNIVERSE_SIZE, &received));
+  CPPUNIT_ASSERT(frame == received);
+
+  // each universe has its own last frame
+  client.SetSinkOptions(TEST_UNIVERSE2, true, 0);
+  CPPUNIT_ASSERT(client.SendDMX(TEST_UNIVERSE2, frame));
+  CPPUNIT_ASSERT_EQUAL(ola::proto::DMX_RLE, stub.encodings[3]);
+
+  encodings.clear();
+  client.SetPushEncodings(encodings);
+  CPPUNIT_ASSERT(client.SendDMX(TEST_UNIVERSE, frame));
+  CPPUNIT_ASSERT_EQUAL(ola::proto::DMX_RAW, stub.encodings[4]);
+  CPPUNIT_ASSERT(frame.Get() == stub.frames[4]);
+}
@@ -29,6 +29,7 @@
 #include "ola/Logging.h"
 #include "ola/StringUtils.h"
 #include "olad/DeviceManager.h"
+#include "olad/PluginShard.h"
 #include "olad/Port.h"
 #include "olad/PortManager.h"
 
@@ -253,8 +254,13 @@ void DeviceManager::UnregisterAllDevices() {
  */
 void DeviceManager::SendTimeCode(const ola::timecode::TimeCode &timecode) {
   set<OutputPort*>::iterator iter = m_timecode_ports.begin();
-  for (; iter != m_timecode_ports.end(); iter++)
-    (*iter)->SendTimeCode(timecode);
+  for (; iter != m_timecode_ports.end(); iter++) {
+    const PluginAdaptor *shard = PortShard(*iter);
+    if (shard)
+      ShardedSendTimeCode(shard, *iter, timecode);
+    else
+      (*iter)->SendTimeCode(timecode);
+  }
 }
 
 
@@ -104,7 +104,9 @@ bool OlaDaemon::Init() {
   OLA_INFO << "Using configs in " << m_config_dir;
   m_preferences_factory = new FileBackedPreferencesFactory(m_config_dir);
 
-  m_ss = new SelectServer(m_export_map);
+  m_ss = new SelectServer(m_export_map, NULL,
+                          m_options.use_epoll ? SelectServer::EPOLL_POLLER :
+                                                SelectServer::SELECT_POLLER);
   m_service_factory = new OlaClientServiceFactory();
 
   // Order is important here as we won't load the same plugin twice.
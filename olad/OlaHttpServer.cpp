@@ -49,6 +49,8 @@ const char OlaHttpServer::K_DATA_DIR_VAR[] = "http_data_dir";
 const char OlaHttpServer::K_UPTIME_VAR[] = "uptime-in-ms";
 const char OlaHttpServer::K_BACKEND_DISCONNECTED_ERROR[] =
   "Failed to send request, client isn't connected";
+const char OlaHttpServer::K_MISSING_UNIVERSE_ERROR[] =
+  "Universe doesn't exist";
 const char OlaHttpServer::K_PRIORITY_VALUE_SUFFIX[] = "_priority_value";
 const char OlaHttpServer::K_PRIORITY_MODE_SUFFIX[] = "_priority_mode";
 
@@ -59,6 +61,8 @@ const char OlaHttpServer::K_PRIORITY_MODE_SUFFIX[] = "_priority_mode";
  * @param client_socket A ConnectedDescriptor which is used to communicate with the
  *   server.
  * @param
+ * @param snapshots if not NULL, the universe data is read from here rather
+ *   than asking the server.
  */
 OlaHttpServer::OlaHttpServer(ExportMap *export_map,
                              ConnectedDescriptor *client_socket,
@@ -66,7 +70,8 @@ OlaHttpServer::OlaHttpServer(ExportMap *export_map,
                              unsigned int port,
                              bool enable_quit,
                              const string &data_dir,
-                             const ola::network::Interface &interface)
+                             const ola::network::Interface &interface,
+                             const UniverseSnapshotTable *snapshots)
     : m_server(port, data_dir),
       m_export_map(export_map),
       m_client_socket(client_socket),
@@ -74,7 +79,8 @@ OlaHttpServer::OlaHttpServer(ExportMap *export_map,
       m_ola_server(ola_server),
       m_enable_quit(enable_quit),
       m_interface(interface),
-      m_rdm_module(&m_server, &m_client) {
+      m_rdm_module(&m_server, &m_client),
+      m_snapshots(snapshots) {
   // The main handlers
   RegisterHandler("/", &OlaHttpServer::DisplayIndex);
   RegisterHandler("/debug", &OlaHttpServer::DisplayDebug);
@@ -415,6 +421,16 @@ int OlaHttpServer::GetDmx(const HttpRequest *request,
   unsigned int universe_id;
   if (!StringToInt(uni_id, &universe_id))
     return m_server.ServeNotFound(response);
+
+  if (m_snapshots) {
+    // read the data directly, this saves a round trip to the server thread
+    DmxBuffer buffer;
+    const UniverseSnapshot *snapshot = LookupSnapshot(universe_id);
+    bool exists = snapshot && snapshot->Read(&buffer);
+    HandleGetDmx(response, buffer, exists ? "" : K_MISSING_UNIVERSE_ERROR);
+    return MHD_YES;
+  }
+
   int ok = m_client.FetchDmx(universe_id,
                              NewSingleCallback(this,
                                                &OlaHttpServer::HandleGetDmx,
@@ -868,6 +884,26 @@ void OlaHttpServer::SendModifyUniverseResponse(HttpResponse *response,
 }
 
 
+/*
+ * Find the snapshot for a universe. Once a universe has a snapshot it's never
+ * removed, so we remember it and don't need to lock the table next time.
+ * @param universe_id the universe to look up
+ * @returns the snapshot or NULL if the universe has never existed
+ */
+const UniverseSnapshot *OlaHttpServer::LookupSnapshot(
+    unsigned int universe_id) {
+  std::map<unsigned int, const UniverseSnapshot*>::const_iterator iter =
+    m_snapshot_cache.find(universe_id);
+  if (iter != m_snapshot_cache.end())
+    return iter->second;
+
+  const UniverseSnapshot *snapshot = m_snapshots->Get(universe_id);
+  if (snapshot)
+    m_snapshot_cache[universe_id] = snapshot;
+  return snapshot;
+}
+
+
 /*
  * Callback for m_client.FetchDmx called by GetDmx
  * @param response the HttpResponse
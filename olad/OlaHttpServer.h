@@ -22,6 +22,7 @@
 #define OLAD_OLAHTTPSERVER_H_
 
 #include <time.h>
+#include <map>
 #include <string>
 #include <vector>
 #include "ola/Clock.h"
@@ -30,6 +31,7 @@
 #include "ola/network/Interface.h"
 #include "olad/HttpServer.h"
 #include "olad/RDMHttpModule.h"
+#include "olad/UniverseSnapshot.h"
 
 namespace ola {
 
@@ -47,7 +49,8 @@ class OlaHttpServer {
                   unsigned int port,
                   bool enable_quit,
                   const string &data_dir,
-                  const ola::network::Interface &interface);
+                  const ola::network::Interface &interface,
+                  const UniverseSnapshotTable *snapshots = NULL);
     ~OlaHttpServer();
 
     bool Init();
@@ -123,10 +126,14 @@ class OlaHttpServer {
     RDMHttpModule m_rdm_module;
     time_t m_start_time_t;
     Clock m_clock;
+    const UniverseSnapshotTable *m_snapshots;
+    // snapshots we've already looked up, only used by the HTTP thread
+    std::map<unsigned int, const UniverseSnapshot*> m_snapshot_cache;
 
     OlaHttpServer(const OlaHttpServer&);
     OlaHttpServer& operator=(const OlaHttpServer&);
 
+    const UniverseSnapshot *LookupSnapshot(unsigned int universe_id);
     void HandleGetDmx(HttpResponse *response,
                       const DmxBuffer &buffer,
                       const string &error);
@@ -164,6 +171,7 @@ class OlaHttpServer {
     static const char K_DATA_DIR_VAR[];
     static const char K_UPTIME_VAR[];
     static const char K_BACKEND_DISCONNECTED_ERROR[];
+    static const char K_MISSING_UNIVERSE_ERROR[];
     static const unsigned int K_UNIVERSE_NAME_LIMIT = 100;
     static const char K_PRIORITY_VALUE_SUFFIX[];
     static const char K_PRIORITY_MODE_SUFFIX[];
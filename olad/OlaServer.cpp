@@ -45,6 +45,7 @@
 #include "olad/Plugin.h"
 #include "olad/PluginAdaptor.h"
 #include "olad/PluginManager.h"
+#include "olad/PluginShard.h"
 #include "olad/Port.h"
 #include "olad/PortBroker.h"
 #include "olad/PortManager.h"
@@ -129,6 +130,7 @@ OlaServer::~OlaServer() {
   if (m_housekeeping_timeout != ola::thread::INVALID_TIMEOUT)
     m_ss->RemoveTimeout(m_housekeeping_timeout);
 
+  StopPluginShards();
   StopPlugins();
 
   map<int, OlaClientService*>::iterator iter;
@@ -167,6 +169,12 @@ OlaServer::~OlaServer() {
   delete m_plugin_manager;
   delete m_service_impl;
 
+  // the plugins have been unloaded so it's now safe to delete the shards
+  vector<PluginShard*>::iterator shard_iter = m_plugin_shards.begin();
+  for (; shard_iter != m_plugin_shards.end(); ++shard_iter)
+    delete *shard_iter;
+  m_plugin_shards.clear();
+
   if (m_free_export_map)
     delete m_export_map;
 }
@@ -196,6 +204,7 @@ bool OlaServer::Init() {
     m_accepting_socket->SetOnAccept(
       ola::NewCallback(this, &OlaServer::NewConnection));
     m_ss->AddReadDescriptor(m_accepting_socket);
+    m_ss->SetReadDescriptorName(m_accepting_socket, "rpc-accept");
   }
 
 #ifndef WIN32
@@ -220,7 +229,8 @@ bool OlaServer::Init() {
   m_universe_preferences = m_preferences_factory->NewPreference(
       UNIVERSE_PREFERENCES);
   m_universe_preferences->Load();
-  m_universe_store = new UniverseStore(m_universe_preferences, m_export_map);
+  m_universe_store = new UniverseStore(m_universe_preferences, m_export_map,
+                                     m_ss);
 
   m_port_broker = new PortBroker();
   m_port_manager = new PortManager(m_universe_store, m_port_broker);
@@ -231,9 +241,26 @@ bool OlaServer::Init() {
   m_plugin_adaptor = new PluginAdaptor(m_device_manager,
                                        m_ss,
                                        m_preferences_factory,
-                                       m_port_broker);
+                                       m_port_broker,
+                                       NULL,
+                                       m_export_map);
+
+  vector<PluginAdaptor*> shard_adaptors;
+  for (unsigned int i = 0; i < m_options.plugin_threads; i++) {
+    PluginShard *shard = new PluginShard(
+        m_device_manager,
+        m_preferences_factory,
+        m_port_broker,
+        m_ss,
+        m_options.use_epoll ? ola::network::SelectServer::EPOLL_POLLER :
+                              ola::network::SelectServer::SELECT_POLLER);
+    m_plugin_shards.push_back(shard);
+    shard_adaptors.push_back(shard->GetPluginAdaptor());
+  }
 
-  m_plugin_manager = new PluginManager(m_plugin_loaders, m_plugin_adaptor);
+  m_plugin_manager = new PluginManager(m_plugin_loaders,
+                                       m_plugin_adaptor,
+                                       shard_adaptors);
   m_service_impl = new OlaServerServiceImpl(
       m_universe_store,
       m_device_manager,
@@ -242,7 +269,8 @@ bool OlaServer::Init() {
       m_port_manager,
       m_broker,
       m_ss->WakeUpTime(),
-      m_default_uid);
+      m_default_uid,
+      &m_plugin_shards);
 
   if (!m_port_broker || !m_universe_store || !m_device_manager ||
       !m_plugin_adaptor || !m_port_manager || !m_plugin_manager || !m_broker ||
@@ -256,8 +284,7 @@ bool OlaServer::Init() {
   }
 
   // The plugin load procedure can take a while so we run it in the main loop.
-  m_ss->Execute(
-      ola::NewSingleCallback(m_plugin_manager, &PluginManager::LoadAll));
+  m_ss->Execute(ola::NewSingleCallback(this, &OlaServer::LoadPlugins));
 
 #ifdef HAVE_LIBMICROHTTPD
   if (!StartHttpServer(iface))
@@ -267,7 +294,10 @@ bool OlaServer::Init() {
   m_housekeeping_timeout = m_ss->RegisterRepeatingTimeout(
       K_HOUSEKEEPING_TIMEOUT_MS,
       ola::NewCallback(this, &OlaServer::RunHousekeeping));
+  m_ss->SetTimeoutName(m_housekeeping_timeout, "housekeeping");
   m_ss->RunInLoop(ola::NewCallback(this, &OlaServer::CheckForReload));
+  m_ss->RunInLoop(ola::NewCallback(m_service_impl,
+                                   &OlaServerServiceImpl::ReadSharedMemory));
 
   m_init_run = true;
   return true;
@@ -292,9 +322,11 @@ void OlaServer::NewConnection(ola::network::ConnectedDescriptor *socket) {
     return;
 
   StreamRpcChannel *channel = new StreamRpcChannel(NULL, socket, m_export_map);
+  channel->SetSelectServer(m_ss);
   socket->SetOnClose(NewSingleCallback(this, &OlaServer::SocketClosed, socket));
   OlaClientService_Stub *stub = new OlaClientService_Stub(channel);
-  Client *client = new Client(stub);
+  Client *client = new Client(stub, channel, m_ss, m_export_map,
+                              socket->ReadDescriptor());
   OlaClientService *service = m_service_factory->New(client, m_service_impl);
   m_broker->AddClient(client);
   channel->SetService(service);
@@ -310,6 +342,7 @@ void OlaServer::NewConnection(ola::network::ConnectedDescriptor *socket) {
 
   // This hands off ownership to the select server
   m_ss->AddReadDescriptor(socket, true);
+  m_ss->SetReadDescriptorName(socket, "rpc-client");
   (*m_export_map->GetIntegerVar(K_CLIENT_VAR))++;
 }
 
@@ -349,8 +382,10 @@ void OlaServer::CheckForReload() {
   if (m_reload_plugins) {
     m_reload_plugins = false;
     OLA_INFO << "Reloading plugins";
-    StopPlugins();
-    m_plugin_manager->LoadAll();
+    // Stop the shards first. Anything they've queued for this thread refers
+    // to their ports, so the plugins are unloaded once that has run.
+    StopPluginShards();
+    m_ss->Execute(ola::NewSingleCallback(this, &OlaServer::RestartPlugins));
   }
 }
 
@@ -380,7 +415,8 @@ bool OlaServer::StartHttpServer(const ola::network::Interface &iface) {
                               m_options.http_port,
                               m_options.http_enable_quit,
                               m_options.http_data_dir,
-                              iface);
+                              iface,
+                              m_universe_store->Snapshots());
 
   if (m_httpd->Init()) {
     m_httpd->Start();
@@ -398,6 +434,24 @@ bool OlaServer::StartHttpServer(const ola::network::Interface &iface) {
 #endif
 
 
+/*
+ * Load & start the plugins, then start the shards they run in.
+ */
+void OlaServer::LoadPlugins() {
+  m_plugin_manager->LoadAll();
+  StartPluginShards();
+}
+
+
+/*
+ * Unload and then load all plugins.
+ */
+void OlaServer::RestartPlugins() {
+  StopPlugins();
+  LoadPlugins();
+}
+
+
 /*
  * Stop and unload all the plugins
  */
@@ -414,12 +468,35 @@ void OlaServer::StopPlugins() {
 }
 
 
+/*
+ * Start the PluginShard threads.
+ */
+void OlaServer::StartPluginShards() {
+  vector<PluginShard*>::iterator iter = m_plugin_shards.begin();
+  for (; iter != m_plugin_shards.end(); ++iter) {
+    if (!(*iter)->Start())
+      OLA_WARN << "Failed to start plugin thread";
+  }
+}
+
+
+/*
+ * Stop the PluginShard threads. This blocks until the threads have exited.
+ */
+void OlaServer::StopPluginShards() {
+  vector<PluginShard*>::iterator iter = m_plugin_shards.begin();
+  for (; iter != m_plugin_shards.end(); ++iter)
+    (*iter)->Stop();
+}
+
+
 /*
  * Cleanup everything related to a client connection
  */
 void OlaServer::CleanupConnection(OlaClientService *service) {
   Client *client = service->GetClient();
   m_broker->RemoveClient(client);
+  m_service_impl->ClientRemoved(client);
 
   vector<Universe*> universe_list;
   m_universe_store->GetList(&universe_list);
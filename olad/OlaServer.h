@@ -50,6 +50,8 @@ typedef struct {
   bool http_enable_quit;  // enable /quit
   unsigned int http_port;  // port to run the http server on
   std::string http_data_dir;  // directory that contains the static content
+  bool use_epoll;  // use epoll() rather than select() for i/o
+  unsigned int plugin_threads;  // the number of PluginShards, 0 disables
 } ola_server_options;
 
 
@@ -83,7 +85,11 @@ class OlaServer {
 #ifdef HAVE_LIBMICROHTTPD
     bool StartHttpServer(const ola::network::Interface &interface);
 #endif
+    void LoadPlugins();
+    void RestartPlugins();
     void StopPlugins();
+    void StartPluginShards();
+    void StopPluginShards();
     void CleanupConnection(class OlaClientService *service);
 
     class OlaClientServiceFactory *m_service_factory;
@@ -102,6 +108,7 @@ class OlaServer {
     class OlaServerServiceImpl *m_service_impl;
     class ClientBroker *m_broker;
     class PortBroker *m_port_broker;
+    vector<class PluginShard*> m_plugin_shards;
 
     bool m_reload_plugins;
     bool m_init_run;
@@ -23,6 +23,7 @@
 #include <string>
 #include <vector>
 #include "common/protocol/Ola.pb.h"
+#include "common/utils/DmxFrameEncoder.h"
 #include "ola/Callback.h"
 #include "ola/CallbackRunner.h"
 #include "ola/DmxBuffer.h"
@@ -33,12 +34,14 @@
 #include "ola/timecode/TimeCode.h"
 #include "ola/timecode/TimeCodeEnums.h"
 #include "olad/Client.h"
+#include "olad/ClientSharedMemory.h"
 #include "olad/Device.h"
 #include "olad/DeviceManager.h"
 #include "olad/DmxSource.h"
 #include "olad/OlaServerServiceImpl.h"
 #include "olad/Plugin.h"
 #include "olad/PluginManager.h"
+#include "olad/PluginShard.h"
 #include "olad/Port.h"
 #include "olad/PortManager.h"
 #include "olad/Universe.h"
@@ -54,6 +57,8 @@ using ola::proto::DeviceInfo;
 using ola::proto::DeviceInfoReply;
 using ola::proto::DeviceInfoRequest;
 using ola::proto::DmxData;
+using ola::proto::DmxEncodingReply;
+using ola::proto::DmxEncodingRequest;
 using ola::proto::MergeModeRequest;
 using ola::proto::OptionalUniverseRequest;
 using ola::proto::PatchPortRequest;
@@ -64,6 +69,8 @@ using ola::proto::PluginListReply;
 using ola::proto::PluginListRequest;
 using ola::proto::PortInfo;
 using ola::proto::RegisterDmxRequest;
+using ola::proto::SharedMemoryReply;
+using ola::proto::SharedMemoryRequest;
 using ola::proto::UniverseInfo;
 using ola::proto::UniverseInfoReply;
 using ola::proto::UniverseNameRequest;
@@ -95,6 +102,8 @@ void OlaServerServiceImpl::GetDmx(
   const DmxBuffer buffer = universe->GetDMX();
   response->set_data(buffer.Get());
   response->set_universe(request->universe());
+  if (universe->SlotPriorities().Size())
+    response->set_slot_priorities(universe->SlotPriorities().Get());
 }
 
 
@@ -115,9 +124,14 @@ void OlaServerServiceImpl::RegisterForDmx(
     return MissingUniverseError(controller);
 
   if (request->action() == ola::proto::REGISTER) {
+    if (client)
+      client->SetSinkOptions(universe->UniverseId(), request->streaming(),
+                             request->max_rate());
     universe->AddSinkClient(client);
   } else {
     universe->RemoveSinkClient(client);
+    if (client)
+      client->RemoveSink(universe->UniverseId());
   }
 }
 
@@ -132,24 +146,17 @@ void OlaServerServiceImpl::UpdateDmxData(
     google::protobuf::Closure* done,
     Client *client) {
   ClosureRunner runner(done);
+  // The client's copy is updated even if the universe doesn't exist, since
+  // the next frame may be a delta against it.
+  if (client)
+    UpdateClientSource(client, request);
+
   Universe *universe = m_universe_store->GetUniverse(request->universe());
   if (!universe)
     return MissingUniverseError(controller);
 
-  if (client) {
-    DmxBuffer buffer;
-    buffer.Set(request->data());
-
-    uint8_t priority = DmxSource::PRIORITY_DEFAULT;
-    if (request->has_priority()) {
-      priority = request->priority();
-      priority = std::max(DmxSource::PRIORITY_MIN, priority);
-      priority = std::min(DmxSource::PRIORITY_MAX, priority);
-    }
-    DmxSource source(buffer, *m_wake_up_time, priority);
-    client->DMXRecieved(request->universe(), source);
+  if (client)
     universe->SourceClientDataChanged(client);
-  }
 }
 
 
@@ -162,26 +169,209 @@ void OlaServerServiceImpl::StreamDmxData(
     ::ola::proto::STREAMING_NO_RESPONSE*,
     ::google::protobuf::Closure*,
     Client *client) {
+  if (!client)
+    return;
 
+  UpdateClientSource(client, request);
   Universe *universe = m_universe_store->GetUniverse(request->universe());
+  if (universe)
+    universe->SourceClientDataChanged(client);
+}
 
-  if (!universe)
+
+/*
+ * Handle a batch of streaming DMX updates. The data for every universe is
+ * applied before any of them are merged so the output ports are all written
+ * with data from this batch, rather than some with the previous frame.
+ */
+void OlaServerServiceImpl::StreamDmxDataBatch(
+    RpcController*,
+    const ::ola::proto::DmxDataBatch* request,
+    ::ola::proto::STREAMING_NO_RESPONSE*,
+    ::google::protobuf::Closure*,
+    Client *client) {
+  if (!client)
+    return;
+
+  m_batch_universes.clear();
+  for (int i = 0; i < request->data_size(); i++) {
+    const DmxData &data = request->data(i);
+    UpdateClientSource(client, &data);
+    Universe *universe = m_universe_store->GetUniverse(data.universe());
+    if (universe)
+      m_batch_universes.push_back(universe);
+  }
+
+  vector<Universe*>::iterator iter = m_batch_universes.begin();
+  for (; iter != m_batch_universes.end(); ++iter)
+    (*iter)->SourceClientDataChanged(client);
+}
+
+
+/*
+ * Create a shared memory region for a client. The client is registered as a
+ * sink for the output universes, their frames are written to the region
+ * rather than being pushed.
+ */
+void OlaServerServiceImpl::SetupSharedMemory(
+    RpcController* controller,
+    const SharedMemoryRequest* request,
+    SharedMemoryReply* response,
+    google::protobuf::Closure* done,
+    Client *client) {
+  ClosureRunner runner(done);
+  if (!client) {
+    controller->SetFailed("Shared memory requires a client");
+    return;
+  }
+  // the output universes of the current region are still registered as
+  // sinks, so the region can't be replaced.
+  if (client->SharedMemory()) {
+    controller->SetFailed("Shared memory is already set up");
     return;
+  }
+
+  vector<unsigned int> inputs, outputs;
+  vector<Universe*> output_universes;
+  for (int i = 0; i < request->input_universes_size(); i++)
+    inputs.push_back(request->input_universes(i));
+  for (int i = 0; i < request->output_universes_size(); i++) {
+    Universe *universe = m_universe_store->GetUniverseOrCreate(
+        request->output_universes(i));
+    if (!universe)
+      return MissingUniverseError(controller);
+    outputs.push_back(universe->UniverseId());
+    output_universes.push_back(universe);
+  }
+
+  ClientSharedMemory *shared_memory = new ClientSharedMemory(
+      client, m_universe_store, m_wake_up_time);
+  if (!shared_memory->Setup(inputs, outputs)) {
+    delete shared_memory;
+    controller->SetFailed("Failed to create the shared memory region");
+    return;
+  }
+  client->SetSharedMemory(shared_memory);
+  m_shared_memory_clients.insert(client);
+  response->set_name(shared_memory->Name());
+
+  vector<Universe*>::iterator iter = output_universes.begin();
+  for (; iter != output_universes.end(); ++iter)
+    (*iter)->AddSinkClient(client);
+}
 
+
+/*
+ * Called when a client has written to its shared memory and we'd armed the
+ * doorbell, which means we may be waiting in select() for the next event.
+ */
+void OlaServerServiceImpl::RingSharedMemoryDoorbell(
+    RpcController*,
+    const ::ola::proto::SharedMemoryDoorbell*,
+    ::ola::proto::STREAMING_NO_RESPONSE*,
+    ::google::protobuf::Closure*,
+    Client *client) {
+  if (client && client->SharedMemory())
+    client->SharedMemory()->ReadInputs();
+}
+
+
+/*
+ * Pick up the frames written to all the shared memory regions.
+ */
+void OlaServerServiceImpl::ReadSharedMemory() {
+  std::set<const Client*>::iterator iter = m_shared_memory_clients.begin();
+  for (; iter != m_shared_memory_clients.end(); ++iter)
+    (*iter)->SharedMemory()->ReadInputs();
+}
+
+
+/*
+ * Set the encodings used for frames pushed to a client, and tell the client
+ * which encodings we accept.
+ */
+void OlaServerServiceImpl::SetDmxEncodings(
+    RpcController*,
+    const DmxEncodingRequest* request,
+    DmxEncodingReply* response,
+    google::protobuf::Closure* done,
+    Client *client) {
+  ClosureRunner runner(done);
   if (client) {
-    DmxBuffer buffer;
-    buffer.Set(request->data());
+    vector<dmx_encoding> encodings;
+    for (int i = 0; i < request->encodings_size(); i++)
+      encodings.push_back(static_cast<dmx_encoding>(request->encodings(i)));
+    client->SetPushEncodings(encodings);
+  }
+  response->add_encodings(ola::proto::DMX_RLE);
+  response->add_encodings(ola::proto::DMX_DELTA);
+}
 
-    uint8_t priority = DmxSource::PRIORITY_DEFAULT;
-    if (request->has_priority()) {
-      priority = request->priority();
-      priority = std::max(DmxSource::PRIORITY_MIN, priority);
-      priority = std::min(DmxSource::PRIORITY_MAX, priority);
+
+/*
+ * Called before a client is deleted.
+ */
+void OlaServerServiceImpl::ClientRemoved(const Client *client) {
+  m_shared_memory_clients.erase(client);
+}
+
+
+/*
+ * Copy the data from a DmxData message straight into the client's source for
+ * the universe, encoded frames are decoded in place. The caller needs to tell
+ * the universe it changed.
+ */
+void OlaServerServiceImpl::UpdateClientSource(Client *client,
+                                              const DmxData *request) {
+  uint8_t priority = DmxSource::PRIORITY_DEFAULT;
+  if (request->has_priority()) {
+    priority = request->priority();
+    priority = std::max(DmxSource::PRIORITY_MIN, priority);
+    priority = std::min(DmxSource::PRIORITY_MAX, priority);
+  }
+
+  const string &data = request->data();
+  DmxSource *source = client->MutableSourceData(request->universe());
+  if (request->encoding() == ola::proto::DMX_RAW) {
+    source->UpdateData(reinterpret_cast<const uint8_t*>(data.data()),
+                       data.size(), *m_wake_up_time, priority);
+  } else {
+    DmxBuffer *buffer = source->UpdateDataInPlace(*m_wake_up_time, priority);
+    if (!DecodeDmxFrame(static_cast<dmx_encoding>(request->encoding()),
+                        reinterpret_cast<const uint8_t*>(data.data()),
+                        data.size(), request->length(), buffer)) {
+      // The deltas that follow fail as well, until the client's encoder sends
+      // the next full frame.
+      OLA_WARN << "Failed to decode frame for universe " <<
+        request->universe();
+      buffer->Reset();
     }
-    DmxSource source(buffer, *m_wake_up_time, priority);
-    client->DMXRecieved(request->universe(), source);
-    universe->SourceClientDataChanged(client);
   }
+  if (request->has_slot_priorities()) {
+    uint8_t priorities[DMX_UNIVERSE_SIZE];
+    unsigned int length = SlotPriorities(request->slot_priorities(),
+                                         priorities);
+    source->SetSlotPriorities(priorities, length);
+  }
+}
+
+
+/*
+ * Convert the slot priorities from a DmxData message, clamping them to the
+ * valid range. A slot priority of 0 is kept since it means the client doesn't
+ * control that slot.
+ * @param data the slot priorities from the message
+ * @param priorities an array of at least DMX_UNIVERSE_SIZE
+ * @returns the number of slot priorities
+ */
+unsigned int OlaServerServiceImpl::SlotPriorities(const string &data,
+                                                  uint8_t *priorities) const {
+  unsigned int length = std::min(data.size(),
+                                 static_cast<size_t>(DMX_UNIVERSE_SIZE));
+  for (unsigned int i = 0; i < length; i++)
+    priorities[i] = std::min(DmxSource::PRIORITY_MAX,
+                             static_cast<uint8_t>(data[i]));
+  return length;
 }
 
 
@@ -230,6 +420,7 @@ void OlaServerServiceImpl::PatchPort(
     Ack*,
     google::protobuf::Closure* done) {
   ClosureRunner runner(done);
+  ShardPauser pauser(m_plugin_shards);
   AbstractDevice *device =
     m_device_manager->GetDevice(request->device_alias());
 
@@ -271,6 +462,7 @@ void OlaServerServiceImpl::SetPortPriority(
     Ack*,
     google::protobuf::Closure* done) {
   ClosureRunner runner(done);
+  ShardPauser pauser(m_plugin_shards);
   AbstractDevice *device =
     m_device_manager->GetDevice(request->device_alias());
 
@@ -412,6 +604,7 @@ void OlaServerServiceImpl::GetDeviceInfo(RpcController*,
                                          DeviceInfoReply* response,
                                          google::protobuf::Closure* done) {
   ClosureRunner runner(done);
+  ShardPauser pauser(m_plugin_shards);
   vector<device_alias_pair> device_list = m_device_manager->Devices();
   vector<device_alias_pair>::const_iterator iter;
 
@@ -436,6 +629,7 @@ void OlaServerServiceImpl::GetCandidatePorts(
     ola::proto::DeviceInfoReply* response,
     google::protobuf::Closure* done) {
   ClosureRunner runner(done);
+  ShardPauser pauser(m_plugin_shards);
   vector<device_alias_pair> device_list = m_device_manager->Devices();
   vector<device_alias_pair>::const_iterator iter;
 
@@ -545,6 +739,8 @@ void OlaServerServiceImpl::ConfigureDevice(RpcController* controller,
                                            const DeviceConfigRequest* request,
                                            DeviceConfigReply* response,
                                            google::protobuf::Closure* done) {
+  // plugins in a PluginShard must complete the request before returning
+  ShardPauser pauser(m_plugin_shards);
   AbstractDevice *device =
     m_device_manager->GetDevice(request->device_alias());
   if (!device) {
@@ -18,9 +18,11 @@
  * Copyright (C) 2005 - 2008 Simon Newton
  */
 
+#include <set>
 #include <vector>
 #include <string>
 #include "common/protocol/Ola.pb.h"
+#include "ola/DmxBuffer.h"
 #include "ola/rdm/UID.h"
 #include "ola/rdm/RDMCommand.h"
 #include "olad/ClientBroker.h"
@@ -30,6 +32,8 @@
 
 namespace ola {
 
+class PluginShard;
+
 using google::protobuf::RpcController;
 using ola::proto::Ack;
 
@@ -50,7 +54,9 @@ class OlaServerServiceImpl {
                          class PortManager *port_manager,
                          class ClientBroker *broker,
                          const class TimeStamp *wake_up_time,
-                         const ola::rdm::UID &uid):
+                         const ola::rdm::UID &uid,
+                         const std::vector<PluginShard*> *plugin_shards =
+                           NULL):
       m_universe_store(universe_store),
       m_device_manager(device_manager),
       m_plugin_manager(plugin_manager),
@@ -58,7 +64,8 @@ class OlaServerServiceImpl {
       m_port_manager(port_manager),
       m_broker(broker),
       m_wake_up_time(wake_up_time),
-      m_uid(uid) {}
+      m_uid(uid),
+      m_plugin_shards(plugin_shards) {}
     ~OlaServerServiceImpl();
 
     void GetDmx(RpcController* controller,
@@ -80,6 +87,27 @@ class OlaServerServiceImpl {
                        ::ola::proto::STREAMING_NO_RESPONSE* response,
                        ::google::protobuf::Closure* done,
                        class Client *client);
+    void StreamDmxDataBatch(RpcController* controller,
+                            const ::ola::proto::DmxDataBatch* request,
+                            ::ola::proto::STREAMING_NO_RESPONSE* response,
+                            ::google::protobuf::Closure* done,
+                            class Client *client);
+    void SetupSharedMemory(RpcController* controller,
+                           const ola::proto::SharedMemoryRequest* request,
+                           ola::proto::SharedMemoryReply* response,
+                           google::protobuf::Closure* done,
+                           class Client *client);
+    void RingSharedMemoryDoorbell(
+        RpcController* controller,
+        const ::ola::proto::SharedMemoryDoorbell* request,
+        ::ola::proto::STREAMING_NO_RESPONSE* response,
+        ::google::protobuf::Closure* done,
+        class Client *client);
+    void SetDmxEncodings(RpcController* controller,
+                         const ola::proto::DmxEncodingRequest* request,
+                         ola::proto::DmxEncodingReply* response,
+                         google::protobuf::Closure* done,
+                         class Client *client);
     void SetUniverseName(RpcController* controller,
                          const ola::proto::UniverseNameRequest* request,
                          Ack* response,
@@ -145,6 +173,10 @@ class OlaServerServiceImpl {
                       ::ola::proto::Ack* response,
                       ::google::protobuf::Closure* done);
 
+    // Called every time around the select loop
+    void ReadSharedMemory();
+    void ClientRemoved(const class Client *client);
+
   private:
     void HandleRDMResponse(ola::proto::RDMResponse* response,
                            google::protobuf::Closure* done,
@@ -162,6 +194,11 @@ class OlaServerServiceImpl {
     void MissingDeviceError(RpcController* controller);
     void MissingPortError(RpcController* controller);
 
+    void UpdateClientSource(class Client *client,
+                            const ola::proto::DmxData *request);
+    unsigned int SlotPriorities(const std::string &data,
+                                uint8_t *priorities) const;
+
     void AddPlugin(class AbstractPlugin *plugin,
                    ola::proto::PluginListReply* response) const;
     void AddDevice(class AbstractDevice *device,
@@ -180,6 +217,10 @@ class OlaServerServiceImpl {
     class ClientBroker *m_broker;
     const class TimeStamp *m_wake_up_time;
     ola::rdm::UID m_uid;
+    // plugin shards are paused while we access their devices & ports
+    const std::vector<PluginShard*> *m_plugin_shards;
+    std::vector<class Universe*> m_batch_universes;  // reused for each batch
+    std::set<const class Client*> m_shared_memory_clients;
 };
 
 
@@ -227,6 +268,38 @@ class OlaClientService: public ola::proto::OlaServerService {
       m_impl->StreamDmxData(controller, request, response, done, m_client);
     }
 
+    void StreamDmxDataBatch(RpcController* controller,
+                            const ::ola::proto::DmxDataBatch* request,
+                            ::ola::proto::STREAMING_NO_RESPONSE* response,
+                            ::google::protobuf::Closure* done) {
+      m_impl->StreamDmxDataBatch(controller, request, response, done,
+                                 m_client);
+    }
+
+    void SetupSharedMemory(RpcController* controller,
+                           const ola::proto::SharedMemoryRequest* request,
+                           ola::proto::SharedMemoryReply* response,
+                           google::protobuf::Closure* done) {
+      m_impl->SetupSharedMemory(controller, request, response, done,
+                                m_client);
+    }
+
+    void RingSharedMemoryDoorbell(
+        RpcController* controller,
+        const ::ola::proto::SharedMemoryDoorbell* request,
+        ::ola::proto::STREAMING_NO_RESPONSE* response,
+        ::google::protobuf::Closure* done) {
+      m_impl->RingSharedMemoryDoorbell(controller, request, response, done,
+                                       m_client);
+    }
+
+    void SetDmxEncodings(RpcController* controller,
+                         const ola::proto::DmxEncodingRequest* request,
+                         ola::proto::DmxEncodingReply* response,
+                         google::protobuf::Closure* done) {
+      m_impl->SetDmxEncodings(controller, request, response, done, m_client);
+    }
+
     void SetUniverseName(RpcController* controller,
                          const ola::proto::UniverseNameRequest* request,
                          Ack* response,
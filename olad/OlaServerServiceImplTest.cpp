@@ -27,6 +27,7 @@
 #include <string>
 
 #include "common/rpc/SimpleRpcController.h"
+#include "common/utils/SharedDmxRegion.h"
 #include "ola/BaseTypes.h"
 #include "ola/Clock.h"
 #include "ola/DmxBuffer.h"
@@ -56,6 +57,9 @@ class OlaServerServiceImplTest: public CppUnit::TestFixture {
   CPPUNIT_TEST(testGetDmx);
   CPPUNIT_TEST(testRegisterForDmx);
   CPPUNIT_TEST(testUpdateDmxData);
+  CPPUNIT_TEST(testStreamDmxDataBatch);
+  CPPUNIT_TEST(testSharedMemory);
+  CPPUNIT_TEST(testDmxEncodings);
   CPPUNIT_TEST(testSetUniverseName);
   CPPUNIT_TEST(testSetMergeMode);
   CPPUNIT_TEST_SUITE_END();
@@ -72,6 +76,9 @@ class OlaServerServiceImplTest: public CppUnit::TestFixture {
     void testGetDmx();
     void testRegisterForDmx();
     void testUpdateDmxData();
+    void testStreamDmxDataBatch();
+    void testSharedMemory();
+    void testDmxEncodings();
     void testSetUniverseName();
     void testSetMergeMode();
 
@@ -426,6 +433,218 @@ void OlaServerServiceImplTest::testUpdateDmxData() {
 }
 
 
+/*
+ * Check the StreamDmxDataBatch method updates every universe in the batch
+ */
+void OlaServerServiceImplTest::testStreamDmxDataBatch() {
+  UniverseStore store(NULL, NULL);
+  ola::TimeStamp time1;
+  ola::Client client(NULL);
+  OlaServerServiceImpl impl(&store,
+                            NULL,
+                            NULL,
+                            NULL,
+                            NULL,
+                            NULL,
+                            &time1,
+                            m_uid);
+  OlaClientService service(&client, &impl);
+  m_clock.CurrentTime(&time1);
+
+  Universe *universe1 = store.GetUniverseOrCreate(1);
+  Universe *universe2 = store.GetUniverseOrCreate(2);
+  DmxBuffer data1("1,2,3");
+  DmxBuffer data2("4,5");
+
+  ola::proto::DmxDataBatch request;
+  ola::proto::DmxData *data = request.add_data();
+  data->set_universe(1);
+  data->set_data(data1.Get());
+  // universe 3 doesn't exist, this is skipped
+  data = request.add_data();
+  data->set_universe(3);
+  data->set_data(data1.Get());
+  data = request.add_data();
+  data->set_universe(2);
+  data->set_data(data2.Get());
+  data->set_priority(150);
+
+  service.StreamDmxDataBatch(NULL, &request, NULL, NULL);
+  CPPUNIT_ASSERT(data1 == universe1->GetDMX());
+  CPPUNIT_ASSERT(data2 == universe2->GetDMX());
+  CPPUNIT_ASSERT(!store.GetUniverse(3));
+  CPPUNIT_ASSERT_EQUAL(static_cast<uint8_t>(100),
+                       client.SourceData(1).Priority());
+  CPPUNIT_ASSERT_EQUAL(static_cast<uint8_t>(150),
+                       client.SourceData(2).Priority());
+}
+
+
+static void SharedMemorySetupDone() {}
+
+
+/*
+ * Check frames are read from and written to a client's shared memory.
+ */
+void OlaServerServiceImplTest::testSharedMemory() {
+  UniverseStore store(NULL, NULL);
+  ola::TimeStamp time1;
+  ola::Client client(NULL);
+  OlaServerServiceImpl impl(&store,
+                            NULL,
+                            NULL,
+                            NULL,
+                            NULL,
+                            NULL,
+                            &time1,
+                            m_uid);
+  OlaClientService service(&client, &impl);
+  m_clock.CurrentTime(&time1);
+
+  Universe *universe1 = store.GetUniverseOrCreate(1);
+  Universe *universe2 = store.GetUniverseOrCreate(2);
+
+  // an empty request fails
+  SimpleRpcController controller;
+  ola::proto::SharedMemoryRequest request;
+  ola::proto::SharedMemoryReply reply;
+  service.SetupSharedMemory(&controller, &request, &reply,
+                            NewCallback(&SharedMemorySetupDone));
+  CPPUNIT_ASSERT(controller.Failed());
+  CPPUNIT_ASSERT(!client.SharedMemory());
+
+  controller.Reset();
+  request.add_input_universes(1);
+  request.add_input_universes(2);
+  request.add_output_universes(3);
+  service.SetupSharedMemory(&controller, &request, &reply,
+                            NewCallback(&SharedMemorySetupDone));
+  CPPUNIT_ASSERT(!controller.Failed());
+  CPPUNIT_ASSERT(client.SharedMemory());
+  Universe *universe3 = store.GetUniverse(3);
+  CPPUNIT_ASSERT(universe3);
+  CPPUNIT_ASSERT(universe3->ContainsSinkClient(&client));
+  const ola::ClientSharedMemory *shared_memory = client.SharedMemory();
+
+  // a second setup is rejected, and the first region is kept
+  controller.Reset();
+  ola::proto::SharedMemoryReply second_reply;
+  service.SetupSharedMemory(&controller, &request, &second_reply,
+                            NewCallback(&SharedMemorySetupDone));
+  CPPUNIT_ASSERT(controller.Failed());
+  CPPUNIT_ASSERT(shared_memory == client.SharedMemory());
+
+  ola::SharedDmxRegion region;
+  CPPUNIT_ASSERT(region.Open(reply.name()));
+  region.Unlink();
+  CPPUNIT_ASSERT_EQUAL(3u, region.SlotCount());
+  CPPUNIT_ASSERT(region.TakeDoorbell());
+
+  // frames are picked up once per loop, all the universes are merged
+  DmxBuffer data1("1,2,3");
+  DmxBuffer data2("4,5");
+  region.Write(0, data1);
+  region.Write(1, data2, 150);
+  CPPUNIT_ASSERT(universe1->GetDMX().Size() == 0);
+  impl.ReadSharedMemory();
+  CPPUNIT_ASSERT(data1 == universe1->GetDMX());
+  CPPUNIT_ASSERT(data2 == universe2->GetDMX());
+  CPPUNIT_ASSERT_EQUAL(static_cast<uint8_t>(100),
+                       client.SourceData(1).Priority());
+  CPPUNIT_ASSERT_EQUAL(static_cast<uint8_t>(150),
+                       client.SourceData(2).Priority());
+
+  // the read armed the doorbell, ringing it reads the new frame
+  CPPUNIT_ASSERT(region.TakeDoorbell());
+  region.Write(0, data2);
+  service.RingSharedMemoryDoorbell(NULL, NULL, NULL, NULL);
+  CPPUNIT_ASSERT(data2 == universe1->GetDMX());
+
+  // the output universe is written to the region
+  DmxBuffer output;
+  uint32_t sequence = 0;
+  universe3->SetDMX(data1);
+  CPPUNIT_ASSERT(region.Read(2, &sequence, &output));
+  CPPUNIT_ASSERT(data1 == output);
+
+  impl.ClientRemoved(&client);
+  region.Write(0, data1);
+  impl.ReadSharedMemory();
+  CPPUNIT_ASSERT(data2 == universe1->GetDMX());
+}
+
+
+/*
+ * Check encoded frames are decoded into the client's source.
+ */
+void OlaServerServiceImplTest::testDmxEncodings() {
+  UniverseStore store(NULL, NULL);
+  ola::TimeStamp time1;
+  ola::Client client(NULL);
+  OlaServerServiceImpl impl(&store,
+                            NULL,
+                            NULL,
+                            NULL,
+                            NULL,
+                            NULL,
+                            &time1,
+                            m_uid);
+  OlaClientService service(&client, &impl);
+  m_clock.CurrentTime(&time1);
+  Universe *universe = store.GetUniverseOrCreate(1);
+
+  SimpleRpcController controller;
+  ola::proto::DmxEncodingRequest request;
+  ola::proto::DmxEncodingReply reply;
+  request.add_encodings(ola::proto::DMX_RLE);
+  service.SetDmxEncodings(&controller, &request, &reply,
+                          NewCallback(&SharedMemorySetupDone));
+  CPPUNIT_ASSERT(!controller.Failed());
+  CPPUNIT_ASSERT_EQUAL(2, reply.encodings_size());
+  CPPUNIT_ASSERT_EQUAL(ola::proto::DMX_RLE, reply.encodings(0));
+  CPPUNIT_ASSERT_EQUAL(ola::proto::DMX_DELTA, reply.encodings(1));
+
+  const uint8_t rle_data[] = {0x85, 7};
+  ola::proto::DmxData data;
+  data.set_universe(1);
+  data.set_data(rle_data, sizeof(rle_data));
+  data.set_encoding(ola::proto::DMX_RLE);
+  data.set_length(5);
+  service.StreamDmxData(NULL, &data, NULL, NULL);
+  CPPUNIT_ASSERT_EQUAL(string("7,7,7,7,7"), universe->GetDMX().ToString());
+
+  const uint8_t delta_data[] = {1, 2, 9, 9};
+  data.set_data(delta_data, sizeof(delta_data));
+  data.set_encoding(ola::proto::DMX_DELTA);
+  service.StreamDmxData(NULL, &data, NULL, NULL);
+  CPPUNIT_ASSERT_EQUAL(string("7,9,9,7,7"), universe->GetDMX().ToString());
+
+  // frames for universes that don't exist are kept for the next delta
+  DmxBuffer frame;
+  frame.SetFromString("1,2,3");
+  data.set_universe(4);
+  data.set_data(frame.Get());
+  data.clear_encoding();
+  data.clear_length();
+  service.StreamDmxData(NULL, &data, NULL, NULL);
+  const uint8_t delta_data2[] = {0, 1, 5};
+  data.set_data(delta_data2, sizeof(delta_data2));
+  data.set_encoding(ola::proto::DMX_DELTA);
+  data.set_length(3);
+  service.StreamDmxData(NULL, &data, NULL, NULL);
+  CPPUNIT_ASSERT_EQUAL(string("5,2,3"), client.SourceData(4).Data().ToString());
+  CPPUNIT_ASSERT(!store.GetUniverse(4));
+
+  // bad data leaves the source empty
+  const uint8_t bad_delta[] = {9, 1, 1};
+  data.set_universe(1);
+  data.set_data(bad_delta, sizeof(bad_delta));
+  data.set_length(5);
+  service.StreamDmxData(NULL, &data, NULL, NULL);
+  CPPUNIT_ASSERT_EQUAL(0u, client.SourceData(1).Data().Size());
+}
+
+
 /*
  * Call the UpdateDmxDataCheck method
  * @param impl the OlaServerServiceImpl to use
@@ -61,6 +61,8 @@ typedef struct {
   int http_quit;
   int http_port;
   int rpc_port;
+  int use_epoll;
+  unsigned int plugin_threads;
   string http_data_dir;
   string config_dir;
 } ola_options;
@@ -178,8 +180,10 @@ static void DisplayHelp() {
   "  -r, --rpc-port           Port to listen for RPCs on (default " <<
     ola::OlaDaemon::DEFAULT_RPC_PORT << ")\n" <<
   "  -s, --syslog             Log to syslog rather than stderr.\n"
+  "  -t, --plugin-threads <n> Run network plugins in n threads (default 0)\n"
   "  --no-http                Don't run the http server\n"
   "  --no-http-quit           Disable the /quit handler\n"
+  "  --use-epoll              Use epoll() rather than select() for i/o\n"
   << endl;
 }
 
@@ -201,8 +205,10 @@ static bool ParseOptions(int argc, char *argv[], ola_options *opts) {
       {"no-daemon", no_argument, 0, 'f'},
       {"no-http", no_argument, &opts->httpd, 0},
       {"no-http-quit", no_argument, &opts->http_quit, 0},
+      {"plugin-threads", required_argument, 0, 't'},
       {"rpc-port", required_argument, 0, 'r'},
       {"syslog", no_argument, 0, 's'},
+      {"use-epoll", no_argument, &opts->use_epoll, 1},
       {0, 0, 0, 0}
     };
 
@@ -211,7 +217,7 @@ static bool ParseOptions(int argc, char *argv[], ola_options *opts) {
   int option_index = 0;
 
   while (1) {
-    c = getopt_long(argc, argv, "c:l:p:fd:hsr:", long_options, &option_index);
+    c = getopt_long(argc, argv, "c:l:p:fd:hsr:t:", long_options, &option_index);
     if (c == -1)
       break;
 
@@ -265,6 +271,9 @@ static bool ParseOptions(int argc, char *argv[], ola_options *opts) {
       case 'r':
         opts->rpc_port = atoi(optarg);
         break;
+      case 't':
+        opts->plugin_threads = atoi(optarg);
+        break;
       case '?':
         break;
       default:
@@ -361,6 +370,8 @@ static void Setup(int argc, char*argv[], ola_options *opts) {
   opts->http_quit = 1;
   opts->http_port = ola::OlaServer::DEFAULT_HTTP_PORT;
   opts->rpc_port = ola::OlaDaemon::DEFAULT_RPC_PORT;
+  opts->use_epoll = 0;
+  opts->plugin_threads = 0;
   opts->http_data_dir = "";
   opts->config_dir = "";
 
@@ -429,6 +440,8 @@ int main(int argc, char *argv[]) {
   ola_options.http_enable_quit = opts.http_quit;
   ola_options.http_port = opts.http_port;
   ola_options.http_data_dir = opts.http_data_dir;
+  ola_options.use_epoll = opts.use_epoll;
+  ola_options.plugin_threads = opts.plugin_threads;
 
   olad = new OlaDaemon(ola_options, &export_map, opts.rpc_port,
                        opts.config_dir);
@@ -0,0 +1,326 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * OutputScheduler.cpp
+ * Limits how often a universe writes to its outputs, and resends the last
+ * frame when a universe has been idle.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <map>
+#include <set>
+#include <string>
+#include "ola/Callback.h"
+#include "olad/OutputScheduler.h"
+#include "olad/Universe.h"
+
+namespace ola {
+
+using std::string;
+
+const char OutputScheduler::K_COALESCED_FRAMES_VAR[] =
+    "universe-coalesced-frames";
+const char OutputScheduler::K_DROPPED_FRAMES_VAR[] = "universe-dropped-frames";
+const char OutputScheduler::K_KEEPALIVE_FRAMES_VAR[] =
+    "universe-keepalive-frames";
+
+static const int USEC_IN_SECOND = 1000000;
+
+
+/*
+ * Create a new OutputScheduler
+ * @param scheduler the scheduler to register the timers with
+ * @param export_map the ExportMap to update, may be NULL
+ * @param clock the clock to use
+ */
+OutputScheduler::OutputScheduler(ola::thread::SchedulerInterface *scheduler,
+                                 ExportMap *export_map,
+                                 const Clock *clock)
+    : m_scheduler(scheduler),
+      m_export_map(export_map),
+      m_clock(clock) {
+  if (m_export_map) {
+    m_export_map->GetUIntIndexedMapVar(K_COALESCED_FRAMES_VAR, "universe");
+    m_export_map->GetUIntIndexedMapVar(K_DROPPED_FRAMES_VAR, "universe");
+    m_export_map->GetUIntIndexedMapVar(K_KEEPALIVE_FRAMES_VAR, "universe");
+  }
+}
+
+
+/*
+ * Remove all the timers.
+ */
+OutputScheduler::~OutputScheduler() {
+  TimerClassMap::iterator iter = m_rate_classes.begin();
+  for (; iter != m_rate_classes.end(); ++iter)
+    m_scheduler->RemoveTimeout(iter->second.timeout);
+  for (iter = m_keepalive_classes.begin(); iter != m_keepalive_classes.end();
+       ++iter)
+    m_scheduler->RemoveTimeout(iter->second.timeout);
+}
+
+
+/*
+ * Set the maximum rate a universe writes to its outputs.
+ * @param universe the universe to change
+ * @param frame_rate the max frames per second, 0 means unlimited.
+ */
+void OutputScheduler::SetMaxFrameRate(Universe *universe,
+                                      unsigned int frame_rate) {
+  universe_state *state = GetState(universe);
+  if (state->frame_rate == frame_rate)
+    return;
+
+  if (state->frame_rate)
+    LeaveRateClass(universe, state->frame_rate);
+  state->frame_rate = frame_rate;
+  if (frame_rate) {
+    JoinRateClass(universe, frame_rate);
+  } else if (state->pending) {
+    // nothing would flush this frame anymore
+    state->pending = false;
+    m_clock->CurrentTime(&state->last_write);
+    universe->WriteFrame();
+  }
+}
+
+
+/*
+ * Set how long a universe can be idle before the last frame is resent.
+ * @param universe the universe to change
+ * @param interval_ms the keepalive interval in ms, 0 disables the keepalive.
+ */
+void OutputScheduler::SetKeepAliveInterval(Universe *universe,
+                                           unsigned int interval_ms) {
+  universe_state *state = GetState(universe);
+  if (state->keepalive_ms == interval_ms)
+    return;
+
+  if (state->keepalive_ms)
+    LeaveKeepAliveClass(universe, state->keepalive_ms);
+  state->keepalive_ms = interval_ms;
+  if (interval_ms)
+    JoinKeepAliveClass(universe, interval_ms);
+}
+
+
+/*
+ * Stop tracking a universe, this is called when the universe is deleted.
+ */
+void OutputScheduler::RemoveUniverse(Universe *universe) {
+  UniverseStateMap::iterator iter = m_universes.find(universe);
+  if (iter == m_universes.end())
+    return;
+
+  if (iter->second.frame_rate)
+    LeaveRateClass(universe, iter->second.frame_rate);
+  if (iter->second.keepalive_ms)
+    LeaveKeepAliveClass(universe, iter->second.keepalive_ms);
+  m_universes.erase(iter);
+
+  if (m_export_map) {
+    const unsigned int universe_id = universe->UniverseId();
+    m_export_map->GetUIntIndexedMapVar(K_COALESCED_FRAMES_VAR)->Remove(
+        universe_id);
+    m_export_map->GetUIntIndexedMapVar(K_DROPPED_FRAMES_VAR)->Remove(
+        universe_id);
+    m_export_map->GetUIntIndexedMapVar(K_KEEPALIVE_FRAMES_VAR)->Remove(
+        universe_id);
+  }
+}
+
+
+/*
+ * Called when a universe has a new frame.
+ * @param universe the universe with new data
+ * @returns true if the universe should write the frame now, false if it'll be
+ *   written when the rate class timer next runs.
+ */
+bool OutputScheduler::FrameReady(Universe *universe) {
+  UniverseStateMap::iterator iter = m_universes.find(universe);
+  if (iter == m_universes.end())
+    return true;
+
+  universe_state &state = iter->second;
+  TimeStamp now;
+  m_clock->CurrentTime(&now);
+
+  if (state.frame_rate) {
+    if (state.pending) {
+      // the frame waiting to be sent has been replaced by this one
+      IncrementCounter(K_DROPPED_FRAMES_VAR, universe);
+      return false;
+    }
+
+    TimeInterval min_interval(0, USEC_IN_SECOND / state.frame_rate);
+    if (state.last_write.IsSet() && now - state.last_write < min_interval) {
+      state.pending = true;
+      IncrementCounter(K_COALESCED_FRAMES_VAR, universe);
+      return false;
+    }
+  }
+  state.last_write = now;
+  return true;
+}
+
+
+/*
+ * Lookup the state for a universe, creating it if required.
+ */
+OutputScheduler::universe_state *OutputScheduler::GetState(
+    Universe *universe) {
+  UniverseStateMap::iterator iter = m_universes.find(universe);
+  if (iter != m_universes.end())
+    return &iter->second;
+
+  universe_state &state = m_universes[universe];
+  state.frame_rate = 0;
+  state.keepalive_ms = 0;
+  state.pending = false;
+  return &state;
+}
+
+
+/*
+ * Add a universe to a rate class, creating the timer for the class if this is
+ * the first universe.
+ */
+void OutputScheduler::JoinRateClass(Universe *universe,
+                                    unsigned int frame_rate) {
+  TimerClassMap::iterator iter = m_rate_classes.find(frame_rate);
+  if (iter == m_rate_classes.end()) {
+    timer_class &rate_class = m_rate_classes[frame_rate];
+    rate_class.timeout = m_scheduler->RegisterRepeatingTimeout(
+        TimeInterval(0, USEC_IN_SECOND / frame_rate),
+        NewCallback(this, &OutputScheduler::FlushRateClass, frame_rate),
+        ola::thread::FIXED_RATE);
+    iter = m_rate_classes.find(frame_rate);
+  }
+  iter->second.universes.insert(universe);
+}
+
+
+/*
+ * Remove a universe from a rate class, the timer is removed once the class is
+ * empty.
+ */
+void OutputScheduler::LeaveRateClass(Universe *universe,
+                                     unsigned int frame_rate) {
+  TimerClassMap::iterator iter = m_rate_classes.find(frame_rate);
+  if (iter == m_rate_classes.end())
+    return;
+
+  iter->second.universes.erase(universe);
+  if (iter->second.universes.empty()) {
+    m_scheduler->RemoveTimeout(iter->second.timeout);
+    m_rate_classes.erase(iter);
+  }
+}
+
+
+/*
+ * Add a universe to a keepalive class, creating the timer for the class if
+ * this is the first universe.
+ */
+void OutputScheduler::JoinKeepAliveClass(Universe *universe,
+                                         unsigned int interval_ms) {
+  TimerClassMap::iterator iter = m_keepalive_classes.find(interval_ms);
+  if (iter == m_keepalive_classes.end()) {
+    unsigned int check_interval = interval_ms / KEEPALIVE_CHECKS_PER_INTERVAL;
+    timer_class &keepalive_class = m_keepalive_classes[interval_ms];
+    keepalive_class.timeout = m_scheduler->RegisterRepeatingTimeout(
+        check_interval ? check_interval : 1,
+        NewCallback(this, &OutputScheduler::RefreshKeepAliveClass,
+                    interval_ms));
+    iter = m_keepalive_classes.find(interval_ms);
+  }
+  iter->second.universes.insert(universe);
+}
+
+
+/*
+ * Remove a universe from a keepalive class, the timer is removed once the
+ * class is empty.
+ */
+void OutputScheduler::LeaveKeepAliveClass(Universe *universe,
+                                          unsigned int interval_ms) {
+  TimerClassMap::iterator iter = m_keepalive_classes.find(interval_ms);
+  if (iter == m_keepalive_classes.end())
+    return;
+
+  iter->second.universes.erase(universe);
+  if (iter->second.universes.empty()) {
+    m_scheduler->RemoveTimeout(iter->second.timeout);
+    m_keepalive_classes.erase(iter);
+  }
+}
+
+
+/*
+ * Write the pending frame for each universe in a rate class.
+ */
+bool OutputScheduler::FlushRateClass(unsigned int frame_rate) {
+  TimerClassMap::iterator class_iter = m_rate_classes.find(frame_rate);
+  if (class_iter == m_rate_classes.end())
+    return true;
+
+  TimeStamp now;
+  m_clock->CurrentTime(&now);
+  UniverseSet::iterator iter = class_iter->second.universes.begin();
+  for (; iter != class_iter->second.universes.end(); ++iter) {
+    universe_state &state = m_universes[*iter];
+    if (!state.pending)
+      continue;
+    state.pending = false;
+    state.last_write = now;
+    (*iter)->WriteFrame();
+  }
+  return true;
+}
+
+
+/*
+ * Resend the last frame for each universe in a keepalive class that hasn't
+ * written anything for the keepalive interval.
+ */
+bool OutputScheduler::RefreshKeepAliveClass(unsigned int interval_ms) {
+  TimerClassMap::iterator class_iter = m_keepalive_classes.find(interval_ms);
+  if (class_iter == m_keepalive_classes.end())
+    return true;
+
+  TimeStamp now;
+  m_clock->CurrentTime(&now);
+  TimeInterval interval(static_cast<int64_t>(interval_ms) * 1000);
+  UniverseSet::iterator iter = class_iter->second.universes.begin();
+  for (; iter != class_iter->second.universes.end(); ++iter) {
+    universe_state &state = m_universes[*iter];
+    // universes that have never had data aren't refreshed
+    if (state.pending || !state.last_write.IsSet() ||
+        now - state.last_write < interval)
+      continue;
+    state.last_write = now;
+    if ((*iter)->RefreshOutputs())
+      IncrementCounter(K_KEEPALIVE_FRAMES_VAR, *iter);
+  }
+  return true;
+}
+
+
+void OutputScheduler::IncrementCounter(const char *var,
+                                       const Universe *universe) {
+  if (m_export_map)
+    (*m_export_map->GetUIntIndexedMapVar(var))[universe->UniverseId()]++;
+}
+}  // ola
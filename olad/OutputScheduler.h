@@ -0,0 +1,97 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * OutputScheduler.h
+ * Limits how often a universe writes to its outputs, and resends the last
+ * frame when a universe has been idle.
+ * Copyright (C) 2012 Simon Newton
+ *
+ * Universes with the same max frame rate share a single timer, as do
+ * universes with the same keepalive interval.
+ */
+
+#ifndef OLAD_OUTPUTSCHEDULER_H_
+#define OLAD_OUTPUTSCHEDULER_H_
+
+#include <map>
+#include <set>
+#include "ola/Clock.h"
+#include "ola/ExportMap.h"
+#include "ola/thread/SchedulerInterface.h"
+
+namespace ola {
+
+class Universe;
+
+class OutputScheduler {
+  public:
+    OutputScheduler(ola::thread::SchedulerInterface *scheduler,
+                    ExportMap *export_map,
+                    const Clock *clock);
+    ~OutputScheduler();
+
+    void SetMaxFrameRate(Universe *universe, unsigned int frame_rate);
+    void SetKeepAliveInterval(Universe *universe, unsigned int interval_ms);
+    void RemoveUniverse(Universe *universe);
+
+    bool FrameReady(Universe *universe);
+
+    static const char K_COALESCED_FRAMES_VAR[];
+    static const char K_DROPPED_FRAMES_VAR[];
+    static const char K_KEEPALIVE_FRAMES_VAR[];
+
+  private:
+    typedef struct {
+      unsigned int frame_rate;
+      unsigned int keepalive_ms;
+      TimeStamp last_write;
+      bool pending;
+    } universe_state;
+
+    typedef std::set<Universe*> UniverseSet;
+
+    typedef struct {
+      ola::thread::timeout_id timeout;
+      UniverseSet universes;
+    } timer_class;
+
+    typedef std::map<Universe*, universe_state> UniverseStateMap;
+    typedef std::map<unsigned int, timer_class> TimerClassMap;
+
+    ola::thread::SchedulerInterface *m_scheduler;
+    ExportMap *m_export_map;
+    const Clock *m_clock;
+    UniverseStateMap m_universes;
+    TimerClassMap m_rate_classes;  // keyed by frames per second
+    TimerClassMap m_keepalive_classes;  // keyed by ms
+
+    universe_state *GetState(Universe *universe);
+    void JoinRateClass(Universe *universe, unsigned int frame_rate);
+    void LeaveRateClass(Universe *universe, unsigned int frame_rate);
+    void JoinKeepAliveClass(Universe *universe, unsigned int interval_ms);
+    void LeaveKeepAliveClass(Universe *universe, unsigned int interval_ms);
+    bool FlushRateClass(unsigned int frame_rate);
+    bool RefreshKeepAliveClass(unsigned int interval_ms);
+    void IncrementCounter(const char *var, const Universe *universe);
+
+    OutputScheduler(const OutputScheduler&);
+    OutputScheduler& operator=(const OutputScheduler&);
+
+    // how often the keepalive timers check for idle universes, as a fraction
+    // of the keepalive interval
+    static const unsigned int KEEPALIVE_CHECKS_PER_INTERVAL = 4;
+};
+}  // ola
+#endif  // OLAD_OUTPUTSCHEDULER_H_
@@ -0,0 +1,358 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * OutputSchedulerTest.cpp
+ * Test fixture for the OutputScheduler class
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <set>
+#include <string>
+
+#include "ola/Callback.h"
+#include "ola/Clock.h"
+#include "ola/DmxBuffer.h"
+#include "ola/ExportMap.h"
+#include "ola/thread/SchedulerInterface.h"
+#include "olad/OutputScheduler.h"
+#include "olad/Preferences.h"
+#include "olad/TestCommon.h"
+#include "olad/Universe.h"
+#include "olad/UniverseStore.h"
+
+using ola::AbstractDevice;
+using ola::DmxBuffer;
+using ola::ExportMap;
+using ola::MockClock;
+using ola::OutputScheduler;
+using ola::TimeInterval;
+using ola::Universe;
+using ola::thread::timeout_id;
+using std::set;
+using std::string;
+
+
+/*
+ * A scheduler which only runs the timers when asked to.
+ */
+class MockScheduler: public ola::thread::SchedulerInterface {
+  public:
+    timeout_id RegisterRepeatingTimeout(unsigned int ms,
+                                        ola::Callback0<bool> *closure) {
+      m_timers.insert(closure);
+      (void) ms;
+      return closure;
+    }
+
+    timeout_id RegisterRepeatingTimeout(const TimeInterval &interval,
+                                        ola::Callback0<bool> *closure,
+                                        ola::thread::TimerMode mode) {
+      m_timers.insert(closure);
+      m_last_interval = interval;
+      (void) mode;
+      return closure;
+    }
+
+    timeout_id RegisterSingleTimeout(unsigned int ms,
+                                     ola::SingleUseCallback0<void> *closure) {
+      delete closure;
+      (void) ms;
+      return ola::thread::INVALID_TIMEOUT;
+    }
+
+    void RemoveTimeout(timeout_id id) {
+      ola::Callback0<bool> *closure = static_cast<ola::Callback0<bool>*>(id);
+      m_timers.erase(closure);
+      delete closure;
+    }
+
+    unsigned int TimerCount() const { return m_timers.size(); }
+    const TimeInterval &LastInterval() const { return m_last_interval; }
+
+    void RunTimers() {
+      set<ola::Callback0<bool>*>::iterator iter = m_timers.begin();
+      for (; iter != m_timers.end(); ++iter)
+        (*iter)->Run();
+    }
+
+  private:
+    set<ola::Callback0<bool>*> m_timers;
+    TimeInterval m_last_interval;
+};
+
+
+/*
+ * An output port which counts the frames it was given
+ */
+class CountingOutputPort: public TestMockOutputPort {
+  public:
+    CountingOutputPort(AbstractDevice *parent, unsigned int port_id):
+      TestMockOutputPort(parent, port_id),
+      m_writes(0) {
+    }
+
+    bool WriteDMX(const DmxBuffer &buffer, uint8_t priority) {
+      m_writes++;
+      return TestMockOutputPort::WriteDMX(buffer, priority);
+    }
+
+    unsigned int m_writes;
+};
+
+
+class OutputSchedulerTest: public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(OutputSchedulerTest);
+  CPPUNIT_TEST(testRateLimit);
+  CPPUNIT_TEST(testMaxFrameRate);
+  CPPUNIT_TEST(testSharedTimers);
+  CPPUNIT_TEST(testKeepAlive);
+  CPPUNIT_TEST(testPreferences);
+  CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void setUp();
+    void tearDown();
+    void testRateLimit();
+    void testMaxFrameRate();
+    void testSharedTimers();
+    void testKeepAlive();
+    void testPreferences();
+
+  private:
+    MockScheduler m_scheduler;
+    MockClock m_clock;
+    ExportMap m_export_map;
+    OutputScheduler *m_output_scheduler;
+    ola::UniverseStore *m_store;
+
+    unsigned int Counter(const char *var) {
+      return (*m_export_map.GetUIntIndexedMapVar(var))[1];
+    }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(OutputSchedulerTest);
+
+
+void OutputSchedulerTest::setUp() {
+  m_output_scheduler = new OutputScheduler(&m_scheduler, &m_export_map,
+                                           &m_clock);
+  m_store = new ola::UniverseStore(NULL, NULL);
+}
+
+
+void OutputSchedulerTest::tearDown() {
+  delete m_store;
+  delete m_output_scheduler;
+  CPPUNIT_ASSERT_EQUAL(0u, m_scheduler.TimerCount());
+}
+
+
+/*
+ * Check frames that arrive faster than the max rate are coalesced.
+ */
+void OutputSchedulerTest::testRateLimit() {
+  Universe *universe = m_store->GetUniverseOrCreate(1);
+  universe->SetOutputScheduler(m_output_scheduler);
+  universe->SetMaxFrameRate(10);
+  CPPUNIT_ASSERT_EQUAL(1u, m_scheduler.TimerCount());
+
+  CountingOutputPort port(NULL, 1);
+  universe->AddPort(&port);
+
+  DmxBuffer frame1, frame2, frame3;
+  frame1.SetFromString("1,2,3");
+  frame2.SetFromString("4,5,6");
+  frame3.SetFromString("7,8,9");
+
+  // the first frame is written immediately
+  universe->SetDMX(frame1);
+  CPPUNIT_ASSERT_EQUAL(1u, port.m_writes);
+
+  // the next one is held until the timer runs
+  m_clock.AdvanceTime(TimeInterval(0, 10000));
+  universe->SetDMX(frame2);
+  CPPUNIT_ASSERT_EQUAL(1u, port.m_writes);
+  CPPUNIT_ASSERT_EQUAL(1u, Counter(OutputScheduler::K_COALESCED_FRAMES_VAR));
+
+  // and replaced by this one
+  universe->SetDMX(frame3);
+  CPPUNIT_ASSERT_EQUAL(1u, port.m_writes);
+  CPPUNIT_ASSERT_EQUAL(1u, Counter(OutputScheduler::K_DROPPED_FRAMES_VAR));
+
+  m_clock.AdvanceTime(TimeInterval(0, 90000));
+  m_scheduler.RunTimers();
+  CPPUNIT_ASSERT_EQUAL(2u, port.m_writes);
+  CPPUNIT_ASSERT(frame3 == port.ReadDMX());
+
+  // nothing is pending now
+  m_scheduler.RunTimers();
+  CPPUNIT_ASSERT_EQUAL(2u, port.m_writes);
+
+  // once the period has passed, frames are written immediately again
+  m_clock.AdvanceTime(TimeInterval(0, 200000));
+  universe->SetDMX(frame1);
+  CPPUNIT_ASSERT_EQUAL(3u, port.m_writes);
+  CPPUNIT_ASSERT(frame1 == port.ReadDMX());
+
+  // removing the limit writes any pending frame
+  m_clock.AdvanceTime(TimeInterval(0, 10000));
+  universe->SetDMX(frame2);
+  CPPUNIT_ASSERT_EQUAL(3u, port.m_writes);
+  universe->SetMaxFrameRate(0);
+  CPPUNIT_ASSERT_EQUAL(4u, port.m_writes);
+  CPPUNIT_ASSERT(frame2 == port.ReadDMX());
+  CPPUNIT_ASSERT_EQUAL(0u, m_scheduler.TimerCount());
+
+  universe->RemovePort(&port);
+}
+
+
+/*
+ * Check rates that are too fast for the timers are limited.
+ */
+void OutputSchedulerTest::testMaxFrameRate() {
+  Universe *universe = m_store->GetUniverseOrCreate(1);
+  universe->SetOutputScheduler(m_output_scheduler);
+
+  universe->SetMaxFrameRate(Universe::MAX_FRAME_RATE);
+  CPPUNIT_ASSERT_EQUAL(Universe::MAX_FRAME_RATE, universe->MaxFrameRate());
+  CPPUNIT_ASSERT_EQUAL(static_cast<int64_t>(1000),
+                       m_scheduler.LastInterval().AsInt());
+  universe->SetMaxFrameRate(0);
+
+  // 2,000,000 fps would be a 0us interval
+  universe->SetMaxFrameRate(2000000);
+  CPPUNIT_ASSERT_EQUAL(Universe::MAX_FRAME_RATE, universe->MaxFrameRate());
+  CPPUNIT_ASSERT_EQUAL(1u, m_scheduler.TimerCount());
+  CPPUNIT_ASSERT_EQUAL(static_cast<int64_t>(1000),
+                       m_scheduler.LastInterval().AsInt());
+
+  universe->SetMaxFrameRate(0);
+  CPPUNIT_ASSERT_EQUAL(0u, m_scheduler.TimerCount());
+}
+
+
+/*
+ * Check universes with the same rate share a timer.
+ */
+void OutputSchedulerTest::testSharedTimers() {
+  Universe *universe1 = m_store->GetUniverseOrCreate(1);
+  Universe *universe2 = m_store->GetUniverseOrCreate(2);
+  Universe *universe3 = m_store->GetUniverseOrCreate(3);
+  universe1->SetOutputScheduler(m_output_scheduler);
+  universe2->SetOutputScheduler(m_output_scheduler);
+  universe3->SetOutputScheduler(m_output_scheduler);
+  CPPUNIT_ASSERT_EQUAL(0u, m_scheduler.TimerCount());
+
+  universe1->SetMaxFrameRate(40);
+  universe2->SetMaxFrameRate(40);
+  CPPUNIT_ASSERT_EQUAL(1u, m_scheduler.TimerCount());
+  universe3->SetMaxFrameRate(20);
+  CPPUNIT_ASSERT_EQUAL(2u, m_scheduler.TimerCount());
+
+  universe1->SetKeepAliveInterval(1000);
+  universe2->SetKeepAliveInterval(1000);
+  universe3->SetKeepAliveInterval(4000);
+  CPPUNIT_ASSERT_EQUAL(4u, m_scheduler.TimerCount());
+
+  universe1->SetMaxFrameRate(0);
+  CPPUNIT_ASSERT_EQUAL(4u, m_scheduler.TimerCount());
+  universe2->SetMaxFrameRate(20);
+  CPPUNIT_ASSERT_EQUAL(3u, m_scheduler.TimerCount());
+
+  // detaching a universe removes it from its classes
+  universe3->SetOutputScheduler(NULL);
+  CPPUNIT_ASSERT_EQUAL(2u, m_scheduler.TimerCount());
+}
+
+
+/*
+ * Check idle universes resend their last frame.
+ */
+void OutputSchedulerTest::testKeepAlive() {
+  Universe *universe = m_store->GetUniverseOrCreate(1);
+  universe->SetOutputScheduler(m_output_scheduler);
+  universe->SetKeepAliveInterval(1000);
+  CPPUNIT_ASSERT_EQUAL(1u, m_scheduler.TimerCount());
+
+  CountingOutputPort port(NULL, 1);
+  universe->AddPort(&port);
+
+  // nothing is sent until the universe has data
+  m_clock.AdvanceTime(TimeInterval(2, 0));
+  m_scheduler.RunTimers();
+  CPPUNIT_ASSERT_EQUAL(0u, port.m_writes);
+
+  DmxBuffer frame;
+  frame.SetFromString("1,2,3");
+  universe->SetDMX(frame);
+  CPPUNIT_ASSERT_EQUAL(1u, port.m_writes);
+
+  m_clock.AdvanceTime(TimeInterval(0, 500000));
+  m_scheduler.RunTimers();
+  CPPUNIT_ASSERT_EQUAL(1u, port.m_writes);
+
+  m_clock.AdvanceTime(TimeInterval(0, 500000));
+  m_scheduler.RunTimers();
+  CPPUNIT_ASSERT_EQUAL(2u, port.m_writes);
+  CPPUNIT_ASSERT(frame == port.ReadDMX());
+  CPPUNIT_ASSERT_EQUAL(1u, Counter(OutputScheduler::K_KEEPALIVE_FRAMES_VAR));
+
+  // the keepalive restarts the interval
+  m_scheduler.RunTimers();
+  CPPUNIT_ASSERT_EQUAL(2u, port.m_writes);
+
+  // new data also restarts it
+  m_clock.AdvanceTime(TimeInterval(0, 900000));
+  universe->SetDMX(frame);
+  CPPUNIT_ASSERT_EQUAL(3u, port.m_writes);
+  m_clock.AdvanceTime(TimeInterval(0, 500000));
+  m_scheduler.RunTimers();
+  CPPUNIT_ASSERT_EQUAL(3u, port.m_writes);
+
+  universe->RemovePort(&port);
+}
+
+
+/*
+ * Check the UniverseStore loads and saves the settings.
+ */
+void OutputSchedulerTest::testPreferences() {
+  ola::MemoryPreferences preferences("foo");
+  preferences.SetValue("uni_1_max_fps", "30");
+  preferences.SetValue("uni_1_keepalive_ms", "4000");
+
+  ola::UniverseStore *store = new ola::UniverseStore(&preferences, NULL,
+                                                     &m_scheduler);
+  Universe *universe = store->GetUniverseOrCreate(1);
+  CPPUNIT_ASSERT_EQUAL(30u, universe->MaxFrameRate());
+  CPPUNIT_ASSERT_EQUAL(4000u, universe->KeepAliveInterval());
+  CPPUNIT_ASSERT_EQUAL(2u, m_scheduler.TimerCount());
+
+  // the keepalive is on by default
+  universe = store->GetUniverseOrCreate(2);
+  CPPUNIT_ASSERT_EQUAL(0u, universe->MaxFrameRate());
+  CPPUNIT_ASSERT_EQUAL(1000u, universe->KeepAliveInterval());
+  CPPUNIT_ASSERT_EQUAL(3u, m_scheduler.TimerCount());
+  universe->SetMaxFrameRate(25);
+
+  delete store;
+  CPPUNIT_ASSERT_EQUAL(0u, m_scheduler.TimerCount());
+  CPPUNIT_ASSERT_EQUAL(string("25"), preferences.GetValue("uni_2_max_fps"));
+  CPPUNIT_ASSERT_EQUAL(string("1000"),
+                       preferences.GetValue("uni_2_keepalive_ms"));
+}
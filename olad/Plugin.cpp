@@ -38,6 +38,20 @@ bool Plugin::ShouldStart() {
   return !(m_preferences->GetValue(ENABLED_KEY) == "false");
 }
 
+/*
+ * Move this plugin to a different PluginAdaptor. This is used to place a
+ * plugin in a PluginShard, it has no effect once the plugin is running.
+ * @param plugin_adaptor the new PluginAdaptor
+ */
+void Plugin::SetPluginAdaptor(PluginAdaptor *plugin_adaptor) {
+  if (m_enabled) {
+    OLA_WARN << Name() << " is running, not changing the PluginAdaptor";
+    return;
+  }
+  m_plugin_adaptor = plugin_adaptor;
+}
+
+
 /*
  * Start the plugin. Calls start_hook() which can be over-ridden by the
  * derrived classes.
@@ -35,15 +35,24 @@ using ola::network::SelectServerInterface;
  * @param device_manager  pointer to a DeviceManager object
  * @param select_server pointer to the SelectServer object
  * @param preferences_factory pointer to the PreferencesFactory object
+ * @param port_broker pointer to the PortBroker object
+ * @param main_executor if the plugins run in a PluginShard, this is used to
+ *   run closures in the main thread. NULL means select_server is the main
+ *   SelectServer.
+ * @param export_map the ExportMap plugins can add variables to, may be NULL.
  */
 PluginAdaptor::PluginAdaptor(DeviceManager *device_manager,
                              SelectServerInterface *select_server,
                              PreferencesFactory *preferences_factory,
-                             PortBrokerInterface *port_broker):
+                             PortBrokerInterface *port_broker,
+                             ola::thread::ExecutorInterface *main_executor,
+                             ExportMap *export_map):
   m_device_manager(device_manager),
   m_ss(select_server),
   m_preferences_factory(preferences_factory),
-  m_port_broker(port_broker) {
+  m_port_broker(port_broker),
+  m_main_executor(main_executor),
+  m_export_map(export_map) {
 }
 
 
@@ -118,6 +127,21 @@ timeout_id PluginAdaptor::RegisterRepeatingTimeout(
 }
 
 
+/*
+ * Register a repeating timeout
+ * @param interval the time between function calls
+ * @param closure the OlaClosure to call when the timeout expires
+ * @param mode FIXED_RATE or FIXED_DELAY
+ * @return a timeout_id on success or K_INVALID_TIMEOUT on failure
+ */
+timeout_id PluginAdaptor::RegisterRepeatingTimeout(
+    const TimeInterval &interval,
+    Callback0<bool> *closure,
+    ola::thread::TimerMode mode) {
+  return m_ss->RegisterRepeatingTimeout(interval, closure, mode);
+}
+
+
 /*
  * Register a single timeout
  * @param ms the time between function calls
@@ -141,7 +165,29 @@ void PluginAdaptor::RemoveTimeout(timeout_id id) {
 
 
 /*
- * Execute a closure in the main thread.
+ * Name a descriptor or timeout so the time its callbacks take is recorded.
+ */
+void PluginAdaptor::SetReadDescriptorName(
+    ola::network::ReadFileDescriptor *descriptor,
+    const string &name) {
+  m_ss->SetReadDescriptorName(descriptor, name);
+}
+
+
+void PluginAdaptor::SetWriteDescriptorName(
+    ola::network::WriteFileDescriptor *descriptor,
+    const string &name) {
+  m_ss->SetWriteDescriptorName(descriptor, name);
+}
+
+
+void PluginAdaptor::SetTimeoutName(timeout_id id, const string &name) {
+  m_ss->SetTimeoutName(id, name);
+}
+
+
+/*
+ * Execute a closure in the thread the plugin runs in.
  * @param closure the closure to execute.
  */
 void PluginAdaptor::Execute(ola::BaseCallback0<void> *closure) {
@@ -149,6 +195,31 @@ void PluginAdaptor::Execute(ola::BaseCallback0<void> *closure) {
 }
 
 
+/*
+ * Execute a closure in the thread the plugin runs in. This is the same as
+ * Execute() but can be used from const methods.
+ * @param closure the closure to execute.
+ */
+void PluginAdaptor::ExecuteInPluginThread(
+    ola::BaseCallback0<void> *closure) const {
+  m_ss->Execute(closure);
+}
+
+
+/*
+ * Execute a closure in the main olad thread, which owns the universes and
+ * clients.
+ * @param closure the closure to execute.
+ */
+void PluginAdaptor::ExecuteInMainThread(
+    ola::BaseCallback0<void> *closure) const {
+  if (m_main_executor)
+    m_main_executor->Execute(closure);
+  else
+    m_ss->Execute(closure);
+}
+
+
 /*
  * Register a device
  * @param dev  the device to register
@@ -29,10 +29,20 @@ namespace ola {
 
 using std::vector;
 
+/*
+ * Create a new PluginManager
+ * @param plugin_loaders the loaders to fetch plugins from
+ * @param plugin_adaptor the PluginAdaptor for plugins in the main thread
+ * @param shard_adaptors the PluginAdaptors of the PluginShards, plugins that
+ *   support it are spread across these. If empty all plugins run in the main
+ *   thread.
+ */
 PluginManager::PluginManager(const vector<PluginLoader*> &plugin_loaders,
-                             class PluginAdaptor *plugin_adaptor)
+                             class PluginAdaptor *plugin_adaptor,
+                             const vector<PluginAdaptor*> &shard_adaptors)
     : m_plugin_loaders(plugin_loaders),
-      m_plugin_adaptor(plugin_adaptor) {
+      m_plugin_adaptor(plugin_adaptor),
+      m_shard_adaptors(shard_adaptors) {
 }
 
 
@@ -63,6 +73,7 @@ void PluginManager::LoadAll() {
     }
   }
 
+  unsigned int next_shard = 0;
   for (plugin_iter = m_plugins.begin(); plugin_iter != m_plugins.end();
        ++plugin_iter) {
     if (!(*plugin_iter)->ShouldStart()) {
@@ -71,6 +82,13 @@ void PluginManager::LoadAll() {
       continue;
     }
 
+    if (!m_shard_adaptors.empty() && (*plugin_iter)->SupportsShards()) {
+      unsigned int shard = next_shard++ % m_shard_adaptors.size();
+      OLA_INFO << "Running " << (*plugin_iter)->Name() << " in plugin thread "
+        << shard;
+      (*plugin_iter)->SetPluginAdaptor(m_shard_adaptors[shard]);
+    }
+
     OLA_INFO << "Trying to start " << (*plugin_iter)->Name();
     if (!(*plugin_iter)->Start())
       OLA_WARN << "Failed to start " << (*plugin_iter)->Name();
@@ -34,7 +34,9 @@ class AbstractPlugin;
 class PluginManager {
   public:
     PluginManager(const vector<PluginLoader*> &plugin_loaders,
-                  PluginAdaptor *plugin_adaptor);
+                  PluginAdaptor *plugin_adaptor,
+                  const vector<PluginAdaptor*> &shard_adaptors =
+                    vector<PluginAdaptor*>());
     ~PluginManager();
 
     void LoadAll();
@@ -48,6 +50,7 @@ class PluginManager {
 
     vector<PluginLoader*> m_plugin_loaders;
     PluginAdaptor *m_plugin_adaptor;
+    vector<PluginAdaptor*> m_shard_adaptors;
     vector<AbstractPlugin*> m_plugins;
 };
 }  // ola
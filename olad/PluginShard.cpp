@@ -0,0 +1,391 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * PluginShard.cpp
+ * Runs plugins in their own SelectServer thread.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <string>
+#include <vector>
+
+#include "ola/Callback.h"
+#include "ola/Logging.h"
+#include "ola/rdm/UIDSet.h"
+#include "olad/Device.h"
+#include "olad/Plugin.h"
+#include "olad/PluginShard.h"
+
+namespace ola {
+
+using ola::network::SelectServer;
+using ola::rdm::RDMCallback;
+using ola::rdm::RDMDiscoveryCallback;
+using ola::rdm::UIDSet;
+using ola::thread::MutexLocker;
+
+
+/*
+ * Create a new PluginShard
+ * @param device_manager the DeviceManager to register devices with
+ * @param preferences_factory the PreferencesFactory for the plugins
+ * @param port_broker the PortBroker
+ * @param main_executor the executor for the main olad thread
+ * @param poller_type the type of poller for this shard's SelectServer
+ */
+PluginShard::PluginShard(DeviceManager *device_manager,
+                         PreferencesFactory *preferences_factory,
+                         PortBrokerInterface *port_broker,
+                         ola::thread::ExecutorInterface *main_executor,
+                         SelectServer::PollerType poller_type)
+    : m_ss(NULL, NULL, poller_type),
+      m_plugin_adaptor(device_manager,
+                       &m_ss,
+                       preferences_factory,
+                       port_broker,
+                       main_executor),
+      m_started(false),
+      m_pause_depth(0),
+      m_pause_requested(false),
+      m_parked(false) {
+}
+
+
+/*
+ * Clean up, this stops the thread if it's running.
+ */
+PluginShard::~PluginShard() {
+  Stop();
+}
+
+
+/*
+ * Start the shard's thread.
+ * @returns true if the thread is running, false otherwise.
+ */
+bool PluginShard::Start() {
+  if (!m_started)
+    m_started = ola::thread::Thread::Start();
+  return m_started;
+}
+
+
+/*
+ * Stop the thread. Any closures already queued with Execute() are run before
+ * the SelectServer exits so nothing is left behind that refers to the ports.
+ */
+void PluginShard::Stop() {
+  if (!m_started)
+    return;
+
+  m_ss.Execute(NewSingleCallback(&m_ss, &SelectServer::Terminate));
+  Join();
+  m_started = false;
+}
+
+
+/*
+ * Block until the shard's thread is parked. Pauses nest, the thread runs
+ * again once Resume() has been called the same number of times. This must
+ * only be called from the main thread.
+ */
+void PluginShard::Pause() {
+  if (!m_started)
+    return;
+  if (m_pause_depth++)
+    return;
+
+  {
+    MutexLocker locker(&m_pause_mutex);
+    m_pause_requested = true;
+  }
+  m_ss.Execute(NewSingleCallback(this, &PluginShard::Park));
+
+  MutexLocker locker(&m_pause_mutex);
+  while (!m_parked)
+    m_pause_condition.Wait(&m_pause_mutex);
+}
+
+
+/*
+ * Let the shard's thread run again.
+ */
+void PluginShard::Resume() {
+  if (!m_pause_depth)
+    return;
+  if (--m_pause_depth)
+    return;
+
+  MutexLocker locker(&m_pause_mutex);
+  m_pause_requested = false;
+  m_pause_condition.Broadcast();
+}
+
+
+/*
+ * Run the SelectServer.
+ */
+void *PluginShard::Run() {
+  m_ss.Run();
+  return NULL;
+}
+
+
+/*
+ * Called in the shard's thread, this waits until Resume() is called.
+ */
+void PluginShard::Park() {
+  MutexLocker locker(&m_pause_mutex);
+  m_parked = true;
+  m_pause_condition.Broadcast();
+  while (m_pause_requested)
+    m_pause_condition.Wait(&m_pause_mutex);
+  m_parked = false;
+}
+
+
+/*
+ * Pause all shards.
+ * @param shards the shards to pause, may be NULL.
+ */
+ShardPauser::ShardPauser(const vector<PluginShard*> *shards)
+    : m_shards(shards) {
+  if (!m_shards)
+    return;
+  vector<PluginShard*>::const_iterator iter = m_shards->begin();
+  for (; iter != m_shards->end(); ++iter)
+    (*iter)->Pause();
+}
+
+
+ShardPauser::~ShardPauser() {
+  if (!m_shards)
+    return;
+  vector<PluginShard*>::const_iterator iter = m_shards->begin();
+  for (; iter != m_shards->end(); ++iter)
+    (*iter)->Resume();
+}
+
+
+/*
+ * Find the shard a port belongs to.
+ * @param port the port to check
+ * @returns the shard's PluginAdaptor or NULL if the port runs in the main
+ *   thread.
+ */
+const PluginAdaptor *PortShard(const Port *port) {
+  const AbstractDevice *device = port->GetDevice();
+  if (!device || !device->Owner())
+    return NULL;
+  const PluginAdaptor *adaptor = device->Owner()->GetPluginAdaptor();
+  return adaptor && adaptor->IsSharded() ? adaptor : NULL;
+}
+
+
+// The functions that run in the other thread. Arguments are passed by value
+// (or pointer) since the caller's references won't be valid by the time they
+// run.
+//-----------------------------------------------------------------------------
+
+static void WriteDMXInShard(OutputPort *port,
+                            DmxBuffer *buffer,
+                            uint8_t priority,
+                            dmx_change change) {
+  port->WriteDMX(*buffer, priority, change);
+  delete buffer;
+}
+
+
+static void WriteSlotPrioritiesInShard(OutputPort *port,
+                                       DmxBuffer *slot_priorities) {
+  port->WriteSlotPriorities(*slot_priorities);
+  delete slot_priorities;
+}
+
+
+static void UniverseNameChangedInShard(OutputPort *port, string name) {
+  port->UniverseNameChanged(name);
+}
+
+
+static void SendRDMRequestInShard(OutputPort *port,
+                                  const ola::rdm::RDMRequest *request,
+                                  RDMCallback *callback) {
+  port->SendRDMRequest(request, callback);
+}
+
+
+static void RunDiscoveryInShard(OutputPort *port,
+                                RDMDiscoveryCallback *on_complete,
+                                bool full) {
+  if (full)
+    port->RunFullDiscovery(on_complete);
+  else
+    port->RunIncrementalDiscovery(on_complete);
+}
+
+
+static void SendTimeCodeInShard(OutputPort *port,
+                                ola::timecode::TimeCode timecode) {
+  port->SendTimeCode(timecode);
+}
+
+
+static void RunRDMCallback(RDMCallback *callback,
+                           ola::rdm::rdm_response_code code,
+                           const ola::rdm::RDMResponse *response,
+                           vector<string> packets) {
+  callback->Run(code, response, packets);
+}
+
+
+static void RunDiscoveryCallback(RDMDiscoveryCallback *callback,
+                                 UIDSet uids) {
+  callback->Run(uids);
+}
+
+
+// These are run in the thread the callback was triggered in, they queue the
+// original callback in the other thread.
+static void RelayRDMResponse(const PluginAdaptor *shard,
+                             bool to_main,
+                             RDMCallback *callback,
+                             ola::rdm::rdm_response_code code,
+                             const ola::rdm::RDMResponse *response,
+                             const vector<string> &packets) {
+  BaseCallback0<void> *closure = NewSingleCallback(
+      &RunRDMCallback, callback, code, response, packets);
+  if (to_main)
+    shard->ExecuteInMainThread(closure);
+  else
+    shard->ExecuteInPluginThread(closure);
+}
+
+
+static void RelayDiscoveryResult(const PluginAdaptor *shard,
+                                 bool to_main,
+                                 RDMDiscoveryCallback *callback,
+                                 const UIDSet &uids) {
+  BaseCallback0<void> *closure = NewSingleCallback(
+      &RunDiscoveryCallback, callback, uids);
+  if (to_main)
+    shard->ExecuteInMainThread(closure);
+  else
+    shard->ExecuteInPluginThread(closure);
+}
+
+
+/*
+ * Write DMX data to a port in a shard.
+ */
+void ShardedWriteDMX(const PluginAdaptor *shard,
+                     OutputPort *port,
+                     const DmxBuffer &buffer,
+                     uint8_t priority,
+                     const dmx_change &change) {
+  DmxBuffer *copy = new DmxBuffer(buffer.GetRaw(), buffer.Size());
+  shard->ExecuteInPluginThread(
+      NewSingleCallback(&WriteDMXInShard, port, copy, priority, change));
+}
+
+
+/*
+ * Write per slot priorities to a port in a shard.
+ */
+void ShardedWriteSlotPriorities(const PluginAdaptor *shard,
+                                OutputPort *port,
+                                const DmxBuffer &slot_priorities) {
+  shard->ExecuteInPluginThread(NewSingleCallback(
+      &WriteSlotPrioritiesInShard, port, new DmxBuffer(slot_priorities)));
+}
+
+
+/*
+ * Notify a port in a shard that the universe name has changed.
+ */
+void ShardedUniverseNameChanged(const PluginAdaptor *shard,
+                                OutputPort *port,
+                                const string &name) {
+  shard->ExecuteInPluginThread(
+      NewSingleCallback(&UniverseNameChangedInShard, port, name));
+}
+
+
+/*
+ * Send a RDM request to a port in a shard. The callback is run in the main
+ * thread.
+ */
+void ShardedSendRDMRequest(const PluginAdaptor *shard,
+                           OutputPort *port,
+                           const ola::rdm::RDMRequest *request,
+                           RDMCallback *callback) {
+  shard->ExecuteInPluginThread(
+      NewSingleCallback(&SendRDMRequestInShard,
+                        port,
+                        request,
+                        RunInMainThread(shard, callback)));
+}
+
+
+/*
+ * Run RDM discovery on a port in a shard. The callback is run in the main
+ * thread.
+ */
+void ShardedRunDiscovery(const PluginAdaptor *shard,
+                         OutputPort *port,
+                         RDMDiscoveryCallback *on_complete,
+                         bool full) {
+  shard->ExecuteInPluginThread(
+      NewSingleCallback(&RunDiscoveryInShard,
+                        port,
+                        RunInMainThread(shard, on_complete),
+                        full));
+}
+
+
+/*
+ * Send timecode to a port in a shard.
+ */
+void ShardedSendTimeCode(const PluginAdaptor *shard,
+                         OutputPort *port,
+                         const ola::timecode::TimeCode &timecode) {
+  shard->ExecuteInPluginThread(
+      NewSingleCallback(&SendTimeCodeInShard, port, timecode));
+}
+
+
+RDMCallback *RunInPluginThread(const PluginAdaptor *shard,
+                               RDMCallback *callback) {
+  return NewSingleCallback(&RelayRDMResponse, shard, false, callback);
+}
+
+
+RDMCallback *RunInMainThread(const PluginAdaptor *shard,
+                             RDMCallback *callback) {
+  return NewSingleCallback(&RelayRDMResponse, shard, true, callback);
+}
+
+
+RDMDiscoveryCallback *RunInPluginThread(const PluginAdaptor *shard,
+                                        RDMDiscoveryCallback *callback) {
+  return NewSingleCallback(&RelayDiscoveryResult, shard, false, callback);
+}
+
+
+RDMDiscoveryCallback *RunInMainThread(const PluginAdaptor *shard,
+                                      RDMDiscoveryCallback *callback) {
+  return NewSingleCallback(&RelayDiscoveryResult, shard, true, callback);
+}
+}  // ola
@@ -0,0 +1,148 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * PluginShard.h
+ * Runs plugins in their own SelectServer thread.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#ifndef OLAD_PLUGINSHARD_H_
+#define OLAD_PLUGINSHARD_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "ola/DmxBuffer.h"
+#include "ola/network/SelectServer.h"
+#include "ola/rdm/RDMControllerInterface.h"
+#include "ola/thread/ExecutorInterface.h"
+#include "ola/thread/Mutex.h"
+#include "ola/thread/Thread.h"
+#include "ola/timecode/TimeCode.h"
+#include "olad/PluginAdaptor.h"
+#include "olad/Port.h"
+
+namespace ola {
+
+using std::string;
+using std::vector;
+
+/*
+ * A PluginShard is a thread with its own SelectServer and PluginAdaptor.
+ * Plugins that support it are spread across the shards so their socket i/o
+ * and timers don't compete with the main olad thread.
+ *
+ * The universes, clients & RPC service stay in the main thread. DMX data and
+ * RDM requests are passed between the two through each SelectServer's
+ * Execute() queue, see the Sharded* functions below. Anything else that
+ * touches a sharded plugin from the main thread, like patching a port, must
+ * hold a ShardPauser, which parks the shard threads until it's destroyed.
+ */
+class PluginShard: public ola::thread::Thread {
+  public:
+    PluginShard(class DeviceManager *device_manager,
+                class PreferencesFactory *preferences_factory,
+                class PortBrokerInterface *port_broker,
+                ola::thread::ExecutorInterface *main_executor,
+                ola::network::SelectServer::PollerType poller_type);
+    ~PluginShard();
+
+    PluginAdaptor *GetPluginAdaptor() { return &m_plugin_adaptor; }
+
+    bool Start();
+    void Stop();
+
+    void Pause();
+    void Resume();
+
+  protected:
+    void *Run();
+
+  private:
+    ola::network::SelectServer m_ss;
+    PluginAdaptor m_plugin_adaptor;
+    bool m_started;
+    unsigned int m_pause_depth;  // only used by the main thread
+    bool m_pause_requested;
+    bool m_parked;
+    ola::thread::Mutex m_pause_mutex;
+    ola::thread::ConditionVariable m_pause_condition;
+
+    void Park();
+
+    PluginShard(const PluginShard&);
+    PluginShard& operator=(const PluginShard&);
+};
+
+
+/*
+ * Pauses a set of PluginShards for as long as this object exists.
+ */
+class ShardPauser {
+  public:
+    explicit ShardPauser(const vector<PluginShard*> *shards);
+    ~ShardPauser();
+
+  private:
+    const vector<PluginShard*> *m_shards;
+
+    ShardPauser(const ShardPauser&);
+    ShardPauser& operator=(const ShardPauser&);
+};
+
+
+// Returns the PluginAdaptor if the port runs in a PluginShard, or NULL if it
+// runs in the main thread.
+const PluginAdaptor *PortShard(const Port *port);
+
+// These queue a call to an OutputPort in the port's shard. Any callbacks are
+// run in the main thread.
+void ShardedWriteDMX(const PluginAdaptor *shard,
+                     OutputPort *port,
+                     const DmxBuffer &buffer,
+                     uint8_t priority,
+                     const dmx_change &change);
+void ShardedWriteSlotPriorities(const PluginAdaptor *shard,
+                                OutputPort *port,
+                                const DmxBuffer &slot_priorities);
+void ShardedUniverseNameChanged(const PluginAdaptor *shard,
+                                OutputPort *port,
+                                const string &name);
+void ShardedSendRDMRequest(const PluginAdaptor *shard,
+                           OutputPort *port,
+                           const ola::rdm::RDMRequest *request,
+                           ola::rdm::RDMCallback *callback);
+void ShardedRunDiscovery(const PluginAdaptor *shard,
+                         OutputPort *port,
+                         ola::rdm::RDMDiscoveryCallback *on_complete,
+                         bool full);
+void ShardedSendTimeCode(const PluginAdaptor *shard,
+                         OutputPort *port,
+                         const ola::timecode::TimeCode &timecode);
+
+// Wrap a callback so that it runs in the plugin's or the main thread.
+ola::rdm::RDMCallback *RunInPluginThread(const PluginAdaptor *shard,
+                                         ola::rdm::RDMCallback *callback);
+ola::rdm::RDMCallback *RunInMainThread(const PluginAdaptor *shard,
+                                       ola::rdm::RDMCallback *callback);
+ola::rdm::RDMDiscoveryCallback *RunInPluginThread(
+    const PluginAdaptor *shard,
+    ola::rdm::RDMDiscoveryCallback *callback);
+ola::rdm::RDMDiscoveryCallback *RunInMainThread(
+    const PluginAdaptor *shard,
+    ola::rdm::RDMDiscoveryCallback *callback);
+}  // ola
+#endif  // OLAD_PLUGINSHARD_H_
@@ -0,0 +1,254 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * PluginShardTest.cpp
+ * Test fixture for the PluginShard class.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "ola/Callback.h"
+#include "ola/DmxBuffer.h"
+#include "ola/network/SelectServer.h"
+#include "ola/thread/Mutex.h"
+#include "ola/thread/Thread.h"
+#include "olad/PluginAdaptor.h"
+#include "olad/PluginShard.h"
+#include "olad/Preferences.h"
+#include "olad/TestCommon.h"
+#include "olad/Universe.h"
+#include "olad/UniverseStore.h"
+
+using ola::DmxBuffer;
+using ola::PluginAdaptor;
+using ola::PluginShard;
+using ola::Universe;
+using ola::network::SelectServer;
+using ola::thread::MutexLocker;
+using ola::thread::ThreadId;
+using std::string;
+
+
+/*
+ * An output port that records the thread WriteDMX() was called in.
+ */
+class ThreadCheckingOutputPort: public BasicOutputPort {
+  public:
+    ThreadCheckingOutputPort(AbstractDevice *parent, SelectServer *main_ss)
+        : BasicOutputPort(parent, 1),
+          m_main_ss(main_ss),
+          m_writes(0) {
+    }
+
+    string Description() const { return ""; }
+
+    bool WriteDMX(const DmxBuffer &buffer, uint8_t priority) {
+      {
+        MutexLocker locker(&m_mutex);
+        m_buffer.Set(buffer.GetRaw(), buffer.Size());
+        m_thread = ola::thread::Thread::Self();
+        m_writes++;
+      }
+      m_main_ss->Terminate();
+      (void) priority;
+      return true;
+    }
+
+    unsigned int Writes() {
+      MutexLocker locker(&m_mutex);
+      return m_writes;
+    }
+
+    DmxBuffer Buffer() {
+      MutexLocker locker(&m_mutex);
+      return DmxBuffer(m_buffer.GetRaw(), m_buffer.Size());
+    }
+
+    ThreadId WriteThread() {
+      MutexLocker locker(&m_mutex);
+      return m_thread;
+    }
+
+  private:
+    SelectServer *m_main_ss;
+    ola::thread::Mutex m_mutex;
+    DmxBuffer m_buffer;
+    ThreadId m_thread;
+    unsigned int m_writes;
+};
+
+
+class PluginShardTest: public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(PluginShardTest);
+  CPPUNIT_TEST(testOutputPort);
+  CPPUNIT_TEST(testInputPort);
+  CPPUNIT_TEST(testPause);
+  CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void setUp();
+    void tearDown();
+    void testOutputPort();
+    void testInputPort();
+    void testPause();
+
+  private:
+    SelectServer m_ss;
+    ola::MemoryPreferences *m_preferences;
+    ola::UniverseStore *m_store;
+    PluginShard *m_shard;
+    bool m_flag;
+
+    void SetFlag() { m_flag = true; }
+    void RunUntilTerminated();
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(PluginShardTest);
+
+static const unsigned int TEST_UNIVERSE = 1;
+
+
+void PluginShardTest::setUp() {
+  m_preferences = new ola::MemoryPreferences("foo");
+  m_store = new ola::UniverseStore(m_preferences, NULL);
+  m_shard = new PluginShard(NULL, NULL, NULL, &m_ss,
+                            SelectServer::SELECT_POLLER);
+  m_flag = false;
+}
+
+
+void PluginShardTest::tearDown() {
+  delete m_shard;
+  delete m_store;
+  delete m_preferences;
+}
+
+
+/*
+ * Run the main SelectServer until it's terminated, or a timeout expires.
+ */
+void PluginShardTest::RunUntilTerminated() {
+  m_ss.RegisterSingleTimeout(
+      2000,
+      ola::NewSingleCallback(&m_ss, &SelectServer::Terminate));
+  m_ss.Run();
+}
+
+
+/*
+ * Check that DMX data for a port in a shard is written in the shard's thread.
+ */
+void PluginShardTest::testOutputPort() {
+  TestMockPlugin plugin(m_shard->GetPluginAdaptor(), ola::OLA_PLUGIN_DUMMY);
+  MockDevice device(&plugin, "test device");
+  ThreadCheckingOutputPort port(&device, &m_ss);
+  CPPUNIT_ASSERT(ola::PortShard(&port));
+
+  Universe *universe = m_store->GetUniverseOrCreate(TEST_UNIVERSE);
+  universe->AddPort(&port);
+  port.SetUniverse(universe);
+
+  DmxBuffer buffer;
+  buffer.SetFromString("1,2,3,4,5");
+  universe->SetDMX(buffer);
+  // nothing is written until the shard runs
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, port.Writes());
+
+  CPPUNIT_ASSERT(m_shard->Start());
+  RunUntilTerminated();
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, port.Writes());
+  CPPUNIT_ASSERT(buffer == port.Buffer());
+  CPPUNIT_ASSERT(!pthread_equal(ola::thread::Thread::Self(),
+                                port.WriteThread()));
+  m_shard->Stop();
+
+  universe->RemovePort(&port);
+}
+
+
+/*
+ * Check that data from an input port in a shard reaches the universe.
+ */
+void PluginShardTest::testInputPort() {
+  TestMockPlugin plugin(m_shard->GetPluginAdaptor(), ola::OLA_PLUGIN_DUMMY);
+  MockDevice device(&plugin, "test device");
+  TestMockInputPort port(&device, 1, m_shard->GetPluginAdaptor());
+
+  // an output port in the main thread, this stops the SelectServer once the
+  // universe is updated.
+  ola::PluginAdaptor main_adaptor(NULL, &m_ss, NULL, NULL);
+  TestMockPlugin main_plugin(&main_adaptor, ola::OLA_PLUGIN_ARTNET);
+  MockDevice main_device(&main_plugin, "main device");
+  ThreadCheckingOutputPort output_port(&main_device, &m_ss);
+  CPPUNIT_ASSERT(!ola::PortShard(&output_port));
+
+  Universe *universe = m_store->GetUniverseOrCreate(TEST_UNIVERSE);
+  universe->AddPort(&port);
+  port.SetUniverse(universe);
+  universe->AddPort(&output_port);
+  output_port.SetUniverse(universe);
+
+  DmxBuffer buffer;
+  buffer.SetFromString("10,20,30");
+  port.WriteDMX(buffer);
+
+  CPPUNIT_ASSERT(m_shard->Start());
+  m_shard->GetPluginAdaptor()->Execute(
+      ola::NewSingleCallback(static_cast<BasicInputPort*>(&port),
+                             &BasicInputPort::DmxChanged));
+  RunUntilTerminated();
+  m_shard->Stop();
+
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, output_port.Writes());
+  CPPUNIT_ASSERT(buffer == universe->GetDMX());
+  CPPUNIT_ASSERT(pthread_equal(ola::thread::Thread::Self(),
+                               output_port.WriteThread()));
+
+  universe->RemovePort(&port);
+  universe->RemovePort(&output_port);
+}
+
+
+/*
+ * Check that nothing runs in the shard while it's paused.
+ */
+void PluginShardTest::testPause() {
+  CPPUNIT_ASSERT(m_shard->Start());
+  m_shard->Pause();
+  m_shard->GetPluginAdaptor()->Execute(
+      ola::NewSingleCallback(this, &PluginShardTest::SetFlag));
+  usleep(10000);
+  CPPUNIT_ASSERT(!m_flag);
+
+  // pauses nest
+  std::vector<PluginShard*> shards;
+  shards.push_back(m_shard);
+  {
+    ola::ShardPauser pauser(&shards);
+  }
+  usleep(10000);
+  CPPUNIT_ASSERT(!m_flag);
+
+  m_shard->Resume();
+  // Stop() runs everything that's queued
+  m_shard->Stop();
+  CPPUNIT_ASSERT(m_flag);
+}
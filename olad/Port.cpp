@@ -25,6 +25,7 @@
 #include "ola/Logging.h"
 #include "ola/rdm/UIDSet.h"
 #include "olad/Device.h"
+#include "olad/PluginShard.h"
 #include "olad/Port.h"
 #include "olad/PortBroker.h"
 
@@ -87,11 +88,32 @@ bool BasicInputPort::SetPriority(uint8_t priority) {
 void BasicInputPort::DmxChanged() {
   if (GetUniverse()) {
     const DmxBuffer &buffer = ReadDMX();
-    uint8_t priority = (PriorityCapability() == CAPABILITY_FULL &&
-                        GetPriorityMode() == PRIORITY_MODE_INHERIT ?
-                        InheritedPriority() :
-                        GetPriority());
-    m_dmx_source.UpdateData(buffer, *m_plugin_adaptor->WakeUpTime(), priority);
+    bool inherit = (PriorityCapability() == CAPABILITY_FULL &&
+                    GetPriorityMode() == PRIORITY_MODE_INHERIT);
+    uint8_t priority = inherit ? InheritedPriority() : GetPriority();
+    const DmxBuffer *slot_priorities = inherit ? ReadSlotPriorities() : NULL;
+    if (slot_priorities && !slot_priorities->Size())
+      slot_priorities = NULL;
+
+    if (m_plugin_adaptor->IsSharded()) {
+      // We're running in a PluginShard, the universe lives in the main
+      // thread so it gets its own copy of the data.
+      m_plugin_adaptor->ExecuteInMainThread(NewSingleCallback(
+          this,
+          &BasicInputPort::UpdateSourceData,
+          new DmxBuffer(buffer.GetRaw(), buffer.Size()),
+          slot_priorities ? new DmxBuffer(*slot_priorities) : NULL,
+          *m_plugin_adaptor->WakeUpTime(),
+          priority));
+      return;
+    }
+    if (slot_priorities) {
+      m_dmx_source.UpdateData(buffer, *slot_priorities,
+                              *m_plugin_adaptor->WakeUpTime(), priority);
+    } else {
+      m_dmx_source.UpdateData(buffer, *m_plugin_adaptor->WakeUpTime(),
+                              priority);
+    }
     GetUniverse()->PortDataChanged(this);
   }
 }
@@ -103,6 +125,62 @@ void BasicInputPort::DmxChanged() {
  */
 void BasicInputPort::HandleRDMRequest(const ola::rdm::RDMRequest *request,
                                       ola::rdm::RDMCallback *callback) {
+  if (m_plugin_adaptor->IsSharded()) {
+    m_plugin_adaptor->ExecuteInMainThread(NewSingleCallback(
+        this,
+        &BasicInputPort::RouteRDMRequest,
+        request,
+        RunInPluginThread(m_plugin_adaptor, callback)));
+  } else {
+    RouteRDMRequest(request, callback);
+  }
+}
+
+
+/*
+ * Trigger the RDM Discovery procedure for this universe
+ */
+void BasicInputPort::TriggerRDMDiscovery(
+    ola::rdm::RDMDiscoveryCallback *on_complete,
+    bool full) {
+  if (m_plugin_adaptor->IsSharded()) {
+    m_plugin_adaptor->ExecuteInMainThread(NewSingleCallback(
+        this,
+        &BasicInputPort::RunUniverseDiscovery,
+        RunInPluginThread(m_plugin_adaptor, on_complete),
+        full));
+  } else {
+    RunUniverseDiscovery(on_complete, full);
+  }
+}
+
+
+/*
+ * Called in the main thread with data from a port in a PluginShard.
+ */
+void BasicInputPort::UpdateSourceData(DmxBuffer *buffer,
+                                      DmxBuffer *slot_priorities,
+                                      TimeStamp wake_up_time,
+                                      uint8_t priority) {
+  if (GetUniverse()) {
+    if (slot_priorities) {
+      m_dmx_source.UpdateData(*buffer, *slot_priorities, wake_up_time,
+                              priority);
+    } else {
+      m_dmx_source.UpdateData(*buffer, wake_up_time, priority);
+    }
+    GetUniverse()->PortDataChanged(this);
+  }
+  delete buffer;
+  delete slot_priorities;
+}
+
+
+/*
+ * Send a RDM request to the universe this port is patched to.
+ */
+void BasicInputPort::RouteRDMRequest(const ola::rdm::RDMRequest *request,
+                                     ola::rdm::RDMCallback *callback) {
   if (m_universe) {
     m_plugin_adaptor->GetPortBroker()->SendRDMRequest(
         this,
@@ -118,9 +196,9 @@ void BasicInputPort::HandleRDMRequest(const ola::rdm::RDMRequest *request,
 
 
 /*
- * Trigger the RDM Discovery procedure for this universe
+ * Run RDM discovery on the universe this port is patched to.
  */
-void BasicInputPort::TriggerRDMDiscovery(
+void BasicInputPort::RunUniverseDiscovery(
     ola::rdm::RDMDiscoveryCallback *on_complete,
     bool full) {
   if (m_universe) {
@@ -228,6 +306,21 @@ void BasicOutputPort::RunIncrementalDiscovery(
  * Called when the discovery triggered by patching completes
  */
 void BasicOutputPort::UpdateUIDs(const ola::rdm::UIDSet &uids) {
+  const PluginAdaptor *shard = PortShard(this);
+  if (shard) {
+    // the universe lives in the main thread
+    shard->ExecuteInMainThread(
+        NewSingleCallback(this, &BasicOutputPort::UpdateUniverseUIDs, uids));
+  } else {
+    UpdateUniverseUIDs(uids);
+  }
+}
+
+
+/*
+ * Pass the new UIDs to the universe, this runs in the main thread.
+ */
+void BasicOutputPort::UpdateUniverseUIDs(ola::rdm::UIDSet uids) {
   Universe *universe = GetUniverse();
   if (universe)
     universe->NewUIDList(this, uids);
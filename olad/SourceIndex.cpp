@@ -0,0 +1,446 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * SourceIndex.cpp
+ * Tracks the active sources for a universe and merges them incrementally.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "olad/SourceIndex.h"
+
+namespace ola {
+
+using std::max;
+
+
+SourceIndex::SourceIndex()
+    : m_merge_valid(false),
+      m_merged_length(0),
+      m_slot_priority_sources(0) {
+}
+
+
+/*
+ * Called when a source has new data.
+ * @param key the port or client that changed
+ * @param source the DmxSource for the port or client
+ * @param now the current time
+ * @param htp_merge true if sources at the same priority are HTP merged, false
+ *   for LTP.
+ * @param output the buffer to update with the new data for the universe
+ * @returns true if output was updated, false if this source isn't active and
+ *   no winning source timed out.
+ */
+bool SourceIndex::SourceChanged(const void *key,
+                                const DmxSource &source,
+                                const TimeStamp &now,
+                                bool htp_merge,
+                                DmxBuffer *output) {
+  uint8_t active_priority = ActivePriority();
+  unsigned int active_sources = ActiveSourceCount();
+  bool had_slot_priorities = m_slot_priority_sources > 0;
+  ExpireSources(now);
+  // if one of the winning sources expired, the output has to be merged again
+  // even if this source isn't one of the new winners.
+  bool winners_expired = (active_priority != ActivePriority() ||
+                          active_sources != ActiveSourceCount() ||
+                          (had_slot_priorities && !m_slot_priority_sources));
+
+  SourceMap::iterator iter = m_sources.find(key);
+  if (!source.IsSet() || !source.IsActive(now) || !source.Data().Size()) {
+    if (iter != m_sources.end())
+      EraseSource(iter);
+    if (!winners_expired || m_sources.empty())
+      return false;
+    if (m_slot_priority_sources)
+      SlotPriorityMerge(htp_merge, output);
+    else
+      MergeActiveBucket(htp_merge, output);
+    return true;
+  }
+
+  SourceEntry *entry;
+  if (iter == m_sources.end()) {
+    SourceEntry &new_entry = m_sources[key];
+    new_entry.source = &source;
+    new_entry.priority = source.Priority();
+    new_entry.has_slot_priorities = false;
+    entry = &new_entry;
+    AddToBucket(entry);
+  } else {
+    entry = &iter->second;
+    entry->source = &source;
+    if (entry->priority != source.Priority()) {
+      RemoveFromBucket(entry);
+      entry->priority = source.Priority();
+      AddToBucket(entry);
+    }
+  }
+
+  if (!m_next_expiry.IsSet() || source.ExpiryTime() < m_next_expiry)
+    m_next_expiry = source.ExpiryTime();
+
+  UpdateSlotPriorityCount(entry);
+  if (m_slot_priority_sources) {
+    SlotPriorityMerge(htp_merge, output);
+    return true;
+  }
+
+  BucketMap::reverse_iterator active = m_buckets.rbegin();
+  if (entry->priority != active->first) {
+    if (!winners_expired)
+      return false;
+    MergeActiveBucket(htp_merge, output);
+    return true;
+  }
+
+  const Bucket &bucket = active->second;
+  if (bucket.size() == 1) {
+    output->Set(source.Data());
+    return true;
+  }
+
+  if (!htp_merge) {
+    // the changed source only wins if it's the newest one
+    Bucket::const_iterator bucket_iter = bucket.begin();
+    for (; bucket_iter != bucket.end(); ++bucket_iter) {
+      if (source.Timestamp() < (*bucket_iter)->source->Timestamp())
+        return false;
+    }
+    output->Set(source.Data());
+    return true;
+  }
+
+  if (m_merge_valid)
+    UpdateHTPMerge(bucket, entry);
+  else
+    FullHTPMerge(bucket);
+  output->Set(&m_merged[0], m_merged_length);
+  return true;
+}
+
+
+/*
+ * Remove a source from the index.
+ * @param key the port or client to remove
+ * @returns true if the source was removed, false if it wasn't in the index.
+ */
+bool SourceIndex::RemoveSource(const void *key) {
+  SourceMap::iterator iter = m_sources.find(key);
+  if (iter == m_sources.end())
+    return false;
+  EraseSource(iter);
+  return true;
+}
+
+
+/*
+ * Remove the sources that have timed out and merge the remaining ones if the
+ * winning sources changed. This is called from a timer so a lower priority
+ * source takes over even if it doesn't send another frame.
+ * @param now the current time
+ * @param htp_merge true if sources at the same priority are HTP merged, false
+ *   for LTP.
+ * @param output the buffer to update with the new data for the universe
+ * @returns true if output was updated, false otherwise. If the last source
+ *   expires the output is left as it was.
+ */
+bool SourceIndex::SourcesExpired(const TimeStamp &now,
+                                 bool htp_merge,
+                                 DmxBuffer *output) {
+  if (!m_next_expiry.IsSet() || now < m_next_expiry)
+    return false;
+
+  unsigned int source_count = m_sources.size();
+  uint8_t active_priority = ActivePriority();
+  unsigned int active_sources = ActiveSourceCount();
+  bool had_slot_priorities = m_slot_priority_sources > 0;
+  ExpireSources(now);
+
+  if (m_sources.size() == source_count || m_sources.empty())
+    return false;
+
+  if (m_slot_priority_sources) {
+    SlotPriorityMerge(htp_merge, output);
+    return true;
+  }
+
+  // only sources below the active priority expired
+  if (!had_slot_priorities && active_priority == ActivePriority() &&
+      active_sources == ActiveSourceCount())
+    return false;
+
+  MergeActiveBucket(htp_merge, output);
+  return true;
+}
+
+
+/*
+ * Return the priority of the highest active sources.
+ */
+uint8_t SourceIndex::ActivePriority() const {
+  if (m_buckets.empty())
+    return DmxSource::PRIORITY_MIN;
+  return m_buckets.rbegin()->first;
+}
+
+
+/*
+ * Return the number of sources at the active priority.
+ */
+unsigned int SourceIndex::ActiveSourceCount() const {
+  if (m_buckets.empty())
+    return 0;
+  return m_buckets.rbegin()->second.size();
+}
+
+
+/*
+ * Remove any sources that have timed out. This only walks the sources once
+ * the earliest expiry time has passed.
+ */
+void SourceIndex::ExpireSources(const TimeStamp &now) {
+  if (!m_next_expiry.IsSet() || now < m_next_expiry)
+    return;
+
+  m_next_expiry = TimeStamp();
+  SourceMap::iterator iter = m_sources.begin();
+  while (iter != m_sources.end()) {
+    const DmxSource *source = iter->second.source;
+    if (!source->IsActive(now)) {
+      EraseSource(iter++);
+    } else {
+      if (!m_next_expiry.IsSet() || source->ExpiryTime() < m_next_expiry)
+        m_next_expiry = source->ExpiryTime();
+      ++iter;
+    }
+  }
+}
+
+
+/*
+ * Merge the sources at the active priority from scratch.
+ */
+void SourceIndex::MergeActiveBucket(bool htp_merge, DmxBuffer *output) {
+  const Bucket &bucket = m_buckets.rbegin()->second;
+  if (htp_merge && bucket.size() > 1) {
+    FullHTPMerge(bucket);
+    output->Set(&m_merged[0], m_merged_length);
+  } else {
+    // the newest source wins
+    const SourceEntry *newest = *std::max_element(bucket.begin(),
+                                                  bucket.end(),
+                                                  OlderSource);
+    output->Set(newest->source->Data());
+  }
+}
+
+
+void SourceIndex::EraseSource(SourceMap::iterator iter) {
+  RemoveFromBucket(&iter->second);
+  if (iter->second.has_slot_priorities && !--m_slot_priority_sources)
+    m_slot_priorities.Reset();
+  m_sources.erase(iter);
+}
+
+
+/*
+ * Track if this source has per slot priorities.
+ */
+void SourceIndex::UpdateSlotPriorityCount(SourceEntry *entry) {
+  bool has_slot_priorities = entry->source->HasSlotPriorities();
+  if (has_slot_priorities == entry->has_slot_priorities)
+    return;
+
+  entry->has_slot_priorities = has_slot_priorities;
+  if (has_slot_priorities) {
+    m_slot_priority_sources++;
+  } else if (!--m_slot_priority_sources) {
+    m_slot_priorities.Reset();
+  }
+}
+
+
+/*
+ * Used to sort sources oldest first, so the newest wins an LTP merge.
+ */
+bool SourceIndex::OlderSource(const SourceEntry *a, const SourceEntry *b) {
+  return a->source->Timestamp() < b->source->Timestamp();
+}
+
+
+/*
+ * Merge every source slot by slot.
+ */
+void SourceIndex::SlotPriorityMerge(bool htp_merge, DmxBuffer *output) {
+  m_slot_entries.clear();
+  SourceMap::iterator iter = m_sources.begin();
+  for (; iter != m_sources.end(); ++iter) {
+    SourceEntry *entry = &iter->second;
+    if (!entry->has_slot_priorities) {
+      unsigned int size = entry->source->Data().Size();
+      if (entry->uniform_priorities.Size() != size ||
+          entry->uniform_priorities.Get(0) != entry->priority) {
+        uint8_t priorities[DMX_UNIVERSE_SIZE];
+        memset(priorities, entry->priority, size);
+        entry->uniform_priorities.Set(priorities, size);
+      }
+    }
+    m_slot_entries.push_back(entry);
+  }
+
+  if (!htp_merge)
+    std::stable_sort(m_slot_entries.begin(), m_slot_entries.end(),
+                     OlderSource);
+
+  m_merge_buffers.clear();
+  m_priority_buffers.clear();
+  std::vector<const SourceEntry*>::const_iterator entry_iter =
+    m_slot_entries.begin();
+  for (; entry_iter != m_slot_entries.end(); ++entry_iter) {
+    const SourceEntry *entry = *entry_iter;
+    m_merge_buffers.push_back(&entry->source->Data());
+    m_priority_buffers.push_back(entry->has_slot_priorities ?
+                                 &entry->source->SlotPriorities() :
+                                 &entry->uniform_priorities);
+  }
+
+  output->PriorityMerge(&m_merge_buffers[0], &m_priority_buffers[0],
+                        m_merge_buffers.size(), &m_slot_priorities,
+                        htp_merge);
+  // the HTP contributions weren't updated
+  m_merge_valid = false;
+}
+
+
+void SourceIndex::AddToBucket(SourceEntry *entry) {
+  m_buckets[entry->priority].push_back(entry);
+  m_merge_valid = false;
+}
+
+
+void SourceIndex::RemoveFromBucket(SourceEntry *entry) {
+  BucketMap::iterator iter = m_buckets.find(entry->priority);
+  if (iter == m_buckets.end())
+    return;
+
+  Bucket &bucket = iter->second;
+  Bucket::iterator bucket_iter = std::find(bucket.begin(), bucket.end(),
+                                           entry);
+  if (bucket_iter != bucket.end())
+    bucket.erase(bucket_iter);
+  if (bucket.empty())
+    m_buckets.erase(iter);
+  m_merge_valid = false;
+}
+
+
+/*
+ * Merge all sources in the bucket and remember what each one contributed.
+ */
+void SourceIndex::FullHTPMerge(const Bucket &bucket) {
+  m_merge_buffers.clear();
+  Bucket::const_iterator iter = bucket.begin();
+  for (; iter != bucket.end(); ++iter) {
+    (*iter)->contribution.Set((*iter)->source->Data());
+    m_merge_buffers.push_back(&(*iter)->contribution);
+  }
+
+  DmxBuffer merged;
+  merged.HTPMerge(&m_merge_buffers[0], m_merge_buffers.size());
+  m_merged_length = merged.Size();
+  m_merged.resize(DMX_UNIVERSE_SIZE);
+  memcpy(&m_merged[0], merged.GetRaw(), m_merged_length);
+  m_merge_valid = true;
+}
+
+
+/*
+ * Update the merge after a single source changed. Only channels where the
+ * changed source previously held the highest value, and has now gone down,
+ * need to look at the other sources.
+ */
+void SourceIndex::UpdateHTPMerge(const Bucket &bucket, SourceEntry *changed) {
+  const DmxBuffer &data = changed->source->Data();
+  const uint8_t *new_data = data.GetRaw();
+  const uint8_t *old_data = changed->contribution.GetRaw();
+  unsigned int new_length = data.Size();
+  unsigned int old_length = changed->contribution.Size();
+  unsigned int length = max(new_length, old_length);
+
+  // Most frames only change a few channels, so skip the blocks where the
+  // data is the same as last time.
+  unsigned int common_length = std::min(new_length, old_length);
+  unsigned int i = 0;
+  while (i < length) {
+    unsigned int block_end = std::min(i + BLOCK_SIZE, length);
+    if (block_end <= common_length &&
+        !memcmp(new_data + i, old_data + i, block_end - i)) {
+      i = block_end;
+      continue;
+    }
+
+    for (; i < block_end; i++) {
+      if (i >= m_merged_length) {
+        // no other source reaches this channel
+        m_merged[i] = new_data[i];
+      } else if (i < new_length && new_data[i] >= m_merged[i]) {
+        m_merged[i] = new_data[i];
+      } else if (i < old_length && old_data[i] == m_merged[i]) {
+        m_merged[i] = MergeChannel(bucket, changed, i);
+      }
+    }
+  }
+
+  if (new_length >= m_merged_length) {
+    m_merged_length = new_length;
+  } else if (old_length == m_merged_length) {
+    // this source may have been the longest
+    unsigned int merged_length = new_length;
+    Bucket::const_iterator iter = bucket.begin();
+    for (; iter != bucket.end(); ++iter) {
+      if (*iter != changed)
+        merged_length = max(merged_length, (*iter)->contribution.Size());
+    }
+    m_merged_length = merged_length;
+  }
+  changed->contribution.Set(data);
+}
+
+
+/*
+ * Find the highest value for a channel across the sources in a bucket.
+ * @param bucket the sources to merge
+ * @param changed the source that changed, we use the new data for this one
+ * @param channel the channel to merge
+ */
+uint8_t SourceIndex::MergeChannel(const Bucket &bucket,
+                                  const SourceEntry *changed,
+                                  unsigned int channel) const {
+  uint8_t value = 0;
+  Bucket::const_iterator iter = bucket.begin();
+  for (; iter != bucket.end(); ++iter) {
+    const DmxBuffer &data = (*iter == changed) ? changed->source->Data() :
+      (*iter)->contribution;
+    if (channel < data.Size())
+      value = max(value, data.GetRaw()[channel]);
+  }
+  return value;
+}
+}  // ola
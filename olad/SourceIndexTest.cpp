@@ -0,0 +1,309 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * SourceIndexTest.cpp
+ * Test fixture for the SourceIndex class
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "ola/BaseTypes.h"
+#include "ola/Clock.h"
+#include "ola/DmxBuffer.h"
+#include "olad/DmxSource.h"
+#include "olad/SourceIndex.h"
+
+using ola::DmxBuffer;
+using ola::DmxSource;
+using ola::SourceIndex;
+using ola::TimeInterval;
+using ola::TimeStamp;
+using std::vector;
+
+
+class SourceIndexTest: public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(SourceIndexTest);
+  CPPUNIT_TEST(testPriorities);
+  CPPUNIT_TEST(testLtp);
+  CPPUNIT_TEST(testIncrementalHtp);
+  CPPUNIT_TEST(testExpiry);
+  CPPUNIT_TEST(testWinnerExpiry);
+  CPPUNIT_TEST(testRemoveSource);
+  CPPUNIT_TEST(testSlotPriorities);
+  CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void setUp() {
+      ola::Clock clock;
+      clock.CurrentTime(&m_now);
+    }
+
+    void testPriorities();
+    void testLtp();
+    void testIncrementalHtp();
+    void testExpiry();
+    void testWinnerExpiry();
+    void testRemoveSource();
+    void testSlotPriorities();
+
+  private:
+    TimeStamp m_now;
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SourceIndexTest);
+
+
+/*
+ * Check that only sources at the highest priority are used.
+ */
+void SourceIndexTest::testPriorities() {
+  SourceIndex index;
+  DmxBuffer output;
+  DmxSource low(DmxBuffer("abc"), m_now, 50);
+  DmxSource high(DmxBuffer("xyz"), m_now, 100);
+  int low_key, high_key;
+
+  CPPUNIT_ASSERT(index.SourceChanged(&low_key, low, m_now, true, &output));
+  CPPUNIT_ASSERT(DmxBuffer("abc") == output);
+  CPPUNIT_ASSERT_EQUAL((uint8_t) 50, index.ActivePriority());
+
+  CPPUNIT_ASSERT(index.SourceChanged(&high_key, high, m_now, true, &output));
+  CPPUNIT_ASSERT(DmxBuffer("xyz") == output);
+  CPPUNIT_ASSERT_EQUAL((uint8_t) 100, index.ActivePriority());
+
+  // the low priority source no longer has any effect
+  low.UpdateData(DmxBuffer("zzz"), m_now, 50);
+  CPPUNIT_ASSERT(!index.SourceChanged(&low_key, low, m_now, true, &output));
+  CPPUNIT_ASSERT(DmxBuffer("xyz") == output);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 2, index.SourceCount());
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, index.ActiveSourceCount());
+
+  // until its priority goes up
+  low.UpdateData(DmxBuffer("abc"), m_now, 100);
+  CPPUNIT_ASSERT(index.SourceChanged(&low_key, low, m_now, true, &output));
+  CPPUNIT_ASSERT(DmxBuffer("xyz") == output);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 2, index.ActiveSourceCount());
+
+  // and if the high priority source drops, it takes over
+  high.UpdateData(DmxBuffer("xyz"), m_now, 10);
+  CPPUNIT_ASSERT(!index.SourceChanged(&high_key, high, m_now, true, &output));
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, index.ActiveSourceCount());
+  CPPUNIT_ASSERT(index.SourceChanged(&low_key, low, m_now, true, &output));
+  CPPUNIT_ASSERT(DmxBuffer("abc") == output);
+}
+
+
+/*
+ * Check that the newest source wins in LTP mode.
+ */
+void SourceIndexTest::testLtp() {
+  SourceIndex index;
+  DmxBuffer output;
+  TimeStamp later = m_now + TimeInterval(0, 1000);
+  DmxSource first(DmxBuffer("abc"), m_now, 100);
+  DmxSource second(DmxBuffer("xyz"), later, 100);
+  int first_key, second_key;
+
+  CPPUNIT_ASSERT(index.SourceChanged(&first_key, first, m_now, false,
+                                     &output));
+  CPPUNIT_ASSERT(index.SourceChanged(&second_key, second, later, false,
+                                     &output));
+  CPPUNIT_ASSERT(DmxBuffer("xyz") == output);
+
+  // an update with an older timestamp is ignored
+  CPPUNIT_ASSERT(!index.SourceChanged(&first_key, first, later, false,
+                                      &output));
+  CPPUNIT_ASSERT(DmxBuffer("xyz") == output);
+}
+
+
+/*
+ * Check the incremental HTP merge against a full merge, as sources go up &
+ * down and change length.
+ */
+void SourceIndexTest::testIncrementalHtp() {
+  const unsigned int SOURCES = 8;
+  srandom(11);
+  SourceIndex index;
+  DmxBuffer output;
+  vector<DmxSource> sources(SOURCES);
+
+  for (unsigned int round = 0; round < 500; round++) {
+    unsigned int changed = random() % SOURCES;
+    uint8_t data[DMX_UNIVERSE_SIZE];
+    // keep the values small so sources often share the highest value
+    for (unsigned int i = 0; i < DMX_UNIVERSE_SIZE; i++)
+      data[i] = random() % 8;
+    unsigned int length = (random() % 4) ?
+      static_cast<unsigned int>(DMX_UNIVERSE_SIZE) :
+      1 + random() % DMX_UNIVERSE_SIZE;
+    sources[changed].UpdateData(DmxBuffer(data, length), m_now, 100);
+    CPPUNIT_ASSERT(index.SourceChanged(&sources[changed], sources[changed],
+                                       m_now, true, &output));
+
+    DmxBuffer expected;
+    expected.Reset();
+    for (unsigned int i = 0; i < SOURCES; i++) {
+      if (sources[i].IsSet())
+        expected.HTPMerge(sources[i].Data());
+    }
+    CPPUNIT_ASSERT_EQUAL(expected.Size(), output.Size());
+    CPPUNIT_ASSERT(expected == output);
+  }
+}
+
+
+/*
+ * Check that sources which stop sending data are removed.
+ */
+void SourceIndexTest::testExpiry() {
+  SourceIndex index;
+  DmxBuffer output;
+  TimeStamp later = m_now + TimeInterval(1, 0);
+  TimeStamp much_later = m_now + TimeInterval(5, 0);
+  DmxSource high(DmxBuffer("xyz"), m_now, 100);
+  DmxSource low(DmxBuffer("abc"), later, 50);
+  int high_key, low_key;
+
+  CPPUNIT_ASSERT(index.SourceChanged(&high_key, high, m_now, true, &output));
+  CPPUNIT_ASSERT(!index.SourceChanged(&low_key, low, later, true, &output));
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 2, index.SourceCount());
+
+  // the high priority source times out, so the low one takes over
+  low.UpdateData(DmxBuffer("abc"), high.ExpiryTime(), 50);
+  CPPUNIT_ASSERT(index.SourceChanged(&low_key, low, high.ExpiryTime(), true,
+                                     &output));
+  CPPUNIT_ASSERT(DmxBuffer("abc") == output);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, index.SourceCount());
+  CPPUNIT_ASSERT_EQUAL((uint8_t) 50, index.ActivePriority());
+
+  // a source which has already timed out is ignored
+  CPPUNIT_ASSERT(!index.SourceChanged(&high_key, high, much_later, true,
+                                      &output));
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, index.SourceCount());
+  CPPUNIT_ASSERT_EQUAL(DmxSource::PRIORITY_MIN, index.ActivePriority());
+}
+
+
+/*
+ * Check that a lower priority source takes over when the winner times out,
+ * even if the source that changed is lower again.
+ */
+void SourceIndexTest::testWinnerExpiry() {
+  SourceIndex index;
+  DmxBuffer output;
+  TimeStamp later = m_now + TimeInterval(1, 0);
+  DmxSource high(DmxBuffer("xyz"), m_now, 100);
+  DmxSource middle(DmxBuffer("mno"), later, 75);
+  DmxSource low(DmxBuffer("abc"), later, 50);
+  int high_key, middle_key, low_key;
+
+  CPPUNIT_ASSERT(index.SourceChanged(&high_key, high, m_now, true, &output));
+  CPPUNIT_ASSERT(!index.SourceChanged(&middle_key, middle, later, true,
+                                      &output));
+  CPPUNIT_ASSERT(!index.SourceChanged(&low_key, low, later, true, &output));
+  CPPUNIT_ASSERT(DmxBuffer("xyz") == output);
+
+  // the high priority source times out as the low one sends a frame
+  low.UpdateData(DmxBuffer("abd"), high.ExpiryTime(), 50);
+  CPPUNIT_ASSERT(index.SourceChanged(&low_key, low, high.ExpiryTime(), true,
+                                     &output));
+  CPPUNIT_ASSERT(DmxBuffer("mno") == output);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 2, index.SourceCount());
+  CPPUNIT_ASSERT_EQUAL((uint8_t) 75, index.ActivePriority());
+
+  // after that, low priority frames have no effect
+  low.UpdateData(DmxBuffer("abe"), high.ExpiryTime(), 50);
+  CPPUNIT_ASSERT(!index.SourceChanged(&low_key, low, high.ExpiryTime(), true,
+                                      &output));
+  CPPUNIT_ASSERT(DmxBuffer("mno") == output);
+}
+
+
+/*
+ * Check that removing a source causes the next merge to exclude it.
+ */
+void SourceIndexTest::testRemoveSource() {
+  SourceIndex index;
+  DmxBuffer output;
+  const uint8_t data1[] = {10, 0, 30};
+  const uint8_t data2[] = {0, 20, 0, 40};
+  const uint8_t merged[] = {10, 20, 30, 40};
+  DmxSource first(DmxBuffer(data1, sizeof(data1)), m_now, 100);
+  DmxSource second(DmxBuffer(data2, sizeof(data2)), m_now, 100);
+
+  CPPUNIT_ASSERT(index.SourceChanged(&first, first, m_now, true, &output));
+  CPPUNIT_ASSERT(index.SourceChanged(&second, second, m_now, true, &output));
+  CPPUNIT_ASSERT(DmxBuffer(merged, sizeof(merged)) == output);
+
+  CPPUNIT_ASSERT(index.RemoveSource(&second));
+  CPPUNIT_ASSERT(!index.RemoveSource(&second));
+  CPPUNIT_ASSERT(index.SourceChanged(&first, first, m_now, true, &output));
+  CPPUNIT_ASSERT(DmxBuffer(data1, sizeof(data1)) == output);
+}
+
+
+/*
+ * Check that sources with per slot priorities are merged slot by slot, with
+ * the sources that don't have them.
+ */
+void SourceIndexTest::testSlotPriorities() {
+  SourceIndex index;
+  DmxBuffer output;
+  const uint8_t data1[] = {10, 20, 30, 40};
+  const uint8_t priorities1[] = {150, 0, 150, 50};
+  const uint8_t data2[] = {1, 2, 3, 4};
+  const uint8_t priorities2[] = {0, 150, 100, 100};
+  const uint8_t data3[] = {50, 50, 50, 50};
+  DmxSource first, second;
+  first.UpdateData(DmxBuffer(data1, sizeof(data1)),
+                   DmxBuffer(priorities1, sizeof(priorities1)), m_now, 100);
+  second.UpdateData(DmxBuffer(data2, sizeof(data2)),
+                    DmxBuffer(priorities2, sizeof(priorities2)), m_now, 100);
+  // this one is at a lower priority, but still wins the slots where the
+  // others are lower still.
+  DmxSource third(DmxBuffer(data3, sizeof(data3)), m_now, 75);
+  CPPUNIT_ASSERT(third.HasSlotPriorities() == false);
+
+  CPPUNIT_ASSERT(index.SourceChanged(&first, first, m_now, true, &output));
+  CPPUNIT_ASSERT(index.SourceChanged(&second, second, m_now, true, &output));
+  CPPUNIT_ASSERT(index.SourceChanged(&third, third, m_now, true, &output));
+
+  const uint8_t expected[] = {10, 2, 30, 4};
+  const uint8_t expected_priorities[] = {150, 150, 150, 100};
+  CPPUNIT_ASSERT(DmxBuffer(expected, sizeof(expected)) == output);
+  CPPUNIT_ASSERT(DmxBuffer(expected_priorities, sizeof(expected_priorities)) ==
+                 index.SlotPriorities());
+
+  // once the second source goes, the third takes the slots it had
+  CPPUNIT_ASSERT(index.RemoveSource(&second));
+  CPPUNIT_ASSERT(index.SourceChanged(&third, third, m_now, true, &output));
+  const uint8_t expected2[] = {10, 50, 30, 50};
+  const uint8_t expected_priorities2[] = {150, 75, 150, 75};
+  CPPUNIT_ASSERT(DmxBuffer(expected2, sizeof(expected2)) == output);
+  CPPUNIT_ASSERT(DmxBuffer(expected_priorities2,
+                           sizeof(expected_priorities2)) ==
+                 index.SlotPriorities());
+
+  // and when no source has slot priorities we go back to the normal merge
+  first.UpdateData(DmxBuffer(data1, sizeof(data1)), m_now, 100);
+  CPPUNIT_ASSERT(index.SourceChanged(&first, first, m_now, true, &output));
+  CPPUNIT_ASSERT(DmxBuffer(data1, sizeof(data1)) == output);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, index.SlotPriorities().Size());
+}
@@ -228,6 +228,15 @@ class MockSelectServer: public ola::network::SelectServerInterface {
       (void) closure;
       return ola::thread::INVALID_TIMEOUT;
     }
+    ola::network::timeout_id RegisterRepeatingTimeout(
+        const ola::TimeInterval &interval,
+        ola::Callback0<bool> *closure,
+        ola::thread::TimerMode mode) {
+      (void) interval;
+      (void) closure;
+      (void) mode;
+      return ola::thread::INVALID_TIMEOUT;
+    }
     ola::network::timeout_id RegisterSingleTimeout(
         unsigned int ms,
         ola::SingleUseCallback0<void> *closure) {
@@ -236,6 +245,21 @@ class MockSelectServer: public ola::network::SelectServerInterface {
       return ola::thread::INVALID_TIMEOUT;
     }
     void RemoveTimeout(ola::network::timeout_id id) { (void) id; }
+
+    void SetReadDescriptorName(ola::network::ReadFileDescriptor *descriptor,
+                               const std::string &name) {
+      (void) descriptor;
+      (void) name;
+    }
+    void SetWriteDescriptorName(ola::network::WriteFileDescriptor *descriptor,
+                                const std::string &name) {
+      (void) descriptor;
+      (void) name;
+    }
+    void SetTimeoutName(ola::network::timeout_id id, const std::string &name) {
+      (void) id;
+      (void) name;
+    }
     const TimeStamp *WakeUpTime() const { return m_wake_up; }
 
     void Execute(ola::BaseCallback0<void> *callback) {
@@ -40,7 +40,12 @@
 #include "ola/Logging.h"
 #include "ola/MultiCallback.h"
 #include "olad/Client.h"
+#include "olad/OutputScheduler.h"
+#include "olad/PluginShard.h"
+#include "olad/UniverseRouter.h"
+#include "olad/UniverseSnapshot.h"
 #include "olad/UniverseStore.h"
+#include "olad/UniverseTransform.h"
 #include "olad/Port.h"
 #include "olad/Universe.h"
 
@@ -48,6 +53,9 @@ namespace ola {
 
 const char Universe::K_UNIVERSE_UID_COUNT_VAR[] = "universe-uids";
 const char Universe::K_FPS_VAR[] = "universe-dmx-frames";
+const unsigned int Universe::MAX_FRAME_RATE = 1000;
+// half the E1.31 refresh, so the 0xdd packets never fall too far behind
+const TimeInterval Universe::SLOT_PRIORITY_RESEND_INTERVAL(0, 500000);
 const char Universe::K_MERGE_HTP_STR[] = "htp";
 const char Universe::K_MERGE_LTP_STR[] = "ltp";
 const char Universe::K_UNIVERSE_INPUT_PORT_VAR[] = "universe-input-ports";
@@ -74,10 +82,17 @@ Universe::Universe(unsigned int universe_id, UniverseStore *store,
       m_merge_mode(Universe::MERGE_LTP),
       m_universe_store(store),
       m_export_map(export_map),
-      m_clock(clock) {
-  stringstream universe_id_str, universe_name_str;
-  universe_id_str << universe_id;
-  m_universe_id_str = universe_id_str.str();
+      m_frame_counter(NULL),
+      m_clock(clock),
+      m_output_scheduler(NULL),
+      m_max_frame_rate(0),
+      m_keepalive_interval(0),
+      m_transform(NULL),
+      m_routes(NULL),
+      m_snapshot(NULL),
+      m_scheduler(NULL),
+      m_expiry_timeout(ola::thread::INVALID_TIMEOUT) {
+  stringstream universe_name_str;
   universe_name_str << "Universe " << universe_id;
   m_universe_name = universe_name_str.str();
 
@@ -96,7 +111,10 @@ Universe::Universe(unsigned int universe_id, UniverseStore *store,
 
   if (m_export_map) {
     for (unsigned int i = 0; i < sizeof(vars) / sizeof(vars[0]); ++i)
-      (*m_export_map->GetUIntMapVar(vars[i]))[m_universe_id_str] = 0;
+      (*m_export_map->GetUIntIndexedMapVar(vars[i]))[m_universe_id] = 0;
+    // this is updated for every frame so we keep a reference to it
+    m_frame_counter =
+      &(*m_export_map->GetUIntIndexedMapVar(K_FPS_VAR))[m_universe_id];
   }
 }
 
@@ -105,6 +123,13 @@ Universe::Universe(unsigned int universe_id, UniverseStore *store,
  * Delete this universe
  */
 Universe::~Universe() {
+  if (m_output_scheduler)
+    m_output_scheduler->RemoveUniverse(this);
+  CancelSourceExpiry();
+  if (m_snapshot)
+    m_snapshot->Clear();
+  delete m_transform;
+
   const char *string_vars[] = {
     K_UNIVERSE_NAME_VAR,
     K_UNIVERSE_MODE_VAR,
@@ -122,9 +147,10 @@ Universe::~Universe() {
 
   if (m_export_map) {
     for (unsigned int i = 0; i < sizeof(string_vars) / sizeof(char*); ++i)
-      m_export_map->GetStringMapVar(string_vars[i])->Remove(m_universe_id_str);
+      m_export_map->GetStringIndexedMapVar(string_vars[i])->Remove(
+          m_universe_id);
     for (unsigned int i = 0; i < sizeof(uint_vars) / sizeof(char*); ++i)
-      m_export_map->GetUIntMapVar(uint_vars[i])->Remove(m_universe_id_str);
+      m_export_map->GetUIntIndexedMapVar(uint_vars[i])->Remove(m_universe_id);
   }
 }
 
@@ -140,7 +166,11 @@ void Universe::SetName(const string &name) {
   // notify ports
   vector<OutputPort*>::const_iterator iter;
   for (iter = m_output_ports.begin(); iter != m_output_ports.end(); ++iter) {
-    (*iter)->UniverseNameChanged(name);
+    const PluginAdaptor *shard = PortShard(*iter);
+    if (shard)
+      ShardedUniverseNameChanged(shard, *iter, name);
+    else
+      (*iter)->UniverseNameChanged(name);
   }
 }
 
@@ -150,11 +180,98 @@ void Universe::SetName(const string &name) {
  * @param merge_mode the new merge_mode
  */
 void Universe::SetMergeMode(enum merge_mode merge_mode) {
+  if (m_merge_mode != merge_mode)
+    m_source_index.Invalidate();
   m_merge_mode = merge_mode;
   UpdateMode();
 }
 
 
+/*
+ * Set the maximum rate this universe writes to its outputs. Frames that
+ * arrive faster than this are coalesced.
+ * @param frame_rate the max frames per second, 0 means unlimited. Rates above
+ *   MAX_FRAME_RATE are reduced to MAX_FRAME_RATE.
+ */
+void Universe::SetMaxFrameRate(unsigned int frame_rate) {
+  if (frame_rate > MAX_FRAME_RATE) {
+    OLA_WARN << "Max frame rate of " << frame_rate << " for universe " <<
+      m_universe_id << " is too high, using " << MAX_FRAME_RATE;
+    frame_rate = MAX_FRAME_RATE;
+  }
+  m_max_frame_rate = frame_rate;
+  if (m_output_scheduler)
+    m_output_scheduler->SetMaxFrameRate(this, frame_rate);
+}
+
+
+/*
+ * Set how long this universe can be idle before the last frame is resent to
+ * the output ports.
+ * @param interval_ms the keepalive interval in ms, 0 disables the keepalive.
+ */
+void Universe::SetKeepAliveInterval(unsigned int interval_ms) {
+  m_keepalive_interval = interval_ms;
+  if (m_output_scheduler)
+    m_output_scheduler->SetKeepAliveInterval(this, interval_ms);
+}
+
+
+/*
+ * Set the scheduler used to time out sources. Without one, sources only time
+ * out when another source sends data.
+ */
+void Universe::SetScheduler(ola::thread::SchedulerInterface *scheduler) {
+  CancelSourceExpiry();
+  m_scheduler = scheduler;
+  ScheduleSourceExpiry();
+}
+
+
+/*
+ * Set the snapshot this universe's frames are published to.
+ */
+void Universe::SetSnapshot(UniverseSnapshot *snapshot) {
+  m_snapshot = snapshot;
+  if (m_snapshot)
+    m_snapshot->Publish(m_buffer);
+}
+
+
+/*
+ * Set the OutputScheduler used to limit the frame rate and send keepalives.
+ * Without one, every frame is written immediately and nothing is resent.
+ */
+void Universe::SetOutputScheduler(OutputScheduler *scheduler) {
+  if (m_output_scheduler)
+    m_output_scheduler->RemoveUniverse(this);
+  m_output_scheduler = scheduler;
+  if (m_output_scheduler) {
+    m_output_scheduler->SetMaxFrameRate(this, m_max_frame_rate);
+    m_output_scheduler->SetKeepAliveInterval(this, m_keepalive_interval);
+  }
+}
+
+
+/*
+ * Set the transform applied to the merged data before it's sent to the
+ * outputs.
+ * @param transform the new transform, ownership is transferred. NULL removes
+ *   the current transform.
+ */
+void Universe::SetTransform(UniverseTransform *transform) {
+  if (!m_transform)
+    m_merged_buffer.Set(m_buffer);
+  delete m_transform;
+  m_transform = transform;
+
+  if (m_transform)
+    m_transform->Apply(m_merged_buffer, &m_buffer);
+  else
+    m_buffer.Set(m_merged_buffer);
+}
+
+
 /*
  * Add an InputPort to this universe.
  * @param port the port to add
@@ -169,6 +286,9 @@ bool Universe::AddPort(InputPort *port) {
  * @param port the port to add
  */
 bool Universe::AddPort(OutputPort *port) {
+  // the new port needs the whole of the next frame, and the slot priorities
+  m_last_frame.Reset();
+  m_last_slot_priorities.Reset();
   return GenericAddPort(port, &m_output_ports);
 }
 
@@ -179,6 +299,7 @@ bool Universe::AddPort(OutputPort *port) {
  * @return true if the port was removed, false if it didn't exist
  */
 bool Universe::RemovePort(InputPort *port) {
+  m_source_index.RemoveSource(port);
   return GenericRemovePort(port, &m_input_ports);
 }
 
@@ -192,8 +313,8 @@ bool Universe::RemovePort(OutputPort *port) {
   bool ret = GenericRemovePort(port, &m_output_ports, &m_output_uids);
 
   if (m_export_map)
-    (*m_export_map->GetUIntMapVar(K_UNIVERSE_UID_COUNT_VAR))[m_universe_id_str]
-      = m_output_uids.size();
+    (*m_export_map->GetUIntIndexedMapVar(K_UNIVERSE_UID_COUNT_VAR))[
+      m_universe_id] = m_output_uids.size();
   return ret;
 }
 
@@ -256,6 +377,7 @@ bool Universe::AddSourceClient(Client *client) {
  * @param client the client to remove
  */
 bool Universe::RemoveSourceClient(Client *client) {
+  m_source_index.RemoveSource(client);
   return RemoveClient(client, true);
 }
 
@@ -278,6 +400,7 @@ bool Universe::ContainsSourceClient(Client *client) const {
 bool Universe::AddSinkClient(Client *client) {
   if (ContainsSinkClient(client))
     return false;
+  m_last_frame.Reset();
   return AddClient(client, false);
 }
 
@@ -313,7 +436,12 @@ bool Universe::SetDMX(const DmxBuffer &buffer) {
       UniverseId();
     return true;
   }
-  m_buffer.Set(buffer);
+  if (m_transform) {
+    m_merged_buffer.Set(buffer);
+    m_transform->Apply(m_merged_buffer, &m_buffer);
+  } else {
+    m_buffer.Set(buffer);
+  }
   return UpdateDependants();
 }
 
@@ -360,8 +488,8 @@ void Universe::SendRDMRequest(const ola::rdm::RDMRequest *request,
     << std::hex << request->ParamId();
 
   if (m_export_map)
-    (*m_export_map->GetUIntMapVar(K_UNIVERSE_RDM_REQUESTS))[
-      m_universe_id_str]++;
+    (*m_export_map->GetUIntIndexedMapVar(K_UNIVERSE_RDM_REQUESTS))[
+      m_universe_id]++;
 
   if (request->DestinationUID().IsBroadcast()) {
     // send this request to all ports
@@ -374,7 +502,8 @@ void Universe::SendRDMRequest(const ola::rdm::RDMRequest *request,
     for (port_iter = m_output_ports.begin(); port_iter != m_output_ports.end();
          ++port_iter) {
       // because each port deletes the request, we need to copy it here
-      (*port_iter)->SendRDMRequest(
+      SendRDMRequestToPort(
+          *port_iter,
           request->Duplicate(),
           NewSingleCallback(this, &Universe::HandleBroadcastAck, tracker));
     }
@@ -390,7 +519,7 @@ void Universe::SendRDMRequest(const ola::rdm::RDMRequest *request,
       callback->Run(ola::rdm::RDM_UNKNOWN_UID, NULL, packets);
       delete request;
     } else {
-      iter->second->SendRDMRequest(request, callback);
+      SendRDMRequestToPort(iter->second, request, callback);
     }
   }
 }
@@ -421,19 +550,18 @@ void Universe::RunRDMDiscovery(RDMDiscoveryCallback *on_complete, bool full) {
   // will trigger, running the DiscoveryCallback.
   vector<OutputPort*>::iterator iter;
   for (iter = output_ports.begin(); iter != output_ports.end(); ++iter) {
-    if (full) {
-      (*iter)->RunFullDiscovery(
-          NewSingleCallback(this,
-                            &Universe::PortDiscoveryComplete,
-                            discovery_complete,
-                            *iter));
-    } else {
-      (*iter)->RunIncrementalDiscovery(
-          NewSingleCallback(this,
-                            &Universe::PortDiscoveryComplete,
-                            discovery_complete,
-                            *iter));
-    }
+    RDMDiscoveryCallback *port_complete = NewSingleCallback(
+        this,
+        &Universe::PortDiscoveryComplete,
+        discovery_complete,
+        *iter);
+    const PluginAdaptor *shard = PortShard(*iter);
+    if (shard)
+      ShardedRunDiscovery(shard, *iter, port_complete, full);
+    else if (full)
+      (*iter)->RunFullDiscovery(port_complete);
+    else
+      (*iter)->RunIncrementalDiscovery(port_complete);
   }
 }
 
@@ -461,8 +589,8 @@ void Universe::NewUIDList(OutputPort *port, const ola::rdm::UIDSet &uids) {
   }
 
   if (m_export_map)
-    (*m_export_map->GetUIntMapVar(K_UNIVERSE_UID_COUNT_VAR))[m_universe_id_str]
-      = m_output_uids.size();
+    (*m_export_map->GetUIntIndexedMapVar(K_UNIVERSE_UID_COUNT_VAR))[
+      m_universe_id] = m_output_uids.size();
 }
 
 
@@ -494,6 +622,61 @@ bool Universe::IsActive() const {
 }
 
 
+/*
+ * Write the current frame to the output ports & sink clients.
+ */
+bool Universe::WriteFrame() {
+  set<Client*>::const_iterator client_iter;
+
+  dmx_change change;
+  change.changed = m_buffer.ChangedRange(m_last_frame, &change.start,
+                                         &change.end);
+  if (change.changed) {
+    m_last_frame.Set(m_buffer);
+    if (m_snapshot)
+      m_snapshot->Publish(m_buffer);
+  } else {
+    change.start = 0;
+    change.end = 0;
+  }
+
+  WriteToPorts(change);
+
+  // write to all clients, they only need frames that changed
+  for (client_iter = m_sink_clients.begin();
+       change.changed && client_iter != m_sink_clients.end();
+       ++client_iter) {
+    (*client_iter)->SendDMX(m_universe_id, m_buffer);
+  }
+
+  // and any virtual universes built from this one
+  if (m_routes && change.changed)
+    m_routes->SourceChanged(m_buffer);
+
+  if (m_frame_counter)
+    (*m_frame_counter)++;
+  return true;
+}
+
+
+/*
+ * Resend the last frame to the output ports. Every slot is marked as changed
+ * so ports that skip unchanged frames still send it.
+ * @returns true if the frame was sent, false if there was nothing to send.
+ */
+bool Universe::RefreshOutputs() {
+  if (m_output_ports.empty() || !m_buffer.Size())
+    return false;
+
+  dmx_change change;
+  change.changed = true;
+  change.start = 0;
+  change.end = m_buffer.Size();
+  WriteToPorts(change);
+  return true;
+}
+
+
 // Private Methods
 //-----------------------------------------------------------------------------
 
@@ -503,24 +686,46 @@ bool Universe::IsActive() const {
  * updates everyone who needs to know (patched ports and network clients)
  */
 bool Universe::UpdateDependants() {
-  vector<OutputPort*>::const_iterator iter;
-  set<Client*>::const_iterator client_iter;
+  if (m_output_scheduler && !m_output_scheduler->FrameReady(this))
+    return true;
+  return WriteFrame();
+}
 
-  // write to all ports assigned to this unviverse
-  for (iter = m_output_ports.begin(); iter != m_output_ports.end(); ++iter) {
-    (*iter)->WriteDMX(m_buffer, m_active_priority);
-  }
 
-  // write to all clients
-  for (client_iter = m_sink_clients.begin();
-       client_iter != m_sink_clients.end();
-       ++client_iter) {
-    (*client_iter)->SendDMX(m_universe_id, m_buffer);
+/*
+ * Write the current frame to all ports assigned to this universe.
+ */
+void Universe::WriteToPorts(const dmx_change &change) {
+  vector<OutputPort*>::const_iterator iter;
+  const DmxBuffer &slot_priorities = m_source_index.SlotPriorities();
+  bool write_priorities = false;
+  if (slot_priorities.Size()) {
+    // slot priorities rarely change, so they're only written when they do,
+    // or often enough for the ports to refresh them.
+    TimeStamp now;
+    m_clock->CurrentTime(&now);
+    if (!(slot_priorities == m_last_slot_priorities) ||
+        now >= m_slot_priority_time + SLOT_PRIORITY_RESEND_INTERVAL) {
+      write_priorities = true;
+      m_last_slot_priorities.Set(slot_priorities);
+      m_slot_priority_time = now;
+    }
+  } else if (m_last_slot_priorities.Size()) {
+    m_last_slot_priorities.Reset();
   }
 
-  if (m_export_map)
-    (*m_export_map->GetUIntMapVar(K_FPS_VAR))[m_universe_id_str]++;
-  return true;
+  for (iter = m_output_ports.begin(); iter != m_output_ports.end(); ++iter) {
+    const PluginAdaptor *shard = PortShard(*iter);
+    if (shard) {
+      if (write_priorities)
+        ShardedWriteSlotPriorities(shard, *iter, slot_priorities);
+      ShardedWriteDMX(shard, *iter, m_buffer, m_active_priority, change);
+    } else {
+      if (write_priorities)
+        (*iter)->WriteSlotPriorities(slot_priorities);
+      (*iter)->WriteDMX(m_buffer, m_active_priority, change);
+    }
+  }
 }
 
 
@@ -530,8 +735,9 @@ bool Universe::UpdateDependants() {
 void Universe::UpdateName() {
   if (!m_export_map)
     return;
-  StringMap *name_map = m_export_map->GetStringMapVar(K_UNIVERSE_NAME_VAR);
-  (*name_map)[m_universe_id_str] = m_universe_name;
+  StringIndexedMap *name_map =
+    m_export_map->GetStringIndexedMapVar(K_UNIVERSE_NAME_VAR);
+  (*name_map)[m_universe_id] = m_universe_name;
 }
 
 
@@ -541,9 +747,10 @@ void Universe::UpdateName() {
 void Universe::UpdateMode() {
   if (!m_export_map)
     return;
-  StringMap *mode_map = m_export_map->GetStringMapVar(K_UNIVERSE_MODE_VAR);
-  (*mode_map)[m_universe_id_str] = (m_merge_mode == Universe::MERGE_LTP ?
-                                    K_MERGE_LTP_STR : K_MERGE_HTP_STR);
+  StringIndexedMap *mode_map =
+    m_export_map->GetStringIndexedMapVar(K_UNIVERSE_MODE_VAR);
+  (*mode_map)[m_universe_id] = (m_merge_mode == Universe::MERGE_LTP ?
+                                K_MERGE_LTP_STR : K_MERGE_HTP_STR);
 }
 
 
@@ -561,7 +768,7 @@ bool Universe::AddClient(Client *client, bool is_source) {
   if (m_export_map) {
     const string &map_name = is_source ? K_UNIVERSE_SOURCE_CLIENTS_VAR :
       K_UNIVERSE_SINK_CLIENTS_VAR;
-    (*m_export_map->GetUIntMapVar(map_name))[m_universe_id_str]++;
+    (*m_export_map->GetUIntIndexedMapVar(map_name))[m_universe_id]++;
   }
   return true;
 }
@@ -584,7 +791,7 @@ bool Universe::RemoveClient(Client *client, bool is_source) {
   if (m_export_map) {
     const string &map_name = is_source ? K_UNIVERSE_SOURCE_CLIENTS_VAR :
       K_UNIVERSE_SINK_CLIENTS_VAR;
-    (*m_export_map->GetUIntMapVar(map_name))[m_universe_id_str]--;
+    (*m_export_map->GetUIntIndexedMapVar(map_name))[m_universe_id]--;
   }
   OLA_INFO << "Client " << client << " has been removed from uni " <<
     m_universe_id;
@@ -597,116 +804,99 @@ bool Universe::RemoveClient(Client *client, bool is_source) {
 
 
 /*
- * HTP Merge all sources (clients/ports)
- * @pre sources.size >= 2
- * @param sources the list of DmxSources to merge
- */
-void Universe::HTPMergeSources(const vector<DmxSource> &sources) {
-  vector<DmxSource>::const_iterator iter;
-  m_buffer.Reset();
-
-  for (iter = sources.begin(); iter != sources.end(); ++iter) {
-    m_buffer.HTPMerge(iter->Data());
-  }
-}
-
-
-/*
- * Merge all port/client sources.
+ * Merge a changed port/client source with the other sources.
  * This does a priority based merge as documented at:
  * http://opendmx.net/index.php/OLA_Merging_Algorithms
+ * The SourceIndex keeps the sources bucketed by priority, so only the source
+ * that changed is examined.
  * @param port the input port that changed or NULL
  * @param client the client that changed or NULL
  * @returns true if the data for this universe changed, false otherwise
  */
 bool Universe::MergeAll(const InputPort *port, const Client *client) {
-  vector<DmxSource> active_sources;
-
-  vector<InputPort*>::const_iterator iter;
-  set<Client*>::const_iterator client_iter;
-
-  m_active_priority = DmxSource::PRIORITY_MIN;
   TimeStamp now;
   m_clock->CurrentTime(&now);
-  bool changed_source_is_active = false;
-
-  // Find the highest active ports
-  for (iter = m_input_ports.begin(); iter != m_input_ports.end(); ++iter) {
-    DmxSource source = (*iter)->SourceData();
-    if (!source.IsSet() || !source.IsActive(now) || !source.Data().Size())
-      continue;
-
-    if (source.Priority() > m_active_priority) {
-      changed_source_is_active = false;
-      active_sources.clear();
-      m_active_priority = source.Priority();
-    }
 
-    if (source.Priority() == m_active_priority) {
-      active_sources.push_back(source);
-      if (*iter == port)
-        changed_source_is_active = true;
-    }
+  DmxBuffer *merged = m_transform ? &m_merged_buffer : &m_buffer;
+  bool changed;
+  if (port) {
+    changed = m_source_index.SourceChanged(port, port->SourceData(), now,
+                                           m_merge_mode == MERGE_HTP,
+                                           merged);
+  } else {
+    changed = m_source_index.SourceChanged(client,
+                                           client->SourceData(UniverseId()),
+                                           now,
+                                           m_merge_mode == MERGE_HTP,
+                                           merged);
   }
+  m_active_priority = m_source_index.ActivePriority();
 
-  // find the highest active clients
-  for (client_iter = m_source_clients.begin();
-       client_iter != m_source_clients.end();
-       ++client_iter) {
-    const DmxSource &source = (*client_iter)->SourceData(UniverseId());
+  if (changed && m_transform)
+    m_transform->Apply(m_merged_buffer, &m_buffer);
+  ScheduleSourceExpiry();
+  return changed;
+}
 
-    if (!source.IsSet() || !source.IsActive(now) || !source.Data().Size())
-      continue;
 
-    if (source.Priority() > m_active_priority) {
-      changed_source_is_active = false;
-      active_sources.clear();
-      m_active_priority = source.Priority();
-    }
+/*
+ * Make sure the expiry timer will fire by the time the first source could
+ * time out. Sources sending data only move their expiry time later, so if the
+ * timer is already set to fire early enough it's left alone and re-armed when
+ * it runs.
+ */
+void Universe::ScheduleSourceExpiry() {
+  if (!m_scheduler)
+    return;
 
-    if (source.Priority() == m_active_priority) {
-      active_sources.push_back(source);
-      if (*client_iter == client)
-        changed_source_is_active = true;
-    }
+  const TimeStamp &deadline = m_source_index.NextExpiry();
+  if (!deadline.IsSet()) {
+    CancelSourceExpiry();
+    return;
   }
 
-  if (active_sources.empty()) {
-    OLA_WARN << "Something changed but we didn't find any active sources " <<
-      " for universe " << UniverseId();
-    return false;
+  if (m_expiry_timeout != ola::thread::INVALID_TIMEOUT) {
+    if (m_expiry_deadline <= deadline)
+      return;
+    m_scheduler->RemoveTimeout(m_expiry_timeout);
   }
 
-  if (!changed_source_is_active)
-    // this source didn't have any effect, skip
-    return false;
+  TimeStamp now;
+  m_clock->CurrentTime(&now);
+  // round up so we don't wake before the deadline
+  int64_t delay = now < deadline ?
+    ((deadline - now).AsInt() + ONE_THOUSAND - 1) / ONE_THOUSAND : 0;
+  m_expiry_deadline = deadline;
+  m_expiry_timeout = m_scheduler->RegisterSingleTimeout(
+      static_cast<unsigned int>(delay),
+      NewSingleCallback(this, &Universe::SourceExpiryTimeout));
+}
 
-  // only one source at the active priority
-  if (active_sources.size() == 1) {
-    m_buffer.Set(active_sources[0].Data());
-  } else {
-    // multi source merge
-    if (m_merge_mode == Universe::MERGE_LTP) {
-      vector<DmxSource>::const_iterator source_iter = active_sources.begin();
-      DmxSource changed_source;
-      if (port)
-        changed_source = port->SourceData();
-      else
-        changed_source = client->SourceData(UniverseId());
-
-      // check that the current port/client is newer than all other active
-      // sources
-      for (; source_iter != active_sources.end(); source_iter++) {
-        if (changed_source.Timestamp() < source_iter->Timestamp())
-          return false;
-      }
-      // if we made it to here this is the newest source
-      m_buffer.Set(changed_source.Data());
-    } else {
-      HTPMergeSources(active_sources);
-    }
+
+/*
+ * Called when the first source may have timed out. If the winning sources
+ * expired the remaining sources are merged and the outputs updated.
+ */
+void Universe::SourceExpiryTimeout() {
+  m_expiry_timeout = ola::thread::INVALID_TIMEOUT;
+
+  TimeStamp now;
+  m_clock->CurrentTime(&now);
+  DmxBuffer *merged = m_transform ? &m_merged_buffer : &m_buffer;
+  if (m_source_index.SourcesExpired(now, m_merge_mode == MERGE_HTP, merged)) {
+    m_active_priority = m_source_index.ActivePriority();
+    if (m_transform)
+      m_transform->Apply(m_merged_buffer, &m_buffer);
+    UpdateDependants();
   }
-  return true;
+  ScheduleSourceExpiry();
+}
+
+
+void Universe::CancelSourceExpiry() {
+  if (m_scheduler && m_expiry_timeout != ola::thread::INVALID_TIMEOUT)
+    m_scheduler->RemoveTimeout(m_expiry_timeout);
+  m_expiry_timeout = ola::thread::INVALID_TIMEOUT;
 }
 
 
@@ -731,6 +921,20 @@ void Universe::DiscoveryComplete(RDMDiscoveryCallback *on_complete) {
 }
 
 
+/**
+ * Send a RDM request to an output port, which may be in a PluginShard.
+ */
+void Universe::SendRDMRequestToPort(OutputPort *port,
+                                    const ola::rdm::RDMRequest *request,
+                                    ola::rdm::RDMCallback *callback) {
+  const PluginAdaptor *shard = PortShard(port);
+  if (shard)
+    ShardedSendRDMRequest(shard, port, request, callback);
+  else
+    port->SendRDMRequest(request, callback);
+}
+
+
 /**
  * Track fan-out responses for a broadcast request.
  * This increments the port counter until we reach the expected value, and
@@ -768,10 +972,10 @@ bool Universe::GenericAddPort(PortClass *port, vector<PortClass*> *ports) {
 
   ports->push_back(port);
   if (m_export_map) {
-    UIntMap *map = m_export_map->GetUIntMapVar(
+    UIntIndexedMap *map = m_export_map->GetUIntIndexedMapVar(
         IsInputPort<PortClass>() ? K_UNIVERSE_INPUT_PORT_VAR :
         K_UNIVERSE_OUTPUT_PORT_VAR);
-    (*map)[m_universe_id_str]++;
+    (*map)[m_universe_id]++;
   }
   return true;
 }
@@ -797,10 +1001,10 @@ bool Universe::GenericRemovePort(PortClass *port,
 
   ports->erase(iter);
   if (m_export_map) {
-    UIntMap *map = m_export_map->GetUIntMapVar(
+    UIntIndexedMap *map = m_export_map->GetUIntIndexedMapVar(
         IsInputPort<PortClass>() ? K_UNIVERSE_INPUT_PORT_VAR :
         K_UNIVERSE_OUTPUT_PORT_VAR);
-    (*map)[m_universe_id_str]--;
+    (*map)[m_universe_id]--;
   }
   if (!IsActive())
     m_universe_store->AddUniverseGarbageCollection(this);
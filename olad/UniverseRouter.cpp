@@ -0,0 +1,274 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * UniverseRouter.cpp
+ * Builds virtual universes from slices of other universes.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "ola/Logging.h"
+#include "olad/Universe.h"
+#include "olad/UniverseRouter.h"
+
+namespace ola {
+
+using std::vector;
+
+
+RouteDestination::RouteDestination(Universe *universe)
+    : m_universe(universe),
+      m_length(0) {
+  memset(m_data, 0, sizeof(m_data));
+}
+
+
+/*
+ * Make sure the universe is at least this long.
+ */
+void RouteDestination::ExtendTo(unsigned int length) {
+  m_length = std::max(m_length, length);
+}
+
+
+/*
+ * Update a slice of the universe.
+ * @param offset the first channel of the slice
+ * @param length the length of the slice
+ * @param data the new data
+ * @param data_length the length of data, if this is less than length the rest
+ *   of the slice is set to 0.
+ */
+void RouteDestination::Update(unsigned int offset,
+                              unsigned int length,
+                              const uint8_t *data,
+                              unsigned int data_length) {
+  unsigned int copy_length = std::min(length, data_length);
+  memcpy(m_data + offset, data, copy_length);
+  memset(m_data + offset + copy_length, 0, length - copy_length);
+}
+
+
+/*
+ * Send the frame to the universe.
+ */
+void RouteDestination::Send() {
+  m_frame.Set(m_data, m_length);
+  m_universe->SetDMX(m_frame);
+}
+
+
+UniverseRoutes::UniverseRoutes()
+    : m_active(false) {
+}
+
+
+/*
+ * Add a route from this source.
+ */
+void UniverseRoutes::AddRoute(RouteDestination *destination,
+                              unsigned int source_offset,
+                              unsigned int length,
+                              unsigned int destination_offset) {
+  route new_route;
+  new_route.destination = destination;
+  new_route.source_offset = source_offset;
+  new_route.length = length;
+  new_route.destination_offset = destination_offset;
+  m_routes.push_back(new_route);
+  if (std::find(m_destinations.begin(), m_destinations.end(), destination) ==
+      m_destinations.end())
+    m_destinations.push_back(destination);
+}
+
+
+/*
+ * Remove all routes to a destination.
+ * @returns the number of routes removed.
+ */
+unsigned int UniverseRoutes::RemoveRoutesTo(
+    const RouteDestination *destination) {
+  unsigned int removed = 0;
+  vector<route>::iterator iter = m_routes.begin();
+  while (iter != m_routes.end()) {
+    if (iter->destination == destination) {
+      iter = m_routes.erase(iter);
+      removed++;
+    } else {
+      ++iter;
+    }
+  }
+  m_destinations.erase(
+      std::remove(m_destinations.begin(), m_destinations.end(), destination),
+      m_destinations.end());
+  return removed;
+}
+
+
+/*
+ * Called when the source universe has a new frame. This copies each slice
+ * and then sends each destination once.
+ */
+void UniverseRoutes::SourceChanged(const DmxBuffer &data) {
+  if (m_active) {
+    OLA_WARN << "Routing loop detected, dropping frame";
+    return;
+  }
+  m_active = true;
+
+  const uint8_t *raw = data.GetRaw();
+  unsigned int size = data.Size();
+  vector<route>::const_iterator iter = m_routes.begin();
+  for (; iter != m_routes.end(); ++iter) {
+    unsigned int available = iter->source_offset < size ?
+      size - iter->source_offset : 0;
+    iter->destination->Update(iter->destination_offset, iter->length,
+                              raw + iter->source_offset, available);
+  }
+
+  vector<RouteDestination*>::const_iterator dest_iter =
+    m_destinations.begin();
+  for (; dest_iter != m_destinations.end(); ++dest_iter)
+    (*dest_iter)->Send();
+  m_active = false;
+}
+
+
+/*
+ * The universes may have been deleted by now so we don't touch them.
+ */
+UniverseRouter::~UniverseRouter() {
+  SourceMap::iterator iter = m_sources.begin();
+  for (; iter != m_sources.end(); ++iter)
+    delete iter->second;
+  DestinationMap::iterator dest_iter = m_destinations.begin();
+  for (; dest_iter != m_destinations.end(); ++dest_iter)
+    delete dest_iter->second;
+}
+
+
+/*
+ * Add a route
+ * @param source the universe to take the data from
+ * @param source_offset the first channel in the source, starting from 0
+ * @param length the number of channels
+ * @param destination the virtual universe to build
+ * @param destination_offset the first channel in the destination
+ * @returns true if the route was added, false if it was invalid
+ */
+bool UniverseRouter::AddRoute(Universe *source,
+                              unsigned int source_offset,
+                              unsigned int length,
+                              Universe *destination,
+                              unsigned int destination_offset) {
+  // the offsets come from the preferences, so check them without overflowing
+  if (!source || !destination || source == destination || !length ||
+      length > DMX_UNIVERSE_SIZE ||
+      source_offset > DMX_UNIVERSE_SIZE - length ||
+      destination_offset > DMX_UNIVERSE_SIZE - length) {
+    OLA_WARN << "Invalid route";
+    return false;
+  }
+
+  RouteDestination *route_destination;
+  DestinationMap::iterator dest_iter = m_destinations.find(destination);
+  if (dest_iter == m_destinations.end()) {
+    route_destination = new RouteDestination(destination);
+    m_destinations[destination] = route_destination;
+  } else {
+    route_destination = dest_iter->second;
+  }
+  route_destination->ExtendTo(destination_offset + length);
+
+  UniverseRoutes *routes;
+  SourceMap::iterator source_iter = m_sources.find(source);
+  if (source_iter == m_sources.end()) {
+    routes = new UniverseRoutes();
+    m_sources[source] = routes;
+    source->SetRoutes(routes);
+  } else {
+    routes = source_iter->second;
+  }
+  routes->AddRoute(route_destination, source_offset, length,
+                   destination_offset);
+  m_route_count++;
+
+  // fill the new slice with the current data
+  if (source->GetDMX().Size())
+    routes->SourceChanged(source->GetDMX());
+  return true;
+}
+
+
+/*
+ * Remove all the routes to a universe.
+ * @param destination the virtual universe
+ * @param unused_sources if not NULL, the sources which no longer have any
+ *   routes are added to this.
+ */
+void UniverseRouter::RemoveRoutesTo(Universe *destination,
+                                    vector<Universe*> *unused_sources) {
+  DestinationMap::iterator dest_iter = m_destinations.find(destination);
+  if (dest_iter == m_destinations.end())
+    return;
+
+  SourceMap::iterator iter = m_sources.begin();
+  while (iter != m_sources.end()) {
+    m_route_count -= iter->second->RemoveRoutesTo(dest_iter->second);
+    if (iter->second->Empty()) {
+      iter->first->SetRoutes(NULL);
+      if (unused_sources)
+        unused_sources->push_back(iter->first);
+      delete iter->second;
+      m_sources.erase(iter++);
+    } else {
+      ++iter;
+    }
+  }
+  delete dest_iter->second;
+  m_destinations.erase(dest_iter);
+}
+
+
+/*
+ * Remove all routes.
+ */
+void UniverseRouter::RemoveAll() {
+  SourceMap::iterator iter = m_sources.begin();
+  for (; iter != m_sources.end(); ++iter) {
+    iter->first->SetRoutes(NULL);
+    delete iter->second;
+  }
+  m_sources.clear();
+
+  DestinationMap::iterator dest_iter = m_destinations.begin();
+  for (; dest_iter != m_destinations.end(); ++dest_iter)
+    delete dest_iter->second;
+  m_destinations.clear();
+  m_route_count = 0;
+}
+
+
+/*
+ * Check if a universe is the source or destination of a route.
+ */
+bool UniverseRouter::IsRouted(Universe *universe) const {
+  return (m_sources.find(universe) != m_sources.end() ||
+          m_destinations.find(universe) != m_destinations.end());
+}
+}  // ola
@@ -0,0 +1,121 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * UniverseRouter.h
+ * Builds virtual universes from slices of other universes.
+ * Copyright (C) 2012 Simon Newton
+ *
+ * Each source universe holds a pointer to its UniverseRoutes, the list of
+ * slices it feeds. When the source sends a frame only those slices are
+ * copied and only the universes they belong to are updated, so the cost
+ * doesn't depend on how many universes are routed in total.
+ */
+
+#ifndef OLAD_UNIVERSEROUTER_H_
+#define OLAD_UNIVERSEROUTER_H_
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include "ola/BaseTypes.h"
+#include "ola/DmxBuffer.h"
+
+namespace ola {
+
+class Universe;
+
+/*
+ * A universe built from routes.
+ */
+class RouteDestination {
+  public:
+    explicit RouteDestination(Universe *universe);
+
+    Universe *GetUniverse() const { return m_universe; }
+    unsigned int Length() const { return m_length; }
+    void ExtendTo(unsigned int length);
+    void Update(unsigned int offset, unsigned int length, const uint8_t *data,
+                unsigned int data_length);
+    void Send();
+
+  private:
+    Universe *m_universe;
+    unsigned int m_length;
+    DmxBuffer m_frame;
+    uint8_t m_data[DMX_UNIVERSE_SIZE];
+};
+
+
+/*
+ * The routes from a single source universe.
+ */
+class UniverseRoutes {
+  public:
+    UniverseRoutes();
+
+    void AddRoute(RouteDestination *destination,
+                  unsigned int source_offset,
+                  unsigned int length,
+                  unsigned int destination_offset);
+    unsigned int RemoveRoutesTo(const RouteDestination *destination);
+    bool Empty() const { return m_routes.empty(); }
+
+    void SourceChanged(const DmxBuffer &data);
+
+  private:
+    typedef struct {
+      RouteDestination *destination;
+      uint16_t source_offset;
+      uint16_t length;
+      uint16_t destination_offset;
+    } route;
+
+    std::vector<route> m_routes;
+    // each destination once, so it's only sent once per frame
+    std::vector<RouteDestination*> m_destinations;
+    bool m_active;  // guards against routing loops
+};
+
+
+class UniverseRouter {
+  public:
+    UniverseRouter() : m_route_count(0) {}
+    ~UniverseRouter();
+
+    bool AddRoute(Universe *source,
+                  unsigned int source_offset,
+                  unsigned int length,
+                  Universe *destination,
+                  unsigned int destination_offset);
+    void RemoveRoutesTo(Universe *destination,
+                        std::vector<Universe*> *unused_sources);
+    void RemoveAll();
+
+    bool IsRouted(Universe *universe) const;
+    unsigned int RouteCount() const { return m_route_count; }
+
+  private:
+    typedef std::map<Universe*, UniverseRoutes*> SourceMap;
+    typedef std::map<Universe*, RouteDestination*> DestinationMap;
+
+    SourceMap m_sources;
+    DestinationMap m_destinations;
+    unsigned int m_route_count;
+
+    UniverseRouter(const UniverseRouter&);
+    UniverseRouter& operator=(const UniverseRouter&);
+};
+}  // ola
+#endif  // OLAD_UNIVERSEROUTER_H_
@@ -0,0 +1,212 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * UniverseRouterTest.cpp
+ * Test fixture for the UniverseRouter class
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <vector>
+
+#include "ola/DmxBuffer.h"
+#include "olad/Preferences.h"
+#include "olad/Universe.h"
+#include "olad/UniverseRouter.h"
+#include "olad/UniverseStore.h"
+
+using ola::DmxBuffer;
+using ola::Universe;
+using ola::UniverseRouter;
+using ola::UniverseStore;
+using std::vector;
+
+
+class UniverseRouterTest: public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(UniverseRouterTest);
+  CPPUNIT_TEST(testRouting);
+  CPPUNIT_TEST(testInvalidRoutes);
+  CPPUNIT_TEST(testRemoveRoutes);
+  CPPUNIT_TEST(testLoop);
+  CPPUNIT_TEST(testPreferences);
+  CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void testRouting();
+    void testInvalidRoutes();
+    void testRemoveRoutes();
+    void testLoop();
+    void testPreferences();
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(UniverseRouterTest);
+
+
+/*
+ * Check a universe can be built from two others and that it's updated when
+ * either source changes.
+ */
+void UniverseRouterTest::testRouting() {
+  UniverseStore store(NULL, NULL);
+  Universe *source1 = store.GetUniverseOrCreate(1);
+  Universe *source2 = store.GetUniverseOrCreate(2);
+
+  DmxBuffer data;
+  data.SetFromString("1,2,3,4");
+  source1->SetDMX(data);
+
+  CPPUNIT_ASSERT(store.AddRoute(1, 1, 2, 10, 0));
+  CPPUNIT_ASSERT(store.AddRoute(2, 0, 3, 10, 4));
+  CPPUNIT_ASSERT(store.AddRoute(1, 0, 1, 10, 2));
+  CPPUNIT_ASSERT_EQUAL(3u, store.RouteCount());
+  Universe *destination = store.GetUniverse(10);
+  CPPUNIT_ASSERT(destination);
+
+  // the slices from universe 1 are filled in straight away
+  DmxBuffer expected;
+  expected.SetFromString("2,3,1,0,0,0,0");
+  CPPUNIT_ASSERT(expected == destination->GetDMX());
+
+  data.SetFromString("10,11,12");
+  source2->SetDMX(data);
+  expected.SetFromString("2,3,1,0,10,11,12");
+  CPPUNIT_ASSERT(expected == destination->GetDMX());
+
+  // only the slices from universe 1 change, short frames are zero filled
+  data.SetFromString("5,6");
+  source1->SetDMX(data);
+  expected.SetFromString("6,0,5,0,10,11,12");
+  CPPUNIT_ASSERT(expected == destination->GetDMX());
+
+  // an unchanged frame isn't routed
+  destination->SetDMX(data);
+  source1->SetDMX(data);
+  CPPUNIT_ASSERT(data == destination->GetDMX());
+
+  // virtual universes can feed other virtual universes
+  CPPUNIT_ASSERT(store.AddRoute(10, 0, 2, 11, 0));
+  data.SetFromString("7,8,9");
+  source1->SetDMX(data);
+  expected.SetFromString("8,9");
+  CPPUNIT_ASSERT(expected == store.GetUniverse(11)->GetDMX());
+}
+
+
+/*
+ * Check invalid routes are rejected.
+ */
+void UniverseRouterTest::testInvalidRoutes() {
+  UniverseStore store(NULL, NULL);
+  CPPUNIT_ASSERT(!store.AddRoute(1, 0, 10, 1, 20));
+  CPPUNIT_ASSERT(!store.AddRoute(1, 0, 0, 2, 0));
+  CPPUNIT_ASSERT(!store.AddRoute(1, 500, 13, 2, 0));
+  CPPUNIT_ASSERT(!store.AddRoute(1, 0, 13, 2, 500));
+  // offsets that wrap around
+  CPPUNIT_ASSERT(!store.AddRoute(1, 0, 10, 2, 4294967289u));
+  CPPUNIT_ASSERT(!store.AddRoute(1, 4294967289u, 10, 2, 0));
+  CPPUNIT_ASSERT(!store.AddRoute(1, 1, 4294967295u, 2, 0));
+  CPPUNIT_ASSERT(store.AddRoute(1, 0, 512, 2, 0));
+  CPPUNIT_ASSERT_EQUAL(1u, store.RouteCount());
+
+  UniverseRouter router;
+  CPPUNIT_ASSERT(!router.AddRoute(NULL, 0, 1, store.GetUniverse(2), 0));
+  CPPUNIT_ASSERT(!router.AddRoute(store.GetUniverse(1), 0, 1, NULL, 0));
+}
+
+
+/*
+ * Check that routed universes aren't garbage collected until the routes are
+ * removed.
+ */
+void UniverseRouterTest::testRemoveRoutes() {
+  UniverseStore store(NULL, NULL);
+  CPPUNIT_ASSERT(store.AddRoute(1, 0, 2, 10, 0));
+  CPPUNIT_ASSERT(store.AddRoute(2, 0, 2, 10, 2));
+  CPPUNIT_ASSERT(store.AddRoute(2, 0, 2, 11, 0));
+  CPPUNIT_ASSERT_EQUAL(4u, store.UniverseCount());
+
+  vector<Universe*> universes;
+  store.GetList(&universes);
+  vector<Universe*>::iterator iter = universes.begin();
+  for (; iter != universes.end(); ++iter)
+    store.AddUniverseGarbageCollection(*iter);
+  store.GarbageCollectUniverses();
+  CPPUNIT_ASSERT_EQUAL(4u, store.UniverseCount());
+
+  // universe 2 still feeds universe 11
+  store.RemoveRoutesTo(10);
+  CPPUNIT_ASSERT_EQUAL(1u, store.RouteCount());
+  store.GarbageCollectUniverses();
+  CPPUNIT_ASSERT_EQUAL(2u, store.UniverseCount());
+  CPPUNIT_ASSERT(!store.GetUniverse(1));
+  CPPUNIT_ASSERT(store.GetUniverse(2));
+  CPPUNIT_ASSERT(!store.GetUniverse(10));
+
+  // data from universe 2 no longer goes to 10
+  DmxBuffer data;
+  data.SetFromString("1,2");
+  store.GetUniverse(2)->SetDMX(data);
+  CPPUNIT_ASSERT(data == store.GetUniverse(11)->GetDMX());
+
+  store.RemoveRoutesTo(11);
+  CPPUNIT_ASSERT_EQUAL(0u, store.RouteCount());
+  store.GarbageCollectUniverses();
+  CPPUNIT_ASSERT_EQUAL(0u, store.UniverseCount());
+}
+
+
+/*
+ * Check that a routing loop doesn't recurse forever.
+ */
+void UniverseRouterTest::testLoop() {
+  UniverseStore store(NULL, NULL);
+  CPPUNIT_ASSERT(store.AddRoute(1, 0, 2, 2, 0));
+  CPPUNIT_ASSERT(store.AddRoute(2, 0, 2, 1, 2));
+
+  DmxBuffer data, expected;
+  data.SetFromString("1,2");
+  store.GetUniverse(1)->SetDMX(data);
+  expected.SetFromString("0,0,1,2");
+  // universe 1 is now a virtual universe, the frame it sends back to itself
+  // is dropped.
+  CPPUNIT_ASSERT(data == store.GetUniverse(2)->GetDMX());
+  CPPUNIT_ASSERT(expected == store.GetUniverse(1)->GetDMX());
+}
+
+
+/*
+ * Check the routes are loaded from the preferences.
+ */
+void UniverseRouterTest::testPreferences() {
+  ola::MemoryPreferences preferences("foo");
+  preferences.SetMultipleValue("route", "1:1-2 10:3");
+  preferences.SetMultipleValue("route", " 2:5   10:1 ");
+  preferences.SetMultipleValue("route", "1:0-2 10:3");
+  preferences.SetMultipleValue("route", "1:1-2 10");
+  preferences.SetMultipleValue("route", "1:2-1 10:1");
+  preferences.SetMultipleValue("route", "1:1-10 10:4294967290");
+  preferences.SetMultipleValue("route", "bogus");
+
+  UniverseStore store(&preferences, NULL);
+  CPPUNIT_ASSERT_EQUAL(2u, store.RouteCount());
+
+  DmxBuffer data, expected;
+  data.SetFromString("1,2,3,4,5");
+  store.GetUniverse(1)->SetDMX(data);
+  store.GetUniverse(2)->SetDMX(data);
+  expected.SetFromString("5,0,1,2");
+  CPPUNIT_ASSERT(expected == store.GetUniverse(10)->GetDMX());
+}
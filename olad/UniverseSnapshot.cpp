@@ -0,0 +1,143 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * UniverseSnapshot.cpp
+ * Lets other threads read the data for a universe without locking.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <string.h>
+#include <map>
+#include "olad/UniverseSnapshot.h"
+
+namespace ola {
+
+using ola::thread::MutexLocker;
+
+
+UniverseSnapshot::UniverseSnapshot()
+    : m_latest(0) {
+  for (unsigned int i = 0; i < 2; i++) {
+    m_frames[i].sequence = 0;
+    m_frames[i].exists = false;
+    m_frames[i].length = 0;
+  }
+}
+
+
+/*
+ * Publish a new frame.
+ */
+void UniverseSnapshot::Publish(const DmxBuffer &buffer) {
+  Write(true, buffer);
+}
+
+
+/*
+ * Mark the universe as deleted.
+ */
+void UniverseSnapshot::Clear() {
+  Write(false, DmxBuffer());
+}
+
+
+/*
+ * Read the latest frame.
+ * @param buffer the DmxBuffer to copy the frame to
+ * @returns true if the universe exists, false otherwise
+ */
+bool UniverseSnapshot::Read(DmxBuffer *buffer) const {
+  uint8_t data[DMX_UNIVERSE_SIZE];
+  while (true) {
+    uint32_t latest = m_latest;
+    __sync_synchronize();
+    const frame &current = m_frames[latest & 1];
+    uint32_t sequence = current.sequence;
+    __sync_synchronize();
+    if (sequence & 1)
+      continue;
+
+    bool exists = current.exists;
+    unsigned int length = current.length;
+    if (length > DMX_UNIVERSE_SIZE)
+      length = 0;
+    memcpy(data, current.data, length);
+    __sync_synchronize();
+    if (current.sequence != sequence)
+      continue;
+
+    if (exists)
+      buffer->Set(data, length);
+    else
+      buffer->Reset();
+    return exists;
+  }
+}
+
+
+/*
+ * Fill in the frame the readers aren't using and then switch them to it.
+ */
+void UniverseSnapshot::Write(bool exists, const DmxBuffer &buffer) {
+  uint32_t next = m_latest + 1;
+  frame &next_frame = m_frames[next & 1];
+
+  next_frame.sequence++;
+  __sync_synchronize();
+  next_frame.exists = exists;
+  next_frame.length = buffer.Size();
+  memcpy(next_frame.data, buffer.GetRaw(), next_frame.length);
+  __sync_synchronize();
+  next_frame.sequence++;
+  __sync_synchronize();
+  m_latest = next;
+}
+
+
+UniverseSnapshotTable::~UniverseSnapshotTable() {
+  SnapshotMap::iterator iter = m_snapshots.begin();
+  for (; iter != m_snapshots.end(); ++iter)
+    delete iter->second;
+}
+
+
+/*
+ * Get the snapshot for a universe, creating it if it doesn't exist.
+ */
+UniverseSnapshot *UniverseSnapshotTable::GetOrCreate(
+    unsigned int universe_id) {
+  MutexLocker locker(&m_mutex);
+  SnapshotMap::iterator iter = m_snapshots.find(universe_id);
+  if (iter != m_snapshots.end())
+    return iter->second;
+
+  UniverseSnapshot *snapshot = new UniverseSnapshot();
+  m_snapshots[universe_id] = snapshot;
+  return snapshot;
+}
+
+
+/*
+ * Get the snapshot for a universe.
+ */
+const UniverseSnapshot *UniverseSnapshotTable::Get(
+    unsigned int universe_id) const {
+  MutexLocker locker(&m_mutex);
+  SnapshotMap::const_iterator iter = m_snapshots.find(universe_id);
+  if (iter == m_snapshots.end())
+    return NULL;
+  return iter->second;
+}
+}  // ola
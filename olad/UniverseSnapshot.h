@@ -0,0 +1,94 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * UniverseSnapshot.h
+ * Lets other threads read the data for a universe without locking.
+ * Copyright (C) 2012 Simon Newton
+ *
+ * Each universe publishes its frames to a UniverseSnapshot. There are two
+ * copies of the frame, each protected by a sequence number. The writer fills
+ * in the copy the readers aren't using and then points them at it. A reader
+ * retries if the sequence number of the copy it read changed, which only
+ * happens if two new frames were published while it was copying.
+ *
+ * There must only be a single writer, the thread that runs the universes.
+ */
+
+#ifndef OLAD_UNIVERSESNAPSHOT_H_
+#define OLAD_UNIVERSESNAPSHOT_H_
+
+#include <stdint.h>
+#include <map>
+#include "ola/BaseTypes.h"
+#include "ola/DmxBuffer.h"
+#include "ola/thread/Mutex.h"
+
+namespace ola {
+
+class UniverseSnapshot {
+  public:
+    UniverseSnapshot();
+
+    // Called by the writer
+    void Publish(const DmxBuffer &buffer);
+    void Clear();
+
+    // Can be called from any thread
+    bool Read(DmxBuffer *buffer) const;
+
+  private:
+    typedef struct {
+      volatile uint32_t sequence;  // odd while the frame is being written
+      bool exists;
+      unsigned int length;
+      uint8_t data[DMX_UNIVERSE_SIZE];
+    } frame;
+
+    frame m_frames[2];
+    volatile uint32_t m_latest;  // the frame readers should use
+
+    void Write(bool exists, const DmxBuffer &buffer);
+
+    UniverseSnapshot(const UniverseSnapshot&);
+    UniverseSnapshot& operator=(const UniverseSnapshot&);
+};
+
+
+/*
+ * The snapshots for all universes. Snapshots are never deleted, once a
+ * universe has a snapshot the pointer remains valid until the table is
+ * destroyed, so readers can keep it and skip the lookup next time.
+ */
+class UniverseSnapshotTable {
+  public:
+    UniverseSnapshotTable() {}
+    ~UniverseSnapshotTable();
+
+    UniverseSnapshot *GetOrCreate(unsigned int universe_id);
+    // Returns NULL if the universe never existed.
+    const UniverseSnapshot *Get(unsigned int universe_id) const;
+
+  private:
+    typedef std::map<unsigned int, UniverseSnapshot*> SnapshotMap;
+
+    // guards the map, not the snapshots
+    mutable ola::thread::Mutex m_mutex;
+    SnapshotMap m_snapshots;
+
+    UniverseSnapshotTable(const UniverseSnapshotTable&);
+    UniverseSnapshotTable& operator=(const UniverseSnapshotTable&);
+};
+}  // ola
+#endif  // OLAD_UNIVERSESNAPSHOT_H_
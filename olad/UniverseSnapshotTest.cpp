@@ -0,0 +1,171 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * UniverseSnapshotTest.cpp
+ * Test fixture for the UniverseSnapshot class
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <string.h>
+
+#include "ola/BaseTypes.h"
+#include "ola/DmxBuffer.h"
+#include "ola/thread/Thread.h"
+#include "olad/Universe.h"
+#include "olad/UniverseSnapshot.h"
+#include "olad/UniverseStore.h"
+
+using ola::DmxBuffer;
+using ola::Universe;
+using ola::UniverseSnapshot;
+using ola::UniverseSnapshotTable;
+
+
+class UniverseSnapshotTest: public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(UniverseSnapshotTest);
+  CPPUNIT_TEST(testSnapshot);
+  CPPUNIT_TEST(testUniverseStore);
+  CPPUNIT_TEST(testConcurrentReads);
+  CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void testSnapshot();
+    void testUniverseStore();
+    void testConcurrentReads();
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(UniverseSnapshotTest);
+
+
+/*
+ * Publishes frames where every slot is the frame number and the length
+ * changes with the frame number.
+ */
+class PublishingThread: public ola::thread::Thread {
+  public:
+    PublishingThread(UniverseSnapshot *snapshot, unsigned int frames)
+        : m_snapshot(snapshot),
+          m_frames(frames) {
+    }
+
+  protected:
+    void *Run() {
+      uint8_t data[DMX_UNIVERSE_SIZE];
+      DmxBuffer buffer;
+      for (unsigned int i = 0; i < m_frames; i++) {
+        unsigned int length = 1 + i % DMX_UNIVERSE_SIZE;
+        memset(data, i, length);
+        buffer.Set(data, length);
+        m_snapshot->Publish(buffer);
+      }
+      return NULL;
+    }
+
+  private:
+    UniverseSnapshot *m_snapshot;
+    unsigned int m_frames;
+};
+
+
+/*
+ * Check publishing and reading a snapshot.
+ */
+void UniverseSnapshotTest::testSnapshot() {
+  UniverseSnapshot snapshot;
+  DmxBuffer buffer, result;
+  buffer.SetFromString("1,2,3");
+  CPPUNIT_ASSERT(!snapshot.Read(&result));
+  CPPUNIT_ASSERT_EQUAL(0u, result.Size());
+
+  snapshot.Publish(buffer);
+  CPPUNIT_ASSERT(snapshot.Read(&result));
+  CPPUNIT_ASSERT(buffer == result);
+
+  buffer.SetFromString("4,5");
+  snapshot.Publish(buffer);
+  CPPUNIT_ASSERT(snapshot.Read(&result));
+  CPPUNIT_ASSERT(buffer == result);
+
+  // an empty universe still exists
+  snapshot.Publish(DmxBuffer());
+  CPPUNIT_ASSERT(snapshot.Read(&result));
+  CPPUNIT_ASSERT_EQUAL(0u, result.Size());
+
+  snapshot.Clear();
+  CPPUNIT_ASSERT(!snapshot.Read(&result));
+}
+
+
+/*
+ * Check universes publish their data and that the snapshot remains valid once
+ * the universe is deleted.
+ */
+void UniverseSnapshotTest::testUniverseStore() {
+  ola::UniverseStore store(NULL, NULL);
+  const UniverseSnapshotTable *snapshots = store.Snapshots();
+  CPPUNIT_ASSERT(!snapshots->Get(1));
+
+  Universe *universe = store.GetUniverseOrCreate(1);
+  const UniverseSnapshot *snapshot = snapshots->Get(1);
+  CPPUNIT_ASSERT(snapshot);
+
+  DmxBuffer buffer, result;
+  CPPUNIT_ASSERT(snapshot->Read(&result));
+  CPPUNIT_ASSERT_EQUAL(0u, result.Size());
+
+  buffer.SetFromString("10,20,30");
+  universe->SetDMX(buffer);
+  CPPUNIT_ASSERT(snapshot->Read(&result));
+  CPPUNIT_ASSERT(buffer == result);
+
+  store.AddUniverseGarbageCollection(universe);
+  store.GarbageCollectUniverses();
+  CPPUNIT_ASSERT(!store.GetUniverse(1));
+  CPPUNIT_ASSERT(!snapshot->Read(&result));
+
+  // a new universe with the same id uses the same snapshot
+  universe = store.GetUniverseOrCreate(1);
+  CPPUNIT_ASSERT_EQUAL(snapshot, snapshots->Get(1));
+  CPPUNIT_ASSERT(snapshot->Read(&result));
+}
+
+
+/*
+ * Check a reader never sees a partially written frame.
+ */
+void UniverseSnapshotTest::testConcurrentReads() {
+  UniverseSnapshot snapshot;
+  const unsigned int frames = 200000;
+  PublishingThread publisher(&snapshot, frames);
+  publisher.Start();
+
+  DmxBuffer result;
+  unsigned int reads = 0;
+  while (reads < frames / 10) {
+    if (!snapshot.Read(&result))
+      continue;
+    reads++;
+    const uint8_t *data = result.GetRaw();
+    unsigned int length = result.Size();
+    CPPUNIT_ASSERT(length);
+    // the length and every slot come from the same frame
+    for (unsigned int i = 0; i < length; i++)
+      CPPUNIT_ASSERT_EQUAL(data[0], data[i]);
+    CPPUNIT_ASSERT_EQUAL((length - 1) % 256, (unsigned int) data[0]);
+  }
+  publisher.Join();
+}
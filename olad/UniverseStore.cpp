@@ -19,6 +19,7 @@
  * Copyright (C) 2005-2008 Simon Newton
  */
 
+#include <algorithm>
 #include <iostream>
 #include <map>
 #include <set>
@@ -29,20 +30,43 @@
 
 #include "ola/ExportMap.h"
 #include "ola/Logging.h"
+#include "ola/StringUtils.h"
+#include "olad/OutputScheduler.h"
 #include "olad/Preferences.h"
 #include "olad/Universe.h"
 #include "olad/UniverseStore.h"
+#include "olad/UniverseTransform.h"
 namespace ola {
 
-using std::pair;
+using std::vector;
 
+const char UniverseStore::ROUTE_KEY[] = "route";
+
+/*
+ * Create a new UniverseStore
+ * @param preferences the Preferences used to store the universe settings
+ * @param export_map the ExportMap to update, may be NULL
+ * @param scheduler the scheduler used for the output frame rate limit,
+ *   keepalive and source timeout timers. If NULL every frame is written
+ *   immediately, nothing is resent and sources only time out when another
+ *   source sends data.
+ */
 UniverseStore::UniverseStore(Preferences *preferences,
-                             ExportMap *export_map)
+                             ExportMap *export_map,
+                             ola::thread::SchedulerInterface *scheduler)
     : m_preferences(preferences),
-      m_export_map(export_map) {
+      m_export_map(export_map),
+      m_universe_count(0),
+      m_scheduler(scheduler),
+      m_output_scheduler(NULL) {
+  if (scheduler)
+    m_output_scheduler = new OutputScheduler(scheduler, export_map, &m_clock);
+
   if (export_map) {
-    export_map->GetStringMapVar(Universe::K_UNIVERSE_NAME_VAR, "universe");
-    export_map->GetStringMapVar(Universe::K_UNIVERSE_MODE_VAR, "universe");
+    export_map->GetStringIndexedMapVar(Universe::K_UNIVERSE_NAME_VAR,
+                                       "universe");
+    export_map->GetStringIndexedMapVar(Universe::K_UNIVERSE_MODE_VAR,
+                                       "universe");
 
     const char *vars[] = {
       Universe::K_FPS_VAR,
@@ -54,8 +78,11 @@ UniverseStore::UniverseStore(Preferences *preferences,
     };
 
     for (unsigned int i = 0; i < sizeof(vars) / sizeof(vars[0]); ++i)
-      export_map->GetUIntMapVar(string(vars[i]), "universe");
+      export_map->GetUIntIndexedMapVar(string(vars[i]), "universe");
   }
+
+  if (m_preferences)
+    LoadRoutes();
 }
 
 
@@ -64,6 +91,7 @@ UniverseStore::UniverseStore(Preferences *preferences,
  */
 UniverseStore::~UniverseStore() {
   DeleteAll();
+  delete m_output_scheduler;
 }
 
 
@@ -72,6 +100,11 @@ UniverseStore::~UniverseStore() {
  * @param uid the uid of the required universe
  */
 Universe *UniverseStore::GetUniverse(unsigned int universe_id) const {
+  if (universe_id < m_universe_table.size())
+    return m_universe_table[universe_id];
+  if (universe_id < MAX_TABLE_UNIVERSE)
+    return NULL;
+
   universe_map::const_iterator iter = m_universe_map.find(universe_id);
   if (iter != m_universe_map.end())
      return iter->second;
@@ -91,8 +124,14 @@ Universe *UniverseStore::GetUniverseOrCreate(unsigned int universe_id) {
     universe = new Universe(universe_id, this, m_export_map, &m_clock);
 
     if (universe) {
-      pair<unsigned int, Universe*> pair(universe_id, universe);
-      m_universe_map.insert(pair);
+      AddToTable(universe);
+      universe->SetSnapshot(m_snapshots.GetOrCreate(universe_id));
+
+      if (m_output_scheduler) {
+        universe->SetKeepAliveInterval(DEFAULT_KEEPALIVE_INTERVAL);
+        universe->SetOutputScheduler(m_output_scheduler);
+        universe->SetScheduler(m_scheduler);
+      }
 
       if (m_preferences)
         RestoreUniverseSettings(universe);
@@ -110,7 +149,13 @@ Universe *UniverseStore::GetUniverseOrCreate(unsigned int universe_id) {
  * @return a pointer to a vector of Universe*
  */
 void UniverseStore::GetList(std::vector<Universe*> *universes) const {
-  universes->reserve(UniverseCount());
+  universes->reserve(universes->size() + UniverseCount());
+
+  universe_table::const_iterator table_iter = m_universe_table.begin();
+  for (; table_iter != m_universe_table.end(); ++table_iter) {
+    if (*table_iter)
+      universes->push_back(*table_iter);
+  }
 
   universe_map::const_iterator iter;
   for (iter = m_universe_map.begin(); iter != m_universe_map.end(); ++iter)
@@ -122,14 +167,19 @@ void UniverseStore::GetList(std::vector<Universe*> *universes) const {
  * Delete all universes
  */
 void UniverseStore::DeleteAll() {
-  universe_map::iterator iter;
-
-  for (iter = m_universe_map.begin(); iter != m_universe_map.end(); iter++) {
-    SaveUniverseSettings(iter->second);
-    delete iter->second;
+  m_router.RemoveAll();
+
+  vector<Universe*> universes;
+  GetList(&universes);
+  vector<Universe*>::iterator iter;
+  for (iter = universes.begin(); iter != universes.end(); iter++) {
+    SaveUniverseSettings(*iter);
+    delete *iter;
   }
   m_deletion_candiates.clear();
+  m_universe_table.clear();
   m_universe_map.clear();
+  m_universe_count = 0;
 }
 
 
@@ -144,17 +194,16 @@ void UniverseStore::AddUniverseGarbageCollection(Universe *universe) {
 
 /*
  * Check all the garbage collection candiates and delete the ones that aren't
- * needed.
+ * needed. This only looks at the candidates, not every universe.
  */
 void UniverseStore::GarbageCollectUniverses() {
   set<Universe*>::iterator iter;
-  universe_map::iterator map_iter;
 
   for (iter = m_deletion_candiates.begin();
        iter != m_deletion_candiates.end(); iter++) {
-    if (!(*iter)->IsActive()) {
+    if (!(*iter)->IsActive() && !m_router.IsRouted(*iter)) {
       SaveUniverseSettings(*iter);
-      m_universe_map.erase((*iter)->UniverseId());
+      RemoveFromTable((*iter)->UniverseId());
       delete *iter;
     }
   }
@@ -162,6 +211,146 @@ void UniverseStore::GarbageCollectUniverses() {
 }
 
 
+/*
+ * Route a slice of one universe into another, creating the universes if
+ * required.
+ * @param source_id the universe to take the data from
+ * @param source_offset the first channel in the source, starting from 0
+ * @param length the number of channels
+ * @param destination_id the virtual universe
+ * @param destination_offset the first channel in the destination
+ * @returns true if the route was added, false if it was invalid
+ */
+bool UniverseStore::AddRoute(unsigned int source_id,
+                             unsigned int source_offset,
+                             unsigned int length,
+                             unsigned int destination_id,
+                             unsigned int destination_offset) {
+  if (source_id == destination_id)
+    return false;
+
+  Universe *source = GetUniverseOrCreate(source_id);
+  Universe *destination = GetUniverseOrCreate(destination_id);
+  if (!source || !destination)
+    return false;
+
+  if (!m_router.AddRoute(source, source_offset, length, destination,
+                         destination_offset)) {
+    AddUniverseGarbageCollection(source);
+    AddUniverseGarbageCollection(destination);
+    return false;
+  }
+  return true;
+}
+
+
+/*
+ * Remove all the routes to a virtual universe. The universe and any sources
+ * that are no longer used will be garbage collected if they're not active.
+ * @param destination_id the virtual universe
+ */
+void UniverseStore::RemoveRoutesTo(unsigned int destination_id) {
+  Universe *destination = GetUniverse(destination_id);
+  if (!destination)
+    return;
+
+  vector<Universe*> unused_sources;
+  m_router.RemoveRoutesTo(destination, &unused_sources);
+  vector<Universe*>::iterator iter = unused_sources.begin();
+  for (; iter != unused_sources.end(); ++iter)
+    AddUniverseGarbageCollection(*iter);
+  AddUniverseGarbageCollection(destination);
+}
+
+
+/*
+ * Load the routes from the preferences.
+ */
+void UniverseStore::LoadRoutes() {
+  vector<string> routes = m_preferences->GetMultipleValue(ROUTE_KEY);
+  vector<string>::const_iterator iter = routes.begin();
+  for (; iter != routes.end(); ++iter) {
+    if (!AddRouteFromString(*iter))
+      OLA_WARN << "Invalid route: " << *iter;
+  }
+}
+
+
+/*
+ * Add a route in the form "<src_uni>:<first>-<last> <dst_uni>:<first>", the
+ * channels start from 1. i.e "1:1-100 10:101" copies the first 100 channels
+ * of universe 1 to channels 101 - 200 of universe 10.
+ */
+bool UniverseStore::AddRouteFromString(const string &route) {
+  vector<string> tokens;
+  string trimmed_route = route;
+  StringTrim(&trimmed_route);
+  StringSplit(trimmed_route, tokens, " \t");
+  tokens.erase(std::remove(tokens.begin(), tokens.end(), ""), tokens.end());
+  if (tokens.size() != 2)
+    return false;
+
+  vector<string> source, destination, channels;
+  StringSplit(tokens[0], source, ":");
+  StringSplit(tokens[1], destination, ":");
+  if (source.size() != 2 || destination.size() != 2)
+    return false;
+  StringSplit(source[1], channels, "-");
+  if (channels.size() > 2)
+    return false;
+
+  unsigned int source_id, first, last, destination_id, destination_first;
+  if (!StringToInt(source[0], &source_id) ||
+      !StringToInt(channels[0], &first) ||
+      !StringToInt(channels[channels.size() - 1], &last) ||
+      !StringToInt(destination[0], &destination_id) ||
+      !StringToInt(destination[1], &destination_first))
+    return false;
+
+  if (!first || first > last || !destination_first)
+    return false;
+  return AddRoute(source_id, first - 1, last - first + 1, destination_id,
+                  destination_first - 1);
+}
+
+
+/*
+ * Add a universe to the table, growing it if needed.
+ */
+void UniverseStore::AddToTable(Universe *universe) {
+  unsigned int universe_id = universe->UniverseId();
+  if (universe_id < MAX_TABLE_UNIVERSE) {
+    if (universe_id >= m_universe_table.size()) {
+      // double the size so adding universes in order is amortized O(1)
+      unsigned int size = m_universe_table.size() * 2;
+      if (size < MIN_TABLE_SIZE)
+        size = MIN_TABLE_SIZE;
+      if (size <= universe_id)
+        size = universe_id + 1;
+      if (size > MAX_TABLE_UNIVERSE)
+        size = MAX_TABLE_UNIVERSE;
+      m_universe_table.resize(size, NULL);
+    }
+    m_universe_table[universe_id] = universe;
+  } else {
+    m_universe_map[universe_id] = universe;
+  }
+  m_universe_count++;
+}
+
+
+void UniverseStore::RemoveFromTable(unsigned int universe_id) {
+  if (universe_id < m_universe_table.size()) {
+    if (m_universe_table[universe_id]) {
+      m_universe_table[universe_id] = NULL;
+      m_universe_count--;
+    }
+  } else if (m_universe_map.erase(universe_id)) {
+    m_universe_count--;
+  }
+}
+
+
 /*
  * Restore a universe's settings
  * @param uni  the universe to update
@@ -192,6 +381,30 @@ bool UniverseStore::RestoreUniverseSettings(Universe *universe) const {
     else
       universe->SetMergeMode(Universe::MERGE_LTP);
   }
+
+  // load the output frame rate limit
+  unsigned int int_value;
+  key = "uni_" + oss.str() + "_max_fps";
+  value = m_preferences->GetValue(key);
+  if (!value.empty() && StringToInt(value, &int_value))
+    universe->SetMaxFrameRate(int_value);
+
+  // load the keepalive interval
+  key = "uni_" + oss.str() + "_keepalive_ms";
+  value = m_preferences->GetValue(key);
+  if (!value.empty() && StringToInt(value, &int_value))
+    universe->SetKeepAliveInterval(int_value);
+
+  // load the transform rules, invalid rules are skipped
+  key = "uni_" + oss.str() + "_transform";
+  vector<string> rules = m_preferences->GetMultipleValue(key);
+  if (!rules.empty()) {
+    UniverseTransform *transform = new UniverseTransform();
+    vector<string>::const_iterator iter = rules.begin();
+    for (; iter != rules.end(); ++iter)
+      transform->AddRule(*iter);
+    universe->SetTransform(transform);
+  }
   return 0;
 }
 
@@ -218,6 +431,12 @@ bool UniverseStore::SaveUniverseSettings(Universe *universe) const {
   mode = (universe->MergeMode() == Universe::MERGE_HTP ? "HTP" : "LTP");
   m_preferences->SetValue(key, mode);
 
+  // save the output frame rate limit & keepalive interval
+  key = "uni_" + oss.str() + "_max_fps";
+  m_preferences->SetValue(key, IntToString(universe->MaxFrameRate()));
+  key = "uni_" + oss.str() + "_keepalive_ms";
+  m_preferences->SetValue(key, IntToString(universe->KeepAliveInterval()));
+
   return 0;
 }
 }  // ola
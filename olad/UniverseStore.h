@@ -26,41 +26,77 @@
 #include <string>
 #include <vector>
 #include "ola/Clock.h"
+#include "ola/thread/SchedulerInterface.h"
+#include "olad/UniverseRouter.h"
+#include "olad/UniverseSnapshot.h"
 
 namespace ola {
 
+class OutputScheduler;
 class Universe;
 
 class UniverseStore {
   public:
-    UniverseStore(class Preferences *preferences, class ExportMap *export_map);
+    UniverseStore(class Preferences *preferences,
+                  class ExportMap *export_map,
+                  ola::thread::SchedulerInterface *scheduler = NULL);
     ~UniverseStore();
 
     Universe *GetUniverse(unsigned int universe_id) const;
     Universe *GetUniverseOrCreate(unsigned int universe_id);
 
-    unsigned int UniverseCount() const { return m_universe_map.size(); }
+    unsigned int UniverseCount() const { return m_universe_count; }
     void GetList(std::vector<Universe*> *universes) const;
 
     void DeleteAll();
     void AddUniverseGarbageCollection(Universe *universe);
     void GarbageCollectUniverses();
 
+    // Virtual universes, channels are numbered from 0
+    bool AddRoute(unsigned int source_id,
+                  unsigned int source_offset,
+                  unsigned int length,
+                  unsigned int destination_id,
+                  unsigned int destination_offset);
+    void RemoveRoutesTo(unsigned int destination_id);
+    unsigned int RouteCount() const { return m_router.RouteCount(); }
+
+    // The universe data, this can be read from any thread
+    const UniverseSnapshotTable *Snapshots() const { return &m_snapshots; }
+
   private:
     typedef std::map<unsigned int, Universe*> universe_map;
+    typedef std::vector<Universe*> universe_table;
 
     Preferences *m_preferences;
     ExportMap *m_export_map;
-    // map of universe_id to Universe
+    // Universes with ids below MAX_TABLE_UNIVERSE are indexed by id, which
+    // covers the ArtNet & E1.31 ranges. The table grows to fit the highest id
+    // used. Universes with larger ids are kept in a map.
+    universe_table m_universe_table;
     universe_map m_universe_map;
+    unsigned int m_universe_count;
     std::set<Universe*> m_deletion_candiates;  // list of universes we may be
                                                // able to delete
     Clock m_clock;
+    ola::thread::SchedulerInterface *m_scheduler;
+    OutputScheduler *m_output_scheduler;
+    UniverseRouter m_router;
+    UniverseSnapshotTable m_snapshots;
 
     explicit UniverseStore(const ola::UniverseStore&);
     UniverseStore& operator=(const UniverseStore&);
     bool RestoreUniverseSettings(Universe *universe) const;
     bool SaveUniverseSettings(Universe *universe) const;
+    void AddToTable(Universe *universe);
+    void RemoveFromTable(unsigned int universe_id);
+    void LoadRoutes();
+    bool AddRouteFromString(const std::string &route);
+
+    static const unsigned int DEFAULT_KEEPALIVE_INTERVAL = 1000;
+    static const unsigned int MAX_TABLE_UNIVERSE = 65536;
+    static const unsigned int MIN_TABLE_SIZE = 64;
+    static const char ROUTE_KEY[];
 };
 }  // ola
 #endif  // OLAD_UNIVERSESTORE_H_
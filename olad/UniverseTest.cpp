@@ -19,7 +19,9 @@
  */
 
 #include <cppunit/extensions/HelperMacros.h>
+#include <map>
 #include <string>
+#include <vector>
 
 #include "ola/Clock.h"
 #include "ola/DmxBuffer.h"
@@ -30,6 +32,7 @@
 #include "olad/PortBroker.h"
 #include "olad/PortManager.h"
 #include "ola/network/SelectServerInterface.h"
+#include "ola/thread/SchedulerInterface.h"
 #include "olad/Preferences.h"
 #include "olad/TestCommon.h"
 #include "olad/Universe.h"
@@ -38,9 +41,14 @@
 using ola::AbstractDevice;
 using ola::Clock;
 using ola::DmxBuffer;
+using ola::MockClock;
+using ola::TimeInterval;
 using ola::TimeStamp;
 using ola::Universe;
+using ola::thread::timeout_id;
+using std::map;
 using std::string;
+using std::vector;
 
 static unsigned int TEST_UNIVERSE = 1;
 static const char TEST_DATA[] = "this is some test data";
@@ -49,26 +57,34 @@ static const char TEST_DATA[] = "this is some test data";
 class UniverseTest: public CppUnit::TestFixture {
   CPPUNIT_TEST_SUITE(UniverseTest);
   CPPUNIT_TEST(testLifecycle);
+  CPPUNIT_TEST(testUniverseIds);
   CPPUNIT_TEST(testSetGet);
   CPPUNIT_TEST(testSendDmx);
+  CPPUNIT_TEST(testChangeDetection);
   CPPUNIT_TEST(testReceiveDmx);
   CPPUNIT_TEST(testSourceClients);
   CPPUNIT_TEST(testSinkClients);
   CPPUNIT_TEST(testLtpMerging);
   CPPUNIT_TEST(testHtpMerging);
+  CPPUNIT_TEST(testSourceExpiry);
+  CPPUNIT_TEST(testSlotPriorityWrites);
   CPPUNIT_TEST_SUITE_END();
 
   public:
     void setUp();
     void tearDown();
     void testLifecycle();
+    void testUniverseIds();
     void testSetGet();
     void testSendDmx();
+    void testChangeDetection();
     void testReceiveDmx();
     void testSourceClients();
     void testSinkClients();
     void testLtpMerging();
     void testHtpMerging();
+    void testSourceExpiry();
+    void testSlotPriorityWrites();
 
   private:
     ola::MemoryPreferences *m_preferences;
@@ -91,6 +107,127 @@ class MockClient: public ola::Client {
 };
 
 
+/*
+ * An output port which records the changes it was given
+ */
+class ChangeRecordingOutputPort: public TestMockOutputPort {
+  public:
+    ChangeRecordingOutputPort(AbstractDevice *parent, unsigned int port_id):
+      TestMockOutputPort(parent, port_id),
+      m_writes(0) {
+    }
+
+    bool WriteDMX(const DmxBuffer &buffer, uint8_t priority,
+                  const ola::dmx_change &change) {
+      m_change = change;
+      m_writes++;
+      return TestMockOutputPort::WriteDMX(buffer, priority);
+    }
+
+    ola::dmx_change m_change;
+    unsigned int m_writes;
+};
+
+
+/*
+ * An output port which counts the slot priorities it was given
+ */
+class SlotPriorityOutputPort: public TestMockOutputPort {
+  public:
+    SlotPriorityOutputPort(AbstractDevice *parent, unsigned int port_id):
+      TestMockOutputPort(parent, port_id),
+      m_priority_writes(0) {
+    }
+
+    bool WriteSlotPriorities(const DmxBuffer &slot_priorities) {
+      m_slot_priorities = slot_priorities;
+      m_priority_writes++;
+      return true;
+    }
+
+    DmxBuffer m_slot_priorities;
+    unsigned int m_priority_writes;
+};
+
+
+/*
+ * A scheduler which runs single timeouts once a MockClock reaches their
+ * deadline.
+ */
+class SingleTimeoutScheduler: public ola::thread::SchedulerInterface {
+  public:
+    explicit SingleTimeoutScheduler(const MockClock *clock)
+        : m_clock(clock),
+          m_registrations(0) {
+    }
+
+    ~SingleTimeoutScheduler() {
+      TimerMap::iterator iter = m_timers.begin();
+      for (; iter != m_timers.end(); ++iter)
+        delete iter->first;
+    }
+
+    timeout_id RegisterRepeatingTimeout(unsigned int,
+                                        ola::Callback0<bool> *closure) {
+      delete closure;
+      return ola::thread::INVALID_TIMEOUT;
+    }
+
+    timeout_id RegisterRepeatingTimeout(const TimeInterval&,
+                                        ola::Callback0<bool> *closure,
+                                        ola::thread::TimerMode) {
+      delete closure;
+      return ola::thread::INVALID_TIMEOUT;
+    }
+
+    timeout_id RegisterSingleTimeout(unsigned int ms,
+                                     ola::SingleUseCallback0<void> *closure) {
+      TimeStamp now;
+      m_clock->CurrentTime(&now);
+      m_timers[closure] = now + TimeInterval(ms * 1000);
+      m_registrations++;
+      return closure;
+    }
+
+    void RemoveTimeout(timeout_id id) {
+      TimerMap::iterator iter = m_timers.find(
+          static_cast<ola::SingleUseCallback0<void>*>(id));
+      if (iter != m_timers.end()) {
+        delete iter->first;
+        m_timers.erase(iter);
+      }
+    }
+
+    void RunDueTimers() {
+      TimeStamp now;
+      m_clock->CurrentTime(&now);
+      vector<ola::SingleUseCallback0<void>*> due;
+      TimerMap::iterator iter = m_timers.begin();
+      while (iter != m_timers.end()) {
+        if (iter->second <= now) {
+          due.push_back(iter->first);
+          m_timers.erase(iter++);
+        } else {
+          ++iter;
+        }
+      }
+      vector<ola::SingleUseCallback0<void>*>::iterator due_iter = due.begin();
+      for (; due_iter != due.end(); ++due_iter)
+        (*due_iter)->Run();
+    }
+
+    unsigned int TimerCount() const { return m_timers.size(); }
+    unsigned int Registrations() const { return m_registrations; }
+
+  private:
+    typedef map<ola::SingleUseCallback0<void>*, TimeStamp> TimerMap;
+
+    const MockClock *m_clock;
+    TimerMap m_timers;
+    unsigned int m_registrations;
+};
+
+
 CPPUNIT_TEST_SUITE_REGISTRATION(UniverseTest);
 
 
@@ -148,6 +285,48 @@ void UniverseTest::testLifecycle() {
 }
 
 
+/*
+ * Check the store handles large and sparse universe ids.
+ */
+void UniverseTest::testUniverseIds() {
+  const unsigned int ids[] = {70000, 65535, 0, 300, 65536};
+  const unsigned int id_count = sizeof(ids) / sizeof(ids[0]);
+  for (unsigned int i = 0; i < id_count; i++) {
+    Universe *universe = m_store->GetUniverseOrCreate(ids[i]);
+    CPPUNIT_ASSERT(universe);
+    CPPUNIT_ASSERT_EQUAL(ids[i], universe->UniverseId());
+    CPPUNIT_ASSERT_EQUAL(universe, m_store->GetUniverseOrCreate(ids[i]));
+  }
+  CPPUNIT_ASSERT_EQUAL(id_count, m_store->UniverseCount());
+  CPPUNIT_ASSERT(!m_store->GetUniverse(1));
+  CPPUNIT_ASSERT(!m_store->GetUniverse(65534));
+  CPPUNIT_ASSERT(!m_store->GetUniverse(100000));
+
+  // the list is ordered by id
+  vector<Universe*> universes;
+  m_store->GetList(&universes);
+  CPPUNIT_ASSERT_EQUAL((size_t) id_count, universes.size());
+  CPPUNIT_ASSERT_EQUAL(0u, universes[0]->UniverseId());
+  CPPUNIT_ASSERT_EQUAL(300u, universes[1]->UniverseId());
+  CPPUNIT_ASSERT_EQUAL(65535u, universes[2]->UniverseId());
+  CPPUNIT_ASSERT_EQUAL(65536u, universes[3]->UniverseId());
+  CPPUNIT_ASSERT_EQUAL(70000u, universes[4]->UniverseId());
+
+  // only the candidates are removed
+  m_store->AddUniverseGarbageCollection(m_store->GetUniverse(65535));
+  m_store->AddUniverseGarbageCollection(m_store->GetUniverse(70000));
+  m_store->GarbageCollectUniverses();
+  CPPUNIT_ASSERT_EQUAL(id_count - 2, m_store->UniverseCount());
+  CPPUNIT_ASSERT(!m_store->GetUniverse(65535));
+  CPPUNIT_ASSERT(!m_store->GetUniverse(70000));
+  CPPUNIT_ASSERT(m_store->GetUniverse(65536));
+
+  m_store->DeleteAll();
+  CPPUNIT_ASSERT_EQUAL(0u, m_store->UniverseCount());
+  CPPUNIT_ASSERT(!m_store->GetUniverse(0));
+}
+
+
 /*
  * Check that SetDMX/GetDMX works
  */
@@ -190,6 +369,58 @@ void UniverseTest::testSendDmx() {
 }
 
 
+/*
+ * Check that ports are told which channels changed, and that sink clients
+ * only get frames that changed.
+ */
+void UniverseTest::testChangeDetection() {
+  Universe *universe = m_store->GetUniverseOrCreate(TEST_UNIVERSE);
+  CPPUNIT_ASSERT(universe);
+
+  ChangeRecordingOutputPort port(NULL, 1);
+  universe->AddPort(&port);
+  MockClient client;
+  universe->AddSinkClient(&client);
+
+  // the first frame is all new
+  CPPUNIT_ASSERT(universe->SetDMX(m_buffer));
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 1, port.m_writes);
+  CPPUNIT_ASSERT(port.m_change.changed);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, port.m_change.start);
+  CPPUNIT_ASSERT_EQUAL(m_buffer.Size(), port.m_change.end);
+  CPPUNIT_ASSERT(client.m_dmx_set);
+
+  // the same frame again, the port is still called but the client isn't
+  client.m_dmx_set = false;
+  CPPUNIT_ASSERT(universe->SetDMX(m_buffer));
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 2, port.m_writes);
+  CPPUNIT_ASSERT(!port.m_change.changed);
+  CPPUNIT_ASSERT(!client.m_dmx_set);
+  universe->RemoveSinkClient(&client);
+
+  // change a couple of channels
+  DmxBuffer changed(m_buffer);
+  changed.SetChannel(3, 'X');
+  changed.SetChannel(6, 'Y');
+  CPPUNIT_ASSERT(universe->SetDMX(changed));
+  CPPUNIT_ASSERT(port.m_change.changed);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 3, port.m_change.start);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 7, port.m_change.end);
+  CPPUNIT_ASSERT(m_buffer.Size() == port.ReadDMX().Size());
+
+  // a new port means the next frame is sent in full
+  ChangeRecordingOutputPort port2(NULL, 2);
+  universe->AddPort(&port2);
+  CPPUNIT_ASSERT(universe->SetDMX(changed));
+  CPPUNIT_ASSERT(port2.m_change.changed);
+  CPPUNIT_ASSERT_EQUAL((unsigned int) 0, port2.m_change.start);
+  CPPUNIT_ASSERT_EQUAL(m_buffer.Size(), port2.m_change.end);
+
+  universe->RemovePort(&port);
+  universe->RemovePort(&port2);
+}
+
+
 /*
  * Check that we update when ports have new data
  */
@@ -483,3 +714,129 @@ void UniverseTest::testHtpMerging() {
   universe->RemovePort(&port2);
   CPPUNIT_ASSERT(!universe->IsActive());
 }
+
+
+/*
+ * Check that a lower priority source takes over as soon as the higher
+ * priority one times out, even if the lower priority source doesn't send
+ * another frame. This simulates a 40fps backup console which stops after a
+ * second, and a primary console which only sends a frame every second.
+ */
+void UniverseTest::testSourceExpiry() {
+  MockClock clock;
+  SingleTimeoutScheduler scheduler(&clock);
+  Universe universe(TEST_UNIVERSE, m_store, NULL, &clock);
+  universe.SetScheduler(&scheduler);
+
+  DmxBuffer backup_data, primary_data;
+  backup_data.SetFromString("1,2,3");
+  primary_data.SetFromString("4,5,6");
+  MockClient backup, primary;
+
+  const unsigned int backup_stops = 1000;  // in ms
+  const unsigned int end_time = 6000;
+  TimeStamp now, backup_expiry, failover_time;
+  unsigned int max_timers = 0;
+  for (unsigned int t = 0; t < end_time; t++) {
+    clock.CurrentTime(&now);
+    if (t < backup_stops && t % 25 == 0) {
+      ola::DmxSource source(backup_data, now, 150);
+      backup.DMXRecieved(TEST_UNIVERSE, source);
+      universe.SourceClientDataChanged(&backup);
+      backup_expiry = source.ExpiryTime();
+    }
+    if (t % 1000 == 500) {
+      primary.DMXRecieved(TEST_UNIVERSE,
+                          ola::DmxSource(primary_data, now, 100));
+      universe.SourceClientDataChanged(&primary);
+    }
+
+    scheduler.RunDueTimers();
+    max_timers = std::max(max_timers, scheduler.TimerCount());
+
+    if (t < backup_stops) {
+      CPPUNIT_ASSERT(backup_data == universe.GetDMX());
+      CPPUNIT_ASSERT_EQUAL((uint8_t) 150, universe.ActivePriority());
+    } else if (!failover_time.IsSet() && primary_data == universe.GetDMX()) {
+      failover_time = now;
+    }
+    clock.AdvanceTime(0, 1000);
+  }
+
+  // the primary took over within a ms of the E1.31 timeout, rather than on
+  // its next frame 500ms later
+  CPPUNIT_ASSERT(failover_time.IsSet());
+  TimeInterval latency = failover_time - backup_expiry;
+  CPPUNIT_ASSERT(latency.AsInt() >= 0);
+  CPPUNIT_ASSERT(latency.InMilliSeconds() <= 1);
+  CPPUNIT_ASSERT_EQUAL((uint8_t) 100, universe.ActivePriority());
+  CPPUNIT_ASSERT(primary_data == universe.GetDMX());
+
+  // one timer for the universe, which isn't re-armed on every frame
+  CPPUNIT_ASSERT_EQUAL(1u, max_timers);
+  CPPUNIT_ASSERT(scheduler.Registrations() < 10);
+
+  universe.RemoveSourceClient(&backup);
+  universe.RemoveSourceClient(&primary);
+}
+
+
+/*
+ * Check the slot priorities are only written to the ports when they change,
+ * or when they're due to be refreshed.
+ */
+void UniverseTest::testSlotPriorityWrites() {
+  MockClock clock;
+  Universe universe(TEST_UNIVERSE, m_store, NULL, &clock);
+  SlotPriorityOutputPort port(NULL, 1);
+  universe.AddPort(&port);
+
+  DmxBuffer data, priorities, new_priorities;
+  data.SetFromString("1,2,3");
+  priorities.SetFromString("100,0,100");
+  new_priorities.SetFromString("100,100,0");
+  MockClient client;
+
+  TimeStamp now;
+  clock.CurrentTime(&now);
+  ola::DmxSource source(data, now, ola::DmxSource::PRIORITY_DEFAULT);
+  source.SetSlotPriorities(priorities.GetRaw(), priorities.Size());
+  client.DMXRecieved(TEST_UNIVERSE, source);
+  universe.SourceClientDataChanged(&client);
+  CPPUNIT_ASSERT_EQUAL(1u, port.m_priority_writes);
+  CPPUNIT_ASSERT(priorities == port.m_slot_priorities);
+
+  // more frames with the same priorities
+  for (unsigned int i = 0; i < 10; i++) {
+    clock.AdvanceTime(0, 25000);
+    clock.CurrentTime(&now);
+    data.SetChannel(0, i);
+    source.UpdateData(data, now, ola::DmxSource::PRIORITY_DEFAULT);
+    source.SetSlotPriorities(priorities.GetRaw(), priorities.Size());
+    client.DMXRecieved(TEST_UNIVERSE, source);
+    universe.SourceClientDataChanged(&client);
+  }
+  CPPUNIT_ASSERT_EQUAL(1u, port.m_priority_writes);
+
+  // the priorities change
+  clock.AdvanceTime(0, 25000);
+  clock.CurrentTime(&now);
+  source.UpdateData(data, now, ola::DmxSource::PRIORITY_DEFAULT);
+  source.SetSlotPriorities(new_priorities.GetRaw(), new_priorities.Size());
+  client.DMXRecieved(TEST_UNIVERSE, source);
+  universe.SourceClientDataChanged(&client);
+  CPPUNIT_ASSERT_EQUAL(2u, port.m_priority_writes);
+  CPPUNIT_ASSERT(new_priorities == port.m_slot_priorities);
+
+  // and are resent once the refresh is due
+  clock.AdvanceTime(1, 0);
+  clock.CurrentTime(&now);
+  source.UpdateData(data, now, ola::DmxSource::PRIORITY_DEFAULT);
+  source.SetSlotPriorities(new_priorities.GetRaw(), new_priorities.Size());
+  client.DMXRecieved(TEST_UNIVERSE, source);
+  universe.SourceClientDataChanged(&client);
+  CPPUNIT_ASSERT_EQUAL(3u, port.m_priority_writes);
+
+  universe.RemoveSourceClient(&client);
+  universe.RemovePort(&port);
+}
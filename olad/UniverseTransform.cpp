@@ -0,0 +1,388 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * UniverseTransform.cpp
+ * Remaps, inverts, scales & clips the merged data for a universe before it's
+ * sent to the outputs.
+ * Copyright (C) 2012 Simon Newton
+ *
+ * The AVX2 kernel gathers 8 channels at a time, first the input values and
+ * then the lookup table entries. It's built with a target attribute and only
+ * used if the CPU supports it, which is checked at runtime. How fast gathers
+ * are varies a lot between CPUs, so the kernels are timed once and the
+ * fastest is used.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "ola/Clock.h"
+#include "ola/Logging.h"
+#include "ola/StringUtils.h"
+#include "olad/UniverseTransform.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || \
+     (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#include <immintrin.h>
+#define OLA_TRANSFORM_AVX2 1
+#endif
+
+namespace ola {
+
+using std::string;
+using std::vector;
+
+static const unsigned int CURVE_SIZE = 256;
+
+
+static void TransformScalar(uint8_t *output,
+                            const uint8_t *input,
+                            const uint16_t *source_channels,
+                            const uint16_t *curve_index,
+                            const uint8_t *curves,
+                            unsigned int length) {
+  for (unsigned int i = 0; i < length; i++)
+    output[i] = curves[curve_index[i] * CURVE_SIZE + input[source_channels[i]]];
+}
+
+
+#ifdef OLA_TRANSFORM_AVX2
+__attribute__((target("avx2")))
+static void TransformAVX2(uint8_t *output,
+                          const uint8_t *input,
+                          const uint16_t *source_channels,
+                          const uint16_t *curve_index,
+                          const uint8_t *curves,
+                          unsigned int length) {
+  static const unsigned int WIDTH = sizeof(__m256i) / sizeof(int32_t);
+  const __m256i byte_mask = _mm256_set1_epi32(0xff);
+  // move the low byte of each 32 bit lane to the bottom of each 128 bit half
+  const __m256i pack = _mm256_setr_epi8(
+      0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const int *input_words = reinterpret_cast<const int*>(input);
+  const int *curve_words = reinterpret_cast<const int*>(curves);
+
+  unsigned int i = 0;
+  for (; i + WIDTH <= length; i += WIDTH) {
+    __m256i sources = _mm256_cvtepu16_epi32(_mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(source_channels + i)));
+    __m256i values = _mm256_and_si256(
+        _mm256_i32gather_epi32(input_words, sources, 1), byte_mask);
+    __m256i curve = _mm256_cvtepu16_epi32(_mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(curve_index + i)));
+    __m256i lookup = _mm256_or_si256(_mm256_slli_epi32(curve, 8), values);
+    __m256i result = _mm256_shuffle_epi8(
+        _mm256_i32gather_epi32(curve_words, lookup, 1), pack);
+
+    int32_t low = _mm_cvtsi128_si32(_mm256_castsi256_si128(result));
+    int32_t high = _mm_cvtsi128_si32(_mm256_extracti128_si256(result, 1));
+    memcpy(output + i, &low, sizeof(low));
+    memcpy(output + i + sizeof(low), &high, sizeof(high));
+  }
+  TransformScalar(output + i, input, source_channels + i, curve_index + i,
+                  curves, length - i);
+}
+#endif
+
+
+void AvailableTransformKernels(vector<TransformKernel> *kernels) {
+  kernels->clear();
+  TransformKernel kernel = {"scalar", TransformScalar};
+  kernels->push_back(kernel);
+
+#ifdef OLA_TRANSFORM_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    kernel.name = "avx2";
+    kernel.function = TransformAVX2;
+    kernels->push_back(kernel);
+  }
+#endif
+}
+
+
+static TransformFunction FastestTransformKernel() {
+  static const unsigned int CALIBRATION_RUNS = 100;
+  vector<TransformKernel> kernels;
+  AvailableTransformKernels(&kernels);
+  if (kernels.size() == 1)
+    return kernels[0].function;
+
+  uint8_t input[DMX_UNIVERSE_SIZE + UniverseTransform::GATHER_PADDING];
+  uint16_t source_channels[DMX_UNIVERSE_SIZE];
+  uint16_t curve_index[DMX_UNIVERSE_SIZE];
+  vector<uint8_t> curves(CURVE_SIZE * CURVE_SIZE +
+                         UniverseTransform::GATHER_PADDING);
+  for (unsigned int i = 0; i < DMX_UNIVERSE_SIZE; i++) {
+    input[i] = i;
+    source_channels[i] = (i * 7) % DMX_UNIVERSE_SIZE;
+    curve_index[i] = i % CURVE_SIZE;
+  }
+  for (unsigned int i = 0; i < curves.size(); i++)
+    curves[i] = i * 13;
+
+  Clock clock;
+  TransformFunction fastest = kernels[0].function;
+  TimeInterval fastest_time;
+  vector<TransformKernel>::const_iterator iter = kernels.begin();
+  for (; iter != kernels.end(); ++iter) {
+    uint8_t output[DMX_UNIVERSE_SIZE];
+    TimeStamp start, end;
+    clock.CurrentTime(&start);
+    for (unsigned int i = 0; i < CALIBRATION_RUNS; i++) {
+      iter->function(output, input, source_channels, curve_index, &curves[0],
+                     DMX_UNIVERSE_SIZE);
+    }
+    clock.CurrentTime(&end);
+    if (iter == kernels.begin() || end - start < fastest_time) {
+      fastest = iter->function;
+      fastest_time = end - start;
+    }
+  }
+  return fastest;
+}
+
+
+/*
+ * Create a new transform, this passes the data through unchanged until rules
+ * are added.
+ */
+UniverseTransform::UniverseTransform()
+    : m_min_length(0) {
+  static const TransformFunction kernel = FastestTransformKernel();
+  m_kernel = kernel;
+  Compile();
+}
+
+
+/*
+ * Add a rule to the transform.
+ * @param rule the rule, see UniverseTransform.h for the format
+ * @returns true if the rule was valid, false otherwise
+ */
+bool UniverseTransform::AddRule(const string &rule) {
+  vector<string> tokens;
+  string trimmed_rule = rule;
+  StringTrim(&trimmed_rule);
+  StringSplit(trimmed_rule, tokens, " \t");
+  tokens.erase(std::remove(tokens.begin(), tokens.end(), ""), tokens.end());
+
+  transform_rule parsed_rule;
+  if (tokens.size() < 2 ||
+      !ParseChannels(tokens[1], &parsed_rule.first, &parsed_rule.last)) {
+    OLA_WARN << "Invalid transform rule: " << rule;
+    return false;
+  }
+
+  const string &type = tokens[0];
+  bool valid = false;
+  if (type == "map" && tokens.size() == 3) {
+    parsed_rule.type = MAP_RULE;
+    unsigned int source = 0;
+    unsigned int count = parsed_rule.last - parsed_rule.first + 1;
+    // check each term on its own, a large source channel would wrap
+    valid = StringToInt(tokens[2], &source) && source &&
+      source - 1 < DMX_UNIVERSE_SIZE &&
+      count <= DMX_UNIVERSE_SIZE - (source - 1);
+    parsed_rule.argument = source - 1;
+  } else if (type == "invert" && tokens.size() == 2) {
+    parsed_rule.type = INVERT_RULE;
+    parsed_rule.argument = 0;
+    valid = true;
+  } else if (type == "scale" && tokens.size() == 3) {
+    parsed_rule.type = SCALE_RULE;
+    valid = ParsePercent(tokens[2], &parsed_rule.argument) &&
+      parsed_rule.argument <= MAX_SCALE_PERCENT;
+  } else if (type == "clip" && tokens.size() == 3) {
+    parsed_rule.type = CLIP_RULE;
+    valid = ParsePercent(tokens[2], &parsed_rule.argument) &&
+      parsed_rule.argument <= 100;
+  }
+
+  if (!valid) {
+    OLA_WARN << "Invalid transform rule: " << rule;
+    return false;
+  }
+
+  m_rules.push_back(rule);
+  m_parsed_rules.push_back(parsed_rule);
+  Compile();
+  return true;
+}
+
+
+/*
+ * Apply the transform.
+ * @param input the merged data for the universe
+ * @param output the buffer to write the transformed data to
+ */
+void UniverseTransform::Apply(const DmxBuffer &input,
+                              DmxBuffer *output) const {
+  uint8_t input_data[DMX_UNIVERSE_SIZE + GATHER_PADDING];
+  unsigned int input_length = input.Size();
+  memcpy(input_data, input.GetRaw(), input_length);
+  // mapped channels past the end of the input are 0
+  memset(input_data + input_length, 0,
+         sizeof(input_data) - input_length);
+
+  uint8_t output_data[DMX_UNIVERSE_SIZE];
+  unsigned int length = std::max(input_length, m_min_length);
+  vector<transform_segment>::const_iterator iter = m_segments.begin();
+  for (; iter != m_segments.end() && iter->start < length; ++iter) {
+    unsigned int count = std::min(iter->length, length - iter->start);
+    if (iter->copy) {
+      memcpy(output_data + iter->start,
+             input_data + m_source_channels[iter->start], count);
+    } else {
+      m_kernel(output_data + iter->start, input_data,
+               m_source_channels + iter->start,
+               m_curve_index + iter->start, &m_curves[0], count);
+    }
+  }
+  output->Set(output_data, length);
+}
+
+
+/*
+ * Run the rules over every channel, then build the tables the kernels use.
+ * Channels which end up with the same curve share a table. Finally split the
+ * channels into runs that can be copied and runs that need a lookup.
+ */
+void UniverseTransform::Compile() {
+  uint16_t sources[DMX_UNIVERSE_SIZE];
+  vector<uint8_t> curves(DMX_UNIVERSE_SIZE * CURVE_SIZE);
+  for (unsigned int i = 0; i < DMX_UNIVERSE_SIZE; i++) {
+    sources[i] = i;
+    for (unsigned int value = 0; value < CURVE_SIZE; value++)
+      curves[i * CURVE_SIZE + value] = value;
+  }
+
+  m_min_length = 0;
+  vector<transform_rule>::const_iterator iter = m_parsed_rules.begin();
+  for (; iter != m_parsed_rules.end(); ++iter) {
+    unsigned int count = iter->last - iter->first + 1;
+    uint8_t *curve = &curves[iter->first * CURVE_SIZE];
+    unsigned int limit = (255 * iter->argument + 50) / 100;
+
+    switch (iter->type) {
+      case MAP_RULE:
+        {
+          // copy first, the source & destination may overlap
+          const vector<uint16_t> source_copy(sources + iter->argument,
+                                             sources + iter->argument + count);
+          const vector<uint8_t> curve_copy(
+              curves.begin() + iter->argument * CURVE_SIZE,
+              curves.begin() + (iter->argument + count) * CURVE_SIZE);
+          std::copy(source_copy.begin(), source_copy.end(),
+                    sources + iter->first);
+          std::copy(curve_copy.begin(), curve_copy.end(), curve);
+          m_min_length = std::max(m_min_length, iter->last + 1);
+        }
+        break;
+      case INVERT_RULE:
+        for (unsigned int i = 0; i < count * CURVE_SIZE; i++)
+          curve[i] = 255 - curve[i];
+        break;
+      case SCALE_RULE:
+        for (unsigned int i = 0; i < count * CURVE_SIZE; i++)
+          curve[i] = std::min(255u, (curve[i] * iter->argument + 50) / 100);
+        break;
+      case CLIP_RULE:
+        for (unsigned int i = 0; i < count * CURVE_SIZE; i++)
+          curve[i] = std::min(limit, static_cast<unsigned int>(curve[i]));
+        break;
+    }
+  }
+
+  // the identity curve comes first
+  m_curves.resize(CURVE_SIZE);
+  for (unsigned int i = 0; i < CURVE_SIZE; i++)
+    m_curves[i] = i;
+  std::map<string, uint16_t> curve_indices;
+  curve_indices[string(m_curves.begin(), m_curves.end())] = 0;
+
+  for (unsigned int i = 0; i < DMX_UNIVERSE_SIZE; i++) {
+    const uint8_t *curve = &curves[i * CURVE_SIZE];
+    const string key(curve, curve + CURVE_SIZE);
+    std::map<string, uint16_t>::const_iterator curve_iter =
+      curve_indices.find(key);
+    if (curve_iter == curve_indices.end()) {
+      uint16_t index = curve_indices.size();
+      curve_iter = curve_indices.insert(std::make_pair(key, index)).first;
+      m_curves.resize(m_curves.size() + CURVE_SIZE);
+      memcpy(&m_curves[index * CURVE_SIZE], curve, CURVE_SIZE);
+    }
+    m_source_channels[i] = sources[i];
+    m_curve_index[i] = curve_iter->second;
+  }
+  m_curves.resize(m_curves.size() + GATHER_PADDING, 0);
+
+  m_segments.clear();
+  for (unsigned int i = 0; i < DMX_UNIVERSE_SIZE; i++) {
+    bool copy = m_curve_index[i] == 0;
+    if (!m_segments.empty()) {
+      transform_segment &last = m_segments.back();
+      if (last.copy == copy &&
+          (!copy || m_source_channels[i] == m_source_channels[i - 1] + 1)) {
+        last.length++;
+        continue;
+      }
+    }
+    transform_segment segment = {i, 1, copy};
+    m_segments.push_back(segment);
+  }
+}
+
+
+/*
+ * Parse a channel or a range of channels, e.g. 5 or 1-10
+ * @param input the string to parse
+ * @param first set to the first channel, zero based
+ * @param last set to the last channel, zero based
+ */
+bool UniverseTransform::ParseChannels(const string &input,
+                                      unsigned int *first,
+                                      unsigned int *last) {
+  vector<string> tokens;
+  StringSplit(input, tokens, "-");
+  if (tokens.size() > 2 || !StringToInt(tokens[0], first) ||
+      (tokens.size() == 2 && !StringToInt(tokens[1], last)))
+    return false;
+  if (tokens.size() == 1)
+    *last = *first;
+
+  if (!*first || *first > *last || *last > DMX_UNIVERSE_SIZE)
+    return false;
+  (*first)--;
+  (*last)--;
+  return true;
+}
+
+
+/*
+ * Parse a percentage, the % is optional.
+ */
+bool UniverseTransform::ParsePercent(const string &input,
+                                     unsigned int *percent) {
+  string value = input;
+  if (!value.empty() && value[value.size() - 1] == '%')
+    value.erase(value.size() - 1);
+  return StringToInt(value, percent);
+}
+}  // ola
@@ -0,0 +1,124 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * UniverseTransform.h
+ * Remaps, inverts, scales & clips the merged data for a universe before it's
+ * sent to the outputs.
+ * Copyright (C) 2012 Simon Newton
+ *
+ * Rules are given one per line, channels start from 1 and can be a single
+ * channel or a range:
+ *   map 1-10 101     output channels 1-10 come from input channels 101-110
+ *   invert 1-10      255 becomes 0, 0 becomes 255
+ *   scale 1-10 40%   scale the values to 40%, at most 25500%
+ *   clip 1-10 80%    limit the values to 80%
+ *
+ * Rules are applied in order. They're compiled into a source channel and a
+ * 256 entry lookup table for each output channel, so applying the transform
+ * costs the same however many rules there are. Runs of channels that are only
+ * moved are copied rather than looked up.
+ */
+
+#ifndef OLAD_UNIVERSETRANSFORM_H_
+#define OLAD_UNIVERSETRANSFORM_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "ola/BaseTypes.h"
+#include "ola/DmxBuffer.h"
+
+namespace ola {
+
+/*
+ * A transform kernel writes length channels to output, where
+ *   output[i] = curves[curve_index[i] * 256 + input[source_channels[i]]]
+ * Kernels may read up to 3 bytes past the end of input & curves.
+ */
+typedef void (*TransformFunction)(uint8_t *output,
+                                  const uint8_t *input,
+                                  const uint16_t *source_channels,
+                                  const uint16_t *curve_index,
+                                  const uint8_t *curves,
+                                  unsigned int length);
+
+typedef struct {
+  const char *name;
+  TransformFunction function;
+} TransformKernel;
+
+// The kernels this CPU can run, from slowest to fastest.
+void AvailableTransformKernels(std::vector<TransformKernel> *kernels);
+
+
+class UniverseTransform {
+  public:
+    UniverseTransform();
+
+    bool AddRule(const std::string &rule);
+    const std::vector<std::string> &Rules() const { return m_rules; }
+
+    void Apply(const DmxBuffer &input, DmxBuffer *output) const;
+
+    // The kernels may read a whole word when they look up the last byte
+    static const unsigned int GATHER_PADDING = 3;
+
+  private:
+    typedef enum {
+      MAP_RULE,
+      INVERT_RULE,
+      SCALE_RULE,
+      CLIP_RULE,
+    } rule_type;
+
+    typedef struct {
+      rule_type type;
+      unsigned int first;  // zero based, inclusive
+      unsigned int last;
+      unsigned int argument;  // the source channel or the percentage
+    } transform_rule;
+
+    std::vector<std::string> m_rules;
+    std::vector<transform_rule> m_parsed_rules;
+
+    typedef struct {
+      unsigned int start;
+      unsigned int length;
+      bool copy;  // true if the channels are copied without a lookup
+    } transform_segment;
+
+    // the output length is at least this, so mapped channels are always sent
+    unsigned int m_min_length;
+    uint16_t m_source_channels[DMX_UNIVERSE_SIZE];
+    uint16_t m_curve_index[DMX_UNIVERSE_SIZE];
+    // 256 bytes per distinct curve, followed by the padding. The first curve
+    // is always the identity.
+    std::vector<uint8_t> m_curves;
+    std::vector<transform_segment> m_segments;
+    TransformFunction m_kernel;
+
+    // any more and every value other than 0 becomes 255 anyway
+    static const unsigned int MAX_SCALE_PERCENT = 25500;
+
+    void Compile();
+    static bool ParseChannels(const std::string &input, unsigned int *first,
+                              unsigned int *last);
+    static bool ParsePercent(const std::string &input, unsigned int *percent);
+
+    UniverseTransform(const UniverseTransform&);
+    UniverseTransform& operator=(const UniverseTransform&);
+};
+}  // ola
+#endif  // OLAD_UNIVERSETRANSFORM_H_
@@ -0,0 +1,234 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * UniverseTransformTest.cpp
+ * Test fixture for the UniverseTransform class
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "ola/BaseTypes.h"
+#include "ola/DmxBuffer.h"
+#include "olad/Preferences.h"
+#include "olad/Universe.h"
+#include "olad/UniverseStore.h"
+#include "olad/UniverseTransform.h"
+
+using ola::DmxBuffer;
+using ola::TransformKernel;
+using ola::Universe;
+using ola::UniverseTransform;
+using std::vector;
+
+
+class UniverseTransformTest: public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(UniverseTransformTest);
+  CPPUNIT_TEST(testRules);
+  CPPUNIT_TEST(testCurves);
+  CPPUNIT_TEST(testMap);
+  CPPUNIT_TEST(testKernels);
+  CPPUNIT_TEST(testUniverse);
+  CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void testRules();
+    void testCurves();
+    void testMap();
+    void testKernels();
+    void testUniverse();
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(UniverseTransformTest);
+
+
+/*
+ * Check the rules are parsed correctly.
+ */
+void UniverseTransformTest::testRules() {
+  UniverseTransform transform;
+  CPPUNIT_ASSERT(transform.AddRule("invert 1"));
+  CPPUNIT_ASSERT(transform.AddRule("  invert   1-512 "));
+  CPPUNIT_ASSERT(transform.AddRule("scale 1-10 40%"));
+  CPPUNIT_ASSERT(transform.AddRule("scale 1-10 150"));
+  CPPUNIT_ASSERT(transform.AddRule("clip 5 80%"));
+  CPPUNIT_ASSERT(transform.AddRule("map 1-10 503"));
+  CPPUNIT_ASSERT(transform.AddRule("scale 1 25500%"));
+  CPPUNIT_ASSERT_EQUAL((size_t) 7, transform.Rules().size());
+
+  CPPUNIT_ASSERT(!transform.AddRule(""));
+  CPPUNIT_ASSERT(!transform.AddRule("invert"));
+  CPPUNIT_ASSERT(!transform.AddRule("invert 0"));
+  CPPUNIT_ASSERT(!transform.AddRule("invert 513"));
+  CPPUNIT_ASSERT(!transform.AddRule("invert 10-5"));
+  CPPUNIT_ASSERT(!transform.AddRule("invert 1-2-3"));
+  CPPUNIT_ASSERT(!transform.AddRule("invert 1 2"));
+  CPPUNIT_ASSERT(!transform.AddRule("scale 1"));
+  CPPUNIT_ASSERT(!transform.AddRule("scale 1 foo"));
+  CPPUNIT_ASSERT(!transform.AddRule("scale 1 25501%"));
+  CPPUNIT_ASSERT(!transform.AddRule("scale 1 4294967295"));
+  CPPUNIT_ASSERT(!transform.AddRule("clip 1 101%"));
+  CPPUNIT_ASSERT(!transform.AddRule("map 1-10"));
+  CPPUNIT_ASSERT(!transform.AddRule("map 1-10 0"));
+  CPPUNIT_ASSERT(!transform.AddRule("map 1-10 504"));
+  CPPUNIT_ASSERT(!transform.AddRule("map 1 513"));
+  // source channels that would wrap around
+  CPPUNIT_ASSERT(!transform.AddRule("map 1-10 4294967290"));
+  CPPUNIT_ASSERT(!transform.AddRule("map 1 4294967295"));
+  CPPUNIT_ASSERT(!transform.AddRule("split 1-10"));
+  CPPUNIT_ASSERT_EQUAL((size_t) 7, transform.Rules().size());
+}
+
+
+/*
+ * Check invert, scale & clip and that they're applied in order.
+ */
+void UniverseTransformTest::testCurves() {
+  DmxBuffer input, output;
+  input.SetFromString("0,100,200,255,100,200");
+
+  // no rules passes the data through
+  UniverseTransform transform;
+  transform.Apply(input, &output);
+  CPPUNIT_ASSERT(input == output);
+
+  CPPUNIT_ASSERT(transform.AddRule("invert 1-2"));
+  CPPUNIT_ASSERT(transform.AddRule("scale 3-4 40%"));
+  CPPUNIT_ASSERT(transform.AddRule("clip 5-6 50%"));
+  transform.Apply(input, &output);
+  DmxBuffer expected;
+  expected.SetFromString("255,155,80,102,100,128");
+  CPPUNIT_ASSERT(expected == output);
+
+  // rules are applied in order
+  CPPUNIT_ASSERT(transform.AddRule("invert 5-6"));
+  CPPUNIT_ASSERT(transform.AddRule("scale 1 200%"));
+  transform.Apply(input, &output);
+  expected.SetFromString("255,155,80,102,155,127");
+  CPPUNIT_ASSERT(expected == output);
+}
+
+
+/*
+ * Check channels can be moved around.
+ */
+void UniverseTransformTest::testMap() {
+  DmxBuffer input, output, expected;
+  input.SetFromString("1,2,3,4,5,6");
+
+  UniverseTransform transform;
+  CPPUNIT_ASSERT(transform.AddRule("invert 1"));
+  // the curve moves with the channel
+  CPPUNIT_ASSERT(transform.AddRule("map 4-6 1"));
+  transform.Apply(input, &output);
+  expected.SetFromString("254,2,3,254,2,3");
+  CPPUNIT_ASSERT(expected == output);
+
+  // overlapping ranges use the channels from before the rule
+  CPPUNIT_ASSERT(transform.AddRule("map 2-6 1"));
+  transform.Apply(input, &output);
+  expected.SetFromString("254,254,2,3,254,2");
+  CPPUNIT_ASSERT(expected == output);
+
+  // mapping past the end of the input extends the output
+  UniverseTransform extend;
+  CPPUNIT_ASSERT(extend.AddRule("map 10-11 2"));
+  extend.Apply(input, &output);
+  expected.SetFromString("1,2,3,4,5,6,0,0,0,2,3");
+  CPPUNIT_ASSERT(expected == output);
+
+  // and channels past the end of the input are 0
+  CPPUNIT_ASSERT(extend.AddRule("map 1 100"));
+  extend.Apply(input, &output);
+  expected.SetFromString("0,2,3,4,5,6,0,0,0,2,3");
+  CPPUNIT_ASSERT(expected == output);
+}
+
+
+/*
+ * Check all the kernels agree.
+ */
+void UniverseTransformTest::testKernels() {
+  srandom(31);
+  const unsigned int curve_count = 40;
+  vector<uint8_t> curves(curve_count * 256 + UniverseTransform::GATHER_PADDING);
+  for (unsigned int i = 0; i < curves.size(); i++)
+    curves[i] = random();
+
+  uint8_t input[DMX_UNIVERSE_SIZE + UniverseTransform::GATHER_PADDING];
+  uint16_t sources[DMX_UNIVERSE_SIZE];
+  uint16_t curve_index[DMX_UNIVERSE_SIZE];
+  for (unsigned int i = 0; i < DMX_UNIVERSE_SIZE; i++) {
+    input[i] = random();
+    sources[i] = random() % DMX_UNIVERSE_SIZE;
+    curve_index[i] = random() % curve_count;
+  }
+  // the last channel & curve entry are the ones that need the padding
+  sources[DMX_UNIVERSE_SIZE - 1] = DMX_UNIVERSE_SIZE - 1;
+  curve_index[DMX_UNIVERSE_SIZE - 1] = curve_count - 1;
+
+  vector<TransformKernel> kernels;
+  ola::AvailableTransformKernels(&kernels);
+  const unsigned int lengths[] = {0, 1, 7, 8, 9, 100, 511, 512};
+  for (unsigned int i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+    uint8_t expected[DMX_UNIVERSE_SIZE];
+    kernels[0].function(expected, input, sources, curve_index, &curves[0],
+                        lengths[i]);
+    for (unsigned int j = 0; j < lengths[i]; j++) {
+      CPPUNIT_ASSERT_EQUAL(curves[curve_index[j] * 256 + input[sources[j]]],
+                           expected[j]);
+    }
+
+    vector<TransformKernel>::const_iterator iter = kernels.begin();
+    for (; iter != kernels.end(); ++iter) {
+      uint8_t output[DMX_UNIVERSE_SIZE];
+      iter->function(output, input, sources, curve_index, &curves[0],
+                     lengths[i]);
+      CPPUNIT_ASSERT_EQUAL(0, memcmp(expected, output, lengths[i]));
+    }
+  }
+}
+
+
+/*
+ * Check the transform is loaded from the preferences and applied to the
+ * universe.
+ */
+void UniverseTransformTest::testUniverse() {
+  ola::MemoryPreferences preferences("foo");
+  preferences.SetMultipleValue("uni_1_transform", "map 3 1");
+  preferences.SetMultipleValue("uni_1_transform", "invert 1");
+  preferences.SetMultipleValue("uni_1_transform", "bogus");
+
+  ola::UniverseStore store(&preferences, NULL);
+  Universe *universe = store.GetUniverseOrCreate(1);
+  CPPUNIT_ASSERT(universe->Transform());
+  CPPUNIT_ASSERT_EQUAL((size_t) 2, universe->Transform()->Rules().size());
+  CPPUNIT_ASSERT(!store.GetUniverseOrCreate(2)->Transform());
+
+  DmxBuffer input, expected;
+  input.SetFromString("10,20,30");
+  universe->SetDMX(input);
+  expected.SetFromString("245,20,10");
+  CPPUNIT_ASSERT(expected == universe->GetDMX());
+
+  // removing the transform restores the merged data
+  universe->SetTransform(NULL);
+  CPPUNIT_ASSERT(input == universe->GetDMX());
+}
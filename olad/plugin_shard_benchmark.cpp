@@ -0,0 +1,347 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * plugin_shard_benchmark.cpp
+ * Measures how output throughput scales as the output ports are spread
+ * across more PluginShards. Each port does the work a network plugin does
+ * for every frame: it packs the DMX data into a packet and checksums it.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ola/BaseTypes.h"
+#include "ola/Callback.h"
+#include "ola/Clock.h"
+#include "ola/DmxBuffer.h"
+#include "ola/Logging.h"
+#include "ola/StringUtils.h"
+#include "ola/network/SelectServer.h"
+#include "ola/thread/Mutex.h"
+#include "olad/Device.h"
+#include "olad/Plugin.h"
+#include "olad/PluginAdaptor.h"
+#include "olad/PluginShard.h"
+#include "olad/Port.h"
+#include "olad/Preferences.h"
+#include "olad/Universe.h"
+#include "olad/UniverseStore.h"
+
+using ola::BasicOutputPort;
+using ola::Clock;
+using ola::DmxBuffer;
+using ola::PluginAdaptor;
+using ola::PluginShard;
+using ola::TimeInterval;
+using ola::TimeStamp;
+using ola::Universe;
+using ola::network::SelectServer;
+using ola::thread::MutexLocker;
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+
+class BenchmarkPlugin: public ola::Plugin {
+  public:
+    explicit BenchmarkPlugin(PluginAdaptor *plugin_adaptor)
+        : Plugin(plugin_adaptor) {
+    }
+
+    string Name() const { return "Benchmark"; }
+    string Description() const { return "Benchmark Plugin"; }
+    ola::ola_plugin_id Id() const { return ola::OLA_PLUGIN_DUMMY; }
+    string PluginPrefix() const { return "benchmark"; }
+    bool SupportsShards() const { return true; }
+};
+
+
+class BenchmarkDevice: public ola::Device {
+  public:
+    explicit BenchmarkDevice(ola::AbstractPlugin *owner)
+        : Device(owner, "Benchmark Device") {
+    }
+    string DeviceId() const { return "1"; }
+};
+
+
+/*
+ * An output port that builds a packet for each frame.
+ */
+class EncodingOutputPort: public BasicOutputPort {
+  public:
+    EncodingOutputPort(ola::AbstractDevice *parent,
+                       unsigned int port_id,
+                       unsigned int passes)
+        : BasicOutputPort(parent, port_id),
+          m_passes(passes),
+          m_frames(0),
+          m_checksum(0) {
+      memset(m_packet, 0, sizeof(m_packet));
+    }
+
+    string Description() const { return ""; }
+
+    bool WriteDMX(const DmxBuffer &buffer, uint8_t priority) {
+      m_packet[HEADER_SIZE - 1] = priority;
+      unsigned int length = sizeof(m_packet) - HEADER_SIZE;
+      buffer.Get(m_packet + HEADER_SIZE, &length);
+
+      // a Fletcher-16 checksum, run several times to model the cost of
+      // building the headers & the send() call.
+      uint16_t sum1 = 0, sum2 = 0;
+      for (unsigned int pass = 0; pass < m_passes; pass++) {
+        for (unsigned int i = 0; i < HEADER_SIZE + length; i++) {
+          sum1 = (sum1 + m_packet[i]) % 255;
+          sum2 = (sum2 + sum1) % 255;
+        }
+        m_packet[0] = sum2;
+      }
+      m_checksum += (sum2 << 8) | sum1;
+      m_frames++;
+      return true;
+    }
+
+    unsigned int Frames() const { return m_frames; }
+
+  private:
+    static const unsigned int HEADER_SIZE = 126;
+
+    const unsigned int m_passes;
+    unsigned int m_frames;
+    uint64_t m_checksum;
+    uint8_t m_packet[HEADER_SIZE + DMX_UNIVERSE_SIZE];
+};
+
+
+/*
+ * Counts the frames the shards have finished with, this stops the main
+ * thread from getting too far ahead.
+ */
+class FrameTracker {
+  public:
+    FrameTracker() : m_done(0) {}
+
+    void FrameDone() {
+      MutexLocker locker(&m_mutex);
+      m_done++;
+      m_condition.Signal();
+    }
+
+    void WaitFor(unsigned int count) {
+      MutexLocker locker(&m_mutex);
+      while (m_done < count)
+        m_condition.Wait(&m_mutex);
+    }
+
+  private:
+    unsigned int m_done;
+    ola::thread::Mutex m_mutex;
+    ola::thread::ConditionVariable m_condition;
+};
+
+
+typedef struct {
+  unsigned int universes;
+  unsigned int frames;
+  unsigned int passes;
+  unsigned int max_threads;
+} options;
+
+
+/*
+ * Send frames to every universe with the ports spread across a number of
+ * shards. 0 shards means the ports run in the main thread, which is how olad
+ * runs without --plugin-threads.
+ * @returns the number of frames per second.
+ */
+double RunBenchmark(unsigned int shard_count, const options &opts) {
+  SelectServer ss;
+  ola::MemoryPreferences preferences("benchmark");
+  ola::UniverseStore store(&preferences, NULL);
+  PluginAdaptor main_adaptor(NULL, &ss, NULL, NULL);
+
+  vector<PluginShard*> shards;
+  vector<BenchmarkPlugin*> plugins;
+  vector<BenchmarkDevice*> devices;
+  if (shard_count) {
+    for (unsigned int i = 0; i < shard_count; i++) {
+      PluginShard *shard = new PluginShard(NULL, NULL, NULL, &ss,
+                                           SelectServer::SELECT_POLLER);
+      shards.push_back(shard);
+      plugins.push_back(new BenchmarkPlugin(shard->GetPluginAdaptor()));
+    }
+  } else {
+    plugins.push_back(new BenchmarkPlugin(&main_adaptor));
+  }
+  for (unsigned int i = 0; i < plugins.size(); i++)
+    devices.push_back(new BenchmarkDevice(plugins[i]));
+
+  vector<Universe*> universes;
+  vector<EncodingOutputPort*> ports;
+  for (unsigned int i = 0; i < opts.universes; i++) {
+    Universe *universe = store.GetUniverseOrCreate(i + 1);
+    EncodingOutputPort *port = new EncodingOutputPort(
+        devices[i % devices.size()], i, opts.passes);
+    universe->AddPort(port);
+    port->SetUniverse(universe);
+    universes.push_back(universe);
+    ports.push_back(port);
+  }
+
+  for (unsigned int i = 0; i < shards.size(); i++)
+    shards[i]->Start();
+
+  FrameTracker tracker;
+  uint8_t data[DMX_UNIVERSE_SIZE];
+  memset(data, 0, sizeof(data));
+  DmxBuffer buffer;
+
+  Clock clock;
+  TimeStamp start, end;
+  clock.CurrentTime(&start);
+
+  for (unsigned int frame = 0; frame < opts.frames; frame++) {
+    data[0] = frame;
+    buffer.Set(data, sizeof(data));
+    vector<Universe*>::iterator iter = universes.begin();
+    for (; iter != universes.end(); ++iter)
+      (*iter)->SetDMX(buffer);
+
+    if (!shards.empty()) {
+      // allow up to two frames to be queued in each shard
+      for (unsigned int i = 0; i < shards.size(); i++)
+        shards[i]->GetPluginAdaptor()->Execute(
+            ola::NewSingleCallback(&tracker, &FrameTracker::FrameDone));
+      if (frame)
+        tracker.WaitFor((frame - 1) * shards.size());
+    }
+  }
+
+  // this blocks until the queued frames have been written
+  for (unsigned int i = 0; i < shards.size(); i++)
+    shards[i]->Stop();
+  clock.CurrentTime(&end);
+
+  unsigned int frames = 0;
+  for (unsigned int i = 0; i < ports.size(); i++) {
+    frames += ports[i]->Frames();
+    universes[i]->RemovePort(ports[i]);
+    delete ports[i];
+  }
+
+  for (unsigned int i = 0; i < devices.size(); i++) {
+    delete devices[i];
+    delete plugins[i];
+  }
+  for (unsigned int i = 0; i < shards.size(); i++)
+    delete shards[i];
+
+  TimeInterval duration = end - start;
+  double fps = frames * 1000000.0 / duration.AsInt();
+  cout << shard_count << " plugin threads: " << frames << " frames to " <<
+    opts.universes << " universes took " << duration << "s, " <<
+    static_cast<unsigned int>(fps) << " frames/s" << endl;
+  return fps;
+}
+
+
+/*
+ * Display the help message
+ */
+void DisplayHelpAndExit(char *argv[]) {
+  cout << "Usage: " << argv[0] << " [options]\n"
+  "\n"
+  "Benchmark output throughput with the ports spread across PluginShards.\n"
+  "\n"
+  "  -f, --frames <count>       The number of frames to send per universe.\n"
+  "  -h, --help                 Display this help message and exit.\n"
+  "  -p, --passes <count>       The work done per frame by each port.\n"
+  "  -t, --max-threads <count>  The largest number of plugin threads to "
+  "try.\n"
+  "  -u, --universes <count>    The number of universes.\n"
+  << endl;
+  exit(0);
+}
+
+
+/*
+ * Parse our command line options
+ */
+void ParseOptions(int argc, char *argv[], options *opts) {
+  static struct option long_options[] = {
+      {"frames", required_argument, 0, 'f'},
+      {"help", no_argument, 0, 'h'},
+      {"max-threads", required_argument, 0, 't'},
+      {"passes", required_argument, 0, 'p'},
+      {"universes", required_argument, 0, 'u'},
+      {0, 0, 0, 0}
+    };
+
+  int option_index = 0;
+  while (1) {
+    int c = getopt_long(argc, argv, "f:hp:t:u:", long_options, &option_index);
+    if (c == -1)
+      break;
+
+    switch (c) {
+      case 0:
+        break;
+      case 'f':
+        ola::StringToInt(optarg, &opts->frames);
+        break;
+      case 'h':
+        DisplayHelpAndExit(argv);
+        break;
+      case 'p':
+        ola::StringToInt(optarg, &opts->passes);
+        break;
+      case 't':
+        ola::StringToInt(optarg, &opts->max_threads);
+        break;
+      case 'u':
+        ola::StringToInt(optarg, &opts->universes);
+        break;
+      default:
+        break;
+    }
+  }
+  if (!opts->universes)
+    opts->universes = 1;
+}
+
+
+int main(int argc, char *argv[]) {
+  options opts;
+  opts.universes = 64;
+  opts.frames = 1000;
+  opts.passes = 4;
+  opts.max_threads = 4;
+  ParseOptions(argc, argv, &opts);
+  ola::InitLogging(ola::OLA_LOG_WARN, ola::OLA_LOG_STDERR);
+
+  double base_fps = RunBenchmark(0, opts);
+  for (unsigned int threads = 1; threads <= opts.max_threads; threads *= 2) {
+    double fps = RunBenchmark(threads, opts);
+    cout << "  speedup vs. main thread: " << fps / base_fps << endl;
+  }
+}
@@ -0,0 +1,176 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * universe_merge_benchmark.cpp
+ * Measures how long a universe takes to merge a new frame from one source,
+ * as the number of sources on the universe grows from 1 to 64.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <iostream>
+#include <vector>
+
+#include "ola/BaseTypes.h"
+#include "ola/Clock.h"
+#include "ola/DmxBuffer.h"
+#include "ola/Logging.h"
+#include "ola/StringUtils.h"
+#include "olad/Client.h"
+#include "olad/DmxSource.h"
+#include "olad/Universe.h"
+#include "olad/UniverseStore.h"
+
+using ola::Client;
+using ola::Clock;
+using ola::DmxBuffer;
+using ola::DmxSource;
+using ola::TimeInterval;
+using ola::TimeStamp;
+using ola::Universe;
+using std::cout;
+using std::endl;
+using std::vector;
+
+
+typedef struct {
+  unsigned int frames;
+  bool ltp;
+} options;
+
+
+static const unsigned int UNIVERSE_ID = 1;
+
+
+/*
+ * Send frames from each source in turn and return the time per frame in us.
+ */
+double RunBenchmark(unsigned int source_count, const options &opts) {
+  ola::UniverseStore store(NULL, NULL);
+  Universe *universe = store.GetUniverseOrCreate(UNIVERSE_ID);
+  universe->SetMergeMode(opts.ltp ? Universe::MERGE_LTP : Universe::MERGE_HTP);
+
+  Clock clock;
+  TimeStamp now;
+  vector<Client*> clients;
+  vector<DmxBuffer> frames(source_count);
+  for (unsigned int i = 0; i < source_count; i++) {
+    uint8_t data[DMX_UNIVERSE_SIZE];
+    for (unsigned int j = 0; j < DMX_UNIVERSE_SIZE; j++)
+      data[j] = random();
+    frames[i].Set(data, sizeof(data));
+    clients.push_back(new Client(NULL));
+  }
+
+  // every source sends a first frame
+  clock.CurrentTime(&now);
+  for (unsigned int i = 0; i < source_count; i++) {
+    DmxSource source(frames[i], now, DmxSource::PRIORITY_DEFAULT);
+    clients[i]->DMXRecieved(UNIVERSE_ID, source);
+    universe->SourceClientDataChanged(clients[i]);
+  }
+
+  TimeStamp start, end;
+  clock.CurrentTime(&start);
+  DmxSource source;
+  for (unsigned int frame = 0; frame < opts.frames; frame++) {
+    unsigned int i = frame % source_count;
+    // change a few channels, as a console would
+    frames[i].SetChannel(frame % DMX_UNIVERSE_SIZE, frame);
+    clock.CurrentTime(&now);
+    source.UpdateData(frames[i], now, DmxSource::PRIORITY_DEFAULT);
+    clients[i]->DMXRecieved(UNIVERSE_ID, source);
+    universe->SourceClientDataChanged(clients[i]);
+  }
+  clock.CurrentTime(&end);
+
+  for (unsigned int i = 0; i < source_count; i++) {
+    universe->RemoveSourceClient(clients[i]);
+    delete clients[i];
+  }
+  return (end - start).AsInt() / static_cast<double>(opts.frames);
+}
+
+
+/*
+ * Display the help message
+ */
+void DisplayHelpAndExit(char *argv[]) {
+  cout << "Usage: " << argv[0] << " [options]\n"
+  "\n"
+  "Time the merge of a single changed source as the number of sources on a\n"
+  "universe grows.\n"
+  "\n"
+  "  -f, --frames <count>    The number of frames to send for each test.\n"
+  "  -h, --help              Display this help message and exit.\n"
+  "  -l, --ltp               Use LTP rather than HTP merging.\n"
+  << endl;
+  exit(0);
+}
+
+
+/*
+ * Parse our command line options
+ */
+void ParseOptions(int argc, char *argv[], options *opts) {
+  static struct option long_options[] = {
+      {"frames", required_argument, 0, 'f'},
+      {"help", no_argument, 0, 'h'},
+      {"ltp", no_argument, 0, 'l'},
+      {0, 0, 0, 0}
+    };
+
+  int option_index = 0;
+  while (1) {
+    int c = getopt_long(argc, argv, "f:hl", long_options, &option_index);
+    if (c == -1)
+      break;
+
+    switch (c) {
+      case 0:
+        break;
+      case 'f':
+        ola::StringToInt(optarg, &opts->frames);
+        break;
+      case 'h':
+        DisplayHelpAndExit(argv);
+        break;
+      case 'l':
+        opts->ltp = true;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+
+int main(int argc, char *argv[]) {
+  options opts;
+  opts.frames = 100000;
+  opts.ltp = false;
+  ParseOptions(argc, argv, &opts);
+  ola::InitLogging(ola::OLA_LOG_WARN, ola::OLA_LOG_STDERR);
+
+  if (!opts.frames)
+    opts.frames = 1;
+
+  for (unsigned int sources = 1; sources <= 64; sources *= 2) {
+    cout << sources << " sources: " << RunBenchmark(sources, opts) <<
+      " us/frame" << endl;
+  }
+}
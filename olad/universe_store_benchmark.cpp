@@ -0,0 +1,210 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * universe_store_benchmark.cpp
+ * Measures how the universe store scales as the number of universes grows.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <iostream>
+#include <vector>
+
+#include "ola/BaseTypes.h"
+#include "ola/Clock.h"
+#include "ola/DmxBuffer.h"
+#include "ola/ExportMap.h"
+#include "ola/Logging.h"
+#include "ola/StringUtils.h"
+#include "olad/Client.h"
+#include "olad/DmxSource.h"
+#include "olad/Universe.h"
+#include "olad/UniverseStore.h"
+
+using ola::Client;
+using ola::Clock;
+using ola::DmxBuffer;
+using ola::DmxSource;
+using ola::ExportMap;
+using ola::TimeInterval;
+using ola::TimeStamp;
+using ola::Universe;
+using ola::UniverseStore;
+using std::cout;
+using std::endl;
+using std::vector;
+
+
+typedef struct {
+  unsigned int universes;
+  unsigned int lookups;
+} options;
+
+
+/*
+ * Print the time each operation took.
+ */
+void PrintResult(const char *name, const TimeInterval &duration,
+                 unsigned int operations) {
+  cout << "  " << name << ": " << duration.AsInt() * 1000.0 / operations <<
+    " ns/op" << endl;
+}
+
+
+/*
+ * Create, look up, send data to and then garbage collect universe_count
+ * universes.
+ */
+void RunBenchmark(unsigned int universe_count, const options &opts) {
+  ExportMap export_map;
+  UniverseStore store(NULL, &export_map);
+  Clock clock;
+  TimeStamp start, end, now;
+
+  cout << universe_count << " universes" << endl;
+
+  clock.CurrentTime(&start);
+  for (unsigned int i = 0; i < universe_count; i++)
+    store.GetUniverseOrCreate(i);
+  clock.CurrentTime(&end);
+  PrintResult("create", end - start, universe_count);
+
+  vector<unsigned int> ids(opts.lookups);
+  for (unsigned int i = 0; i < opts.lookups; i++)
+    ids[i] = random() % universe_count;
+
+  unsigned int found = 0;
+  clock.CurrentTime(&start);
+  for (unsigned int i = 0; i < opts.lookups; i++) {
+    if (store.GetUniverse(ids[i]))
+      found++;
+  }
+  clock.CurrentTime(&end);
+  PrintResult("lookup", end - start, opts.lookups);
+  if (found != opts.lookups)
+    OLA_WARN << "Only found " << found << " of " << opts.lookups;
+
+  // a single client sends a frame to every universe
+  uint8_t data[DMX_UNIVERSE_SIZE];
+  for (unsigned int i = 0; i < DMX_UNIVERSE_SIZE; i++)
+    data[i] = random();
+  DmxBuffer frame(data, sizeof(data));
+  Client client(NULL);
+  DmxSource source;
+
+  clock.CurrentTime(&start);
+  for (unsigned int i = 0; i < universe_count; i++) {
+    frame.SetChannel(i % DMX_UNIVERSE_SIZE, i);
+    clock.CurrentTime(&now);
+    source.UpdateData(frame, now, DmxSource::PRIORITY_DEFAULT);
+    client.DMXRecieved(i, source);
+    store.GetUniverse(i)->SourceClientDataChanged(&client);
+  }
+  clock.CurrentTime(&end);
+  PrintResult("merge", end - start, universe_count);
+
+  vector<Universe*> universes;
+  store.GetList(&universes);
+  vector<Universe*>::iterator iter = universes.begin();
+  for (; iter != universes.end(); ++iter) {
+    (*iter)->RemoveSourceClient(&client);
+    store.AddUniverseGarbageCollection(*iter);
+  }
+
+  clock.CurrentTime(&start);
+  store.GarbageCollectUniverses();
+  clock.CurrentTime(&end);
+  PrintResult("gc", end - start, universe_count);
+
+  if (store.UniverseCount())
+    OLA_WARN << store.UniverseCount() << " universes weren't deleted";
+}
+
+
+/*
+ * Display the help message
+ */
+void DisplayHelpAndExit(char *argv[]) {
+  cout << "Usage: " << argv[0] << " [options]\n"
+  "\n"
+  "Time creating, looking up, merging and garbage collecting universes as\n"
+  "the number of universes grows. By default this runs with 1000, 10000 and\n"
+  "65536 universes.\n"
+  "\n"
+  "  -h, --help                Display this help message and exit.\n"
+  "  -l, --lookups <count>     The number of random lookups to time.\n"
+  "  -n, --universes <count>   Only run with this many universes.\n"
+  << endl;
+  exit(0);
+}
+
+
+/*
+ * Parse our command line options
+ */
+void ParseOptions(int argc, char *argv[], options *opts) {
+  static struct option long_options[] = {
+      {"help", no_argument, 0, 'h'},
+      {"lookups", required_argument, 0, 'l'},
+      {"universes", required_argument, 0, 'n'},
+      {0, 0, 0, 0}
+    };
+
+  int option_index = 0;
+  while (1) {
+    int c = getopt_long(argc, argv, "hl:n:", long_options, &option_index);
+    if (c == -1)
+      break;
+
+    switch (c) {
+      case 0:
+        break;
+      case 'h':
+        DisplayHelpAndExit(argv);
+        break;
+      case 'l':
+        ola::StringToInt(optarg, &opts->lookups);
+        break;
+      case 'n':
+        ola::StringToInt(optarg, &opts->universes);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+
+int main(int argc, char *argv[]) {
+  options opts;
+  opts.universes = 0;
+  opts.lookups = 1000000;
+  ParseOptions(argc, argv, &opts);
+  ola::InitLogging(ola::OLA_LOG_WARN, ola::OLA_LOG_STDERR);
+
+  if (!opts.lookups)
+    opts.lookups = 1;
+
+  cout << "sizeof(Universe) is " << sizeof(Universe) << " bytes" << endl;
+  if (opts.universes) {
+    RunBenchmark(opts.universes, opts);
+  } else {
+    const unsigned int counts[] = {1000, 10000, 65536};
+    for (unsigned int i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+      RunBenchmark(counts[i], opts);
+  }
+}
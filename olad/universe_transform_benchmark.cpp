@@ -0,0 +1,204 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * universe_transform_benchmark.cpp
+ * Measures how long it takes to apply a universe transform to a full frame,
+ * with each of the kernels the CPU supports.
+ * Copyright (C) 2012 Simon Newton
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ola/BaseTypes.h"
+#include "ola/Clock.h"
+#include "ola/DmxBuffer.h"
+#include "ola/Logging.h"
+#include "ola/StringUtils.h"
+#include "olad/UniverseTransform.h"
+
+using ola::Clock;
+using ola::DmxBuffer;
+using ola::TimeInterval;
+using ola::TimeStamp;
+using ola::TransformKernel;
+using ola::UniverseTransform;
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+
+typedef struct {
+  unsigned int frames;
+} options;
+
+
+/*
+ * Print the time each frame took.
+ */
+void PrintResult(const char *name, const TimeInterval &duration,
+                 unsigned int frames) {
+  cout << "  " << name << ": " << duration.AsInt() * 1000.0 / frames <<
+    " ns/frame" << endl;
+}
+
+
+/*
+ * Time the kernels with random tables, where every channel has its own curve
+ * and comes from a different input channel.
+ */
+void RunKernelBenchmark(const options &opts) {
+  vector<uint8_t> curves(DMX_UNIVERSE_SIZE * 256 +
+                         UniverseTransform::GATHER_PADDING);
+  for (unsigned int i = 0; i < curves.size(); i++)
+    curves[i] = random();
+
+  uint8_t input[DMX_UNIVERSE_SIZE + UniverseTransform::GATHER_PADDING];
+  uint16_t sources[DMX_UNIVERSE_SIZE];
+  uint16_t curve_index[DMX_UNIVERSE_SIZE];
+  for (unsigned int i = 0; i < DMX_UNIVERSE_SIZE; i++) {
+    input[i] = random();
+    sources[i] = random() % DMX_UNIVERSE_SIZE;
+    curve_index[i] = i;
+  }
+
+  cout << "Kernels" << endl;
+  Clock clock;
+  TimeStamp start, end;
+  vector<TransformKernel> kernels;
+  ola::AvailableTransformKernels(&kernels);
+  vector<TransformKernel>::const_iterator iter = kernels.begin();
+  for (; iter != kernels.end(); ++iter) {
+    uint8_t output[DMX_UNIVERSE_SIZE];
+    clock.CurrentTime(&start);
+    for (unsigned int i = 0; i < opts.frames; i++) {
+      iter->function(output, input, sources, curve_index, &curves[0],
+                     DMX_UNIVERSE_SIZE);
+      // feed the output back in so the compiler can't hoist the loop
+      input[i % DMX_UNIVERSE_SIZE] = output[i % DMX_UNIVERSE_SIZE];
+    }
+    clock.CurrentTime(&end);
+    PrintResult(iter->name, end - start, opts.frames);
+  }
+}
+
+
+/*
+ * Time UniverseTransform::Apply, which includes copying the frame in & out.
+ */
+void RunApplyBenchmark(const options &opts) {
+  const char *rules[] = {
+    "map 1-256 257",
+    "invert 1-100",
+    "scale 101-200 40%",
+    "clip 201-300 80%",
+  };
+
+  UniverseTransform transform;
+  for (unsigned int i = 0; i < sizeof(rules) / sizeof(rules[0]); i++)
+    transform.AddRule(rules[i]);
+  // swap RGB to BGR for some pixels, using the last channel as a spare
+  for (unsigned int i = 0; i < 10; i++) {
+    const string red = ola::IntToString(i * 3 + 1);
+    const string blue = ola::IntToString(i * 3 + 3);
+    transform.AddRule("map 512 " + red);
+    transform.AddRule("map " + red + " " + blue);
+    transform.AddRule("map " + blue + " 512");
+  }
+
+  uint8_t data[DMX_UNIVERSE_SIZE];
+  for (unsigned int i = 0; i < DMX_UNIVERSE_SIZE; i++)
+    data[i] = random();
+  DmxBuffer input(data, sizeof(data));
+  DmxBuffer output;
+
+  cout << "Apply with " << transform.Rules().size() << " rules" << endl;
+  Clock clock;
+  TimeStamp start, end;
+  clock.CurrentTime(&start);
+  for (unsigned int i = 0; i < opts.frames; i++) {
+    input.SetChannel(i % DMX_UNIVERSE_SIZE, i);
+    transform.Apply(input, &output);
+  }
+  clock.CurrentTime(&end);
+  PrintResult("apply", end - start, opts.frames);
+}
+
+
+/*
+ * Display the help message
+ */
+void DisplayHelpAndExit(char *argv[]) {
+  cout << "Usage: " << argv[0] << " [options]\n"
+  "\n"
+  "Benchmark the universe transform kernels and the cost of a transform per\n"
+  "frame.\n"
+  "\n"
+  "  -f, --frames <count>    The number of frames to time.\n"
+  "  -h, --help              Display this help message and exit.\n"
+  << endl;
+  exit(0);
+}
+
+
+/*
+ * Parse our command line options
+ */
+void ParseOptions(int argc, char *argv[], options *opts) {
+  static struct option long_options[] = {
+      {"frames", required_argument, 0, 'f'},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0}
+    };
+
+  int option_index = 0;
+  while (1) {
+    int c = getopt_long(argc, argv, "f:h", long_options, &option_index);
+    if (c == -1)
+      break;
+
+    switch (c) {
+      case 0:
+        break;
+      case 'f':
+        ola::StringToInt(optarg, &opts->frames);
+        break;
+      case 'h':
+        DisplayHelpAndExit(argv);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+
+int main(int argc, char *argv[]) {
+  options opts;
+  opts.frames = 100000;
+  ParseOptions(argc, argv, &opts);
+  ola::InitLogging(ola::OLA_LOG_WARN, ola::OLA_LOG_STDERR);
+
+  if (!opts.frames)
+    opts.frames = 1;
+
+  RunKernelBenchmark(opts);
+  RunApplyBenchmark(opts);
+}
@@ -113,7 +113,8 @@ bool ArtNetDevice::StartHook() {
   node_options.use_limited_broadcast_address = m_preferences->GetValueAsBool(
       K_LIMITED_BROADCAST_KEY);
 
-  m_node = new ArtNetNode(interface, m_plugin_adaptor, node_options);
+  m_node = new ArtNetNode(interface, m_plugin_adaptor, node_options, NULL,
+                          m_plugin_adaptor->GetExportMap());
   m_node->SetNetAddress(net);
   m_node->SetSubnetAddress(subnet);
   m_node->SetShortName(m_preferences->GetValue(K_SHORT_NAME_KEY));
@@ -50,6 +50,8 @@ using std::vector;
 
 
 const char ArtNetNodeImpl::ARTNET_ID[] = "Art-Net";
+const char ArtNetNodeImpl::K_DATAGRAMS_SENT_VAR[] = "artnet-datagrams-sent";
+const char ArtNetNodeImpl::K_SEND_CALLS_VAR[] = "artnet-send-calls";
 
 /*
  * Create a new node
@@ -57,11 +59,14 @@ const char ArtNetNodeImpl::ARTNET_ID[] = "Art-Net";
  * @param short_name the short node name
  * @param long_name the long node name
  * @param subnet_address the ArtNet 'subnet' address, 4 bits.
+ * @param export_map if not NULL, the number of datagrams sent & the number of
+ *   send system calls are exported.
  */
 ArtNetNodeImpl::ArtNetNodeImpl(const ola::network::Interface &interface,
                                ola::network::SelectServerInterface *ss,
                                const ArtNetNodeOptions &options,
-                               ola::network::UdpSocketInterface *socket)
+                               ola::network::UdpSocketInterface *socket,
+                               ola::ExportMap *export_map)
     : m_running(false),
       m_net_address(0),
       m_send_reply_on_change(true),
@@ -73,7 +78,10 @@ ArtNetNodeImpl::ArtNetNodeImpl(const ola::network::Interface &interface,
       m_always_broadcast(options.always_broadcast),
       m_use_limited_broadcast_address(options.use_limited_broadcast_address),
       m_interface(interface),
-      m_socket(socket) {
+      m_socket(socket),
+      m_recv_batch(RECV_BATCH_SIZE, sizeof(artnet_packet)),
+      m_datagrams_sent_var(NULL),
+      m_send_calls_var(NULL) {
   // reset all the port structures
   for (unsigned int i = 0; i < ARTNET_MAX_PORTS; i++) {
     m_input_ports[i].universe_address = 0;
@@ -97,6 +105,11 @@ ArtNetNodeImpl::ArtNetNodeImpl(const ola::network::Interface &interface,
     m_output_ports[i].on_flush = NULL;
     m_output_ports[i].on_rdm_request = NULL;
   }
+
+  if (export_map) {
+    m_datagrams_sent_var = export_map->GetCounterVar(K_DATAGRAMS_SENT_VAR);
+    m_send_calls_var = export_map->GetCounterVar(K_SEND_CALLS_VAR);
+  }
 }
 
 
@@ -418,6 +431,11 @@ bool ArtNetNodeImpl::SendDMX(uint8_t port_id, const DmxBuffer &buffer) {
     map<IPV4Address, TimeStamp>::iterator iter =
       m_input_ports[port_id].subscribed_nodes.begin();
 
+    // The packet is the same for every node, so queue it once and send it
+    // to all the nodes with as few system calls as possible.
+    const uint8_t *data = reinterpret_cast<const uint8_t*>(&packet);
+    unsigned int packet_size = size + sizeof(packet.id) +
+      sizeof(packet.op_code);
     TimeStamp last_heard_threshold = (
         *m_ss->WakeUpTime() - TimeInterval(NODE_TIMEOUT, 0));
     while (iter != m_input_ports[port_id].subscribed_nodes.end()) {
@@ -426,9 +444,16 @@ bool ArtNetNodeImpl::SendDMX(uint8_t port_id, const DmxBuffer &buffer) {
         m_input_ports[port_id].subscribed_nodes.erase(iter++);
         continue;
       }
-      sent_ok |= SendPacket(packet, size, iter->first);
+      if (!m_send_queue.AddDestination(iter->first, ARTNET_PORT)) {
+        // either this is the first node, or the queue is full
+        if (m_send_queue.IsFull())
+          sent_ok |= SendQueuedPackets();
+        m_send_queue.Add(data, packet_size, iter->first, ARTNET_PORT);
+      }
       ++iter;
     }
+    if (!m_send_queue.Empty())
+      sent_ok |= SendQueuedPackets();
 
     if (m_input_ports[port_id].subscribed_nodes.empty()) {
       OLA_DEBUG <<
@@ -742,19 +767,19 @@ bool ArtNetNodeImpl::SendTimeCode(const ola::timecode::TimeCode &timecode) {
 }
 
 /*
- * Called when there is data on this socket
+ * Called when there is data on this socket. This handles all the packets that
+ * are waiting, up to RECV_BATCH_SIZE.
  */
 void ArtNetNodeImpl::SocketReady() {
-  artnet_packet packet;
-  ssize_t packet_size = sizeof(packet);
-  ola::network::IPV4Address source;
-
-  if (!m_socket->RecvFrom(reinterpret_cast<uint8_t*>(&packet),
-                          &packet_size,
-                          source))
+  if (!m_socket->RecvBatch(&m_recv_batch))
     return;
 
-  HandlePacket(source, packet, packet_size);
+  for (unsigned int i = 0; i < m_recv_batch.Size(); i++) {
+    HandlePacket(
+        m_recv_batch.Source(i),
+        *reinterpret_cast<const artnet_packet*>(m_recv_batch.Data(i)),
+        m_recv_batch.Length(i));
+  }
 }
 
 
@@ -1374,6 +1399,32 @@ void ArtNetNodeImpl::IncrementUIDCounts(uint8_t port_id) {
 }
 
 
+/*
+ * Send the packets in m_send_queue.
+ * @returns true if at least one packet was sent.
+ */
+bool ArtNetNodeImpl::SendQueuedPackets() {
+  unsigned int queued = m_send_queue.Size();
+  unsigned int sent = m_socket->SendBatch(&m_send_queue);
+  UpdateSendCounters(sent, m_send_queue.SendCalls());
+  if (sent != queued)
+    OLA_INFO << "Only sent " << sent << " of " << queued << " packets";
+  return sent > 0;
+}
+
+
+/*
+ * Update the exported send counters.
+ */
+void ArtNetNodeImpl::UpdateSendCounters(unsigned int datagrams,
+                                        unsigned int calls) {
+  if (m_datagrams_sent_var)
+    (*m_datagrams_sent_var) += datagrams;
+  if (m_send_calls_var)
+    (*m_send_calls_var) += calls;
+}
+
+
 /*
  * Send an ArtNet packet
  * @param packet
@@ -1389,6 +1440,7 @@ bool ArtNetNodeImpl::SendPacket(const artnet_packet &packet,
       size,
       ip_destination,
       ARTNET_PORT);
+  UpdateSendCounters(bytes_sent == size ? 1 : 0, 1);
 
   if (bytes_sent != size) {
     OLA_INFO << "Only sent " << bytes_sent << " of " << size;
@@ -1500,17 +1552,13 @@ void ArtNetNodeImpl::UpdatePortFromSource(OutputPort *port,
     (*port->buffer) = source.buffer;
   } else {
     // HTP merge
-    bool first = true;
+    const DmxBuffer *buffers[MAX_MERGE_SOURCES];
+    unsigned int count = 0;
     for (unsigned int i = 0; i < MAX_MERGE_SOURCES; i++) {
-      if (!port->sources[i].address.IsWildcard()) {
-        if (first) {
-          (*port->buffer) = port->sources[i].buffer;
-          first = false;
-        } else {
-          port->buffer->HTPMerge(port->sources[i].buffer);
-        }
-      }
+      if (!port->sources[i].address.IsWildcard())
+        buffers[count++] = &port->sources[i].buffer;
     }
+    port->buffer->HTPMerge(buffers, count);
   }
   port->on_data->Run();
 }
@@ -1628,6 +1676,7 @@ bool ArtNetNodeImpl::InitNetwork() {
 
   m_socket->SetOnData(NewCallback(this, &ArtNetNodeImpl::SocketReady));
   m_ss->AddReadDescriptor(m_socket);
+  m_ss->SetReadDescriptorName(m_socket, "artnet-socket");
   return true;
 }
 
@@ -1801,8 +1850,9 @@ void ArtNetNodeImpl::RunRDMCallbackWithUIDs(const uid_map &uids,
 ArtNetNode::ArtNetNode(const ola::network::Interface &interface,
                        ola::network::SelectServerInterface *ss,
                        const ArtNetNodeOptions &options,
-                       ola::network::UdpSocketInterface *socket):
-    m_impl(interface, ss, options, socket) {
+                       ola::network::UdpSocketInterface *socket,
+                       ola::ExportMap *export_map):
+    m_impl(interface, ss, options, socket, export_map) {
   for (unsigned int i = 0; i < ARTNET_MAX_PORTS; i++) {
     m_wrappers[i] = new ArtNetNodeImplRDMWrapper(&m_impl, i);
     m_controllers[i] = new ola::rdm::DiscoverableQueueingRDMController(
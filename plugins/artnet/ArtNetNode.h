@@ -31,6 +31,7 @@
 #include "ola/Callback.h"
 #include "ola/Clock.h"
 #include "ola/DmxBuffer.h"
+#include "ola/ExportMap.h"
 #include "ola/network/IPV4Address.h"
 #include "ola/network/Interface.h"
 #include "ola/network/SelectServerInterface.h"
@@ -97,7 +98,8 @@ class ArtNetNodeImpl {
     ArtNetNodeImpl(const ola::network::Interface &interface,
                    ola::network::SelectServerInterface *ss,
                    const ArtNetNodeOptions &options,
-                   ola::network::UdpSocketInterface *socket = NULL);
+                   ola::network::UdpSocketInterface *socket = NULL,
+                   ola::ExportMap *export_map = NULL);
     virtual ~ArtNetNodeImpl();
 
     bool Start();
@@ -230,6 +232,10 @@ class ArtNetNodeImpl {
     OutputPort m_output_ports[ARTNET_MAX_PORTS];
     ola::network::Interface m_interface;
     ola::network::UdpSocketInterface *m_socket;
+    ola::network::DatagramBatch m_recv_batch;
+    ola::network::DatagramSendQueue m_send_queue;
+    ola::CounterVariable *m_datagrams_sent_var;
+    ola::CounterVariable *m_send_calls_var;
 
     ArtNetNodeImpl(const ArtNetNodeImpl&);
     ArtNetNodeImpl& operator=(const ArtNetNodeImpl&);
@@ -274,6 +280,8 @@ class ArtNetNodeImpl {
                          unsigned int packet_size);
     void PopulatePacketHeader(artnet_packet *packet, uint16_t op_code);
     void IncrementUIDCounts(uint8_t port_id);
+    bool SendQueuedPackets();
+    void UpdateSendCounters(unsigned int datagrams, unsigned int calls);
     bool SendPacket(const artnet_packet &packet,
                     unsigned int size,
                     const IPV4Address &destination);
@@ -307,6 +315,8 @@ class ArtNetNodeImpl {
     bool InitNetwork();
 
     static const char ARTNET_ID[];
+    static const char K_DATAGRAMS_SENT_VAR[];
+    static const char K_SEND_CALLS_VAR[];
     static const uint16_t ARTNET_PORT = 6454;
     static const uint16_t OEM_CODE = 0x0431;
     static const uint16_t ARTNET_VERSION = 14;
@@ -317,6 +327,8 @@ class ArtNetNodeImpl {
     static const uint8_t RDM_VERSION = 0x01;  // v1.0 standard baby!
     static const uint8_t TOD_FLUSH_COMMAND = 0x01;
     static const unsigned int MERGE_TIMEOUT = 10;  // As per the spec
+    // the number of packets to read each time the socket is ready
+    static const unsigned int RECV_BATCH_SIZE = 32;
     // seconds after which a node is marked as inactive for the dmx merging
     static const unsigned int NODE_TIMEOUT = 31;
     // mseconds we wait for a TodData packet before declaring a node missing
@@ -373,7 +385,8 @@ class ArtNetNode {
     ArtNetNode(const ola::network::Interface &interface,
                ola::network::SelectServerInterface *ss,
                const ArtNetNodeOptions &options,
-               ola::network::UdpSocketInterface *socket = NULL);
+               ola::network::UdpSocketInterface *socket = NULL,
+               ola::ExportMap *export_map = NULL);
     virtual ~ArtNetNode();
 
     bool Start() { return m_impl.Start(); }
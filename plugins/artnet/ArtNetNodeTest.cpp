@@ -26,6 +26,7 @@
 
 #include "ola/Callback.h"
 #include "ola/DmxBuffer.h"
+#include "ola/ExportMap.h"
 #include "ola/Logging.h"
 #include "ola/network/IPV4Address.h"
 #include "ola/network/Interface.h"
@@ -42,7 +43,9 @@
 #include "plugins/artnet/MockUdpSocket.h"
 
 
+using ola::CounterVariable;
 using ola::DmxBuffer;
+using ola::ExportMap;
 using ola::network::IPV4Address;
 using ola::network::Interface;
 using ola::plugin::artnet::ArtNetNode;
@@ -525,12 +528,15 @@ void ArtNetNodeTest::testLimitedBroadcastDMX() {
 void ArtNetNodeTest::testNonBroadcastSendDMX() {
   m_socket->SetDiscardMode(true);
   ArtNetNodeOptions node_options;
-  ArtNetNode node(interface, &ss, node_options, m_socket);
+  ExportMap export_map;
+  ArtNetNode node(interface, &ss, node_options, m_socket, &export_map);
   SetupInputPort(&node);
   CPPUNIT_ASSERT(node.Start());
   ss.RemoveReadDescriptor(m_socket);
   m_socket->Verify();
   m_socket->SetDiscardMode(false);
+  CounterVariable *datagrams_sent =
+    export_map.GetCounterVar("artnet-datagrams-sent");
 
   DmxBuffer dmx;
   dmx.SetFromString("0,1,2,3,4,5");
@@ -675,7 +681,9 @@ void ArtNetNodeTest::testNonBroadcastSendDMX() {
     dmx.SetFromString("10,11,12,0,1,2");
     ExpectedSend(DMX_MESSAGE2, sizeof(DMX_MESSAGE2), peer_ip);
     ExpectedSend(DMX_MESSAGE2, sizeof(DMX_MESSAGE2), peer_ip2);
+    unsigned int datagrams_before = datagrams_sent->Get();
     CPPUNIT_ASSERT(node.SendDMX(m_port_id, dmx));
+    CPPUNIT_ASSERT_EQUAL(datagrams_before + 2, datagrams_sent->Get());
   }
 
   // adjust the broadcast threshold
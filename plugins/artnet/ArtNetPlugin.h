@@ -47,6 +47,7 @@ class ArtNetPlugin : public Plugin {
     ola_plugin_id Id() const { return OLA_PLUGIN_ARTNET; }
     string Description() const;
     string PluginPrefix() const { return PLUGIN_PREFIX; }
+    bool SupportsShards() const { return true; }
 
   private:
     bool StartHook();
@@ -135,6 +135,41 @@ bool MockUdpSocket::RecvFrom(uint8_t *buffer,
 }
 
 
+/*
+ * Return all the queued data, up to the capacity of the batch.
+ */
+bool MockUdpSocket::RecvBatch(ola::network::DatagramBatch *batch) const {
+  CPPUNIT_ASSERT(m_received_data.size());
+  batch->Clear();
+  while (m_received_data.size() && batch->Size() < batch->Capacity()) {
+    const received_data &new_data = m_received_data.front();
+    CPPUNIT_ASSERT(batch->MaxSize() >= new_data.size);
+    memcpy(batch->Buffer(batch->Size()), new_data.data, new_data.size);
+    batch->Append(new_data.size, new_data.address, new_data.port);
+    m_received_data.pop();
+  }
+  return true;
+}
+
+
+/*
+ * Each queued datagram is checked against the expected data.
+ */
+unsigned int MockUdpSocket::SendBatch(
+    ola::network::DatagramSendQueue *queue) const {
+  unsigned int sent = 0;
+  for (unsigned int i = 0; i < queue->Size(); i++) {
+    ssize_t bytes_sent = SendTo(queue->Data(i), queue->Length(i),
+                                queue->Destination(i), queue->Port(i));
+    if (bytes_sent == static_cast<ssize_t>(queue->Length(i)))
+      sent++;
+  }
+  queue->SetSendCalls(queue->Size());
+  queue->Clear();
+  return sent;
+}
+
+
 bool MockUdpSocket::EnableBroadcast() {
   m_broadcast_set = true;
   return true;
@@ -63,6 +63,8 @@ class MockUdpSocket: public ola::network::UdpSocketInterface {
                   ssize_t *data_read,
                   ola::network::IPV4Address &source,
                   uint16_t &port) const;
+    bool RecvBatch(ola::network::DatagramBatch *batch) const;
+    unsigned int SendBatch(ola::network::DatagramSendQueue *queue) const;
     bool EnableBroadcast();
     bool SetMulticastInterface(const IPV4Address &interface);
     bool JoinMulticast(const IPV4Address &interface,
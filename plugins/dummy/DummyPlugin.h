@@ -44,6 +44,7 @@ class DummyPlugin: public Plugin {
     string Description() const;
     ola_plugin_id Id() const { return OLA_PLUGIN_DUMMY; }
     string PluginPrefix() const { return PLUGIN_PREFIX; }
+    bool SupportsShards() const { return true; }
 
   private:
     bool StartHook();
@@ -100,6 +100,10 @@ bool E131Device::StartHook() {
   }
 
   m_plugin_adaptor->AddReadDescriptor(m_node->GetSocket());
+  m_node->EnableSendBatching(m_plugin_adaptor,
+                             m_plugin_adaptor->GetExportMap());
+  m_plugin_adaptor->SetReadDescriptorName(m_node->GetSocket(),
+                                          "e131-socket");
   return true;
 }
 
@@ -40,6 +40,7 @@ class E131Plugin: public ola::Plugin {
     ola_plugin_id Id() const { return OLA_PLUGIN_E131; }
     string Description() const;
     string PluginPrefix() const { return PLUGIN_PREFIX; }
+    bool SupportsShards() const { return true; }
 
   private:
     bool StartHook();
@@ -31,6 +31,8 @@ namespace ola {
 namespace plugin {
 namespace e131 {
 
+const TimeInterval E131OutputPort::PRIORITY_REFRESH_INTERVAL(1, 0);
+
 
 bool E131PortHelper::PreSetUniverse(Universe *old_universe,
                                     Universe *new_universe) {
@@ -67,7 +69,8 @@ void E131InputPort::PostSetUniverse(Universe *old_universe,
         new_universe->UniverseId(),
         &m_buffer,
         &m_priority,
-        NewCallback<E131InputPort, void>(this, &E131InputPort::DmxChanged));
+        NewCallback<E131InputPort, void>(this, &E131InputPort::DmxChanged),
+        &m_slot_priorities);
 }
 
 
@@ -108,6 +111,33 @@ bool E131OutputPort::WriteDMX(const DmxBuffer &buffer, uint8_t priority) {
 }
 
 
+/*
+ * Send the per slot priorities for the universe as a 0xdd packet. These
+ * rarely change so they're only sent when they do, or once a second so
+ * receivers don't time them out.
+ */
+bool E131OutputPort::WriteSlotPriorities(const DmxBuffer &slot_priorities) {
+  Universe *universe = GetUniverse();
+  if (!universe)
+    return false;
+
+  TimeStamp now;
+  m_clock.CurrentTime(&now);
+  if (slot_priorities == m_slot_priorities &&
+      now < m_last_priority_send + PRIORITY_REFRESH_INTERVAL)
+    return true;
+
+  uint8_t priority = GetPriorityMode() == PRIORITY_MODE_OVERRIDE ?
+    GetPriority() : universe->ActivePriority();
+  m_slot_priorities = slot_priorities;
+  m_last_priority_send = now;
+  return m_node->SendDMXPriorities(universe->UniverseId(),
+                                   slot_priorities,
+                                   priority,
+                                   m_preview_on);
+}
+
+
 /*
  * Update the universe name
  */
@@ -22,6 +22,7 @@
 #define PLUGINS_E131_E131PORT_H_
 
 #include <string>
+#include "ola/Clock.h"
 #include "olad/Port.h"
 #include "plugins/e131/E131Device.h"
 #include "plugins/e131/e131/E131Node.h"
@@ -57,9 +58,11 @@ class E131InputPort: public BasicInputPort {
     const DmxBuffer &ReadDMX() const { return m_buffer; }
     bool SupportsPriorities() const { return true; }
     uint8_t InheritedPriority() const { return m_priority; }
+    const DmxBuffer *ReadSlotPriorities() const { return &m_slot_priorities; }
 
   private:
     DmxBuffer m_buffer;
+    DmxBuffer m_slot_priorities;
     E131Node *m_node;
     E131PortHelper m_helper;
     uint8_t m_priority;
@@ -82,6 +85,7 @@ class E131OutputPort: public BasicOutputPort {
     string Description() const { return m_helper.Description(GetUniverse()); }
 
     bool WriteDMX(const DmxBuffer &buffer, uint8_t priority);
+    bool WriteSlotPriorities(const DmxBuffer &slot_priorities);
     void UniverseNameChanged(const string &new_name);
 
     void SetPreviewMode(bool preview_mode) { m_preview_on = preview_mode; }
@@ -92,8 +96,14 @@ class E131OutputPort: public BasicOutputPort {
     bool m_prepend_hostname;
     bool m_preview_on;
     DmxBuffer m_buffer;
+    DmxBuffer m_slot_priorities;
+    TimeStamp m_last_priority_send;
+    ola::Clock m_clock;
     E131Node *m_node;
     E131PortHelper m_helper;
+
+    // resend the slot priorities at least this often
+    static const TimeInterval PRIORITY_REFRESH_INTERVAL;
 };
 }  // e131
 }  // plugin
@@ -19,6 +19,7 @@
  */
 
 #include "plugins/e131/e131/E131Includes.h"  //  NOLINT, this has to be first
+#include <string.h>
 #include <sys/time.h>
 #include <algorithm>
 #include <map>
@@ -118,30 +119,53 @@ bool DMPE131Inflator::HandlePDUData(uint32_t vector,
     start_code = *(data + available_length);
 
   // The only time we want to continue processing a non-0 start code is if it
-  // contains a Terminate message.
-  if (start_code && !e131_header.StreamTerminated()) {
+  // contains a Terminate message or per slot priorities.
+  if (start_code && start_code != PRIORITY_START_CODE &&
+      !e131_header.StreamTerminated()) {
     OLA_INFO << "Skipping packet with non-0 start code: " << start_code;
     return true;
   }
 
-  DmxBuffer *target_buffer;
-  if (!TrackSourceIfRequired(&universe_iter->second, headers, &target_buffer)) {
+  dmx_source *source;
+  if (!TrackSourceIfRequired(&universe_iter->second, headers, &source)) {
     // no need to continue processing
     return true;
   }
 
   // Reaching here means that we actually have new data and we should merge.
-  if (target_buffer && start_code == 0) {
+  if (source && (start_code == DMX512_START_CODE ||
+                 start_code == PRIORITY_START_CODE)) {
+    DmxBuffer *target_buffer = start_code == DMX512_START_CODE ?
+      &source->buffer : &source->priorities;
     unsigned int channels = std::min(length_remaining, address->Number());
     if (e131_header.UsingRev2())
       target_buffer->Set(data + available_length, channels);
     else
      target_buffer->Set(data + available_length + 1, channels - 1);
+
+    // wait for the levels before using the priorities from a new source
+    if (start_code == PRIORITY_START_CODE && !source->buffer.Size())
+      return true;
   }
 
   if (universe_iter->second.priority)
     *universe_iter->second.priority = universe_iter->second.active_priority;
 
+  bool has_slot_priorities = false;
+  std::vector<dmx_source>::const_iterator source_iter =
+    universe_iter->second.sources.begin();
+  for (; source_iter != universe_iter->second.sources.end(); ++source_iter)
+    has_slot_priorities |= source_iter->priorities.Size() != 0;
+
+  if (universe_iter->second.slot_priorities && !has_slot_priorities)
+    universe_iter->second.slot_priorities->Reset();
+
+  if (has_slot_priorities) {
+    SlotPriorityMerge(&universe_iter->second);
+    universe_iter->second.closure->Run();
+    return true;
+  }
+
   // merge the sources
   switch (universe_iter->second.sources.size()) {
     case 0:
@@ -154,11 +178,13 @@ bool DMPE131Inflator::HandlePDUData(uint32_t vector,
       break;
     default:
       // HTP Merge
-      universe_iter->second.buffer->Reset();
-      std::vector<dmx_source>::const_iterator source_iter =
-        universe_iter->second.sources.begin();
-      for (; source_iter != universe_iter->second.sources.end(); ++source_iter)
-        universe_iter->second.buffer->HTPMerge(source_iter->buffer);
+      const DmxBuffer *buffers[MAX_MERGE_SOURCES];
+      unsigned int count = 0;
+      for (source_iter = universe_iter->second.sources.begin();
+           source_iter != universe_iter->second.sources.end();
+           ++source_iter)
+        buffers[count++] = &source_iter->buffer;
+      universe_iter->second.buffer->HTPMerge(buffers, count);
       universe_iter->second.closure->Run();
   }
   return true;
@@ -171,11 +197,14 @@ bool DMPE131Inflator::HandlePDUData(uint32_t vector,
  * @param buffer the DmxBuffer to update with the data
  * @param handler the Callback0 to call when there is data for this universe.
  * Ownership of the closure is transferred to the node.
+ * @param slot_priorities if not NULL, this is updated with the priority for
+ * each slot when a source sends 0xdd packets, and is empty otherwise.
  */
 bool DMPE131Inflator::SetHandler(unsigned int universe,
                                  ola::DmxBuffer *buffer,
                                  uint8_t *priority,
-                                 ola::Callback0<void> *closure) {
+                                 ola::Callback0<void> *closure,
+                                 ola::DmxBuffer *slot_priorities) {
   if (!closure || !buffer)
     return false;
 
@@ -188,6 +217,7 @@ bool DMPE131Inflator::SetHandler(unsigned int universe,
     handler.closure = closure;
     handler.active_priority = 0;
     handler.priority = priority;
+    handler.slot_priorities = slot_priorities;
     m_handlers[universe] = handler;
     m_e131_layer->JoinUniverse(universe);
   } else {
@@ -195,6 +225,7 @@ bool DMPE131Inflator::SetHandler(unsigned int universe,
     iter->second.closure = closure;
     iter->second.buffer = buffer;
     iter->second.priority = priority;
+    iter->second.slot_priorities = slot_priorities;
     delete old_closure;
   }
   return true;
@@ -227,16 +258,16 @@ bool DMPE131Inflator::RemoveHandler(unsigned int universe) {
  * priority.
  * @param universe_data the universe_handler struct for this universe,
  * @param HeaderSet the set of headers in this packet
- * @param buffer, if set to a non-NULL pointer, the caller should copy the data
- * in the buffer.
+ * @param source, if set to a non-NULL pointer, the caller should copy the
+ * data into the source.
  * @returns true if we should remerge the data, false otherwise.
  */
 bool DMPE131Inflator::TrackSourceIfRequired(
     universe_handler *universe_data,
     const HeaderSet &headers,
-    DmxBuffer **buffer) {
+    dmx_source **source) {
 
-  *buffer = NULL;  // default the buffer to NULL
+  *source = NULL;  // default the source to NULL
   ola::TimeStamp now;
   m_clock.CurrentTime(&now);
   const E131Header &e131_header = headers.GetE131Header();
@@ -293,7 +324,7 @@ bool DMPE131Inflator::TrackSourceIfRequired(
       new_source.sequence = e131_header.Sequence();
       new_source.last_heard_from = now;
       iter = sources.insert(sources.end(), new_source);
-      *buffer = &iter->buffer;
+      *source = &*iter;
       return true;
     }
 
@@ -338,10 +369,40 @@ bool DMPE131Inflator::TrackSourceIfRequired(
         iter = sources.insert(sources.end(), this_source);
       }
     }
-    *buffer = &iter->buffer;
+    *source = &*iter;
     return true;
   }
 }
+
+
+/*
+ * Merge the sources slot by slot, when at least one of them has sent 0xdd
+ * priorities. The other sources use the universe priority for every slot.
+ */
+void DMPE131Inflator::SlotPriorityMerge(universe_handler *universe_data) {
+  uint8_t active_priority[DMX_UNIVERSE_SIZE];
+  memset(active_priority, universe_data->active_priority,
+         sizeof(active_priority));
+  const DmxBuffer uniform_priorities(active_priority,
+                                     sizeof(active_priority));
+
+  const DmxBuffer *buffers[MAX_MERGE_SOURCES];
+  const DmxBuffer *priorities[MAX_MERGE_SOURCES];
+  unsigned int count = 0;
+  std::vector<dmx_source>::const_iterator iter =
+    universe_data->sources.begin();
+  for (; iter != universe_data->sources.end(); ++iter) {
+    buffers[count] = &iter->buffer;
+    priorities[count++] = iter->priorities.Size() ? &iter->priorities :
+      &uniform_priorities;
+  }
+
+  DmxBuffer merged_priorities;
+  universe_data->buffer->PriorityMerge(
+      buffers, priorities, count,
+      universe_data->slot_priorities ? universe_data->slot_priorities :
+      &merged_priorities);
+}
 }  // e131
 }  // plugin
 }  // ola
@@ -45,9 +45,13 @@ class DMPE131Inflator: public DMPInflator {
     ~DMPE131Inflator();
 
     bool SetHandler(unsigned int universe, ola::DmxBuffer *buffer,
-                    uint8_t *priority, ola::Callback0<void> *handler);
+                    uint8_t *priority, ola::Callback0<void> *handler,
+                    ola::DmxBuffer *slot_priorities = NULL);
     bool RemoveHandler(unsigned int universe);
 
+    // The start code for packets which carry a priority for each slot.
+    static const uint8_t PRIORITY_START_CODE = 0xdd;
+
   protected:
     virtual bool HandlePDUData(uint32_t vector,
                                HeaderSet &headers,
@@ -60,6 +64,8 @@ class DMPE131Inflator: public DMPInflator {
       uint8_t sequence;
       TimeStamp last_heard_from;
       DmxBuffer buffer;
+      // the last 0xdd priorities, empty if the source hasn't sent any
+      DmxBuffer priorities;
     } dmx_source;
 
     typedef struct {
@@ -67,6 +73,7 @@ class DMPE131Inflator: public DMPInflator {
       Callback0<void> *closure;
       uint8_t active_priority;
       uint8_t *priority;
+      DmxBuffer *slot_priorities;
       std::vector<dmx_source> sources;
     } universe_handler;
 
@@ -77,7 +84,8 @@ class DMPE131Inflator: public DMPInflator {
 
     bool TrackSourceIfRequired(universe_handler *universe_data,
                                const HeaderSet &headers,
-                               DmxBuffer **buffer);
+                               dmx_source **source);
+    void SlotPriorityMerge(universe_handler *universe_data);
 
     // The max number of sources we'll track per universe.
     static const uint8_t MAX_MERGE_SOURCES = 6;
@@ -161,6 +161,44 @@ bool E131Node::SendDMXWithSequenceOffset(uint16_t universe,
                                          int8_t sequence_offset,
                                          uint8_t priority,
                                          bool preview) {
+  return SendDataWithStartCode(universe, DMX512_START_CODE, buffer,
+                               sequence_offset, priority, preview);
+}
+
+
+/*
+ * Send a priority for each slot, using the 0xdd start code. Receivers which
+ * understand these use them in place of the universe priority. They share the
+ * sequence numbers with the DMX data for the universe. Per slot priorities
+ * can't be sent using Rev 2.
+ * @param universe the id of the universe to send
+ * @param slot_priorities the priority for each slot, 0 means this source
+ *   doesn't control the slot.
+ * @param priority the universe priority to use
+ * @param preview set to true to turn on the preview bit
+ * @return true if it was sent successfully, false otherwise
+ */
+bool E131Node::SendDMXPriorities(uint16_t universe,
+                                 const ola::DmxBuffer &slot_priorities,
+                                 uint8_t priority,
+                                 bool preview) {
+  if (m_use_rev2)
+    return false;
+  return SendDataWithStartCode(universe,
+                               DMPE131Inflator::PRIORITY_START_CODE,
+                               slot_priorities, 0, priority, preview);
+}
+
+
+/*
+ * Send a DMP packet with the given start code.
+ */
+bool E131Node::SendDataWithStartCode(uint16_t universe,
+                                     uint8_t start_code,
+                                     const ola::DmxBuffer &buffer,
+                                     int8_t sequence_offset,
+                                     uint8_t priority,
+                                     bool preview) {
   map<unsigned int, tx_universe>::iterator iter =
       m_tx_universes.find(universe);
   tx_universe *settings;
@@ -178,6 +216,7 @@ bool E131Node::SendDMXWithSequenceOffset(uint16_t universe,
     dmp_data_length = buffer.Size();
   } else {
     unsigned int data_size = DMX_UNIVERSE_SIZE;
+    m_send_buffer[0] = start_code;
     buffer.Get(m_send_buffer + 1, &data_size);
     dmp_data = m_send_buffer;
     dmp_data_length = data_size + 1;
@@ -233,6 +272,7 @@ bool E131Node::StreamTerminated(uint16_t universe,
   }
 
   unsigned int data_size = DMX_UNIVERSE_SIZE;
+  m_send_buffer[0] = DMX512_START_CODE;
   buffer.Get(m_send_buffer + 1, &data_size);
 
   TwoByteRangeDMPAddress range_addr(0, 1, (uint16_t) data_size);
@@ -267,12 +307,15 @@ bool E131Node::StreamTerminated(uint16_t universe,
  * @param universe the universe to register the handler for
  * @param handler the Callback0 to call when there is data for this universe.
  * Ownership of the closure is transferred to the node.
+ * @param slot_priorities if not NULL, updated with the 0xdd priorities
  */
 bool E131Node::SetHandler(unsigned int universe,
                           DmxBuffer *buffer,
                           uint8_t *priority,
-                          Callback0<void> *closure) {
-  return m_dmp_inflator.SetHandler(universe, buffer, priority, closure);
+                          Callback0<void> *closure,
+                          DmxBuffer *slot_priorities) {
+  return m_dmp_inflator.SetHandler(universe, buffer, priority, closure,
+                                   slot_priorities);
 }
 
 
@@ -57,6 +57,11 @@ class E131Node {
                  uint8_t priority = DEFAULT_PRIORITY,
                  bool preview = false);
 
+    bool SendDMXPriorities(uint16_t universe,
+                           const ola::DmxBuffer &slot_priorities,
+                           uint8_t priority = DEFAULT_PRIORITY,
+                           bool preview = false);
+
     // The following method is provided for the testing framework. Don't use
     // it in production code!
     bool SendDMXWithSequenceOffset(uint16_t universe,
@@ -70,13 +75,20 @@ class E131Node {
                           uint8_t priority = DEFAULT_PRIORITY);
 
     bool SetHandler(unsigned int universe, ola::DmxBuffer *buffer,
-                    uint8_t *priority, ola::Callback0<void> *handler);
+                    uint8_t *priority, ola::Callback0<void> *handler,
+                    ola::DmxBuffer *slot_priorities = NULL);
     bool RemoveHandler(unsigned int universe);
 
     const ola::network::Interface &GetInterface() const { return m_interface; }
 
     ola::network::UdpSocket* GetSocket() { return m_transport.GetSocket(); }
 
+    // Send the datagrams for each SelectServer iteration in one batch.
+    void EnableSendBatching(ola::network::SelectServerInterface *ss,
+                            ola::ExportMap *export_map = NULL) {
+      m_transport.EnableSendBatching(ss, export_map);
+    }
+
   private:
     typedef struct {
       string source;
@@ -96,6 +108,12 @@ class E131Node {
     uint8_t *m_send_buffer;
 
     tx_universe *SetupOutgoingSettings(unsigned int universe);
+    bool SendDataWithStartCode(uint16_t universe,
+                               uint8_t start_code,
+                               const ola::DmxBuffer &buffer,
+                               int8_t sequence_offset,
+                               uint8_t priority,
+                               bool preview);
 
     E131Node(const E131Node&);
     E131Node& operator=(const E131Node&);
@@ -38,16 +38,20 @@ using ola::network::HostToNetwork;
 using ola::network::IPV4Address;
 
 const char UDPTransport::ACN_PACKET_ID[] = "ASC-E1.17\0\0\0";
+const char UDPTransport::K_DATAGRAMS_SENT_VAR[] = "e131-datagrams-sent";
+const char UDPTransport::K_SEND_CALLS_VAR[] = "e131-send-calls";
 
 /*
  * Clean up
  */
 UDPTransport::~UDPTransport() {
+  if (!m_send_queue.Empty())
+    SendQueuedDatagrams();
   m_socket.Close();
   if (m_send_buffer)
     delete[] m_send_buffer;
-  if (m_recv_buffer)
-    delete[] m_recv_buffer;
+  if (m_recv_batch)
+    delete m_recv_batch;
 }
 
 
@@ -77,8 +81,9 @@ bool UDPTransport::Init(const ola::network::Interface &interface) {
             strlen(ACN_PACKET_ID));
   }
 
-  if (!m_recv_buffer)
-    m_recv_buffer = new uint8_t[MAX_DATAGRAM_SIZE];
+  if (!m_recv_batch)
+    m_recv_batch = new ola::network::DatagramBatch(RECV_BATCH_SIZE,
+                                                   MAX_DATAGRAM_SIZE);
 
   m_interface = interface;
   return true;
@@ -105,35 +110,108 @@ bool UDPTransport::Send(const PDUBlock<PDU> &pdu_block,
     OLA_WARN << "Failed to pack E1.31 PDU";
     return false;
   }
+  size += DATA_OFFSET;
 
-  return m_socket.SendTo(m_send_buffer, DATA_OFFSET + size,
-                         destination,
-                         port);
+  if (!m_ss) {
+    ssize_t bytes_sent = m_socket.SendTo(m_send_buffer, size, destination,
+                                         port);
+    UpdateSendCounters(bytes_sent == static_cast<ssize_t>(size) ? 1 : 0, 1);
+    return bytes_sent == static_cast<ssize_t>(size);
+  }
+
+  if (m_send_queue.IsFull())
+    SendQueuedDatagrams();
+  // the queue is sent once the socket is writable, which is the next time the
+  // SelectServer checks for i/o.
+  if (m_send_queue.Empty())
+    m_ss->AddWriteDescriptor(&m_socket);
+  return m_send_queue.Add(m_send_buffer, size, destination, port);
+}
+
+
+/*
+ * Queue datagrams rather than sending them straight away. All the datagrams
+ * queued while the SelectServer handles an iteration's i/o & timeouts are
+ * sent with a single system call, this makes a big difference when there are
+ * many universes.
+ * @param ss the SelectServerInterface the socket is registered with.
+ * @param export_map if not NULL, the number of datagrams sent & the number of
+ *   send system calls are exported.
+ */
+void UDPTransport::EnableSendBatching(
+    ola::network::SelectServerInterface *ss,
+    ola::ExportMap *export_map) {
+  m_ss = ss;
+  m_socket.SetOnWritable(
+      NewCallback(this, &UDPTransport::SendQueuedDatagrams));
+  if (export_map) {
+    m_datagrams_sent_var = export_map->GetCounterVar(K_DATAGRAMS_SENT_VAR);
+    m_send_calls_var = export_map->GetCounterVar(K_SEND_CALLS_VAR);
+  }
+}
+
+
+/*
+ * Send everything in the queue.
+ */
+void UDPTransport::SendQueuedDatagrams() {
+  if (m_ss)
+    m_ss->RemoveWriteDescriptor(&m_socket);
+
+  unsigned int queued = m_send_queue.Size();
+  unsigned int sent = m_socket.SendBatch(&m_send_queue);
+  UpdateSendCounters(sent, m_send_queue.SendCalls());
+  if (sent != queued)
+    OLA_INFO << "Only sent " << sent << " of " << queued << " E1.31 datagrams";
+}
+
+
+/*
+ * Update the exported send counters.
+ */
+void UDPTransport::UpdateSendCounters(unsigned int datagrams,
+                                      unsigned int calls) {
+  if (m_datagrams_sent_var)
+    (*m_datagrams_sent_var) += datagrams;
+  if (m_send_calls_var)
+    (*m_send_calls_var) += calls;
 }
 
 
 /*
- * Called when new data arrives.
+ * Called when new data arrives. This handles all the datagrams that are
+ * waiting, up to RECV_BATCH_SIZE.
  */
 void UDPTransport::Receive() {
-  if (!m_recv_buffer) {
+  if (!m_recv_batch) {
     OLA_WARN << "Receive called the transport hasn't been initialized";
     return;
   }
 
-  ssize_t size = MAX_DATAGRAM_SIZE;
-  ola::network::IPV4Address src_address;
-  uint16_t src_port;
-
-  if (!m_socket.RecvFrom(m_recv_buffer, &size, src_address, src_port))
+  if (!m_socket.RecvBatch(m_recv_batch))
     return;
 
-  if (size < (ssize_t) DATA_OFFSET) {
+  for (unsigned int i = 0; i < m_recv_batch->Size(); i++)
+    HandleDatagram(m_recv_batch->Data(i),
+                   m_recv_batch->Length(i),
+                   m_recv_batch->Source(i),
+                   m_recv_batch->SourcePort(i));
+}
+
+
+/*
+ * Check the ACN header & pass the PDU block to the inflator.
+ */
+void UDPTransport::HandleDatagram(const uint8_t *data,
+                                  unsigned int size,
+                                  const IPV4Address &src_address,
+                                  uint16_t src_port) {
+  if (size < DATA_OFFSET) {
     OLA_WARN << "short ACN frame, discarding";
     return;
   }
 
-  if (memcmp(m_recv_buffer, m_send_buffer, DATA_OFFSET)) {
+  if (memcmp(data, m_send_buffer, DATA_OFFSET)) {
     OLA_WARN << "ACN header is bad, discarding";
     return;
   }
@@ -143,9 +221,8 @@ void UDPTransport::Receive() {
   header_set.SetTransportHeader(transport_header);
 
   m_inflator->InflatePDUBlock(header_set,
-                              m_recv_buffer + DATA_OFFSET,
-                              static_cast<unsigned int>(size) - DATA_OFFSET);
-  return;
+                              data + DATA_OFFSET,
+                              size - DATA_OFFSET);
 }
 
 
@@ -23,8 +23,10 @@
 #define PLUGINS_E131_E131_UDPTRANSPORT_H_
 
 #include <string>
+#include "ola/ExportMap.h"
 #include "ola/network/IPV4Address.h"
 #include "ola/network/Interface.h"
+#include "ola/network/SelectServerInterface.h"
 #include "ola/network/Socket.h"
 #include "plugins/e131/e131/ACNPort.h"
 #include "plugins/e131/e131/PDU.h"
@@ -44,7 +46,10 @@ class UDPTransport {
       m_inflator(NULL),
       m_port(port),
       m_send_buffer(NULL),
-      m_recv_buffer(NULL) {
+      m_recv_batch(NULL),
+      m_ss(NULL),
+      m_datagrams_sent_var(NULL),
+      m_send_calls_var(NULL) {
     }
 
     UDPTransport(class BaseInflator *inflator,
@@ -52,7 +57,10 @@ class UDPTransport {
       m_inflator(inflator),
       m_port(port),
       m_send_buffer(NULL),
-      m_recv_buffer(NULL) {
+      m_recv_batch(NULL),
+      m_ss(NULL),
+      m_datagrams_sent_var(NULL),
+      m_send_calls_var(NULL) {
     }
     ~UDPTransport();
 
@@ -64,6 +72,10 @@ class UDPTransport {
     void SetInflator(class BaseInflator *inflator) { m_inflator = inflator; }
     void Receive();
 
+    void EnableSendBatching(ola::network::SelectServerInterface *ss,
+                            ola::ExportMap *export_map = NULL);
+    void SendQueuedDatagrams();
+
     bool JoinMulticast(const IPV4Address &group);
     bool LeaveMulticast(const IPV4Address &group);
 
@@ -73,15 +85,29 @@ class UDPTransport {
     class BaseInflator *m_inflator;
     uint16_t m_port;
     uint8_t *m_send_buffer;
-    uint8_t *m_recv_buffer;
+    ola::network::DatagramBatch *m_recv_batch;
+    ola::network::SelectServerInterface *m_ss;
+    ola::network::DatagramSendQueue m_send_queue;
+    ola::CounterVariable *m_datagrams_sent_var;
+    ola::CounterVariable *m_send_calls_var;
 
     static const char ACN_PACKET_ID[];  // ASC-E1.17\0\0\0
+    static const char K_DATAGRAMS_SENT_VAR[];
+    static const char K_SEND_CALLS_VAR[];
     // TODO(simon): add MTU discovery?
     static const unsigned int MAX_DATAGRAM_SIZE = 1472;
     static const uint16_t PREAMBLE_SIZE = 0x10;
     static const uint16_t POSTABLE_SIZE = 0;
     static const unsigned int PREAMBLE_OFFSET = 4;
     static const unsigned int DATA_OFFSET = PREAMBLE_OFFSET + 12;
+    // the number of datagrams to read each time the socket is ready
+    static const unsigned int RECV_BATCH_SIZE = 32;
+
+    void UpdateSendCounters(unsigned int datagrams, unsigned int calls);
+    void HandleDatagram(const uint8_t *data,
+                        unsigned int size,
+                        const IPV4Address &src_address,
+                        uint16_t src_port);
 };
 }  // e131
 }  // plugin
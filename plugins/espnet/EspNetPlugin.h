@@ -42,6 +42,7 @@ class EspNetPlugin: public ola::Plugin {
     string Description() const;
     ola_plugin_id Id() const { return OLA_PLUGIN_ESPNET; }
     string PluginPrefix() const { return PLUGIN_PREFIX; }
+    bool SupportsShards() const { return true; }
 
   private:
     bool StartHook();
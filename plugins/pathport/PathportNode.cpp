@@ -55,7 +55,8 @@ PathportNode::PathportNode(const string &ip_address,
       m_dscp(dscp),
       m_preferred_ip(ip_address),
       m_device_id(device_id),
-      m_sequence_number(1) {
+      m_sequence_number(1),
+      m_recv_batch(RECV_BATCH_SIZE, sizeof(pathport_packet_s)) {
 }
 
 
@@ -118,22 +119,29 @@ bool PathportNode::Stop() {
 
 
 /*
- * Called when there is data on this socket
+ * Called when there is data on this socket. This handles all the packets that
+ * are waiting, up to RECV_BATCH_SIZE.
  */
 void PathportNode::SocketReady(UdpSocket *socket) {
-  pathport_packet_s packet;
-  ssize_t packet_size = sizeof(packet);
-  IPV4Address source;
-
-  if (!socket->RecvFrom(reinterpret_cast<uint8_t*>(&packet),
-                        &packet_size,
-                        source))
+  if (!socket->RecvBatch(&m_recv_batch))
     return;
 
-  // skip packets sent by us
-  if (source == m_interface.ip_address)
-    return;
+  for (unsigned int i = 0; i < m_recv_batch.Size(); i++) {
+    // skip packets sent by us
+    if (m_recv_batch.Source(i) == m_interface.ip_address)
+      continue;
+    HandlePacket(
+        *reinterpret_cast<const pathport_packet_s*>(m_recv_batch.Data(i)),
+        m_recv_batch.Length(i));
+  }
+}
 
+
+/*
+ * Handle a pathport packet
+ */
+void PathportNode::HandlePacket(const pathport_packet_s &packet,
+                                ssize_t packet_size) {
   if (packet_size < static_cast<ssize_t>(sizeof(packet.header))) {
     OLA_WARN << "Small pathport packet received, discarding";
     return;
@@ -158,7 +166,7 @@ void PathportNode::SocketReady(UdpSocket *socket) {
   }
 
   // TODO(simon): Handle multiple pdus here
-  pathport_packet_pdu *pdu = &packet.d.pdu;
+  const pathport_packet_pdu *pdu = &packet.d.pdu;
 
   if (packet_size < static_cast<ssize_t>(sizeof(pathport_pdu_header))) {
     OLA_WARN << "Pathport packet too small to fit a pdu header";
@@ -106,6 +106,7 @@ class PathportNode {
 
     bool InitNetwork();
     void PopulateHeader(pathport_packet_header *header, uint32_t destination);
+    void HandlePacket(const pathport_packet_s &packet, ssize_t packet_size);
     bool ValidateHeader(const pathport_packet_header &header);
     void HandleDmxData(const pathport_pdu_data &packet,
                        unsigned int size);
@@ -123,6 +124,7 @@ class PathportNode {
     universe_handlers m_handlers;
     ola::network::Interface m_interface;
     UdpSocket m_socket;
+    ola::network::DatagramBatch m_recv_batch;
     IPV4Address m_config_addr;
     IPV4Address m_status_addr;
     IPV4Address m_data_addr;
@@ -135,6 +137,8 @@ class PathportNode {
     static const uint32_t PATHPORT_STATUS_GROUP = 0xefffedff;
     static const uint8_t MAJOR_VERSION = 2;
     static const uint8_t MINOR_VERSION = 0;
+    // the number of packets to read each time the socket is ready
+    static const unsigned int RECV_BATCH_SIZE = 32;
 };
 }  // pathport
 }  // plugin
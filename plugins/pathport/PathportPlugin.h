@@ -40,6 +40,7 @@ class PathportPlugin: public ola::Plugin {
     string Description() const;
     ola_plugin_id Id() const { return OLA_PLUGIN_PATHPORT; }
     string PluginPrefix() const { return PLUGIN_PREFIX; }
+    bool SupportsShards() const { return true; }
 
   private:
     bool StartHook();
@@ -40,6 +40,7 @@ class SandNetPlugin: public ola::Plugin {
     string Description() const;
     ola_plugin_id Id() const { return OLA_PLUGIN_SANDNET; }
     string PluginPrefix() const { return PLUGIN_PREFIX; }
+    bool SupportsShards() const { return true; }
 
   private:
     class SandNetDevice *m_device;  // only have one device
@@ -49,7 +49,8 @@ ShowNetNode::ShowNetNode(const string &ip_address)
     : m_running(false),
       m_packet_count(0),
       m_node_name(),
-      m_preferred_ip(ip_address) {
+      m_preferred_ip(ip_address),
+      m_recv_batch(RECV_BATCH_SIZE, sizeof(shownet_data_packet)) {
 }
 
 
@@ -201,21 +202,21 @@ bool ShowNetNode::RemoveHandler(unsigned int universe) {
 
 
 /*
- * Called when there is data on this socket
+ * Called when there is data on this socket. This handles all the packets that
+ * are waiting, up to RECV_BATCH_SIZE.
  */
 void ShowNetNode::SocketReady() {
-  shownet_data_packet packet;
-  ssize_t packet_size = sizeof(packet);
-  ola::network::IPV4Address source;
-
-  if (!m_socket->RecvFrom(reinterpret_cast<uint8_t*>(&packet),
-                          &packet_size,
-                          source))
+  if (!m_socket->RecvBatch(&m_recv_batch))
     return;
 
-  // skip packets sent by us
-  if (source != m_interface.ip_address)
-    HandlePacket(packet, packet_size);
+  for (unsigned int i = 0; i < m_recv_batch.Size(); i++) {
+    // skip packets sent by us
+    if (m_recv_batch.Source(i) == m_interface.ip_address)
+      continue;
+    HandlePacket(
+        *reinterpret_cast<const shownet_data_packet*>(m_recv_batch.Data(i)),
+        m_recv_batch.Length(i));
+  }
 }
 
 
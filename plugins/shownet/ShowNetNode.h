@@ -74,6 +74,7 @@ class ShowNetNode {
     ola::network::Interface m_interface;
     ola::RunLengthEncoder m_encoder;
     ola::network::UdpSocket *m_socket;
+    ola::network::DatagramBatch m_recv_batch;
 
     ShowNetNode(const ShowNetNode&);
     ShowNetNode& operator=(const ShowNetNode&);
@@ -89,6 +90,8 @@ class ShowNetNode {
     static const uint8_t SHOWNET_ID_HIGH = 0x80;
     static const uint8_t SHOWNET_ID_LOW = 0x8f;
     static const int MAGIC_INDEX_OFFSET = 11;
+    // the number of packets to read each time the socket is ready
+    static const unsigned int RECV_BATCH_SIZE = 32;
 };
 }  // shownet
 }  // plugin
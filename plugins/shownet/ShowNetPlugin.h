@@ -46,6 +46,7 @@ class ShowNetPlugin: public Plugin {
     ola_plugin_id Id() const { return OLA_PLUGIN_SHOWNET; }
     string Description() const;
     string PluginPrefix() const { return PLUGIN_PREFIX; }
+    bool SupportsShards() const { return true; }
 
   private:
     bool StartHook();
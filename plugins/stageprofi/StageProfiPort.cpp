@@ -36,6 +36,20 @@ bool StageProfiOutputPort::WriteDMX(const DmxBuffer &buffer,
   return m_widget->SendDmx(buffer);
   (void) priority;
 }
+
+
+/*
+ * The widget keeps sending the last values it was given, so we only need to
+ * send the channels that changed.
+ */
+bool StageProfiOutputPort::WriteDMX(const DmxBuffer &buffer,
+                                    uint8_t priority,
+                                    const dmx_change &change) {
+  if (!change.changed)
+    return true;
+  return m_widget->SendDmxRange(buffer, change.start, change.end);
+  (void) priority;
+}
 }  // stageprofi
 }  // plugin
 }  // ola
@@ -40,6 +40,9 @@ class StageProfiOutputPort: public BasicOutputPort {
           m_widget(widget) {}
 
     bool WriteDMX(const DmxBuffer &buffer, uint8_t priority);
+    bool WriteDMX(const DmxBuffer &buffer,
+                  uint8_t priority,
+                  const dmx_change &change);
     string Description() const { return ""; }
 
   private:
@@ -64,10 +64,21 @@ int StageProfiWidget::Disconnect() {
  * TODO: fix this
  */
 bool StageProfiWidget::SendDmx(const DmxBuffer &buffer) const {
-  unsigned int index = 0;
-  while (index < buffer.Size()) {
-    unsigned int size = std::min((unsigned int) DMX_MSG_LEN,
-                                 buffer.Size() - index);
+  return SendDmxRange(buffer, 0, buffer.Size());
+}
+
+
+/*
+ * Send the channels [start, end), the widget keeps the other channels at
+ * their last values.
+ */
+bool StageProfiWidget::SendDmxRange(const DmxBuffer &buffer,
+                                    unsigned int start,
+                                    unsigned int end) const {
+  unsigned int index = start;
+  end = std::min(end, buffer.Size());
+  while (index < end) {
+    unsigned int size = std::min((unsigned int) DMX_MSG_LEN, end - index);
     Send255(index, buffer.GetRaw() + index, size);
     index += size;
   }
@@ -47,6 +47,9 @@ class StageProfiWidget {
     int Disconnect();
     ConnectedDescriptor *GetSocket() { return m_socket; }
     bool SendDmx(const DmxBuffer &buffer) const;
+    bool SendDmxRange(const DmxBuffer &buffer,
+                      unsigned int start,
+                      unsigned int end) const;
     bool DetectDevice();
     void SocketReady();
     void Timeout();